@@ -0,0 +1,51 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Bump allocator with chunked growth.
+// Objects allocated from an arena are never freed individually; the whole
+// arena is released at once with arena_destroy() or recycled with arena_reset().
+
+#define ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+    size_t size;              // Usable bytes in data[]
+    size_t used;              // Bytes handed out so far
+    _Alignas(16) unsigned char data[];
+} ArenaChunk;
+
+typedef struct Arena {
+    ArenaChunk *head;         // Chunk currently being filled
+    size_t chunk_size;        // Size of regular chunks
+    size_t bytes_allocated;   // Bytes handed out to callers
+    size_t bytes_reserved;    // Bytes obtained from malloc
+    size_t allocation_count;  // Number of arena_alloc() calls
+} Arena;
+
+// Running totals over every arena used by the calling thread; they only
+// grow, so a phase's share is the difference of two snapshots
+typedef struct ArenaStats {
+    size_t allocation_count;
+    size_t bytes_allocated;
+    size_t bytes_reserved;
+} ArenaStats;
+
+// Arena lifetime
+Arena *arena_create(size_t chunk_size);
+void arena_destroy(Arena *arena);
+void arena_reset(Arena *arena);
+
+// Allocation
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_calloc(Arena *arena, size_t count, size_t size);
+void *arena_memdup(Arena *arena, const void *src, size_t size);
+char *arena_strdup(Arena *arena, const char *str);
+char *arena_strndup(Arena *arena, const char *str, size_t len);
+
+// Statistics
+ArenaStats arena_thread_stats(void);
+
+#endif // ARENA_H
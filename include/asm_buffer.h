@@ -0,0 +1,48 @@
+#ifndef ASM_BUFFER_H
+#define ASM_BUFFER_H
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Output buffer shared by the assembly emitters.
+// Text is appended to one large memory block instead of going through stdio
+// per instruction. The common conversions (%s %c %d %i %u %x with l/ll/z
+// modifiers) are formatted by hand; anything with flags, width or precision
+// falls back to vsnprintf. With a sink the block is written out with one
+// fwrite whenever it fills up and by asm_buffer_flush(); without one it
+// grows and the caller takes the text from data/length.
+
+#define ASM_BUFFER_FLUSH_SIZE (1024 * 1024)
+
+typedef struct AsmBuffer {
+    char *data;
+    size_t length;
+    size_t capacity;
+    FILE *sink;                  // Written to when full, or NULL
+    bool failed;                 // Allocation or write failure; later text is dropped
+} AsmBuffer;
+
+// Returns false when the initial block cannot be allocated
+bool asm_buffer_init(AsmBuffer *buffer, FILE *sink);
+void asm_buffer_free(AsmBuffer *buffer);
+
+// Discards the buffered text, keeping the memory
+void asm_buffer_reset(AsmBuffer *buffer);
+
+void asm_buffer_append(AsmBuffer *buffer, const char *text, size_t length);
+void asm_buffer_puts(AsmBuffer *buffer, const char *text);
+void asm_buffer_putc(AsmBuffer *buffer, char c);
+void asm_buffer_int(AsmBuffer *buffer, long long value);
+void asm_buffer_uint(AsmBuffer *buffer, unsigned long long value, unsigned base);
+
+void asm_buffer_vformat(AsmBuffer *buffer, const char *format, va_list args);
+void asm_buffer_format(AsmBuffer *buffer, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Writes the buffered text to the sink; false if anything could not be
+// allocated or written since the buffer was created
+bool asm_buffer_flush(AsmBuffer *buffer);
+
+#endif // ASM_BUFFER_H
@@ -44,8 +44,13 @@ void ast_add_parameter(ASTNode *function, ASTNode *parameter);
 void ast_add_statement(ASTNode *compound_stmt, ASTNode *statement);
 void ast_add_argument(ASTNode *call_expr, ASTNode *argument);
 
+// AST memory: nodes, child arrays and names are owned by the AST arena
+char *ast_strdup(const char *str);
+ASTNode **ast_copy_children(ASTNode **children, int count);
+
 // AST utility functions
 void ast_destroy(ASTNode *node);
+size_t ast_node_count(void);     // Nodes allocated for the current tree
 // In the ast.c header file
 void ast_print(ASTNode *node, int indent);
 const char *ast_node_type_to_string(ASTNodeType type);
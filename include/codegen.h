@@ -7,16 +7,26 @@
 
 // Code generator lifecycle functions
 CodeGenerator *codegen_create(const char *output_filename);
+
+// On x86-64 hosts the instructions can be encoded in-process and written
+// as an ELF object instead of assembly text
+#if defined(__x86_64__)
+#define CODEGEN_HAS_OBJECT_OUTPUT 1
+CodeGenerator *codegen_create_object(const char *object_filename);
+#endif
 void codegen_destroy(CodeGenerator *codegen);
 
 // Main code generation functions
 bool codegen_generate(CodeGenerator *codegen, ASTNode *ast);
 void codegen_emit(CodeGenerator *codegen, const char *format, ...);
-char *codegen_new_label(CodeGenerator *codegen);
-char *codegen_new_temp(CodeGenerator *codegen);
+
+// Label and temporary numbers; emit them as "L%d" and "t%d"
+int codegen_new_label(CodeGenerator *codegen);
+int codegen_new_temp(CodeGenerator *codegen);
 
 // Code generation for different AST nodes
 void codegen_program(CodeGenerator *codegen, ASTNode *node);
+bool codegen_defines_main(ASTNode *program);
 void codegen_function_declaration(CodeGenerator *codegen, ASTNode *node);
 void codegen_variable_declaration(CodeGenerator *codegen, ASTNode *node);
 void codegen_statement(CodeGenerator *codegen, ASTNode *node);
@@ -26,14 +36,19 @@ void codegen_return_statement(CodeGenerator *codegen, ASTNode *node);
 void codegen_if_statement(CodeGenerator *codegen, ASTNode *node);
 void codegen_while_statement(CodeGenerator *codegen, ASTNode *node);
 void codegen_for_statement(CodeGenerator *codegen, ASTNode *node);
+
+// Evaluates an expression into the result register (rax / w0)
 void codegen_expression(CodeGenerator *codegen, ASTNode *node);
-void codegen_binary_expression(CodeGenerator *codegen, ASTNode *node);
-void codegen_unary_expression(CodeGenerator *codegen, ASTNode *node);
-void codegen_call_expression(CodeGenerator *codegen, ASTNode *node);
-void codegen_identifier(CodeGenerator *codegen, ASTNode *node);
-void codegen_number(CodeGenerator *codegen, ASTNode *node);
-void codegen_string(CodeGenerator *codegen, ASTNode *node);
-void codegen_assignment(CodeGenerator *codegen, ASTNode *node);
+
+// Evaluate into expression temporary reg, using reg and the temporaries
+// above it as scratch
+void codegen_binary_expression(CodeGenerator *codegen, ASTNode *node, int reg);
+void codegen_unary_expression(CodeGenerator *codegen, ASTNode *node, int reg);
+void codegen_call_expression(CodeGenerator *codegen, ASTNode *node, int reg);
+void codegen_identifier(CodeGenerator *codegen, ASTNode *node, int reg);
+void codegen_number(CodeGenerator *codegen, ASTNode *node, int reg);
+void codegen_string(CodeGenerator *codegen, ASTNode *node, int reg);
+void codegen_assignment(CodeGenerator *codegen, ASTNode *node, int reg);
 
 // Array code generation functions
 void codegen_array_declaration(CodeGenerator *codegen, ASTNode *node);
@@ -0,0 +1,46 @@
+#ifndef COMPILE_CACHE_H
+#define COMPILE_CACHE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "kcc.h"
+
+// Content-addressed cache of code generator output.
+// The key hashes the preprocessed source together with everything else the
+// output depends on (compiler version, target, optimization and output
+// kind), so a hit can skip lexing, parsing and code generation. Entries are
+// plain files under <dir>/<first two key digits>/<rest of the key>; a hit
+// refreshes the entry's mtime and the oldest entries are evicted once the
+// cache grows past its size limit. Hit/miss counters and the total size
+// live in <dir>/stats, updated under an flock so parallel compiles (-j, the
+// compile server, several kcc processes) can share one cache.
+
+#define COMPILE_CACHE_KEY_SIZE 33            // 32 hex digits and a NUL
+#define COMPILE_CACHE_DEFAULT_MAX_SIZE (1024ull * 1024 * 1024)
+
+// $KCC_CACHE_DIR, else $XDG_CACHE_HOME/kcc, else $HOME/.cache/kcc
+const char *compile_cache_default_dir(void);
+
+// $KCC_CACHE_MAX_SIZE (bytes, optionally with a K, M or G suffix), else
+// COMPILE_CACHE_DEFAULT_MAX_SIZE
+uint64_t compile_cache_max_size(void);
+
+// Key for a preprocessed translation unit; object_output tells an object
+// file from assembly
+void compile_cache_key(const char *source, size_t length, const CompilerOptions *opts,
+                       bool object_output, char key[COMPILE_CACHE_KEY_SIZE]);
+
+// On a hit copies the entry to output_path and returns true; counts the hit
+// or miss either way
+bool compile_cache_fetch(const char *dir, const char *key, const char *output_path);
+
+// Adds the file at path under key, then evicts least recently used entries
+// while the cache is over max_size. Failures only cost the cache entry.
+void compile_cache_store(const char *dir, const char *key, const char *path, uint64_t max_size);
+
+// Prints the counters; returns false if the statistics cannot be read
+bool compile_cache_print_stats(const char *dir, FILE *out);
+
+#endif // COMPILE_CACHE_H
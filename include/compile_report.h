@@ -0,0 +1,62 @@
+#ifndef COMPILE_REPORT_H
+#define COMPILE_REPORT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "arena.h"
+
+// Per-phase instrumentation for -ftime-report and -fmem-report.
+// Each phase records its wall time (monotonic clock), the process's peak
+// RSS when it ended, what it allocated from arenas on the compiling thread,
+// and a count of what it produced (lines, tokens, AST nodes). Reports are
+// printed as a table or, for CI, as one JSON object per line.
+
+typedef enum {
+    REPORT_PHASE_PREPROCESS,
+    REPORT_PHASE_CACHE,          // Compile cache lookup and store
+    REPORT_PHASE_LEX,
+    REPORT_PHASE_PARSE,
+    REPORT_PHASE_CODEGEN,        // Including the integrated assembler
+    REPORT_PHASE_ASSEMBLE,       // External assembler
+    REPORT_PHASE_LINK,
+    REPORT_PHASE_COUNT
+} ReportPhase;
+
+typedef enum {
+    REPORT_FORMAT_TABLE,
+    REPORT_FORMAT_JSON
+} ReportFormat;
+
+typedef struct PhaseReport {
+    bool ran;
+    double seconds;
+    long peak_rss_kb;            // Process high-water mark at the end
+    size_t allocations;          // Arena allocations during the phase
+    size_t bytes;                // Arena bytes handed out during the phase
+    size_t count;                // Lines, tokens or nodes; see the table
+} PhaseReport;
+
+typedef struct CompileReport {
+    const char *name;            // Input file, or the output for a link
+    size_t lines;                // Preprocessed lines, for lines/second
+    PhaseReport phases[REPORT_PHASE_COUNT];
+
+    // The phase being timed
+    double started;
+    ArenaStats arena_at_start;
+} CompileReport;
+
+void compile_report_init(CompileReport *report, const char *name);
+
+// Phases do not nest. Both calls accept a NULL report, so instrumented code
+// does not need to check whether reporting is on.
+void compile_report_begin(CompileReport *report);
+void compile_report_end(CompileReport *report, ReportPhase phase, size_t count);
+
+// Prints the phases that ran, with timing (time) and/or memory (mem)
+// columns, in one write so reports of parallel compiles do not interleave
+void compile_report_print(const CompileReport *report, bool time, bool mem,
+                          ReportFormat format, FILE *out);
+
+#endif // COMPILE_REPORT_H
@@ -0,0 +1,34 @@
+#ifndef COMPILE_SERVER_H
+#define COMPILE_SERVER_H
+
+#include <stdbool.h>
+
+// Persistent compile server.
+// `kcc --server` listens on a Unix socket and answers every request from a
+// fork of itself, so each compile starts with the server's warm state
+// (interned strings, the include cache with headers already read and their
+// guards known) instead of a cold process. A request carries the client's
+// working directory, its argv and its stdin/stdout/stderr descriptors; the
+// forked compile writes diagnostics and output straight to the client's
+// streams and the server replies with the exit status.
+//
+// Clients find the server through the KCC_SERVER environment variable and
+// compile locally when nobody answers there.
+
+#define COMPILE_SERVER_MAGIC 0x4B434353u  // "KCCS"
+#define COMPILE_SERVER_VERSION 1
+
+// Runs one request in the forked child; returns its exit status
+typedef int (*CompileServerHandler)(int argc, char **argv);
+
+// Default socket: $XDG_RUNTIME_DIR/kcc.sock, else /tmp/kcc-<uid>.sock
+const char *compile_server_default_socket(void);
+
+// Serves requests until SIGINT/SIGTERM; returns the process exit status
+int compile_server_run(const char *socket_path, CompileServerHandler handler);
+
+// Forwards argv to the server; returns the compile's exit status, or -1 if
+// no server answered (the caller should then compile itself)
+int compile_server_forward(const char *socket_path, int argc, char **argv);
+
+#endif // COMPILE_SERVER_H
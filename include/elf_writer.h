@@ -0,0 +1,54 @@
+#ifndef ELF_WRITER_H
+#define ELF_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Relocatable ELF object writer shared by the integrated assemblers.
+// Handles both classes and byte orders (ELF64 little-endian for x86-64,
+// ELF32 big-endian for SH). Callers hand over finished section contents in
+// the target byte order, then symbols and RELA relocations against them; the
+// writer orders the symbol table (locals first) and lays out the file.
+
+#define ELF_EM_SH      42
+#define ELF_EM_X86_64  62
+
+#define ELF_SHT_PROGBITS 1
+#define ELF_SHT_NOBITS   8
+
+#define ELF_SHF_WRITE     0x1
+#define ELF_SHF_ALLOC     0x2
+#define ELF_SHF_EXECINSTR 0x4
+#define ELF_SHF_MERGE     0x10
+#define ELF_SHF_STRINGS   0x20
+
+#define ELF_STT_NOTYPE  0
+#define ELF_STT_OBJECT  1
+#define ELF_STT_FUNC    2
+
+typedef struct ElfWriter ElfWriter;
+
+ElfWriter *elf_writer_create(bool is_64bit, bool big_endian, uint16_t machine);
+void elf_writer_destroy(ElfWriter *writer);
+
+// Adds a section; data must stay valid until elf_writer_write() and is
+// ignored for NOBITS sections. Returns the section's index (from 1).
+int elf_writer_add_section(ElfWriter *writer, const char *name, uint32_t type, uint64_t flags,
+                           uint64_t alignment, const void *data, uint64_t size);
+
+// Adds a symbol and returns a handle for relocations; section 0 means
+// undefined
+int elf_writer_add_symbol(ElfWriter *writer, const char *name, int section, uint64_t value,
+                          uint64_t size, uint8_t type, bool global);
+
+// Handle of the STT_SECTION symbol for a section
+int elf_writer_section_symbol(ElfWriter *writer, int section);
+
+void elf_writer_add_relocation(ElfWriter *writer, int section, uint64_t offset, int symbol,
+                               uint32_t type, int64_t addend);
+
+// Writes the object file; returns false (after reporting) on I/O errors
+bool elf_writer_write(ElfWriter *writer, const char *path);
+
+#endif // ELF_WRITER_H
@@ -0,0 +1,50 @@
+#ifndef INCLUDE_CACHE_H
+#define INCLUDE_CACHE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "kcc.h"
+
+// Process-wide cache of header files.
+// Entries are keyed by the file's identity (device, inode, mtime), so the
+// same header reached through different paths is read once, and an edited
+// header gets a fresh entry. Besides the contents, an entry remembers what
+// the preprocessor learnt the first time through: the include guard macro
+// and whether the file said #pragma once. A guarded header can then be
+// skipped on later #includes without being read or lexed again.
+// Lookups and loads are thread-safe; include_cache_destroy() is not.
+
+typedef struct IncludeCacheEntry {
+    unsigned long long device;
+    unsigned long long inode;
+    long long mtime;
+    char *path;                  // Path the file was first opened under
+    SourceFile source;           // Contents, loaded on first use
+    bool loaded;
+
+    // Learnt while preprocessing the file
+    bool scanned;                // Guard detection has run
+    const char *guard;           // Interned #ifndef guard macro, or NULL
+    bool pragma_once;
+} IncludeCacheEntry;
+
+// Finds (or creates) the entry for the file at path; returns NULL if the
+// file does not exist
+IncludeCacheEntry *include_cache_lookup(const char *path);
+
+// Maps or reads the contents; returns false on I/O errors
+bool include_cache_load(IncludeCacheEntry *entry);
+
+// What the preprocessor learnt. Entries are shared by translation units
+// compiled in parallel, so these go through the cache's lock; the fields
+// themselves may only be read directly while nothing else is compiling.
+void include_cache_set_guard(IncludeCacheEntry *entry, const char *guard);
+void include_cache_set_pragma_once(IncludeCacheEntry *entry);
+const char *include_cache_guard(IncludeCacheEntry *entry);
+bool include_cache_pragma_once(IncludeCacheEntry *entry);
+
+// Statistics and cleanup
+size_t include_cache_count(void);
+void include_cache_destroy(void);
+
+#endif // INCLUDE_CACHE_H
@@ -0,0 +1,34 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Process-wide string interner.
+// Every distinct spelling is stored once; the returned pointer is a stable
+// handle that stays valid until intern_table_destroy(). Two interned strings
+// are equal iff their pointers are equal, so identifiers, keywords and symbol
+// names can be compared without strcmp. The hash is computed once at intern
+// time and stored in front of the characters.
+// Interning and lookups are thread-safe; intern_table_destroy() is not.
+
+// Interning
+const char *intern_string(const char *str);
+const char *intern_string_n(const char *str, size_t length);
+
+// Queries on interned handles (undefined for non-interned pointers)
+unsigned int intern_hash(const char *interned);
+size_t intern_length(const char *interned);
+
+// Lookup without inserting; returns NULL if the spelling was never interned
+const char *intern_lookup_n(const char *str, size_t length);
+
+// Hash used by the interner (FNV-1a), exposed so tables keyed by
+// non-interned text can agree with intern_hash()
+unsigned int intern_hash_bytes(const char *str, size_t length);
+
+// Statistics and cleanup
+size_t intern_count(void);
+void intern_table_destroy(void);
+
+#endif // INTERN_H
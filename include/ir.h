@@ -0,0 +1,188 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "arena.h"
+#include "types.h"
+
+// Target-independent SSA intermediate representation.
+// The AST is lowered once (ir_lower.c) into functions made of basic blocks.
+// Every instruction that produces a value defines one typed virtual
+// register; phis come first in their block, with one operand per
+// predecessor in predecessor order, and every block ends in exactly one
+// terminator (jump, branch or ret). Constants are operands only: they
+// have no register and are not placed in a block. A module and everything it holds live
+// in one arena and are released together by ir_module_destroy().
+
+typedef enum {
+    IR_TYPE_VOID,
+    IR_TYPE_I8,
+    IR_TYPE_I16,
+    IR_TYPE_I32,
+    IR_TYPE_I64,
+    IR_TYPE_PTR,
+    IR_TYPE_F32,
+    IR_TYPE_F64
+} IRType;
+
+typedef enum {
+    // Values
+    IR_CONST,            // data.constant, or data.fconstant for f32/f64
+    IR_PARAM,            // data.index-th argument
+    IR_UNDEF,            // A variable read before it was assigned
+    IR_PHI,
+    IR_GLOBAL_ADDR,      // Address of data.symbol
+    IR_LOAD,             // [address]
+    IR_STORE,            // [address, value]; defines nothing
+    IR_CALL,             // data.symbol with the operands as arguments
+    IR_CONVERT,          // [value] to the instruction's type
+
+    // Arithmetic and bitwise, [lhs, rhs]
+    IR_ADD,
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_MOD,
+    IR_AND,
+    IR_OR,
+    IR_XOR,
+    IR_SHL,
+    IR_SHR,
+
+    // Comparisons, [lhs, rhs]; 1 or 0 as i32
+    IR_EQ,
+    IR_NE,
+    IR_LT,
+    IR_LE,
+    IR_GT,
+    IR_GE,
+
+    // Unary, [value]
+    IR_NEG,
+    IR_BITNOT,
+
+    // Terminators
+    IR_JUMP,             // To data.targets[0]
+    IR_BRANCH,           // [condition]; nonzero to targets[0], zero to targets[1]
+    IR_RET,              // [value], or no operand
+
+    IR_OP_COUNT
+} IROp;
+
+typedef struct IRBlock IRBlock;
+typedef struct IRFunction IRFunction;
+
+typedef struct IRInstr {
+    IROp op;
+    IRType type;                 // IR_TYPE_VOID when nothing is defined
+    int id;                      // Virtual register, or -1
+    int operand_count;
+    struct IRInstr **operands;
+    IRBlock *block;
+    struct IRInstr *prev;
+    struct IRInstr *next;
+    struct IRInstr *replacement; // Set when a phi was folded into another value
+    union {
+        int64_t constant;
+        double fconstant;
+        int index;
+        const char *symbol;
+        IRBlock *targets[2];
+    } data;
+} IRInstr;
+
+struct IRBlock {
+    int id;
+    IRInstr *first;
+    IRInstr *last;
+    IRBlock **preds;
+    int pred_count;
+    int pred_capacity;
+    bool sealed;                 // All predecessors known (SSA construction)
+    IRBlock *next;               // Layout order within the function
+};
+
+struct IRFunction {
+    const char *name;
+    IRType return_type;
+    int param_count;
+    IRInstr **params;
+    IRBlock *entry;
+    IRBlock *last_block;
+    int block_count;
+    int value_count;             // Virtual registers are 0..value_count-1
+    IRFunction *next;
+};
+
+typedef struct IRGlobal {
+    const char *name;
+    IRType type;
+    bool has_initializer;
+    int64_t initializer;
+    const char *string;          // String literal as written, escapes included, or NULL
+    struct IRGlobal *next;
+} IRGlobal;
+
+typedef struct IRModule {
+    Arena *arena;
+    IRFunction *functions;
+    IRFunction *last_function;
+    IRGlobal *globals;
+    IRGlobal *last_global;
+    int string_count;
+} IRModule;
+
+// Module and storage
+IRModule *ir_module_create(void);
+void ir_module_destroy(IRModule *module);
+
+IRFunction *ir_function_create(IRModule *module, const char *name, IRType return_type,
+                               int param_count);
+// A new block is numbered in function but only enters the layout once
+// appended, so blocks can be created ahead as jump targets
+IRBlock *ir_block_create(IRModule *module, IRFunction *function);
+void ir_function_append_block(IRFunction *function, IRBlock *block);
+IRGlobal *ir_global_create(IRModule *module, const char *name, IRType type);
+IRGlobal *ir_global_find(const IRModule *module, const char *name);
+
+// Adds a private global holding text and returns its symbol
+const char *ir_string_literal(IRModule *module, const char *text);
+
+// Instructions; ids are assigned to instructions that define a value
+IRInstr *ir_instr_create(IRModule *module, IRFunction *function, IROp op, IRType type,
+                         int operand_count);
+IRInstr *ir_const(IRModule *module, IRType type, int64_t value);
+IRInstr *ir_fconst(IRModule *module, IRType type, double value);
+void ir_block_append(IRBlock *block, IRInstr *instr);
+void ir_block_insert_phi(IRBlock *block, IRInstr *phi);
+void ir_instr_remove(IRInstr *instr);
+
+// Control flow
+void ir_block_add_pred(IRModule *module, IRBlock *block, IRBlock *pred);
+void ir_block_remove_pred(IRBlock *block, int index);
+bool ir_block_terminated(const IRBlock *block);
+int ir_block_successors(const IRBlock *block, IRBlock *succs[2]);
+
+// The value a folded phi stands for
+IRInstr *ir_resolve(IRInstr *value);
+
+// Numbers blocks and values densely in layout order
+void ir_function_renumber(IRFunction *function);
+
+const char *ir_type_name(IRType type);
+const char *ir_op_name(IROp op);
+IRType ir_type_from_data_type(DataType type);
+int ir_type_size(IRType type);
+
+// Text dump, as written by --emit-ir
+void ir_print_function(const IRFunction *function, FILE *out);
+void ir_print_module(const IRModule *module, FILE *out);
+
+// Lowering (ir_lower.c): the program's function definitions and globals.
+// Constructs the AST does not map onto are reported through the error module
+// (callers check error_has_errors()) and lowered to undef.
+IRModule *ir_lower_program(ASTNode *program);
+
+#endif // IR_H
@@ -13,6 +13,10 @@
 #define MAX_NODES 512
 #define MAX_IDENTIFIER_LENGTH 256
 #define MAX_STRING_LENGTH 1024
+
+// Programs are entered at _main, which every backend defines in the unit
+// that defines main
+#define KCC_LINK_FLAGS "-Wl,-e,_main -nostartfiles"
 #define TARGET_SH2 1
 // Architecture-specific settings
 #ifdef TARGET_SH2
@@ -32,6 +36,7 @@
 
 // Include headers in correct order
 #include "error.h"
+#include "intern.h"
 #include "lexer.h"
 #include "ast.h"
 #include "parser.h"
@@ -40,6 +45,19 @@
 
 // Essential utility functions
 char* read_file(const char* filename);
+
+// Read-only view of a whole source file. Regular files are memory-mapped
+// where the platform supports it, anything else is read into a malloc'd
+// buffer. data is not NUL-terminated; use size.
+typedef struct {
+    const char *data;
+    size_t size;
+    bool mapped;
+} SourceFile;
+
+bool source_file_open(SourceFile *file, const char *filename);
+void source_file_close(SourceFile *file);
+
 void* safe_malloc(size_t size);
 bool safe_strcpy(char* dest, size_t dest_size, const char* src);
 char* safe_strdup(const char* src);
@@ -62,8 +80,18 @@ typedef struct {
     bool keep_asm;
     bool no_preprocess;  // Skip preprocessing
     bool preprocess_only; // Only run preprocessor
+    bool emit_ir;         // Only lower to IR and print it
     char **user_macros;   // User-defined macros from command line
     int macro_count;      // Number of user macros
+    char **include_paths; // -I directories, searched in order
+    int include_path_count;
+    bool emit_pch;        // Write a precompiled header instead of compiling
+    char *include_pch;    // Precompiled header to start from, or NULL
+    const char *cache_dir; // Compile cache directory, or NULL when not caching
+    bool cache_stats;     // Print the compile cache counters
+    bool time_report;     // -ftime-report: per-phase timings
+    bool mem_report;      // -fmem-report: per-phase memory use
+    bool report_json;     // ...as JSON rather than a table
     bool include_env;     // Include environment variable macros
     bool include_system;  // Include system information macros
     char *target_arch;    // Target architecture (x86_64, arm64)
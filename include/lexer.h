@@ -13,17 +13,24 @@
 #define MAX_STRING_LENGTH 1024
 
 // Lexer functions
+// The lexer does not copy its input: the buffer passed to lexer_create()
+// must stay alive for as long as the lexer or any of its tokens are used.
 Lexer *lexer_create(const char *input, const char *filename);
 void lexer_destroy(Lexer *lexer);
 Token lexer_next_token(Lexer *lexer);
 Token lexer_peek_token(Lexer *lexer);
+
+// Lex the rest of the input into one malloc'd array terminated by a
+// TOKEN_EOF token (included in *count); the caller frees it
+Token *lexer_tokenize(Lexer *lexer, size_t *count);
 const char *token_type_to_string(TokenType type);
 bool is_keyword(const char *str, TokenType *type);
 void print_token(const Token *token);
 
-// Helper functions for token management
-void token_destroy(Token *token);
-Token token_copy(const Token *token);
+// Token text: tokens are plain values that borrow their text from the
+// lexer input, so there is nothing to free or deep-copy
+const char *lexer_token_start(const Lexer *lexer, const Token *token);
+const char *lexer_token_text(Lexer *lexer, const Token *token);
 
 // Objective-C specific helper functions
 bool is_objc_at_keyword(const char *str, TokenType *type);
@@ -0,0 +1,31 @@
+#ifndef LEXER_SCAN_H
+#define LEXER_SCAN_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Bulk character scanning for the lexer.
+// Every scanner looks at the bytes in [p, end) and returns a pointer to the
+// first byte that stops the scan, or end. On x86 the work is done 16 (SSE2)
+// or 32 (AVX2, picked at run time) bytes at a time, on ARM with NEON; the
+// remaining tail and other targets fall back to a plain byte loop.
+
+// Skip runs of C whitespace (' ', \t, \n, \v, \f, \r)
+const char *lexer_scan_whitespace(const char *p, const char *end);
+
+// Skip runs of identifier characters [A-Za-z0-9_]
+const char *lexer_scan_identifier(const char *p, const char *end);
+
+// Find the first occurrence of either byte a or byte b
+const char *lexer_scan_until2(const char *p, const char *end, char a, char b);
+
+// Count '\n' bytes in [p, end); *last_newline receives the position of the
+// last one (left untouched if there is none)
+size_t lexer_scan_count_newlines(const char *p, const char *end, const char **last_newline);
+
+// Backend selection, mainly for benchmarking the vector paths against the
+// scalar one
+void lexer_scan_set_vector(bool enabled);
+const char *lexer_scan_backend_name(void);
+
+#endif // LEXER_SCAN_H
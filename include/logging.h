@@ -0,0 +1,60 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <stdbool.h>
+
+// Leveled diagnostic logging for the compiler itself.
+// Every category has its own runtime level, all off by default, so a normal
+// compile does no diagnostic I/O; a disabled call costs one load and
+// compare. KCC_LOG_MAX_LEVEL (CMake: -DKCC_LOG_LEVEL=n) caps what is
+// compiled in: at 0 every LOG_* call compiles to nothing.
+// Messages go to stderr, one line per call, prefixed with the category.
+
+#ifndef KCC_LOG_MAX_LEVEL
+#define KCC_LOG_MAX_LEVEL 3
+#endif
+
+typedef enum {
+    LOG_LEVEL_OFF = 0,
+    LOG_LEVEL_INFO = 1,      // What the driver did (output files, commands)
+    LOG_LEVEL_DEBUG = 2,     // Phase progress
+    LOG_LEVEL_TRACE = 3      // Dumps of intermediate data
+} LogLevel;
+
+typedef enum {
+    LOG_DRIVER,
+    LOG_PP,
+    LOG_LEX,
+    LOG_PARSE,
+    LOG_CODEGEN,
+    LOG_OPT,
+    LOG_CATEGORY_COUNT
+} LogCategory;
+
+// Set once at startup, before any compile thread runs
+extern int log_category_levels[LOG_CATEGORY_COUNT];
+
+#define LOG_ENABLED(category, level) \
+    ((level) <= KCC_LOG_MAX_LEVEL && log_category_levels[(category)] >= (level))
+
+#define LOG_AT(category, level, ...) \
+    do { \
+        if (LOG_ENABLED(category, level)) log_write((category), __VA_ARGS__); \
+    } while (0)
+
+#define LOG_INFO(category, ...)  LOG_AT(category, LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(category, ...) LOG_AT(category, LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_TRACE(category, ...) LOG_AT(category, LOG_LEVEL_TRACE, __VA_ARGS__)
+
+void log_write(LogCategory category, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Sets every category's level
+void log_set_all(LogLevel level);
+
+// Applies a --log spec: comma-separated "category[:level]" items, where
+// category is a name or "all" and level a number or off/info/debug/trace
+// (default debug); returns false on an unknown name
+bool log_configure(const char *spec);
+
+#endif // LOGGING_H
@@ -6,6 +6,7 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
+#include "asm_buffer.h"
 
 // Target architectures
 typedef enum {
@@ -84,21 +85,12 @@ typedef struct {
 // Multi-architecture code generator
 typedef struct MultiArchCodegen {
     FILE *output_file;
+    AsmBuffer output;             // Pending text for output_file
     TargetConfig *target;
     
     // Code generation state
     int label_counter;
     int temp_counter;
-    int current_function_locals;
-    int stack_offset;
-    
-    // Symbol tables and tracking
-    struct {
-        char name[64];
-        int offset;
-        int size;
-    } local_vars[256];
-    int local_var_count;
     
     // Function prologue/epilogue tracking
     bool in_function;
@@ -117,7 +109,8 @@ TargetPlatform detect_host_platform(void);
 MultiArchCodegen *multiarch_codegen_create(const char *output_file, TargetArch arch, TargetPlatform platform);
 void multiarch_codegen_destroy(MultiArchCodegen *codegen);
 
-// Main code generation
+// Main code generation. The AST is lowered to the IR first: locals become
+// SSA values in registers or spill slots, never looked up by name.
 bool multiarch_codegen_generate(MultiArchCodegen *codegen, struct ASTNode *ast);
 
 // Architecture-neutral code generation
@@ -180,12 +173,6 @@ void multiarch_pop(MultiArchCodegen *codegen, const char *reg);
 void multiarch_stack_alloc(MultiArchCodegen *codegen, int bytes);
 void multiarch_stack_dealloc(MultiArchCodegen *codegen, int bytes);
 
-// Variable management
-void multiarch_declare_local_var(MultiArchCodegen *codegen, const char *name, int size);
-int multiarch_get_local_var_offset(MultiArchCodegen *codegen, const char *name);
-void multiarch_load_local_var(MultiArchCodegen *codegen, const char *dest_reg, const char *var_name);
-void multiarch_store_local_var(MultiArchCodegen *codegen, const char *src_reg, const char *var_name);
-
 // System calls
 void multiarch_syscall(MultiArchCodegen *codegen, int syscall_num, int arg_count);
 void multiarch_exit_program(MultiArchCodegen *codegen, int exit_code);
@@ -195,19 +182,9 @@ char *multiarch_new_label(MultiArchCodegen *codegen);
 char *multiarch_new_temp(MultiArchCodegen *codegen);
 void multiarch_align_stack(MultiArchCodegen *codegen);
 
-// AST-specific code generation
-void multiarch_codegen_program(MultiArchCodegen *codegen, struct ASTNode *node);
-void multiarch_codegen_function_declaration(MultiArchCodegen *codegen, struct ASTNode *node);
-void multiarch_codegen_variable_declaration(MultiArchCodegen *codegen, struct ASTNode *node);
-void multiarch_codegen_statement(MultiArchCodegen *codegen, struct ASTNode *node);
-void multiarch_codegen_expression(MultiArchCodegen *codegen, struct ASTNode *node);
-void multiarch_codegen_binary_expr(MultiArchCodegen *codegen, struct ASTNode *node);
-void multiarch_codegen_unary_expr(MultiArchCodegen *codegen, struct ASTNode *node);
-void multiarch_codegen_call_expr(MultiArchCodegen *codegen, struct ASTNode *node);
-void multiarch_codegen_return_stmt(MultiArchCodegen *codegen, struct ASTNode *node);
-void multiarch_codegen_if_stmt(MultiArchCodegen *codegen, struct ASTNode *node);
-void multiarch_codegen_while_stmt(MultiArchCodegen *codegen, struct ASTNode *node);
-
-
-void multiarch_codegen_switch_stmt(MultiArchCodegen *codegen, struct ASTNode *node);
+// IR code generation, with registers from the linear-scan allocator (regalloc.h)
+struct IRFunction;
+struct IRModule;
+void multiarch_codegen_ir_function(MultiArchCodegen *codegen, const struct IRFunction *function);
+void multiarch_codegen_ir_globals(MultiArchCodegen *codegen, const struct IRModule *module);
 #endif // MULTIARCH_CODEGEN_H
\ No newline at end of file
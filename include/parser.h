@@ -11,6 +11,12 @@ void parser_advance(Parser *parser);
 bool parser_match(Parser *parser, TokenType type);
 bool parser_expect(Parser *parser, TokenType type);
 
+// Lookahead and backtracking over the pre-lexed token array
+Token parser_peek(Parser *parser, size_t ahead);
+size_t parser_mark(Parser *parser);
+void parser_rewind(Parser *parser, size_t mark);
+void parser_synchronize(Parser *parser);
+
 // Type checking and parsing utilities
 bool parser_is_type_specifier(TokenType type);
 bool parser_is_objc_directive(TokenType type);
@@ -20,8 +26,8 @@ DataType token_type_to_data_type(TokenType type);
 // Core parsing functions
 ASTNode *parser_parse_program(Parser *parser);
 ASTNode *parser_parse_declaration(Parser *parser);
-ASTNode *parser_parse_function(Parser *parser, DataType return_type, char *name);
-ASTNode *parser_parse_function_definition(Parser *parser, DataType return_type, char *name);
+ASTNode *parser_parse_function(Parser *parser, DataType return_type, const char *name);
+ASTNode *parser_parse_function_definition(Parser *parser, DataType return_type, const char *name);
 ASTNode *parser_parse_variable_declaration(Parser *parser, DataType var_type);
 
 // Helper functions for AST creation
@@ -0,0 +1,30 @@
+#ifndef PCH_H
+#define PCH_H
+
+#include <stdbool.h>
+#include "preprocessor.h"
+
+// Precompiled headers.
+// A PCH captures what preprocessing a header prefix left behind: the macro
+// table, the include guard / #pragma once state of every header it read,
+// and the preprocessed text. Loading one restores that state into a fresh
+// Preprocessor, so a translation unit that starts with the same headers can
+// skip reading and expanding them again.
+//
+// Every header the prefix depended on is recorded by absolute path, with its
+// size, mtime and a content hash, so the PCH works from any directory. A PCH
+// whose headers changed is rejected; one whose headers were only touched (new
+// mtime, same contents) is still used.
+
+#define PCH_MAGIC "KCCPCH\0\0"
+#define PCH_VERSION 2
+
+// Writes the state pp was left in after preprocessing header into text;
+// returns false (after reporting) on I/O errors
+bool pch_write(Preprocessor *pp, const char *header, const char *text, const char *path);
+
+// Restores a PCH into pp and returns the prefix's preprocessed text
+// (heap-allocated), or NULL if the file is unreadable or out of date
+char *pch_load(Preprocessor *pp, const char *path);
+
+#endif // PCH_H
@@ -7,12 +7,67 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include "types.h"
+#include "arena.h"
+
+// ========================================
+// Preprocessing tokens
+// ========================================
+
+typedef enum {
+    PP_EOF,
+    PP_IDENT,
+    PP_NUMBER,
+    PP_CHAR,
+    PP_STRING,
+    PP_PUNCT,
+    PP_OTHER,
+    PP_PLACEMARKER               // Empty argument next to ## (never emitted)
+} PPTokenKind;
+
+#define PP_SPACE_BEFORE  0x01    // Whitespace precedes the token
+#define PP_LINE_START    0x02    // First token on a source line
+#define PP_PAINTED       0x04    // Identifier that must never be expanded again
+#define PP_PASTE_OP      0x08    // ## from a replacement list
+#define PP_STRINGIZE_OP  0x10    // # from a function-like replacement list
+
+// Prosser hide-set: names of the macros a token has already been expanded
+// from. Lists are immutable and shared; nodes live in the expansion arena.
+typedef struct PPHideSet {
+    const char *name;
+    struct PPHideSet *next;
+} PPHideSet;
+
+typedef struct PPToken {
+    const char *text;            // Interned spelling
+    PPHideSet *hideset;
+    int line;
+    int column;                  // Source column, 0 for tokens made by expansion
+    short param;                 // Parameter index inside a replacement list, else -1
+    unsigned char kind;          // PPTokenKind
+    unsigned char flags;
+} PPToken;
+
+typedef struct PPTokenList {
+    PPToken *items;
+    size_t count;
+    size_t capacity;
+} PPTokenList;
 
 // Complete Preprocessor struct definition
 typedef struct Preprocessor {
-    // Macro storage
-    Macro macros[MAX_MACROS];
-    int macro_count;
+    // Macro storage: hash table of macro_capacity slots (power of two),
+    // keyed by interned name; empty slots are NULL
+    Macro **macros;
+    size_t macro_capacity;
+    size_t macro_count;
+    unsigned long macro_generation;  // Bumped by every #define/#undef
+
+    // Expansion state
+    Arena *expand_arena;         // Hide-sets; reset between text runs
+    const char *id_defined;      // Interned names the expander tests for
+    const char *id_va_args;
+    const char *id_line;
+    const char *id_file;
 
     // Conditional compilation stack
     ConditionalState cond_stack[32];
@@ -22,15 +77,30 @@ typedef struct Preprocessor {
     IncludeFile include_stack[MAX_INCLUDE_DEPTH];
     int include_depth;
 
+    // Header search
+    char **include_paths;
+    int include_path_count;
+    int include_path_capacity;
+    struct IncludeCacheEntry **once_files;  // #pragma once / #import'ed so far
+    size_t once_count;
+    size_t once_capacity;
+    struct IncludeCacheEntry **included_files;  // Every header this run read
+    size_t included_count;
+    size_t included_capacity;
+
     // Output buffer
     char *output;
     size_t output_size;
     size_t output_capacity;
+    int output_line;             // Source line the output is currently on
+    const char *output_last;     // Spelling of the last token written
+    size_t output_line_start;    // Offset in output where the current line begins
 
     // Current file tracking
     char *current_file;
     int current_line;
     bool skip_lines;
+    int error_count;
 } Preprocessor;
 
 // Preprocessor creation and destruction
@@ -40,6 +110,24 @@ void preprocessor_destroy(Preprocessor *preprocessor);
 // Main preprocessing functions
 char *preprocessor_process_file(Preprocessor *pp, const char *filename);
 char *preprocessor_process_string(Preprocessor *pp, const char *source, const char *filename);
+char *preprocessor_process_buffer(Preprocessor *pp, const char *source, size_t length,
+                                  const char *filename);
+void preprocessor_run(Preprocessor *pp, const char *source, size_t length);
+
+// Preprocessing tokens
+void preprocessor_lex_tokens(const char *text, size_t length, PPTokenList *out);
+char *preprocessor_spell_tokens(const PPToken *tokens, size_t count);
+void preprocessor_tokens_push(PPTokenList *list, const PPToken *token);
+void preprocessor_tokens_free(PPTokenList *list);
+
+// Header search paths, tried in the order they were added
+void preprocessor_add_include_path(Preprocessor *pp, const char *dir);
+
+// Records a header that must not be entered again (#pragma once, #import)
+void preprocessor_remember_once(Preprocessor *pp, struct IncludeCacheEntry *entry);
+
+// Records a header this run read, once; these are what a PCH depends on
+void preprocessor_remember_included(Preprocessor *pp, struct IncludeCacheEntry *entry);
 
 // Macro management
 bool preprocessor_define_macro(Preprocessor *pp, const char *name, const char *body);
@@ -47,6 +135,11 @@ bool preprocessor_define_function_macro(Preprocessor *pp, const char *name,
                                       const char *params[], int param_count, const char *body);
 bool preprocessor_undefine_macro(Preprocessor *pp, const char *name);
 Macro *preprocessor_find_macro(Preprocessor *pp, const char *name);
+Macro *preprocessor_find_macro_n(Preprocessor *pp, const char *name, size_t length);
+Macro *preprocessor_lookup_macro(Preprocessor *pp, const char *interned);
+bool preprocessor_add_macro(Preprocessor *pp, Macro *macro);
+bool preprocessor_define_tokens(Preprocessor *pp, const PPToken *tokens, size_t count);
+void preprocessor_mark_predefined(Preprocessor *pp);
 bool preprocessor_is_macro_defined(Preprocessor *pp, const char *name);
 
 // Macro expansion
@@ -56,6 +149,7 @@ char *preprocessor_expand_function_macro(Preprocessor *pp, Macro *macro,
 
 // Directive processing
 bool preprocessor_process_directive(Preprocessor *pp, const char *line);
+bool preprocessor_handle_directive_tokens(Preprocessor *pp, const PPToken *tokens, size_t count);
 bool preprocessor_handle_define(Preprocessor *pp, const char *directive);
 bool preprocessor_handle_undef(Preprocessor *pp, const char *directive);
 bool preprocessor_handle_include(Preprocessor *pp, const char *directive);
@@ -75,10 +169,14 @@ bool preprocessor_evaluate_condition(Preprocessor *pp, const char *condition);
 bool preprocessor_should_skip_line(Preprocessor *pp);
 void preprocessor_push_conditional(Preprocessor *pp, ConditionalType type, bool condition);
 bool preprocessor_pop_conditional(Preprocessor *pp);
+long long preprocessor_evaluate_tokens(Preprocessor *pp, const PPToken *tokens, size_t count);
 
 // Utility functions
 char *preprocessor_read_file(const char *filename);
 void preprocessor_append_output(Preprocessor *pp, const char *text);
+void preprocessor_append_output_n(Preprocessor *pp, const char *text, size_t length);
+void preprocessor_reserve_output(Preprocessor *pp, size_t extra);
+char *preprocessor_take_output(Preprocessor *pp);
 char *preprocessor_parse_macro_args(const char *call, char *args[], int max_args);
 char *preprocessor_substitute_params(const char *body, const char *params[],
                                    const char *args[], int param_count);
@@ -0,0 +1,89 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "arena.h"
+#include "ir.h"
+#include "multiarch_codegen.h"
+
+// Global linear-scan register allocation over the SSA IR.
+// Instructions are numbered in block layout order; instruction k reads its
+// operands at position 2k and writes its result at 2k + 1. Each value gets
+// one live interval from its definition to its last use, widened over every
+// block it is live into or out of. Intervals are visited in order of start
+// and given a free general register of the TargetConfig: callee-saved ones
+// (RegisterInfo.preserved) for values live across a call, caller-saved ones
+// otherwise. When every register is taken, whichever interval is next used
+// furthest away is split; its remainder waits in a spill slot and goes back
+// on the worklist from its next use, so it can be reloaded into a different
+// register. Spill slots are shared by values whose lifetimes do not overlap.
+//
+// An interval is kept as a chain of pieces, each in one register or on the
+// stack. Where consecutive pieces differ inside a block the backend emits
+// the moves listed in RegAllocation.moves; along control-flow edges,
+// including phi operands, it emits those from regalloc_edge_moves().
+
+#define REGALLOC_STACK (-1)
+
+typedef struct LiveInterval {
+    int value;                   // Virtual register
+    int start;                   // First position covered
+    int end;                     // Last position covered
+    int reg;                     // Index into TargetConfig.general_regs, or REGALLOC_STACK
+    struct LiveInterval *next;   // Piece split off after this one
+} LiveInterval;
+
+// Where a value is at some position
+typedef struct {
+    int reg;                     // general_regs index, or REGALLOC_STACK
+    int slot;                    // Spill slot when reg is REGALLOC_STACK
+} RegLocation;
+
+// Copies value from one location to another; constant is set instead of
+// from when a phi takes a constant operand
+typedef struct {
+    int position;                // Emitted before the instruction at position / 2
+    int value;
+    const IRInstr *constant;
+    RegLocation from;
+    RegLocation to;
+} RegMove;
+
+typedef struct RegAllocation {
+    Arena *arena;
+    const IRFunction *function;
+    const TargetConfig *target;
+    int *block_start;            // Position of each block's first instruction, by block id
+    int *block_end;              // Position of its terminator
+    uint64_t *live_in;           // Values live into each block, live_words per block
+    int live_words;
+    LiveInterval **intervals;    // First piece of each value, NULL if it is never live
+    int *spill_slot;             // By value; -1 while it never leaves registers
+    int spill_slot_count;        // After coalescing
+    uint64_t used_callee_saved;  // Bit i set when preserved general_regs[i] was handed out
+    RegMove *moves;              // Moves between pieces inside blocks, in position order
+    int move_count;
+} RegAllocation;
+
+// Allocates the general registers of target to the values of function, a
+// renumbered function as left by ir_lower_program(). Registers whose bit is
+// set in reserved are kept out, for the backend's own scratch use.
+RegAllocation *regalloc_function(const IRFunction *function, const TargetConfig *target,
+                                 uint64_t reserved);
+void regalloc_destroy(RegAllocation *alloc);
+
+// Location of value at position; the value must be live there
+RegLocation regalloc_location(const RegAllocation *alloc, int value, int position);
+bool regalloc_same_location(RegLocation a, RegLocation b);
+
+// The moves to run on the edge from pred to succ so that every value live
+// into succ, and every phi of succ, is where succ expects it. They form one
+// parallel copy. Returns a malloc'd array of *count moves, or NULL if none.
+RegMove *regalloc_edge_moves(const RegAllocation *alloc, const IRBlock *pred,
+                             const IRBlock *succ, int *count);
+
+// Text dump of the intervals, for debugging
+void regalloc_print(const RegAllocation *alloc, FILE *out);
+
+#endif // REGALLOC_H
@@ -0,0 +1,48 @@
+#ifndef SH2_ASSEMBLER_H
+#define SH2_ASSEMBLER_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Integrated SH-2 assembler for Saturn builds.
+// Takes the GNU syntax the sh2_* emitters print, encodes it with the
+// sh2_encode_* layer and writes a big-endian ELF32 relocatable object or a
+// flat binary, so building does not need sh-elf-as.
+//
+// The emitters' text is the interface on purpose: it is what -S shows, and
+// hand-written .s files take the same path. Relaxation and literal pools
+// need the whole section as a list before anything is encoded, so parsing
+// a line costs little next to the layout.
+//
+// Instructions are kept as a list until the end so that:
+// - conditional branches (bt/bf) whose target is out of the 8-bit range are
+//   relaxed into an inverted branch around a bra
+// - literals are pooled: mov.l/mov.w from a label the source never defines
+//   gets its value from the emitters' naming (.L_const_<n> and .L_frame_<n>
+//   hold n, .L_<name> the address of _<name>), and pools are placed after
+//   the delay slot of the next unconditional branch, at .pool/.ltorg, or
+//   behind a bra when the first reference would otherwise go out of reach
+
+typedef struct SH2Assembler SH2Assembler;
+
+SH2Assembler *sh2_asm_create(void);
+void sh2_asm_destroy(SH2Assembler *as);
+
+// Assembles one or more newline-separated lines, such as the text of the
+// AsmBuffer the sh2_* emitters filled; errors are reported with the line
+// number and make the writers fail
+void sh2_asm_source(SH2Assembler *as, const char *text, size_t length);
+
+// Lays out the sections and writes an ELF32 relocatable object
+bool sh2_asm_write_object(SH2Assembler *as, const char *path);
+
+// Places the allocated sections back to back from base_address (code, then
+// read-only data, then data; .bss only receives addresses) and writes them
+// as a flat image; every referenced symbol must be defined
+bool sh2_asm_write_binary(SH2Assembler *as, const char *path, uint32_t base_address);
+
+int sh2_asm_error_count(const SH2Assembler *as);
+
+#endif // SH2_ASSEMBLER_H
@@ -5,6 +5,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include "asm_buffer.h"
 
 typedef struct {
     int reg;
@@ -12,30 +13,30 @@ typedef struct {
     int is_memory;
 } SH2Operand;
 
-void sh2_emit_prologue(FILE *out, const char *func_name, int frame_size);
-void sh2_emit_epilogue(FILE *out);
-void sh2_emit_load_imm(FILE *out, int reg, int32_t value);
-void sh2_emit_mov(FILE *out, int dst, int src);
-void sh2_emit_add(FILE *out, int dst, int src);
-void sh2_emit_sub(FILE *out, int dst, int src);
-void sh2_emit_mul(FILE *out, int dst, int src);
-void sh2_emit_div(FILE *out, int dst, int src);
-void sh2_emit_and(FILE *out, int dst, int src);
-void sh2_emit_or(FILE *out, int dst, int src);
-void sh2_emit_xor(FILE *out, int dst, int src);
-void sh2_emit_not(FILE *out, int reg);
-void sh2_emit_neg(FILE *out, int reg);
-void sh2_emit_load_mem(FILE *out, int dst, int base, int offset);
-void sh2_emit_store_mem(FILE *out, int src, int base, int offset);
-void sh2_emit_push(FILE *out, int reg);
-void sh2_emit_pop(FILE *out, int reg);
-void sh2_emit_call(FILE *out, const char *func_name);
-void sh2_emit_return(FILE *out);
-void sh2_emit_branch(FILE *out, const char *label);
-void sh2_emit_branch_if_zero(FILE *out, int reg, const char *label);
-void sh2_emit_branch_if_not_zero(FILE *out, int reg, const char *label);
-void sh2_emit_compare(FILE *out, int reg1, int reg2);
-void sh2_emit_label(FILE *out, const char *label);
-void sh2_emit_comment(FILE *out, const char *comment);
+void sh2_emit_prologue(AsmBuffer *out, const char *func_name, int frame_size);
+void sh2_emit_epilogue(AsmBuffer *out);
+void sh2_emit_load_imm(AsmBuffer *out, int reg, int32_t value);
+void sh2_emit_mov(AsmBuffer *out, int dst, int src);
+void sh2_emit_add(AsmBuffer *out, int dst, int src);
+void sh2_emit_sub(AsmBuffer *out, int dst, int src);
+void sh2_emit_mul(AsmBuffer *out, int dst, int src);
+void sh2_emit_div(AsmBuffer *out, int dst, int src);
+void sh2_emit_and(AsmBuffer *out, int dst, int src);
+void sh2_emit_or(AsmBuffer *out, int dst, int src);
+void sh2_emit_xor(AsmBuffer *out, int dst, int src);
+void sh2_emit_not(AsmBuffer *out, int reg);
+void sh2_emit_neg(AsmBuffer *out, int reg);
+void sh2_emit_load_mem(AsmBuffer *out, int dst, int base, int offset);
+void sh2_emit_store_mem(AsmBuffer *out, int src, int base, int offset);
+void sh2_emit_push(AsmBuffer *out, int reg);
+void sh2_emit_pop(AsmBuffer *out, int reg);
+void sh2_emit_call(AsmBuffer *out, const char *func_name);
+void sh2_emit_return(AsmBuffer *out);
+void sh2_emit_branch(AsmBuffer *out, const char *label);
+void sh2_emit_branch_if_zero(AsmBuffer *out, int reg, const char *label);
+void sh2_emit_branch_if_not_zero(AsmBuffer *out, int reg, const char *label);
+void sh2_emit_compare(AsmBuffer *out, int reg1, int reg2);
+void sh2_emit_label(AsmBuffer *out, const char *label);
+void sh2_emit_comment(AsmBuffer *out, const char *comment);
 
 #endif // SH2_CODEGEN_H
\ No newline at end of file
@@ -7,255 +7,256 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "asm_buffer.h"
 
 // ============================================================================
 // Data Transfer Instructions
 // ============================================================================
 
 // MOV - Move data
-void sh2_mov_reg_reg(FILE *out, int dst, int src);
-void sh2_mov_imm(FILE *out, int reg, int8_t imm);
-void sh2_mov_w_imm(FILE *out, int reg, int16_t imm);
-void sh2_mov_l_imm(FILE *out, int reg, int32_t imm);
+void sh2_mov_reg_reg(AsmBuffer *out, int dst, int src);
+void sh2_mov_imm(AsmBuffer *out, int reg, int8_t imm);
+void sh2_mov_w_imm(AsmBuffer *out, int reg, int16_t imm);
+void sh2_mov_l_imm(AsmBuffer *out, int reg, int32_t imm);
 
 // MOV with displacement
-void sh2_mov_l_disp_reg(FILE *out, int dst, int disp, int src);  // mov.l @(disp,Rn),Rm
-void sh2_mov_l_reg_disp(FILE *out, int src, int disp, int dst);  // mov.l Rm,@(disp,Rn)
-void sh2_mov_w_disp_reg(FILE *out, int dst, int disp, int src);  // mov.w @(disp,Rn),Rm
-void sh2_mov_w_reg_disp(FILE *out, int src, int disp, int dst);  // mov.w Rm,@(disp,Rn)
-void sh2_mov_b_disp_reg(FILE *out, int dst, int disp, int src);  // mov.b @(disp,Rn),Rm
-void sh2_mov_b_reg_disp(FILE *out, int src, int disp, int dst);  // mov.b Rm,@(disp,Rn)
+void sh2_mov_l_disp_reg(AsmBuffer *out, int dst, int disp, int src);  // mov.l @(disp,Rn),Rm
+void sh2_mov_l_reg_disp(AsmBuffer *out, int src, int disp, int dst);  // mov.l Rm,@(disp,Rn)
+void sh2_mov_w_disp_reg(AsmBuffer *out, int dst, int disp, int src);  // mov.w @(disp,Rn),Rm
+void sh2_mov_w_reg_disp(AsmBuffer *out, int src, int disp, int dst);  // mov.w Rm,@(disp,Rn)
+void sh2_mov_b_disp_reg(AsmBuffer *out, int dst, int disp, int src);  // mov.b @(disp,Rn),Rm
+void sh2_mov_b_reg_disp(AsmBuffer *out, int src, int disp, int dst);  // mov.b Rm,@(disp,Rn)
 
 // MOV with indirect addressing
-void sh2_mov_l_indir(FILE *out, int dst, int src);     // mov.l @Rm,Rn
-void sh2_mov_l_indir_store(FILE *out, int src, int dst); // mov.l Rm,@Rn
-void sh2_mov_w_indir(FILE *out, int dst, int src);     // mov.w @Rm,Rn
-void sh2_mov_w_indir_store(FILE *out, int src, int dst); // mov.w Rm,@Rn
-void sh2_mov_b_indir(FILE *out, int dst, int src);     // mov.b @Rm,Rn
-void sh2_mov_b_indir_store(FILE *out, int src, int dst); // mov.b Rm,@Rn
+void sh2_mov_l_indir(AsmBuffer *out, int dst, int src);     // mov.l @Rm,Rn
+void sh2_mov_l_indir_store(AsmBuffer *out, int src, int dst); // mov.l Rm,@Rn
+void sh2_mov_w_indir(AsmBuffer *out, int dst, int src);     // mov.w @Rm,Rn
+void sh2_mov_w_indir_store(AsmBuffer *out, int src, int dst); // mov.w Rm,@Rn
+void sh2_mov_b_indir(AsmBuffer *out, int dst, int src);     // mov.b @Rm,Rn
+void sh2_mov_b_indir_store(AsmBuffer *out, int src, int dst); // mov.b Rm,@Rn
 
 // MOV with post-increment
-void sh2_mov_l_post_inc(FILE *out, int dst, int src);  // mov.l @Rm+,Rn
-void sh2_mov_w_post_inc(FILE *out, int dst, int src);  // mov.w @Rm+,Rn
-void sh2_mov_b_post_inc(FILE *out, int dst, int src);  // mov.b @Rm+,Rn
+void sh2_mov_l_post_inc(AsmBuffer *out, int dst, int src);  // mov.l @Rm+,Rn
+void sh2_mov_w_post_inc(AsmBuffer *out, int dst, int src);  // mov.w @Rm+,Rn
+void sh2_mov_b_post_inc(AsmBuffer *out, int dst, int src);  // mov.b @Rm+,Rn
 
 // MOV with pre-decrement
-void sh2_mov_l_pre_dec(FILE *out, int src, int dst);   // mov.l Rm,@-Rn
-void sh2_mov_w_pre_dec(FILE *out, int src, int dst);   // mov.w Rm,@-Rn
-void sh2_mov_b_pre_dec(FILE *out, int src, int dst);   // mov.b Rm,@-Rn
+void sh2_mov_l_pre_dec(AsmBuffer *out, int src, int dst);   // mov.l Rm,@-Rn
+void sh2_mov_w_pre_dec(AsmBuffer *out, int src, int dst);   // mov.w Rm,@-Rn
+void sh2_mov_b_pre_dec(AsmBuffer *out, int src, int dst);   // mov.b Rm,@-Rn
 
 // MOV with indexed addressing (R0-based)
-void sh2_mov_l_r0_indexed(FILE *out, int dst, int src); // mov.l @(R0,Rm),Rn
-void sh2_mov_l_r0_indexed_store(FILE *out, int src, int dst); // mov.l Rm,@(R0,Rn)
-void sh2_mov_w_r0_indexed(FILE *out, int dst, int src); // mov.w @(R0,Rm),Rn
-void sh2_mov_w_r0_indexed_store(FILE *out, int src, int dst); // mov.w Rm,@(R0,Rn)
-void sh2_mov_b_r0_indexed(FILE *out, int dst, int src); // mov.b @(R0,Rm),Rn
-void sh2_mov_b_r0_indexed_store(FILE *out, int src, int dst); // mov.b Rm,@(R0,Rn)
+void sh2_mov_l_r0_indexed(AsmBuffer *out, int dst, int src); // mov.l @(R0,Rm),Rn
+void sh2_mov_l_r0_indexed_store(AsmBuffer *out, int src, int dst); // mov.l Rm,@(R0,Rn)
+void sh2_mov_w_r0_indexed(AsmBuffer *out, int dst, int src); // mov.w @(R0,Rm),Rn
+void sh2_mov_w_r0_indexed_store(AsmBuffer *out, int src, int dst); // mov.w Rm,@(R0,Rn)
+void sh2_mov_b_r0_indexed(AsmBuffer *out, int dst, int src); // mov.b @(R0,Rm),Rn
+void sh2_mov_b_r0_indexed_store(AsmBuffer *out, int src, int dst); // mov.b Rm,@(R0,Rn)
 
 // MOV with GBR
-void sh2_mov_l_gbr_disp(FILE *out, int reg, int disp);  // mov.l @(disp,GBR),R0
-void sh2_mov_l_gbr_store(FILE *out, int reg, int disp); // mov.l R0,@(disp,GBR)
-void sh2_mov_w_gbr_disp(FILE *out, int reg, int disp);  // mov.w @(disp,GBR),R0
-void sh2_mov_w_gbr_store(FILE *out, int reg, int disp); // mov.w R0,@(disp,GBR)
-void sh2_mov_b_gbr_disp(FILE *out, int reg, int disp);  // mov.b @(disp,GBR),R0
-void sh2_mov_b_gbr_store(FILE *out, int reg, int disp); // mov.b R0,@(disp,GBR)
+void sh2_mov_l_gbr_disp(AsmBuffer *out, int reg, int disp);  // mov.l @(disp,GBR),R0
+void sh2_mov_l_gbr_store(AsmBuffer *out, int reg, int disp); // mov.l R0,@(disp,GBR)
+void sh2_mov_w_gbr_disp(AsmBuffer *out, int reg, int disp);  // mov.w @(disp,GBR),R0
+void sh2_mov_w_gbr_store(AsmBuffer *out, int reg, int disp); // mov.w R0,@(disp,GBR)
+void sh2_mov_b_gbr_disp(AsmBuffer *out, int reg, int disp);  // mov.b @(disp,GBR),R0
+void sh2_mov_b_gbr_store(AsmBuffer *out, int reg, int disp); // mov.b R0,@(disp,GBR)
 
 // MOVA - Move effective address
-void sh2_mova(FILE *out, int disp);  // mova @(disp,PC),R0
+void sh2_mova(AsmBuffer *out, int disp);  // mova @(disp,PC),R0
 
 // MOVT - Move T bit to register
-void sh2_movt(FILE *out, int reg);
+void sh2_movt(AsmBuffer *out, int reg);
 
 // SWAP - Swap register halves
-void sh2_swap_b(FILE *out, int dst, int src);  // swap.b
-void sh2_swap_w(FILE *out, int dst, int src);  // swap.w
+void sh2_swap_b(AsmBuffer *out, int dst, int src);  // swap.b
+void sh2_swap_w(AsmBuffer *out, int dst, int src);  // swap.w
 
 // XTRCT - Extract
-void sh2_xtrct(FILE *out, int dst, int src);
+void sh2_xtrct(AsmBuffer *out, int dst, int src);
 
 // ============================================================================
 // Arithmetic Instructions
 // ============================================================================
 
 // ADD - Addition
-void sh2_add(FILE *out, int dst, int src);           // add Rm,Rn
-void sh2_add_imm(FILE *out, int reg, int8_t imm);    // add #imm,Rn
-void sh2_addc(FILE *out, int dst, int src);          // addc Rm,Rn (with carry)
-void sh2_addv(FILE *out, int dst, int src);          // addv Rm,Rn (with overflow)
+void sh2_add(AsmBuffer *out, int dst, int src);           // add Rm,Rn
+void sh2_add_imm(AsmBuffer *out, int reg, int8_t imm);    // add #imm,Rn
+void sh2_addc(AsmBuffer *out, int dst, int src);          // addc Rm,Rn (with carry)
+void sh2_addv(AsmBuffer *out, int dst, int src);          // addv Rm,Rn (with overflow)
 
 // SUB - Subtraction
-void sh2_sub(FILE *out, int dst, int src);           // sub Rm,Rn
-void sh2_subc(FILE *out, int dst, int src);          // subc Rm,Rn (with borrow)
-void sh2_subv(FILE *out, int dst, int src);          // subv Rm,Rn (with overflow)
+void sh2_sub(AsmBuffer *out, int dst, int src);           // sub Rm,Rn
+void sh2_subc(AsmBuffer *out, int dst, int src);          // subc Rm,Rn (with borrow)
+void sh2_subv(AsmBuffer *out, int dst, int src);          // subv Rm,Rn (with overflow)
 
 // NEG - Negate
-void sh2_neg(FILE *out, int dst, int src);           // neg Rm,Rn
-void sh2_negc(FILE *out, int dst, int src);          // negc Rm,Rn (with borrow)
+void sh2_neg(AsmBuffer *out, int dst, int src);           // neg Rm,Rn
+void sh2_negc(AsmBuffer *out, int dst, int src);          // negc Rm,Rn (with borrow)
 
 // Multiply and Accumulate
-void sh2_mac_l(FILE *out, int src1, int src2);       // mac.l @Rm+,@Rn+
-void sh2_mac_w(FILE *out, int src1, int src2);       // mac.w @Rm+,@Rn+
+void sh2_mac_l(AsmBuffer *out, int src1, int src2);       // mac.l @Rm+,@Rn+
+void sh2_mac_w(AsmBuffer *out, int src1, int src2);       // mac.w @Rm+,@Rn+
 
 // Multiply
-void sh2_mul_l(FILE *out, int src1, int src2);       // mul.l Rm,Rn
-void sh2_mulu_w(FILE *out, int src1, int src2);      // mulu.w Rm,Rn (unsigned)
-void sh2_muls_w(FILE *out, int src1, int src2);      // muls.w Rm,Rn (signed)
+void sh2_mul_l(AsmBuffer *out, int src1, int src2);       // mul.l Rm,Rn
+void sh2_mulu_w(AsmBuffer *out, int src1, int src2);      // mulu.w Rm,Rn (unsigned)
+void sh2_muls_w(AsmBuffer *out, int src1, int src2);      // muls.w Rm,Rn (signed)
 
 // Divide
-void sh2_div0s(FILE *out, int src1, int src2);       // div0s Rm,Rn
-void sh2_div0u(FILE *out);                           // div0u
-void sh2_div1(FILE *out, int src1, int src2);        // div1 Rm,Rn
+void sh2_div0s(AsmBuffer *out, int src1, int src2);       // div0s Rm,Rn
+void sh2_div0u(AsmBuffer *out);                           // div0u
+void sh2_div1(AsmBuffer *out, int src1, int src2);        // div1 Rm,Rn
 
 // Multiply and accumulate special
-void sh2_dmulu_l(FILE *out, int src1, int src2);     // dmulu.l Rm,Rn (double-length unsigned)
-void sh2_dmuls_l(FILE *out, int src1, int src2);     // dmuls.l Rm,Rn (double-length signed)
+void sh2_dmulu_l(AsmBuffer *out, int src1, int src2);     // dmulu.l Rm,Rn (double-length unsigned)
+void sh2_dmuls_l(AsmBuffer *out, int src1, int src2);     // dmuls.l Rm,Rn (double-length signed)
 
 // Decimal adjust
-void sh2_dt(FILE *out, int reg);                     // dt Rn (decrement and test)
+void sh2_dt(AsmBuffer *out, int reg);                     // dt Rn (decrement and test)
 
 // ============================================================================
 // Logic Instructions
 // ============================================================================
 
 // AND
-void sh2_and(FILE *out, int dst, int src);           // and Rm,Rn
-void sh2_and_imm(FILE *out, uint8_t imm);            // and #imm,R0
-void sh2_and_b_imm(FILE *out, uint8_t imm);          // and.b #imm,@(R0,GBR)
+void sh2_and(AsmBuffer *out, int dst, int src);           // and Rm,Rn
+void sh2_and_imm(AsmBuffer *out, uint8_t imm);            // and #imm,R0
+void sh2_and_b_imm(AsmBuffer *out, uint8_t imm);          // and.b #imm,@(R0,GBR)
 
 // OR
-void sh2_or(FILE *out, int dst, int src);            // or Rm,Rn
-void sh2_or_imm(FILE *out, uint8_t imm);             // or #imm,R0
-void sh2_or_b_imm(FILE *out, uint8_t imm);           // or.b #imm,@(R0,GBR)
+void sh2_or(AsmBuffer *out, int dst, int src);            // or Rm,Rn
+void sh2_or_imm(AsmBuffer *out, uint8_t imm);             // or #imm,R0
+void sh2_or_b_imm(AsmBuffer *out, uint8_t imm);           // or.b #imm,@(R0,GBR)
 
 // XOR
-void sh2_xor(FILE *out, int dst, int src);           // xor Rm,Rn
-void sh2_xor_imm(FILE *out, uint8_t imm);            // xor #imm,R0
-void sh2_xor_b_imm(FILE *out, uint8_t imm);          // xor.b #imm,@(R0,GBR)
+void sh2_xor(AsmBuffer *out, int dst, int src);           // xor Rm,Rn
+void sh2_xor_imm(AsmBuffer *out, uint8_t imm);            // xor #imm,R0
+void sh2_xor_b_imm(AsmBuffer *out, uint8_t imm);          // xor.b #imm,@(R0,GBR)
 
 // NOT
-void sh2_not(FILE *out, int dst, int src);           // not Rm,Rn
+void sh2_not(AsmBuffer *out, int dst, int src);           // not Rm,Rn
 
 // TEST
-void sh2_tst(FILE *out, int src1, int src2);         // tst Rm,Rn
-void sh2_tst_imm(FILE *out, uint8_t imm);            // tst #imm,R0
-void sh2_tst_b_imm(FILE *out, uint8_t imm);          // tst.b #imm,@(R0,GBR)
+void sh2_tst(AsmBuffer *out, int src1, int src2);         // tst Rm,Rn
+void sh2_tst_imm(AsmBuffer *out, uint8_t imm);            // tst #imm,R0
+void sh2_tst_b_imm(AsmBuffer *out, uint8_t imm);          // tst.b #imm,@(R0,GBR)
 
 // ============================================================================
 // Shift Instructions
 // ============================================================================
 
 // Shift Logical
-void sh2_shal(FILE *out, int reg);                   // shal Rn (shift arithmetic left)
-void sh2_shar(FILE *out, int reg);                   // shar Rn (shift arithmetic right)
-void sh2_shll(FILE *out, int reg);                   // shll Rn (shift logical left)
-void sh2_shlr(FILE *out, int reg);                   // shlr Rn (shift logical right)
+void sh2_shal(AsmBuffer *out, int reg);                   // shal Rn (shift arithmetic left)
+void sh2_shar(AsmBuffer *out, int reg);                   // shar Rn (shift arithmetic right)
+void sh2_shll(AsmBuffer *out, int reg);                   // shll Rn (shift logical left)
+void sh2_shlr(AsmBuffer *out, int reg);                   // shlr Rn (shift logical right)
 
 // Shift Logical by 2
-void sh2_shll2(FILE *out, int reg);                  // shll2 Rn
-void sh2_shlr2(FILE *out, int reg);                  // shlr2 Rn
+void sh2_shll2(AsmBuffer *out, int reg);                  // shll2 Rn
+void sh2_shlr2(AsmBuffer *out, int reg);                  // shlr2 Rn
 
 // Shift Logical by 8
-void sh2_shll8(FILE *out, int reg);                  // shll8 Rn
-void sh2_shlr8(FILE *out, int reg);                  // shlr8 Rn
+void sh2_shll8(AsmBuffer *out, int reg);                  // shll8 Rn
+void sh2_shlr8(AsmBuffer *out, int reg);                  // shlr8 Rn
 
 // Shift Logical by 16
-void sh2_shll16(FILE *out, int reg);                 // shll16 Rn
-void sh2_shlr16(FILE *out, int reg);                 // shlr16 Rn
+void sh2_shll16(AsmBuffer *out, int reg);                 // shll16 Rn
+void sh2_shlr16(AsmBuffer *out, int reg);                 // shlr16 Rn
 
 // Rotate
-void sh2_rotl(FILE *out, int reg);                   // rotl Rn
-void sh2_rotr(FILE *out, int reg);                   // rotr Rn
-void sh2_rotcl(FILE *out, int reg);                  // rotcl Rn (with carry)
-void sh2_rotcr(FILE *out, int reg);                  // rotcr Rn (with carry)
+void sh2_rotl(AsmBuffer *out, int reg);                   // rotl Rn
+void sh2_rotr(AsmBuffer *out, int reg);                   // rotr Rn
+void sh2_rotcl(AsmBuffer *out, int reg);                  // rotcl Rn (with carry)
+void sh2_rotcr(AsmBuffer *out, int reg);                  // rotcr Rn (with carry)
 
 // ============================================================================
 // Branch Instructions
 // ============================================================================
 
 // Unconditional branches
-void sh2_bra(FILE *out, const char *label);          // bra label
-void sh2_braf(FILE *out, int reg);                   // braf Rn
-void sh2_bsr(FILE *out, const char *label);          // bsr label (branch to subroutine)
-void sh2_bsrf(FILE *out, int reg);                   // bsrf Rn
+void sh2_bra(AsmBuffer *out, const char *label);          // bra label
+void sh2_braf(AsmBuffer *out, int reg);                   // braf Rn
+void sh2_bsr(AsmBuffer *out, const char *label);          // bsr label (branch to subroutine)
+void sh2_bsrf(AsmBuffer *out, int reg);                   // bsrf Rn
 
 // Conditional branches (based on T bit)
-void sh2_bt(FILE *out, const char *label);           // bt label (branch if true)
-void sh2_bf(FILE *out, const char *label);           // bf label (branch if false)
-void sh2_bt_s(FILE *out, const char *label);         // bt/s label (with delay slot)
-void sh2_bf_s(FILE *out, const char *label);         // bf/s label (with delay slot)
+void sh2_bt(AsmBuffer *out, const char *label);           // bt label (branch if true)
+void sh2_bf(AsmBuffer *out, const char *label);           // bf label (branch if false)
+void sh2_bt_s(AsmBuffer *out, const char *label);         // bt/s label (with delay slot)
+void sh2_bf_s(AsmBuffer *out, const char *label);         // bf/s label (with delay slot)
 
 // Jump
-void sh2_jmp(FILE *out, int reg);                    // jmp @Rn
-void sh2_jsr(FILE *out, int reg);                    // jsr @Rn (jump to subroutine)
+void sh2_jmp(AsmBuffer *out, int reg);                    // jmp @Rn
+void sh2_jsr(AsmBuffer *out, int reg);                    // jsr @Rn (jump to subroutine)
 
 // Return
-void sh2_rts(FILE *out);                             // rts (return from subroutine)
-void sh2_rte(FILE *out);                             // rte (return from exception)
+void sh2_rts(AsmBuffer *out);                             // rts (return from subroutine)
+void sh2_rte(AsmBuffer *out);                             // rte (return from exception)
 
 // ============================================================================
 // Compare Instructions
 // ============================================================================
 
 // Compare/Conditional set T bit
-void sh2_cmp_eq(FILE *out, int src1, int src2);      // cmp/eq Rm,Rn
-void sh2_cmp_hs(FILE *out, int src1, int src2);      // cmp/hs Rm,Rn (higher or same, unsigned)
-void sh2_cmp_ge(FILE *out, int src1, int src2);      // cmp/ge Rm,Rn (greater or equal, signed)
-void sh2_cmp_hi(FILE *out, int src1, int src2);      // cmp/hi Rm,Rn (higher, unsigned)
-void sh2_cmp_gt(FILE *out, int src1, int src2);      // cmp/gt Rm,Rn (greater than, signed)
-void sh2_cmp_pz(FILE *out, int reg);                 // cmp/pz Rn (positive or zero)
-void sh2_cmp_pl(FILE *out, int reg);                 // cmp/pl Rn (positive)
-void sh2_cmp_str(FILE *out, int src1, int src2);     // cmp/str Rm,Rn (string compare)
+void sh2_cmp_eq(AsmBuffer *out, int src1, int src2);      // cmp/eq Rm,Rn
+void sh2_cmp_hs(AsmBuffer *out, int src1, int src2);      // cmp/hs Rm,Rn (higher or same, unsigned)
+void sh2_cmp_ge(AsmBuffer *out, int src1, int src2);      // cmp/ge Rm,Rn (greater or equal, signed)
+void sh2_cmp_hi(AsmBuffer *out, int src1, int src2);      // cmp/hi Rm,Rn (higher, unsigned)
+void sh2_cmp_gt(AsmBuffer *out, int src1, int src2);      // cmp/gt Rm,Rn (greater than, signed)
+void sh2_cmp_pz(AsmBuffer *out, int reg);                 // cmp/pz Rn (positive or zero)
+void sh2_cmp_pl(AsmBuffer *out, int reg);                 // cmp/pl Rn (positive)
+void sh2_cmp_str(AsmBuffer *out, int src1, int src2);     // cmp/str Rm,Rn (string compare)
 
 // Compare immediate
-void sh2_cmp_eq_imm(FILE *out, int8_t imm);          // cmp/eq #imm,R0
+void sh2_cmp_eq_imm(AsmBuffer *out, int8_t imm);          // cmp/eq #imm,R0
 
 // ============================================================================
 // System Control Instructions
 // ============================================================================
 
 // Status Register Control
-void sh2_ldc(FILE *out, int src, const char *ctrl);  // ldc Rm,SR/GBR/VBR
-void sh2_ldc_l(FILE *out, int src, const char *ctrl);// ldc.l @Rm+,SR/GBR/VBR
-void sh2_stc(FILE *out, const char *ctrl, int dst);  // stc SR/GBR/VBR,Rn
-void sh2_stc_l(FILE *out, const char *ctrl, int dst);// stc.l SR/GBR/VBR,@-Rn
+void sh2_ldc(AsmBuffer *out, int src, const char *ctrl);  // ldc Rm,SR/GBR/VBR
+void sh2_ldc_l(AsmBuffer *out, int src, const char *ctrl);// ldc.l @Rm+,SR/GBR/VBR
+void sh2_stc(AsmBuffer *out, const char *ctrl, int dst);  // stc SR/GBR/VBR,Rn
+void sh2_stc_l(AsmBuffer *out, const char *ctrl, int dst);// stc.l SR/GBR/VBR,@-Rn
 
 // MAC Register Control
-void sh2_lds(FILE *out, int src, const char *ctrl);  // lds Rm,MACH/MACL/PR
-void sh2_lds_l(FILE *out, int src, const char *ctrl);// lds.l @Rm+,MACH/MACL/PR
-void sh2_sts(FILE *out, const char *ctrl, int dst);  // sts MACH/MACL/PR,Rn
-void sh2_sts_l(FILE *out, const char *ctrl, int dst);// sts.l MACH/MACL/PR,@-Rn
+void sh2_lds(AsmBuffer *out, int src, const char *ctrl);  // lds Rm,MACH/MACL/PR
+void sh2_lds_l(AsmBuffer *out, int src, const char *ctrl);// lds.l @Rm+,MACH/MACL/PR
+void sh2_sts(AsmBuffer *out, const char *ctrl, int dst);  // sts MACH/MACL/PR,Rn
+void sh2_sts_l(AsmBuffer *out, const char *ctrl, int dst);// sts.l MACH/MACL/PR,@-Rn
 
 // Special
-void sh2_clrmac(FILE *out);                          // clrmac (clear MAC register)
-void sh2_clrt(FILE *out);                            // clrt (clear T bit)
-void sh2_sett(FILE *out);                            // sett (set T bit)
-void sh2_ldtlb(FILE *out);                           // ldtlb (load PTEH/PTEL into TLB)
-void sh2_nop(FILE *out);                             // nop
-void sh2_rte_nop(FILE *out);                         // rte with delay slot nop
-void sh2_sleep(FILE *out);                           // sleep
+void sh2_clrmac(AsmBuffer *out);                          // clrmac (clear MAC register)
+void sh2_clrt(AsmBuffer *out);                            // clrt (clear T bit)
+void sh2_sett(AsmBuffer *out);                            // sett (set T bit)
+void sh2_ldtlb(AsmBuffer *out);                           // ldtlb (load PTEH/PTEL into TLB)
+void sh2_nop(AsmBuffer *out);                             // nop
+void sh2_rte_nop(AsmBuffer *out);                         // rte with delay slot nop
+void sh2_sleep(AsmBuffer *out);                           // sleep
 
 // ============================================================================
 // Sign/Zero Extension
 // ============================================================================
 
-void sh2_exts_b(FILE *out, int dst, int src);        // exts.b Rm,Rn (sign extend byte)
-void sh2_exts_w(FILE *out, int dst, int src);        // exts.w Rm,Rn (sign extend word)
-void sh2_extu_b(FILE *out, int dst, int src);        // extu.b Rm,Rn (zero extend byte)
-void sh2_extu_w(FILE *out, int dst, int src);        // extu.w Rm,Rn (zero extend word)
+void sh2_exts_b(AsmBuffer *out, int dst, int src);        // exts.b Rm,Rn (sign extend byte)
+void sh2_exts_w(AsmBuffer *out, int dst, int src);        // exts.w Rm,Rn (sign extend word)
+void sh2_extu_b(AsmBuffer *out, int dst, int src);        // extu.b Rm,Rn (zero extend byte)
+void sh2_extu_w(AsmBuffer *out, int dst, int src);        // extu.w Rm,Rn (zero extend word)
 
 // ============================================================================
 // Pseudo Instructions (for convenience)
 // ============================================================================
 
-void sh2_push(FILE *out, int reg);                   // push Rn
-void sh2_pop(FILE *out, int reg);                    // pop Rn
-void sh2_call(FILE *out, const char *label);         // call label
-void sh2_ret(FILE *out);                             // ret
-void sh2_label(FILE *out, const char *label);        // label:
-void sh2_comment(FILE *out, const char *comment);    // ! comment
+void sh2_push(AsmBuffer *out, int reg);                   // push Rn
+void sh2_pop(AsmBuffer *out, int reg);                    // pop Rn
+void sh2_call(AsmBuffer *out, const char *label);         // call label
+void sh2_ret(AsmBuffer *out);                             // ret
+void sh2_label(AsmBuffer *out, const char *label);        // label:
+void sh2_comment(AsmBuffer *out, const char *comment);    // ! comment
 
 // Load 32-bit immediate (pseudo-instruction using literal pool)
-void sh2_load_imm32(FILE *out, int reg, uint32_t value);
+void sh2_load_imm32(AsmBuffer *out, int reg, uint32_t value);
 
 // ============================================================================
 // Literal Pool Management
@@ -277,7 +278,7 @@ typedef struct {
 LiteralPool* sh2_literal_pool_create(void);
 void sh2_literal_pool_destroy(LiteralPool *pool);
 const char* sh2_literal_pool_add(LiteralPool *pool, uint32_t value);
-void sh2_literal_pool_emit(LiteralPool *pool, FILE *out);
+void sh2_literal_pool_emit(LiteralPool *pool, AsmBuffer *out);
 void sh2_literal_pool_clear(LiteralPool *pool);
 
 // ============================================================================
@@ -290,9 +291,289 @@ typedef struct {
     uint8_t size;  // in bytes
 } SH2Instruction;
 
+// Base opcodes; the operand fields are zero. n is bits 8-11, m bits 4-7,
+// 8-bit immediates/displacements bits 0-7 and bra/bsr displacements 0-11.
+#define SH2_OP_MOV_RR        0x6003
+#define SH2_OP_MOV_IMM       0xE000
+#define SH2_OP_MOV_W_PC      0x9000
+#define SH2_OP_MOV_L_PC      0xD000
+#define SH2_OP_MOV_B_STORE   0x2000
+#define SH2_OP_MOV_W_STORE   0x2001
+#define SH2_OP_MOV_L_STORE   0x2002
+#define SH2_OP_MOV_B_LOAD    0x6000
+#define SH2_OP_MOV_W_LOAD    0x6001
+#define SH2_OP_MOV_L_LOAD    0x6002
+#define SH2_OP_MOV_B_PREDEC  0x2004
+#define SH2_OP_MOV_W_PREDEC  0x2005
+#define SH2_OP_MOV_L_PREDEC  0x2006
+#define SH2_OP_MOV_B_POSTINC 0x6004
+#define SH2_OP_MOV_W_POSTINC 0x6005
+#define SH2_OP_MOV_L_POSTINC 0x6006
+#define SH2_OP_MOV_B_R0_DISP_STORE 0x8000  // mov.b R0,@(disp,Rn)
+#define SH2_OP_MOV_W_R0_DISP_STORE 0x8100
+#define SH2_OP_MOV_L_DISP_STORE    0x1000  // mov.l Rm,@(disp,Rn)
+#define SH2_OP_MOV_B_DISP_R0_LOAD  0x8400  // mov.b @(disp,Rm),R0
+#define SH2_OP_MOV_W_DISP_R0_LOAD  0x8500
+#define SH2_OP_MOV_L_DISP_LOAD     0x5000  // mov.l @(disp,Rm),Rn
+#define SH2_OP_MOV_B_R0_STORE 0x0004       // mov.b Rm,@(R0,Rn)
+#define SH2_OP_MOV_W_R0_STORE 0x0005
+#define SH2_OP_MOV_L_R0_STORE 0x0006
+#define SH2_OP_MOV_B_R0_LOAD  0x000C       // mov.b @(R0,Rm),Rn
+#define SH2_OP_MOV_W_R0_LOAD  0x000D
+#define SH2_OP_MOV_L_R0_LOAD  0x000E
+#define SH2_OP_MOV_B_GBR_STORE 0xC000
+#define SH2_OP_MOV_W_GBR_STORE 0xC100
+#define SH2_OP_MOV_L_GBR_STORE 0xC200
+#define SH2_OP_MOV_B_GBR_LOAD  0xC400
+#define SH2_OP_MOV_W_GBR_LOAD  0xC500
+#define SH2_OP_MOV_L_GBR_LOAD  0xC600
+#define SH2_OP_MOVA     0xC700
+#define SH2_OP_MOVT     0x0029
+#define SH2_OP_SWAP_B   0x6008
+#define SH2_OP_SWAP_W   0x6009
+#define SH2_OP_XTRCT    0x200D
+
+#define SH2_OP_ADD      0x300C
+#define SH2_OP_ADD_IMM  0x7000
+#define SH2_OP_ADDC     0x300E
+#define SH2_OP_ADDV     0x300F
+#define SH2_OP_SUB      0x3008
+#define SH2_OP_SUBC     0x300A
+#define SH2_OP_SUBV     0x300B
+#define SH2_OP_NEG      0x600B
+#define SH2_OP_NEGC     0x600A
+#define SH2_OP_MAC_L    0x000F
+#define SH2_OP_MAC_W    0x400F
+#define SH2_OP_MUL_L    0x0007
+#define SH2_OP_MULU_W   0x200E
+#define SH2_OP_MULS_W   0x200F
+#define SH2_OP_DIV0S    0x2007
+#define SH2_OP_DIV0U    0x0019
+#define SH2_OP_DIV1     0x3004
+#define SH2_OP_DMULU_L  0x3005
+#define SH2_OP_DMULS_L  0x300D
+#define SH2_OP_DT       0x4010
+
+#define SH2_OP_AND      0x2009
+#define SH2_OP_AND_IMM  0xC900
+#define SH2_OP_AND_B    0xCD00
+#define SH2_OP_OR       0x200B
+#define SH2_OP_OR_IMM   0xCB00
+#define SH2_OP_OR_B     0xCF00
+#define SH2_OP_XOR      0x200A
+#define SH2_OP_XOR_IMM  0xCA00
+#define SH2_OP_XOR_B    0xCE00
+#define SH2_OP_NOT      0x6007
+#define SH2_OP_TST      0x2008
+#define SH2_OP_TST_IMM  0xC800
+#define SH2_OP_TST_B    0xCC00
+#define SH2_OP_TAS_B    0x401B
+
+#define SH2_OP_SHAL     0x4020
+#define SH2_OP_SHAR     0x4021
+#define SH2_OP_SHLL     0x4000
+#define SH2_OP_SHLR     0x4001
+#define SH2_OP_SHLL2    0x4008
+#define SH2_OP_SHLR2    0x4009
+#define SH2_OP_SHLL8    0x4018
+#define SH2_OP_SHLR8    0x4019
+#define SH2_OP_SHLL16   0x4028
+#define SH2_OP_SHLR16   0x4029
+#define SH2_OP_ROTL     0x4004
+#define SH2_OP_ROTR     0x4005
+#define SH2_OP_ROTCL    0x4024
+#define SH2_OP_ROTCR    0x4025
+
+#define SH2_OP_BRA      0xA000
+#define SH2_OP_BRAF     0x0023
+#define SH2_OP_BSR      0xB000
+#define SH2_OP_BSRF     0x0003
+#define SH2_OP_BT       0x8900
+#define SH2_OP_BF       0x8B00
+#define SH2_OP_BT_S     0x8D00
+#define SH2_OP_BF_S     0x8F00
+#define SH2_OP_JMP      0x402B
+#define SH2_OP_JSR      0x400B
+#define SH2_OP_RTS      0x000B
+#define SH2_OP_RTE      0x002B
+#define SH2_OP_TRAPA    0xC300
+
+#define SH2_OP_CMP_EQ     0x3000
+#define SH2_OP_CMP_HS     0x3002
+#define SH2_OP_CMP_GE     0x3003
+#define SH2_OP_CMP_HI     0x3006
+#define SH2_OP_CMP_GT     0x3007
+#define SH2_OP_CMP_PZ     0x4011
+#define SH2_OP_CMP_PL     0x4015
+#define SH2_OP_CMP_STR    0x200C
+#define SH2_OP_CMP_EQ_IMM 0x8800
+
+// Control and system registers: ldc/stc take SR, GBR, VBR; lds/sts take
+// MACH, MACL, PR. The register's index (0-2) goes into bits 4-5.
+#define SH2_OP_LDC      0x400E
+#define SH2_OP_LDC_L    0x4007
+#define SH2_OP_STC      0x0002
+#define SH2_OP_STC_L    0x4003
+#define SH2_OP_LDS      0x400A
+#define SH2_OP_LDS_L    0x4006
+#define SH2_OP_STS      0x000A
+#define SH2_OP_STS_L    0x4002
+
+#define SH2_OP_CLRMAC   0x0028
+#define SH2_OP_CLRT     0x0008
+#define SH2_OP_SETT     0x0018
+#define SH2_OP_NOP      0x0009
+#define SH2_OP_SLEEP    0x001B
+
+#define SH2_OP_EXTS_B   0x600E
+#define SH2_OP_EXTS_W   0x600F
+#define SH2_OP_EXTU_B   0x600C
+#define SH2_OP_EXTU_W   0x600D
+
+// Returned for operands the instruction cannot encode (an undefined opcode
+// on the SH-2)
+#define SH2_ENCODE_INVALID 0xFFFF
+
+// Encoders take the same operands as the emitters above; displacements are
+// in bytes, as written in assembly. Branch displacements are relative to
+// the branch address + 4.
 uint16_t sh2_encode_mov_reg_reg(int dst, int src);
+uint16_t sh2_encode_mov_imm(int reg, int8_t imm);
+uint16_t sh2_encode_mov_w_pc(int reg, int disp);        // mov.w @(disp,PC),Rn
+uint16_t sh2_encode_mov_l_pc(int reg, int disp);        // mov.l @(disp,PC),Rn
+uint16_t sh2_encode_mov_l_disp_reg(int dst, int disp, int src);
+uint16_t sh2_encode_mov_l_reg_disp(int src, int disp, int dst);
+uint16_t sh2_encode_mov_w_disp_reg(int dst, int disp, int src);  // dst must be R0
+uint16_t sh2_encode_mov_w_reg_disp(int src, int disp, int dst);  // src must be R0
+uint16_t sh2_encode_mov_b_disp_reg(int dst, int disp, int src);  // dst must be R0
+uint16_t sh2_encode_mov_b_reg_disp(int src, int disp, int dst);  // src must be R0
+uint16_t sh2_encode_mov_l_indir(int dst, int src);
+uint16_t sh2_encode_mov_l_indir_store(int src, int dst);
+uint16_t sh2_encode_mov_w_indir(int dst, int src);
+uint16_t sh2_encode_mov_w_indir_store(int src, int dst);
+uint16_t sh2_encode_mov_b_indir(int dst, int src);
+uint16_t sh2_encode_mov_b_indir_store(int src, int dst);
+uint16_t sh2_encode_mov_l_post_inc(int dst, int src);
+uint16_t sh2_encode_mov_w_post_inc(int dst, int src);
+uint16_t sh2_encode_mov_b_post_inc(int dst, int src);
+uint16_t sh2_encode_mov_l_pre_dec(int src, int dst);
+uint16_t sh2_encode_mov_w_pre_dec(int src, int dst);
+uint16_t sh2_encode_mov_b_pre_dec(int src, int dst);
+uint16_t sh2_encode_mov_l_r0_indexed(int dst, int src);
+uint16_t sh2_encode_mov_l_r0_indexed_store(int src, int dst);
+uint16_t sh2_encode_mov_w_r0_indexed(int dst, int src);
+uint16_t sh2_encode_mov_w_r0_indexed_store(int src, int dst);
+uint16_t sh2_encode_mov_b_r0_indexed(int dst, int src);
+uint16_t sh2_encode_mov_b_r0_indexed_store(int src, int dst);
+uint16_t sh2_encode_mov_l_gbr_disp(int reg, int disp);  // reg must be R0
+uint16_t sh2_encode_mov_l_gbr_store(int reg, int disp);
+uint16_t sh2_encode_mov_w_gbr_disp(int reg, int disp);
+uint16_t sh2_encode_mov_w_gbr_store(int reg, int disp);
+uint16_t sh2_encode_mov_b_gbr_disp(int reg, int disp);
+uint16_t sh2_encode_mov_b_gbr_store(int reg, int disp);
+uint16_t sh2_encode_mova(int disp);
+uint16_t sh2_encode_movt(int reg);
+uint16_t sh2_encode_swap_b(int dst, int src);
+uint16_t sh2_encode_swap_w(int dst, int src);
+uint16_t sh2_encode_xtrct(int dst, int src);
+
 uint16_t sh2_encode_add(int dst, int src);
+uint16_t sh2_encode_add_imm(int reg, int8_t imm);
+uint16_t sh2_encode_addc(int dst, int src);
+uint16_t sh2_encode_addv(int dst, int src);
+uint16_t sh2_encode_sub(int dst, int src);
+uint16_t sh2_encode_subc(int dst, int src);
+uint16_t sh2_encode_subv(int dst, int src);
+uint16_t sh2_encode_neg(int dst, int src);
+uint16_t sh2_encode_negc(int dst, int src);
+uint16_t sh2_encode_mac_l(int src1, int src2);
+uint16_t sh2_encode_mac_w(int src1, int src2);
+uint16_t sh2_encode_mul_l(int src1, int src2);
+uint16_t sh2_encode_mulu_w(int src1, int src2);
+uint16_t sh2_encode_muls_w(int src1, int src2);
+uint16_t sh2_encode_div0s(int src1, int src2);
+uint16_t sh2_encode_div0u(void);
+uint16_t sh2_encode_div1(int src1, int src2);
+uint16_t sh2_encode_dmulu_l(int src1, int src2);
+uint16_t sh2_encode_dmuls_l(int src1, int src2);
+uint16_t sh2_encode_dt(int reg);
+
+uint16_t sh2_encode_and(int dst, int src);
+uint16_t sh2_encode_and_imm(uint8_t imm);
+uint16_t sh2_encode_and_b_imm(uint8_t imm);
+uint16_t sh2_encode_or(int dst, int src);
+uint16_t sh2_encode_or_imm(uint8_t imm);
+uint16_t sh2_encode_or_b_imm(uint8_t imm);
+uint16_t sh2_encode_xor(int dst, int src);
+uint16_t sh2_encode_xor_imm(uint8_t imm);
+uint16_t sh2_encode_xor_b_imm(uint8_t imm);
+uint16_t sh2_encode_not(int dst, int src);
+uint16_t sh2_encode_tst(int src1, int src2);
+uint16_t sh2_encode_tst_imm(uint8_t imm);
+uint16_t sh2_encode_tst_b_imm(uint8_t imm);
+uint16_t sh2_encode_tas_b(int reg);
+
+uint16_t sh2_encode_shal(int reg);
+uint16_t sh2_encode_shar(int reg);
+uint16_t sh2_encode_shll(int reg);
+uint16_t sh2_encode_shlr(int reg);
+uint16_t sh2_encode_shll2(int reg);
+uint16_t sh2_encode_shlr2(int reg);
+uint16_t sh2_encode_shll8(int reg);
+uint16_t sh2_encode_shlr8(int reg);
+uint16_t sh2_encode_shll16(int reg);
+uint16_t sh2_encode_shlr16(int reg);
+uint16_t sh2_encode_rotl(int reg);
+uint16_t sh2_encode_rotr(int reg);
+uint16_t sh2_encode_rotcl(int reg);
+uint16_t sh2_encode_rotcr(int reg);
+
+uint16_t sh2_encode_bra(int disp);                      // -4096..4094
+uint16_t sh2_encode_braf(int reg);
+uint16_t sh2_encode_bsr(int disp);
+uint16_t sh2_encode_bsrf(int reg);
+uint16_t sh2_encode_bt(int disp);                       // -256..254
+uint16_t sh2_encode_bf(int disp);
+uint16_t sh2_encode_bt_s(int disp);
+uint16_t sh2_encode_bf_s(int disp);
+uint16_t sh2_encode_jmp(int reg);
+uint16_t sh2_encode_jsr(int reg);
+uint16_t sh2_encode_rts(void);
+uint16_t sh2_encode_rte(void);
+uint16_t sh2_encode_trapa(uint8_t imm);
+
 uint16_t sh2_encode_cmp_eq(int src1, int src2);
-// ... more encoding functions
+uint16_t sh2_encode_cmp_hs(int src1, int src2);
+uint16_t sh2_encode_cmp_ge(int src1, int src2);
+uint16_t sh2_encode_cmp_hi(int src1, int src2);
+uint16_t sh2_encode_cmp_gt(int src1, int src2);
+uint16_t sh2_encode_cmp_pz(int reg);
+uint16_t sh2_encode_cmp_pl(int reg);
+uint16_t sh2_encode_cmp_str(int src1, int src2);
+uint16_t sh2_encode_cmp_eq_imm(int8_t imm);
+
+uint16_t sh2_encode_ldc(int src, const char *ctrl);
+uint16_t sh2_encode_ldc_l(int src, const char *ctrl);
+uint16_t sh2_encode_stc(const char *ctrl, int dst);
+uint16_t sh2_encode_stc_l(const char *ctrl, int dst);
+uint16_t sh2_encode_lds(int src, const char *ctrl);
+uint16_t sh2_encode_lds_l(int src, const char *ctrl);
+uint16_t sh2_encode_sts(const char *ctrl, int dst);
+uint16_t sh2_encode_sts_l(const char *ctrl, int dst);
+uint16_t sh2_encode_clrmac(void);
+uint16_t sh2_encode_clrt(void);
+uint16_t sh2_encode_sett(void);
+uint16_t sh2_encode_nop(void);
+uint16_t sh2_encode_sleep(void);
+
+uint16_t sh2_encode_exts_b(int dst, int src);
+uint16_t sh2_encode_exts_w(int dst, int src);
+uint16_t sh2_encode_extu_b(int dst, int src);
+uint16_t sh2_encode_extu_w(int dst, int src);
+
+// Index of a control register name for ldc/stc (sr, gbr, vbr) or a system
+// register for lds/sts (mach, macl, pr); -1 if it is not one
+int sh2_control_register(const char *name, size_t length);
+int sh2_system_register(const char *name, size_t length);
 
 #endif // SH2_INSTRUCTION_SET_H
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include "asm_buffer.h"
 
 // ============================================================================
 // Forward Declarations
@@ -59,7 +60,7 @@ bool sh2_peephole_apply_pattern(const char **input, int count,
 // ============================================================================
 
 bool sh2_can_use_in_delay_slot(const char *instruction);
-void sh2_optimize_delay_slot(FILE *out, const char *branch_inst,
+void sh2_optimize_delay_slot(AsmBuffer *out, const char *branch_inst,
                               const char *next_inst);
 bool sh2_is_branch_instruction(const char *inst);
 bool sh2_has_delay_slot(const char *inst);
@@ -69,15 +70,15 @@ bool sh2_has_delay_slot(const char *inst);
 // ============================================================================
 
 // Comparison and branching
-void sh2_gen_compare(FILE *out, const char *op, int lhs, int rhs,
+void sh2_gen_compare(AsmBuffer *out, const char *op, int lhs, int rhs,
                      const char *true_label);
 
 // Loop generation
-void sh2_gen_loop(FILE *out, int counter_reg, int count,
+void sh2_gen_loop(AsmBuffer *out, int counter_reg, int count,
                   const char *body_label, const char *end_label);
 
 // Switch statement with jump table
-void sh2_gen_switch(FILE *out, int value_reg, int num_cases,
+void sh2_gen_switch(AsmBuffer *out, int value_reg, int num_cases,
                     const char *table_label);
 
 // ============================================================================
@@ -85,13 +86,13 @@ void sh2_gen_switch(FILE *out, int value_reg, int num_cases,
 // ============================================================================
 
 // Optimize multiplication by constant
-void sh2_gen_mul_const(FILE *out, int dst, int src, int constant);
+void sh2_gen_mul_const(AsmBuffer *out, int dst, int src, int constant);
 
 // Optimize division by constant
-void sh2_gen_div_const(FILE *out, int dst, int src, int constant);
+void sh2_gen_div_const(AsmBuffer *out, int dst, int src, int constant);
 
 // Optimize modulo by constant (power of 2)
-void sh2_gen_mod_const(FILE *out, int dst, int src, int constant);
+void sh2_gen_mod_const(AsmBuffer *out, int dst, int src, int constant);
 
 // Check if value is power of 2
 bool sh2_is_power_of_2(int value);
@@ -104,18 +105,18 @@ int sh2_count_trailing_zeros(unsigned int value);
 // ============================================================================
 
 // Optimize consecutive loads
-void sh2_gen_load_multiple(FILE *out, int base_reg, int *dst_regs,
+void sh2_gen_load_multiple(AsmBuffer *out, int base_reg, int *dst_regs,
                             int count, int offset);
 
 // Optimize consecutive stores
-void sh2_gen_store_multiple(FILE *out, int base_reg, int *src_regs,
+void sh2_gen_store_multiple(AsmBuffer *out, int base_reg, int *src_regs,
                              int count, int offset);
 
 // Optimize structure field access
-void sh2_gen_struct_access(FILE *out, int dst, int base, int offset);
+void sh2_gen_struct_access(AsmBuffer *out, int dst, int base, int offset);
 
 // Optimize array element access
-void sh2_gen_array_access(FILE *out, int dst, int base, int index,
+void sh2_gen_array_access(AsmBuffer *out, int dst, int base, int index,
                            int element_size);
 
 // ============================================================================
@@ -123,7 +124,7 @@ void sh2_gen_array_access(FILE *out, int dst, int base, int index,
 // ============================================================================
 
 // Replace expensive operations with cheaper equivalents
-void sh2_strength_reduce(FILE *out, const char *op, int dst, int src,
+void sh2_strength_reduce(AsmBuffer *out, const char *op, int dst, int src,
                          int constant);
 
 // Replace multiplication with shifts and adds
@@ -137,7 +138,7 @@ bool sh2_can_strength_reduce_div(int constant);
 // ============================================================================
 
 // Invert branch conditions to eliminate jumps
-void sh2_optimize_branch_chain(FILE *out, bool invert,
+void sh2_optimize_branch_chain(AsmBuffer *out, bool invert,
                                 const char *target_label);
 
 // Eliminate dead code after unconditional branches
@@ -151,10 +152,10 @@ void sh2_merge_basic_blocks(FlowGraph *cfg);
 // ============================================================================
 
 // Generate leaf function (no calls to other functions)
-void sh2_gen_leaf_function(FILE *out, const char *name, int frame_size);
+void sh2_gen_leaf_function(AsmBuffer *out, const char *name, int frame_size);
 
 // Generate tail call optimization
-void sh2_gen_tail_call(FILE *out, const char *target);
+void sh2_gen_tail_call(AsmBuffer *out, const char *target);
 
 // Inline small functions
 bool sh2_should_inline(const char *func_name, int size);
@@ -164,68 +165,68 @@ bool sh2_should_inline(const char *func_name, int size);
 // ============================================================================
 
 // Use shorter instruction sequences
-void sh2_optimize_code_size(FILE *out, const char *operation,
+void sh2_optimize_code_size(AsmBuffer *out, const char *operation,
                             int dst, int src, int immediate);
 
 // Compress immediate values
 bool sh2_can_use_short_immediate(int value);
 
 // Share common code sequences
-void sh2_share_common_sequences(FILE *out);
+void sh2_share_common_sequences(AsmBuffer *out);
 
 // ============================================================================
 // Loop Optimization
 // ============================================================================
 
 // Unroll small loops
-void sh2_unroll_loop(FILE *out, int iterations, const char *body_label);
+void sh2_unroll_loop(AsmBuffer *out, int iterations, const char *body_label);
 
 // Convert while loops to do-while (eliminates one branch)
-void sh2_optimize_loop_structure(FILE *out);
+void sh2_optimize_loop_structure(AsmBuffer *out);
 
 // Hoist loop-invariant code
-void sh2_hoist_invariants(FILE *out);
+void sh2_hoist_invariants(AsmBuffer *out);
 
 // ============================================================================
 // Common Pattern Recognition
 // ============================================================================
 
 // Recognize and optimize common idioms
-void sh2_optimize_idiom(FILE *out, const char *pattern_name,
+void sh2_optimize_idiom(AsmBuffer *out, const char *pattern_name,
                         int *regs, int count);
 
 // Pattern: clear memory region
-void sh2_gen_memset_zero(FILE *out, int addr_reg, int size_reg);
+void sh2_gen_memset_zero(AsmBuffer *out, int addr_reg, int size_reg);
 
 // Pattern: copy memory region
-void sh2_gen_memcpy_fast(FILE *out, int dst_reg, int src_reg, int size_reg);
+void sh2_gen_memcpy_fast(AsmBuffer *out, int dst_reg, int src_reg, int size_reg);
 
 // Pattern: bit manipulation
-void sh2_gen_set_bit(FILE *out, int reg, int bit_pos);
-void sh2_gen_clear_bit(FILE *out, int reg, int bit_pos);
-void sh2_gen_toggle_bit(FILE *out, int reg, int bit_pos);
-void sh2_gen_test_bit(FILE *out, int reg, int bit_pos, const char *label);
+void sh2_gen_set_bit(AsmBuffer *out, int reg, int bit_pos);
+void sh2_gen_clear_bit(AsmBuffer *out, int reg, int bit_pos);
+void sh2_gen_toggle_bit(AsmBuffer *out, int reg, int bit_pos);
+void sh2_gen_test_bit(AsmBuffer *out, int reg, int bit_pos, const char *label);
 
 // ============================================================================
 // Saturn-Specific Optimizations
 // ============================================================================
 
 // Optimize for dual CPU architecture
-void sh2_optimize_for_dual_cpu(FILE *out, bool is_slave);
+void sh2_optimize_for_dual_cpu(AsmBuffer *out, bool is_slave);
 
 // Synchronize master and slave CPUs
-void sh2_gen_cpu_sync(FILE *out, bool is_master);
+void sh2_gen_cpu_sync(AsmBuffer *out, bool is_master);
 
 // Optimize VDP1/VDP2 memory access
-void sh2_optimize_vram_access(FILE *out, uint32_t vram_addr,
+void sh2_optimize_vram_access(AsmBuffer *out, uint32_t vram_addr,
                                int data_reg, bool is_write);
 
 // Optimize DMA transfers
-void sh2_gen_dma_transfer(FILE *out, int src_reg, int dst_reg,
+void sh2_gen_dma_transfer(AsmBuffer *out, int src_reg, int dst_reg,
                           int size_reg, int channel);
 
 // Batch VDP commands
-void sh2_optimize_vdp_commands(FILE *out);
+void sh2_optimize_vdp_commands(AsmBuffer *out);
 
 // ============================================================================
 // Data Flow Analysis
@@ -305,16 +306,16 @@ typedef struct {
     int priority;
 } ScheduledInstruction;
 
-void sh2_schedule_instructions(FILE *out, const char **instructions,
+void sh2_schedule_instructions(AsmBuffer *out, const char **instructions,
                                 int count, bool optimize_for_pipeline);
 
 // ============================================================================
 // Debug and Profiling Support
 // ============================================================================
 
-void sh2_emit_debug_info(FILE *out, const char *source_file, int line);
-void sh2_emit_function_trace(FILE *out, const char *func_name);
-void sh2_emit_profiling_code(FILE *out, const char *label);
+void sh2_emit_debug_info(AsmBuffer *out, const char *source_file, int line);
+void sh2_emit_function_trace(AsmBuffer *out, const char *func_name);
+void sh2_emit_profiling_code(AsmBuffer *out, const char *label);
 
 // ============================================================================
 // Optimization Statistics
@@ -331,7 +332,7 @@ typedef struct {
 OptimizationStats* sh2_create_stats(void);
 void sh2_update_stats(OptimizationStats *stats, const char *opt_type,
                       int improvement);
-void sh2_print_stats(OptimizationStats *stats, FILE *out);
+void sh2_print_stats(OptimizationStats *stats, AsmBuffer *out);
 void sh2_free_stats(OptimizationStats *stats);
 
 // ============================================================================
@@ -351,7 +352,7 @@ typedef struct {
     bool saturn_dual_cpu;
 } OptimizationOptions;
 
-void sh2_optimize_function(FILE *out, const char *func_name,
+void sh2_optimize_function(AsmBuffer *out, const char *func_name,
                            const char **instructions, int count,
                            OptimizationOptions *opts);
 
@@ -4,7 +4,7 @@
 #include "types.h"
 #include <stdbool.h>
 
-#define SYMBOL_TABLE_SIZE 127
+#define SYMBOL_TABLE_INITIAL_CAPACITY 64   // Buckets; always a power of two
 
 // Symbol types for the symbol table - UNIFIED DEFINITION
 typedef enum {
@@ -54,7 +54,7 @@ typedef struct {
 
 // Symbol structure for hash table entries - UNIFIED DEFINITION
 typedef struct Symbol {
-    char *name;
+    const char *name;       // Interned; compare by pointer
     SymbolType symbol_type;
     DataType data_type;
     int scope_level;
@@ -62,6 +62,7 @@ typedef struct Symbol {
     int column;             // Column where symbol was declared
     bool is_initialized;    // Whether variable has been initialized
     bool is_used;           // Whether symbol has been referenced
+    int frame_offset;       // Codegen: displacement of the variable's stack slot
 
     // Union for different symbol data types
     union {
@@ -80,12 +81,21 @@ typedef struct Symbol {
         } func_info;
     } data;
 
-    struct Symbol *next;  // For chaining in hash table
+    struct Symbol *next;  // Bucket chain, newest (innermost) first
 } Symbol;
 
 // Symbol table structure
+// Every live symbol is also recorded on a scope log in declaration order, and
+// each open scope remembers where its part of the log starts. Leaving a scope
+// pops just its own symbols instead of scanning every bucket.
 typedef struct SymbolTable {
     Symbol **table;       // Array of symbol pointers (hash table)
+    int capacity;         // Number of buckets, a power of two
+    int count;            // Live symbols across all scopes
+    Symbol **scope_log;   // Live symbols, oldest first
+    int log_capacity;
+    int *scope_marks;     // scope_marks[n - 1]: log length when scope n opened
+    int marks_capacity;
     int current_scope;    // Current scope level
     int max_scope_seen;   // Highest scope level encountered
 } SymbolTable;
@@ -97,6 +107,8 @@ void symbol_table_enter_scope(SymbolTable *table);
 void symbol_table_exit_scope(SymbolTable *table);
 
 // Symbol management functions
+// Names are interned handles (intern_string), as AST names already are; they
+// are hashed with intern_hash() and compared by pointer
 bool symbol_table_insert(SymbolTable *table, const char *name, SymbolType symbol_type, DataType data_type);
 Symbol *symbol_table_lookup(SymbolTable *table, const char *name);
 Symbol *symbol_table_lookup_current_scope(SymbolTable *table, const char *name);
@@ -151,7 +163,7 @@ void mark_symbol_as_used(SymbolTable *table, const char *name);
 void mark_symbol_as_initialized(SymbolTable *table, const char *name);
 
 // Debug and utility functions
-unsigned int symbol_table_hash(const char *name);
+unsigned int symbol_table_hash(const char *name);    // name is interned
 void symbol_table_print(SymbolTable *table);
 void symbol_table_print_scope(SymbolTable *table, int scope);
 void symbol_print_info(Symbol *symbol);
@@ -14,6 +14,7 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include <stdio.h>      // Add this for FILE type
+#include "asm_buffer.h"
 
 // Forward declarations to avoid circular dependencies - MOVED TO TOP
 struct ASTNode;
@@ -389,10 +390,11 @@ typedef enum {
  */
 typedef struct Token {
     TokenType type;
-    char *value;              // Token text (lexeme)
-    char *lexeme;            // Alternative name for compatibility
+    unsigned int offset;     // Byte offset of the token text in the lexer input
+    unsigned int length;     // Length of the token text in bytes
     int line;                // Line number
     int column;              // Column number
+    const char *value;       // Interned spelling of identifiers and keywords, else NULL (see lexer_token_text)
     union {
         int int_value;
         float float_value;
@@ -488,7 +490,7 @@ struct ASTNode {
         // Enhanced variable declaration with ARC
         struct {
             DataType var_type;
-            char *name;
+            const char *name;
             struct ASTNode *initializer;
             struct ASTNode *type_node;
             ARCQualifier arc_qualifier;  // Ownership qualifier
@@ -496,7 +498,7 @@ struct ASTNode {
 
         // ARC-aware assignment
         struct {
-            char *variable;
+            const char *variable;
             struct ASTNode *value;
             bool needs_retain;           // Insert retain call
             bool needs_release;          // Insert release call
@@ -518,7 +520,7 @@ struct ASTNode {
 
         struct {
             DataType return_type;
-            char *name;
+            const char *name;
             struct ASTNode **parameters;
             int parameter_count;
             struct ASTNode *body;
@@ -526,17 +528,19 @@ struct ASTNode {
 
         struct {
             DataType var_type;
-            char *name;
+            const char *name;
             struct ASTNode *initializer;
             struct ASTNode *type_node;
             TypeQualifier qualifiers;  // ADD THIS LINE
             bool is_const;             // ADD THIS LINE
             bool is_volatile;          // ADD THIS LINE
+            int frame_offset;          // Stack slot from codegen's frame layout
         } var_decl;
 
         struct {
             DataType param_type;
-            char *name;
+            const char *name;
+            int frame_offset;          // Stack slot from codegen's frame layout
         } parameter;
 
         struct {
@@ -582,13 +586,13 @@ struct ASTNode {
         } unary_expr;
 
         struct {
-            char *function_name;
+            const char *function_name;
             struct ASTNode **arguments;
             int argument_count;
         } call_expr;
         
         struct {
-            char *name;
+            const char *name;
         } identifier;
 
         struct {
@@ -600,14 +604,14 @@ struct ASTNode {
         } string;
 
         struct {
-            char *variable;
+            const char *variable;
             struct ASTNode *value;
         } assignment;
 
         // Objective-C specific nodes
         struct {
-            char *class_name;
-            char *superclass_name;
+            const char *class_name;
+            const char *superclass_name;
             struct ASTNode **protocols;
             int protocol_count;
             struct ASTNode **methods;
@@ -617,8 +621,8 @@ struct ASTNode {
         } objc_interface;
 
         struct {
-            char *class_name;
-            char *category_name;
+            const char *class_name;
+            const char *category_name;
             struct ASTNode **methods;
             int method_count;
             struct ASTNode **ivars;
@@ -628,7 +632,7 @@ struct ASTNode {
         struct {
             ObjCMethodType method_type;
             DataType return_type;
-            char *selector;
+            const char *selector;
             ObjCMethodParam *params;
             int param_count;
             struct ASTNode *body;
@@ -636,21 +640,21 @@ struct ASTNode {
 
         struct {
             struct ASTNode *receiver;
-            char *selector;
+            const char *selector;
             struct ASTNode **arguments;
             int argument_count;
         } objc_message;
 
         struct {
             DataType property_type;
-            char *property_name;
+            const char *property_name;
             ObjCPropertyAttributes attributes;
-            char *getter_name;
-            char *setter_name;
+            const char *getter_name;
+            const char *setter_name;
         } objc_property;
 
         struct {
-            char *protocol_name;
+            const char *protocol_name;
             struct ASTNode **methods;
             int method_count;
             struct ASTNode **properties;
@@ -662,7 +666,7 @@ struct ASTNode {
         } objc_string;
 
         struct {
-            char *selector_name;
+            const char *selector_name;
         } objc_selector;
 
         struct {
@@ -672,35 +676,35 @@ struct ASTNode {
         // Complex type definitions
         struct {
             struct ASTNode *base_type;
-            char *alias_name;
+            const char *alias_name;
         } typedef_decl;
 
         struct {
-            char *name;
+            const char *name;
             struct ASTNode **members;
             int member_count;
         } struct_decl;
 
         struct {
-            char *name;
+            const char *name;
             struct ASTNode **members;
             int member_count;
         } union_decl;
 
         struct {
-            char *name;
+            const char *name;
             struct ASTNode **constants;
             int constant_count;
         } enum_decl;
 
         struct {
-            char *name;
+            const char *name;
             int value;
         } enum_constant;
 
         struct {
             DataType type;
-            char *name;
+            const char *name;
             int bitfield_width;
             struct ASTNode *type_node;
             TypeQualifier qualifiers;  // ADD THIS LINE
@@ -720,7 +724,7 @@ struct ASTNode {
         // NEW: Complex type structures - ADD THESE
         struct {
             DataType return_type;
-            char *name;
+            const char *name;
             struct ASTNode **param_types;
             int param_count;
             bool is_variadic;
@@ -784,10 +788,11 @@ typedef struct Lexer {
     int column;
     bool has_error;
     char *error_message;
-    char *input;
+    const char *input;           // Borrowed; must outlive the lexer and its tokens
     size_t pos;
     size_t input_length;
     bool objc_mode;              // Enable Objective-C syntax
+    bool in_property_attributes; // Inside "@property ( ... )"
 } Lexer;
 
 /**
@@ -795,8 +800,11 @@ typedef struct Lexer {
  */
 typedef struct Parser {
     Lexer *lexer;
-    Token current_token;
-    Token peek_token;
+    Token *tokens;               // Whole input, lexed up front, ends in TOKEN_EOF
+    size_t token_count;
+    size_t token_index;          // Position of current_token in tokens
+    Token current_token;         // tokens[token_index]
+    Token peek_token;            // tokens[token_index + 1]
     bool has_error;
     char *error_message;
     bool objc_mode;              // Enable Objective-C parsing
@@ -806,9 +814,14 @@ typedef struct Parser {
  * @brief CodeGenerator structure
  */
 typedef struct CodeGenerator {
-    FILE *output_file;
-    int label_counter;
+    FILE *output_file;           // Assembly text, or NULL when assembling in-process
+    AsmBuffer output;            // Pending text for output_file
+    struct X86Assembler *assembler;  // Encodes instructions directly (x86-64 only)
+    char *object_file;           // Where codegen_generate() writes the object
+    int label_counter;           // Next local label, emitted as L<n>
     int temp_counter;
+    int frame_size;              // Bytes reserved below the frame base
+    bool frameless;              // Leaf function: no frame, locals in the red zone
     bool objc_mode;              // Enable Objective-C code generation
     SymbolTable *symbol_table;   // Now properly forward declared
 } CodeGenerator;
@@ -821,10 +834,6 @@ const char* objc_method_type_to_string(ObjCMethodType type);
 DataType token_to_data_type(TokenType type);
 
 // PreProcessor definitions
-#define MAX_MACRO_NAME 64
-#define MAX_MACRO_BODY 512
-#define MAX_MACRO_PARAMS 32
-#define MAX_MACROS 256
 #define MAX_INCLUDE_DEPTH 32
 #define MAX_LINE_LENGTH 1024
 
@@ -840,18 +849,24 @@ typedef enum {
  * @brief Macro parameter
  */
 typedef struct MacroParam {
-    char name[MAX_MACRO_NAME];
+    const char *name;            // Interned
 } MacroParam;
 
 /**
  * @brief Macro definition
  */
 typedef struct Macro {
-    char name[256];
-    char body[1024];
+    const char *name;            // Interned; the macro table key
+    char *body;                  // Heap-allocated replacement text
     MacroType type;
-    MacroParam params[MAX_MACRO_PARAMS];
+    MacroParam *params;          // param_count entries, heap-allocated
     int param_count;
+    bool is_variadic;            // Last parameter collects the remaining arguments
+    struct PPToken *tokens;      // Pre-lexed replacement list
+    int token_count;
+    struct PPToken *expansion;   // Memoized expansion (object-like macros only)
+    int expansion_count;         // -1 if this macro cannot be memoized
+    unsigned long expansion_generation; // Macro table generation the memo belongs to
     bool is_predefined;
     int line_defined;
     char *file_defined;
@@ -876,6 +891,7 @@ typedef struct ConditionalState {
     ConditionalType type;
     bool condition_met;
     bool else_taken;
+    bool was_skipping;           // Enclosing group was already being skipped
     int line_number;
 } ConditionalState;
 
@@ -883,10 +899,11 @@ typedef struct ConditionalState {
  * @brief Include file tracking
  */
 typedef struct IncludeFile {
-    char *filename;
-    char *content;
-    int line;
-    int pos;
+    char *filename;              // File that contains the #include
+    int line;                    // Line of the #include in that file
+    int search_index;            // Include path the new file was found in, -1 if beside it
+    int cond_depth;              // Conditional depth on entry
+    struct IncludeCacheEntry *entry;
 } IncludeFile;
 
 // ARC context for tracking scope and cleanup
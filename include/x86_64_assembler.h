@@ -0,0 +1,109 @@
+#ifndef X86_64_ASSEMBLER_H
+#define X86_64_ASSEMBLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "asm_buffer.h"
+
+// Integrated x86-64 assembler.
+// Encodes instructions straight into section buffers and writes an ELF64
+// relocatable object, so compiling does not go through a .s file and an
+// external assembler.
+//
+// The code generator hands it X86Instruction values (x86_asm_encode), and
+// prints the same values with x86_asm_format() when -S asks for text.
+// x86_asm_source() is a front end for AT&T syntax text; it decodes each
+// line into the same values. It also takes labels and the common data and
+// section directives (Mach-O section names map onto their ELF equivalents).
+//
+// Covers the integer instruction set: mov/lea/movzx/movsx, ALU, shifts,
+// mul/div, push/pop, setcc/cmovcc, call/jmp/jcc, ret, syscall. Backward
+// branches to labels within 127 bytes use the short form.
+
+typedef struct X86Assembler X86Assembler;
+
+#define X86_NONE (-1)
+
+// Register numbers, as encoded in ModRM and REX
+enum {
+    X86_RAX, X86_RCX, X86_RDX, X86_RBX, X86_RSP, X86_RBP, X86_RSI, X86_RDI,
+    X86_R8, X86_R9, X86_R10, X86_R11, X86_R12, X86_R13, X86_R14, X86_R15,
+    X86_RIP                          // Base of rip-relative memory operands
+};
+
+// Condition codes, as encoded in jcc/setcc/cmovcc
+typedef enum {
+    X86_CC_O, X86_CC_NO, X86_CC_B, X86_CC_AE, X86_CC_E, X86_CC_NE, X86_CC_BE, X86_CC_A,
+    X86_CC_S, X86_CC_NS, X86_CC_P, X86_CC_NP, X86_CC_L, X86_CC_GE, X86_CC_LE, X86_CC_G
+} X86Condition;
+
+typedef enum {
+    // Group 1 ALU, in encoding order
+    X86_ADD, X86_OR, X86_ADC, X86_SBB, X86_AND, X86_SUB, X86_XOR, X86_CMP,
+    X86_MOV, X86_MOVABS, X86_MOVZX, X86_MOVSX, X86_LEA, X86_TEST, X86_IMUL,
+    X86_NOT, X86_NEG, X86_MUL, X86_DIV, X86_IDIV, X86_INC, X86_DEC,
+    X86_ROL, X86_ROR, X86_SHL, X86_SHR, X86_SAR,
+    X86_PUSH, X86_POP, X86_JMP, X86_CALL, X86_JCC, X86_SETCC, X86_CMOVCC,
+    // No operands
+    X86_RET, X86_LEAVE, X86_SYSCALL, X86_NOP, X86_HLT, X86_INT3, X86_UD2,
+    X86_CQTO, X86_CLTQ, X86_CLTD,
+    X86_OPCODE_COUNT
+} X86Opcode;
+
+typedef enum {
+    X86_OP_REG,
+    X86_OP_IMM,
+    X86_OP_MEM                       // Also a jmp/call target or label reference
+} X86OperandKind;
+
+typedef struct X86Operand {
+    X86OperandKind kind;
+    int reg;                         // X86_OP_REG: register number
+    int size;                        // X86_OP_REG: width in bytes
+    int64_t value;                   // Immediate or displacement
+    const char *symbol;              // Symbol added to value, or NULL
+    int base;                        // X86_OP_MEM registers, or X86_NONE
+    int index;
+    int scale;
+    bool indirect;                   // '*' before a jmp/call operand
+} X86Operand;
+
+typedef struct X86Instruction {
+    X86Opcode opcode;
+    int size;                        // Operation width; 0 takes it from a register operand
+    int source_size;                 // X86_MOVZX/X86_MOVSX: width of the source
+    X86Condition condition;          // X86_JCC/X86_SETCC/X86_CMOVCC
+    X86Operand operands[3];          // AT&T order: sources first, destination last
+    int operand_count;
+} X86Instruction;
+
+// Operand constructors
+X86Operand x86_reg(int reg, int size);
+X86Operand x86_imm(int64_t value);
+X86Operand x86_mem(int base, int64_t displacement);
+X86Operand x86_sym(const char *symbol);    // Label reference or jmp/call target
+
+X86Assembler *x86_asm_create(void);
+void x86_asm_destroy(X86Assembler *as);
+
+// Direct entry points. Errors are reported and make x86_asm_write_object()
+// fail.
+void x86_asm_encode(X86Assembler *as, const X86Instruction *instruction);
+void x86_asm_label(X86Assembler *as, const char *name);
+void x86_asm_global(X86Assembler *as, const char *name);
+void x86_asm_section(X86Assembler *as, const char *name);
+
+// Prints an instruction in AT&T syntax, without indentation or newline
+void x86_asm_format(AsmBuffer *out, const X86Instruction *instruction);
+
+// Assembles one or more newline-separated lines; errors are reported with
+// the line number
+void x86_asm_source(X86Assembler *as, const char *text, size_t length);
+
+// Resolves local references and writes the object file
+bool x86_asm_write_object(X86Assembler *as, const char *path);
+
+int x86_asm_error_count(const X86Assembler *as);
+
+#endif // X86_64_ASSEMBLER_H
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Regenerate the perfect keyword hash in src/lexer.c.
+
+Reads the spellings from the keywords[] table, searches for multipliers that
+give every spelling its own slot, and rewrites the block between the
+BEGIN/END GENERATED KEYWORD HASH markers.
+
+Usage: scripts/gen_keyword_hash.py [path/to/lexer.c]
+"""
+import random
+import re
+import sys
+
+HASH_SIZE = 512
+BEGIN = "// BEGIN GENERATED KEYWORD HASH"
+END = "// END GENERATED KEYWORD HASH"
+
+
+def keyword_hash(word, a, b, c, d):
+    w = word.encode()
+    return (w[0] * a + w[1] * b + w[len(w) >> 1] * c + w[-1] + len(w) * d) & (HASH_SIZE - 1)
+
+
+def find_multipliers(words):
+    rng = random.Random(1)
+    for _ in range(1000000):
+        a, b, c, d = (rng.randrange(1, 1024) | 1 for _ in range(4))
+        slots = {keyword_hash(w, a, b, c, d) for w in words}
+        if len(slots) == len(words):
+            return a, b, c, d
+    sys.exit("no perfect hash found; increase HASH_SIZE")
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else "src/lexer.c"
+    source = open(path).read()
+
+    table = source[source.index("static const KeywordEntry keywords[]"):]
+    table = table[:table.index("};")]
+    words = re.findall(r'KW\("([^"]+)"', table)
+    if len(words) != len(set(words)):
+        sys.exit("duplicate spelling in keywords[]")
+    if len(words) > 255:
+        sys.exit("too many keywords for unsigned char slots")
+
+    a, b, c, d = find_multipliers(words)
+    slots = [0] * HASH_SIZE
+    for index, word in enumerate(words):
+        slots[keyword_hash(word, a, b, c, d)] = index + 1
+
+    rows = []
+    for i in range(0, HASH_SIZE, 16):
+        rows.append("    " + ", ".join("%2d" % v for v in slots[i:i + 16]) + ",")
+
+    block = "\n".join([
+        BEGIN + " (scripts/gen_keyword_hash.py)",
+        "#define KEYWORD_MIN_LENGTH %d" % min(len(w) for w in words),
+        "#define KEYWORD_MAX_LENGTH %d" % max(len(w) for w in words),
+        "#define KEYWORD_HASH_SIZE %d" % HASH_SIZE,
+        "#define KEYWORD_HASH(s, n) \\",
+        "    (((unsigned char)(s)[0] * %du + (unsigned char)(s)[1] * %du + \\" % (a, b),
+        "      (unsigned char)(s)[(n) >> 1] * %du + (unsigned char)(s)[(n) - 1] + \\" % c,
+        "      (unsigned)(n) * %du) & (KEYWORD_HASH_SIZE - 1))" % d,
+        "",
+        "static const unsigned char keyword_slots[KEYWORD_HASH_SIZE] = {",
+        *rows,
+        "};",
+        END,
+    ])
+
+    if BEGIN in source:
+        start = source.index(BEGIN)
+        stop = source.index(END) + len(END)
+        source = source[:start] + block + source[stop:]
+    else:
+        source = source.replace("@@SLOTS@@", block)
+
+    open(path, "w").write(source)
+    print("%d keywords, multipliers %d %d %d %d" % (len(words), a, b, c, d))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "error.h"
+
+#define ARENA_ALIGNMENT 16
+
+// Totals over every arena the thread allocated from (see arena_thread_stats)
+static _Thread_local ArenaStats arena_thread_totals;
+
+static size_t arena_align(size_t size) {
+    return (size + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static ArenaChunk *arena_new_chunk(Arena *arena, size_t size) {
+    ArenaChunk *chunk = malloc(sizeof(ArenaChunk) + size);
+    if (!chunk) {
+        error_fatal("Memory allocation failed for arena chunk (%zu bytes)", size);
+        return NULL;
+    }
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    arena->bytes_reserved += size;
+    arena_thread_totals.bytes_reserved += size;
+
+    return chunk;
+}
+
+Arena *arena_create(size_t chunk_size) {
+    Arena *arena = malloc(sizeof(Arena));
+    if (!arena) {
+        error_fatal("Memory allocation failed for arena");
+        return NULL;
+    }
+
+    memset(arena, 0, sizeof(Arena));
+    arena->chunk_size = chunk_size ? arena_align(chunk_size) : ARENA_DEFAULT_CHUNK_SIZE;
+    arena->head = arena_new_chunk(arena, arena->chunk_size);
+
+    return arena;
+}
+
+void arena_destroy(Arena *arena) {
+    if (!arena) return;
+
+    ArenaChunk *chunk = arena->head;
+    while (chunk) {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    free(arena);
+}
+
+void arena_reset(Arena *arena) {
+    if (!arena || !arena->head) return;
+
+    // Keep the most recent chunk, drop the rest
+    ArenaChunk *chunk = arena->head->next;
+    while (chunk) {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    arena->head->next = NULL;
+    arena->head->used = 0;
+    arena->bytes_allocated = 0;
+    arena->bytes_reserved = arena->head->size;
+    arena->allocation_count = 0;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    if (!arena) return NULL;
+
+    size = arena_align(size ? size : 1);
+    arena->bytes_allocated += size;
+    arena->allocation_count++;
+    arena_thread_totals.bytes_allocated += size;
+    arena_thread_totals.allocation_count++;
+
+    ArenaChunk *head = arena->head;
+    if (head && head->size - head->used >= size) {
+        void *ptr = head->data + head->used;
+        head->used += size;
+        return ptr;
+    }
+
+    // Oversized requests get a dedicated chunk behind the current one so the
+    // space left in the head chunk is not wasted.
+    if (head && size > arena->chunk_size / 4) {
+        ArenaChunk *big = arena_new_chunk(arena, size);
+        big->used = size;
+        big->next = head->next;
+        head->next = big;
+        return big->data;
+    }
+
+    ArenaChunk *chunk = arena_new_chunk(arena, size > arena->chunk_size ? size : arena->chunk_size);
+    chunk->next = head;
+    arena->head = chunk;
+
+    chunk->used = size;
+    return chunk->data;
+}
+
+void *arena_calloc(Arena *arena, size_t count, size_t size) {
+    if (size && count > (size_t)-1 / size) {
+        error_fatal("Arena allocation overflow (%zu x %zu bytes)", count, size);
+        return NULL;
+    }
+
+    void *ptr = arena_alloc(arena, count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void *arena_memdup(Arena *arena, const void *src, size_t size) {
+    if (!src) return NULL;
+
+    void *ptr = arena_alloc(arena, size);
+    if (ptr && size) {
+        memcpy(ptr, src, size);
+    }
+    return ptr;
+}
+
+char *arena_strndup(Arena *arena, const char *str, size_t len) {
+    if (!str) return NULL;
+
+    char *copy = arena_alloc(arena, len + 1);
+    if (!copy) return NULL;
+
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+char *arena_strdup(Arena *arena, const char *str) {
+    if (!str) return NULL;
+    return arena_strndup(arena, str, strlen(str));
+}
+
+ArenaStats arena_thread_stats(void) {
+    return arena_thread_totals;
+}
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "asm_buffer.h"
+
+#define ASM_BUFFER_INITIAL_SIZE 256
+
+bool asm_buffer_init(AsmBuffer *buffer, FILE *sink) {
+    buffer->capacity = sink ? ASM_BUFFER_FLUSH_SIZE : ASM_BUFFER_INITIAL_SIZE;
+    buffer->data = malloc(buffer->capacity);
+    buffer->length = 0;
+    buffer->sink = sink;
+    buffer->failed = buffer->data == NULL;
+    if (!buffer->data) {
+        buffer->capacity = 0;
+    }
+    return !buffer->failed;
+}
+
+void asm_buffer_free(AsmBuffer *buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+void asm_buffer_reset(AsmBuffer *buffer) {
+    buffer->length = 0;
+}
+
+static void asm_buffer_write(AsmBuffer *buffer) {
+    if (buffer->length &&
+        fwrite(buffer->data, 1, buffer->length, buffer->sink) != buffer->length) {
+        buffer->failed = true;
+    }
+    buffer->length = 0;
+}
+
+// Room for size more bytes at data + length, or NULL after a failure
+static char *asm_buffer_reserve(AsmBuffer *buffer, size_t size) {
+    if (buffer->failed) {
+        return NULL;
+    }
+    if (buffer->capacity - buffer->length >= size) {
+        return buffer->data + buffer->length;
+    }
+
+    // Full: a buffer with a sink empties itself instead of growing
+    if (buffer->sink && buffer->length) {
+        asm_buffer_write(buffer);
+        if (buffer->failed) {
+            return NULL;
+        }
+        if (buffer->capacity >= size) {
+            return buffer->data;
+        }
+    }
+
+    size_t capacity = buffer->capacity ? buffer->capacity : ASM_BUFFER_INITIAL_SIZE;
+    while (capacity - buffer->length < size) {
+        capacity *= 2;
+    }
+    char *data = realloc(buffer->data, capacity);
+    if (!data) {
+        buffer->failed = true;
+        return NULL;
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return buffer->data + buffer->length;
+}
+
+void asm_buffer_append(AsmBuffer *buffer, const char *text, size_t length) {
+    char *dest = asm_buffer_reserve(buffer, length);
+    if (dest) {
+        memcpy(dest, text, length);
+        buffer->length += length;
+    }
+}
+
+void asm_buffer_puts(AsmBuffer *buffer, const char *text) {
+    asm_buffer_append(buffer, text, strlen(text));
+}
+
+void asm_buffer_putc(AsmBuffer *buffer, char c) {
+    char *dest = asm_buffer_reserve(buffer, 1);
+    if (dest) {
+        *dest = c;
+        buffer->length++;
+    }
+}
+
+void asm_buffer_uint(AsmBuffer *buffer, unsigned long long value, unsigned base) {
+    static const char digits[] = "0123456789abcdef";
+    char text[24];
+    char *start = text + sizeof(text);
+    do {
+        *--start = digits[value % base];
+        value /= base;
+    } while (value);
+    asm_buffer_append(buffer, start, (size_t)(text + sizeof(text) - start));
+}
+
+void asm_buffer_int(AsmBuffer *buffer, long long value) {
+    if (value < 0) {
+        asm_buffer_putc(buffer, '-');
+        asm_buffer_uint(buffer, 0ULL - (unsigned long long)value, 10);
+    } else {
+        asm_buffer_uint(buffer, (unsigned long long)value, 10);
+    }
+}
+
+// Formats the rest of the line with the C library
+static void asm_buffer_vformat_libc(AsmBuffer *buffer, const char *format, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+    if (length < 0) {
+        return;
+    }
+
+    char *dest = asm_buffer_reserve(buffer, (size_t)length + 1);
+    if (dest) {
+        vsnprintf(dest, (size_t)length + 1, format, args);
+        buffer->length += (size_t)length;
+    }
+}
+
+void asm_buffer_vformat(AsmBuffer *buffer, const char *format, va_list args) {
+    va_list ap;
+    va_copy(ap, args);
+
+    const char *p = format;
+    while (*p) {
+        const char *text = p;
+        while (*p && *p != '%') p++;
+        if (p > text) {
+            asm_buffer_append(buffer, text, (size_t)(p - text));
+        }
+        if (!*p) break;
+
+        const char *spec = p++;
+        int longs = 0;
+        bool size = false;
+        while (*p == 'l') {
+            longs++;
+            p++;
+        }
+        if (longs == 0 && *p == 'z') {
+            size = true;
+            p++;
+        }
+
+        switch (*p) {
+            case '%':
+                asm_buffer_putc(buffer, '%');
+                break;
+            case 's': {
+                const char *s = va_arg(ap, const char *);
+                asm_buffer_puts(buffer, s ? s : "(null)");
+                break;
+            }
+            case 'c':
+                asm_buffer_putc(buffer, (char)va_arg(ap, int));
+                break;
+            case 'd':
+            case 'i':
+                asm_buffer_int(buffer, longs >= 2 ? va_arg(ap, long long)
+                                     : longs == 1 ? va_arg(ap, long)
+                                     : size ? (long long)va_arg(ap, ptrdiff_t)
+                                     : va_arg(ap, int));
+                break;
+            case 'u':
+            case 'x':
+                asm_buffer_uint(buffer, longs >= 2 ? va_arg(ap, unsigned long long)
+                                      : longs == 1 ? va_arg(ap, unsigned long)
+                                      : size ? va_arg(ap, size_t)
+                                      : va_arg(ap, unsigned),
+                                *p == 'x' ? 16 : 10);
+                break;
+            default:
+                // Flags, width, precision or a conversion not handled above
+                asm_buffer_vformat_libc(buffer, spec, ap);
+                va_end(ap);
+                return;
+        }
+        p++;
+    }
+    va_end(ap);
+}
+
+void asm_buffer_format(AsmBuffer *buffer, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    asm_buffer_vformat(buffer, format, args);
+    va_end(args);
+}
+
+bool asm_buffer_flush(AsmBuffer *buffer) {
+    if (buffer->sink && !buffer->failed) {
+        asm_buffer_write(buffer);
+        if (fflush(buffer->sink) != 0) {
+            buffer->failed = true;
+        }
+    }
+    return !buffer->failed;
+}
@@ -2,8 +2,60 @@
 
 #include "types.h"
 #include "ast.h"
+#include "arena.h"
+#include "intern.h"
 #include <stdlib.h>
 #include <string.h>
+
+#define AST_ARENA_CHUNK_SIZE (256 * 1024)
+
+// Arena owning every node, child array and literal of the current translation unit.
+// Identifier-like names are interned (intern.h) rather than copied.
+// Created lazily on the first allocation and released by ast_destroy(program).
+// Per thread, so parallel compiles each build their own tree.
+static _Thread_local Arena *ast_arena = NULL;
+static _Thread_local size_t ast_nodes = 0;      // Nodes in the current tree
+
+static Arena *ast_current_arena(void) {
+    if (!ast_arena) {
+        ast_arena = arena_create(AST_ARENA_CHUNK_SIZE);
+    }
+    return ast_arena;
+}
+
+static ASTNode *ast_alloc_node(void) {
+    ast_nodes++;
+    return arena_calloc(ast_current_arena(), 1, sizeof(ASTNode));
+}
+
+static ASTNode **ast_alloc_children(int count) {
+    return arena_calloc(ast_current_arena(), (size_t)count, sizeof(ASTNode*));
+}
+
+// Make room for one more child. Capacity is implied by the count (next power
+// of two), so arrays only move when they fill up and the arena waste stays
+// bounded by the final array size.
+static ASTNode **ast_grow_children(ASTNode **children, int count) {
+    if (children && (count & (count - 1)) != 0) {
+        return children;
+    }
+
+    ASTNode **grown = ast_alloc_children(count ? count * 2 : 1);
+    if (children && count > 0) {
+        memcpy(grown, children, sizeof(ASTNode*) * (size_t)count);
+    }
+    return grown;
+}
+
+char *ast_strdup(const char *str) {
+    return str ? arena_strdup(ast_current_arena(), str) : NULL;
+}
+
+ASTNode **ast_copy_children(ASTNode **children, int count) {
+    if (!children || count <= 0) return NULL;
+    return arena_memdup(ast_current_arena(), children, sizeof(ASTNode*) * (size_t)count);
+}
+
 ASTNode *ast_create_typedef(ASTNode *base_type, const char *alias_name);
 ASTNode *ast_create_struct(const char *name);
 ASTNode *ast_create_union(const char *name);
@@ -29,10 +81,9 @@ bool is_objc_object_type(DataType type) {
 
 // Basic AST creation functions
 ASTNode *ast_create_program(void) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_PROGRAM;
     node->data.program.declarations = NULL;
     node->data.program.declaration_count = 0;
@@ -41,13 +92,12 @@ ASTNode *ast_create_program(void) {
 }
 
 ASTNode *ast_create_function_decl(DataType return_type, const char *name, ASTNode **params, ASTNode *body) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_FUNCTION_DECLARATION;
     node->data.function_decl.return_type = return_type;
-    node->data.function_decl.name = strdup(name);
+    node->data.function_decl.name = intern_string(name);
     node->data.function_decl.parameters = params;
     node->data.function_decl.parameter_count = 0;
     node->data.function_decl.body = body;
@@ -56,12 +106,12 @@ ASTNode *ast_create_function_decl(DataType return_type, const char *name, ASTNod
 }
 
 ASTNode *ast_create_var_decl(DataType type, const char *name, ASTNode *initializer) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
     node->type = AST_VAR_DECL;
     node->data.var_decl.var_type = type;
-    node->data.var_decl.name = strdup(name);
+    node->data.var_decl.name = intern_string(name);
     node->data.var_decl.initializer = initializer;
     node->data.var_decl.type_node = NULL;
     node->data.var_decl.qualifiers = QUAL_NONE;  // ADD THIS
@@ -71,11 +121,21 @@ ASTNode *ast_create_var_decl(DataType type, const char *name, ASTNode *initializ
     return node;
 }
 
+ASTNode *ast_create_parameter(DataType param_type, const char *name) {
+    ASTNode *node = ast_alloc_node();
+    if (!node) return NULL;
+
+    node->type = AST_PARAMETER;
+    node->data.parameter.param_type = param_type;
+    node->data.parameter.name = intern_string(name ? name : "");
+
+    return node;
+}
+
 ASTNode *ast_create_compound_stmt(void) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_COMPOUND_STATEMENT;
     node->data.compound_stmt.statements = NULL;
     node->data.compound_stmt.statement_count = 0;
@@ -84,10 +144,9 @@ ASTNode *ast_create_compound_stmt(void) {
 }
 
 ASTNode *ast_create_expression_stmt(ASTNode *expr) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_EXPRESSION_STATEMENT;
     node->data.expression_stmt.expression = expr;
 
@@ -95,10 +154,9 @@ ASTNode *ast_create_expression_stmt(ASTNode *expr) {
 }
 
 ASTNode *ast_create_return_stmt(ASTNode *expr) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_RETURN_STATEMENT;
     node->data.return_stmt.expression = expr;
 
@@ -106,10 +164,9 @@ ASTNode *ast_create_return_stmt(ASTNode *expr) {
 }
 
 ASTNode *ast_create_if_stmt(ASTNode *condition, ASTNode *then_stmt, ASTNode *else_stmt) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_IF_STATEMENT;
     node->data.if_stmt.condition = condition;
     node->data.if_stmt.then_stmt = then_stmt;
@@ -119,10 +176,9 @@ ASTNode *ast_create_if_stmt(ASTNode *condition, ASTNode *then_stmt, ASTNode *els
 }
 
 ASTNode *ast_create_while_stmt(ASTNode *condition, ASTNode *body) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_WHILE_STATEMENT;
     node->data.while_stmt.condition = condition;
     node->data.while_stmt.body = body;
@@ -131,10 +187,9 @@ ASTNode *ast_create_while_stmt(ASTNode *condition, ASTNode *body) {
 }
 
 ASTNode *ast_create_for_stmt(ASTNode *init, ASTNode *condition, ASTNode *update, ASTNode *body) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_FOR_STATEMENT;
     node->data.for_stmt.init = init;
     node->data.for_stmt.condition = condition;
@@ -145,30 +200,27 @@ ASTNode *ast_create_for_stmt(ASTNode *init, ASTNode *condition, ASTNode *update,
 }
 
 ASTNode *ast_create_break_stmt(void) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_BREAK_STATEMENT;
 
     return node;
 }
 
 ASTNode *ast_create_continue_stmt(void) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_CONTINUE_STATEMENT;
 
     return node;
 }
 
 ASTNode *ast_create_binary_expr(TokenType op, ASTNode *left, ASTNode *right) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_BINARY_OP;
     node->data.binary_expr.operator = op;
     node->data.binary_expr.left = left;
@@ -178,10 +230,9 @@ ASTNode *ast_create_binary_expr(TokenType op, ASTNode *left, ASTNode *right) {
 }
 
 ASTNode *ast_create_unary_expr(TokenType op, ASTNode *operand) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_UNARY_OP;
     node->data.unary_expr.operator = op;
     node->data.unary_expr.operand = operand;
@@ -190,24 +241,22 @@ ASTNode *ast_create_unary_expr(TokenType op, ASTNode *operand) {
 }
 
 ASTNode *ast_create_assignment(const char *variable, ASTNode *value) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_ASSIGNMENT;
-    node->data.assignment.variable = strdup(variable);
+    node->data.assignment.variable = intern_string(variable);
     node->data.assignment.value = value;
 
     return node;
 }
 
 ASTNode *ast_create_call_expr(const char *function_name) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_FUNCTION_CALL;
-    node->data.call_expr.function_name = strdup(function_name);
+    node->data.call_expr.function_name = intern_string(function_name);
     node->data.call_expr.arguments = NULL;
     node->data.call_expr.argument_count = 0;
 
@@ -215,21 +264,19 @@ ASTNode *ast_create_call_expr(const char *function_name) {
 }
 
 ASTNode *ast_create_identifier(const char *name) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_IDENTIFIER;
-    node->data.identifier.name = strdup(name);
+    node->data.identifier.name = intern_string(name);
 
     return node;
 }
 
 ASTNode *ast_create_number(int value) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_NUMBER_LITERAL;
     node->data.number.value = value;
 
@@ -237,12 +284,11 @@ ASTNode *ast_create_number(int value) {
 }
 
 ASTNode *ast_create_string(const char *value) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_STRING_LITERAL;
-    node->data.string.value = strdup(value);
+    node->data.string.value = ast_strdup(value);
 
     return node;
 }
@@ -251,199 +297,64 @@ ASTNode *ast_create_string(const char *value) {
 void ast_add_declaration(ASTNode *program, ASTNode *declaration) {
     if (!program || program->type != AST_PROGRAM || !declaration) return;
 
+    program->data.program.declarations = ast_grow_children(program->data.program.declarations,
+        program->data.program.declaration_count);
     program->data.program.declaration_count++;
-    program->data.program.declarations = realloc(program->data.program.declarations,
-        sizeof(ASTNode*) * program->data.program.declaration_count);
     program->data.program.declarations[program->data.program.declaration_count - 1] = declaration;
 }
 
+void ast_add_parameter(ASTNode *function, ASTNode *parameter) {
+    if (!function || function->type != AST_FUNCTION_DECLARATION || !parameter) return;
+
+    function->data.function_decl.parameters = ast_grow_children(function->data.function_decl.parameters,
+        function->data.function_decl.parameter_count);
+    function->data.function_decl.parameter_count++;
+    function->data.function_decl.parameters[function->data.function_decl.parameter_count - 1] = parameter;
+}
+
 void ast_add_statement(ASTNode *compound, ASTNode *statement) {
     if (!compound || compound->type != AST_COMPOUND_STATEMENT || !statement) return;
 
+    compound->data.compound_stmt.statements = ast_grow_children(compound->data.compound_stmt.statements,
+        compound->data.compound_stmt.statement_count);
     compound->data.compound_stmt.statement_count++;
-    compound->data.compound_stmt.statements = realloc(compound->data.compound_stmt.statements,
-        sizeof(ASTNode*) * compound->data.compound_stmt.statement_count);
     compound->data.compound_stmt.statements[compound->data.compound_stmt.statement_count - 1] = statement;
 }
 
 void ast_add_argument(ASTNode *call, ASTNode *argument) {
     if (!call || call->type != AST_FUNCTION_CALL || !argument) return;
 
+    call->data.call_expr.arguments = ast_grow_children(call->data.call_expr.arguments,
+        call->data.call_expr.argument_count);
     call->data.call_expr.argument_count++;
-    call->data.call_expr.arguments = realloc(call->data.call_expr.arguments,
-        sizeof(ASTNode*) * call->data.call_expr.argument_count);
     call->data.call_expr.arguments[call->data.call_expr.argument_count - 1] = argument;
 }
 
 // AST destruction function
+// Nodes, child arrays and literals all live in the AST arena, so releasing the
+// program root frees the whole translation unit at once. Destroying any other
+// subtree is a no-op; its storage goes away together with the program.
 void ast_destroy(ASTNode *node) {
-    if (!node) return;
-
-    switch (node->type) {
-        case AST_PROGRAM:
-            for (int i = 0; i < node->data.program.declaration_count; i++) {
-                ast_destroy(node->data.program.declarations[i]);
-            }
-            free(node->data.program.declarations);
-            break;
-
-        case AST_FUNCTION_DECLARATION:
-            free(node->data.function_decl.name);
-            if (node->data.function_decl.parameters) {
-                for (int i = 0; i < node->data.function_decl.parameter_count; i++) {
-                    ast_destroy(node->data.function_decl.parameters[i]);
-                }
-                free(node->data.function_decl.parameters);
-            }
-            ast_destroy(node->data.function_decl.body);
-            break;
-
-        case AST_VARIABLE_DECLARATION:
-            free(node->data.var_decl.name);
-            ast_destroy(node->data.var_decl.initializer);
-            break;
-
-        case AST_COMPOUND_STATEMENT:
-            for (int i = 0; i < node->data.compound_stmt.statement_count; i++) {
-                ast_destroy(node->data.compound_stmt.statements[i]);
-            }
-            free(node->data.compound_stmt.statements);
-            break;
-
-        case AST_EXPRESSION_STATEMENT:
-            ast_destroy(node->data.expression_stmt.expression);
-            break;
-
-        case AST_RETURN_STATEMENT:
-            ast_destroy(node->data.return_stmt.expression);
-            break;
-
-        case AST_IF_STATEMENT:
-            ast_destroy(node->data.if_stmt.condition);
-            ast_destroy(node->data.if_stmt.then_stmt);
-            ast_destroy(node->data.if_stmt.else_stmt);
-            break;
-
-        case AST_WHILE_STATEMENT:
-            ast_destroy(node->data.while_stmt.condition);
-            ast_destroy(node->data.while_stmt.body);
-            break;
-
-        case AST_FOR_STATEMENT:
-            ast_destroy(node->data.for_stmt.init);
-            ast_destroy(node->data.for_stmt.condition);
-            ast_destroy(node->data.for_stmt.update);
-            ast_destroy(node->data.for_stmt.body);
-            break;
-
-        case AST_BINARY_OP:
-            ast_destroy(node->data.binary_expr.left);
-            ast_destroy(node->data.binary_expr.right);
-            break;
-
-        case AST_UNARY_OP:
-            ast_destroy(node->data.unary_expr.operand);
-            break;
-
-        case AST_ASSIGNMENT:
-            free(node->data.assignment.variable);
-            ast_destroy(node->data.assignment.value);
-            break;
-
-        case AST_FUNCTION_CALL:
-            free(node->data.call_expr.function_name);
-            for (int i = 0; i < node->data.call_expr.argument_count; i++) {
-                ast_destroy(node->data.call_expr.arguments[i]);
-            }
-            free(node->data.call_expr.arguments);
-            break;
-
-        case AST_IDENTIFIER:
-            free(node->data.identifier.name);
-            break;
-
-        case AST_STRING_LITERAL:
-            free(node->data.string.value);
-            break;
-
-        case AST_OBJC_INTERFACE:
-            free(node->data.objc_interface.class_name);
-            free(node->data.objc_interface.superclass_name);
-            for (int i = 0; i < node->data.objc_interface.method_count; i++) {
-                ast_destroy(node->data.objc_interface.methods[i]);
-            }
-            free(node->data.objc_interface.methods);
-            for (int i = 0; i < node->data.objc_interface.property_count; i++) {
-                ast_destroy(node->data.objc_interface.properties[i]);
-            }
-            free(node->data.objc_interface.properties);
-            break;
-
-        case AST_OBJC_IMPLEMENTATION:
-            free(node->data.objc_implementation.class_name);
-            free(node->data.objc_implementation.category_name);
-            for (int i = 0; i < node->data.objc_implementation.method_count; i++) {
-                ast_destroy(node->data.objc_implementation.methods[i]);
-            }
-            free(node->data.objc_implementation.methods);
-            break;
-
-        case AST_OBJC_METHOD_DECLARATION:
-            free(node->data.objc_method.selector);
-            ast_destroy(node->data.objc_method.body);
-            break;
-
-        case AST_OBJC_PROPERTY_DECLARATION:
-            free(node->data.objc_property.property_name);
-            break;
-
-        case AST_OBJC_MESSAGE_SEND:
-            ast_destroy(node->data.objc_message.receiver);
-            free(node->data.objc_message.selector);
-            for (int i = 0; i < node->data.objc_message.argument_count; i++) {
-                ast_destroy(node->data.objc_message.arguments[i]);
-            }
-            free(node->data.objc_message.arguments);
-            break;
-
-        case AST_OBJC_STRING_LITERAL:
-            free(node->data.objc_string.value);
-            break;
-
-        case AST_OBJC_SELECTOR_EXPR:
-            free(node->data.objc_selector.selector_name);
-            break;
-
-        case AST_OBJC_PROTOCOL:
-            free(node->data.objc_protocol.protocol_name);
-            for (int i = 0; i < node->data.objc_protocol.method_count; i++) {
-                ast_destroy(node->data.objc_protocol.methods[i]);
-            }
-            free(node->data.objc_protocol.methods);
-            for (int i = 0; i < node->data.objc_protocol.property_count; i++) {
-                ast_destroy(node->data.objc_protocol.properties[i]);
-            }
-            free(node->data.objc_protocol.properties);
-            break;
-
-        default:
-            // Handle other node types as needed
-            break;
-    }
+    if (!node || node->type != AST_PROGRAM) return;
 
-    free(node);
+    arena_destroy(ast_arena);
+    ast_arena = NULL;
+    ast_nodes = 0;
+}
+
+size_t ast_node_count(void) {
+    return ast_nodes;
 }
 
 // Objective-C Interface
 ASTNode *ast_create_objc_interface(const char *class_name, const char *superclass_name) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_INTERFACE;
 
-    node->data.objc_interface.class_name = strdup(class_name);
-    node->data.objc_interface.superclass_name = superclass_name ? strdup(superclass_name) : NULL;
+    node->data.objc_interface.class_name = intern_string(class_name);
+    node->data.objc_interface.superclass_name = intern_string(superclass_name);
     node->data.objc_interface.methods = NULL;
     node->data.objc_interface.method_count = 0;
     node->data.objc_interface.properties = NULL;
@@ -454,14 +365,13 @@ ASTNode *ast_create_objc_interface(const char *class_name, const char *superclas
 
 // Objective-C Implementation
 ASTNode *ast_create_objc_implementation(const char *class_name, const char *category_name) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_IMPLEMENTATION;
 
-    node->data.objc_implementation.class_name = strdup(class_name);
-    node->data.objc_implementation.category_name = category_name ? strdup(category_name) : NULL;
+    node->data.objc_implementation.class_name = intern_string(class_name);
+    node->data.objc_implementation.category_name = intern_string(category_name);
     node->data.objc_implementation.methods = NULL;
     node->data.objc_implementation.method_count = 0;
 
@@ -470,13 +380,12 @@ ASTNode *ast_create_objc_implementation(const char *class_name, const char *cate
 
 // Objective-C Protocol
 ASTNode *ast_create_objc_protocol(const char *protocol_name) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_PROTOCOL;
 
-    node->data.objc_protocol.protocol_name = strdup(protocol_name);
+    node->data.objc_protocol.protocol_name = intern_string(protocol_name);
     node->data.objc_protocol.methods = NULL;
     node->data.objc_protocol.method_count = 0;
 
@@ -485,15 +394,14 @@ ASTNode *ast_create_objc_protocol(const char *protocol_name) {
 
 // Objective-C Method
 ASTNode *ast_create_objc_method(ObjCMethodType method_type, DataType return_type, const char *selector, ASTNode *body) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_METHOD_DECLARATION;
 
     node->data.objc_method.method_type = method_type;
     node->data.objc_method.return_type = return_type;
-    node->data.objc_method.selector = strdup(selector);
+    node->data.objc_method.selector = intern_string(selector);
     node->data.objc_method.body = body;
 
     return node;
@@ -501,14 +409,13 @@ ASTNode *ast_create_objc_method(ObjCMethodType method_type, DataType return_type
 
 // Objective-C Property
 ASTNode *ast_create_objc_property(DataType property_type, const char *property_name, ObjCPropertyAttributes attributes) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_PROPERTY_DECLARATION;
 
     node->data.objc_property.property_type = property_type;
-    node->data.objc_property.property_name = strdup(property_name);
+    node->data.objc_property.property_name = intern_string(property_name);
     node->data.objc_property.attributes = attributes;
 
     return node;
@@ -516,41 +423,38 @@ ASTNode *ast_create_objc_property(DataType property_type, const char *property_n
 
 // Objective-C Synthesize
 ASTNode *ast_create_objc_synthesize(const char *property_name, const char *ivar_name) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_SYNTHESIZE;
 
     // Store property name in a simple way for now
-    node->data.string.value = strdup(property_name);
+    node->data.string.value = ast_strdup(property_name);
 
     return node;
 }
 
 // Objective-C Dynamic (stub)
 ASTNode *ast_create_objc_dynamic(const char *property_name) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_DYNAMIC;
 
-    node->data.string.value = strdup(property_name);
+    node->data.string.value = ast_strdup(property_name);
 
     return node;
 }
 
 // Objective-C Message Send
 ASTNode *ast_create_objc_message_send(ASTNode *receiver, const char *selector) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_MESSAGE_SEND;
 
     node->data.objc_message.receiver = receiver;
-    node->data.objc_message.selector = strdup(selector);
+    node->data.objc_message.selector = intern_string(selector);
     node->data.objc_message.arguments = NULL;
     node->data.objc_message.argument_count = 0;
 
@@ -559,23 +463,21 @@ ASTNode *ast_create_objc_message_send(ASTNode *receiver, const char *selector) {
 
 // Objective-C String Literal
 ASTNode *ast_create_objc_string(const char *value) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_STRING_LITERAL;
 
-    node->data.objc_string.value = strdup(value);
+    node->data.objc_string.value = ast_strdup(value);
 
     return node;
 }
 
 // Objective-C Boolean
 ASTNode *ast_create_objc_boolean(bool value) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_BOOLEAN_LITERAL;
 
     node->data.objc_boolean.value = value;
@@ -585,62 +487,57 @@ ASTNode *ast_create_objc_boolean(bool value) {
 
 // Objective-C nil
 ASTNode *ast_create_objc_nil(void) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_IDENTIFIER; // Treat as special identifier for now
 
-    node->data.identifier.name = strdup("nil");
+    node->data.identifier.name = intern_string("nil");
 
     return node;
 }
 
 // Objective-C self
 ASTNode *ast_create_objc_self(void) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_IDENTIFIER;
 
-    node->data.identifier.name = strdup("self");
+    node->data.identifier.name = intern_string("self");
 
     return node;
 }
 
 // Objective-C super
 ASTNode *ast_create_objc_super(void) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_IDENTIFIER;
 
-    node->data.identifier.name = strdup("super");
+    node->data.identifier.name = intern_string("super");
 
     return node;
 }
 
 // Objective-C Selector
 ASTNode *ast_create_objc_selector(const char *selector_name) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_SELECTOR_EXPR;
 
-    node->data.objc_selector.selector_name = strdup(selector_name);
+    node->data.objc_selector.selector_name = intern_string(selector_name);
 
     return node;
 }
 
 // Objective-C Encode
 ASTNode *ast_create_objc_encode(DataType type) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_ENCODE_EXPR;
 
     node->data_type = type;
@@ -650,14 +547,13 @@ ASTNode *ast_create_objc_encode(DataType type) {
 
 // Objective-C Try Statement
 ASTNode *ast_create_objc_try(ASTNode *try_body, ASTNode **catch_blocks, int catch_count, ASTNode *finally_block) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_TRY_STATEMENT;
 
     // Simplified - store just the try body for now
-    node->data.compound_stmt.statements = malloc(sizeof(ASTNode*));
+    node->data.compound_stmt.statements = ast_alloc_children(1);
     node->data.compound_stmt.statements[0] = try_body;
     node->data.compound_stmt.statement_count = 1;
 
@@ -666,13 +562,12 @@ ASTNode *ast_create_objc_try(ASTNode *try_body, ASTNode **catch_blocks, int catc
 
 // Objective-C Catch Block
 ASTNode *ast_create_objc_catch(DataType exception_type, const char *exception_var, ASTNode *catch_body) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_CATCH_STATEMENT;
 
-    node->data.compound_stmt.statements = malloc(sizeof(ASTNode*));
+    node->data.compound_stmt.statements = ast_alloc_children(1);
     node->data.compound_stmt.statements[0] = catch_body;
     node->data.compound_stmt.statement_count = 1;
 
@@ -681,10 +576,9 @@ ASTNode *ast_create_objc_catch(DataType exception_type, const char *exception_va
 
 // Objective-C Throw Statement
 ASTNode *ast_create_objc_throw(ASTNode *exception_expr) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_THROW_STATEMENT;
 
     node->data.expression_stmt.expression = exception_expr;
@@ -694,13 +588,12 @@ ASTNode *ast_create_objc_throw(ASTNode *exception_expr) {
 
 // Objective-C Synchronized Statement
 ASTNode *ast_create_objc_synchronized(ASTNode *sync_object, ASTNode *sync_body) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_SYNCHRONIZED_STATEMENT;
 
-    node->data.compound_stmt.statements = malloc(sizeof(ASTNode*));
+    node->data.compound_stmt.statements = ast_alloc_children(1);
     node->data.compound_stmt.statements[0] = sync_body;
     node->data.compound_stmt.statement_count = 1;
 
@@ -709,13 +602,12 @@ ASTNode *ast_create_objc_synchronized(ASTNode *sync_object, ASTNode *sync_body)
 
 // Objective-C Autoreleasepool Statement
 ASTNode *ast_create_objc_autoreleasepool(ASTNode *pool_body) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_OBJC_AUTORELEASEPOOL_STATEMENT;
 
-    node->data.compound_stmt.statements = malloc(sizeof(ASTNode*));
+    node->data.compound_stmt.statements = ast_alloc_children(1);
     node->data.compound_stmt.statements[0] = pool_body;
     node->data.compound_stmt.statement_count = 1;
 
@@ -724,10 +616,9 @@ ASTNode *ast_create_objc_autoreleasepool(ASTNode *pool_body) {
 
 // Property Access
 ASTNode *ast_create_property_access(ASTNode *object, const char *property_name) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_MEMBER_ACCESS;
 
     // Store in a simple way - you may need to adjust based on your AST structure
@@ -742,36 +633,36 @@ void ast_add_objc_interface_member(ASTNode *interface, ASTNode *member) {
     if (!interface || interface->type != AST_OBJC_INTERFACE || !member) return;
 
     // Simple implementation - expand arrays as needed
+    interface->data.objc_interface.methods = ast_grow_children(interface->data.objc_interface.methods,
+        interface->data.objc_interface.method_count);
     interface->data.objc_interface.method_count++;
-    interface->data.objc_interface.methods = realloc(interface->data.objc_interface.methods,
-        sizeof(ASTNode*) * interface->data.objc_interface.method_count);
     interface->data.objc_interface.methods[interface->data.objc_interface.method_count - 1] = member;
 }
 
 void ast_add_objc_implementation_member(ASTNode *implementation, ASTNode *member) {
     if (!implementation || implementation->type != AST_OBJC_IMPLEMENTATION || !member) return;
 
+    implementation->data.objc_implementation.methods = ast_grow_children(implementation->data.objc_implementation.methods,
+        implementation->data.objc_implementation.method_count);
     implementation->data.objc_implementation.method_count++;
-    implementation->data.objc_implementation.methods = realloc(implementation->data.objc_implementation.methods,
-        sizeof(ASTNode*) * implementation->data.objc_implementation.method_count);
     implementation->data.objc_implementation.methods[implementation->data.objc_implementation.method_count - 1] = member;
 }
 
 void ast_add_objc_protocol_method(ASTNode *protocol, ASTNode *method) {
     if (!protocol || protocol->type != AST_OBJC_PROTOCOL || !method) return;
 
+    protocol->data.objc_protocol.methods = ast_grow_children(protocol->data.objc_protocol.methods,
+        protocol->data.objc_protocol.method_count);
     protocol->data.objc_protocol.method_count++;
-    protocol->data.objc_protocol.methods = realloc(protocol->data.objc_protocol.methods,
-        sizeof(ASTNode*) * protocol->data.objc_protocol.method_count);
     protocol->data.objc_protocol.methods[protocol->data.objc_protocol.method_count - 1] = method;
 }
 
 void ast_add_objc_protocol_property(ASTNode *protocol, ASTNode *property) {
     if (!protocol || protocol->type != AST_OBJC_PROTOCOL || !property) return;
 
+    protocol->data.objc_protocol.properties = ast_grow_children(protocol->data.objc_protocol.properties,
+        protocol->data.objc_protocol.property_count);
     protocol->data.objc_protocol.property_count++;
-    protocol->data.objc_protocol.properties = realloc(protocol->data.objc_protocol.properties,
-        sizeof(ASTNode*) * protocol->data.objc_protocol.property_count);
     protocol->data.objc_protocol.properties[protocol->data.objc_protocol.property_count - 1] = property;
 }
 
@@ -779,24 +670,22 @@ void ast_add_objc_protocol_property(ASTNode *protocol, ASTNode *property) {
 // Add these implementations to your ast.c file
 
 ASTNode *ast_create_typedef(ASTNode *base_type, const char *alias_name) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_TYPEDEF;
     node->data.typedef_decl.base_type = base_type;
-    node->data.typedef_decl.alias_name = strdup(alias_name);
+    node->data.typedef_decl.alias_name = intern_string(alias_name);
 
     return node;
 }
 
 ASTNode *ast_create_struct(const char *name) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_STRUCT;
-    node->data.struct_decl.name = name ? strdup(name) : NULL;
+    node->data.struct_decl.name = intern_string(name);
     node->data.struct_decl.members = NULL;
     node->data.struct_decl.member_count = 0;
 
@@ -804,12 +693,11 @@ ASTNode *ast_create_struct(const char *name) {
 }
 
 ASTNode *ast_create_union(const char *name) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_UNION;
-    node->data.union_decl.name = name ? strdup(name) : NULL;
+    node->data.union_decl.name = intern_string(name);
     node->data.union_decl.members = NULL;
     node->data.union_decl.member_count = 0;
 
@@ -817,12 +705,11 @@ ASTNode *ast_create_union(const char *name) {
 }
 
 ASTNode *ast_create_enum(const char *name) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_ENUM;
-    node->data.enum_decl.name = name ? strdup(name) : NULL;
+    node->data.enum_decl.name = intern_string(name);
     node->data.enum_decl.constants = NULL;
     node->data.enum_decl.constant_count = 0;
 
@@ -830,24 +717,23 @@ ASTNode *ast_create_enum(const char *name) {
 }
 
 ASTNode *ast_create_enum_constant(const char *name, int value) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_ENUM_CONSTANT;
-    node->data.enum_constant.name = strdup(name);
+    node->data.enum_constant.name = intern_string(name);
     node->data.enum_constant.value = value;
 
     return node;
 }
 
 ASTNode *ast_create_struct_member(DataType type, const char *name, int bitfield_width) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
     node->type = AST_STRUCT_MEMBER;
     node->data.struct_member.type = type;
-    node->data.struct_member.name = strdup(name);
+    node->data.struct_member.name = intern_string(name);
     node->data.struct_member.bitfield_width = bitfield_width;
     node->data.struct_member.type_node = NULL;
     node->data.struct_member.qualifiers = QUAL_NONE;  // ADD THIS
@@ -856,10 +742,9 @@ ASTNode *ast_create_struct_member(DataType type, const char *name, int bitfield_
 }
 
 ASTNode *ast_create_basic_type(DataType type) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_BASIC_TYPE;
     node->data.basic_type.type = type;
 
@@ -867,12 +752,11 @@ ASTNode *ast_create_basic_type(DataType type) {
 }
 
 ASTNode *ast_create_var_decl_with_type_node(ASTNode *type_node, const char *name) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
-    memset(node, 0, sizeof(ASTNode));
     node->type = AST_VARIABLE_DECLARATION;
-    node->data.var_decl.name = strdup(name);
+    node->data.var_decl.name = intern_string(name);
     node->data.var_decl.type_node = type_node;
     node->data.var_decl.initializer = NULL;
     node->data.var_decl.var_type = TYPE_UNKNOWN; // Will be determined from type_node
@@ -883,11 +767,9 @@ ASTNode *ast_create_var_decl_with_type_node(ASTNode *type_node, const char *name
 void ast_add_struct_member(ASTNode *struct_node, ASTNode *member) {
     if (!struct_node || struct_node->type != AST_STRUCT || !member) return;
 
+    struct_node->data.struct_decl.members = ast_grow_children(struct_node->data.struct_decl.members,
+        struct_node->data.struct_decl.member_count);
     struct_node->data.struct_decl.member_count++;
-    struct_node->data.struct_decl.members = realloc(
-        struct_node->data.struct_decl.members,
-        struct_node->data.struct_decl.member_count * sizeof(ASTNode*)
-    );
 
     if (struct_node->data.struct_decl.members) {
         struct_node->data.struct_decl.members[struct_node->data.struct_decl.member_count - 1] = member;
@@ -897,11 +779,9 @@ void ast_add_struct_member(ASTNode *struct_node, ASTNode *member) {
 void ast_add_union_member(ASTNode *union_node, ASTNode *member) {
     if (!union_node || union_node->type != AST_UNION || !member) return;
 
+    union_node->data.union_decl.members = ast_grow_children(union_node->data.union_decl.members,
+        union_node->data.union_decl.member_count);
     union_node->data.union_decl.member_count++;
-    union_node->data.union_decl.members = realloc(
-        union_node->data.union_decl.members,
-        union_node->data.union_decl.member_count * sizeof(ASTNode*)
-    );
 
     if (union_node->data.union_decl.members) {
         union_node->data.union_decl.members[union_node->data.union_decl.member_count - 1] = member;
@@ -911,11 +791,9 @@ void ast_add_union_member(ASTNode *union_node, ASTNode *member) {
 void ast_add_enum_constant(ASTNode *enum_node, ASTNode *constant) {
     if (!enum_node || enum_node->type != AST_ENUM || !constant) return;
 
+    enum_node->data.enum_decl.constants = ast_grow_children(enum_node->data.enum_decl.constants,
+        enum_node->data.enum_decl.constant_count);
     enum_node->data.enum_decl.constant_count++;
-    enum_node->data.enum_decl.constants = realloc(
-        enum_node->data.enum_decl.constants,
-        enum_node->data.enum_decl.constant_count * sizeof(ASTNode*)
-    );
 
     if (enum_node->data.enum_decl.constants) {
         enum_node->data.enum_decl.constants[enum_node->data.enum_decl.constant_count - 1] = constant;
@@ -939,7 +817,7 @@ void ast_set_member_type_node(ASTNode *member, ASTNode *type_node) {
 // Create array declaration AST node
 ASTNode* ast_create_array_declaration(ASTNode* element_type, ASTNode* size_expr,
                                      int is_dynamic, int line, int column) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_alloc_node();
     if (!node) return NULL;
 
     node->type = AST_ARRAY_DECLARATION;
@@ -953,7 +831,7 @@ ASTNode* ast_create_array_declaration(ASTNode* element_type, ASTNode* size_expr,
     node->data.array_decl.dimension_count = 1;
 
     // Allocate and set single dimension
-    node->data.array_decl.dimensions = malloc(sizeof(ASTNode*));
+    node->data.array_decl.dimensions = ast_alloc_children(1);
     node->data.array_decl.dimensions[0] = size_expr;
 
     return node;
@@ -963,7 +841,7 @@ ASTNode* ast_create_array_declaration(ASTNode* element_type, ASTNode* size_expr,
 ASTNode* ast_create_multidim_array_declaration(ASTNode* element_type,
                                               ASTNode** dimensions, int dim_count,
                                               int line, int column) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_alloc_node();
     if (!node) return NULL;
 
     node->type = AST_ARRAY_DECLARATION;
@@ -975,7 +853,7 @@ ASTNode* ast_create_multidim_array_declaration(ASTNode* element_type,
     node->data.array_decl.size_expr = (dim_count > 0) ? dimensions[0] : NULL;
     node->data.array_decl.is_dynamic = 0;  // Multidim arrays are typically static
     node->data.array_decl.dimension_count = dim_count;
-    node->data.array_decl.dimensions = dimensions;
+    node->data.array_decl.dimensions = ast_copy_children(dimensions, dim_count);
 
     return node;
 }
@@ -983,7 +861,7 @@ ASTNode* ast_create_multidim_array_declaration(ASTNode* element_type,
 // Create array access AST node
 ASTNode* ast_create_array_access(ASTNode* array_expr, ASTNode* index_expr,
                                 int line, int column) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_alloc_node();
     if (!node) return NULL;
 
     node->type = AST_ARRAY_ACCESS;
@@ -1000,7 +878,7 @@ ASTNode* ast_create_array_access(ASTNode* array_expr, ASTNode* index_expr,
 // Create array literal AST node
 ASTNode* ast_create_array_literal(ASTNode** elements, int element_count,
                                  int line, int column) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_alloc_node();
     if (!node) return NULL;
 
     node->type = AST_ARRAY_LITERAL;
@@ -1008,7 +886,7 @@ ASTNode* ast_create_array_literal(ASTNode** elements, int element_count,
     node->line = line;
     node->column = column;
 
-    node->data.array_literal.elements = elements;
+    node->data.array_literal.elements = ast_copy_children(elements, element_count);
     node->data.array_literal.element_count = element_count;
     node->data.array_literal.element_type = NULL; // Will be inferred
 
@@ -1017,7 +895,7 @@ ASTNode* ast_create_array_literal(ASTNode** elements, int element_count,
 
 // Create address-of operator AST node
 ASTNode* ast_create_address_of(ASTNode* operand, int line, int column) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_alloc_node();
     if (!node) return NULL;
 
     node->type = AST_ADDRESS_OF;
@@ -1032,7 +910,7 @@ ASTNode* ast_create_address_of(ASTNode* operand, int line, int column) {
 
 // Create pointer dereference AST node
 ASTNode* ast_create_pointer_dereference(ASTNode* operand, int line, int column) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_alloc_node();
     if (!node) return NULL;
 
     node->type = AST_POINTER_DEREFERENCE;
@@ -1046,67 +924,9 @@ ASTNode* ast_create_pointer_dereference(ASTNode* operand, int line, int column)
 }
 
 // Helper function to destroy array-related AST nodes
+// Array nodes are arena-owned like every other node; see ast_destroy().
 void ast_destroy_array_node(ASTNode* node) {
-    if (!node) return;
-
-    switch (node->type) {
-        case AST_ARRAY_DECLARATION:
-            if (node->data.array_decl.element_type) {
-                ast_destroy(node->data.array_decl.element_type);
-            }
-            if (node->data.array_decl.size_expr) {
-                ast_destroy(node->data.array_decl.size_expr);
-            }
-            if (node->data.array_decl.dimensions) {
-                for (int i = 0; i < node->data.array_decl.dimension_count; i++) {
-                    if (node->data.array_decl.dimensions[i]) {
-                        ast_destroy(node->data.array_decl.dimensions[i]);
-                    }
-                }
-                free(node->data.array_decl.dimensions);
-            }
-            break;
-
-        case AST_ARRAY_ACCESS:
-            if (node->data.array_access.array_expr) {
-                ast_destroy(node->data.array_access.array_expr);
-            }
-            if (node->data.array_access.index_expr) {
-                ast_destroy(node->data.array_access.index_expr);
-            }
-            break;
-
-        case AST_ARRAY_LITERAL:
-            if (node->data.array_literal.elements) {
-                for (int i = 0; i < node->data.array_literal.element_count; i++) {
-                    if (node->data.array_literal.elements[i]) {
-                        ast_destroy(node->data.array_literal.elements[i]);
-                    }
-                }
-                free(node->data.array_literal.elements);
-            }
-            if (node->data.array_literal.element_type) {
-                ast_destroy(node->data.array_literal.element_type);
-            }
-            break;
-
-        case AST_ADDRESS_OF:
-            if (node->data.address_of.operand) {
-                ast_destroy(node->data.address_of.operand);
-            }
-            break;
-
-        case AST_POINTER_DEREFERENCE:
-            if (node->data.pointer_deref.operand) {
-                ast_destroy(node->data.pointer_deref.operand);
-            }
-            break;
-
-        default:
-            break;
-    }
-
-    free(node);
+    ast_destroy(node);
 }
 
 /* ============================================
@@ -1117,7 +937,7 @@ void ast_destroy_array_node(ASTNode* node) {
 
 ASTNode* ast_create_arc_var_decl(DataType type, const char* name,
                                  ASTNode* initializer, ARCQualifier qualifier) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = ast_alloc_node();
     if (!node) return NULL;
 
     node->type = AST_VAR_DECL;
@@ -1136,7 +956,7 @@ ASTNode* ast_create_arc_var_decl(DataType type, const char* name,
     node->arc_info.retain_count = 0;
 
     node->data.var_decl.var_type = type;
-    node->data.var_decl.name = strdup(name);
+    node->data.var_decl.name = intern_string(name);
     node->data.var_decl.initializer = initializer;
     node->data.var_decl.type_node = NULL;
 
@@ -1144,7 +964,7 @@ ASTNode* ast_create_arc_var_decl(DataType type, const char* name,
 }
 
 ASTNode *ast_create_switch_stmt(ASTNode *expression) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
     node->type = AST_SWITCH_STATEMENT;
@@ -1156,7 +976,7 @@ ASTNode *ast_create_switch_stmt(ASTNode *expression) {
 }
 
 ASTNode *ast_create_case_stmt(ASTNode *value, bool is_default) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node();
     if (!node) return NULL;
 
     node->type = AST_CASE_STATEMENT;
@@ -1171,21 +991,17 @@ ASTNode *ast_create_case_stmt(ASTNode *value, bool is_default) {
 void ast_add_case_to_switch(ASTNode *switch_node, ASTNode *case_node) {
     if (!switch_node || !case_node) return;
 
+    switch_node->data.switch_stmt.cases = ast_grow_children(switch_node->data.switch_stmt.cases,
+        switch_node->data.switch_stmt.case_count);
     switch_node->data.switch_stmt.case_count++;
-    switch_node->data.switch_stmt.cases = realloc(
-        switch_node->data.switch_stmt.cases,
-        sizeof(ASTNode*) * switch_node->data.switch_stmt.case_count
-    );
     switch_node->data.switch_stmt.cases[switch_node->data.switch_stmt.case_count - 1] = case_node;
 }
 
 void ast_add_statement_to_case(ASTNode *case_node, ASTNode *stmt) {
     if (!case_node || !stmt) return;
 
+    case_node->data.case_stmt.statements = ast_grow_children(case_node->data.case_stmt.statements,
+        case_node->data.case_stmt.statement_count);
     case_node->data.case_stmt.statement_count++;
-    case_node->data.case_stmt.statements = realloc(
-        case_node->data.case_stmt.statements,
-        sizeof(ASTNode*) * case_node->data.case_stmt.statement_count
-    );
     case_node->data.case_stmt.statements[case_node->data.case_stmt.statement_count - 1] = stmt;
 }
@@ -74,9 +74,7 @@ void preprocessor_add_builtin_macros(Preprocessor *pp) {
 #endif
 
     // Mark as predefined
-    for (int i = 0; i < pp->macro_count; i++) {
-        pp->macros[i].is_predefined = true;
-    }
+    preprocessor_mark_predefined(pp);
 }
 
 // Add user-defined macros
@@ -46,6 +46,8 @@
 #include <stdarg.h>
 #include <ctype.h>  // Might be needed for character checking
 #include "symbol_table.h"
+#include "codegen.h"
+#include "x86_64_assembler.h"
 
 
 
@@ -246,21 +248,59 @@ CodeGenerator *codegen_create(const char *output_filename) {
         free(codegen);
         return NULL;
     }
+    if (!asm_buffer_init(&codegen->output, codegen->output_file)) {
+        fclose(codegen->output_file);
+        free(codegen);
+        return NULL;
+    }
 
+    codegen->assembler = NULL;
+    codegen->object_file = NULL;
     codegen->label_counter = 0;
     codegen->temp_counter = 0;
+    codegen->frame_size = 0;
+    codegen->frameless = false;
     codegen->objc_mode = false;
     codegen->symbol_table = symbol_table_create();
 
     return codegen;
 }
 
+#if TARGET_X86_64
+// Same generation, but instructions go to the integrated assembler
+CodeGenerator *codegen_create_object(const char *object_filename) {
+    CodeGenerator *codegen = calloc(1, sizeof(CodeGenerator));
+    if (!codegen) {
+        return NULL;
+    }
+
+    codegen->assembler = x86_asm_create();
+    codegen->object_file = strdup(object_filename);
+    if (!codegen->assembler || !codegen->object_file) {
+        x86_asm_destroy(codegen->assembler);
+        free(codegen->object_file);
+        free(codegen);
+        return NULL;
+    }
+
+    codegen->objc_mode = false;
+    codegen->symbol_table = symbol_table_create();
+    return codegen;
+}
+#endif
+
 // And make sure your destroy function properly closes the file:
 void codegen_destroy(CodeGenerator *codegen) {
     if (codegen) {
         if (codegen->output_file) {
+            asm_buffer_flush(&codegen->output);
             fclose(codegen->output_file);
         }
+        asm_buffer_free(&codegen->output);
+#if TARGET_X86_64
+        x86_asm_destroy(codegen->assembler);
+#endif
+        free(codegen->object_file);
         if (codegen->symbol_table) {
             symbol_table_destroy(codegen->symbol_table);
         }
@@ -270,58 +310,179 @@ void codegen_destroy(CodeGenerator *codegen) {
 
 
 void codegen_emit(CodeGenerator *codegen, const char *format, ...) {
+#if TARGET_X86_64
+    // Instructions, labels and directives reach the integrated assembler
+    // through the helpers below; what is left here is comments
+    if (codegen->assembler) return;
+#endif
     va_list args;
     va_start(args, format);
-    vfprintf(codegen->output_file, format, args);
+    asm_buffer_vformat(&codegen->output, format, args);
     va_end(args);
-    fprintf(codegen->output_file, "\n");
+    asm_buffer_putc(&codegen->output, '\n');
 }
 
-char *codegen_new_label(CodeGenerator *codegen) {
-    char *label = malloc(32);
-    if (!label) {
-        error_fatal("Memory allocation failed for label");
-        return NULL;
+static void codegen_emit_label(CodeGenerator *codegen, const char *name) {
+#if TARGET_X86_64
+    if (codegen->assembler) {
+        x86_asm_label(codegen->assembler, name);
+        return;
     }
-    snprintf(label, 32, "L%d", codegen->label_counter++);
-    return label;
+#endif
+    codegen_emit(codegen, "%s:", name);
 }
 
-char *codegen_new_temp(CodeGenerator *codegen) {
-    char *temp = malloc(32);
-    if (!temp) {
-        error_fatal("Memory allocation failed for temp");
-        return NULL;
+static void codegen_emit_local_label(CodeGenerator *codegen, int label) {
+    char name[16];
+    snprintf(name, sizeof(name), "L%d", label);
+    codegen_emit_label(codegen, name);
+}
+
+static void codegen_emit_global(CodeGenerator *codegen, const char *name) {
+#if TARGET_X86_64
+    if (codegen->assembler) {
+        x86_asm_global(codegen->assembler, name);
+        return;
     }
-    snprintf(temp, 32, "t%d", codegen->temp_counter++);
-    return temp;
+#endif
+    codegen_emit(codegen, ".globl %s", name);
+}
+
+static void codegen_emit_section(CodeGenerator *codegen, const char *name) {
+#if TARGET_X86_64
+    if (codegen->assembler) {
+        x86_asm_section(codegen->assembler, name);
+        return;
+    }
+#endif
+    codegen_emit(codegen, ".section %s", name);
+}
+
+#if TARGET_X86_64
+// x86-64 instructions are built as X86Instruction values: the integrated
+// assembler encodes them as they are, and -S prints them as AT&T text
+static void codegen_x86(CodeGenerator *codegen, const X86Instruction *instruction) {
+    if (codegen->assembler) {
+        x86_asm_encode(codegen->assembler, instruction);
+        return;
+    }
+    asm_buffer_puts(&codegen->output, "    ");
+    x86_asm_format(&codegen->output, instruction);
+    asm_buffer_putc(&codegen->output, '\n');
+}
+
+static void codegen_x86_0(CodeGenerator *codegen, X86Opcode opcode) {
+    X86Instruction instruction = {.opcode = opcode};
+    codegen_x86(codegen, &instruction);
+}
+
+static void codegen_x86_1(CodeGenerator *codegen, X86Opcode opcode, int size,
+                          X86Operand operand) {
+    X86Instruction instruction = {.opcode = opcode, .size = size, .operands = {operand},
+                                  .operand_count = 1};
+    codegen_x86(codegen, &instruction);
+}
+
+// AT&T order: source, then destination
+static void codegen_x86_2(CodeGenerator *codegen, X86Opcode opcode, int size,
+                          X86Operand src, X86Operand dst) {
+    X86Instruction instruction = {.opcode = opcode, .size = size, .operands = {src, dst},
+                                  .operand_count = 2};
+    codegen_x86(codegen, &instruction);
+}
+
+// Zero- or sign-extends a from-byte source into a 64-bit register
+static void codegen_x86_extend(CodeGenerator *codegen, bool sign, int from, X86Operand src,
+                               int reg) {
+    X86Instruction instruction = {.opcode = sign ? X86_MOVSX : X86_MOVZX, .size = 8,
+                                  .source_size = from, .operands = {src, x86_reg(reg, 8)},
+                                  .operand_count = 2};
+    codegen_x86(codegen, &instruction);
+}
+
+// reg = condition ? 1 : 0
+static void codegen_x86_set(CodeGenerator *codegen, X86Condition condition, int reg) {
+    X86Instruction instruction = {.opcode = X86_SETCC, .condition = condition,
+                                  .operands = {x86_reg(reg, 1)}, .operand_count = 1};
+    codegen_x86(codegen, &instruction);
+    codegen_x86_extend(codegen, false, 1, x86_reg(reg, 1), reg);
+}
+
+static void codegen_x86_jump(CodeGenerator *codegen, int label) {
+    char name[16];
+    snprintf(name, sizeof(name), "L%d", label);
+    codegen_x86_1(codegen, X86_JMP, 0, x86_sym(name));
+}
+
+static void codegen_x86_branch(CodeGenerator *codegen, X86Condition condition, int label) {
+    char name[16];
+    snprintf(name, sizeof(name), "L%d", label);
+    X86Instruction instruction = {.opcode = X86_JCC, .condition = condition,
+                                  .operands = {x86_sym(name)}, .operand_count = 1};
+    codegen_x86(codegen, &instruction);
 }
 
+static bool codegen_x86_is_reg(const X86Operand *operand, int reg) {
+    return operand->kind == X86_OP_REG && operand->reg == reg;
+}
+#endif
+
+int codegen_new_label(CodeGenerator *codegen) {
+    return codegen->label_counter++;
+}
+
+int codegen_new_temp(CodeGenerator *codegen) {
+    return codegen->temp_counter++;
+}
+
+static bool codegen_generate_unit(CodeGenerator *codegen, ASTNode *ast);
+
 bool codegen_generate(CodeGenerator *codegen, ASTNode *ast) {
     if (!codegen || !ast) {
         return false;
     }
 
+    bool generated = codegen_generate_unit(codegen, ast);
+
+    // Assembly text is written in large blocks; this writes the last one
+    if (codegen->output_file && !asm_buffer_flush(&codegen->output)) {
+        fprintf(stderr, "Error: Failed to write assembly output\n");
+        return false;
+    }
+    return generated;
+}
+
+static bool codegen_generate_unit(CodeGenerator *codegen, ASTNode *ast) {
+
     // Generate assembly header
 #if TARGET_ARM64
     codegen_emit(codegen, "// Generated by KCC (ARM64/Apple Silicon) v%s", KCC_VERSION);
     codegen_emit(codegen, ".section __TEXT,__text,regular,pure_instructions");
     codegen_emit(codegen, ".build_version macos, 11, 0");
-    codegen_emit(codegen, ".globl _main");
     codegen_emit(codegen, ".p2align 2");
 #else
     codegen_emit(codegen, "# Generated by KCC (x86-64) v%s", KCC_VERSION);
-    codegen_emit(codegen, ".section __TEXT,__text,regular,pure_instructions");
-    codegen_emit(codegen, ".globl _main");
+    codegen_emit_section(codegen, "__TEXT,__text,regular,pure_instructions");
 #endif
     codegen_emit(codegen, "");
 
     // Generate code for the program
     codegen_program(codegen, ast);
 
-    // Generate main entry point
+    // Generate main entry point, only in the unit that defines main so
+    // several objects can be linked into one program
+    if (!codegen_defines_main(ast)) {
+#if !TARGET_ARM64
+        if (codegen->assembler) {
+            return x86_asm_write_object(codegen->assembler, codegen->object_file);
+        }
+#endif
+        return true;
+    }
+
     codegen_emit(codegen, "");
-    codegen_emit(codegen, "_main:");
+    codegen_emit_global(codegen, "_main");
+    codegen_emit_label(codegen, "_main");
 
 #if TARGET_ARM64
     codegen_emit(codegen, "    stp     fp, lr, [sp, #-16]!");
@@ -331,19 +492,35 @@ bool codegen_generate(CodeGenerator *codegen, ASTNode *ast) {
     codegen_emit(codegen, "    ldp     fp, lr, [sp], #16");
     codegen_emit(codegen, "    ret");
 #else
-    codegen_emit(codegen, "    pushq   %%rbp");
-    codegen_emit(codegen, "    movq    %%rsp, %%rbp");
-    codegen_emit(codegen, "    callq   _main_func");
-    codegen_emit(codegen, "    movq    $0x2000001, %%rax");
-    codegen_emit(codegen, "    movq    $0, %%rdi");
-    codegen_emit(codegen, "    syscall");
-    codegen_emit(codegen, "    popq    %%rbp");
-    codegen_emit(codegen, "    retq");
+    codegen_x86_1(codegen, X86_PUSH, 8, x86_reg(X86_RBP, 8));
+    codegen_x86_2(codegen, X86_MOV, 8, x86_reg(X86_RSP, 8), x86_reg(X86_RBP, 8));
+    codegen_x86_1(codegen, X86_CALL, 0, x86_sym("_main_func"));
+    codegen_x86_2(codegen, X86_MOV, 8, x86_imm(0x2000001), x86_reg(X86_RAX, 8));
+    codegen_x86_2(codegen, X86_MOV, 8, x86_imm(0), x86_reg(X86_RDI, 8));
+    codegen_x86_0(codegen, X86_SYSCALL);
+    codegen_x86_1(codegen, X86_POP, 8, x86_reg(X86_RBP, 8));
+    codegen_x86_0(codegen, X86_RET);
+
+    if (codegen->assembler) {
+        return x86_asm_write_object(codegen->assembler, codegen->object_file);
+    }
 #endif
 
     return true;
 }
 
+bool codegen_defines_main(ASTNode *program) {
+    const char *main_name = intern_string("main");
+    for (int i = 0; i < program->data.program.declaration_count; i++) {
+        ASTNode *decl = program->data.program.declarations[i];
+        if (decl->type == AST_FUNCTION_DECLARATION && decl->data.function_decl.body &&
+            decl->data.function_decl.name == main_name) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void codegen_program(CodeGenerator *codegen, ASTNode *node) {
     if (node->type != AST_PROGRAM) return;
 
@@ -358,46 +535,409 @@ void codegen_program(CodeGenerator *codegen, ASTNode *node) {
     }
 }
 
-void codegen_function_declaration(CodeGenerator *codegen, ASTNode *node) {
-    if (node->type != AST_FUNCTION_DECLARATION) return;
+// ============================================
+// REGISTERS
+// ============================================
 
-    codegen_emit(codegen, "");
+// Expression temporaries, taken from the caller-saved registers of the
+// TargetConfig tables (multiarch_codegen.c). x86-64 keeps rax (results,
+// idiv, spill reloads) and rdx (idiv) out of the set; ARM64 keeps w0-w7
+// for arguments and w16/w17 as scratch.
 #if TARGET_ARM64
-    codegen_emit(codegen, "// Function: %s", node->data.function_decl.name);
+static const char *const codegen_temps[] = {
+    "w9", "w10", "w11", "w12", "w13", "w14", "w15"
+};
+static const char *const codegen_temps64[] = {
+    "x9", "x10", "x11", "x12", "x13", "x14", "x15"
+};
+#define CODEGEN_SCRATCH "w16"
+#define CODEGEN_SCRATCH64 "x16"
+#define CODEGEN_SCRATCH2 "w17"
+#define CODEGEN_SCRATCH2_64 "x17"
 #else
-    codegen_emit(codegen, "# Function: %s", node->data.function_decl.name);
+static const int codegen_temps[] = {
+    X86_RCX, X86_RSI, X86_RDI, X86_R8, X86_R9, X86_R10, X86_R11
+};
+#define CODEGEN_SCRATCH X86_RAX
 #endif
+#define CODEGEN_TEMP_COUNT ((int)(sizeof(codegen_temps) / sizeof(codegen_temps[0])))
+
+static int codegen_register_need(CodeGenerator *codegen, ASTNode *node);
+static void codegen_expression_into(CodeGenerator *codegen, ASTNode *node, int reg);
+
+// ============================================
+// FRAME LAYOUT
+// ============================================
+
+// Locals are laid out once per function, before its prologue. A block
+// puts the variables it declares directly below those of the blocks
+// around it, widest first so that no padding is needed between them.
+// Sibling blocks start from the same offset, so variables whose
+// lifetimes do not overlap share slots; the frame is as deep as the
+// deepest block.
+//
+// A function that makes no calls and never spills keeps no frame at all:
+// its locals sit in the red zone below the stack pointer.
+
+#define CODEGEN_RED_ZONE 128
+
+static int codegen_type_size(DataType type) {
+    switch (type) {
+        case TYPE_CHAR:
+        case TYPE_SIGNED_CHAR:
+        case TYPE_UNSIGNED_CHAR:
+        case TYPE_BOOL:
+            return 1;
+        case TYPE_SHORT:
+        case TYPE_UNSIGNED_SHORT:
+            return 2;
+        case TYPE_INT:
+        case TYPE_UNSIGNED_INT:
+        case TYPE_FLOAT:
+        case TYPE_ENUM:
+            return 4;
+        default:
+            return 8;
+    }
+}
 
-    if (strcmp(node->data.function_decl.name, "main") == 0) {
-        codegen_emit(codegen, "_main_func:");
+static bool codegen_type_is_unsigned(DataType type) {
+    return type == TYPE_UNSIGNED_CHAR || type == TYPE_BOOL ||
+           type == TYPE_UNSIGNED_SHORT || type == TYPE_UNSIGNED_INT;
+}
+
+static DataType codegen_slot_type(ASTNode *node) {
+    return node->type == AST_PARAMETER ? node->data.parameter.param_type
+                                       : node->data.var_decl.var_type;
+}
+
+// Gives the variables and parameters among nodes slots below offset and
+// returns the new offset
+static int codegen_layout_slots(ASTNode **nodes, int count, int offset) {
+    for (int size = 8; size >= 1; size /= 2) {
+        for (int i = 0; i < count; i++) {
+            ASTNode *slot = nodes[i];
+            if ((slot->type != AST_VAR_DECL && slot->type != AST_PARAMETER) ||
+                codegen_type_size(codegen_slot_type(slot)) != size) {
+                continue;
+            }
+
+            offset = (offset + size + size - 1) & ~(size - 1);
+            if (slot->type == AST_PARAMETER) {
+                slot->data.parameter.frame_offset = -offset;
+            } else {
+                slot->data.var_decl.frame_offset = -offset;
+            }
+        }
+    }
+    return offset;
+}
+
+// Lays out the blocks in node below offset; returns the deepest offset
+static int codegen_layout_statement(ASTNode *node, int offset) {
+    if (!node) return offset;
+
+    int deepest = offset;
+    switch (node->type) {
+        case AST_COMPOUND_STATEMENT:
+            offset = codegen_layout_slots(node->data.compound_stmt.statements,
+                                          node->data.compound_stmt.statement_count, offset);
+            deepest = offset;
+            for (int i = 0; i < node->data.compound_stmt.statement_count; i++) {
+                int depth = codegen_layout_statement(node->data.compound_stmt.statements[i], offset);
+                if (depth > deepest) deepest = depth;
+            }
+            break;
+        case AST_IF_STATEMENT: {
+            deepest = codegen_layout_statement(node->data.if_stmt.then_stmt, offset);
+            int depth = codegen_layout_statement(node->data.if_stmt.else_stmt, offset);
+            if (depth > deepest) deepest = depth;
+            break;
+        }
+        case AST_WHILE_STATEMENT:
+            deepest = codegen_layout_statement(node->data.while_stmt.body, offset);
+            break;
+        case AST_FOR_STATEMENT:
+            deepest = codegen_layout_statement(node->data.for_stmt.body, offset);
+            break;
+        default:
+            break;
+    }
+    return deepest;
+}
+
+static bool codegen_expression_calls(ASTNode *node) {
+    if (!node) return false;
+
+    switch (node->type) {
+        case AST_FUNCTION_CALL:
+            return true;
+        case AST_BINARY_OP:
+            return codegen_expression_calls(node->data.binary_expr.left) ||
+                   codegen_expression_calls(node->data.binary_expr.right);
+        case AST_UNARY_OP:
+            return codegen_expression_calls(node->data.unary_expr.operand);
+        case AST_ASSIGNMENT:
+            return codegen_expression_calls(node->data.assignment.value);
+        default:
+            return false;
+    }
+}
+
+// Whether an expression calls out or runs out of temporaries, either of
+// which moves the stack pointer. Nothing is declared yet while this runs,
+// so variables count as needing a register: the estimate errs high.
+static bool codegen_expression_uses_stack(CodeGenerator *codegen, ASTNode *node) {
+    return node && (codegen_expression_calls(node) ||
+                    codegen_register_need(codegen, node) > CODEGEN_TEMP_COUNT);
+}
+
+static bool codegen_statement_uses_stack(CodeGenerator *codegen, ASTNode *node) {
+    if (!node) return false;
+
+    switch (node->type) {
+        case AST_COMPOUND_STATEMENT:
+            for (int i = 0; i < node->data.compound_stmt.statement_count; i++) {
+                if (codegen_statement_uses_stack(codegen, node->data.compound_stmt.statements[i])) {
+                    return true;
+                }
+            }
+            return false;
+        case AST_EXPRESSION_STATEMENT:
+            return codegen_expression_uses_stack(codegen, node->data.expression_stmt.expression);
+        case AST_RETURN_STATEMENT:
+            return codegen_expression_uses_stack(codegen, node->data.return_stmt.expression);
+        case AST_VAR_DECL:
+            return codegen_expression_uses_stack(codegen, node->data.var_decl.initializer);
+        case AST_IF_STATEMENT:
+            return codegen_expression_uses_stack(codegen, node->data.if_stmt.condition) ||
+                   codegen_statement_uses_stack(codegen, node->data.if_stmt.then_stmt) ||
+                   codegen_statement_uses_stack(codegen, node->data.if_stmt.else_stmt);
+        case AST_WHILE_STATEMENT:
+            return codegen_expression_uses_stack(codegen, node->data.while_stmt.condition) ||
+                   codegen_statement_uses_stack(codegen, node->data.while_stmt.body);
+        case AST_FOR_STATEMENT:
+            return codegen_expression_uses_stack(codegen, node->data.for_stmt.init) ||
+                   codegen_expression_uses_stack(codegen, node->data.for_stmt.condition) ||
+                   codegen_expression_uses_stack(codegen, node->data.for_stmt.update) ||
+                   codegen_statement_uses_stack(codegen, node->data.for_stmt.body);
+        default:
+            return false;
+    }
+}
+
+static void codegen_declare_variable(CodeGenerator *codegen, const char *name, SymbolType kind,
+                                     DataType type, int frame_offset) {
+    symbol_table_insert(codegen->symbol_table, name, kind, type);
+    Symbol *symbol = symbol_table_lookup_current_scope(codegen->symbol_table, name);
+    if (symbol) {
+        symbol->frame_offset = frame_offset;
+    }
+}
+
+#if TARGET_ARM64
+// Writes the memory operand for a variable's slot
+static void codegen_variable_address(CodeGenerator *codegen, const Symbol *symbol,
+                                     char *text, size_t size) {
+    if (symbol->frame_offset < -256) {
+        // Beyond the reach of an unscaled offset
+        codegen_emit(codegen, "    sub     %s, fp, #%d", CODEGEN_SCRATCH2_64, -symbol->frame_offset);
+        snprintf(text, size, "[%s]", CODEGEN_SCRATCH2_64);
+        return;
+    }
+    snprintf(text, size, "[%s, #%d]", codegen->frameless ? "sp" : "fp", symbol->frame_offset);
+}
+#else
+// The memory operand for a variable's slot
+static X86Operand codegen_variable_slot(CodeGenerator *codegen, const Symbol *symbol) {
+    return x86_mem(codegen->frameless ? X86_RSP : X86_RBP, symbol->frame_offset);
+}
+#endif
+
+// Loads a variable into temporary reg, extended to the register's width
+static void codegen_load_variable(CodeGenerator *codegen, const Symbol *symbol, int reg) {
+    bool is_unsigned = codegen_type_is_unsigned(symbol->data_type);
+
+#if TARGET_ARM64
+    char address[32];
+    codegen_variable_address(codegen, symbol, address, sizeof(address));
+    switch (codegen_type_size(symbol->data_type)) {
+        case 1:
+            codegen_emit(codegen, "    %s %s, %s", is_unsigned ? "ldrb   " : "ldrsb  ",
+                        codegen_temps[reg], address);
+            break;
+        case 2:
+            codegen_emit(codegen, "    %s %s, %s", is_unsigned ? "ldrh   " : "ldrsh  ",
+                        codegen_temps[reg], address);
+            break;
+        case 4:
+            codegen_emit(codegen, "    ldr     %s, %s", codegen_temps[reg], address);
+            break;
+        default:
+            codegen_emit(codegen, "    ldr     %s, %s", codegen_temps64[reg], address);
+            break;
+    }
+#else
+    X86Operand slot = codegen_variable_slot(codegen, symbol);
+    int size = codegen_type_size(symbol->data_type);
+    if (size == 8 || (size == 4 && is_unsigned)) {
+        // A 32-bit mov clears the upper half
+        codegen_x86_2(codegen, X86_MOV, size, slot, x86_reg(codegen_temps[reg], size));
     } else {
-        codegen_emit(codegen, "_%s:", node->data.function_decl.name);
+        codegen_x86_extend(codegen, !is_unsigned, size, slot, codegen_temps[reg]);
     }
+#endif
+}
 
-    // Function prologue
+// Stores temporary reg into a variable, truncated to the variable's size
+static void codegen_store_variable(CodeGenerator *codegen, const Symbol *symbol, int reg) {
 #if TARGET_ARM64
-    codegen_emit(codegen, "    stp     fp, lr, [sp, #-16]!");
-    codegen_emit(codegen, "    mov     fp, sp");
+    char address[32];
+    codegen_variable_address(codegen, symbol, address, sizeof(address));
+    switch (codegen_type_size(symbol->data_type)) {
+        case 1:
+            codegen_emit(codegen, "    strb    %s, %s", codegen_temps[reg], address);
+            break;
+        case 2:
+            codegen_emit(codegen, "    strh    %s, %s", codegen_temps[reg], address);
+            break;
+        case 4:
+            codegen_emit(codegen, "    str     %s, %s", codegen_temps[reg], address);
+            break;
+        default:
+            codegen_emit(codegen, "    str     %s, %s", codegen_temps64[reg], address);
+            break;
+    }
+#else
+    int size = codegen_type_size(symbol->data_type);
+    codegen_x86_2(codegen, X86_MOV, size, x86_reg(codegen_temps[reg], size),
+                  codegen_variable_slot(codegen, symbol));
+#endif
+}
+
+// Lays out the function's frame, emits its prologue and declares its
+// parameters. x86-64 arguments stay where the caller pushed them; ARM64
+// arguments arrive in x0-x7 and are stored to slots like locals.
+static void codegen_enter_function(CodeGenerator *codegen, ASTNode *node) {
+    ASTNode **parameters = node->data.function_decl.parameters;
+    int parameter_count = node->data.function_decl.parameter_count;
+    ASTNode *body = node->data.function_decl.body;
+
+#if TARGET_ARM64
+    int offset = codegen_layout_slots(parameters, parameter_count, 0);
 #else
-    codegen_emit(codegen, "    pushq   %%rbp");
-    codegen_emit(codegen, "    movq    %%rsp, %%rbp");
+    int offset = 0;
 #endif
+    int frame_size = (codegen_layout_statement(body, offset) + 15) & ~15;
+
+    codegen->frameless = frame_size <= CODEGEN_RED_ZONE &&
+                         !codegen_statement_uses_stack(codegen, body);
+    codegen->frame_size = codegen->frameless ? 0 : frame_size;
 
-    if (node->data.function_decl.body) {
-        codegen_compound_statement(codegen, node->data.function_decl.body);
+#if TARGET_ARM64
+    if (!codegen->frameless) {
+        codegen_emit(codegen, "    stp     fp, lr, [sp, #-16]!");
+        codegen_emit(codegen, "    mov     fp, sp");
+        if (frame_size > 4095) {
+            codegen_emit(codegen, "    mov     %s, #%d", CODEGEN_SCRATCH2_64, frame_size);
+            codegen_emit(codegen, "    sub     sp, sp, %s", CODEGEN_SCRATCH2_64);
+        } else if (frame_size > 0) {
+            codegen_emit(codegen, "    sub     sp, sp, #%d", frame_size);
+        }
+    }
+#else
+    if (!codegen->frameless) {
+        codegen_x86_1(codegen, X86_PUSH, 8, x86_reg(X86_RBP, 8));
+        codegen_x86_2(codegen, X86_MOV, 8, x86_reg(X86_RSP, 8), x86_reg(X86_RBP, 8));
+        if (frame_size > 0) {
+            codegen_x86_2(codegen, X86_SUB, 8, x86_imm(frame_size), x86_reg(X86_RSP, 8));
+        }
     }
+#endif
+
+    symbol_table_enter_scope(codegen->symbol_table);
+    for (int i = 0; i < parameter_count; i++) {
+        ASTNode *parameter = parameters[i];
+        if (!parameter->data.parameter.name[0]) continue;
+
+#if TARGET_ARM64
+        if (i >= 8) {
+            codegen_emit(codegen, "    // Parameter %s: only x0-x7 are supported",
+                        parameter->data.parameter.name);
+            continue;
+        }
+        codegen_declare_variable(codegen, parameter->data.parameter.name, SYMBOL_PARAMETER,
+                                 parameter->data.parameter.param_type,
+                                 parameter->data.parameter.frame_offset);
+        Symbol *symbol = symbol_table_lookup_current_scope(codegen->symbol_table,
+                                                           parameter->data.parameter.name);
+        char address[32];
+        codegen_variable_address(codegen, symbol, address, sizeof(address));
+        switch (codegen_type_size(parameter->data.parameter.param_type)) {
+            case 1: codegen_emit(codegen, "    strb    w%d, %s", i, address); break;
+            case 2: codegen_emit(codegen, "    strh    w%d, %s", i, address); break;
+            case 4: codegen_emit(codegen, "    str     w%d, %s", i, address); break;
+            default: codegen_emit(codegen, "    str     x%d, %s", i, address); break;
+        }
+#else
+        // Pushed right to left, above the return address (and saved rbp)
+        codegen_declare_variable(codegen, parameter->data.parameter.name, SYMBOL_PARAMETER,
+                                 TYPE_LONG, (codegen->frameless ? 8 : 16) + 8 * i);
+#endif
+    }
+}
+
+static void codegen_emit_epilogue(CodeGenerator *codegen) {
+#if TARGET_ARM64
+    if (!codegen->frameless) {
+        if (codegen->frame_size > 0) {
+            codegen_emit(codegen, "    mov     sp, fp");
+        }
+        codegen_emit(codegen, "    ldp     fp, lr, [sp], #16");
+    }
+    codegen_emit(codegen, "    ret");
+#else
+    if (!codegen->frameless) {
+        codegen_x86_2(codegen, X86_MOV, 8, x86_reg(X86_RBP, 8), x86_reg(X86_RSP, 8));
+        codegen_x86_1(codegen, X86_POP, 8, x86_reg(X86_RBP, 8));
+    }
+    codegen_x86_0(codegen, X86_RET);
+#endif
+}
+
+void codegen_function_declaration(CodeGenerator *codegen, ASTNode *node) {
+    if (node->type != AST_FUNCTION_DECLARATION) return;
+
+    // A prototype: the definition may be in another translation unit
+    if (!node->data.function_decl.body) return;
+
+    codegen_emit(codegen, "");
+#if TARGET_ARM64
+    codegen_emit(codegen, "// Function: %s", node->data.function_decl.name);
+#else
+    codegen_emit(codegen, "# Function: %s", node->data.function_decl.name);
+#endif
+
+    if (node->data.function_decl.name == intern_string("main")) {
+        codegen_emit_label(codegen, "_main_func");
+    } else {
+        char label[256];
+        snprintf(label, sizeof(label), "_%s", node->data.function_decl.name);
+        codegen_emit_global(codegen, label);
+        codegen_emit_label(codegen, label);
+    }
+
+    codegen_enter_function(codegen, node);
+    codegen_compound_statement(codegen, node->data.function_decl.body);
 
     // Function epilogue - default return 0
 #if TARGET_ARM64
     codegen_emit(codegen, "    mov     w0, #0");
-    codegen_emit(codegen, "    ldp     fp, lr, [sp], #16");
-    codegen_emit(codegen, "    ret");
 #else
-    codegen_emit(codegen, "    movq    $0, %%rax");
-    codegen_emit(codegen, "    movq    %%rbp, %%rsp");
-    codegen_emit(codegen, "    popq    %%rbp");
-    codegen_emit(codegen, "    retq");
+    codegen_x86_2(codegen, X86_MOV, 8, x86_imm(0), x86_reg(X86_RAX, 8));
 #endif
+    codegen_emit_epilogue(codegen);
+    symbol_table_exit_scope(codegen->symbol_table);
 }
 
 void codegen_variable_declaration(CodeGenerator *codegen, ASTNode *node) {
@@ -419,6 +959,26 @@ void codegen_variable_declaration(CodeGenerator *codegen, ASTNode *node) {
     }
 }
 
+// A local: its slot was assigned when the function's frame was laid out
+static void codegen_local_declaration(CodeGenerator *codegen, ASTNode *node) {
+    codegen_declare_variable(codegen, node->data.var_decl.name, SYMBOL_VARIABLE,
+                             node->data.var_decl.var_type, node->data.var_decl.frame_offset);
+    if (!node->data.var_decl.initializer) return;
+
+#if TARGET_ARM64
+    codegen_emit(codegen, "    // Variable: %s", node->data.var_decl.name);
+#else
+    codegen_emit(codegen, "    # Variable: %s", node->data.var_decl.name);
+#endif
+
+    Symbol *symbol = symbol_table_lookup_current_scope(codegen->symbol_table,
+                                                       node->data.var_decl.name);
+    codegen_expression_into(codegen, node->data.var_decl.initializer, 0);
+    if (symbol) {
+        codegen_store_variable(codegen, symbol, 0);
+    }
+}
+
 void codegen_statement(CodeGenerator *codegen, ASTNode *node) {
     switch (node->type) {
         case AST_COMPOUND_STATEMENT:
@@ -442,6 +1002,9 @@ void codegen_statement(CodeGenerator *codegen, ASTNode *node) {
         case AST_VARIABLE_DECLARATION:
             codegen_variable_declaration(codegen, node);
             break;
+        case AST_VAR_DECL:
+            codegen_local_declaration(codegen, node);
+            break;
         default:
 #if TARGET_ARM64
             codegen_emit(codegen, "    // Unsupported statement type: %s",
@@ -457,9 +1020,11 @@ void codegen_statement(CodeGenerator *codegen, ASTNode *node) {
 void codegen_compound_statement(CodeGenerator *codegen, ASTNode *node) {
     if (node->type != AST_COMPOUND_STATEMENT) return;
 
+    symbol_table_enter_scope(codegen->symbol_table);
     for (int i = 0; i < node->data.compound_stmt.statement_count; i++) {
         codegen_statement(codegen, node->data.compound_stmt.statements[i]);
     }
+    symbol_table_exit_scope(codegen->symbol_table);
 }
 
 void codegen_expression_statement(CodeGenerator *codegen, ASTNode *node) {
@@ -484,148 +1049,281 @@ void codegen_return_statement(CodeGenerator *codegen, ASTNode *node) {
 #if TARGET_ARM64
         codegen_emit(codegen, "    mov     w0, #0");
 #else
-        codegen_emit(codegen, "    movq    $0, %%rax");
+        codegen_x86_2(codegen, X86_MOV, 8, x86_imm(0), x86_reg(X86_RAX, 8));
 #endif
     }
 
-#if TARGET_ARM64
-    codegen_emit(codegen, "    ldp     fp, lr, [sp], #16");
-    codegen_emit(codegen, "    ret");
-#else
-    codegen_emit(codegen, "    movq    %%rbp, %%rsp");
-    codegen_emit(codegen, "    popq    %%rbp");
-    codegen_emit(codegen, "    retq");
-#endif
+    codegen_emit_epilogue(codegen);
 }
 
 void codegen_if_statement(CodeGenerator *codegen, ASTNode *node) {
     if (node->type != AST_IF_STATEMENT) return;
 
-    char *else_label = codegen_new_label(codegen);
-    char *end_label = codegen_new_label(codegen);
+    int else_label = codegen_new_label(codegen);
+    int end_label = codegen_new_label(codegen);
 
     codegen_expression(codegen, node->data.if_stmt.condition);
 #if TARGET_ARM64
     codegen_emit(codegen, "    cmp     w0, #0");
-    codegen_emit(codegen, "    b.eq    %s", else_label);
+    codegen_emit(codegen, "    b.eq    L%d", else_label);
 #else
-    codegen_emit(codegen, "    testq   %%rax, %%rax");
-    codegen_emit(codegen, "    jz      %s", else_label);
+    codegen_x86_2(codegen, X86_TEST, 8, x86_reg(X86_RAX, 8), x86_reg(X86_RAX, 8));
+    codegen_x86_branch(codegen, X86_CC_E, else_label);
 #endif
 
     codegen_statement(codegen, node->data.if_stmt.then_stmt);
 #if TARGET_ARM64
-    codegen_emit(codegen, "    b       %s", end_label);
+    codegen_emit(codegen, "    b       L%d", end_label);
 #else
-    codegen_emit(codegen, "    jmp     %s", end_label);
+    codegen_x86_jump(codegen, end_label);
 #endif
 
-    codegen_emit(codegen, "%s:", else_label);
+    codegen_emit_local_label(codegen, else_label);
     if (node->data.if_stmt.else_stmt) {
         codegen_statement(codegen, node->data.if_stmt.else_stmt);
     }
 
-    codegen_emit(codegen, "%s:", end_label);
-
-    free(else_label);
-    free(end_label);
+    codegen_emit_local_label(codegen, end_label);
 }
 
 void codegen_while_statement(CodeGenerator *codegen, ASTNode *node) {
     if (node->type != AST_WHILE_STATEMENT) return;
 
-    char *loop_label = codegen_new_label(codegen);
-    char *end_label = codegen_new_label(codegen);
+    int loop_label = codegen_new_label(codegen);
+    int end_label = codegen_new_label(codegen);
 
-    codegen_emit(codegen, "%s:", loop_label);
+    codegen_emit_local_label(codegen, loop_label);
 
     codegen_expression(codegen, node->data.while_stmt.condition);
 #if TARGET_ARM64
     codegen_emit(codegen, "    cmp     w0, #0");
-    codegen_emit(codegen, "    b.eq    %s", end_label);
+    codegen_emit(codegen, "    b.eq    L%d", end_label);
 #else
-    codegen_emit(codegen, "    testq   %%rax, %%rax");
-    codegen_emit(codegen, "    jz      %s", end_label);
+    codegen_x86_2(codegen, X86_TEST, 8, x86_reg(X86_RAX, 8), x86_reg(X86_RAX, 8));
+    codegen_x86_branch(codegen, X86_CC_E, end_label);
 #endif
 
     codegen_statement(codegen, node->data.while_stmt.body);
 #if TARGET_ARM64
-    codegen_emit(codegen, "    b       %s", loop_label);
+    codegen_emit(codegen, "    b       L%d", loop_label);
 #else
-    codegen_emit(codegen, "    jmp     %s", loop_label);
+    codegen_x86_jump(codegen, loop_label);
 #endif
 
-    codegen_emit(codegen, "%s:", end_label);
-
-    free(loop_label);
-    free(end_label);
+    codegen_emit_local_label(codegen, end_label);
 }
 
 void codegen_for_statement(CodeGenerator *codegen, ASTNode *node) {
     if (node->type != AST_FOR_STATEMENT) return;
 
-    char *loop_label = codegen_new_label(codegen);
-    char *update_label = codegen_new_label(codegen);
-    char *end_label = codegen_new_label(codegen);
+    int loop_label = codegen_new_label(codegen);
+    int update_label = codegen_new_label(codegen);
+    int end_label = codegen_new_label(codegen);
 
     if (node->data.for_stmt.init) {
         codegen_expression(codegen, node->data.for_stmt.init);
     }
 
-    codegen_emit(codegen, "%s:", loop_label);
+    codegen_emit_local_label(codegen, loop_label);
 
     if (node->data.for_stmt.condition) {
         codegen_expression(codegen, node->data.for_stmt.condition);
 #if TARGET_ARM64
         codegen_emit(codegen, "    cmp     w0, #0");
-        codegen_emit(codegen, "    b.eq    %s", end_label);
+        codegen_emit(codegen, "    b.eq    L%d", end_label);
 #else
-        codegen_emit(codegen, "    testq   %%rax, %%rax");
-        codegen_emit(codegen, "    jz      %s", end_label);
+        codegen_x86_2(codegen, X86_TEST, 8, x86_reg(X86_RAX, 8), x86_reg(X86_RAX, 8));
+        codegen_x86_branch(codegen, X86_CC_E, end_label);
 #endif
     }
 
     codegen_statement(codegen, node->data.for_stmt.body);
 
-    codegen_emit(codegen, "%s:", update_label);
+    codegen_emit_local_label(codegen, update_label);
     if (node->data.for_stmt.update) {
         codegen_expression(codegen, node->data.for_stmt.update);
     }
 #if TARGET_ARM64
-    codegen_emit(codegen, "    b       %s", loop_label);
+    codegen_emit(codegen, "    b       L%d", loop_label);
+#else
+    codegen_x86_jump(codegen, loop_label);
+#endif
+
+    codegen_emit_local_label(codegen, end_label);
+}
+
+// ============================================
+// EXPRESSIONS
+// ============================================
+
+// Expressions are evaluated into the temporaries listed above. A node is
+// given a base index: its value ends up in codegen_temps[base], and the
+// temporaries from base upwards are free for it to use. Operands are
+// visited in Sethi-Ullman order, so a tree uses as few temporaries as it
+// can and only goes through the stack when it needs more than there are.
+
+static bool codegen_is_comparison(TokenType op) {
+    return op == TOKEN_EQUAL || op == TOKEN_NOT_EQUAL || op == TOKEN_LESS ||
+           op == TOKEN_LESS_EQUAL || op == TOKEN_GREATER || op == TOKEN_GREATER_EQUAL;
+}
+
+// An instruction operand: assembly text on ARM64, an encodable operand on
+// x86-64
+#if TARGET_ARM64
+typedef struct CodegenOperand {
+    char text[32];
+} CodegenOperand;
+
+static CodegenOperand codegen_register_operand(const char *name) {
+    CodegenOperand operand;
+    snprintf(operand.text, sizeof(operand.text), "%s", name);
+    return operand;
+}
+
+#define codegen_temp_operand(reg) codegen_register_operand(codegen_temps[reg])
+#define codegen_scratch_operand() codegen_register_operand(CODEGEN_SCRATCH)
+#else
+typedef X86Operand CodegenOperand;
+
+#define codegen_temp_operand(reg) x86_reg(codegen_temps[reg], 8)
+#define codegen_scratch_operand() x86_reg(CODEGEN_SCRATCH, 8)
+#endif
+
+// Whether the instruction for op can take node as its right-hand operand
+// as is, with no register; if so and operand is given, writes the operand
+static bool codegen_direct_operand(CodeGenerator *codegen, ASTNode *node, TokenType op,
+                                   CodegenOperand *operand) {
+#if TARGET_ARM64
+    (void)codegen;
+    // add, sub and cmp take a 12-bit unsigned immediate
+    if (op != TOKEN_PLUS && op != TOKEN_MINUS && !codegen_is_comparison(op)) return false;
+    if (node->type != AST_NUMBER_LITERAL) return false;
+    if (node->data.number.value < 0 || node->data.number.value > 4095) return false;
+    if (operand) snprintf(operand->text, sizeof(operand->text), "#%d", node->data.number.value);
+    return true;
+#else
+    bool immediate;
+    switch (op) {
+        case TOKEN_PLUS:
+        case TOKEN_MINUS:
+        case TOKEN_MULTIPLY:
+        case TOKEN_BITWISE_AND:
+        case TOKEN_BITWISE_OR:
+        case TOKEN_BITWISE_XOR:
+            immediate = true;
+            break;
+        case TOKEN_DIVIDE:
+        case TOKEN_MODULO:
+            // idiv has no immediate form
+            immediate = false;
+            break;
+        default:
+            if (!codegen_is_comparison(op)) return false;
+            immediate = true;
+            break;
+    }
+
+    if (node->type == AST_NUMBER_LITERAL && immediate) {
+        if (operand) *operand = x86_imm(node->data.number.value);
+        return true;
+    }
+    if (node->type == AST_IDENTIFIER) {
+        // Only a full-width slot can be read as a 64-bit operand
+        Symbol *symbol = symbol_table_lookup(codegen->symbol_table, node->data.identifier.name);
+        if (!symbol || codegen_type_size(symbol->data_type) != 8) return false;
+        if (operand) *operand = codegen_variable_slot(codegen, symbol);
+        return true;
+    }
+    return false;
+#endif
+}
+
+// Temporaries needed to evaluate node without touching the stack
+static int codegen_register_need(CodeGenerator *codegen, ASTNode *node) {
+    switch (node->type) {
+        case AST_BINARY_OP: {
+            TokenType op = node->data.binary_expr.operator;
+            ASTNode *right = node->data.binary_expr.right;
+            int left_need = codegen_register_need(codegen, node->data.binary_expr.left);
+            if (op != TOKEN_AND && op != TOKEN_OR && codegen_direct_operand(codegen, right, op, NULL)) {
+                return left_need;
+            }
+
+            int right_need = codegen_register_need(codegen, right);
+            if (op == TOKEN_AND || op == TOKEN_OR) {
+                // Both sides are evaluated into the same register
+                return left_need > right_need ? left_need : right_need;
+            }
+            if (left_need == right_need) return left_need + 1;
+            return left_need > right_need ? left_need : right_need;
+        }
+        case AST_UNARY_OP:
+            return codegen_register_need(codegen, node->data.unary_expr.operand);
+        case AST_ASSIGNMENT:
+            return codegen_register_need(codegen, node->data.assignment.value);
+        case AST_FUNCTION_CALL:
+            // A call clobbers every temporary, so it is best evaluated first
+            return CODEGEN_TEMP_COUNT;
+        default:
+            return 1;
+    }
+}
+
+static void codegen_clear_temp(CodeGenerator *codegen, int reg) {
+#if TARGET_ARM64
+    codegen_emit(codegen, "    mov     %s, #0", codegen_temps[reg]);
 #else
-    codegen_emit(codegen, "    jmp     %s", loop_label);
+    codegen_x86_2(codegen, X86_MOV, 8, x86_imm(0), codegen_temp_operand(reg));
 #endif
+}
 
-    codegen_emit(codegen, "%s:", end_label);
+static void codegen_push_temp(CodeGenerator *codegen, int reg) {
+#if TARGET_ARM64
+    codegen_emit(codegen, "    str     %s, [sp, #-16]!", codegen_temps64[reg]);
+#else
+    codegen_x86_1(codegen, X86_PUSH, 8, codegen_temp_operand(reg));
+#endif
+}
 
-    free(loop_label);
-    free(update_label);
-    free(end_label);
+static void codegen_pop_temp(CodeGenerator *codegen, int reg) {
+#if TARGET_ARM64
+    codegen_emit(codegen, "    ldr     %s, [sp], #16", codegen_temps64[reg]);
+#else
+    codegen_x86_1(codegen, X86_POP, 8, codegen_temp_operand(reg));
+#endif
 }
 
 void codegen_expression(CodeGenerator *codegen, ASTNode *node) {
+    codegen_expression_into(codegen, node, 0);
+#if TARGET_ARM64
+    codegen_emit(codegen, "    mov     x0, %s", codegen_temps64[0]);
+#else
+    codegen_x86_2(codegen, X86_MOV, 8, codegen_temp_operand(0), x86_reg(X86_RAX, 8));
+#endif
+}
+
+static void codegen_expression_into(CodeGenerator *codegen, ASTNode *node, int reg) {
     switch (node->type) {
         case AST_BINARY_OP:
-            codegen_binary_expression(codegen, node);
+            codegen_binary_expression(codegen, node, reg);
             break;
         case AST_UNARY_OP:
-            codegen_unary_expression(codegen, node);
+            codegen_unary_expression(codegen, node, reg);
             break;
         case AST_FUNCTION_CALL:
-            codegen_call_expression(codegen, node);
+            codegen_call_expression(codegen, node, reg);
             break;
         case AST_IDENTIFIER:
-            codegen_identifier(codegen, node);
+            codegen_identifier(codegen, node, reg);
             break;
         case AST_NUMBER_LITERAL:
-            codegen_number(codegen, node);
+            codegen_number(codegen, node, reg);
             break;
         case AST_STRING_LITERAL:
-            codegen_string(codegen, node);
+            codegen_string(codegen, node, reg);
             break;
         case AST_ASSIGNMENT:
-            codegen_assignment(codegen, node);
+            codegen_assignment(codegen, node, reg);
             break;
         default:
 #if TARGET_ARM64
@@ -635,94 +1333,225 @@ void codegen_expression(CodeGenerator *codegen, ASTNode *node) {
             codegen_emit(codegen, "    # Unsupported expression type: %s",
                         ast_node_type_to_string(node->type));
 #endif
+            codegen_clear_temp(codegen, reg);
             break;
     }
 }
 
-void codegen_binary_expression(CodeGenerator *codegen, ASTNode *node) {
-    if (node->type != AST_BINARY_OP) return;
-
-    codegen_expression(codegen, node->data.binary_expr.left);
-#if TARGET_ARM64
-    codegen_emit(codegen, "    str     w0, [sp, #-16]!");
-#else
-    codegen_emit(codegen, "    pushq   %%rax");
-#endif
-
-    codegen_expression(codegen, node->data.binary_expr.right);
+// Temporary reg = lhs op rhs. lhs is a register and reg holds one of the
+// operands; rhs may also be an operand from codegen_direct_operand().
+static void codegen_binary_operation(CodeGenerator *codegen, TokenType op, int reg,
+                                     const CodegenOperand *lhs, const CodegenOperand *rhs) {
 #if TARGET_ARM64
-    codegen_emit(codegen, "    mov     w1, w0");
-    codegen_emit(codegen, "    ldr     w0, [sp], #16");
-#else
-    codegen_emit(codegen, "    movq    %%rax, %%rbx");
-    codegen_emit(codegen, "    popq    %%rax");
-#endif
+    const char *dst = codegen_temps[reg];
+    const char *mnemonic = NULL;
+    const char *condition = NULL;
+
+    switch (op) {
+        case TOKEN_PLUS:          mnemonic = "add     "; break;
+        case TOKEN_MINUS:         mnemonic = "sub     "; break;
+        case TOKEN_MULTIPLY:      mnemonic = "mul     "; break;
+        case TOKEN_DIVIDE:        mnemonic = "sdiv    "; break;
+        case TOKEN_BITWISE_AND:   mnemonic = "and     "; break;
+        case TOKEN_BITWISE_OR:    mnemonic = "orr     "; break;
+        case TOKEN_BITWISE_XOR:   mnemonic = "eor     "; break;
+        case TOKEN_EQUAL:         condition = "eq"; break;
+        case TOKEN_NOT_EQUAL:     condition = "ne"; break;
+        case TOKEN_LESS:          condition = "lt"; break;
+        case TOKEN_LESS_EQUAL:    condition = "le"; break;
+        case TOKEN_GREATER:       condition = "gt"; break;
+        case TOKEN_GREATER_EQUAL: condition = "ge"; break;
+        case TOKEN_MODULO:
+            codegen_emit(codegen, "    sdiv    %s, %s, %s", CODEGEN_SCRATCH2, lhs->text, rhs->text);
+            codegen_emit(codegen, "    msub    %s, %s, %s, %s", dst, CODEGEN_SCRATCH2, rhs->text,
+                        lhs->text);
+            return;
+        default:
+            codegen_emit(codegen, "    // Unsupported binary operator: %s",
+                        token_type_to_string(op));
+            codegen_clear_temp(codegen, reg);
+            return;
+    }
 
-    switch (node->data.binary_expr.operator) {
-        case TOKEN_PLUS:
-#if TARGET_ARM64
-            codegen_emit(codegen, "    add     w0, w0, w1");
+    if (condition) {
+        codegen_emit(codegen, "    cmp     %s, %s", lhs->text, rhs->text);
+        codegen_emit(codegen, "    cset    %s, %s", dst, condition);
+    } else {
+        codegen_emit(codegen, "    %s%s, %s, %s", mnemonic, dst, lhs->text, rhs->text);
+    }
 #else
-            codegen_emit(codegen, "    addq    %%rbx, %%rax");
-#endif
-            break;
+    X86Operand dst = codegen_temp_operand(reg);
+    X86Opcode opcode = X86_ADD;
+    X86Condition condition = X86_CC_E;
+    bool compare = false;
+
+    switch (op) {
+        case TOKEN_PLUS:          opcode = X86_ADD; break;
+        case TOKEN_MULTIPLY:      opcode = X86_IMUL; break;
+        case TOKEN_BITWISE_AND:   opcode = X86_AND; break;
+        case TOKEN_BITWISE_OR:    opcode = X86_OR; break;
+        case TOKEN_BITWISE_XOR:   opcode = X86_XOR; break;
+        case TOKEN_EQUAL:         compare = true; condition = X86_CC_E; break;
+        case TOKEN_NOT_EQUAL:     compare = true; condition = X86_CC_NE; break;
+        case TOKEN_LESS:          compare = true; condition = X86_CC_L; break;
+        case TOKEN_LESS_EQUAL:    compare = true; condition = X86_CC_LE; break;
+        case TOKEN_GREATER:       compare = true; condition = X86_CC_G; break;
+        case TOKEN_GREATER_EQUAL: compare = true; condition = X86_CC_GE; break;
         case TOKEN_MINUS:
-#if TARGET_ARM64
-            codegen_emit(codegen, "    sub     w0, w0, w1");
-#else
-            codegen_emit(codegen, "    subq    %%rbx, %%rax");
-#endif
-            break;
-        case TOKEN_MULTIPLY:
-#if TARGET_ARM64
-            codegen_emit(codegen, "    mul     w0, w0, w1");
-#else
-            codegen_emit(codegen, "    imulq   %%rbx, %%rax");
+            codegen_x86_2(codegen, X86_SUB, 8, *rhs, *lhs);
+            if (!codegen_x86_is_reg(lhs, dst.reg)) {
+                codegen_x86_2(codegen, X86_MOV, 8, *lhs, dst);
+            }
+            return;
+        case TOKEN_DIVIDE:
+        case TOKEN_MODULO:
+            if (codegen_x86_is_reg(rhs, CODEGEN_SCRATCH)) {
+                // The divisor was reloaded into rax, which the dividend needs
+                codegen_x86_1(codegen, X86_PUSH, 8, x86_reg(X86_RAX, 8));
+                codegen_x86_2(codegen, X86_MOV, 8, *lhs, x86_reg(X86_RAX, 8));
+                codegen_x86_0(codegen, X86_CQTO);
+                codegen_x86_1(codegen, X86_IDIV, 8, x86_mem(X86_RSP, 0));
+                codegen_x86_2(codegen, X86_ADD, 8, x86_imm(8), x86_reg(X86_RSP, 8));
+            } else {
+                if (!codegen_x86_is_reg(lhs, CODEGEN_SCRATCH)) {
+                    codegen_x86_2(codegen, X86_MOV, 8, *lhs, x86_reg(X86_RAX, 8));
+                }
+                codegen_x86_0(codegen, X86_CQTO);
+                codegen_x86_1(codegen, X86_IDIV, 8, *rhs);
+            }
+            codegen_x86_2(codegen, X86_MOV, 8, x86_reg(op == TOKEN_DIVIDE ? X86_RAX : X86_RDX, 8),
+                          dst);
+            return;
+        default:
+            codegen_emit(codegen, "    # Unsupported binary operator: %s",
+                        token_type_to_string(op));
+            codegen_clear_temp(codegen, reg);
+            return;
+    }
+
+    if (compare) {
+        codegen_x86_2(codegen, X86_CMP, 8, *rhs, *lhs);
+        codegen_x86_set(codegen, condition, dst.reg);
+    } else {
+        // Commutative: fold whichever operand is not already in dst
+        codegen_x86_2(codegen, opcode, 8, codegen_x86_is_reg(lhs, dst.reg) ? *rhs : *lhs, dst);
+    }
 #endif
-            break;
-        case TOKEN_GREATER:
+}
+
+// && and || only evaluate their right side when the left one does not
+// decide the result
+static void codegen_logical_expression(CodeGenerator *codegen, ASTNode *node, int reg) {
+    bool is_and = node->data.binary_expr.operator == TOKEN_AND;
+    int short_label = codegen_new_label(codegen);
+    int end_label = codegen_new_label(codegen);
+
+    codegen_expression_into(codegen, node->data.binary_expr.left, reg);
 #if TARGET_ARM64
-            codegen_emit(codegen, "    cmp     w0, w1");
-            codegen_emit(codegen, "    cset    w0, gt");
+    const char *dst = codegen_temps[reg];
+    codegen_emit(codegen, "    cmp     %s, #0", dst);
+    codegen_emit(codegen, "    %s    L%d", is_and ? "b.eq" : "b.ne", short_label);
+    codegen_expression_into(codegen, node->data.binary_expr.right, reg);
+    codegen_emit(codegen, "    cmp     %s, #0", dst);
+    codegen_emit(codegen, "    cset    %s, ne", dst);
+    codegen_emit(codegen, "    b       L%d", end_label);
+    codegen_emit_local_label(codegen, short_label);
+    codegen_emit(codegen, "    mov     %s, #%d", dst, is_and ? 0 : 1);
 #else
-            codegen_emit(codegen, "    cmpq    %%rbx, %%rax");
-            codegen_emit(codegen, "    setg    %%al");
-            codegen_emit(codegen, "    movzbq  %%al, %%rax");
+    X86Operand dst = codegen_temp_operand(reg);
+    codegen_x86_2(codegen, X86_TEST, 8, dst, dst);
+    codegen_x86_branch(codegen, is_and ? X86_CC_E : X86_CC_NE, short_label);
+    codegen_expression_into(codegen, node->data.binary_expr.right, reg);
+    codegen_x86_2(codegen, X86_TEST, 8, dst, dst);
+    codegen_x86_set(codegen, X86_CC_NE, dst.reg);
+    codegen_x86_jump(codegen, end_label);
+    codegen_emit_local_label(codegen, short_label);
+    codegen_x86_2(codegen, X86_MOV, 8, x86_imm(is_and ? 0 : 1), dst);
 #endif
-            break;
-        default:
+    codegen_emit_local_label(codegen, end_label);
+}
+
+void codegen_binary_expression(CodeGenerator *codegen, ASTNode *node, int reg) {
+    if (node->type != AST_BINARY_OP) return;
+
+    TokenType op = node->data.binary_expr.operator;
+    ASTNode *left = node->data.binary_expr.left;
+    ASTNode *right = node->data.binary_expr.right;
+
+    if (op == TOKEN_AND || op == TOKEN_OR) {
+        codegen_logical_expression(codegen, node, reg);
+        return;
+    }
+
+    CodegenOperand operand;
+    if (codegen_direct_operand(codegen, right, op, &operand)) {
+        codegen_expression_into(codegen, left, reg);
+        CodegenOperand lhs = codegen_temp_operand(reg);
+        codegen_binary_operation(codegen, op, reg, &lhs, &operand);
+        return;
+    }
+
+    // The side that needs more temporaries goes first: they are all free
+    // again by the time the other side is evaluated next to its result
+    bool left_first = codegen_register_need(codegen, left) >= codegen_register_need(codegen, right);
+    CodegenOperand first = codegen_temp_operand(reg);
+    CodegenOperand second;
+
+    codegen_expression_into(codegen, left_first ? left : right, reg);
+    if (reg + 1 < CODEGEN_TEMP_COUNT) {
+        codegen_expression_into(codegen, left_first ? right : left, reg + 1);
+        second = codegen_temp_operand(reg + 1);
+    } else {
+        // Out of temporaries: the first result waits on the stack
+        codegen_push_temp(codegen, reg);
+        codegen_expression_into(codegen, left_first ? right : left, reg);
 #if TARGET_ARM64
-            codegen_emit(codegen, "    // Unsupported binary operator: %s",
-                        token_type_to_string(node->data.binary_expr.operator));
+        codegen_emit(codegen, "    ldr     %s, [sp], #16", CODEGEN_SCRATCH64);
 #else
-            codegen_emit(codegen, "    # Unsupported binary operator: %s",
-                        token_type_to_string(node->data.binary_expr.operator));
+        codegen_x86_1(codegen, X86_POP, 8, codegen_scratch_operand());
 #endif
-            break;
+        first = codegen_scratch_operand();
+        second = codegen_temp_operand(reg);
     }
+
+    codegen_binary_operation(codegen, op, reg, left_first ? &first : &second,
+                             left_first ? &second : &first);
 }
 
-void codegen_unary_expression(CodeGenerator *codegen, ASTNode *node) {
+void codegen_unary_expression(CodeGenerator *codegen, ASTNode *node, int reg) {
     if (node->type != AST_UNARY_OP) return;
 
-    codegen_expression(codegen, node->data.unary_expr.operand);
+#if TARGET_ARM64
+    const char *dst = codegen_temps[reg];
+#else
+    X86Operand dst = codegen_temp_operand(reg);
+#endif
+    codegen_expression_into(codegen, node->data.unary_expr.operand, reg);
 
     switch (node->data.unary_expr.operator) {
+        case TOKEN_PLUS:
+            break;
         case TOKEN_MINUS:
 #if TARGET_ARM64
-            codegen_emit(codegen, "    neg     w0, w0");
+            codegen_emit(codegen, "    neg     %s, %s", dst, dst);
 #else
-            codegen_emit(codegen, "    negq    %%rax");
+            codegen_x86_1(codegen, X86_NEG, 8, dst);
 #endif
             break;
         case TOKEN_NOT:
 #if TARGET_ARM64
-            codegen_emit(codegen, "    cmp     w0, #0");
-            codegen_emit(codegen, "    cset    w0, eq");
+            codegen_emit(codegen, "    cmp     %s, #0", dst);
+            codegen_emit(codegen, "    cset    %s, eq", dst);
 #else
-            codegen_emit(codegen, "    testq   %%rax, %%rax");
-            codegen_emit(codegen, "    setz    %%al");
-            codegen_emit(codegen, "    movzbq  %%al, %%rax");
+            codegen_x86_2(codegen, X86_TEST, 8, dst, dst);
+            codegen_x86_set(codegen, X86_CC_E, dst.reg);
+#endif
+            break;
+        case TOKEN_BITWISE_NOT:
+#if TARGET_ARM64
+            codegen_emit(codegen, "    mvn     %s, %s", dst, dst);
+#else
+            codegen_x86_1(codegen, X86_NOT, 8, dst);
 #endif
             break;
         default:
@@ -733,83 +1562,137 @@ void codegen_unary_expression(CodeGenerator *codegen, ASTNode *node) {
             codegen_emit(codegen, "    # Unsupported unary operator: %s",
                         token_type_to_string(node->data.unary_expr.operator));
 #endif
+            codegen_clear_temp(codegen, reg);
             break;
     }
 }
 
-void codegen_call_expression(CodeGenerator *codegen, ASTNode *node) {
+void codegen_call_expression(CodeGenerator *codegen, ASTNode *node, int reg) {
     if (node->type != AST_FUNCTION_CALL) return;
 
+    int argument_count = node->data.call_expr.argument_count;
+    ASTNode **arguments = node->data.call_expr.arguments;
+
+    // Temporaries are caller-saved: keep the live ones across the call
+    for (int i = 0; i < reg; i++) {
+        codegen_push_temp(codegen, i);
+    }
+
 #if TARGET_ARM64
     // ARM64 calling convention uses x0-x7 for first 8 args
-    for (int i = 0; i < node->data.call_expr.argument_count && i < 8; i++) {
-        codegen_expression(codegen, node->data.call_expr.arguments[i]);
-        if (i > 0) {
-            codegen_emit(codegen, "    mov     x%d, x0", i);
+    int count = argument_count < 8 ? argument_count : 8;
+    if (count <= CODEGEN_TEMP_COUNT) {
+        // Each argument stays in its own temporary until all are done
+        for (int i = 0; i < count; i++) {
+            codegen_expression_into(codegen, arguments[i], i);
+        }
+        for (int i = 0; i < count; i++) {
+            codegen_emit(codegen, "    mov     x%d, %s", i, codegen_temps64[i]);
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            codegen_expression_into(codegen, arguments[i], 0);
+            codegen_push_temp(codegen, 0);
+        }
+        for (int i = count - 1; i >= 0; i--) {
+            codegen_emit(codegen, "    ldr     x%d, [sp], #16", i);
         }
     }
     codegen_emit(codegen, "    bl      _%s", node->data.call_expr.function_name);
+    codegen_emit(codegen, "    mov     %s, x0", codegen_temps64[reg]);
 #else
     // x86-64 - push args right to left
-    for (int i = node->data.call_expr.argument_count - 1; i >= 0; i--) {
-        codegen_expression(codegen, node->data.call_expr.arguments[i]);
-        codegen_emit(codegen, "    pushq   %%rax");
+    for (int i = argument_count - 1; i >= 0; i--) {
+        codegen_expression_into(codegen, arguments[i], 0);
+        codegen_push_temp(codegen, 0);
     }
-    codegen_emit(codegen, "    callq   _%s", node->data.call_expr.function_name);
-    if (node->data.call_expr.argument_count > 0) {
-        codegen_emit(codegen, "    addq    $%d, %%rsp",
-                    node->data.call_expr.argument_count * 8);
+    char target[256];
+    snprintf(target, sizeof(target), "_%s", node->data.call_expr.function_name);
+    codegen_x86_1(codegen, X86_CALL, 0, x86_sym(target));
+    if (argument_count > 0) {
+        codegen_x86_2(codegen, X86_ADD, 8, x86_imm(argument_count * 8), x86_reg(X86_RSP, 8));
     }
+    codegen_x86_2(codegen, X86_MOV, 8, x86_reg(X86_RAX, 8), codegen_temp_operand(reg));
 #endif
+
+    for (int i = reg - 1; i >= 0; i--) {
+        codegen_pop_temp(codegen, i);
+    }
 }
 
-void codegen_identifier(CodeGenerator *codegen, ASTNode *node) {
+void codegen_identifier(CodeGenerator *codegen, ASTNode *node, int reg) {
     if (node->type != AST_IDENTIFIER) return;
 
+    Symbol *symbol = symbol_table_lookup(codegen->symbol_table, node->data.identifier.name);
+    if (!symbol) {
+#if TARGET_ARM64
+        codegen_emit(codegen, "    // Unknown variable %s", node->data.identifier.name);
+#else
+        codegen_emit(codegen, "    # Unknown variable %s", node->data.identifier.name);
+#endif
+        codegen_clear_temp(codegen, reg);
+        return;
+    }
+
 #if TARGET_ARM64
     codegen_emit(codegen, "    // Load variable %s", node->data.identifier.name);
-    codegen_emit(codegen, "    ldr     w0, [fp, #-8]");
 #else
     codegen_emit(codegen, "    # Load variable %s", node->data.identifier.name);
-    codegen_emit(codegen, "    movq    -8(%%rbp), %%rax");
 #endif
+    codegen_load_variable(codegen, symbol, reg);
 }
 
-void codegen_number(CodeGenerator *codegen, ASTNode *node) {
+void codegen_number(CodeGenerator *codegen, ASTNode *node, int reg) {
     if (node->type != AST_NUMBER_LITERAL) return;
 
 #if TARGET_ARM64
-    codegen_emit(codegen, "    mov     w0, #%d", node->data.number.value);
+    codegen_emit(codegen, "    mov     %s, #%d", codegen_temps[reg], node->data.number.value);
 #else
-    codegen_emit(codegen, "    movq    $%d, %%rax", node->data.number.value);
+    codegen_x86_2(codegen, X86_MOV, 8, x86_imm(node->data.number.value),
+                  codegen_temp_operand(reg));
 #endif
 }
 
-void codegen_string(CodeGenerator *codegen, ASTNode *node) {
+void codegen_string(CodeGenerator *codegen, ASTNode *node, int reg) {
     if (node->type != AST_STRING_LITERAL) return;
 
 #if TARGET_ARM64
+    const char *dst = codegen_temps64[reg];
     codegen_emit(codegen, "    // String literal: \"%s\"", node->data.string.value);
-    codegen_emit(codegen, "    adrp    x0, string_literal_%d@PAGE", codegen->label_counter);
-    codegen_emit(codegen, "    add     x0, x0, string_literal_%d@PAGEOFF", codegen->label_counter++);
+    codegen_emit(codegen, "    adrp    %s, string_literal_%d@PAGE", dst, codegen->label_counter);
+    codegen_emit(codegen, "    add     %s, %s, string_literal_%d@PAGEOFF", dst, dst,
+                codegen->label_counter++);
 #else
     codegen_emit(codegen, "    # String literal: \"%s\"", node->data.string.value);
-    codegen_emit(codegen, "    movq    $string_literal_%d, %%rax", codegen->label_counter++);
+    char literal[32];
+    snprintf(literal, sizeof(literal), "string_literal_%d", codegen->label_counter++);
+    X86Operand address = x86_imm(0);
+    address.symbol = literal;
+    codegen_x86_2(codegen, X86_MOV, 8, address, codegen_temp_operand(reg));
 #endif
 }
 
-void codegen_assignment(CodeGenerator *codegen, ASTNode *node) {
+void codegen_assignment(CodeGenerator *codegen, ASTNode *node, int reg) {
     if (node->type != AST_ASSIGNMENT) return;
 
-    codegen_expression(codegen, node->data.assignment.value);
+    codegen_expression_into(codegen, node->data.assignment.value, reg);
+
+    Symbol *symbol = symbol_table_lookup(codegen->symbol_table, node->data.assignment.variable);
+    if (!symbol) {
+#if TARGET_ARM64
+        codegen_emit(codegen, "    // Unknown variable %s", node->data.assignment.variable);
+#else
+        codegen_emit(codegen, "    # Unknown variable %s", node->data.assignment.variable);
+#endif
+        return;
+    }
 
 #if TARGET_ARM64
     codegen_emit(codegen, "    // Assign to %s", node->data.assignment.variable);
-    codegen_emit(codegen, "    str     w0, [fp, #-8]");
 #else
     codegen_emit(codegen, "    # Assign to %s", node->data.assignment.variable);
-    codegen_emit(codegen, "    movq    %%rax, -8(%%rbp)");
 #endif
+    codegen_store_variable(codegen, symbol, reg);
 }
 
 /* ============================================
@@ -0,0 +1,440 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "compile_cache.h"
+
+#define COMPILE_CACHE_FORMAT "kcc-cache-1"
+#define COMPILE_CACHE_STATS_FILE "stats"
+#define COMPILE_CACHE_COPY_CHUNK (64 * 1024)
+
+// Eviction goes below the limit, so it does not run again on the next store
+#define COMPILE_CACHE_EVICT_TARGET(max) ((max) / 10 * 9)
+
+// Code generator the key is for; the same source gives different output
+// for different builds of kcc
+#if defined(TARGET_SATURN)
+#define COMPILE_CACHE_TARGET "saturn-sh2"
+#elif defined(TARGET_DREAMCAST)
+#define COMPILE_CACHE_TARGET "dreamcast-sh4"
+#elif defined(__aarch64__)
+#define COMPILE_CACHE_TARGET "arm64"
+#else
+#define COMPILE_CACHE_TARGET "x86_64"
+#endif
+
+typedef struct CompileCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;
+    uint64_t size;               // Bytes in entries
+} CompileCacheStats;
+
+// ========================================
+// Key
+// ========================================
+// Two independently seeded 64-bit lanes fed eight bytes at a time, each
+// finished with the splitmix64 avalanche: 128 bits is plenty for a cache
+// that only ever sees honest inputs.
+
+typedef struct CompileCacheHasher {
+    uint64_t lanes[2];
+    uint64_t length;
+} CompileCacheHasher;
+
+static uint64_t compile_cache_rotl(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+static uint64_t compile_cache_avalanche(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+static void compile_cache_mix(CompileCacheHasher *hasher, uint64_t word) {
+    hasher->lanes[0] = compile_cache_rotl(hasher->lanes[0] ^ (word * 0x87C37B91114253D5ull), 31) *
+                       0x9E3779B97F4A7C15ull;
+    hasher->lanes[1] = compile_cache_rotl(hasher->lanes[1] ^ (word * 0x4CF5AD432745937Full), 29) *
+                       0xC2B2AE3D27D4EB4Full;
+}
+
+static void compile_cache_hash(CompileCacheHasher *hasher, const void *data, size_t length) {
+    const unsigned char *bytes = data;
+    hasher->length += length;
+
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        compile_cache_mix(hasher, word);
+        bytes += 8;
+        length -= 8;
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, bytes, length);
+    compile_cache_mix(hasher, tail ^ ((uint64_t)length << 56));
+}
+
+// Strings are hashed with their terminator so neighbouring fields cannot
+// run into each other
+static void compile_cache_hash_string(CompileCacheHasher *hasher, const char *text) {
+    text = text ? text : "";
+    compile_cache_hash(hasher, text, strlen(text) + 1);
+}
+
+void compile_cache_key(const char *source, size_t length, const CompilerOptions *opts,
+                       bool object_output, char key[COMPILE_CACHE_KEY_SIZE]) {
+    CompileCacheHasher hasher = {{0x243F6A8885A308D3ull, 0x13198A2E03707344ull}, 0};
+
+    compile_cache_hash_string(&hasher, COMPILE_CACHE_FORMAT);
+    compile_cache_hash_string(&hasher, KCC_VERSION);
+    compile_cache_hash_string(&hasher, COMPILE_CACHE_TARGET);
+    compile_cache_hash_string(&hasher, opts ? opts->target_arch : NULL);
+    compile_cache_hash_string(&hasher, opts ? opts->target_platform : NULL);
+
+    unsigned char flags[3] = {
+        (unsigned char)(opts && opts->optimize),
+        (unsigned char)object_output,
+        (unsigned char)(opts && opts->use_multiarch),
+    };
+    compile_cache_hash(&hasher, flags, sizeof(flags));
+    compile_cache_hash(&hasher, source, length);
+
+    uint64_t high = compile_cache_avalanche(hasher.lanes[0] ^ hasher.length);
+    uint64_t low = compile_cache_avalanche(hasher.lanes[1] + high);
+    snprintf(key, COMPILE_CACHE_KEY_SIZE, "%016llx%016llx",
+             (unsigned long long)high, (unsigned long long)low);
+}
+
+// ========================================
+// Configuration
+// ========================================
+
+const char *compile_cache_default_dir(void) {
+    static char dir[PATH_MAX];
+    const char *env = getenv("KCC_CACHE_DIR");
+    if (env && *env) {
+        return env;
+    }
+
+    const char *cache_home = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (cache_home && *cache_home) {
+        snprintf(dir, sizeof(dir), "%s/kcc", cache_home);
+    } else if (home && *home) {
+        snprintf(dir, sizeof(dir), "%s/.cache/kcc", home);
+    } else {
+        snprintf(dir, sizeof(dir), "/tmp/kcc-cache-%lu", (unsigned long)getuid());
+    }
+    return dir;
+}
+
+uint64_t compile_cache_max_size(void) {
+    const char *env = getenv("KCC_CACHE_MAX_SIZE");
+    if (!env || !*env) {
+        return COMPILE_CACHE_DEFAULT_MAX_SIZE;
+    }
+
+    char *end;
+    unsigned long long size = strtoull(env, &end, 10);
+    switch (*end) {
+        case 'G': case 'g': size *= 1024; // fall through
+        case 'M': case 'm': size *= 1024; // fall through
+        case 'K': case 'k': size *= 1024; end++; break;
+        default: break;
+    }
+    if (*end != '\0' || size == 0) {
+        fprintf(stderr, "Warning: Ignoring invalid KCC_CACHE_MAX_SIZE '%s'\n", env);
+        return COMPILE_CACHE_DEFAULT_MAX_SIZE;
+    }
+    return size;
+}
+
+// ========================================
+// Files
+// ========================================
+
+static bool compile_cache_mkdir(const char *path) {
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+// Path of the entry for key; with create, makes dir and its two-digit
+// subdirectory first
+static char *compile_cache_entry_path(const char *dir, const char *key, bool create) {
+    char *path = malloc(strlen(dir) + COMPILE_CACHE_KEY_SIZE + 8);
+    if (!path) return NULL;
+
+    sprintf(path, "%s/%.2s", dir, key);
+    if (create && !(compile_cache_mkdir(dir) && compile_cache_mkdir(path))) {
+        free(path);
+        return NULL;
+    }
+    sprintf(path + strlen(path), "/%s", key + 2);
+    return path;
+}
+
+static bool compile_cache_copy(const char *from, const char *to) {
+    FILE *in = fopen(from, "rb");
+    if (!in) return false;
+    FILE *out = fopen(to, "wb");
+    if (!out) {
+        fclose(in);
+        return false;
+    }
+
+    char *buffer = malloc(COMPILE_CACHE_COPY_CHUNK);
+    bool ok = buffer != NULL;
+    size_t got;
+    while (ok && (got = fread(buffer, 1, COMPILE_CACHE_COPY_CHUNK, in)) > 0) {
+        ok = fwrite(buffer, 1, got, out) == got;
+    }
+    ok = ok && !ferror(in);
+
+    free(buffer);
+    fclose(in);
+    return fclose(out) == 0 && ok;
+}
+
+// ========================================
+// Statistics
+// ========================================
+// The stats file is locked for the whole read-modify-write, which also
+// serializes evictions.
+
+static int compile_cache_lock_stats(const char *dir, CompileCacheStats *stats) {
+    char *path = malloc(strlen(dir) + sizeof(COMPILE_CACHE_STATS_FILE) + 2);
+    if (!path) return -1;
+    sprintf(path, "%s/%s", dir, COMPILE_CACHE_STATS_FILE);
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    free(path);
+    if (fd < 0) return -1;
+    if (flock(fd, LOCK_EX) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    char text[512];
+    ssize_t got = pread(fd, text, sizeof(text) - 1, 0);
+    text[got > 0 ? got : 0] = '\0';
+    sscanf(text, "hits %llu misses %llu stores %llu evictions %llu size %llu",
+           (unsigned long long *)&stats->hits, (unsigned long long *)&stats->misses,
+           (unsigned long long *)&stats->stores, (unsigned long long *)&stats->evictions,
+           (unsigned long long *)&stats->size);
+    return fd;
+}
+
+static void compile_cache_unlock_stats(int fd, const CompileCacheStats *stats) {
+    char text[512];
+    int length = snprintf(text, sizeof(text),
+                          "hits %llu\nmisses %llu\nstores %llu\nevictions %llu\nsize %llu\n",
+                          (unsigned long long)stats->hits, (unsigned long long)stats->misses,
+                          (unsigned long long)stats->stores, (unsigned long long)stats->evictions,
+                          (unsigned long long)stats->size);
+    if (ftruncate(fd, 0) != 0 || pwrite(fd, text, (size_t)length, 0) != length) {
+        fprintf(stderr, "Warning: Could not update compile cache statistics\n");
+    }
+    close(fd);  // Also releases the lock
+}
+
+// ========================================
+// Lookup and store
+// ========================================
+
+bool compile_cache_fetch(const char *dir, const char *key, const char *output_path) {
+    char *path = compile_cache_entry_path(dir, key, false);
+    bool hit = path && compile_cache_copy(path, output_path);
+
+    // Touch the entry so eviction sees it as recently used
+    if (hit) {
+        utimes(path, NULL);
+    }
+    free(path);
+
+    CompileCacheStats stats;
+    if (compile_cache_mkdir(dir)) {
+        int fd = compile_cache_lock_stats(dir, &stats);
+        if (fd >= 0) {
+            if (hit) stats.hits++; else stats.misses++;
+            compile_cache_unlock_stats(fd, &stats);
+        }
+    }
+    return hit;
+}
+
+typedef struct CompileCacheEntry {
+    char *path;
+    time_t mtime;
+    uint64_t size;
+} CompileCacheEntry;
+
+static int compare_entry_age(const void *a, const void *b) {
+    const CompileCacheEntry *left = a;
+    const CompileCacheEntry *right = b;
+    return (left->mtime > right->mtime) - (left->mtime < right->mtime);
+}
+
+// Lists every entry with its age; the stats' size is recomputed from it
+static CompileCacheEntry *compile_cache_list(const char *dir, size_t *count, uint64_t *total) {
+    CompileCacheEntry *entries = NULL;
+    size_t capacity = 0;
+    *count = 0;
+    *total = 0;
+
+    DIR *top = opendir(dir);
+    if (!top) return NULL;
+
+    struct dirent *bucket;
+    while ((bucket = readdir(top))) {
+        if (strlen(bucket->d_name) != 2) continue;
+
+        char bucket_path[PATH_MAX];
+        if ((size_t)snprintf(bucket_path, sizeof(bucket_path), "%s/%s", dir, bucket->d_name) >=
+            sizeof(bucket_path)) {
+            continue;
+        }
+        DIR *sub = opendir(bucket_path);
+        if (!sub) continue;
+
+        struct dirent *file;
+        while ((file = readdir(sub))) {
+            if (file->d_name[0] == '.' || strlen(file->d_name) != COMPILE_CACHE_KEY_SIZE - 3) continue;
+
+            char path[PATH_MAX];
+            struct stat st;
+            if ((size_t)snprintf(path, sizeof(path), "%s/%s", bucket_path, file->d_name) >= sizeof(path) ||
+                stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+                continue;
+            }
+
+            if (*count == capacity) {
+                capacity = capacity ? capacity * 2 : 256;
+                CompileCacheEntry *grown = realloc(entries, capacity * sizeof(CompileCacheEntry));
+                if (!grown) break;
+                entries = grown;
+            }
+            entries[*count].path = strdup(path);
+            entries[*count].mtime = st.st_mtime;
+            entries[*count].size = (uint64_t)st.st_size;
+            if (entries[*count].path) {
+                *total += entries[*count].size;
+                (*count)++;
+            }
+        }
+        closedir(sub);
+    }
+    closedir(top);
+    return entries;
+}
+
+// Removes the oldest entries until the cache is below the eviction target
+static void compile_cache_evict(const char *dir, CompileCacheStats *stats, uint64_t max_size) {
+    size_t count;
+    uint64_t total;
+    CompileCacheEntry *entries = compile_cache_list(dir, &count, &total);
+    if (entries) {
+        qsort(entries, count, sizeof(CompileCacheEntry), compare_entry_age);
+    }
+
+    uint64_t target = COMPILE_CACHE_EVICT_TARGET(max_size);
+    for (size_t i = 0; i < count; i++) {
+        if (total > target && remove(entries[i].path) == 0) {
+            total -= entries[i].size;
+            stats->evictions++;
+        }
+        free(entries[i].path);
+    }
+    free(entries);
+    stats->size = total;
+}
+
+void compile_cache_store(const char *dir, const char *key, const char *path, uint64_t max_size) {
+    char *entry_path = compile_cache_entry_path(dir, key, true);
+    char *temp_path = entry_path ? malloc(strlen(entry_path) + 16) : NULL;
+    if (!temp_path) {
+        free(entry_path);
+        return;
+    }
+
+    // Write beside the entry and rename, so readers never see half a file
+    sprintf(temp_path, "%s.XXXXXX", entry_path);
+    int temp_fd = mkstemp(temp_path);
+    struct stat st;
+    bool stored = temp_fd >= 0 && close(temp_fd) == 0 &&
+                  compile_cache_copy(path, temp_path) &&
+                  stat(temp_path, &st) == 0 &&
+                  rename(temp_path, entry_path) == 0;
+    if (!stored) {
+        if (temp_fd >= 0) remove(temp_path);
+        free(temp_path);
+        free(entry_path);
+        return;
+    }
+    free(temp_path);
+    free(entry_path);
+
+    CompileCacheStats stats;
+    int fd = compile_cache_lock_stats(dir, &stats);
+    if (fd < 0) return;
+
+    stats.stores++;
+    stats.size += (uint64_t)st.st_size;
+    if (stats.size > max_size) {
+        compile_cache_evict(dir, &stats, max_size);
+    }
+    compile_cache_unlock_stats(fd, &stats);
+}
+
+static void compile_cache_format_size(uint64_t size, char text[32]) {
+    const char *units = "KMG";
+    double value = (double)size;
+    int unit = -1;
+    while (value >= 1024.0 && unit < 2) {
+        value /= 1024.0;
+        unit++;
+    }
+    if (unit < 0) {
+        snprintf(text, 32, "%llu bytes", (unsigned long long)size);
+    } else {
+        snprintf(text, 32, "%.1f %cB", value, units[unit]);
+    }
+}
+
+bool compile_cache_print_stats(const char *dir, FILE *out) {
+    CompileCacheStats stats;
+    int fd = compile_cache_mkdir(dir) ? compile_cache_lock_stats(dir, &stats) : -1;
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot read compile cache statistics in '%s'\n", dir);
+        return false;
+    }
+    close(fd);
+
+    uint64_t lookups = stats.hits + stats.misses;
+    fprintf(out, "Cache directory:  %s\n", dir);
+    fprintf(out, "Hits:             %llu\n", (unsigned long long)stats.hits);
+    fprintf(out, "Misses:           %llu\n", (unsigned long long)stats.misses);
+    fprintf(out, "Hit rate:         %.1f%%\n", lookups ? 100.0 * (double)stats.hits / (double)lookups : 0.0);
+    fprintf(out, "Stores:           %llu\n", (unsigned long long)stats.stores);
+    fprintf(out, "Evictions:        %llu\n", (unsigned long long)stats.evictions);
+    char size[32];
+    char max_size[32];
+    compile_cache_format_size(stats.size, size);
+    compile_cache_format_size(compile_cache_max_size(), max_size);
+    fprintf(out, "Size:             %s (limit %s)\n", size, max_size);
+    return true;
+}
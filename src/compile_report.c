@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "compile_report.h"
+
+typedef struct PhaseInfo {
+    const char *name;
+    const char *count_name;      // What PhaseReport.count counts, or NULL
+    bool per_line;               // Worth a lines/second rate
+} PhaseInfo;
+
+static const PhaseInfo phase_info[REPORT_PHASE_COUNT] = {
+    [REPORT_PHASE_PREPROCESS] = {"preprocess", "lines", true},
+    [REPORT_PHASE_CACHE]      = {"cache", NULL, false},
+    [REPORT_PHASE_LEX]        = {"lex", "tokens", true},
+    [REPORT_PHASE_PARSE]      = {"parse", "nodes", true},
+    [REPORT_PHASE_CODEGEN]    = {"codegen", NULL, true},
+    [REPORT_PHASE_ASSEMBLE]   = {"assemble", NULL, false},
+    [REPORT_PHASE_LINK]       = {"link", "objects", false},
+};
+
+static double report_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static long report_peak_rss_kb(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;  // Bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+void compile_report_init(CompileReport *report, const char *name) {
+    memset(report, 0, sizeof(*report));
+    report->name = name;
+}
+
+void compile_report_begin(CompileReport *report) {
+    if (!report) return;
+    report->arena_at_start = arena_thread_stats();
+    report->started = report_now();
+}
+
+void compile_report_end(CompileReport *report, ReportPhase phase, size_t count) {
+    if (!report) return;
+
+    double elapsed = report_now() - report->started;
+    ArenaStats arena = arena_thread_stats();
+    PhaseReport *entry = &report->phases[phase];
+
+    entry->ran = true;
+    entry->seconds += elapsed;
+    entry->peak_rss_kb = report_peak_rss_kb();
+    entry->allocations += arena.allocation_count - report->arena_at_start.allocation_count;
+    entry->bytes += arena.bytes_allocated - report->arena_at_start.bytes_allocated;
+    entry->count += count;
+}
+
+static double report_lines_per_second(const CompileReport *report, const PhaseReport *entry) {
+    return entry->seconds > 0 ? (double)report->lines / entry->seconds : 0.0;
+}
+
+static void report_print_table(const CompileReport *report, bool time, bool mem, FILE *out) {
+    double total = 0;
+    for (int i = 0; i < REPORT_PHASE_COUNT; i++) {
+        total += report->phases[i].seconds;
+    }
+
+    fprintf(out, "\nCompile report for %s (%zu lines)\n", report->name, report->lines);
+    fprintf(out, "  %-11s", "phase");
+    if (time) fprintf(out, " %10s %6s %16s %12s", "wall ms", "%", "count", "lines/s");
+    if (mem) fprintf(out, " %12s %10s %12s", "peak RSS KB", "allocs", "bytes");
+    fprintf(out, "\n");
+
+    for (int i = 0; i < REPORT_PHASE_COUNT; i++) {
+        const PhaseReport *entry = &report->phases[i];
+        const PhaseInfo *info = &phase_info[i];
+        if (!entry->ran) continue;
+
+        fprintf(out, "  %-11s", info->name);
+        if (time) {
+            char count[32] = "-";
+            char rate[32] = "-";
+            if (info->count_name) {
+                snprintf(count, sizeof(count), "%zu %s", entry->count, info->count_name);
+            }
+            if (info->per_line && report->lines) {
+                snprintf(rate, sizeof(rate), "%.0f", report_lines_per_second(report, entry));
+            }
+            fprintf(out, " %10.3f %5.1f%% %16s %12s", entry->seconds * 1e3,
+                    total > 0 ? 100.0 * entry->seconds / total : 0.0, count, rate);
+        }
+        if (mem) {
+            fprintf(out, " %12ld %10zu %12zu", entry->peak_rss_kb, entry->allocations, entry->bytes);
+        }
+        fprintf(out, "\n");
+    }
+
+    if (time) {
+        fprintf(out, "  %-11s %10.3f\n", "total", total * 1e3);
+    }
+}
+
+static void report_print_json_string(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const char *c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(out, "\\%c", *c);
+        } else if ((unsigned char)*c < 0x20) {
+            fprintf(out, "\\u%04x", (unsigned char)*c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void report_print_json(const CompileReport *report, bool time, bool mem, FILE *out) {
+    fprintf(out, "{\"file\":");
+    report_print_json_string(out, report->name);
+    fprintf(out, ",\"lines\":%zu,\"phases\":[", report->lines);
+
+    bool first = true;
+    for (int i = 0; i < REPORT_PHASE_COUNT; i++) {
+        const PhaseReport *entry = &report->phases[i];
+        const PhaseInfo *info = &phase_info[i];
+        if (!entry->ran) continue;
+
+        fprintf(out, "%s{\"phase\":\"%s\"", first ? "" : ",", info->name);
+        if (time) {
+            fprintf(out, ",\"seconds\":%.9f", entry->seconds);
+            if (info->count_name) {
+                fprintf(out, ",\"%s\":%zu", info->count_name, entry->count);
+            }
+            if (info->per_line && report->lines) {
+                fprintf(out, ",\"lines_per_second\":%.1f", report_lines_per_second(report, entry));
+            }
+        }
+        if (mem) {
+            fprintf(out, ",\"peak_rss_kb\":%ld,\"allocations\":%zu,\"bytes\":%zu",
+                    entry->peak_rss_kb, entry->allocations, entry->bytes);
+        }
+        fprintf(out, "}");
+        first = false;
+    }
+    fprintf(out, "]}\n");
+}
+
+void compile_report_print(const CompileReport *report, bool time, bool mem,
+                          ReportFormat format, FILE *out) {
+    char *text = NULL;
+    size_t size = 0;
+    FILE *buffer = open_memstream(&text, &size);
+    if (!buffer) {
+        return;
+    }
+
+    if (format == REPORT_FORMAT_JSON) {
+        report_print_json(report, time, mem, buffer);
+    } else {
+        report_print_table(report, time, mem, buffer);
+    }
+
+    if (fclose(buffer) == 0) {
+        fwrite(text, 1, size, out);
+        fflush(out);
+    }
+    free(text);
+}
@@ -0,0 +1,440 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "compile_server.h"
+
+#define COMPILE_SERVER_MAX_ARGS 4096
+#define COMPILE_SERVER_MAX_STRING (1024 * 1024)
+#define COMPILE_SERVER_BACKLOG 64
+
+// ========================================
+// Wire format
+// ========================================
+// Client and server are the same binary on the same machine, so integers
+// are in host byte order. A request is a CompileServerHello, sent together
+// with the client's stdin, stdout and stderr (SCM_RIGHTS), then the working
+// directory and argc arguments, each as a uint32_t length and the bytes.
+// The reply is the compile's exit status as an int32_t.
+
+typedef struct CompileServerHello {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t argc;
+    uint32_t reserved;
+} CompileServerHello;
+
+// A request being compiled by a forked child
+typedef struct CompileServerJob {
+    pid_t pid;
+    int connection;              // Where the exit status goes
+} CompileServerJob;
+
+static volatile sig_atomic_t compile_server_stopping = 0;
+static int compile_server_wakeup[2] = {-1, -1};  // Self-pipe written on SIGCHLD
+
+// ========================================
+// I/O helpers
+// ========================================
+
+static bool compile_server_write(int fd, const void *data, size_t size) {
+    const char *bytes = data;
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        bytes += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+static bool compile_server_read(int fd, void *data, size_t size) {
+    char *bytes = data;
+    while (size > 0) {
+        ssize_t got = read(fd, bytes, size);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        bytes += got;
+        size -= (size_t)got;
+    }
+    return true;
+}
+
+static bool compile_server_write_string(int fd, const char *text) {
+    uint32_t length = (uint32_t)strlen(text);
+    return compile_server_write(fd, &length, sizeof(length)) &&
+           compile_server_write(fd, text, length);
+}
+
+static char *compile_server_read_string(int fd) {
+    uint32_t length;
+    if (!compile_server_read(fd, &length, sizeof(length)) || length > COMPILE_SERVER_MAX_STRING) {
+        return NULL;
+    }
+
+    char *text = malloc((size_t)length + 1);
+    if (!text) return NULL;
+    if (!compile_server_read(fd, text, length)) {
+        free(text);
+        return NULL;
+    }
+    text[length] = '\0';
+    return text;
+}
+
+static bool compile_server_address(const char *path, struct sockaddr_un *address) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "Error: Socket path too long: '%s'\n", path);
+        return false;
+    }
+    strcpy(address->sun_path, path);
+    return true;
+}
+
+const char *compile_server_default_socket(void) {
+    static char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir && *runtime_dir &&
+        (size_t)snprintf(path, sizeof(path), "%s/kcc.sock", runtime_dir) < sizeof(path)) {
+        return path;
+    }
+    snprintf(path, sizeof(path), "/tmp/kcc-%lu.sock", (unsigned long)getuid());
+    return path;
+}
+
+// ========================================
+// Client
+// ========================================
+
+static bool compile_server_send_hello(int fd, const CompileServerHello *hello) {
+    int streams[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    union {
+        char buffer[CMSG_SPACE(sizeof(streams))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct iovec iov = {(void *)hello, sizeof(*hello)};
+    struct msghdr message = {0};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(streams));
+    memcpy(CMSG_DATA(cmsg), streams, sizeof(streams));
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(fd, &message, 0);
+    } while (sent < 0 && errno == EINTR);
+    return sent == (ssize_t)sizeof(*hello);
+}
+
+int compile_server_forward(const char *socket_path, int argc, char **argv) {
+    struct sockaddr_un address;
+    if (argc < 0 || argc > COMPILE_SERVER_MAX_ARGS ||
+        !compile_server_address(socket_path, &address)) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    char cwd[PATH_MAX];
+    CompileServerHello hello = {COMPILE_SERVER_MAGIC, COMPILE_SERVER_VERSION, (uint32_t)argc, 0};
+    if (!getcwd(cwd, sizeof(cwd)) || !compile_server_send_hello(fd, &hello)) {
+        close(fd);
+        return -1;
+    }
+
+    // From here on the server owns the compile: falling back to a local one
+    // could produce its output twice
+    signal(SIGPIPE, SIG_IGN);
+    bool sent = compile_server_write_string(fd, cwd);
+    for (int i = 0; sent && i < argc; i++) {
+        sent = compile_server_write_string(fd, argv[i]);
+    }
+
+    int32_t status;
+    if (!sent || !compile_server_read(fd, &status, sizeof(status))) {
+        fprintf(stderr, "Error: Compile server at '%s' dropped the request\n", socket_path);
+        close(fd);
+        return 1;
+    }
+
+    close(fd);
+    return status;
+}
+
+// ========================================
+// Server
+// ========================================
+
+static void compile_server_on_stop(int signal_number) {
+    (void)signal_number;
+    compile_server_stopping = 1;
+}
+
+static void compile_server_on_child(int signal_number) {
+    (void)signal_number;
+    int saved_errno = errno;
+    char byte = 0;
+    if (write(compile_server_wakeup[1], &byte, 1) < 0) {
+        // The pipe is full, so a wakeup is already pending
+    }
+    errno = saved_errno;
+}
+
+static void compile_server_set_signal(int signal_number, void (*handler)(int)) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handler;
+    sigemptyset(&action.sa_mask);
+    sigaction(signal_number, &action, NULL);
+}
+
+static bool compile_server_receive_hello(int fd, CompileServerHello *hello, int streams[3]) {
+    union {
+        char buffer[CMSG_SPACE(3 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    struct iovec iov = {hello, sizeof(*hello)};
+    struct msghdr message = {0};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    ssize_t got;
+    do {
+        got = recvmsg(fd, &message, 0);
+    } while (got < 0 && errno == EINTR);
+    if (got <= 0) return false;
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int))) {
+        return false;
+    }
+    memcpy(streams, CMSG_DATA(cmsg), 3 * sizeof(int));
+
+    // The descriptors come with the first bytes; the rest may arrive later
+    return compile_server_read(fd, (char *)hello + got, sizeof(*hello) - (size_t)got) &&
+           hello->magic == COMPILE_SERVER_MAGIC && hello->version == COMPILE_SERVER_VERSION &&
+           hello->argc <= COMPILE_SERVER_MAX_ARGS;
+}
+
+// Runs in the forked child: takes over the client's streams and directory
+// and compiles with the server's caches
+static int compile_server_child(int connection, CompileServerHandler handler) {
+    CompileServerHello hello;
+    int streams[3] = {-1, -1, -1};
+    if (!compile_server_receive_hello(connection, &hello, streams)) {
+        return 1;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        if (dup2(streams[i], i) < 0) return 1;
+        close(streams[i]);
+    }
+
+    char *cwd = compile_server_read_string(connection);
+    char **argv = calloc((size_t)hello.argc + 1, sizeof(char*));
+    if (!cwd || !argv) {
+        fprintf(stderr, "Error: Malformed compile server request\n");
+        return 1;
+    }
+    for (uint32_t i = 0; i < hello.argc; i++) {
+        if (!(argv[i] = compile_server_read_string(connection))) {
+            fprintf(stderr, "Error: Malformed compile server request\n");
+            return 1;
+        }
+    }
+
+    if (chdir(cwd) != 0) {
+        fprintf(stderr, "Error: Cannot change to directory '%s'\n", cwd);
+        return 1;
+    }
+
+    int status = handler((int)hello.argc, argv);
+    fflush(stdout);
+    fflush(stderr);
+    return status;
+}
+
+static int compile_server_listen(const char *socket_path) {
+    struct sockaddr_un address;
+    if (!compile_server_address(socket_path, &address)) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot create socket: %s\n", strerror(errno));
+        return -1;
+    }
+
+    // A socket nobody answers on was left behind by a server that died
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0) {
+        fprintf(stderr, "Error: A compile server is already running on '%s'\n", socket_path);
+        close(fd);
+        return -1;
+    }
+    unlink(socket_path);
+
+    mode_t old_mask = umask(0077);
+    int bound = bind(fd, (struct sockaddr *)&address, sizeof(address));
+    umask(old_mask);
+    if (bound != 0 || listen(fd, COMPILE_SERVER_BACKLOG) != 0) {
+        fprintf(stderr, "Error: Cannot listen on '%s': %s\n", socket_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Sends the status of every finished child to its client
+static void compile_server_reap(CompileServerJob *jobs, int *job_count, bool block) {
+    while (*job_count > 0) {
+        int wait_status;
+        pid_t pid = waitpid(-1, &wait_status, block ? 0 : WNOHANG);
+        if (pid < 0 && errno == EINTR) continue;
+        if (pid <= 0) break;
+
+        int32_t status = WIFEXITED(wait_status) ? WEXITSTATUS(wait_status)
+                       : WIFSIGNALED(wait_status) ? 128 + WTERMSIG(wait_status) : 1;
+
+        for (int i = 0; i < *job_count; i++) {
+            if (jobs[i].pid != pid) continue;
+            compile_server_write(jobs[i].connection, &status, sizeof(status));
+            close(jobs[i].connection);
+            jobs[i] = jobs[--*job_count];
+            break;
+        }
+    }
+}
+
+int compile_server_run(const char *socket_path, CompileServerHandler handler) {
+    int listener = compile_server_listen(socket_path);
+    if (listener < 0) {
+        return 1;
+    }
+
+    if (pipe(compile_server_wakeup) != 0) {
+        fprintf(stderr, "Error: Cannot create pipe: %s\n", strerror(errno));
+        close(listener);
+        unlink(socket_path);
+        return 1;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(compile_server_wakeup[i], F_SETFL, O_NONBLOCK);
+        fcntl(compile_server_wakeup[i], F_SETFD, FD_CLOEXEC);
+    }
+    fcntl(listener, F_SETFD, FD_CLOEXEC);
+
+    compile_server_set_signal(SIGINT, compile_server_on_stop);
+    compile_server_set_signal(SIGTERM, compile_server_on_stop);
+    compile_server_set_signal(SIGCHLD, compile_server_on_child);
+    compile_server_set_signal(SIGPIPE, SIG_IGN);
+
+    printf("kcc: compile server listening on %s\n", socket_path);
+    fflush(stdout);
+
+    CompileServerJob *jobs = NULL;
+    int job_count = 0;
+    int job_capacity = 0;
+
+    while (!compile_server_stopping) {
+        struct pollfd fds[2] = {
+            {listener, POLLIN, 0},
+            {compile_server_wakeup[0], POLLIN, 0},
+        };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Error: poll failed: %s\n", strerror(errno));
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char drain[64];
+            while (read(compile_server_wakeup[0], drain, sizeof(drain)) > 0) {
+            }
+            compile_server_reap(jobs, &job_count, false);
+        }
+
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        int connection = accept(listener, NULL, NULL);
+        if (connection < 0) continue;
+
+        if (job_count == job_capacity) {
+            int new_capacity = job_capacity ? job_capacity * 2 : 16;
+            CompileServerJob *grown = realloc(jobs, (size_t)new_capacity * sizeof(CompileServerJob));
+            if (!grown) {
+                close(connection);
+                continue;
+            }
+            jobs = grown;
+            job_capacity = new_capacity;
+        }
+
+        fflush(stdout);
+        fflush(stderr);
+        pid_t pid = fork();
+        if (pid == 0) {
+            compile_server_set_signal(SIGINT, SIG_DFL);
+            compile_server_set_signal(SIGTERM, SIG_DFL);
+            compile_server_set_signal(SIGCHLD, SIG_DFL);
+            compile_server_set_signal(SIGPIPE, SIG_DFL);
+            close(listener);
+            close(compile_server_wakeup[0]);
+            close(compile_server_wakeup[1]);
+            exit(compile_server_child(connection, handler));
+        }
+
+        if (pid < 0) {
+            int32_t status = 1;
+            compile_server_write(connection, &status, sizeof(status));
+            close(connection);
+            continue;
+        }
+
+        // Register before reaping so a child that already exited is found
+        jobs[job_count].pid = pid;
+        jobs[job_count].connection = connection;
+        job_count++;
+        compile_server_reap(jobs, &job_count, false);
+    }
+
+    // Let the compiles in flight finish and answer their clients
+    close(listener);
+    unlink(socket_path);
+    compile_server_reap(jobs, &job_count, true);
+    free(jobs);
+    close(compile_server_wakeup[0]);
+    close(compile_server_wakeup[1]);
+    return 0;
+}
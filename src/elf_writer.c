@@ -0,0 +1,441 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elf_writer.h"
+#include "error.h"
+
+#define ELF_SHT_SYMTAB 2
+#define ELF_SHT_STRTAB 3
+#define ELF_SHT_RELA   4
+#define ELF_SHF_INFO_LINK 0x40
+#define ELF_STT_SECTION 3
+
+typedef struct ElfSection {
+    char *name;
+    uint32_t type;
+    uint64_t flags;
+    uint64_t alignment;
+    const void *data;
+    uint64_t size;
+    int symbol;                  // Handle of its STT_SECTION symbol
+} ElfSection;
+
+typedef struct ElfSymbol {
+    char *name;
+    int section;
+    uint64_t value;
+    uint64_t size;
+    uint8_t type;
+    bool global;
+    uint32_t index;              // Final symbol table index, set while writing
+} ElfSymbol;
+
+typedef struct ElfRelocation {
+    int section;
+    uint64_t offset;
+    int symbol;
+    uint32_t type;
+    int64_t addend;
+} ElfRelocation;
+
+typedef struct ElfBuffer {
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+} ElfBuffer;
+
+struct ElfWriter {
+    bool is_64bit;
+    bool big_endian;
+    uint16_t machine;
+
+    ElfSection *sections;
+    int section_count;
+    int section_capacity;
+
+    ElfSymbol *symbols;
+    int symbol_count;
+    int symbol_capacity;
+
+    ElfRelocation *relocations;
+    int relocation_count;
+    int relocation_capacity;
+};
+
+static void *elf_grow(void *items, int *capacity, size_t item_size) {
+    int new_capacity = *capacity ? *capacity * 2 : 16;
+    void *new_items = realloc(items, (size_t)new_capacity * item_size);
+    if (!new_items) {
+        error_fatal("Memory allocation failed for object file");
+        return NULL;
+    }
+    *capacity = new_capacity;
+    return new_items;
+}
+
+ElfWriter *elf_writer_create(bool is_64bit, bool big_endian, uint16_t machine) {
+    ElfWriter *writer = calloc(1, sizeof(ElfWriter));
+    if (!writer) {
+        error_fatal("Memory allocation failed for object file");
+        return NULL;
+    }
+    writer->is_64bit = is_64bit;
+    writer->big_endian = big_endian;
+    writer->machine = machine;
+    return writer;
+}
+
+void elf_writer_destroy(ElfWriter *writer) {
+    if (!writer) return;
+
+    for (int i = 0; i < writer->section_count; i++) {
+        free(writer->sections[i].name);
+    }
+    for (int i = 0; i < writer->symbol_count; i++) {
+        free(writer->symbols[i].name);
+    }
+    free(writer->sections);
+    free(writer->symbols);
+    free(writer->relocations);
+    free(writer);
+}
+
+int elf_writer_add_symbol(ElfWriter *writer, const char *name, int section, uint64_t value,
+                          uint64_t size, uint8_t type, bool global) {
+    if (writer->symbol_count == writer->symbol_capacity) {
+        ElfSymbol *symbols = elf_grow(writer->symbols, &writer->symbol_capacity, sizeof(ElfSymbol));
+        if (!symbols) return -1;
+        writer->symbols = symbols;
+    }
+
+    ElfSymbol *symbol = &writer->symbols[writer->symbol_count];
+    symbol->name = strdup(name ? name : "");
+    symbol->section = section;
+    symbol->value = value;
+    symbol->size = size;
+    symbol->type = type;
+    // Undefined symbols are always global
+    symbol->global = global || section == 0;
+    symbol->index = 0;
+    return writer->symbol_count++;
+}
+
+int elf_writer_add_section(ElfWriter *writer, const char *name, uint32_t type, uint64_t flags,
+                           uint64_t alignment, const void *data, uint64_t size) {
+    if (writer->section_count == writer->section_capacity) {
+        ElfSection *sections = elf_grow(writer->sections, &writer->section_capacity,
+                                        sizeof(ElfSection));
+        if (!sections) return -1;
+        writer->sections = sections;
+    }
+
+    ElfSection *section = &writer->sections[writer->section_count++];
+    section->name = strdup(name);
+    section->type = type;
+    section->flags = flags;
+    section->alignment = alignment ? alignment : 1;
+    section->data = data;
+    section->size = size;
+    section->symbol = elf_writer_add_symbol(writer, "", writer->section_count, 0, 0,
+                                            ELF_STT_SECTION, false);
+    return writer->section_count;
+}
+
+int elf_writer_section_symbol(ElfWriter *writer, int section) {
+    return writer->sections[section - 1].symbol;
+}
+
+void elf_writer_add_relocation(ElfWriter *writer, int section, uint64_t offset, int symbol,
+                               uint32_t type, int64_t addend) {
+    if (writer->relocation_count == writer->relocation_capacity) {
+        ElfRelocation *relocations = elf_grow(writer->relocations, &writer->relocation_capacity,
+                                              sizeof(ElfRelocation));
+        if (!relocations) return;
+        writer->relocations = relocations;
+    }
+
+    ElfRelocation *relocation = &writer->relocations[writer->relocation_count++];
+    relocation->section = section;
+    relocation->offset = offset;
+    relocation->symbol = symbol;
+    relocation->type = type;
+    relocation->addend = addend;
+}
+
+// ========================================
+// Serialization
+// ========================================
+
+static void elf_put(ElfBuffer *buffer, const void *data, size_t size) {
+    if (buffer->size + size > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (capacity < buffer->size + size) {
+            capacity *= 2;
+        }
+        unsigned char *new_data = realloc(buffer->data, capacity);
+        if (!new_data) {
+            error_fatal("Memory allocation failed for object file");
+            return;
+        }
+        buffer->data = new_data;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static void elf_put_uint(ElfBuffer *buffer, bool big_endian, uint64_t value, int size) {
+    unsigned char bytes[8];
+    for (int i = 0; i < size; i++) {
+        int shift = big_endian ? (size - 1 - i) * 8 : i * 8;
+        bytes[i] = (unsigned char)(value >> shift);
+    }
+    elf_put(buffer, bytes, (size_t)size);
+}
+
+static void elf_align(ElfBuffer *buffer, uint64_t alignment) {
+    static const unsigned char zeros[16] = {0};
+    while (buffer->size % alignment) {
+        size_t pad = alignment - buffer->size % alignment;
+        elf_put(buffer, zeros, pad < sizeof(zeros) ? pad : sizeof(zeros));
+    }
+}
+
+static uint32_t elf_string(ElfBuffer *strings, const char *text) {
+    if (!text[0]) return 0;
+    uint32_t offset = (uint32_t)strings->size;
+    elf_put(strings, text, strlen(text) + 1);
+    return offset;
+}
+
+// Section header table entries, in the order they are written
+typedef struct ElfHeaderEntry {
+    uint32_t name;
+    uint32_t type;
+    uint64_t flags;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t link;
+    uint32_t info;
+    uint64_t alignment;
+    uint64_t entry_size;
+} ElfHeaderEntry;
+
+bool elf_writer_write(ElfWriter *writer, const char *path) {
+    bool be = writer->big_endian;
+    bool is64 = writer->is_64bit;
+    int word = is64 ? 8 : 4;
+    size_t header_size = is64 ? 64 : 52;
+    size_t symbol_size = is64 ? 24 : 16;
+    size_t rela_size = is64 ? 24 : 12;
+
+    ElfBuffer file = {NULL, 0, 0};
+    ElfBuffer strings = {NULL, 0, 0};
+    ElfBuffer section_names = {NULL, 0, 0};
+    elf_put(&strings, "", 1);
+    elf_put(&section_names, "", 1);
+
+    // Which sections carry relocations
+    int rela_count = 0;
+    bool *has_relocations = calloc((size_t)writer->section_count + 1, sizeof(bool));
+    ElfHeaderEntry *entries = calloc((size_t)writer->section_count * 2 + 4, sizeof(ElfHeaderEntry));
+    if (!has_relocations || !entries) {
+        free(has_relocations);
+        free(entries);
+        error_fatal("Memory allocation failed for object file");
+        return false;
+    }
+    for (int i = 0; i < writer->relocation_count; i++) {
+        if (!has_relocations[writer->relocations[i].section]) {
+            has_relocations[writer->relocations[i].section] = true;
+            rela_count++;
+        }
+    }
+
+    // Section indices: 0 null, user sections, .rela.*, .symtab, .strtab, .shstrtab
+    int symtab_index = writer->section_count + rela_count + 1;
+    int strtab_index = symtab_index + 1;
+    int shstrtab_index = strtab_index + 1;
+    int entry_count = shstrtab_index + 1;
+
+    // Locals (after the null symbol) come before globals
+    uint32_t next_index = 1;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < writer->symbol_count; i++) {
+            if (writer->symbols[i].global == (pass == 1)) {
+                writer->symbols[i].index = next_index++;
+            }
+        }
+    }
+    uint32_t first_global = 1;
+    for (int i = 0; i < writer->symbol_count; i++) {
+        if (!writer->symbols[i].global) first_global++;
+    }
+
+    // ELF header, patched with the section header offset at the end
+    elf_put(&file, (unsigned char[]){0x7F, 'E', 'L', 'F', is64 ? 2 : 1, be ? 2 : 1, 1, 0}, 8);
+    elf_put(&file, (unsigned char[8]){0}, 8);
+    elf_put_uint(&file, be, 1, 2);                          // e_type: ET_REL
+    elf_put_uint(&file, be, writer->machine, 2);
+    elf_put_uint(&file, be, 1, 4);                          // e_version
+    elf_put_uint(&file, be, 0, word);                       // e_entry
+    elf_put_uint(&file, be, 0, word);                       // e_phoff
+    size_t shoff_position = file.size;
+    elf_put_uint(&file, be, 0, word);                       // e_shoff
+    elf_put_uint(&file, be, 0, 4);                          // e_flags
+    elf_put_uint(&file, be, header_size, 2);
+    elf_put_uint(&file, be, 0, 2);                          // e_phentsize
+    elf_put_uint(&file, be, 0, 2);                          // e_phnum
+    elf_put_uint(&file, be, is64 ? 64 : 40, 2);             // e_shentsize
+    elf_put_uint(&file, be, (uint64_t)entry_count, 2);
+    elf_put_uint(&file, be, (uint64_t)shstrtab_index, 2);
+
+    // Section contents
+    for (int i = 0; i < writer->section_count; i++) {
+        ElfSection *section = &writer->sections[i];
+        ElfHeaderEntry *entry = &entries[i + 1];
+        elf_align(&file, section->alignment);
+
+        entry->name = elf_string(&section_names, section->name);
+        entry->type = section->type;
+        entry->flags = section->flags;
+        entry->offset = file.size;
+        entry->size = section->size;
+        entry->alignment = section->alignment;
+        entry->entry_size = (section->flags & ELF_SHF_STRINGS) ? 1 : 0;
+        if (section->type != ELF_SHT_NOBITS && section->size) {
+            elf_put(&file, section->data, (size_t)section->size);
+        }
+    }
+
+    // Relocations, one RELA section per relocated section
+    int rela_index = writer->section_count + 1;
+    for (int s = 1; s <= writer->section_count; s++) {
+        if (!has_relocations[s]) continue;
+
+        char name[256];
+        snprintf(name, sizeof(name), ".rela%s", writer->sections[s - 1].name);
+        elf_align(&file, (uint64_t)word);
+
+        ElfHeaderEntry *entry = &entries[rela_index++];
+        entry->name = elf_string(&section_names, name);
+        entry->type = ELF_SHT_RELA;
+        entry->flags = ELF_SHF_INFO_LINK;
+        entry->offset = file.size;
+        entry->link = (uint32_t)symtab_index;
+        entry->info = (uint32_t)s;
+        entry->alignment = (uint64_t)word;
+        entry->entry_size = rela_size;
+
+        for (int i = 0; i < writer->relocation_count; i++) {
+            ElfRelocation *relocation = &writer->relocations[i];
+            if (relocation->section != s) continue;
+
+            uint64_t symbol = writer->symbols[relocation->symbol].index;
+            uint64_t info = is64 ? (symbol << 32) | relocation->type
+                                 : (symbol << 8) | (relocation->type & 0xFF);
+            elf_put_uint(&file, be, relocation->offset, word);
+            elf_put_uint(&file, be, info, word);
+            elf_put_uint(&file, be, (uint64_t)relocation->addend, word);
+        }
+        entry->size = file.size - entry->offset;
+    }
+
+    // Symbol table, in final index order
+    elf_align(&file, (uint64_t)word);
+    ElfHeaderEntry *symtab = &entries[symtab_index];
+    symtab->name = elf_string(&section_names, ".symtab");
+    symtab->type = ELF_SHT_SYMTAB;
+    symtab->offset = file.size;
+    symtab->link = (uint32_t)strtab_index;
+    symtab->info = first_global;
+    symtab->alignment = (uint64_t)word;
+    symtab->entry_size = symbol_size;
+
+    elf_put(&file, (unsigned char[24]){0}, symbol_size);
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < writer->symbol_count; i++) {
+            ElfSymbol *symbol = &writer->symbols[i];
+            if (symbol->global != (pass == 1)) continue;
+
+            uint32_t name = elf_string(&strings, symbol->name);
+            uint8_t info = (uint8_t)(((symbol->global ? 1 : 0) << 4) | symbol->type);
+            if (is64) {
+                elf_put_uint(&file, be, name, 4);
+                elf_put_uint(&file, be, info, 1);
+                elf_put_uint(&file, be, 0, 1);              // st_other
+                elf_put_uint(&file, be, (uint64_t)symbol->section, 2);
+                elf_put_uint(&file, be, symbol->value, 8);
+                elf_put_uint(&file, be, symbol->size, 8);
+            } else {
+                elf_put_uint(&file, be, name, 4);
+                elf_put_uint(&file, be, symbol->value, 4);
+                elf_put_uint(&file, be, symbol->size, 4);
+                elf_put_uint(&file, be, info, 1);
+                elf_put_uint(&file, be, 0, 1);
+                elf_put_uint(&file, be, (uint64_t)symbol->section, 2);
+            }
+        }
+    }
+    symtab->size = file.size - symtab->offset;
+
+    ElfHeaderEntry *strtab = &entries[strtab_index];
+    strtab->name = elf_string(&section_names, ".strtab");
+    strtab->type = ELF_SHT_STRTAB;
+    strtab->offset = file.size;
+    strtab->size = strings.size;
+    strtab->alignment = 1;
+    elf_put(&file, strings.data, strings.size);
+
+    ElfHeaderEntry *shstrtab = &entries[shstrtab_index];
+    shstrtab->name = elf_string(&section_names, ".shstrtab");
+    shstrtab->type = ELF_SHT_STRTAB;
+    shstrtab->offset = file.size;
+    shstrtab->size = section_names.size;
+    shstrtab->alignment = 1;
+    elf_put(&file, section_names.data, section_names.size);
+
+    // Section header table
+    elf_align(&file, (uint64_t)word);
+    uint64_t shoff = file.size;
+    for (int i = 0; i < entry_count; i++) {
+        ElfHeaderEntry *entry = &entries[i];
+        elf_put_uint(&file, be, entry->name, 4);
+        elf_put_uint(&file, be, entry->type, 4);
+        elf_put_uint(&file, be, entry->flags, word);
+        elf_put_uint(&file, be, 0, word);                   // sh_addr
+        elf_put_uint(&file, be, entry->offset, word);
+        elf_put_uint(&file, be, entry->size, word);
+        elf_put_uint(&file, be, entry->link, 4);
+        elf_put_uint(&file, be, entry->info, 4);
+        elf_put_uint(&file, be, i ? entry->alignment : 0, word);
+        elf_put_uint(&file, be, entry->entry_size, word);
+    }
+
+    ElfBuffer patch = {NULL, 0, 0};
+    elf_put_uint(&patch, be, shoff, word);
+    memcpy(file.data + shoff_position, patch.data, (size_t)word);
+    free(patch.data);
+
+    bool ok = true;
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        fprintf(stderr, "Error: Cannot open output file '%s'\n", path);
+        ok = false;
+    } else {
+        ok = fwrite(file.data, 1, file.size, out) == file.size;
+        if (fclose(out) != 0 || !ok) {
+            fprintf(stderr, "Error: Failed to write object file '%s'\n", path);
+            remove(path);
+            ok = false;
+        }
+    }
+
+    free(file.data);
+    free(strings.data);
+    free(section_names.data);
+    free(has_relocations);
+    free(entries);
+    return ok;
+}
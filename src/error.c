@@ -6,7 +6,9 @@
 #include <stdbool.h>
 #include <string.h>
 
-static int g_error_count = 0;
+// Errors are counted per thread: a thread compiles one translation unit at a
+// time, so with a parallel build each unit still sees only its own errors
+static _Thread_local int g_error_count = 0;
 
 void error_init(void) {
     g_error_count = 0;
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#include "include_cache.h"
+#include "error.h"
+
+#define INCLUDE_CACHE_INITIAL_CAPACITY 64
+
+typedef struct IncludeCache {
+    IncludeCacheEntry **slots;   // Open addressing, linear probing
+    size_t capacity;             // Always a power of two
+    size_t count;
+} IncludeCache;
+
+static IncludeCache include_cache = {NULL, 0, 0};
+
+// Guards the slots and every entry's fields: translation units compiled in
+// parallel look up, load and learn about the same headers
+static pthread_mutex_t include_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t include_cache_hash(unsigned long long device, unsigned long long inode,
+                                 long long mtime) {
+    unsigned long long hash = inode * 0x9E3779B97F4A7C15ull;
+    hash ^= device + 0x632BE59BD9B4E019ull + (hash << 6) + (hash >> 2);
+    hash ^= (unsigned long long)mtime + (hash << 6) + (hash >> 2);
+    return (size_t)hash;
+}
+
+// Without inode numbers (e.g. on Windows) files can only be told apart by path
+static bool include_cache_matches(const IncludeCacheEntry *entry, const char *path,
+                                  unsigned long long device, unsigned long long inode,
+                                  long long mtime) {
+    if (entry->device != device || entry->inode != inode || entry->mtime != mtime) {
+        return false;
+    }
+    return inode != 0 || strcmp(entry->path, path) == 0;
+}
+
+static bool include_cache_grow(void) {
+    size_t new_capacity = include_cache.capacity ? include_cache.capacity * 2
+                                                 : INCLUDE_CACHE_INITIAL_CAPACITY;
+    IncludeCacheEntry **new_slots = calloc(new_capacity, sizeof(IncludeCacheEntry*));
+    if (!new_slots) {
+        error_fatal("Memory allocation failed for include cache");
+        return false;
+    }
+
+    size_t mask = new_capacity - 1;
+    for (size_t i = 0; i < include_cache.capacity; i++) {
+        IncludeCacheEntry *entry = include_cache.slots[i];
+        if (!entry) continue;
+
+        size_t index = include_cache_hash(entry->device, entry->inode, entry->mtime) & mask;
+        while (new_slots[index]) {
+            index = (index + 1) & mask;
+        }
+        new_slots[index] = entry;
+    }
+
+    free(include_cache.slots);
+    include_cache.slots = new_slots;
+    include_cache.capacity = new_capacity;
+    return true;
+}
+
+IncludeCacheEntry *include_cache_lookup(const char *path) {
+    struct stat st;
+    if (!path || stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return NULL;
+    }
+
+    unsigned long long device = (unsigned long long)st.st_dev;
+    unsigned long long inode = (unsigned long long)st.st_ino;
+    long long mtime = (long long)st.st_mtime;
+
+    pthread_mutex_lock(&include_cache_mutex);
+    if ((include_cache.count + 1) * 2 > include_cache.capacity && !include_cache_grow()) {
+        pthread_mutex_unlock(&include_cache_mutex);
+        return NULL;
+    }
+
+    size_t mask = include_cache.capacity - 1;
+    size_t index = include_cache_hash(device, inode, mtime) & mask;
+    while (include_cache.slots[index]) {
+        IncludeCacheEntry *entry = include_cache.slots[index];
+        if (include_cache_matches(entry, path, device, inode, mtime)) {
+            pthread_mutex_unlock(&include_cache_mutex);
+            return entry;
+        }
+        index = (index + 1) & mask;
+    }
+
+    IncludeCacheEntry *entry = calloc(1, sizeof(IncludeCacheEntry));
+    char *path_copy = strdup(path);
+    if (!entry || !path_copy) {
+        free(entry);
+        free(path_copy);
+        error_fatal("Memory allocation failed for include cache");
+        return NULL;
+    }
+
+    entry->device = device;
+    entry->inode = inode;
+    entry->mtime = mtime;
+    entry->path = path_copy;
+
+    include_cache.slots[index] = entry;
+    include_cache.count++;
+    pthread_mutex_unlock(&include_cache_mutex);
+    return entry;
+}
+
+bool include_cache_load(IncludeCacheEntry *entry) {
+    pthread_mutex_lock(&include_cache_mutex);
+    if (!entry->loaded && source_file_open(&entry->source, entry->path)) {
+        entry->loaded = true;
+    }
+    bool loaded = entry->loaded;
+    pthread_mutex_unlock(&include_cache_mutex);
+    return loaded;
+}
+
+void include_cache_set_guard(IncludeCacheEntry *entry, const char *guard) {
+    pthread_mutex_lock(&include_cache_mutex);
+    entry->scanned = true;
+    entry->guard = guard;
+    pthread_mutex_unlock(&include_cache_mutex);
+}
+
+void include_cache_set_pragma_once(IncludeCacheEntry *entry) {
+    pthread_mutex_lock(&include_cache_mutex);
+    entry->pragma_once = true;
+    pthread_mutex_unlock(&include_cache_mutex);
+}
+
+const char *include_cache_guard(IncludeCacheEntry *entry) {
+    pthread_mutex_lock(&include_cache_mutex);
+    const char *guard = entry->guard;
+    pthread_mutex_unlock(&include_cache_mutex);
+    return guard;
+}
+
+bool include_cache_pragma_once(IncludeCacheEntry *entry) {
+    pthread_mutex_lock(&include_cache_mutex);
+    bool pragma_once = entry->pragma_once;
+    pthread_mutex_unlock(&include_cache_mutex);
+    return pragma_once;
+}
+
+size_t include_cache_count(void) {
+    pthread_mutex_lock(&include_cache_mutex);
+    size_t count = include_cache.count;
+    pthread_mutex_unlock(&include_cache_mutex);
+    return count;
+}
+
+void include_cache_destroy(void) {
+    for (size_t i = 0; i < include_cache.capacity; i++) {
+        IncludeCacheEntry *entry = include_cache.slots[i];
+        if (!entry) continue;
+
+        if (entry->loaded) {
+            source_file_close(&entry->source);
+        }
+        free(entry->path);
+        free(entry);
+    }
+
+    free(include_cache.slots);
+    include_cache.slots = NULL;
+    include_cache.capacity = 0;
+    include_cache.count = 0;
+}
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "intern.h"
+#include "arena.h"
+#include "error.h"
+
+#define INTERN_INITIAL_CAPACITY 1024
+#define INTERN_ARENA_CHUNK_SIZE (128 * 1024)
+
+// Header stored directly in front of the characters of every interned string
+typedef struct InternEntry {
+    unsigned int hash;
+    unsigned int length;
+    char text[];
+} InternEntry;
+
+typedef struct InternTable {
+    InternEntry **slots;      // Open addressing, linear probing
+    size_t capacity;          // Always a power of two
+    size_t count;
+    Arena *storage;           // Owns every InternEntry
+} InternTable;
+
+static InternTable intern_table = {NULL, 0, 0, NULL};
+
+// Translation units compiled in parallel share the table; handles are never
+// moved, so only the slots and the arena need the lock
+static pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static InternEntry *intern_entry(const char *interned) {
+    return (InternEntry *)(interned - offsetof(InternEntry, text));
+}
+
+unsigned int intern_hash_bytes(const char *str, size_t length) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void intern_table_init(void) {
+    intern_table.capacity = INTERN_INITIAL_CAPACITY;
+    intern_table.count = 0;
+    intern_table.slots = calloc(intern_table.capacity, sizeof(InternEntry*));
+    intern_table.storage = arena_create(INTERN_ARENA_CHUNK_SIZE);
+    if (!intern_table.slots) {
+        error_fatal("Memory allocation failed for intern table");
+    }
+}
+
+static void intern_table_grow(void) {
+    size_t new_capacity = intern_table.capacity * 2;
+    InternEntry **new_slots = calloc(new_capacity, sizeof(InternEntry*));
+    if (!new_slots) {
+        error_fatal("Memory allocation failed for intern table");
+        return;
+    }
+
+    for (size_t i = 0; i < intern_table.capacity; i++) {
+        InternEntry *entry = intern_table.slots[i];
+        if (!entry) continue;
+
+        size_t index = entry->hash & (new_capacity - 1);
+        while (new_slots[index]) {
+            index = (index + 1) & (new_capacity - 1);
+        }
+        new_slots[index] = entry;
+    }
+
+    free(intern_table.slots);
+    intern_table.slots = new_slots;
+    intern_table.capacity = new_capacity;
+}
+
+// Returns the slot holding the spelling, or the empty slot where it belongs
+static InternEntry **intern_find_slot(const char *str, size_t length, unsigned int hash) {
+    size_t mask = intern_table.capacity - 1;
+    size_t index = hash & mask;
+
+    while (intern_table.slots[index]) {
+        InternEntry *entry = intern_table.slots[index];
+        if (entry->hash == hash && entry->length == length &&
+            memcmp(entry->text, str, length) == 0) {
+            break;
+        }
+        index = (index + 1) & mask;
+    }
+
+    return &intern_table.slots[index];
+}
+
+const char *intern_string_n(const char *str, size_t length) {
+    if (!str) return NULL;
+
+    unsigned int hash = intern_hash_bytes(str, length);
+    pthread_mutex_lock(&intern_lock);
+
+    if (!intern_table.slots) {
+        intern_table_init();
+    }
+
+    InternEntry **slot = intern_find_slot(str, length, hash);
+    if (*slot) {
+        const char *text = (*slot)->text;
+        pthread_mutex_unlock(&intern_lock);
+        return text;
+    }
+
+    InternEntry *entry = arena_alloc(intern_table.storage, sizeof(InternEntry) + length + 1);
+    entry->hash = hash;
+    entry->length = (unsigned int)length;
+    memcpy(entry->text, str, length);
+    entry->text[length] = '\0';
+
+    *slot = entry;
+    intern_table.count++;
+
+    // Keep the load factor at or below 1/2
+    if (intern_table.count * 2 > intern_table.capacity) {
+        intern_table_grow();
+    }
+
+    pthread_mutex_unlock(&intern_lock);
+    return entry->text;
+}
+
+const char *intern_string(const char *str) {
+    if (!str) return NULL;
+    return intern_string_n(str, strlen(str));
+}
+
+const char *intern_lookup_n(const char *str, size_t length) {
+    if (!str) return NULL;
+
+    unsigned int hash = intern_hash_bytes(str, length);
+    pthread_mutex_lock(&intern_lock);
+
+    const char *text = NULL;
+    if (intern_table.slots) {
+        InternEntry **slot = intern_find_slot(str, length, hash);
+        text = *slot ? (*slot)->text : NULL;
+    }
+
+    pthread_mutex_unlock(&intern_lock);
+    return text;
+}
+
+unsigned int intern_hash(const char *interned) {
+    return interned ? intern_entry(interned)->hash : 0;
+}
+
+size_t intern_length(const char *interned) {
+    return interned ? intern_entry(interned)->length : 0;
+}
+
+size_t intern_count(void) {
+    pthread_mutex_lock(&intern_lock);
+    size_t count = intern_table.count;
+    pthread_mutex_unlock(&intern_lock);
+    return count;
+}
+
+void intern_table_destroy(void) {
+    free(intern_table.slots);
+    arena_destroy(intern_table.storage);
+
+    intern_table.slots = NULL;
+    intern_table.storage = NULL;
+    intern_table.capacity = 0;
+    intern_table.count = 0;
+}
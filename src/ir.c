@@ -0,0 +1,455 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "ir.h"
+
+#define IR_ARENA_CHUNK_SIZE (64 * 1024)
+
+// ============================================================================
+// Module and storage
+// ============================================================================
+
+IRModule *ir_module_create(void) {
+    Arena *arena = arena_create(IR_ARENA_CHUNK_SIZE);
+    if (!arena) return NULL;
+
+    IRModule *module = arena_calloc(arena, 1, sizeof(IRModule));
+    if (!module) {
+        arena_destroy(arena);
+        return NULL;
+    }
+    module->arena = arena;
+    return module;
+}
+
+void ir_module_destroy(IRModule *module) {
+    if (module) {
+        arena_destroy(module->arena);
+    }
+}
+
+IRFunction *ir_function_create(IRModule *module, const char *name, IRType return_type,
+                               int param_count) {
+    IRFunction *function = arena_calloc(module->arena, 1, sizeof(IRFunction));
+    function->name = name;
+    function->return_type = return_type;
+    function->param_count = param_count;
+    if (param_count > 0) {
+        function->params = arena_calloc(module->arena, (size_t)param_count, sizeof(IRInstr*));
+    }
+
+    if (module->last_function) {
+        module->last_function->next = function;
+    } else {
+        module->functions = function;
+    }
+    module->last_function = function;
+    return function;
+}
+
+IRBlock *ir_block_create(IRModule *module, IRFunction *function) {
+    IRBlock *block = arena_calloc(module->arena, 1, sizeof(IRBlock));
+    block->id = function->block_count++;
+    return block;
+}
+
+void ir_function_append_block(IRFunction *function, IRBlock *block) {
+    block->next = NULL;
+    if (function->last_block) {
+        function->last_block->next = block;
+    } else {
+        function->entry = block;
+    }
+    function->last_block = block;
+}
+
+IRGlobal *ir_global_create(IRModule *module, const char *name, IRType type) {
+    IRGlobal *global = arena_calloc(module->arena, 1, sizeof(IRGlobal));
+    global->name = name;
+    global->type = type;
+
+    if (module->last_global) {
+        module->last_global->next = global;
+    } else {
+        module->globals = global;
+    }
+    module->last_global = global;
+    return global;
+}
+
+IRGlobal *ir_global_find(const IRModule *module, const char *name) {
+    for (IRGlobal *global = module->globals; global; global = global->next) {
+        if (global->name == name || strcmp(global->name, name) == 0) {
+            return global;
+        }
+    }
+    return NULL;
+}
+
+const char *ir_string_literal(IRModule *module, const char *text) {
+    char name[32];
+    snprintf(name, sizeof(name), ".str.%d", module->string_count++);
+
+    IRGlobal *global = ir_global_create(module, arena_strdup(module->arena, name), IR_TYPE_I8);
+    global->string = arena_strdup(module->arena, text ? text : "");
+    return global->name;
+}
+
+// ============================================================================
+// Instructions
+// ============================================================================
+
+static bool ir_op_is_terminator(IROp op) {
+    return op == IR_JUMP || op == IR_BRANCH || op == IR_RET;
+}
+
+IRInstr *ir_instr_create(IRModule *module, IRFunction *function, IROp op, IRType type,
+                         int operand_count) {
+    IRInstr *instr = arena_calloc(module->arena, 1, sizeof(IRInstr));
+    instr->op = op;
+    instr->type = type;
+    instr->id = -1;
+    if (op != IR_CONST && op != IR_STORE && !ir_op_is_terminator(op) &&
+        !(op == IR_CALL && type == IR_TYPE_VOID)) {
+        instr->id = function->value_count++;
+    }
+    instr->operand_count = operand_count;
+    if (operand_count > 0) {
+        instr->operands = arena_calloc(module->arena, (size_t)operand_count, sizeof(IRInstr*));
+    }
+    return instr;
+}
+
+IRInstr *ir_const(IRModule *module, IRType type, int64_t value) {
+    IRInstr *instr = arena_calloc(module->arena, 1, sizeof(IRInstr));
+    instr->op = IR_CONST;
+    instr->type = type;
+    instr->id = -1;
+    instr->data.constant = value;
+    return instr;
+}
+
+IRInstr *ir_fconst(IRModule *module, IRType type, double value) {
+    IRInstr *instr = ir_const(module, type, 0);
+    instr->data.fconstant = value;
+    return instr;
+}
+
+void ir_block_append(IRBlock *block, IRInstr *instr) {
+    instr->block = block;
+    instr->prev = block->last;
+    instr->next = NULL;
+    if (block->last) {
+        block->last->next = instr;
+    } else {
+        block->first = instr;
+    }
+    block->last = instr;
+}
+
+void ir_block_insert_phi(IRBlock *block, IRInstr *phi) {
+    // After the block's existing phis, before everything else
+    IRInstr *after = NULL;
+    for (IRInstr *instr = block->first; instr && instr->op == IR_PHI; instr = instr->next) {
+        after = instr;
+    }
+
+    phi->block = block;
+    phi->prev = after;
+    phi->next = after ? after->next : block->first;
+    if (phi->next) {
+        phi->next->prev = phi;
+    } else {
+        block->last = phi;
+    }
+    if (after) {
+        after->next = phi;
+    } else {
+        block->first = phi;
+    }
+}
+
+void ir_instr_remove(IRInstr *instr) {
+    IRBlock *block = instr->block;
+    if (!block) return;
+
+    if (instr->prev) {
+        instr->prev->next = instr->next;
+    } else {
+        block->first = instr->next;
+    }
+    if (instr->next) {
+        instr->next->prev = instr->prev;
+    } else {
+        block->last = instr->prev;
+    }
+    instr->block = NULL;
+    instr->prev = instr->next = NULL;
+}
+
+// ============================================================================
+// Control flow
+// ============================================================================
+
+void ir_block_add_pred(IRModule *module, IRBlock *block, IRBlock *pred) {
+    if (block->pred_count == block->pred_capacity) {
+        int capacity = block->pred_capacity ? block->pred_capacity * 2 : 2;
+        IRBlock **preds = arena_alloc(module->arena, sizeof(IRBlock*) * (size_t)capacity);
+        if (block->pred_count) {
+            memcpy(preds, block->preds, sizeof(IRBlock*) * (size_t)block->pred_count);
+        }
+        block->preds = preds;
+        block->pred_capacity = capacity;
+    }
+    block->preds[block->pred_count++] = pred;
+}
+
+void ir_block_remove_pred(IRBlock *block, int index) {
+    for (IRInstr *phi = block->first; phi && phi->op == IR_PHI; phi = phi->next) {
+        if (index < phi->operand_count) {
+            memmove(&phi->operands[index], &phi->operands[index + 1],
+                    sizeof(IRInstr*) * (size_t)(phi->operand_count - index - 1));
+            phi->operand_count--;
+        }
+    }
+    memmove(&block->preds[index], &block->preds[index + 1],
+            sizeof(IRBlock*) * (size_t)(block->pred_count - index - 1));
+    block->pred_count--;
+}
+
+bool ir_block_terminated(const IRBlock *block) {
+    return block->last && ir_op_is_terminator(block->last->op);
+}
+
+int ir_block_successors(const IRBlock *block, IRBlock *succs[2]) {
+    if (!block->last) return 0;
+
+    switch (block->last->op) {
+        case IR_JUMP:
+            succs[0] = block->last->data.targets[0];
+            return 1;
+        case IR_BRANCH:
+            succs[0] = block->last->data.targets[0];
+            succs[1] = block->last->data.targets[1];
+            return succs[0] == succs[1] ? 1 : 2;
+        default:
+            return 0;
+    }
+}
+
+IRInstr *ir_resolve(IRInstr *value) {
+    while (value && value->replacement) {
+        value = value->replacement;
+    }
+    return value;
+}
+
+void ir_function_renumber(IRFunction *function) {
+    int block_id = 0;
+    int value_id = 0;
+    for (IRBlock *block = function->entry; block; block = block->next) {
+        block->id = block_id++;
+        for (IRInstr *instr = block->first; instr; instr = instr->next) {
+            if (instr->id >= 0) {
+                instr->id = value_id++;
+            }
+        }
+    }
+    function->block_count = block_id;
+    function->value_count = value_id;
+}
+
+// ============================================================================
+// Types and names
+// ============================================================================
+
+const char *ir_type_name(IRType type) {
+    switch (type) {
+        case IR_TYPE_VOID: return "void";
+        case IR_TYPE_I8:   return "i8";
+        case IR_TYPE_I16:  return "i16";
+        case IR_TYPE_I32:  return "i32";
+        case IR_TYPE_I64:  return "i64";
+        case IR_TYPE_PTR:  return "ptr";
+        case IR_TYPE_F32:  return "f32";
+        case IR_TYPE_F64:  return "f64";
+    }
+    return "?";
+}
+
+const char *ir_op_name(IROp op) {
+    static const char *const names[IR_OP_COUNT] = {
+        [IR_CONST] = "const", [IR_PARAM] = "param", [IR_UNDEF] = "undef",
+        [IR_PHI] = "phi", [IR_GLOBAL_ADDR] = "addr", [IR_LOAD] = "load",
+        [IR_STORE] = "store", [IR_CALL] = "call", [IR_CONVERT] = "convert",
+        [IR_ADD] = "add", [IR_SUB] = "sub", [IR_MUL] = "mul", [IR_DIV] = "div",
+        [IR_MOD] = "mod", [IR_AND] = "and", [IR_OR] = "or", [IR_XOR] = "xor",
+        [IR_SHL] = "shl", [IR_SHR] = "shr",
+        [IR_EQ] = "eq", [IR_NE] = "ne", [IR_LT] = "lt", [IR_LE] = "le",
+        [IR_GT] = "gt", [IR_GE] = "ge",
+        [IR_NEG] = "neg", [IR_BITNOT] = "not",
+        [IR_JUMP] = "jump", [IR_BRANCH] = "branch", [IR_RET] = "ret",
+    };
+    return op < IR_OP_COUNT && names[op] ? names[op] : "?";
+}
+
+IRType ir_type_from_data_type(DataType type) {
+    switch (type) {
+        case TYPE_VOID:
+            return IR_TYPE_VOID;
+        case TYPE_CHAR:
+        case TYPE_BOOL:
+        case TYPE_SIGNED_CHAR:
+        case TYPE_UNSIGNED_CHAR:
+            return IR_TYPE_I8;
+        case TYPE_SHORT:
+        case TYPE_UNSIGNED_SHORT:
+            return IR_TYPE_I16;
+        case TYPE_LONG:
+        case TYPE_LONG_LONG:
+        case TYPE_UNSIGNED_LONG:
+            return IR_TYPE_I64;
+        case TYPE_FLOAT:
+            return IR_TYPE_F32;
+        case TYPE_DOUBLE:
+        case TYPE_LONG_DOUBLE:
+            return IR_TYPE_F64;
+        case TYPE_STRING:
+        case TYPE_ID:
+        case TYPE_CLASS:
+        case TYPE_SEL:
+        case TYPE_POINTER:
+        case TYPE_FUNCTION_POINTER:
+        case TYPE_ARRAY:
+            return IR_TYPE_PTR;
+        default:
+            return IR_TYPE_I32;
+    }
+}
+
+int ir_type_size(IRType type) {
+    switch (type) {
+        case IR_TYPE_VOID: return 0;
+        case IR_TYPE_I8:   return 1;
+        case IR_TYPE_I16:  return 2;
+        case IR_TYPE_I32:
+        case IR_TYPE_F32:  return 4;
+        default:           return 8;
+    }
+}
+
+// ============================================================================
+// Printing
+// ============================================================================
+
+static void ir_print_operand(const IRInstr *value, FILE *out) {
+    value = ir_resolve((IRInstr *)value);
+    if (!value) {
+        fputs("<null>", out);
+    } else if (value->op == IR_CONST && (value->type == IR_TYPE_F32 || value->type == IR_TYPE_F64)) {
+        fprintf(out, "%g", value->data.fconstant);
+    } else if (value->op == IR_CONST) {
+        fprintf(out, "%" PRId64, value->data.constant);
+    } else {
+        fprintf(out, "%%%d", value->id);
+    }
+}
+
+static void ir_print_instr(const IRInstr *instr, FILE *out) {
+    fputs("    ", out);
+    if (instr->id >= 0) {
+        fprintf(out, "%%%d = ", instr->id);
+    }
+    fputs(ir_op_name(instr->op), out);
+    if (instr->type != IR_TYPE_VOID || instr->op == IR_CALL) {
+        fprintf(out, " %s", ir_type_name(instr->type));
+    }
+
+    switch (instr->op) {
+        case IR_PARAM:
+            fprintf(out, " %d\n", instr->data.index);
+            return;
+        case IR_GLOBAL_ADDR:
+            fprintf(out, " @%s\n", instr->data.symbol);
+            return;
+        case IR_PHI:
+            for (int i = 0; i < instr->operand_count; i++) {
+                fputs(i ? ", [" : " [", out);
+                ir_print_operand(instr->operands[i], out);
+                fprintf(out, ", bb%d]", instr->block->preds[i]->id);
+            }
+            fputc('\n', out);
+            return;
+        case IR_CALL:
+            fprintf(out, " @%s(", instr->data.symbol);
+            for (int i = 0; i < instr->operand_count; i++) {
+                if (i) fputs(", ", out);
+                ir_print_operand(instr->operands[i], out);
+            }
+            fputs(")\n", out);
+            return;
+        case IR_JUMP:
+            fprintf(out, " bb%d\n", instr->data.targets[0]->id);
+            return;
+        case IR_BRANCH:
+            fputc(' ', out);
+            ir_print_operand(instr->operands[0], out);
+            fprintf(out, ", bb%d, bb%d\n", instr->data.targets[0]->id, instr->data.targets[1]->id);
+            return;
+        default:
+            for (int i = 0; i < instr->operand_count; i++) {
+                fputs(i ? ", " : " ", out);
+                ir_print_operand(instr->operands[i], out);
+            }
+            fputc('\n', out);
+            return;
+    }
+}
+
+void ir_print_function(const IRFunction *function, FILE *out) {
+    fprintf(out, "function %s @%s(", ir_type_name(function->return_type), function->name);
+    for (int i = 0; i < function->param_count; i++) {
+        if (i) fputs(", ", out);
+        fprintf(out, "%s", ir_type_name(function->params[i]->type));
+    }
+    fputs(") {\n", out);
+
+    for (const IRBlock *block = function->entry; block; block = block->next) {
+        fprintf(out, "bb%d:", block->id);
+        if (block->pred_count) {
+            fputs("    ; preds:", out);
+            for (int i = 0; i < block->pred_count; i++) {
+                fprintf(out, " bb%d", block->preds[i]->id);
+            }
+        }
+        fputc('\n', out);
+        for (const IRInstr *instr = block->first; instr; instr = instr->next) {
+            ir_print_instr(instr, out);
+        }
+    }
+    fputs("}\n", out);
+}
+
+void ir_print_module(const IRModule *module, FILE *out) {
+    for (const IRGlobal *global = module->globals; global; global = global->next) {
+        fprintf(out, "global %s @%s", ir_type_name(global->type), global->name);
+        if (global->string) {
+            fprintf(out, " = \"%s\"", global->string);
+        } else if (global->has_initializer) {
+            fprintf(out, " = %" PRId64, global->initializer);
+        }
+        fputc('\n', out);
+    }
+    if (module->globals && module->functions) {
+        fputc('\n', out);
+    }
+
+    for (const IRFunction *function = module->functions; function; function = function->next) {
+        ir_print_function(function, out);
+        if (function->next) {
+            fputc('\n', out);
+        }
+    }
+}
@@ -0,0 +1,1089 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ir.h"
+#include "ast.h"
+#include "error.h"
+#include "intern.h"
+
+// AST to SSA lowering.
+// Local variables never touch memory: SSA form is built on the fly while
+// the statements are walked (Braun et al., "Simple and Efficient
+// Construction of Static Single Assignment Form"). Each block records the
+// current value of every variable assigned in it; a read in a block without
+// one asks the predecessors, placing a phi where control flow merges. Blocks
+// whose predecessors are not all known yet (loop headers, break targets)
+// stay unsealed and collect incomplete phis that are filled in once the
+// block is sealed. Phis that turn out to merge a single value are folded
+// away. Globals are reached through addr/load/store.
+
+#define IR_DEFS_INITIAL_SIZE 256
+
+typedef struct {
+    const char *name;            // Interned
+    IRType type;
+} IRLowerVar;
+
+// Variable visible by name; inner declarations shadow outer ones
+typedef struct {
+    const char *name;
+    int var;
+} IRLowerBinding;
+
+// Current value of a variable at the end of a block, keyed by both ids
+typedef struct {
+    uint64_t key;                // 0 marks an empty slot
+    IRInstr *value;
+} IRLowerDef;
+
+typedef struct {
+    IRBlock *block;
+    IRInstr *phi;
+    int var;
+} IRLowerIncomplete;
+
+typedef struct {
+    const char *name;
+    IRType return_type;
+    int param_count;
+    ASTNode **params;
+} IRLowerSignature;
+
+typedef struct {
+    IRModule *module;
+    IRFunction *function;
+    IRBlock *block;              // Instructions are appended here
+
+    IRLowerVar *vars;
+    int var_count;
+    int var_capacity;
+
+    IRLowerBinding *bindings;
+    int binding_count;
+    int binding_capacity;
+
+    IRLowerDef *defs;
+    size_t def_count;
+    size_t def_capacity;         // Power of two
+
+    IRLowerIncomplete *incomplete;
+    int incomplete_count;
+    int incomplete_capacity;
+
+    IRLowerSignature *signatures;
+    int signature_count;
+
+    IRBlock *break_target;
+    IRBlock *continue_target;
+    bool failed;                 // Out of memory
+} IRLower;
+
+static IRInstr *ir_lower_expression(IRLower *lower, ASTNode *node);
+static void ir_lower_statement(IRLower *lower, ASTNode *node);
+
+// Grows a context array by doubling; false when out of memory
+static bool ir_lower_reserve(IRLower *lower, void **items, int *capacity, int count, size_t size) {
+    if (count < *capacity) return true;
+
+    int grown = *capacity ? *capacity * 2 : 16;
+    void *resized = realloc(*items, size * (size_t)grown);
+    if (!resized) {
+        lower->failed = true;
+        return false;
+    }
+    *items = resized;
+    *capacity = grown;
+    return true;
+}
+
+// Errors go through the error module, so the driver's error_has_errors()
+// check fails the compile; lowering carries on with an undef to find more
+static void ir_lower_unsupported(ASTNode *node, const char *what, const char *name) {
+    error_semantic(node ? node->line : 0, node ? node->column : 0, "%s%s%s is not supported",
+                   what, name ? " " : "", name ? name : "");
+}
+
+// ============================================================================
+// Blocks and instructions
+// ============================================================================
+
+static IRBlock *ir_lower_new_block(IRLower *lower) {
+    return ir_block_create(lower->module, lower->function);
+}
+
+// Continues emitting into block, which joins the layout here
+static void ir_lower_start_block(IRLower *lower, IRBlock *block) {
+    ir_function_append_block(lower->function, block);
+    lower->block = block;
+}
+
+// Code after a return, break or continue goes to a block nothing reaches;
+// it is dropped once the function is complete
+static void ir_lower_start_dead_block(IRLower *lower) {
+    IRBlock *block = ir_lower_new_block(lower);
+    block->sealed = true;
+    ir_lower_start_block(lower, block);
+}
+
+static IRInstr *ir_lower_emit(IRLower *lower, IROp op, IRType type, int operand_count) {
+    IRInstr *instr = ir_instr_create(lower->module, lower->function, op, type, operand_count);
+    ir_block_append(lower->block, instr);
+    return instr;
+}
+
+// Nothing reaches the current block, so its edges would only feed
+// undefined values into the phis of their targets
+static bool ir_lower_in_dead_block(const IRLower *lower) {
+    return lower->block->sealed && lower->block->pred_count == 0 &&
+           lower->block != lower->function->entry;
+}
+
+static void ir_lower_jump(IRLower *lower, IRBlock *target) {
+    if (ir_lower_in_dead_block(lower)) return;
+
+    IRInstr *jump = ir_lower_emit(lower, IR_JUMP, IR_TYPE_VOID, 0);
+    jump->data.targets[0] = target;
+    ir_block_add_pred(lower->module, target, lower->block);
+}
+
+static void ir_lower_branch(IRLower *lower, IRInstr *condition, IRBlock *if_true, IRBlock *if_false) {
+    if (ir_lower_in_dead_block(lower)) return;
+    if (condition->op == IR_CONST || if_true == if_false) {
+        ir_lower_jump(lower, condition->op != IR_CONST || condition->data.constant ? if_true : if_false);
+        return;
+    }
+
+    IRInstr *branch = ir_lower_emit(lower, IR_BRANCH, IR_TYPE_VOID, 1);
+    branch->operands[0] = condition;
+    branch->data.targets[0] = if_true;
+    branch->data.targets[1] = if_false;
+    ir_block_add_pred(lower->module, if_true, lower->block);
+    ir_block_add_pred(lower->module, if_false, lower->block);
+}
+
+// ============================================================================
+// SSA construction
+// ============================================================================
+
+static uint64_t ir_lower_def_key(const IRBlock *block, int var) {
+    return ((uint64_t)(uint32_t)block->id << 32 | (uint32_t)var) + 1;
+}
+
+static size_t ir_lower_def_slot(const IRLower *lower, uint64_t key) {
+    size_t mask = lower->def_capacity - 1;
+    size_t slot = (size_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+    while (lower->defs[slot].key && lower->defs[slot].key != key) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void ir_lower_write_var(IRLower *lower, int var, IRBlock *block, IRInstr *value) {
+    if ((lower->def_count + 1) * 2 > lower->def_capacity) {
+        IRLowerDef *old = lower->defs;
+        size_t old_capacity = lower->def_capacity;
+        IRLowerDef *defs = calloc(old_capacity * 2, sizeof(IRLowerDef));
+        if (!defs) {
+            lower->failed = true;
+            return;
+        }
+        lower->defs = defs;
+        lower->def_capacity = old_capacity * 2;
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old[i].key) {
+                lower->defs[ir_lower_def_slot(lower, old[i].key)] = old[i];
+            }
+        }
+        free(old);
+    }
+
+    uint64_t key = ir_lower_def_key(block, var);
+    size_t slot = ir_lower_def_slot(lower, key);
+    if (!lower->defs[slot].key) {
+        lower->defs[slot].key = key;
+        lower->def_count++;
+    }
+    lower->defs[slot].value = value;
+}
+
+static IRInstr *ir_lower_undef(IRLower *lower, IRType type) {
+    // Kept at the top of the entry block, where it dominates every use
+    IRInstr *undef = ir_instr_create(lower->module, lower->function, IR_UNDEF, type, 0);
+    ir_block_insert_phi(lower->function->entry, undef);
+    return undef;
+}
+
+static IRInstr *ir_lower_new_phi(IRLower *lower, IRBlock *block, IRType type) {
+    IRInstr *phi = ir_instr_create(lower->module, lower->function, IR_PHI, type, 0);
+    ir_block_insert_phi(block, phi);
+    return phi;
+}
+
+// A phi merging only itself and one other value is that value
+static IRInstr *ir_lower_try_remove_trivial_phi(IRLower *lower, IRInstr *phi) {
+    IRInstr *same = NULL;
+    for (int i = 0; i < phi->operand_count; i++) {
+        IRInstr *operand = ir_resolve(phi->operands[i]);
+        if (operand == same || operand == phi) continue;
+        if (same) return phi;
+        same = operand;
+    }
+    if (!same) {
+        same = ir_lower_undef(lower, phi->type);
+    }
+
+    ir_instr_remove(phi);
+    phi->replacement = same;
+    return same;
+}
+
+static IRInstr *ir_lower_read_var(IRLower *lower, int var, IRBlock *block);
+
+static IRInstr *ir_lower_add_phi_operands(IRLower *lower, int var, IRInstr *phi) {
+    IRBlock *block = phi->block;
+    phi->operands = arena_calloc(lower->module->arena, (size_t)(block->pred_count ? block->pred_count : 1),
+                                 sizeof(IRInstr*));
+    for (int i = 0; i < block->pred_count; i++) {
+        phi->operands[i] = ir_lower_read_var(lower, var, block->preds[i]);
+        phi->operand_count = i + 1;
+    }
+    return ir_lower_try_remove_trivial_phi(lower, phi);
+}
+
+static IRInstr *ir_lower_read_var(IRLower *lower, int var, IRBlock *block) {
+    if (lower->def_capacity) {
+        size_t slot = ir_lower_def_slot(lower, ir_lower_def_key(block, var));
+        if (lower->defs[slot].key) {
+            return ir_resolve(lower->defs[slot].value);
+        }
+    }
+
+    IRType type = lower->vars[var].type;
+    IRInstr *value;
+    if (!block->sealed) {
+        value = ir_lower_new_phi(lower, block, type);
+        if (ir_lower_reserve(lower, (void **)&lower->incomplete, &lower->incomplete_capacity,
+                             lower->incomplete_count, sizeof(IRLowerIncomplete))) {
+            lower->incomplete[lower->incomplete_count++] = (IRLowerIncomplete){block, value, var};
+        }
+    } else if (block->pred_count == 0) {
+        value = ir_lower_undef(lower, type);
+    } else if (block->pred_count == 1) {
+        value = ir_lower_read_var(lower, var, block->preds[0]);
+    } else {
+        // Recorded before the operands are read, so loops end at the phi
+        IRInstr *phi = ir_lower_new_phi(lower, block, type);
+        ir_lower_write_var(lower, var, block, phi);
+        value = ir_lower_add_phi_operands(lower, var, phi);
+    }
+    ir_lower_write_var(lower, var, block, value);
+    return value;
+}
+
+// All predecessors of block are known: complete its pending phis
+static void ir_lower_seal_block(IRLower *lower, IRBlock *block) {
+    int kept = 0;
+    for (int i = 0; i < lower->incomplete_count; i++) {
+        IRLowerIncomplete entry = lower->incomplete[i];
+        if (entry.block == block) {
+            ir_lower_add_phi_operands(lower, entry.var, entry.phi);
+        } else {
+            lower->incomplete[kept++] = entry;
+        }
+    }
+    lower->incomplete_count = kept;
+    block->sealed = true;
+}
+
+// ============================================================================
+// Variables
+// ============================================================================
+
+static int ir_lower_declare(IRLower *lower, const char *name, IRType type) {
+    if (!ir_lower_reserve(lower, (void **)&lower->vars, &lower->var_capacity,
+                          lower->var_count, sizeof(IRLowerVar)) ||
+        !ir_lower_reserve(lower, (void **)&lower->bindings, &lower->binding_capacity,
+                          lower->binding_count, sizeof(IRLowerBinding))) {
+        return -1;
+    }
+
+    int var = lower->var_count++;
+    lower->vars[var] = (IRLowerVar){name, type};
+    lower->bindings[lower->binding_count++] = (IRLowerBinding){name, var};
+    return var;
+}
+
+static int ir_lower_lookup(const IRLower *lower, const char *name) {
+    for (int i = lower->binding_count - 1; i >= 0; i--) {
+        if (lower->bindings[i].name == name) {
+            return lower->bindings[i].var;
+        }
+    }
+    return -1;
+}
+
+static const IRLowerSignature *ir_lower_signature(const IRLower *lower, const char *name) {
+    for (int i = 0; i < lower->signature_count; i++) {
+        if (lower->signatures[i].name == name) {
+            return &lower->signatures[i];
+        }
+    }
+    return NULL;
+}
+
+// ============================================================================
+// Expressions
+// ============================================================================
+
+static bool ir_type_is_float(IRType type) {
+    return type == IR_TYPE_F32 || type == IR_TYPE_F64;
+}
+
+// Wraps an integer constant to the width of type
+static int64_t ir_lower_truncate(IRType type, int64_t value) {
+    switch (type) {
+        case IR_TYPE_I8:  return (int8_t)value;
+        case IR_TYPE_I16: return (int16_t)value;
+        case IR_TYPE_I32: return (int32_t)value;
+        default:          return value;
+    }
+}
+
+static IRInstr *ir_lower_convert(IRLower *lower, IRInstr *value, IRType type) {
+    if (value->type == type || type == IR_TYPE_VOID) {
+        return value;
+    }
+
+    if (value->op == IR_CONST) {
+        bool from_float = ir_type_is_float(value->type);
+        if (ir_type_is_float(type)) {
+            return ir_fconst(lower->module, type,
+                             from_float ? value->data.fconstant : (double)value->data.constant);
+        }
+        int64_t integer = from_float ? (int64_t)value->data.fconstant : value->data.constant;
+        return ir_const(lower->module, type, ir_lower_truncate(type, integer));
+    }
+
+    IRInstr *convert = ir_lower_emit(lower, IR_CONVERT, type, 1);
+    convert->operands[0] = value;
+    return convert;
+}
+
+// Usual arithmetic conversions: small integers promote to i32, floating
+// point and wider operands win
+static IRType ir_lower_common_type(IRType left, IRType right) {
+    if (left == IR_TYPE_F64 || right == IR_TYPE_F64) return IR_TYPE_F64;
+    if (left == IR_TYPE_F32 || right == IR_TYPE_F32) return IR_TYPE_F32;
+    if (left == IR_TYPE_PTR || right == IR_TYPE_PTR) return IR_TYPE_PTR;
+    if (left == IR_TYPE_I64 || right == IR_TYPE_I64) return IR_TYPE_I64;
+    return IR_TYPE_I32;
+}
+
+static bool ir_lower_fold(IROp op, int64_t a, int64_t b, int64_t *result) {
+    switch (op) {
+        case IR_ADD: *result = (int64_t)((uint64_t)a + (uint64_t)b); return true;
+        case IR_SUB: *result = (int64_t)((uint64_t)a - (uint64_t)b); return true;
+        case IR_MUL: *result = (int64_t)((uint64_t)a * (uint64_t)b); return true;
+        case IR_DIV:
+            if (b == 0 || (a == INT64_MIN && b == -1)) return false;
+            *result = a / b;
+            return true;
+        case IR_MOD:
+            if (b == 0 || (a == INT64_MIN && b == -1)) return false;
+            *result = a % b;
+            return true;
+        case IR_AND: *result = a & b; return true;
+        case IR_OR:  *result = a | b; return true;
+        case IR_XOR: *result = a ^ b; return true;
+        case IR_SHL:
+            if (b < 0 || b > 63) return false;
+            *result = (int64_t)((uint64_t)a << b);
+            return true;
+        case IR_SHR:
+            if (b < 0 || b > 63) return false;
+            *result = a >> b;
+            return true;
+        case IR_EQ: *result = a == b; return true;
+        case IR_NE: *result = a != b; return true;
+        case IR_LT: *result = a < b; return true;
+        case IR_LE: *result = a <= b; return true;
+        case IR_GT: *result = a > b; return true;
+        case IR_GE: *result = a >= b; return true;
+        default:    return false;
+    }
+}
+
+static IRInstr *ir_lower_binary(IRLower *lower, IROp op, IRInstr *left, IRInstr *right) {
+    IRType operand_type = ir_lower_common_type(left->type, right->type);
+    IRType result_type = op >= IR_EQ && op <= IR_GE ? IR_TYPE_I32 : operand_type;
+    left = ir_lower_convert(lower, left, operand_type);
+    right = ir_lower_convert(lower, right, operand_type);
+
+    int64_t folded;
+    if (left->op == IR_CONST && right->op == IR_CONST && !ir_type_is_float(operand_type) &&
+        ir_lower_fold(op, left->data.constant, right->data.constant, &folded)) {
+        return ir_const(lower->module, result_type, ir_lower_truncate(result_type, folded));
+    }
+
+    IRInstr *instr = ir_lower_emit(lower, op, result_type, 2);
+    instr->operands[0] = left;
+    instr->operands[1] = right;
+    return instr;
+}
+
+// 1 when value is nonzero, else 0
+static IRInstr *ir_lower_truth(IRLower *lower, IRInstr *value) {
+    if (value->op >= IR_EQ && value->op <= IR_GE) {
+        return value;
+    }
+    return ir_lower_binary(lower, IR_NE, value, ir_const(lower->module, value->type, 0));
+}
+
+// a && b and a || b: the right operand only runs when it decides the result
+static IRInstr *ir_lower_logical(IRLower *lower, ASTNode *node) {
+    bool is_and = node->data.binary_expr.operator == TOKEN_AND;
+    IRInstr *left = ir_lower_truth(lower, ir_lower_expression(lower, node->data.binary_expr.left));
+    if (left->op == IR_CONST && (left->data.constant != 0) == is_and) {
+        // The left operand never short-circuits
+        return ir_lower_truth(lower, ir_lower_expression(lower, node->data.binary_expr.right));
+    }
+    if (left->op == IR_CONST) {
+        return ir_const(lower->module, IR_TYPE_I32, is_and ? 0 : 1);
+    }
+
+    IRBlock *rhs = ir_lower_new_block(lower);
+    IRBlock *done = ir_lower_new_block(lower);
+    if (is_and) {
+        ir_lower_branch(lower, left, rhs, done);
+    } else {
+        ir_lower_branch(lower, left, done, rhs);
+    }
+    ir_lower_seal_block(lower, rhs);
+
+    ir_lower_start_block(lower, rhs);
+    IRInstr *right = ir_lower_truth(lower, ir_lower_expression(lower, node->data.binary_expr.right));
+    ir_lower_jump(lower, done);
+    ir_lower_seal_block(lower, done);
+
+    ir_lower_start_block(lower, done);
+    IRInstr *phi = ir_lower_new_phi(lower, done, IR_TYPE_I32);
+    phi->operands = arena_calloc(lower->module->arena, 2, sizeof(IRInstr*));
+    phi->operands[0] = ir_const(lower->module, IR_TYPE_I32, is_and ? 0 : 1);
+    phi->operands[1] = right;
+    phi->operand_count = 2;
+    return phi;
+}
+
+static IROp ir_lower_binary_op(TokenType op) {
+    switch (op) {
+        case TOKEN_PLUS:          return IR_ADD;
+        case TOKEN_MINUS:         return IR_SUB;
+        case TOKEN_MULTIPLY:      return IR_MUL;
+        case TOKEN_DIVIDE:        return IR_DIV;
+        case TOKEN_MODULO:        return IR_MOD;
+        case TOKEN_BITWISE_AND:
+        case TOKEN_AMPERSAND:     return IR_AND;
+        case TOKEN_BITWISE_OR:
+        case TOKEN_PIPE:          return IR_OR;
+        case TOKEN_BITWISE_XOR:   return IR_XOR;
+        case TOKEN_LEFT_SHIFT:    return IR_SHL;
+        case TOKEN_RIGHT_SHIFT:   return IR_SHR;
+        case TOKEN_EQUAL:         return IR_EQ;
+        case TOKEN_NOT_EQUAL:     return IR_NE;
+        case TOKEN_LESS:          return IR_LT;
+        case TOKEN_LESS_EQUAL:    return IR_LE;
+        case TOKEN_GREATER:       return IR_GT;
+        case TOKEN_GREATER_EQUAL: return IR_GE;
+        default:                  return IR_OP_COUNT;
+    }
+}
+
+static IRInstr *ir_lower_global_address(IRLower *lower, const char *symbol) {
+    IRInstr *address = ir_lower_emit(lower, IR_GLOBAL_ADDR, IR_TYPE_PTR, 0);
+    address->data.symbol = symbol;
+    return address;
+}
+
+static IRInstr *ir_lower_identifier(IRLower *lower, ASTNode *node) {
+    const char *name = node->data.identifier.name;
+    int var = ir_lower_lookup(lower, name);
+    if (var >= 0) {
+        return ir_lower_read_var(lower, var, lower->block);
+    }
+
+    IRGlobal *global = ir_global_find(lower->module, name);
+    if (global) {
+        IRInstr *address = ir_lower_global_address(lower, global->name);
+        IRInstr *load = ir_lower_emit(lower, IR_LOAD, global->type, 1);
+        load->operands[0] = address;
+        return load;
+    }
+
+    error_semantic(node->line, node->column, "Use of undeclared identifier '%s'", name);
+    return ir_lower_undef(lower, IR_TYPE_I32);
+}
+
+static IRInstr *ir_lower_assignment(IRLower *lower, ASTNode *node) {
+    const char *name = node->data.assignment.variable;
+    IRInstr *value = ir_lower_expression(lower, node->data.assignment.value);
+
+    int var = ir_lower_lookup(lower, name);
+    if (var >= 0) {
+        value = ir_lower_convert(lower, value, lower->vars[var].type);
+        ir_lower_write_var(lower, var, lower->block, value);
+        return value;
+    }
+
+    IRGlobal *global = ir_global_find(lower->module, name);
+    if (global) {
+        value = ir_lower_convert(lower, value, global->type);
+        IRInstr *address = ir_lower_global_address(lower, global->name);
+        IRInstr *store = ir_lower_emit(lower, IR_STORE, IR_TYPE_VOID, 2);
+        store->operands[0] = address;
+        store->operands[1] = value;
+        return value;
+    }
+
+    error_semantic(node->line, node->column, "Assignment to undeclared identifier '%s'", name);
+    return value;
+}
+
+static IRInstr *ir_lower_call(IRLower *lower, ASTNode *node) {
+    const IRLowerSignature *signature = ir_lower_signature(lower, node->data.call_expr.function_name);
+    int count = node->data.call_expr.argument_count;
+
+    // Arguments are evaluated before the call is placed
+    IRInstr **arguments = count ? arena_alloc(lower->module->arena, sizeof(IRInstr*) * (size_t)count) : NULL;
+    for (int i = 0; i < count; i++) {
+        arguments[i] = ir_lower_expression(lower, node->data.call_expr.arguments[i]);
+        if (signature && i < signature->param_count) {
+            IRType type = ir_type_from_data_type(signature->params[i]->data.parameter.param_type);
+            arguments[i] = ir_lower_convert(lower, arguments[i], type);
+        }
+    }
+
+    // Undeclared functions return int
+    IRInstr *call = ir_lower_emit(lower, IR_CALL, signature ? signature->return_type : IR_TYPE_I32, 0);
+    call->data.symbol = node->data.call_expr.function_name;
+    call->operands = arguments;
+    call->operand_count = count;
+    return call;
+}
+
+static IRInstr *ir_lower_expression(IRLower *lower, ASTNode *node) {
+    if (!node) {
+        return ir_lower_undef(lower, IR_TYPE_I32);
+    }
+
+    switch (node->type) {
+        case AST_NUMBER_LITERAL:
+            return ir_const(lower->module, IR_TYPE_I32, node->data.number.value);
+
+        case AST_CHAR_LITERAL:
+            return ir_const(lower->module, IR_TYPE_I32, node->data.char_literal.value);
+
+        case AST_LONG_LITERAL:
+            return ir_const(lower->module, IR_TYPE_I64, node->data.long_literal.value);
+
+        case AST_ULONG_LITERAL:
+            return ir_const(lower->module, IR_TYPE_I64, (int64_t)node->data.ulong_literal.value);
+
+        case AST_FLOAT_LITERAL:
+            return ir_fconst(lower->module, IR_TYPE_F32, node->data.float_literal.value);
+
+        case AST_DOUBLE_LITERAL:
+            return ir_fconst(lower->module, IR_TYPE_F64, node->data.double_literal.value);
+
+        case AST_OBJC_BOOLEAN_LITERAL:
+            return ir_const(lower->module, IR_TYPE_I8, node->data.objc_boolean.value);
+
+        case AST_STRING_LITERAL:
+            return ir_lower_global_address(lower,
+                ir_string_literal(lower->module, node->data.string.value));
+
+        case AST_IDENTIFIER:
+            return ir_lower_identifier(lower, node);
+
+        case AST_ASSIGNMENT:
+            return ir_lower_assignment(lower, node);
+
+        case AST_FUNCTION_CALL:
+            return ir_lower_call(lower, node);
+
+        case AST_CAST_EXPR:
+            return ir_lower_convert(lower, ir_lower_expression(lower, node->data.cast_expr.operand),
+                                    ir_type_from_data_type(node->data.cast_expr.target_type));
+
+        case AST_BINARY_OP: {
+            TokenType token = node->data.binary_expr.operator;
+            if (token == TOKEN_AND || token == TOKEN_OR) {
+                return ir_lower_logical(lower, node);
+            }
+
+            IROp op = ir_lower_binary_op(token);
+            if (op == IR_OP_COUNT) {
+                ir_lower_unsupported(node, "Operator", token_type_to_string(token));
+                return ir_lower_undef(lower, IR_TYPE_I32);
+            }
+            IRInstr *left = ir_lower_expression(lower, node->data.binary_expr.left);
+            IRInstr *right = ir_lower_expression(lower, node->data.binary_expr.right);
+            return ir_lower_binary(lower, op, left, right);
+        }
+
+        case AST_UNARY_OP: {
+            IRInstr *operand = ir_lower_expression(lower, node->data.unary_expr.operand);
+            switch (node->data.unary_expr.operator) {
+                case TOKEN_NOT:
+                    return ir_lower_binary(lower, IR_EQ, operand, ir_const(lower->module, operand->type, 0));
+                case TOKEN_MINUS:
+                case TOKEN_BITWISE_NOT: {
+                    IROp op = node->data.unary_expr.operator == TOKEN_MINUS ? IR_NEG : IR_BITNOT;
+                    IRType type = ir_lower_common_type(operand->type, IR_TYPE_I32);
+                    operand = ir_lower_convert(lower, operand, type);
+                    if (operand->op == IR_CONST && ir_type_is_float(type)) {
+                        if (op == IR_NEG) return ir_fconst(lower->module, type, -operand->data.fconstant);
+                    } else if (operand->op == IR_CONST) {
+                        int64_t value = op == IR_NEG ? (int64_t)(0 - (uint64_t)operand->data.constant)
+                                                     : ~operand->data.constant;
+                        return ir_const(lower->module, type, ir_lower_truncate(type, value));
+                    }
+                    IRInstr *instr = ir_lower_emit(lower, op, type, 1);
+                    instr->operands[0] = operand;
+                    return instr;
+                }
+                default:
+                    ir_lower_unsupported(node, "Unary operator",
+                                         token_type_to_string(node->data.unary_expr.operator));
+                    return ir_lower_undef(lower, IR_TYPE_I32);
+            }
+        }
+
+        default:
+            ir_lower_unsupported(node, "Expression", ast_node_type_to_string(node->type));
+            return ir_lower_undef(lower, IR_TYPE_I32);
+    }
+}
+
+// ============================================================================
+// Statements
+// ============================================================================
+
+static void ir_lower_statements(IRLower *lower, ASTNode **statements, int count) {
+    // Declarations in the list go out of scope at its end
+    int bindings = lower->binding_count;
+    for (int i = 0; i < count; i++) {
+        ir_lower_statement(lower, statements[i]);
+    }
+    lower->binding_count = bindings;
+}
+
+static void ir_lower_if(IRLower *lower, ASTNode *node) {
+    IRInstr *condition = ir_lower_expression(lower, node->data.if_stmt.condition);
+    IRBlock *then_block = ir_lower_new_block(lower);
+    IRBlock *else_block = node->data.if_stmt.else_stmt ? ir_lower_new_block(lower) : NULL;
+    IRBlock *done = ir_lower_new_block(lower);
+
+    ir_lower_branch(lower, condition, then_block, else_block ? else_block : done);
+    ir_lower_seal_block(lower, then_block);
+    ir_lower_start_block(lower, then_block);
+    ir_lower_statement(lower, node->data.if_stmt.then_stmt);
+    ir_lower_jump(lower, done);
+
+    if (else_block) {
+        ir_lower_seal_block(lower, else_block);
+        ir_lower_start_block(lower, else_block);
+        ir_lower_statement(lower, node->data.if_stmt.else_stmt);
+        ir_lower_jump(lower, done);
+    }
+
+    ir_lower_seal_block(lower, done);
+    ir_lower_start_block(lower, done);
+}
+
+// while and for share one shape: header (condition), body, latch (update)
+static void ir_lower_loop(IRLower *lower, ASTNode *condition, ASTNode *update, ASTNode *body) {
+    IRBlock *header = ir_lower_new_block(lower);
+    IRBlock *body_block = ir_lower_new_block(lower);
+    IRBlock *latch = update ? ir_lower_new_block(lower) : header;
+    IRBlock *done = ir_lower_new_block(lower);
+
+    ir_lower_jump(lower, header);
+    ir_lower_start_block(lower, header);
+    IRInstr *test = condition ? ir_lower_expression(lower, condition)
+                              : ir_const(lower->module, IR_TYPE_I32, 1);
+    ir_lower_branch(lower, test, body_block, done);
+
+    IRBlock *saved_break = lower->break_target;
+    IRBlock *saved_continue = lower->continue_target;
+    lower->break_target = done;
+    lower->continue_target = latch;
+
+    ir_lower_seal_block(lower, body_block);
+    ir_lower_start_block(lower, body_block);
+    ir_lower_statement(lower, body);
+    ir_lower_jump(lower, latch);
+
+    if (update) {
+        ir_lower_seal_block(lower, latch);
+        ir_lower_start_block(lower, latch);
+        ir_lower_expression(lower, update);
+        ir_lower_jump(lower, header);
+    }
+
+    lower->break_target = saved_break;
+    lower->continue_target = saved_continue;
+
+    ir_lower_seal_block(lower, header);
+    ir_lower_seal_block(lower, done);
+    ir_lower_start_block(lower, done);
+}
+
+// A chain of comparisons; case bodies fall through into the next one
+static void ir_lower_switch(IRLower *lower, ASTNode *node) {
+    int count = node->data.switch_stmt.case_count;
+    IRInstr *value = ir_lower_expression(lower, node->data.switch_stmt.expression);
+    IRBlock *done = ir_lower_new_block(lower);
+    IRBlock **bodies = arena_alloc(lower->module->arena, sizeof(IRBlock*) * (size_t)(count + 1));
+    IRBlock *default_block = done;
+
+    for (int i = 0; i < count; i++) {
+        bodies[i] = ir_lower_new_block(lower);
+        if (node->data.switch_stmt.cases[i]->data.case_stmt.is_default) {
+            default_block = bodies[i];
+        }
+    }
+    bodies[count] = done;
+
+    for (int i = 0; i < count; i++) {
+        ASTNode *case_node = node->data.switch_stmt.cases[i];
+        if (case_node->data.case_stmt.is_default) continue;
+
+        IRInstr *match = ir_lower_binary(lower, IR_EQ, value,
+                                         ir_lower_expression(lower, case_node->data.case_stmt.value));
+        IRBlock *next = ir_lower_new_block(lower);
+        ir_lower_branch(lower, match, bodies[i], next);
+        ir_lower_seal_block(lower, next);
+        ir_lower_start_block(lower, next);
+    }
+    ir_lower_jump(lower, default_block);
+
+    IRBlock *saved_break = lower->break_target;
+    lower->break_target = done;
+    for (int i = 0; i < count; i++) {
+        ASTNode *case_node = node->data.switch_stmt.cases[i];
+        ir_lower_seal_block(lower, bodies[i]);
+        ir_lower_start_block(lower, bodies[i]);
+        ir_lower_statements(lower, case_node->data.case_stmt.statements,
+                            case_node->data.case_stmt.statement_count);
+        ir_lower_jump(lower, bodies[i + 1]);
+    }
+    lower->break_target = saved_break;
+
+    ir_lower_seal_block(lower, done);
+    ir_lower_start_block(lower, done);
+}
+
+static void ir_lower_return(IRLower *lower, ASTNode *node) {
+    IRType type = lower->function->return_type;
+    ASTNode *expression = node ? node->data.return_stmt.expression : NULL;
+
+    if (expression) {
+        IRInstr *value = ir_lower_expression(lower, expression);
+        if (type != IR_TYPE_VOID) {
+            IRInstr *ret = ir_lower_emit(lower, IR_RET, IR_TYPE_VOID, 1);
+            ret->operands[0] = ir_lower_convert(lower, value, type);
+            ir_lower_start_dead_block(lower);
+            return;
+        }
+    } else if (type != IR_TYPE_VOID) {
+        IRInstr *ret = ir_lower_emit(lower, IR_RET, IR_TYPE_VOID, 1);
+        ret->operands[0] = ir_const(lower->module, type, 0);
+        ir_lower_start_dead_block(lower);
+        return;
+    }
+
+    ir_lower_emit(lower, IR_RET, IR_TYPE_VOID, 0);
+    ir_lower_start_dead_block(lower);
+}
+
+static void ir_lower_statement(IRLower *lower, ASTNode *node) {
+    if (!node) return;
+
+    switch (node->type) {
+        case AST_COMPOUND_STATEMENT:
+            ir_lower_statements(lower, node->data.compound_stmt.statements,
+                                node->data.compound_stmt.statement_count);
+            break;
+
+        case AST_VAR_DECL: {
+            IRType type = ir_type_from_data_type(node->data.var_decl.var_type);
+            IRInstr *value = node->data.var_decl.initializer
+                ? ir_lower_convert(lower, ir_lower_expression(lower, node->data.var_decl.initializer), type)
+                : NULL;
+            // Declared after the initializer, which still sees an outer variable of the same name
+            int var = ir_lower_declare(lower, node->data.var_decl.name, type);
+            if (var >= 0 && value) {
+                ir_lower_write_var(lower, var, lower->block, value);
+            }
+            break;
+        }
+
+        case AST_EXPRESSION_STATEMENT:
+            if (node->data.expression_stmt.expression) {
+                ir_lower_expression(lower, node->data.expression_stmt.expression);
+            }
+            break;
+
+        case AST_IF_STATEMENT:
+            ir_lower_if(lower, node);
+            break;
+
+        case AST_WHILE_STATEMENT:
+            ir_lower_loop(lower, node->data.while_stmt.condition, NULL, node->data.while_stmt.body);
+            break;
+
+        case AST_FOR_STATEMENT: {
+            int bindings = lower->binding_count;
+            ir_lower_statement(lower, node->data.for_stmt.init);
+            ir_lower_loop(lower, node->data.for_stmt.condition, node->data.for_stmt.update,
+                          node->data.for_stmt.body);
+            lower->binding_count = bindings;
+            break;
+        }
+
+        case AST_SWITCH_STATEMENT:
+            ir_lower_switch(lower, node);
+            break;
+
+        case AST_RETURN_STATEMENT:
+            ir_lower_return(lower, node);
+            break;
+
+        case AST_BREAK_STATEMENT:
+        case AST_CONTINUE_STATEMENT: {
+            IRBlock *target = node->type == AST_BREAK_STATEMENT ? lower->break_target
+                                                                : lower->continue_target;
+            if (!target) {
+                error_semantic(node->line, node->column, node->type == AST_BREAK_STATEMENT
+                               ? "'break' outside a loop or switch" : "'continue' outside a loop");
+                break;
+            }
+            ir_lower_jump(lower, target);
+            ir_lower_start_dead_block(lower);
+            break;
+        }
+
+        default:
+            // Bare expressions, as in a for loop's init clause
+            ir_lower_expression(lower, node);
+            break;
+    }
+}
+
+// ============================================================================
+// Functions
+// ============================================================================
+
+// Drops blocks the entry cannot reach, with their phi operands
+static void ir_lower_remove_unreachable(IRFunction *function, int block_count) {
+    bool *reachable = calloc((size_t)block_count, sizeof(bool));
+    IRBlock **worklist = malloc(sizeof(IRBlock*) * (size_t)block_count);
+    if (!reachable || !worklist) {
+        free(reachable);
+        free(worklist);
+        return;
+    }
+
+    int pending = 0;
+    reachable[function->entry->id] = true;
+    worklist[pending++] = function->entry;
+    while (pending) {
+        IRBlock *succs[2];
+        IRBlock *block = worklist[--pending];
+        int count = ir_block_successors(block, succs);
+        for (int i = 0; i < count; i++) {
+            if (!reachable[succs[i]->id]) {
+                reachable[succs[i]->id] = true;
+                worklist[pending++] = succs[i];
+            }
+        }
+    }
+
+    IRBlock *kept = NULL;
+    for (IRBlock *block = function->entry; block; block = block->next) {
+        if (!reachable[block->id]) continue;
+
+        for (int i = block->pred_count - 1; i >= 0; i--) {
+            if (!reachable[block->preds[i]->id]) {
+                ir_block_remove_pred(block, i);
+            }
+        }
+        if (kept) {
+            kept->next = block;
+        }
+        kept = block;
+    }
+    kept->next = NULL;
+    function->last_block = kept;
+
+    free(reachable);
+    free(worklist);
+}
+
+// Folds phis left trivial by removed edges or by later folding, then points
+// every operand at its final value
+static void ir_lower_finish_function(IRLower *lower, IRFunction *function) {
+    ir_lower_remove_unreachable(function, function->block_count);
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (IRBlock *block = function->entry; block; block = block->next) {
+            IRInstr *next;
+            for (IRInstr *instr = block->first; instr && instr->op == IR_PHI; instr = next) {
+                next = instr->next;
+                if (ir_lower_try_remove_trivial_phi(lower, instr) != instr) {
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    bool *used = calloc((size_t)function->value_count, sizeof(bool));
+    for (IRBlock *block = function->entry; block; block = block->next) {
+        for (IRInstr *instr = block->first; instr; instr = instr->next) {
+            for (int i = 0; i < instr->operand_count; i++) {
+                instr->operands[i] = ir_resolve(instr->operands[i]);
+                if (used && instr->operands[i]->id >= 0) {
+                    used[instr->operands[i]->id] = true;
+                }
+            }
+        }
+    }
+
+    // Undefs of folded phis may have no uses left
+    IRInstr *next;
+    for (IRInstr *instr = function->entry->first; used && instr; instr = next) {
+        next = instr->next;
+        if (instr->op == IR_UNDEF && !used[instr->id]) {
+            ir_instr_remove(instr);
+        }
+    }
+    free(used);
+
+    ir_function_renumber(function);
+}
+
+static void ir_lower_function(IRLower *lower, ASTNode *node) {
+    int param_count = node->data.function_decl.parameter_count;
+    IRFunction *function = ir_function_create(lower->module, node->data.function_decl.name,
+                                              ir_type_from_data_type(node->data.function_decl.return_type),
+                                              param_count);
+    lower->function = function;
+    lower->var_count = 0;
+    lower->binding_count = 0;
+    lower->incomplete_count = 0;
+    lower->break_target = NULL;
+    lower->continue_target = NULL;
+    memset(lower->defs, 0, sizeof(IRLowerDef) * lower->def_capacity);
+    lower->def_count = 0;
+
+    IRBlock *entry = ir_lower_new_block(lower);
+    entry->sealed = true;
+    ir_lower_start_block(lower, entry);
+
+    for (int i = 0; i < param_count; i++) {
+        ASTNode *param = node->data.function_decl.parameters[i];
+        IRType type = ir_type_from_data_type(param->data.parameter.param_type);
+        IRInstr *value = ir_lower_emit(lower, IR_PARAM, type, 0);
+        value->data.index = i;
+        function->params[i] = value;
+
+        int var = ir_lower_declare(lower, param->data.parameter.name, type);
+        if (var >= 0) {
+            ir_lower_write_var(lower, var, entry, value);
+        }
+    }
+
+    ir_lower_statement(lower, node->data.function_decl.body);
+
+    // Falling off the end returns 0 (defined for main, harmless elsewhere)
+    if (!ir_block_terminated(lower->block)) {
+        ir_lower_return(lower, NULL);
+    }
+    ir_lower_finish_function(lower, function);
+}
+
+static void ir_lower_global(IRLower *lower, ASTNode *node) {
+    const char *name = node->data.var_decl.name;
+    if (!name || !*name || ir_global_find(lower->module, name)) return;
+
+    IRGlobal *global = ir_global_create(lower->module, name,
+                                        ir_type_from_data_type(node->data.var_decl.var_type));
+    ASTNode *initializer = node->data.var_decl.initializer;
+    if (initializer && initializer->type == AST_NUMBER_LITERAL) {
+        global->has_initializer = true;
+        global->initializer = initializer->data.number.value;
+    } else if (initializer && initializer->type == AST_UNARY_OP &&
+               initializer->data.unary_expr.operator == TOKEN_MINUS &&
+               initializer->data.unary_expr.operand &&
+               initializer->data.unary_expr.operand->type == AST_NUMBER_LITERAL) {
+        global->has_initializer = true;
+        global->initializer = -(int64_t)initializer->data.unary_expr.operand->data.number.value;
+    } else if (initializer) {
+        ir_lower_unsupported(initializer, "A non-constant global initializer", NULL);
+    }
+}
+
+IRModule *ir_lower_program(ASTNode *program) {
+    if (!program || program->type != AST_PROGRAM) return NULL;
+
+    IRLower lower = {0};
+    lower.module = ir_module_create();
+    lower.defs = calloc(IR_DEFS_INITIAL_SIZE, sizeof(IRLowerDef));
+    int count = program->data.program.declaration_count;
+    lower.signatures = calloc((size_t)(count ? count : 1), sizeof(IRLowerSignature));
+    if (!lower.module || !lower.defs || !lower.signatures) {
+        ir_module_destroy(lower.module);
+        free(lower.defs);
+        free(lower.signatures);
+        return NULL;
+    }
+    lower.def_capacity = IR_DEFS_INITIAL_SIZE;
+
+    // Globals and signatures first, so uses may precede definitions
+    for (int i = 0; i < count; i++) {
+        ASTNode *decl = program->data.program.declarations[i];
+        if (decl->type == AST_VAR_DECL) {
+            ir_lower_global(&lower, decl);
+        } else if (decl->type == AST_FUNCTION_DECLARATION) {
+            lower.signatures[lower.signature_count++] = (IRLowerSignature){
+                decl->data.function_decl.name,
+                ir_type_from_data_type(decl->data.function_decl.return_type),
+                decl->data.function_decl.parameter_count,
+                decl->data.function_decl.parameters,
+            };
+        }
+    }
+
+    for (int i = 0; i < count && !lower.failed; i++) {
+        ASTNode *decl = program->data.program.declarations[i];
+        if (decl->type == AST_FUNCTION_DECLARATION && decl->data.function_decl.body) {
+            ir_lower_function(&lower, decl);
+        }
+    }
+
+    free(lower.vars);
+    free(lower.bindings);
+    free(lower.defs);
+    free(lower.incomplete);
+    free(lower.signatures);
+
+    if (lower.failed) {
+        fprintf(stderr, "Error: Out of memory while lowering to IR\n");
+        ir_module_destroy(lower.module);
+        return NULL;
+    }
+    return lower.module;
+}
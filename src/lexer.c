@@ -3,37 +3,195 @@
 #include <string.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <limits.h>
 #include "kcc.h"
 #include "lexer.h"
+#include "intern.h"
+#include "lexer_scan.h"
 
-// Keywords table
-static const struct {
+// Keyword classes: C keywords are always recognized, Objective-C words only
+// in objc_mode, and property attributes only inside "@property ( ... )".
+#define KW_C              0x01
+#define KW_OBJC           0x02
+#define KW_PROPERTY_ATTR  0x04
+
+typedef struct {
     const char *keyword;
-    TokenType type;
-} keywords[] = {
-    {"int", TOKEN_INT},
-    {"char", TOKEN_CHAR_KW},
-    {"void", TOKEN_VOID},
-    {"if", TOKEN_IF},
-    {"else", TOKEN_ELSE},
-    {"while", TOKEN_WHILE},
-    {"for", TOKEN_FOR},
-    {"return", TOKEN_RETURN},
-    {"break", TOKEN_BREAK},
-    {"continue", TOKEN_CONTINUE},
-    {"id", TOKEN_ID},
-    {"YES", TOKEN_YES},
-    {"NO", TOKEN_NO},
-    {"nil", TOKEN_NIL},
-    {"self", TOKEN_SELF},
-    {"super", TOKEN_SUPER},
-    {"typedef", TOKEN_TYPEDEF},
-    {"struct", TOKEN_STRUCT},
-    {"union", TOKEN_UNION},
-    {"enum", TOKEN_ENUM},
-    {NULL, TOKEN_UNKNOWN}
+    unsigned char length;
+    unsigned char kind;       // KW_* class of the bare word (0 = not a bare keyword)
+    TokenType type;           // Token for the bare word
+    TokenType at_type;        // Token after '@' (TOKEN_UNKNOWN = not a directive)
+} KeywordEntry;
+
+#define KW(str, kind, type, at_type) {str, sizeof(str) - 1, kind, type, at_type}
+
+// Keywords table
+// C, Objective-C and '@'-directive spellings share one table so a single hash
+// probe classifies any identifier. After editing this table, regenerate
+// keyword_slots below with scripts/gen_keyword_hash.py.
+static const KeywordEntry keywords[] = {
+    // C
+    KW("int",        KW_C, TOKEN_INT,      TOKEN_UNKNOWN),
+    KW("char",       KW_C, TOKEN_CHAR_KW,  TOKEN_UNKNOWN),
+    KW("void",       KW_C, TOKEN_VOID,     TOKEN_UNKNOWN),
+    KW("float",      KW_C, TOKEN_FLOAT,    TOKEN_UNKNOWN),
+    KW("double",     KW_C, TOKEN_DOUBLE,   TOKEN_UNKNOWN),
+    KW("long",       KW_C, TOKEN_LONG,     TOKEN_UNKNOWN),
+    KW("short",      KW_C, TOKEN_SHORT,    TOKEN_UNKNOWN),
+    KW("unsigned",   KW_C, TOKEN_UNSIGNED, TOKEN_UNKNOWN),
+    KW("signed",     KW_C, TOKEN_SIGNED,   TOKEN_UNKNOWN),
+    KW("if",         KW_C, TOKEN_IF,       TOKEN_UNKNOWN),
+    KW("else",       KW_C, TOKEN_ELSE,     TOKEN_UNKNOWN),
+    KW("while",      KW_C, TOKEN_WHILE,    TOKEN_UNKNOWN),
+    KW("for",        KW_C, TOKEN_FOR,      TOKEN_UNKNOWN),
+    KW("return",     KW_C, TOKEN_RETURN,   TOKEN_UNKNOWN),
+    KW("break",      KW_C, TOKEN_BREAK,    TOKEN_UNKNOWN),
+    KW("continue",   KW_C, TOKEN_CONTINUE, TOKEN_UNKNOWN),
+    KW("switch",     KW_C, TOKEN_SWITCH,   TOKEN_UNKNOWN),
+    KW("case",       KW_C, TOKEN_CASE,     TOKEN_UNKNOWN),
+    KW("default",    KW_C, TOKEN_DEFAULT,  TOKEN_UNKNOWN),
+    KW("sizeof",     KW_C, TOKEN_SIZEOF,   TOKEN_UNKNOWN),
+    KW("typedef",    KW_C, TOKEN_TYPEDEF,  TOKEN_UNKNOWN),
+    KW("struct",     KW_C, TOKEN_STRUCT,   TOKEN_UNKNOWN),
+    KW("union",      KW_C, TOKEN_UNION,    TOKEN_UNKNOWN),
+    KW("enum",       KW_C, TOKEN_ENUM,     TOKEN_UNKNOWN),
+    KW("static",     KW_C, TOKEN_STATIC,   TOKEN_UNKNOWN),
+    KW("extern",     KW_C, TOKEN_EXTERN,   TOKEN_UNKNOWN),
+    KW("const",      KW_C, TOKEN_CONST,    TOKEN_UNKNOWN),
+    KW("volatile",   KW_C, TOKEN_VOLATILE, TOKEN_UNKNOWN),
+    KW("restrict",   KW_C, TOKEN_RESTRICT, TOKEN_UNKNOWN),
+
+    // Objective-C words the lexer has always treated as keywords
+    KW("id",         KW_C, TOKEN_ID,       TOKEN_UNKNOWN),
+    KW("YES",        KW_C, TOKEN_YES,      TOKEN_UNKNOWN),
+    KW("NO",         KW_C, TOKEN_NO,       TOKEN_UNKNOWN),
+    KW("nil",        KW_C, TOKEN_NIL,      TOKEN_UNKNOWN),
+    KW("self",       KW_C, TOKEN_SELF,     TOKEN_UNKNOWN),
+    KW("super",      KW_C, TOKEN_SUPER,    TOKEN_UNKNOWN),
+
+    // Objective-C types and ARC qualifiers
+    KW("BOOL",               KW_OBJC, TOKEN_BOOL_KW,           TOKEN_UNKNOWN),
+    KW("SEL",                KW_OBJC, TOKEN_SEL,               TOKEN_UNKNOWN),
+    KW("IMP",                KW_OBJC, TOKEN_IMP,               TOKEN_UNKNOWN),
+    KW("Class",              KW_OBJC, TOKEN_CLASS_KW,          TOKEN_UNKNOWN),
+    KW("instancetype",       KW_OBJC, TOKEN_INSTANCETYPE,      TOKEN_UNKNOWN),
+    KW("NSString",           KW_OBJC, TOKEN_NSSTRING,          TOKEN_UNKNOWN),
+    KW("NSArray",            KW_OBJC, TOKEN_NSARRAY,           TOKEN_UNKNOWN),
+    KW("NSDictionary",       KW_OBJC, TOKEN_NSDICTIONARY,      TOKEN_UNKNOWN),
+    KW("NSObject",           KW_OBJC, TOKEN_NSOBJECT,          TOKEN_UNKNOWN),
+    KW("__strong",           KW_OBJC, TOKEN_STRONG,            TOKEN_UNKNOWN),
+    KW("__weak",             KW_OBJC, TOKEN_WEAK,              TOKEN_UNKNOWN),
+    KW("__unsafe_unretained", KW_OBJC, TOKEN_UNSAFE_UNRETAINED, TOKEN_UNKNOWN),
+    KW("__autoreleasing",    KW_OBJC, TOKEN_AUTORELEASING,     TOKEN_UNKNOWN),
+    KW("__bridge",           KW_OBJC, TOKEN_BRIDGE,            TOKEN_UNKNOWN),
+    KW("__bridge_retained",  KW_OBJC, TOKEN_BRIDGE_RETAINED,   TOKEN_UNKNOWN),
+    KW("__bridge_transfer",  KW_OBJC, TOKEN_BRIDGE_TRANSFER,   TOKEN_UNKNOWN),
+
+    // Property attributes (also valid '@' directives where noted)
+    KW("atomic",     KW_PROPERTY_ATTR, TOKEN_ATOMIC,      TOKEN_UNKNOWN),
+    KW("nonatomic",  KW_PROPERTY_ATTR, TOKEN_NONATOMIC,   TOKEN_UNKNOWN),
+    KW("retain",     KW_PROPERTY_ATTR, TOKEN_RETAIN,      TOKEN_UNKNOWN),
+    KW("assign",     KW_PROPERTY_ATTR, TOKEN_ASSIGN_ATTR, TOKEN_UNKNOWN),
+    KW("copy",       KW_PROPERTY_ATTR, TOKEN_COPY,        TOKEN_UNKNOWN),
+    KW("weak",       KW_PROPERTY_ATTR, TOKEN_WEAK,        TOKEN_UNKNOWN),
+    KW("strong",     KW_PROPERTY_ATTR, TOKEN_STRONG,      TOKEN_UNKNOWN),
+    KW("readonly",   KW_PROPERTY_ATTR, TOKEN_READONLY,    TOKEN_UNKNOWN),
+    KW("readwrite",  KW_PROPERTY_ATTR, TOKEN_READWRITE,   TOKEN_UNKNOWN),
+    KW("getter",     KW_PROPERTY_ATTR, TOKEN_GETTER,      TOKEN_UNKNOWN),
+    KW("setter",     KW_PROPERTY_ATTR, TOKEN_SETTER,      TOKEN_UNKNOWN),
+
+    // '@' directives
+    KW("interface",       0, TOKEN_UNKNOWN, TOKEN_AT_INTERFACE),
+    KW("implementation",  0, TOKEN_UNKNOWN, TOKEN_AT_IMPLEMENTATION),
+    KW("protocol",        0, TOKEN_UNKNOWN, TOKEN_AT_PROTOCOL),
+    KW("property",        0, TOKEN_UNKNOWN, TOKEN_AT_PROPERTY),
+    KW("end",             0, TOKEN_UNKNOWN, TOKEN_AT_END),
+    KW("synthesize",      0, TOKEN_UNKNOWN, TOKEN_AT_SYNTHESIZE),
+    KW("dynamic",         0, TOKEN_UNKNOWN, TOKEN_AT_DYNAMIC),
+    KW("class",           0, TOKEN_UNKNOWN, TOKEN_AT_CLASS),
+    KW("selector",        0, TOKEN_UNKNOWN, TOKEN_AT_SELECTOR),
+    KW("encode",          0, TOKEN_UNKNOWN, TOKEN_AT_ENCODE),
+    KW("synchronized",    0, TOKEN_UNKNOWN, TOKEN_AT_SYNCHRONIZED),
+    KW("try",             0, TOKEN_UNKNOWN, TOKEN_AT_TRY),
+    KW("catch",           0, TOKEN_UNKNOWN, TOKEN_AT_CATCH),
+    KW("finally",         0, TOKEN_UNKNOWN, TOKEN_AT_FINALLY),
+    KW("throw",           0, TOKEN_UNKNOWN, TOKEN_AT_THROW),
+    KW("autoreleasepool", 0, TOKEN_UNKNOWN, TOKEN_AUTORELEASEPOOL),
+    KW("optional",        0, TOKEN_UNKNOWN, TOKEN_OPTIONAL),
+    KW("required",        0, TOKEN_UNKNOWN, TOKEN_REQUIRED),
+    KW("private",         0, TOKEN_UNKNOWN, TOKEN_PRIVATE),
+    KW("protected",       0, TOKEN_UNKNOWN, TOKEN_PROTECTED),
+    KW("public",          0, TOKEN_UNKNOWN, TOKEN_PUBLIC),
+    KW("package",         0, TOKEN_UNKNOWN, TOKEN_PACKAGE),
 };
 
+#define KEYWORD_COUNT (sizeof(keywords) / sizeof(keywords[0]))
+
+// Perfect hash over the spellings in keywords[]: every spelling lands in its
+// own slot, so recognition is one hash plus one memcmp.
+// BEGIN GENERATED KEYWORD HASH (scripts/gen_keyword_hash.py)
+#define KEYWORD_MIN_LENGTH 2
+#define KEYWORD_MAX_LENGTH 19
+#define KEYWORD_HASH_SIZE 512
+#define KEYWORD_HASH(s, n) \
+    (((unsigned char)(s)[0] * 451u + (unsigned char)(s)[1] * 309u + \
+      (unsigned char)(s)[(n) >> 1] * 779u + (unsigned char)(s)[(n) - 1] + \
+      (unsigned)(n) * 927u) & (KEYWORD_HASH_SIZE - 1))
+
+static const unsigned char keyword_slots[KEYWORD_HASH_SIZE] = {
+     0,  0,  0,  0,  0,  0,  0,  0, 34,  0,  2,  0,  0,  0,  0,  0,
+     0,  0, 54, 65,  0,  0,  0, 48,  0,  0,  0,  0,  0, 15, 39, 10,
+     0,  0,  0,  0,  0,  0,  0,  0,  0, 56,  0,  0,  0,  0,  9,  0,
+    78,  0, 74,  0,  0,  0, 28,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     3,  0,  0, 73,  0,  0, 26,  0,  0,  0,  0,  0,  0, 45,  0,  0,
+    18, 42,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  4,  0,  0,  0, 64,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  7,  0,  0,  0,  0,  0,  0,  5,  0, 70,  0,
+     0,  0,  0, 58,  0,  0, 61,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0, 68, 72,  0,  0,  0,  0,  0,  0,
+     0,  0, 37,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    67,  0,  0, 52,  0,  0,  0, 32,  0,  0,  0,  0,  0,  0,  0,  0,
+     0, 13,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 20, 36,  0,
+     0,  0, 22,  0,  0,  0,  0,  0,  0,  0,  0, 40,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0, 49,  0,  0,  0,  0,  0, 14,  0,
+     0, 23,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 75,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0, 38, 43,  0,  0,  0, 19,  0,  0,
+    50, 29,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 11, 51,  0,
+    69,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 71,  0, 35,
+    12,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 31, 82,  0,  0,  0,
+    47,  0,  0,  0, 16,  0,  0,  0,  0,  0, 83,  0,  0,  0,  0,  0,
+     0,  0,  0, 33,  0,  0,  0,  0,  0,  0, 17,  0, 77, 55,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 76,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 21,
+     0,  0,  0,  0, 46,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0, 44,  0,  0,  0,  0,  0,  0,  0,  0,  0, 30, 80,  0,
+    57,  0,  0, 63,  0, 24,  0,  0,  0,  0, 62,  0,  0, 27,  8,  0,
+     0,  0, 66,  0,  0,  0, 25,  0,  0,  0, 81, 53, 84,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0, 60,  0,  0,  0,  6,  0, 41,  0,
+     0,  0,  0,  0,  0,  0, 79,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0, 59,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+};
+// END GENERATED KEYWORD HASH
+
+static const KeywordEntry *keyword_lookup(const char *str, size_t length) {
+    if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH) {
+        return NULL;
+    }
+
+    unsigned int slot = KEYWORD_HASH(str, length);
+    unsigned int index = keyword_slots[slot];
+    if (index == 0) {
+        return NULL;
+    }
+
+    const KeywordEntry *entry = &keywords[index - 1];
+    if (entry->length != length || memcmp(entry->keyword, str, length) != 0) {
+        return NULL;
+    }
+    return entry;
+}
+
 Lexer *lexer_create(const char *input, const char *filename) {
     if (!input) return NULL;
     
@@ -42,7 +200,7 @@ Lexer *lexer_create(const char *input, const char *filename) {
     
     memset(lexer, 0, sizeof(Lexer));
     lexer->input_length = strlen(input);
-    lexer->input = strdup(input);
+    lexer->input = input; // Lexed in place; tokens point into it
     lexer->source = lexer->input;
     lexer->pos = 0;
     lexer->position = 0;
@@ -50,14 +208,18 @@ Lexer *lexer_create(const char *input, const char *filename) {
     lexer->line = 1;
     lexer->column = 1;
     lexer->has_error = false;
-    lexer->objc_mode = false;
+
+    // Objective-C keywords are enabled for .m sources and after the first
+    // '@' directive
+    size_t name_length = filename ? strlen(filename) : 0;
+    lexer->objc_mode = name_length > 2 && strcmp(filename + name_length - 2, ".m") == 0;
+    lexer->in_property_attributes = false;
     
     return lexer;
 }
 
 void lexer_destroy(Lexer *lexer) {
     if (lexer) {
-        free(lexer->input);
         free(lexer->error_message);
         free(lexer);
     }
@@ -82,94 +244,259 @@ static void advance(Lexer *lexer) {
     }
 }
 
+// Move to an absolute input position, keeping line/column in step. Newlines
+// in the skipped span are counted in bulk rather than one advance() at a time.
+static void advance_to(Lexer *lexer, size_t target) {
+    const char *start = lexer->input + lexer->pos;
+    const char *stop = lexer->input + target;
+    const char *last_newline = NULL;
+
+    size_t newlines = lexer_scan_count_newlines(start, stop, &last_newline);
+    if (newlines) {
+        lexer->line += (int)newlines;
+        lexer->column = (int)(stop - last_newline);
+    } else {
+        lexer->column += (int)(stop - start);
+    }
+
+    lexer->pos = target;
+    lexer->position = target;
+    lexer->current = target;
+}
+
+// Recognizes a '# <line> "file"' marker left by the preprocessor at p and
+// returns the line it names, or 0 if p does not start one
+static int line_marker_number(const char *input, const char *p, const char *end) {
+    if (p >= end || *p != '#') {
+        return 0;
+    }
+
+    // Markers always start a line
+    for (const char *q = p; q > input && q[-1] != '\n'; q--) {
+        if (q[-1] != ' ' && q[-1] != '\t') {
+            return 0;
+        }
+    }
+
+    const char *q = p + 1;
+    while (q < end && (*q == ' ' || *q == '\t')) q++;
+
+    int line = 0;
+    while (q < end && isdigit((unsigned char)*q)) {
+        line = line * 10 + (*q++ - '0');
+    }
+    return line;
+}
+
+// Skips whitespace, /* block */ and // line comments, and consumes
+// preprocessor line markers
 static void skip_whitespace(Lexer *lexer) {
-    while (isspace(current_char(lexer))) {
-        advance(lexer);
+    const char *input = lexer->input;
+    const char *end = input + lexer->input_length;
+    const char *p = input + lexer->pos;
+
+    for (;;) {
+        p = lexer_scan_whitespace(p, end);
+
+        int marker_line = line_marker_number(input, p, end);
+        if (marker_line > 0) {
+            const char *newline = lexer_scan_until2(p, end, '\n', '\n');
+            p = newline < end ? newline + 1 : end;
+            advance_to(lexer, (size_t)(p - input));
+            lexer->line = marker_line;
+            lexer->column = 1;
+            continue;
+        }
+
+        if (end - p < 2 || p[0] != '/') {
+            break;
+        }
+
+        if (p[1] == '*') {
+            // Hop from '*' to '*' until one is followed by '/'
+            const char *q = p + 2;
+            for (;;) {
+                q = lexer_scan_until2(q, end, '*', '*');
+                if (end - q < 2) {
+                    q = end; // Unterminated comment runs to the end of input
+                    break;
+                }
+                if (q[1] == '/') {
+                    q += 2;
+                    break;
+                }
+                q++;
+            }
+            p = q;
+        } else if (p[1] == '/') {
+            p = lexer_scan_until2(p + 2, end, '\n', '\n');
+        } else {
+            break;
+        }
     }
+
+    advance_to(lexer, (size_t)(p - input));
 }
 
 bool is_keyword(const char *str, TokenType *type) {
-    for (int i = 0; keywords[i].keyword != NULL; i++) {
-        if (strcmp(str, keywords[i].keyword) == 0) {
-            *type = keywords[i].type;
+    const KeywordEntry *entry = keyword_lookup(str, strlen(str));
+    if (!entry || !(entry->kind & KW_C)) {
+        return false;
+    }
+
+    *type = entry->type;
+    return true;
+}
+
+bool is_objc_keyword(const char *str, TokenType *type) {
+    const KeywordEntry *entry = keyword_lookup(str, strlen(str));
+    if (!entry || !(entry->kind & (KW_OBJC | KW_PROPERTY_ATTR))) {
+        return false;
+    }
+
+    *type = entry->type;
+    return true;
+}
+
+bool is_objc_at_keyword(const char *str, TokenType *type) {
+    const KeywordEntry *entry = keyword_lookup(str, strlen(str));
+    if (!entry || entry->at_type == TOKEN_UNKNOWN) {
+        return false;
+    }
+
+    *type = entry->at_type;
+    return true;
+}
+
+bool is_objc_type(const char *str, TokenType *type) {
+    if (!is_objc_keyword(str, type)) {
+        return false;
+    }
+
+    switch (*type) {
+        case TOKEN_ID:
+        case TOKEN_BOOL_KW:
+        case TOKEN_SEL:
+        case TOKEN_IMP:
+        case TOKEN_CLASS_KW:
+        case TOKEN_INSTANCETYPE:
+        case TOKEN_NSSTRING:
+        case TOKEN_NSARRAY:
+        case TOKEN_NSDICTIONARY:
+        case TOKEN_NSOBJECT:
             return true;
-        }
+        default:
+            return false;
     }
-    return false;
 }
 
-static Token read_identifier(Lexer *lexer) {
+// Classify an identifier-shaped word in the lexer's current context
+static TokenType lexer_classify_word(Lexer *lexer, const char *str, size_t length) {
+    const KeywordEntry *entry = keyword_lookup(str, length);
+    if (!entry) {
+        return TOKEN_IDENTIFIER;
+    }
+
+    unsigned char enabled = KW_C;
+    if (lexer->objc_mode) enabled |= KW_OBJC;
+    if (lexer->in_property_attributes) enabled |= KW_PROPERTY_ATTR;
+
+    return (entry->kind & enabled) ? entry->type : TOKEN_IDENTIFIER;
+}
+
+// Tokens borrow their text from the lexer input: offset/length describe the
+// span, and only identifiers and keywords are resolved to an interned handle.
+// Numbers, strings, punctuation and '@' words leave value NULL; their text
+// is produced on demand by lexer_token_text().
+static Token token_begin(Lexer *lexer, TokenType type) {
     Token token;
     memset(&token, 0, sizeof(Token));
+    token.type = type;
+    token.offset = (unsigned int)lexer->pos;
     token.line = lexer->line;
     token.column = lexer->column;
+    return token;
+}
+
+static void token_end(Lexer *lexer, Token *token) {
+    token->length = (unsigned int)(lexer->pos - token->offset);
+}
+
+static Token read_identifier(Lexer *lexer) {
+    Token token = token_begin(lexer, TOKEN_IDENTIFIER);
     
-    char buffer[256];
-    int i = 0;
-    
-    while ((isalnum(current_char(lexer)) || current_char(lexer) == '_') && i < 255) {
-        buffer[i++] = current_char(lexer);
-        advance(lexer);
-    }
-    buffer[i] = '\0';
-    
-    token.value = strdup(buffer);
+    const char *end = lexer_scan_identifier(lexer->input + lexer->pos,
+                                            lexer->input + lexer->input_length);
+    advance_to(lexer, (size_t)(end - lexer->input));
+    token_end(lexer, &token);
     
-    if (!is_keyword(buffer, &token.type)) {
-        token.type = TOKEN_IDENTIFIER;
-    }
+    const char *start = lexer->input + token.offset;
+    token.value = intern_string_n(start, token.length);
+    token.type = lexer_classify_word(lexer, start, token.length);
     
     return token;
 }
 
 static Token read_number(Lexer *lexer) {
-    Token token;
-    memset(&token, 0, sizeof(Token));
-    token.type = TOKEN_NUMBER;
-    token.line = lexer->line;
-    token.column = lexer->column;
-    
-    char buffer[64];
-    int i = 0;
+    Token token = token_begin(lexer, TOKEN_NUMBER);
     
-    while (isdigit(current_char(lexer)) && i < 63) {
-        buffer[i++] = current_char(lexer);
+    // Saturates instead of overflowing; anything past INT_MAX is diagnosed
+    unsigned long long value = 0;
+    while (isdigit(current_char(lexer))) {
+        unsigned int digit = (unsigned int)(current_char(lexer) - '0');
+        value = value > (ULLONG_MAX - digit) / 10 ? ULLONG_MAX : value * 10 + digit;
         advance(lexer);
     }
-    buffer[i] = '\0';
+    token_end(lexer, &token);
     
-    token.value = strdup(buffer);
-    token.literal.int_value = atoi(buffer);
+    if (value > INT_MAX) {
+        error_report(ERROR_LEXICAL, token.line, token.column,
+                     "integer constant '%.*s' is too large for int",
+                     (int)token.length, lexer->input + token.offset);
+        value = INT_MAX;
+    }
+    token.literal.int_value = (int)value;
     
     return token;
 }
 
+// String literal tokens span the characters between the quotes; the text is
+// not copied until someone asks for it with lexer_token_text().
 static Token read_string(Lexer *lexer) {
-    Token token;
-    memset(&token, 0, sizeof(Token));
-    token.type = TOKEN_STRING;
-    token.line = lexer->line;
-    token.column = lexer->column;
-    
     advance(lexer); // skip opening quote
+
+    Token token = token_begin(lexer, TOKEN_STRING);
     
-    char buffer[1024];
-    int i = 0;
-    
-    while (current_char(lexer) != '"' && current_char(lexer) != '\0' && i < 1023) {
-        buffer[i++] = current_char(lexer);
-        advance(lexer);
+    // Escapes are kept verbatim in the span; only the quote they protect
+    // has to be stepped over
+    const char *end = lexer->input + lexer->input_length;
+    const char *p = lexer->input + lexer->pos;
+    for (;;) {
+        p = lexer_scan_until2(p, end, '"', '\\');
+        if (p == end || *p == '"') break;
+        p += (end - p >= 2) ? 2 : 1;
     }
-    buffer[i] = '\0';
+    advance_to(lexer, (size_t)(p - lexer->input));
+    token_end(lexer, &token);
     
     if (current_char(lexer) == '"') {
         advance(lexer); // skip closing quote
     }
     
-    token.value = strdup(buffer);
     return token;
 }
 
+const char *lexer_token_start(const Lexer *lexer, const Token *token) {
+    return lexer->input + token->offset;
+}
+
+const char *lexer_token_text(Lexer *lexer, const Token *token) {
+    if (token->value) {
+        return token->value;
+    }
+    return intern_string_n(lexer->input + token->offset, token->length);
+}
+
 Token lexer_next_token(Lexer *lexer) {
     Token token;
     memset(&token, 0, sizeof(Token));
@@ -184,55 +511,35 @@ Token lexer_next_token(Lexer *lexer) {
         token.column = lexer->column;
         
         char c = current_char(lexer);
-
-        // Handle multi-line comments
-        if (c == '/' && current_char(lexer) == '*') {
-            advance(lexer); // skip '/'
-            advance(lexer); // skip '*'
-            while (current_char(lexer) != '\0') {
-                if (current_char(lexer) == '*') {
-                    advance(lexer);
-                    if (current_char(lexer) == '/') {
-                        advance(lexer);
-                        break;
-                    }
-                } else {
-                    advance(lexer);
-                }
-            }
-            continue;
+        if (c == '\0') {
+            break;
         }
 
-        
         if (c == '@') {
+            token.offset = (unsigned int)lexer->pos;
             advance(lexer);
             if (isalpha(current_char(lexer))) {
-                Token id_token = read_identifier(lexer);
+                const char *word = lexer->input + lexer->pos;
+                const char *word_end = lexer_scan_identifier(word, lexer->input + lexer->input_length);
+                advance_to(lexer, (size_t)(word_end - lexer->input));
                 // Handle @interface, @implementation, etc.
-                if (strcmp(id_token.value, "interface") == 0) {
-                    token.type = TOKEN_AT_INTERFACE;
-                } else if (strcmp(id_token.value, "implementation") == 0) {
-                    token.type = TOKEN_AT_IMPLEMENTATION;
-                } else if (strcmp(id_token.value, "protocol") == 0) {
-                    token.type = TOKEN_AT_PROTOCOL;
-                } else if (strcmp(id_token.value, "property") == 0) {
-                    token.type = TOKEN_AT_PROPERTY;
-                } else if (strcmp(id_token.value, "end") == 0) {
-                    token.type = TOKEN_AT_END;
+                const KeywordEntry *entry = keyword_lookup(word, (size_t)(word_end - word));
+                if (entry && entry->at_type != TOKEN_UNKNOWN) {
+                    token.type = entry->at_type;
+                    lexer->objc_mode = true;
+                    lexer->in_property_attributes = (token.type == TOKEN_AT_PROPERTY);
                 } else {
                     token.type = TOKEN_AT_IDENTIFIER;
                 }
-                token.value = malloc(strlen(id_token.value) + 2);
-                sprintf(token.value, "@%s", id_token.value);
-                free(id_token.value);
+                token_end(lexer, &token);
                 return token;
-            } else if (c == '"') {
+            } else if (current_char(lexer) == '"') {
                 token = read_string(lexer);
                 token.type = TOKEN_NSSTRING_LITERAL;
                 return token;
             } else {
                 token.type = TOKEN_AT;
-                token.value = strdup("@");
+                token_end(lexer, &token);
                 return token;
             }
         }
@@ -249,10 +556,9 @@ Token lexer_next_token(Lexer *lexer) {
             return read_string(lexer);
         }
         
+        token.offset = (unsigned int)lexer->pos;
         advance(lexer);
-        token.value = malloc(2);
-        token.value[0] = c;
-        token.value[1] = '\0';
+        token_end(lexer, &token);
         
         switch (c) {
             case '+': token.type = TOKEN_PLUS; break;
@@ -260,10 +566,16 @@ Token lexer_next_token(Lexer *lexer) {
             case '*': token.type = TOKEN_MULTIPLY; break;
             case '/': token.type = TOKEN_DIVIDE; break;
             case '=': token.type = TOKEN_ASSIGN; break;
-            case ';': token.type = TOKEN_SEMICOLON; break;
+            case ';':
+                token.type = TOKEN_SEMICOLON;
+                lexer->in_property_attributes = false;
+                break;
             case ',': token.type = TOKEN_COMMA; break;
             case '(': token.type = TOKEN_LPAREN; break;
-            case ')': token.type = TOKEN_RPAREN; break;
+            case ')':
+                token.type = TOKEN_RPAREN;
+                lexer->in_property_attributes = false;
+                break;
             case '{': token.type = TOKEN_LBRACE; break;
             case '}': token.type = TOKEN_RBRACE; break;
             case '[': token.type = TOKEN_LBRACKET; break;
@@ -290,13 +602,49 @@ Token lexer_next_token(Lexer *lexer) {
     }
 
     token.type = TOKEN_EOF;
-    token.value = strdup("EOF");
+    token.offset = (unsigned int)lexer->pos;
+    token.length = 0;
     token.line = lexer->line;
     token.column = lexer->column;
 
     return token;
 }
 
+Token *lexer_tokenize(Lexer *lexer, size_t *count) {
+    if (count) *count = 0;
+    if (!lexer) return NULL;
+
+    // Roughly one token per six bytes of source; grows geometrically if not
+    size_t capacity = lexer->input_length / 6 + 64;
+    Token *tokens = malloc(capacity * sizeof(Token));
+    if (!tokens) {
+        error_fatal("Memory allocation failed for token buffer");
+        return NULL;
+    }
+
+    size_t n = 0;
+    for (;;) {
+        if (n == capacity) {
+            capacity *= 2;
+            Token *grown = realloc(tokens, capacity * sizeof(Token));
+            if (!grown) {
+                free(tokens);
+                error_fatal("Memory allocation failed for token buffer");
+                return NULL;
+            }
+            tokens = grown;
+        }
+
+        tokens[n] = lexer_next_token(lexer);
+        if (tokens[n++].type == TOKEN_EOF) {
+            break;
+        }
+    }
+
+    if (count) *count = n;
+    return tokens;
+}
+
 const char *token_type_to_string(TokenType type) {
     switch (type) {
         case TOKEN_EOF: return "EOF";
@@ -368,6 +716,49 @@ const char *token_type_to_string(TokenType type) {
         case TOKEN_CONST: return "const";
         case TOKEN_VOLATILE: return "volatile";
         case TOKEN_RESTRICT: return "restrict";
+        case TOKEN_STATIC: return "STATIC";
+        case TOKEN_EXTERN: return "EXTERN";
+        case TOKEN_FLOAT: return "FLOAT";
+        case TOKEN_DOUBLE: return "DOUBLE";
+        case TOKEN_BOOL_KW: return "BOOL_KW";
+        case TOKEN_SEL: return "SEL";
+        case TOKEN_IMP: return "IMP";
+        case TOKEN_CLASS_KW: return "CLASS_KW";
+        case TOKEN_INSTANCETYPE: return "INSTANCETYPE";
+        case TOKEN_NSSTRING: return "NSSTRING";
+        case TOKEN_NSARRAY: return "NSARRAY";
+        case TOKEN_NSDICTIONARY: return "NSDICTIONARY";
+        case TOKEN_NSOBJECT: return "NSOBJECT";
+        case TOKEN_STRONG: return "STRONG";
+        case TOKEN_WEAK: return "WEAK";
+        case TOKEN_UNSAFE_UNRETAINED: return "UNSAFE_UNRETAINED";
+        case TOKEN_AUTORELEASING: return "AUTORELEASING";
+        case TOKEN_ATOMIC: return "ATOMIC";
+        case TOKEN_NONATOMIC: return "NONATOMIC";
+        case TOKEN_RETAIN: return "RETAIN";
+        case TOKEN_ASSIGN_ATTR: return "ASSIGN_ATTR";
+        case TOKEN_COPY: return "COPY";
+        case TOKEN_READONLY: return "READONLY";
+        case TOKEN_READWRITE: return "READWRITE";
+        case TOKEN_GETTER: return "GETTER";
+        case TOKEN_SETTER: return "SETTER";
+        case TOKEN_AT_SYNTHESIZE: return "AT_SYNTHESIZE";
+        case TOKEN_AT_DYNAMIC: return "AT_DYNAMIC";
+        case TOKEN_AT_CLASS: return "AT_CLASS";
+        case TOKEN_AT_SELECTOR: return "AT_SELECTOR";
+        case TOKEN_AT_ENCODE: return "AT_ENCODE";
+        case TOKEN_AT_SYNCHRONIZED: return "AT_SYNCHRONIZED";
+        case TOKEN_AT_TRY: return "AT_TRY";
+        case TOKEN_AT_CATCH: return "AT_CATCH";
+        case TOKEN_AT_FINALLY: return "AT_FINALLY";
+        case TOKEN_AT_THROW: return "AT_THROW";
+        case TOKEN_AUTORELEASEPOOL: return "AUTORELEASEPOOL";
+        case TOKEN_OPTIONAL: return "OPTIONAL";
+        case TOKEN_REQUIRED: return "REQUIRED";
+        case TOKEN_PRIVATE: return "PRIVATE";
+        case TOKEN_PROTECTED: return "PROTECTED";
+        case TOKEN_PUBLIC: return "PUBLIC";
+        case TOKEN_PACKAGE: return "PACKAGE";
         default: return "UNKNOWN";
     }
 }
@@ -0,0 +1,413 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "lexer_scan.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LEXER_SCAN_SSE2 1
+#include <emmintrin.h>
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+// AVX2 is compiled per function and only used if the CPU reports it
+#define LEXER_SCAN_AVX2 1
+#include <immintrin.h>
+#define SCAN_AVX2_FN static __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define LEXER_SCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+typedef enum {
+    SCAN_LEVEL_SCALAR = 0,
+    SCAN_LEVEL_128 = 1,          // SSE2 or NEON
+    SCAN_LEVEL_256 = 2           // AVX2
+} ScanLevel;
+
+static int scan_level = -1;      // Detected on first use
+
+// ========================================
+// Bit helpers
+// ========================================
+
+static inline unsigned scan_ctz32(uint32_t x) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(x);
+#endif
+}
+
+static inline unsigned scan_high_bit32(uint32_t x) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanReverse(&index, x);
+    return (unsigned)index;
+#else
+    return 31u - (unsigned)__builtin_clz(x);
+#endif
+}
+
+static inline unsigned scan_popcount32(uint32_t x) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    x = x - ((x >> 1) & 0x55555555u);
+    x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+    return (((x + (x >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+#else
+    return (unsigned)__builtin_popcount(x);
+#endif
+}
+
+// ========================================
+// Scalar paths (also used for the tail of every vector scan)
+// ========================================
+
+static inline int scan_is_space(unsigned char c) {
+    return c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t';
+}
+
+static inline int scan_is_ident(unsigned char c) {
+    return (unsigned char)((c | 0x20) - 'a') < 26 ||
+           (unsigned char)(c - '0') < 10 || c == '_';
+}
+
+static const char *scalar_whitespace(const char *p, const char *end) {
+    while (p < end && scan_is_space((unsigned char)*p)) p++;
+    return p;
+}
+
+static const char *scalar_identifier(const char *p, const char *end) {
+    while (p < end && scan_is_ident((unsigned char)*p)) p++;
+    return p;
+}
+
+static const char *scalar_until2(const char *p, const char *end, char a, char b) {
+    while (p < end && *p != a && *p != b) p++;
+    return p;
+}
+
+static size_t scalar_count_newlines(const char *p, const char *end, const char **last_newline) {
+    size_t count = 0;
+    for (; p < end; p++) {
+        if (*p == '\n') {
+            count++;
+            *last_newline = p;
+        }
+    }
+    return count;
+}
+
+// ========================================
+// SSE2 (16 bytes per step)
+// ========================================
+
+#if LEXER_SCAN_SSE2
+
+// Bytes in [lo, lo + span] compare equal after an unsigned min
+static inline __m128i sse2_in_range(__m128i v, char lo, char span) {
+    __m128i t = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(span)), t);
+}
+
+static inline uint32_t sse2_space_mask(__m128i v) {
+    __m128i control = sse2_in_range(v, '\t', '\r' - '\t');
+    __m128i blank = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    return (uint32_t)_mm_movemask_epi8(_mm_or_si128(control, blank));
+}
+
+static inline uint32_t sse2_ident_mask(__m128i v) {
+    __m128i alpha = sse2_in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 25);
+    __m128i digit = sse2_in_range(v, '0', 9);
+    __m128i underscore = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    return (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), underscore));
+}
+
+static const char *sse2_whitespace(const char *p, const char *end) {
+    while (end - p >= 16) {
+        uint32_t stop = ~sse2_space_mask(_mm_loadu_si128((const __m128i *)p)) & 0xFFFFu;
+        if (stop) return p + scan_ctz32(stop);
+        p += 16;
+    }
+    return scalar_whitespace(p, end);
+}
+
+static const char *sse2_identifier(const char *p, const char *end) {
+    while (end - p >= 16) {
+        uint32_t stop = ~sse2_ident_mask(_mm_loadu_si128((const __m128i *)p)) & 0xFFFFu;
+        if (stop) return p + scan_ctz32(stop);
+        p += 16;
+    }
+    return scalar_identifier(p, end);
+}
+
+static const char *sse2_until2(const char *p, const char *end, char a, char b) {
+    __m128i va = _mm_set1_epi8(a);
+    __m128i vb = _mm_set1_epi8(b);
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        uint32_t hit = (uint32_t)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+        if (hit) return p + scan_ctz32(hit);
+        p += 16;
+    }
+    return scalar_until2(p, end, a, b);
+}
+
+static size_t sse2_count_newlines(const char *p, const char *end, const char **last_newline) {
+    __m128i newline = _mm_set1_epi8('\n');
+    size_t count = 0;
+    while (end - p >= 16) {
+        uint32_t hit = (uint32_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), newline));
+        if (hit) {
+            count += scan_popcount32(hit);
+            *last_newline = p + scan_high_bit32(hit);
+        }
+        p += 16;
+    }
+    return count + scalar_count_newlines(p, end, last_newline);
+}
+
+#endif // LEXER_SCAN_SSE2
+
+// ========================================
+// AVX2 (32 bytes per step)
+// ========================================
+
+#if LEXER_SCAN_AVX2
+
+SCAN_AVX2_FN inline __m256i avx2_in_range(__m256i v, char lo, char span) {
+    __m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(span)), t);
+}
+
+SCAN_AVX2_FN const char *avx2_whitespace(const char *p, const char *end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i control = avx2_in_range(v, '\t', '\r' - '\t');
+        __m256i blank = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+        uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(control, blank));
+        if (stop) return p + scan_ctz32(stop);
+        p += 32;
+    }
+    return sse2_whitespace(p, end);
+}
+
+SCAN_AVX2_FN const char *avx2_identifier(const char *p, const char *end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i alpha = avx2_in_range(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 25);
+        __m256i digit = avx2_in_range(v, '0', 9);
+        __m256i underscore = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+        uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_or_si256(alpha, digit), underscore));
+        if (stop) return p + scan_ctz32(stop);
+        p += 32;
+    }
+    return sse2_identifier(p, end);
+}
+
+SCAN_AVX2_FN const char *avx2_until2(const char *p, const char *end, char a, char b) {
+    __m256i va = _mm256_set1_epi8(a);
+    __m256i vb = _mm256_set1_epi8(b);
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        uint32_t hit = (uint32_t)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)));
+        if (hit) return p + scan_ctz32(hit);
+        p += 32;
+    }
+    return sse2_until2(p, end, a, b);
+}
+
+SCAN_AVX2_FN size_t avx2_count_newlines(const char *p, const char *end, const char **last_newline) {
+    __m256i newline = _mm256_set1_epi8('\n');
+    size_t count = 0;
+    while (end - p >= 32) {
+        uint32_t hit = (uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), newline));
+        if (hit) {
+            count += scan_popcount32(hit);
+            *last_newline = p + scan_high_bit32(hit);
+        }
+        p += 32;
+    }
+    return count + sse2_count_newlines(p, end, last_newline);
+}
+
+#endif // LEXER_SCAN_AVX2
+
+// ========================================
+// NEON (16 bytes per step)
+// ========================================
+
+#if LEXER_SCAN_NEON
+
+// NEON has no movemask; narrowing by 4 packs a compare result into a 64-bit
+// value with one nibble per byte lane
+static inline uint64_t neon_nibble_mask(uint8x16_t match) {
+    uint8x8_t packed = vshrn_n_u16(vreinterpretq_u16_u8(match), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(packed), 0);
+}
+
+static inline uint8x16_t neon_space(uint8x16_t v) {
+    uint8x16_t control = vcleq_u8(vsubq_u8(v, vdupq_n_u8('\t')), vdupq_n_u8('\r' - '\t'));
+    return vorrq_u8(control, vceqq_u8(v, vdupq_n_u8(' ')));
+}
+
+static inline uint8x16_t neon_ident(uint8x16_t v) {
+    uint8x16_t lower = vorrq_u8(v, vdupq_n_u8(0x20));
+    uint8x16_t alpha = vcleq_u8(vsubq_u8(lower, vdupq_n_u8('a')), vdupq_n_u8(25));
+    uint8x16_t digit = vcleq_u8(vsubq_u8(v, vdupq_n_u8('0')), vdupq_n_u8(9));
+    return vorrq_u8(vorrq_u8(alpha, digit), vceqq_u8(v, vdupq_n_u8('_')));
+}
+
+static const char *neon_whitespace(const char *p, const char *end) {
+    while (end - p >= 16) {
+        uint64_t stop = neon_nibble_mask(vmvnq_u8(neon_space(vld1q_u8((const uint8_t *)p))));
+        if (stop) return p + (__builtin_ctzll(stop) >> 2);
+        p += 16;
+    }
+    return scalar_whitespace(p, end);
+}
+
+static const char *neon_identifier(const char *p, const char *end) {
+    while (end - p >= 16) {
+        uint64_t stop = neon_nibble_mask(vmvnq_u8(neon_ident(vld1q_u8((const uint8_t *)p))));
+        if (stop) return p + (__builtin_ctzll(stop) >> 2);
+        p += 16;
+    }
+    return scalar_identifier(p, end);
+}
+
+static const char *neon_until2(const char *p, const char *end, char a, char b) {
+    uint8x16_t va = vdupq_n_u8((uint8_t)a);
+    uint8x16_t vb = vdupq_n_u8((uint8_t)b);
+    while (end - p >= 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t *)p);
+        uint64_t hit = neon_nibble_mask(vorrq_u8(vceqq_u8(v, va), vceqq_u8(v, vb)));
+        if (hit) return p + (__builtin_ctzll(hit) >> 2);
+        p += 16;
+    }
+    return scalar_until2(p, end, a, b);
+}
+
+static size_t neon_count_newlines(const char *p, const char *end, const char **last_newline) {
+    uint8x16_t newline = vdupq_n_u8('\n');
+    size_t count = 0;
+    while (end - p >= 16) {
+        uint64_t hit = neon_nibble_mask(vceqq_u8(vld1q_u8((const uint8_t *)p), newline));
+        if (hit) {
+            count += (size_t)__builtin_popcountll(hit) >> 2;
+            *last_newline = p + ((63 - __builtin_clzll(hit)) >> 2);
+        }
+        p += 16;
+    }
+    return count + scalar_count_newlines(p, end, last_newline);
+}
+
+#endif // LEXER_SCAN_NEON
+
+// ========================================
+// Dispatch
+// ========================================
+
+static int scan_level_detect(void) {
+#if LEXER_SCAN_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SCAN_LEVEL_256;
+    }
+#endif
+#if LEXER_SCAN_SSE2 || LEXER_SCAN_NEON
+    return SCAN_LEVEL_128;
+#else
+    return SCAN_LEVEL_SCALAR;
+#endif
+}
+
+static inline int scan_current_level(void) {
+    if (scan_level < 0) {
+        scan_level = scan_level_detect();
+    }
+    return scan_level;
+}
+
+void lexer_scan_set_vector(bool enabled) {
+    scan_level = enabled ? scan_level_detect() : SCAN_LEVEL_SCALAR;
+}
+
+const char *lexer_scan_backend_name(void) {
+    switch (scan_current_level()) {
+#if LEXER_SCAN_AVX2
+        case SCAN_LEVEL_256: return "avx2";
+#endif
+#if LEXER_SCAN_SSE2
+        case SCAN_LEVEL_128: return "sse2";
+#elif LEXER_SCAN_NEON
+        case SCAN_LEVEL_128: return "neon";
+#endif
+        default:             return "scalar";
+    }
+}
+
+const char *lexer_scan_whitespace(const char *p, const char *end) {
+    switch (scan_current_level()) {
+#if LEXER_SCAN_AVX2
+        case SCAN_LEVEL_256: return avx2_whitespace(p, end);
+#endif
+#if LEXER_SCAN_SSE2
+        case SCAN_LEVEL_128: return sse2_whitespace(p, end);
+#elif LEXER_SCAN_NEON
+        case SCAN_LEVEL_128: return neon_whitespace(p, end);
+#endif
+        default:             return scalar_whitespace(p, end);
+    }
+}
+
+const char *lexer_scan_identifier(const char *p, const char *end) {
+    switch (scan_current_level()) {
+#if LEXER_SCAN_AVX2
+        case SCAN_LEVEL_256: return avx2_identifier(p, end);
+#endif
+#if LEXER_SCAN_SSE2
+        case SCAN_LEVEL_128: return sse2_identifier(p, end);
+#elif LEXER_SCAN_NEON
+        case SCAN_LEVEL_128: return neon_identifier(p, end);
+#endif
+        default:             return scalar_identifier(p, end);
+    }
+}
+
+const char *lexer_scan_until2(const char *p, const char *end, char a, char b) {
+    switch (scan_current_level()) {
+#if LEXER_SCAN_AVX2
+        case SCAN_LEVEL_256: return avx2_until2(p, end, a, b);
+#endif
+#if LEXER_SCAN_SSE2
+        case SCAN_LEVEL_128: return sse2_until2(p, end, a, b);
+#elif LEXER_SCAN_NEON
+        case SCAN_LEVEL_128: return neon_until2(p, end, a, b);
+#endif
+        default:             return scalar_until2(p, end, a, b);
+    }
+}
+
+size_t lexer_scan_count_newlines(const char *p, const char *end, const char **last_newline) {
+    switch (scan_current_level()) {
+#if LEXER_SCAN_AVX2
+        case SCAN_LEVEL_256: return avx2_count_newlines(p, end, last_newline);
+#endif
+#if LEXER_SCAN_SSE2
+        case SCAN_LEVEL_128: return sse2_count_newlines(p, end, last_newline);
+#elif LEXER_SCAN_NEON
+        case SCAN_LEVEL_128: return neon_count_newlines(p, end, last_newline);
+#endif
+        default:             return scalar_count_newlines(p, end, last_newline);
+    }
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "logging.h"
+
+#define LOG_LINE_SIZE 4096
+
+int log_category_levels[LOG_CATEGORY_COUNT];
+
+static const char *const log_category_names[LOG_CATEGORY_COUNT] = {
+    [LOG_DRIVER] = "driver",
+    [LOG_PP] = "pp",
+    [LOG_LEX] = "lex",
+    [LOG_PARSE] = "parse",
+    [LOG_CODEGEN] = "codegen",
+    [LOG_OPT] = "opt",
+};
+
+static const char *const log_level_names[] = {"off", "info", "debug", "trace"};
+
+void log_write(LogCategory category, const char *format, ...) {
+    // Formatted first and written with one call, so lines from parallel
+    // compiles do not mix
+    char line[LOG_LINE_SIZE];
+    int prefix = snprintf(line, sizeof(line), "[%s] ", log_category_names[category]);
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line + prefix, sizeof(line) - (size_t)prefix - 1, format, args);
+    va_end(args);
+
+    strcat(line, "\n");
+    fputs(line, stderr);
+}
+
+void log_set_all(LogLevel level) {
+    for (int i = 0; i < LOG_CATEGORY_COUNT; i++) {
+        log_category_levels[i] = level;
+    }
+}
+
+static int log_parse_level(const char *text, size_t length) {
+    for (int level = 0; level <= LOG_LEVEL_TRACE; level++) {
+        if (strlen(log_level_names[level]) == length &&
+            strncmp(text, log_level_names[level], length) == 0) {
+            return level;
+        }
+    }
+    if (length == 1 && text[0] >= '0' && text[0] <= '3') {
+        return text[0] - '0';
+    }
+    return -1;
+}
+
+bool log_configure(const char *spec) {
+    const char *item = spec;
+    while (*item) {
+        size_t length = strcspn(item, ",");
+        const char *colon = memchr(item, ':', length);
+        size_t name_length = colon ? (size_t)(colon - item) : length;
+
+        int level = LOG_LEVEL_DEBUG;
+        if (colon) {
+            level = log_parse_level(colon + 1, length - name_length - 1);
+            if (level < 0) {
+                fprintf(stderr, "Error: Unknown log level in '%.*s'\n", (int)length, item);
+                return false;
+            }
+        }
+
+        if (name_length == 3 && strncmp(item, "all", 3) == 0) {
+            log_set_all((LogLevel)level);
+        } else {
+            int category = 0;
+            while (category < LOG_CATEGORY_COUNT &&
+                   !(strlen(log_category_names[category]) == name_length &&
+                     strncmp(item, log_category_names[category], name_length) == 0)) {
+                category++;
+            }
+            if (category == LOG_CATEGORY_COUNT) {
+                fprintf(stderr, "Error: Unknown log category '%.*s' "
+                        "(driver, pp, lex, parse, codegen, opt or all)\n", (int)name_length, item);
+                return false;
+            }
+            log_category_levels[category] = level;
+        }
+
+        item += length;
+        if (*item == ',') item++;
+    }
+    return true;
+}
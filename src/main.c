@@ -9,6 +9,9 @@
 #include <errno.h>
 #include <assert.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
 
 extern FILE *stderr;
 extern FILE *stdout;
@@ -27,33 +30,59 @@ extern int strcmp(const char *s1, const char *s2);
 // Project-specific includes
 #include "kcc.h"
 #include "preprocessor.h"
+#include "include_cache.h"
+#include "pch.h"
+#include "compile_server.h"
+#include "compile_cache.h"
+#include "compile_report.h"
+#include "logging.h"
+#include "ir.h"
+#include "multiarch_codegen.h"
 #include "symbol_table.h"
 #include "parser.h"
 #include "builtins.h"
 
 
 
-
-struct Parser *parser = NULL;
-
 void print_usage(const char *program_name) {
     printf("KCC - Kayte C Compiler v%s\n\n", KCC_VERSION);
-    printf("Usage: %s [options] <input_file>\n\n", program_name);
+    printf("Usage: %s [options] <input_file>...\n\n", program_name);
     printf("Options:\n");
     printf("  -o <file>     Specify output file\n");
     printf("  -v, --verbose Enable verbose output\n");
-    printf("  -d, --debug   Enable debug mode\n");
+    printf("  -d, --debug   Enable debug mode (all log categories at debug level)\n");
+    printf("  --log=<cat>[:level],...  Log driver, pp, lex, parse, codegen, opt or all\n");
+    printf("                at info, debug (default) or trace level to stderr\n");
     printf("  -O            Enable optimization\n");
     printf("  -S            Keep assembly output\n");
     printf("  -E            Run preprocessor only\n");
+    printf("  --emit-ir     Print the SSA IR (to -o, or stdout) instead of compiling\n");
+    printf("  --backend=<name> Generate code with the default or the multiarch backend\n");
+    printf("                (SSA IR with linear-scan register allocation; emits assembly)\n");
+    printf("  -I <dir>      Add directory to the header search path\n");
+    printf("  -j <n>        Compile up to n input files in parallel\n");
+    printf("  --emit-pch    Precompile the input header (to -o, or <input>.pch)\n");
+    printf("  --include-pch <file> Start from a precompiled header\n");
+    printf("  --cache       Reuse earlier output for identical preprocessed input\n");
+    printf("  --cache-dir <dir> Cache in dir (default $KCC_CACHE_DIR, ~/.cache/kcc)\n");
+    printf("  --no-cache    Do not use the compile cache\n");
+    printf("  --cache-stats Print compile cache hits, misses and size\n");
+    printf("  -ftime-report[=json] Print per-phase timings\n");
+    printf("  -fmem-report[=json]  Print per-phase memory use\n");
     printf("  --no-preprocess Skip preprocessing step\n");
+    printf("  --server [--socket <path>] [-I <dir>]... [<header>...]\n");
+    printf("                Run a compile server, warmed up with the headers\n");
     printf("  -h, --help    Show this help message\n");
     printf("  --version     Show version information\n");
     printf("\nExamples:\n");
     printf("  %s hello.c\n", program_name);
     printf("  %s -o hello hello.c\n", program_name);
     printf("  %s -v -O hello.c\n", program_name);
+    printf("  %s -j 4 -o app main.c util.c io.c\n", program_name);
     printf("  %s -E macros.c > preprocessed.c\n", program_name);
+    printf("\nWith KCC_SERVER set to a server's socket, compiles are sent to it.\n");
+    printf("With KCC_CACHE_DIR set, the compile cache is on; KCC_CACHE_MAX_SIZE\n");
+    printf("bounds it (e.g. 500M, default 1G).\n");
 }
 
 void print_version(void) {
@@ -66,100 +95,161 @@ void print_version(void) {
 void error_init(void);
 bool error_has_errors(void);
 int error_count(void);
+void error_reset(void);
 //struct Parser *parser = parser_create(debug_lexer);
 
 
 
-int compile_file(const char *input_file, const char *output_file, CompilerOptions *opts) {
+// Puts a precompiled prefix in front of a file's preprocessed text, with a
+// line marker so the file's own lines are numbered from 1
+static char *prepend_pch_text(const char *prefix, const char *text, const char *input_file) {
+    size_t prefix_length = strlen(prefix);
+    size_t text_length = strlen(text);
+    char *combined = malloc(prefix_length + strlen(input_file) + text_length + 32);
+    if (!combined) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return NULL;
+    }
 
-    printf("DEBUG: Starting compilation of '%s'\n", input_file);
+    memcpy(combined, prefix, prefix_length);
+    size_t length = prefix_length;
+    if (length && combined[length - 1] != '\n') {
+        combined[length++] = '\n';
+    }
+    length += (size_t)sprintf(combined + length, "# 1 \"%s\"\n", input_file);
+    memcpy(combined + length, text, text_length + 1);
+    return combined;
+}
 
-    // Set default output file if not provided
-    const char *final_output = output_file ? output_file : "a.out";
+// Links the objects into an executable with the system toolchain
+static int link_objects(char **objects, int count, const char *output_file) {
+    size_t length = strlen(output_file) + 128;
+    for (int i = 0; i < count; i++) {
+        length += strlen(objects[i]) + 3;
+    }
 
-    // Check if file exists and is readable
-    FILE *test_file = fopen(input_file, "r");
-    if (!test_file) {
-        fprintf(stderr, "Error: Cannot open input file '%s'\n", input_file);
+    char *ld_cmd = malloc(length);
+    if (!ld_cmd) {
+        fprintf(stderr, "Error: Memory allocation failed for linker command\n");
         return 1;
     }
-    fclose(test_file);
-    printf("DEBUG: File '%s' is readable\n", input_file);
 
-    // Read and preprocess
-    printf("DEBUG: Creating preprocessor...\n");
-    Preprocessor *preprocessor = preprocessor_create();
-    if (!preprocessor) {
-        fprintf(stderr, "Error: Failed to create preprocessor\n");
+    // Use clang as linker with proper entry point for macOS
+    size_t used = (size_t)sprintf(ld_cmd, "clang");
+    for (int i = 0; i < count; i++) {
+        used += (size_t)sprintf(ld_cmd + used, " '%s'", objects[i]);
+    }
+    sprintf(ld_cmd + used, " -o '%s' " KCC_LINK_FLAGS, output_file);
+
+    LOG_INFO(LOG_DRIVER, "Running linker: %s", ld_cmd);
+    int ld_result = system(ld_cmd);
+    free(ld_cmd);
+
+    if (ld_result != 0) {
+        fprintf(stderr, "Error: Linking failed (linker returned %d)\n", ld_result);
         return 1;
     }
-    printf("DEBUG: Preprocessor created successfully\n");
+    return 0;
+}
 
-    printf("DEBUG: Processing file...\n");
-    char *preprocessed_source = preprocessor_process_file(preprocessor, input_file);
-    if (!preprocessed_source) {
-        fprintf(stderr, "Error: Preprocessing failed\n");
-        preprocessor_destroy(preprocessor);
+// -ftime-report / -fmem-report go to stderr, like the diagnostics
+static void print_report(const CompileReport *report, const CompilerOptions *opts) {
+    if (report) {
+        compile_report_print(report, opts->time_report, opts->mem_report,
+                             opts->report_json ? REPORT_FORMAT_JSON : REPORT_FORMAT_TABLE, stderr);
+    }
+}
+
+// Lowers a parsed unit and writes the IR text to output, or stdout
+static int emit_ir(ASTNode *ast, const char *input_file, const char *output,
+                   CompileReport *report) {
+    compile_report_begin(report);
+    IRModule *module = ir_lower_program(ast);
+    compile_report_end(report, REPORT_PHASE_CODEGEN, 0);
+    if (!module || error_has_errors()) {
+        fprintf(stderr, "Error: IR lowering failed for '%s'\n", input_file);
+        if (module) ir_module_destroy(module);
+        return 1;
+    }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Error: Cannot open output file '%s'\n", output);
+        ir_module_destroy(module);
         return 1;
     }
+    ir_print_module(module, out);
+    bool written = fflush(out) == 0;
+    if (out != stdout) {
+        written = fclose(out) == 0 && written;
+    }
+    ir_module_destroy(module);
 
-    printf("DEBUG: Preprocessed source (first 500 chars):\n");
-    printf("%.500s\n", preprocessed_source);
-    printf("DEBUG: End of preprocessed source\n");
+    if (!written) {
+        fprintf(stderr, "Error: Failed to write IR output\n");
+        return 1;
+    }
+    return 0;
+}
 
-    printf("DEBUG: Preprocessed source length: %zu\n", strlen(preprocessed_source));
+// --backend=multiarch: assembly for the host from the IR backend
+static int generate_multiarch(ASTNode *ast, const char *output, CompileReport *report) {
+    compile_report_begin(report);
+    MultiArchCodegen *codegen = multiarch_codegen_create(output, detect_host_architecture(),
+                                                         detect_host_platform());
+    bool generated = codegen && multiarch_codegen_generate(codegen, ast);
+    compile_report_end(report, REPORT_PHASE_CODEGEN, 0);
+    if (!codegen) {
+        fprintf(stderr, "Error: Failed to create code generator for '%s'\n", output);
+        return 1;
+    }
+    multiarch_codegen_destroy(codegen);
+    if (!generated) {
+        fprintf(stderr, "Error: Code generation failed\n");
+        return 1;
+    }
+    return 0;
+}
 
-    // Create lexer
-    printf("DEBUG: Creating lexer...\n");
-    Lexer *lexer = lexer_create(preprocessed_source, input_file);
+// Lexes, parses and generates code for a preprocessed translation unit:
+// an object with the integrated assembler, assembly otherwise, or with
+// --emit-ir the IR text (codegen_output NULL for stdout)
+static int generate_code(const char *source, const char *input_file, const char *codegen_output,
+                         bool integrated_assembler, CompilerOptions *opts, CompileReport *report) {
+    // The parser lexes the whole input up front
+    compile_report_begin(report);
+    Lexer *lexer = lexer_create(source, input_file);
     if (!lexer) {
         fprintf(stderr, "Error: Failed to create lexer\n");
-        free(preprocessed_source);
-        preprocessor_destroy(preprocessor);
         return 1;
     }
-    printf("DEBUG: Lexer created successfully\n");
-
-    // Add this after creating the lexer in compile_file() function
-    printf("DEBUG: Lexer created successfully\n");
-
-    // Optional: Debug the first few tokens to see what the lexer is producing
-    if (opts && opts->debug) {
-        printf("DEBUG: First few tokens from lexer:\n");
-        Lexer *debug_lexer = lexer_create(preprocessed_source, input_file);
-        if (debug_lexer) {
-            for (int i = 0; i < 10; i++) {
-                Token tok = lexer_next_token(debug_lexer);
-                printf("Token %d: type=%d, value='%s', line=%d, col=%d\n",
-                       i, tok.type, tok.value ? tok.value : "(null)", tok.line, tok.column);
-                if (tok.type == TOKEN_EOF) break;
-            }
-            lexer_destroy(debug_lexer);
-            printf("DEBUG: Token debugging complete\n");
-        }
-    }
-
-    // Create parser
-    printf("DEBUG: Creating parser...\n");
     Parser *parser = parser_create(lexer);
     if (!parser) {
         fprintf(stderr, "Error: Failed to create parser\n");
         lexer_destroy(lexer);
-        free(preprocessed_source);
-        preprocessor_destroy(preprocessor);
         return 1;
     }
-    printf("DEBUG: Parser created successfully\n");
+    compile_report_end(report, REPORT_PHASE_LEX, parser->token_count);
+    LOG_DEBUG(LOG_LEX, "%s: %zu tokens", input_file, parser->token_count);
+
+    // The first tokens, straight from the parser's token array
+    if (LOG_ENABLED(LOG_LEX, LOG_LEVEL_TRACE)) {
+        for (size_t i = 0; i < parser->token_count && i < 10; i++) {
+            const Token *tok = &parser->tokens[i];
+            log_write(LOG_LEX, "token %zu: type=%d, text='%s', line=%d, col=%d",
+                      i, tok->type, lexer_token_text(lexer, tok), tok->line, tok->column);
+        }
+    }
 
-    // Parse AST
-    printf("DEBUG: Parsing AST...\n");
+    compile_report_begin(report);
     ASTNode *ast = parser_parse_program(parser);
-    if (!ast) {
+    compile_report_end(report, REPORT_PHASE_PARSE, ast_node_count());
+    LOG_DEBUG(LOG_PARSE, "%s: %zu AST nodes", input_file, ast_node_count());
+    if (!ast || error_has_errors()) {
         fprintf(stderr, "Error: Parsing failed\n");
+        if (ast) ast_destroy(ast);
         parser_destroy(parser);
         lexer_destroy(lexer);
-        free(preprocessed_source);
-        preprocessor_destroy(preprocessor);
         return 1;
     }
 
@@ -169,174 +259,464 @@ int compile_file(const char *input_file, const char *output_file, CompilerOption
         ast_print(ast, 0);
     }
 
-    // Create temporary assembly file name
-    char *asm_file = malloc(strlen(final_output) + 16);
-    if (!asm_file) {
-        fprintf(stderr, "Error: Memory allocation failed\n");
+    if (opts && opts->emit_ir) {
+        int result = emit_ir(ast, input_file, codegen_output, report);
         ast_destroy(ast);
         parser_destroy(parser);
         lexer_destroy(lexer);
-        free(preprocessed_source);
-        preprocessor_destroy(preprocessor);
-        return 1;
+        return result;
     }
-    snprintf(asm_file, strlen(final_output) + 16, "%s.s", final_output);
 
-    // Generate assembly code
-    printf("DEBUG: Generating assembly code to '%s'...\n", asm_file);
-    CodeGenerator *codegen = codegen_create(asm_file);
-    if (!codegen) {
-        fprintf(stderr, "Error: Failed to create code generator for '%s'\n", asm_file);
-        free(asm_file);
+    if (opts && opts->use_multiarch) {
+        LOG_DEBUG(LOG_CODEGEN, "Generating code to '%s' with the multiarch backend", codegen_output);
+        int result = generate_multiarch(ast, codegen_output, report);
         ast_destroy(ast);
         parser_destroy(parser);
         lexer_destroy(lexer);
-        free(preprocessed_source);
-        preprocessor_destroy(preprocessor);
-        return 1;
+        return result;
     }
 
-    if (!codegen_generate(codegen, ast)) {
+    LOG_DEBUG(LOG_CODEGEN, "Generating code to '%s'", codegen_output);
+    compile_report_begin(report);
+#ifdef CODEGEN_HAS_OBJECT_OUTPUT
+    CodeGenerator *codegen = integrated_assembler ? codegen_create_object(codegen_output)
+                                                  : codegen_create(codegen_output);
+#else
+    (void)integrated_assembler;
+    CodeGenerator *codegen = codegen_create(codegen_output);
+#endif
+    bool generated = codegen && codegen_generate(codegen, ast);
+    compile_report_end(report, REPORT_PHASE_CODEGEN, 0);
+    if (!codegen) {
+        fprintf(stderr, "Error: Failed to create code generator for '%s'\n", codegen_output);
+    } else if (!generated) {
         fprintf(stderr, "Error: Code generation failed\n");
-        codegen_destroy(codegen);
-        free(asm_file);
-        ast_destroy(ast);
-        parser_destroy(parser);
-        lexer_destroy(lexer);
-        free(preprocessed_source);
-        preprocessor_destroy(preprocessor);
+    }
+
+    if (codegen) codegen_destroy(codegen);
+    ast_destroy(ast);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    return generated ? 0 : 1;
+}
+
+// Compiles one translation unit. The .s/.o names are output_file plus a
+// suffix; with link the object is linked into output_file and removed,
+// otherwise it is left for the caller to link.
+static int compile_unit(const char *input_file, const char *output_file, bool link,
+                        CompilerOptions *opts) {
+    LOG_DEBUG(LOG_DRIVER, "Compiling '%s'", input_file);
+    error_reset();
+
+    // Set default output file if not provided
+    const char *final_output = output_file ? output_file : "a.out";
+
+    // Check if file exists and is readable
+    FILE *test_file = fopen(input_file, "r");
+    if (!test_file) {
+        fprintf(stderr, "Error: Cannot open input file '%s'\n", input_file);
         return 1;
     }
+    fclose(test_file);
 
-    printf("DEBUG: Assembly code generation completed\n");
-    codegen_destroy(codegen);
+    // Read and preprocess
+    CompileReport report_storage;
+    CompileReport *report = NULL;
+    if (opts && (opts->time_report || opts->mem_report)) {
+        report = &report_storage;
+        compile_report_init(report, input_file);
+    }
 
-    // Stop here if user only wants assembly
-    if (opts && opts->keep_asm) {
-        printf("Assembly file generated: %s\n", asm_file);
-        free(asm_file);
-        ast_destroy(ast);
-        parser_destroy(parser);
-        lexer_destroy(lexer);
-        free(preprocessed_source);
-        preprocessor_destroy(preprocessor);
-        return 0;
+    compile_report_begin(report);
+    Preprocessor *preprocessor = preprocessor_create();
+    if (!preprocessor) {
+        fprintf(stderr, "Error: Failed to create preprocessor\n");
+        return 1;
     }
 
-    // Now assemble and link to create executable
-    printf("DEBUG: Assembling and linking to create '%s'...\n", final_output);
+    for (int i = 0; opts && i < opts->include_path_count; i++) {
+        preprocessor_add_include_path(preprocessor, opts->include_paths[i]);
+    }
 
-    // Create object file name
-    char *obj_file = malloc(strlen(final_output) + 16);
-    if (!obj_file) {
-        fprintf(stderr, "Error: Memory allocation failed for object file name\n");
-        remove(asm_file);
-        free(asm_file);
-        ast_destroy(ast);
-        parser_destroy(parser);
-        lexer_destroy(lexer);
-        free(preprocessed_source);
+    // The PCH restores the macros and header state its prefix left behind
+    char *pch_text = NULL;
+    if (opts && opts->include_pch) {
+        pch_text = pch_load(preprocessor, opts->include_pch);
+        if (!pch_text) {
+            preprocessor_destroy(preprocessor);
+            return 1;
+        }
+    }
+
+    char *preprocessed_source = preprocessor_process_file(preprocessor, input_file);
+    if (!preprocessed_source) {
+        fprintf(stderr, "Error: Preprocessing failed\n");
+        free(pch_text);
         preprocessor_destroy(preprocessor);
         return 1;
     }
-    snprintf(obj_file, strlen(final_output) + 16, "%s.o", final_output);
 
-    // Step 1: Assemble (.s -> .o) - Use clang for macOS compatibility
-    char *as_cmd = malloc(strlen(asm_file) + strlen(obj_file) + 64);
-    if (!as_cmd) {
-        fprintf(stderr, "Error: Memory allocation failed for assembler command\n");
-        remove(asm_file);
-        free(obj_file);
-        free(asm_file);
-        ast_destroy(ast);
-        parser_destroy(parser);
-        lexer_destroy(lexer);
+    if (pch_text) {
+        char *combined = prepend_pch_text(pch_text, preprocessed_source, input_file);
+        free(pch_text);
+        free(preprocessed_source);
+        if (!combined) {
+            preprocessor_destroy(preprocessor);
+            return 1;
+        }
+        preprocessed_source = combined;
+    }
+
+    if (report) {
+        for (const char *c = preprocessed_source; *c; c++) {
+            report->lines += *c == '\n';
+        }
+    }
+    compile_report_end(report, REPORT_PHASE_PREPROCESS, report ? report->lines : 0);
+
+    // --emit-pch: save the preprocessor state for later compiles and stop
+    if (opts && opts->emit_pch) {
+        char *pch_file = output_file ? strdup(output_file) : NULL;
+        if (!pch_file) {
+            pch_file = malloc(strlen(input_file) + 5);
+            if (pch_file) sprintf(pch_file, "%s.pch", input_file);
+        }
+        bool written = pch_file && pch_write(preprocessor, input_file, preprocessed_source, pch_file);
+        free(pch_file);
         free(preprocessed_source);
         preprocessor_destroy(preprocessor);
-        return 1;
+        return written ? 0 : 1;
     }
 
-    // Use clang as assembler for better macOS compatibility
-    snprintf(as_cmd, strlen(asm_file) + strlen(obj_file) + 64,
-             "clang -c '%s' -o '%s'", asm_file, obj_file);
+    // -E: write the preprocessed source to -o, or stdout, and stop
+    if (opts && opts->preprocess_only) {
+        FILE *out = output_file ? fopen(output_file, "w") : stdout;
+        if (!out) {
+            fprintf(stderr, "Error: Cannot open output file '%s'\n", output_file);
+            free(preprocessed_source);
+            preprocessor_destroy(preprocessor);
+            return 1;
+        }
+        fputs(preprocessed_source, out);
+        if (out != stdout) {
+            fclose(out);
+        }
+        free(preprocessed_source);
+        preprocessor_destroy(preprocessor);
+        return 0;
+    }
 
-    printf("DEBUG: Running assembler: %s\n", as_cmd);
-    int as_result = system(as_cmd);
-    free(as_cmd);
+    LOG_DEBUG(LOG_PP, "%s: %zu bytes preprocessed", input_file, strlen(preprocessed_source));
+    LOG_TRACE(LOG_PP, "Preprocessed source (first 500 chars):\n%.500s", preprocessed_source);
 
-    if (as_result != 0) {
-        fprintf(stderr, "Error: Assembly failed (assembler returned %d)\n", as_result);
-        remove(asm_file);
-        free(obj_file);
-        free(asm_file);
-        ast_destroy(ast);
-        parser_destroy(parser);
-        lexer_destroy(lexer);
+    // --emit-ir: write the IR to -o, or stdout, and stop
+    if (opts && opts->emit_ir) {
+        int result = generate_code(preprocessed_source, input_file, output_file, false, opts, report);
         free(preprocessed_source);
         preprocessor_destroy(preprocessor);
-        return 1;
+        if (result == 0) {
+            print_report(report, opts);
+        }
+        return result;
     }
 
-    // Step 2: Link (.o -> executable) - Use clang as linker for macOS
-    char *ld_cmd = malloc(strlen(obj_file) + strlen(final_output) + 128);
-    if (!ld_cmd) {
-        fprintf(stderr, "Error: Memory allocation failed for linker command\n");
-        remove(obj_file);
-        remove(asm_file);
-        free(obj_file);
+    // Create temporary assembly and object file names
+    char *asm_file = malloc(strlen(final_output) + 16);
+    char *obj_file = malloc(strlen(final_output) + 16);
+    if (!asm_file || !obj_file) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
         free(asm_file);
-        ast_destroy(ast);
-        parser_destroy(parser);
-        lexer_destroy(lexer);
+        free(obj_file);
         free(preprocessed_source);
         preprocessor_destroy(preprocessor);
         return 1;
     }
+    snprintf(asm_file, strlen(final_output) + 16, "%s.s", final_output);
+    snprintf(obj_file, strlen(final_output) + 16, "%s.o", final_output);
 
-    // Use clang as linker with proper entry point for macOS
-    snprintf(ld_cmd, strlen(obj_file) + strlen(final_output) + 128,
-             "clang '%s' -o '%s' -Wl,-e,_main -nostartfiles", obj_file, final_output);
+    // Without -S the integrated assembler writes the object directly; the
+    // multiarch backend only emits assembly
+#ifdef CODEGEN_HAS_OBJECT_OUTPUT
+    bool integrated_assembler = !(opts && (opts->keep_asm || opts->use_multiarch));
+#else
+    bool integrated_assembler = false;
+#endif
+    const char *codegen_output = integrated_assembler ? obj_file : asm_file;
+
+    // The same preprocessed source with the same options was compiled
+    // before: reuse its output instead of lexing, parsing and generating
+    const char *cache_dir = opts ? opts->cache_dir : NULL;
+    char cache_key[COMPILE_CACHE_KEY_SIZE];
+    bool cached = false;
+    if (cache_dir) {
+        compile_report_begin(report);
+        compile_cache_key(preprocessed_source, strlen(preprocessed_source), opts,
+                          integrated_assembler, cache_key);
+        cached = compile_cache_fetch(cache_dir, cache_key, codegen_output);
+        compile_report_end(report, REPORT_PHASE_CACHE, 0);
+        LOG_INFO(LOG_DRIVER, "Compile cache %s for '%s'", cached ? "hit" : "miss", input_file);
+    }
 
-    printf("DEBUG: Running linker: %s\n", ld_cmd);
-    int ld_result = system(ld_cmd);
-    free(ld_cmd);
+    if (!cached) {
+        if (generate_code(preprocessed_source, input_file, codegen_output,
+                          integrated_assembler, opts, report) != 0) {
+            remove(codegen_output);
+            free(obj_file);
+            free(asm_file);
+            free(preprocessed_source);
+            preprocessor_destroy(preprocessor);
+            return 1;
+        }
+        if (cache_dir) {
+            compile_report_begin(report);
+            compile_cache_store(cache_dir, cache_key, codegen_output, compile_cache_max_size());
+            compile_report_end(report, REPORT_PHASE_CACHE, 0);
+        }
+    }
 
-    if (ld_result != 0) {
-        fprintf(stderr, "Error: Linking failed (linker returned %d)\n", ld_result);
-        remove(obj_file);
-        remove(asm_file);
+    free(preprocessed_source);
+    preprocessor_destroy(preprocessor);
+
+    // Stop here if user only wants assembly
+    if (opts && opts->keep_asm) {
+        LOG_INFO(LOG_DRIVER, "Assembly file generated: %s", asm_file);
+        print_report(report, opts);
         free(obj_file);
         free(asm_file);
-        ast_destroy(ast);
-        parser_destroy(parser);
-        lexer_destroy(lexer);
-        free(preprocessed_source);
-        preprocessor_destroy(preprocessor);
-        return 1;
+        return 0;
+    }
+
+    // Step 1: Assemble (.s -> .o) when there is no integrated assembler
+    if (!integrated_assembler) {
+
+        char *as_cmd = malloc(strlen(asm_file) + strlen(obj_file) + 64);
+        if (!as_cmd) {
+            fprintf(stderr, "Error: Memory allocation failed for assembler command\n");
+            remove(asm_file);
+            free(obj_file);
+            free(asm_file);
+            return 1;
+        }
+
+        // Use clang as assembler for better macOS compatibility
+        snprintf(as_cmd, strlen(asm_file) + strlen(obj_file) + 64,
+                 "clang -c '%s' -o '%s'", asm_file, obj_file);
+
+        LOG_INFO(LOG_DRIVER, "Running assembler: %s", as_cmd);
+        compile_report_begin(report);
+        int as_result = system(as_cmd);
+        compile_report_end(report, REPORT_PHASE_ASSEMBLE, 0);
+        free(as_cmd);
+
+        if (as_result != 0) {
+            fprintf(stderr, "Error: Assembly failed (assembler returned %d)\n", as_result);
+            remove(asm_file);
+            free(obj_file);
+            free(asm_file);
+            return 1;
+        }
     }
 
-    // Clean up temporary files (unless user wants to keep them)
-    if (!opts || !opts->keep_asm) {
+    // Object only: the caller links it together with the other units
+    if (!link) {
         remove(asm_file);
-        remove(obj_file);
+        print_report(report, opts);
+        free(obj_file);
+        free(asm_file);
+        return 0;
     }
 
-    printf("Compilation successful: %s -> %s\n", input_file, final_output);
+    // Step 2: Link (.o -> executable)
+    compile_report_begin(report);
+    int result = link_objects(&obj_file, 1, final_output);
+    compile_report_end(report, REPORT_PHASE_LINK, 1);
+
+    // Clean up temporary files
+    remove(asm_file);
+    remove(obj_file);
+    if (result == 0) {
+        LOG_INFO(LOG_DRIVER, "Compilation successful: %s -> %s", input_file, final_output);
+        print_report(report, opts);
+    }
 
-    // Cleanup
     free(obj_file);
     free(asm_file);
-    ast_destroy(ast);
-    parser_destroy(parser);
-    lexer_destroy(lexer);
-    free(preprocessed_source);
-    preprocessor_destroy(preprocessor);
+    return result;
+}
 
-    return 0;
+int compile_file(const char *input_file, const char *output_file, CompilerOptions *opts) {
+    return compile_unit(input_file, output_file, true, opts);
 }
 
+// ========================================
+// Parallel compilation (several inputs, -j)
+// ========================================
+
+typedef struct CompileJob {
+    const char *input_file;
+    char *output_base;           // The unit's .s/.o are named after this
+    off_t size;                  // Used to start the biggest units first
+    int result;
+} CompileJob;
+
+typedef struct CompileQueue {
+    CompileJob **order;          // Jobs by decreasing size
+    int count;
+    atomic_int next;             // Next entry of order to hand out
+    CompilerOptions *opts;
+} CompileQueue;
+
+// Each worker takes the next job until none are left. A unit stays on one
+// thread from preprocessing to its object file, and what the phases keep
+// per compile (error count, AST arena) is per thread.
+static void *compile_worker(void *arg) {
+    CompileQueue *queue = arg;
+    int index;
+    while ((index = atomic_fetch_add(&queue->next, 1)) < queue->count) {
+        CompileJob *job = queue->order[index];
+        job->result = compile_unit(job->input_file, job->output_base, false, queue->opts);
+    }
+    return NULL;
+}
 
-int main(int argc, char *argv[]) {
+static int compare_job_size(const void *a, const void *b) {
+    const CompileJob *left = *(CompileJob *const *)a;
+    const CompileJob *right = *(CompileJob *const *)b;
+    return (left->size < right->size) - (left->size > right->size);
+}
+
+// Names a unit's outputs: with -S the assembly goes next to the input
+// (foo.c -> foo.s); otherwise objects are temporaries named after the
+// executable, numbered in input order
+static char *job_output_base(const char *input_file, const char *final_output,
+                             int index, bool keep_asm) {
+    if (keep_asm) {
+        char *base = strdup(input_file);
+        if (!base) return NULL;
+        char *dot = strrchr(base, '.');
+        if (dot && dot != base && !strchr(dot, '/')) {
+            *dot = '\0';
+        }
+        return base;
+    }
+
+    char *base = malloc(strlen(final_output) + 16);
+    if (base) {
+        sprintf(base, "%s.%d", final_output, index);
+    }
+    return base;
+}
+
+static int compile_files(const char **input_files, int count, int jobs, CompilerOptions *opts) {
+    if (opts->preprocess_only || opts->emit_pch || opts->emit_ir) {
+        fprintf(stderr, "Error: -E, --emit-ir and --emit-pch take a single input file\n");
+        return 1;
+    }
+    if (opts->keep_asm && opts->output_file) {
+        fprintf(stderr, "Error: -o cannot be used with -S and multiple input files\n");
+        return 1;
+    }
+
+    const char *final_output = opts->output_file ? opts->output_file : "a.out";
+    CompileJob *job_list = calloc((size_t)count, sizeof(CompileJob));
+    CompileJob **order = calloc((size_t)count, sizeof(CompileJob*));
+    char **objects = calloc((size_t)count, sizeof(char*));
+    if (!job_list || !order || !objects) {
+        fprintf(stderr, "Error: Out of memory\n");
+        free(job_list);
+        free(order);
+        free(objects);
+        return 1;
+    }
+
+    int result = 0;
+    for (int i = 0; i < count; i++) {
+        CompileJob *job = &job_list[i];
+        struct stat st;
+        job->input_file = input_files[i];
+        job->output_base = job_output_base(input_files[i], final_output, i, opts->keep_asm);
+        job->size = stat(input_files[i], &st) == 0 ? st.st_size : 0;
+        job->result = 1;
+        order[i] = job;
+        if (!job->output_base) {
+            fprintf(stderr, "Error: Out of memory\n");
+            result = 1;
+        }
+    }
+
+    if (result == 0) {
+        qsort(order, (size_t)count, sizeof(CompileJob*), compare_job_size);
+
+        CompileQueue queue = {order, count, 0, opts};
+        if (jobs > count) {
+            jobs = count;
+        }
+
+        // The calling thread is one of the workers
+        pthread_t *threads = malloc((size_t)jobs * sizeof(pthread_t));
+        int started = 0;
+        while (threads && started < jobs - 1 &&
+               pthread_create(&threads[started], NULL, compile_worker, &queue) == 0) {
+            started++;
+        }
+        compile_worker(&queue);
+        for (int i = 0; i < started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        free(threads);
+
+        for (int i = 0; i < count; i++) {
+            if (job_list[i].result != 0) {
+                fprintf(stderr, "Error: Compilation of '%s' failed\n", job_list[i].input_file);
+                result = 1;
+            }
+        }
+    }
+
+    // One link for the whole program, with the objects in input order
+    if (!opts->keep_asm) {
+        for (int i = 0; i < count; i++) {
+            char *base = job_list[i].output_base;
+            objects[i] = base ? malloc(strlen(base) + 3) : NULL;
+            if (objects[i]) {
+                sprintf(objects[i], "%s.o", base);
+            } else {
+                result = 1;
+            }
+        }
+
+        if (result == 0) {
+            CompileReport report;
+            compile_report_init(&report, final_output);
+            compile_report_begin(&report);
+            result = link_objects(objects, count, final_output);
+            compile_report_end(&report, REPORT_PHASE_LINK, (size_t)count);
+            if (result == 0) {
+                print_report(opts->time_report || opts->mem_report ? &report : NULL, opts);
+            }
+        }
+        if (result == 0) {
+            LOG_INFO(LOG_DRIVER, "Compilation successful: %d files -> %s", count, final_output);
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (objects[i]) {
+                remove(objects[i]);
+                free(objects[i]);
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(job_list[i].output_base);
+    }
+    free(objects);
+    free(order);
+    free(job_list);
+    return result;
+}
+
+static int kcc_main(int argc, char *argv[]) {
     if (argc < 2) {
         print_usage(argv[0]);
         return 1;
@@ -344,7 +724,7 @@ int main(int argc, char *argv[]) {
 
     CompilerOptions opts = {0};
     opts.input_file = NULL;
-    opts.output_file = "a.out";
+    opts.output_file = NULL;     // compile_file() picks the default
     opts.verbose = false;
     opts.debug = false;
     opts.optimize = false;
@@ -352,6 +732,20 @@ int main(int argc, char *argv[]) {
     opts.no_preprocess = false;
     opts.preprocess_only = false;
 
+    // KCC_CACHE_DIR turns the cache on, like --cache
+    const char *cache_env = getenv("KCC_CACHE_DIR");
+    opts.cache_dir = cache_env && *cache_env ? cache_env : NULL;
+
+    // Every -I and input takes at least one argument, so argc bounds the counts
+    opts.include_paths = malloc((size_t)argc * sizeof(char*));
+    const char **input_files = malloc((size_t)argc * sizeof(char*));
+    int input_count = 0;
+    int jobs = 1;
+    if (!opts.include_paths || !input_files) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 1;
+    }
+
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
@@ -362,14 +756,83 @@ int main(int argc, char *argv[]) {
             return 0;
         } else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
             opts.verbose = true;
+            if (log_category_levels[LOG_DRIVER] < LOG_LEVEL_INFO) {
+                log_category_levels[LOG_DRIVER] = LOG_LEVEL_INFO;
+            }
         } else if (strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--debug") == 0) {
             opts.debug = true;
+            log_set_all(LOG_LEVEL_DEBUG);
+        } else if (strncmp(argv[i], "--log=", 6) == 0) {
+            if (!log_configure(argv[i] + 6)) {
+                return 1;
+            }
         } else if (strcmp(argv[i], "-O") == 0) {
             opts.optimize = true;
         } else if (strcmp(argv[i], "-S") == 0) {
             opts.keep_asm = true;
         } else if (strcmp(argv[i], "-E") == 0) {
             opts.preprocess_only = true;
+        } else if (strncmp(argv[i], "-I", 2) == 0) {
+            if (argv[i][2] != '\0') {
+                opts.include_paths[opts.include_path_count++] = argv[i] + 2;
+            } else if (i + 1 < argc) {
+                opts.include_paths[opts.include_path_count++] = argv[++i];
+            } else {
+                fprintf(stderr, "Error: -I requires a directory\n");
+                return 1;
+            }
+        } else if (strncmp(argv[i], "-j", 2) == 0) {
+            const char *count = argv[i][2] != '\0' ? argv[i] + 2 : (i + 1 < argc ? argv[++i] : "");
+            char *end;
+            long value = strtol(count, &end, 10);
+            if (*count == '\0' || *end != '\0' || value < 1 || value > 1024) {
+                fprintf(stderr, "Error: -j requires a job count between 1 and 1024\n");
+                return 1;
+            }
+            jobs = (int)value;
+        } else if (strcmp(argv[i], "--emit-ir") == 0) {
+            opts.emit_ir = true;
+        } else if (strncmp(argv[i], "--backend=", 10) == 0) {
+            const char *backend = argv[i] + 10;
+            if (strcmp(backend, "multiarch") == 0) {
+                opts.use_multiarch = true;
+            } else if (strcmp(backend, "default") == 0) {
+                opts.use_multiarch = false;
+            } else {
+                fprintf(stderr, "Error: Unknown backend '%s' (default or multiarch)\n", backend);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--emit-pch") == 0) {
+            opts.emit_pch = true;
+        } else if (strcmp(argv[i], "--include-pch") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --include-pch requires a file\n");
+                return 1;
+            }
+            opts.include_pch = argv[++i];
+        } else if (strncmp(argv[i], "-ftime-report", 13) == 0 ||
+                   strncmp(argv[i], "-fmem-report", 12) == 0) {
+            bool time = argv[i][2] == 't';
+            const char *format = argv[i] + (time ? 13 : 12);
+            if (strcmp(format, "=json") == 0) {
+                opts.report_json = true;
+            } else if (*format != '\0' && strcmp(format, "=table") != 0) {
+                fprintf(stderr, "Error: Unknown report format in '%s'\n", argv[i]);
+                return 1;
+            }
+            if (time) opts.time_report = true; else opts.mem_report = true;
+        } else if (strcmp(argv[i], "--cache") == 0) {
+            opts.cache_dir = compile_cache_default_dir();
+        } else if (strcmp(argv[i], "--cache-dir") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --cache-dir requires a directory\n");
+                return 1;
+            }
+            opts.cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--no-cache") == 0) {
+            opts.cache_dir = NULL;
+        } else if (strcmp(argv[i], "--cache-stats") == 0) {
+            opts.cache_stats = true;
         } else if (strcmp(argv[i], "--no-preprocess") == 0) {
             opts.no_preprocess = true;
         } else if (strcmp(argv[i], "-o") == 0) {
@@ -384,19 +847,98 @@ int main(int argc, char *argv[]) {
             print_usage(argv[0]);
             return 1;
         } else {
-            if (opts.input_file) {
-                fprintf(stderr, "Error: Multiple input files specified\n");
-                return 1;
-            }
-            opts.input_file = argv[i];
+            input_files[input_count++] = argv[i];
         }
     }
 
-    if (!opts.input_file) {
+    const char *stats_dir = opts.cache_dir ? opts.cache_dir : compile_cache_default_dir();
+    if (input_count == 0 && opts.cache_stats) {
+        return compile_cache_print_stats(stats_dir, stdout) ? 0 : 1;
+    }
+
+    if (input_count == 0) {
         fprintf(stderr, "Error: No input file specified\n");
         print_usage(argv[0]);
         return 1;
     }
+    opts.input_file = (char *)input_files[0];
+
+    int result = input_count == 1
+        ? compile_file(opts.input_file, opts.output_file, &opts)
+        : compile_files(input_files, input_count, jobs, &opts);
+    if (opts.cache_stats && !compile_cache_print_stats(stats_dir, stdout)) {
+        result = 1;
+    }
+    include_cache_destroy();
+    intern_table_destroy();
+    free(input_files);
+    free(opts.include_paths);
+    return result;
+}
+
+// --server: preprocess the warm-up headers once, so their contents, guards
+// and spellings are in the caches every forked compile starts from
+static int run_compile_server(int argc, char *argv[]) {
+    const char *socket_path = compile_server_default_socket();
+    const char **include_paths = malloc((size_t)argc * sizeof(char*));
+    const char **headers = malloc((size_t)argc * sizeof(char*));
+    int include_path_count = 0;
+    int header_count = 0;
+    if (!include_paths || !headers) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 1;
+    }
 
-    return compile_file(opts.input_file, opts.output_file, &opts);
-}
\ No newline at end of file
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strncmp(argv[i], "-I", 2) == 0 && (argv[i][2] != '\0' || i + 1 < argc)) {
+            include_paths[include_path_count++] = argv[i][2] != '\0' ? argv[i] + 2 : argv[++i];
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Error: Unknown server option '%s'\n", argv[i]);
+            free(include_paths);
+            free(headers);
+            return 1;
+        } else {
+            headers[header_count++] = argv[i];
+        }
+    }
+
+    for (int i = 0; i < header_count; i++) {
+        Preprocessor *preprocessor = preprocessor_create();
+        if (!preprocessor) continue;
+        for (int j = 0; j < include_path_count; j++) {
+            preprocessor_add_include_path(preprocessor, include_paths[j]);
+        }
+        char *text = preprocessor_process_file(preprocessor, headers[i]);
+        if (!text) {
+            fprintf(stderr, "Warning: Could not preprocess warm-up header '%s'\n", headers[i]);
+        }
+        free(text);
+        preprocessor_destroy(preprocessor);
+    }
+    free(include_paths);
+    free(headers);
+
+    int result = compile_server_run(socket_path, kcc_main);
+    include_cache_destroy();
+    intern_table_destroy();
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "--server") == 0) {
+        return run_compile_server(argc, argv);
+    }
+
+    // Hand the compile to a running server; compile here if none answers
+    const char *server = getenv("KCC_SERVER");
+    if (server && *server) {
+        int status = compile_server_forward(server, argc, argv);
+        if (status >= 0) {
+            return status;
+        }
+    }
+
+    return kcc_main(argc, argv);
+}
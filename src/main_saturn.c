@@ -8,6 +8,7 @@
 #include <stdbool.h>
 
 // KCC headers
+#include "kcc.h"
 #include "lexer.h"
 #include "parser.h"
 #include "ast.h"
@@ -18,19 +19,30 @@
 #include "sh2_instruction_set.h"
 #include "sh2_register_allocator.h"
 #endif
+#include "sh2_assembler.h"
 
 // ============================================================================
 // Saturn-specific Configuration
 // ============================================================================
 
+// Where the BIOS loads the first program file: the start of high work RAM
+// after its own 16 KB
+#define SATURN_LOAD_ADDRESS 0x06004000u
+
 typedef struct {
     bool dual_cpu;
     bool use_linear_scan;
+    bool compile_only;            // -c: ELF object instead of a flat image
+    const char *output_file;
+    const char *input_file;
 } SaturnOptions;
 
 static SaturnOptions saturn_opts = {
     .dual_cpu = false,
-    .use_linear_scan = false
+    .use_linear_scan = false,
+    .compile_only = false,
+    .output_file = NULL,
+    .input_file = NULL
 };
 
 // ============================================================================
@@ -46,7 +58,7 @@ static void print_saturn_version(void) {
 
 static void print_saturn_help(void) {
     print_saturn_version();
-    printf("Usage: kcc [options] <input.c>\n\n");
+    printf("Usage: kcc [options] <input.c | input.s>\n\n");
     printf("Standard Options:\n");
     printf("  -o <file>         Write output to <file>\n");
     printf("  -S                Emit assembly code\n");
@@ -62,6 +74,8 @@ static void print_saturn_help(void) {
     printf("Examples:\n");
     printf("  kcc game.c -o game.s\n");
     printf("  kcc game.c --dual-cpu -o game.s\n");
+    printf("  kcc game.s -o game.bin      (flat image loaded at 0x%08X)\n", SATURN_LOAD_ADDRESS);
+    printf("  kcc -c game.s -o game.o\n");
     printf("\n");
 }
 
@@ -75,18 +89,77 @@ static bool parse_saturn_arguments(int argc, char **argv) {
             saturn_opts.dual_cpu = true;
         } else if (strcmp(argv[i], "--linear-scan") == 0) {
             saturn_opts.use_linear_scan = true;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            saturn_opts.compile_only = true;
+        } else if (strcmp(argv[i], "-o") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: -o requires a file name\n");
+                return false;
+            }
+            saturn_opts.output_file = argv[++i];
+        } else if (argv[i][0] != '-') {
+            saturn_opts.input_file = argv[i];
         }
     }
     return true;
 }
 
+// ============================================================================
+// Assembly Input
+// ============================================================================
+
+static bool has_suffix(const char *name, const char *suffix) {
+    size_t length = strlen(name);
+    size_t suffix_length = strlen(suffix);
+    return length >= suffix_length && strcmp(name + length - suffix_length, suffix) == 0;
+}
+
+// Assembles SH-2 source (what the sh2_* emitters print, or written by hand)
+// with the integrated assembler: an ELF32 object with -c, otherwise a flat
+// image for SATURN_LOAD_ADDRESS. No sh-elf-as is needed.
+static int assemble_saturn(const char *input, const char *output, bool object) {
+    SourceFile source;
+    if (!source_file_open(&source, input)) {
+        fprintf(stderr, "Error: Cannot open input file '%s'\n", input);
+        return 1;
+    }
+
+    SH2Assembler *as = sh2_asm_create();
+    if (!as) {
+        source_file_close(&source);
+        fprintf(stderr, "Error: Failed to create SH-2 assembler\n");
+        return 1;
+    }
+    sh2_asm_source(as, source.data, source.size);
+    source_file_close(&source);
+
+    bool written = object ? sh2_asm_write_object(as, output)
+                          : sh2_asm_write_binary(as, output, SATURN_LOAD_ADDRESS);
+    sh2_asm_destroy(as);
+    if (!written) {
+        fprintf(stderr, "Error: Assembling '%s' failed\n", input);
+        return 1;
+    }
+    return 0;
+}
+
 // ============================================================================
 // Main Entry Point
 // ============================================================================
 
 int main(int argc, char **argv) {
     // Parse Saturn-specific arguments
-    parse_saturn_arguments(argc, argv);
+    if (!parse_saturn_arguments(argc, argv)) {
+        return 1;
+    }
+
+    if (saturn_opts.input_file && has_suffix(saturn_opts.input_file, ".s")) {
+        const char *output = saturn_opts.output_file;
+        if (!output) {
+            output = saturn_opts.compile_only ? "a.o" : "a.bin";
+        }
+        return assemble_saturn(saturn_opts.input_file, output, saturn_opts.compile_only);
+    }
 
     // Print Saturn banner
     printf("KCC for Sega Saturn - SH-2 Code Generator\n");
@@ -1,5 +1,10 @@
+#include <stdint.h>
 #include "kcc.h"
 #include "multiarch_codegen.h"
+#include "builtins.h"
+#include "ir.h"
+#include "regalloc.h"
+#include "error.h"
 
 // ===== ARCHITECTURE DEFINITIONS =====
 
@@ -170,7 +175,8 @@ MultiArchCodegen *multiarch_codegen_create(const char *output_file, TargetArch a
     }
 
     codegen->target = target_config_create(arch, platform);
-    if (!codegen->target) {
+    if (!codegen->target || !asm_buffer_init(&codegen->output, codegen->output_file)) {
+        target_config_destroy(codegen->target);
         fclose(codegen->output_file);
         free(codegen);
         return NULL;
@@ -178,9 +184,6 @@ MultiArchCodegen *multiarch_codegen_create(const char *output_file, TargetArch a
 
     codegen->label_counter = 0;
     codegen->temp_counter = 0;
-    codegen->current_function_locals = 0;
-    codegen->stack_offset = 0;
-    codegen->local_var_count = 0;
     codegen->in_function = false;
     codegen->stack_size = 0;
 
@@ -190,8 +193,12 @@ MultiArchCodegen *multiarch_codegen_create(const char *output_file, TargetArch a
 void multiarch_codegen_destroy(MultiArchCodegen *codegen) {
     if (codegen) {
         if (codegen->output_file) {
+            if (!asm_buffer_flush(&codegen->output)) {
+                fprintf(stderr, "Error: Failed to write assembly output\n");
+            }
             fclose(codegen->output_file);
         }
+        asm_buffer_free(&codegen->output);
         target_config_destroy(codegen->target);
         free(codegen);
     }
@@ -200,9 +207,9 @@ void multiarch_codegen_destroy(MultiArchCodegen *codegen) {
 void multiarch_emit(MultiArchCodegen *codegen, const char *format, ...) {
     va_list args;
     va_start(args, format);
-    vfprintf(codegen->output_file, format, args);
+    asm_buffer_vformat(&codegen->output, format, args);
     va_end(args);
-    fprintf(codegen->output_file, "\n");
+    asm_buffer_putc(&codegen->output, '\n');
 }
 
 void multiarch_emit_comment(MultiArchCodegen *codegen, const char *comment) {
@@ -226,19 +233,24 @@ void multiarch_emit_directive(MultiArchCodegen *codegen, const char *directive,
 void multiarch_load_immediate(MultiArchCodegen *codegen, const char *dest_reg, long value) {
     switch (codegen->target->arch) {
         case ARCH_X86_64:
-            multiarch_emit(codegen, "    movq $%ld, %%%s", value, dest_reg);
+            if (value >= INT32_MIN && value <= INT32_MAX) {
+                multiarch_emit(codegen, "    movq $%ld, %%%s", value, dest_reg);
+            } else {
+                multiarch_emit(codegen, "    movabsq $%ld, %%%s", value, dest_reg);
+            }
             break;
         case ARCH_ARM64:
-            if (value >= 0 && value < 65536) {
+            if (value >= -65536 && value < 65536) {
                 multiarch_emit(codegen, "    mov %s, #%ld", dest_reg, value);
             } else {
-                multiarch_emit(codegen, "    mov %s, #%ld", dest_reg, value & 0xFFFF);
-                if (value > 65535) {
-                    multiarch_emit(codegen, "    movk %s, #%ld, lsl #16", dest_reg, (value >> 16) & 0xFFFF);
-                }
-                if (value > 0xFFFFFFFF) {
-                    multiarch_emit(codegen, "    movk %s, #%ld, lsl #32", dest_reg, (value >> 32) & 0xFFFF);
-                    multiarch_emit(codegen, "    movk %s, #%ld, lsl #48", dest_reg, (value >> 48) & 0xFFFF);
+                // First halfword zeroes the rest, movk fills in the nonzero ones
+                unsigned long bits = (unsigned long)value;
+                multiarch_emit(codegen, "    mov %s, #%lu", dest_reg, bits & 0xFFFF);
+                for (int shift = 16; shift < 64; shift += 16) {
+                    if ((bits >> shift) & 0xFFFF) {
+                        multiarch_emit(codegen, "    movk %s, #%lu, lsl #%d", dest_reg,
+                                       (bits >> shift) & 0xFFFF, shift);
+                    }
                 }
             }
             break;
@@ -403,10 +415,9 @@ void multiarch_jump_if_greater(MultiArchCodegen *codegen, const char *label) {
 }
 
 void multiarch_function_prologue(MultiArchCodegen *codegen, const char *func_name, int param_count) {
+    (void)param_count;  // The frame is the same whatever the parameter count
     codegen->in_function = true;
     strncpy(codegen->current_function, func_name, sizeof(codegen->current_function) - 1);
-    codegen->local_var_count = 0;
-    codegen->stack_offset = 0;
 
     // Emit function label
     if (codegen->target->platform == PLATFORM_MACOS) {
@@ -511,24 +522,26 @@ const char *multiarch_get_return_reg(MultiArchCodegen *codegen) {
     return codegen->target->return_regs[0];
 }
 
+// The index-th caller-saved general register that carries neither
+// arguments nor results, falling back to the return register
 const char *multiarch_get_temp_reg(MultiArchCodegen *codegen, int index) {
-    switch (codegen->target->arch) {
-        case ARCH_X86_64:
-            switch (index) {
-                case 0: return "r10";
-                case 1: return "r11";
-                default: return "rax";
-            }
-        case ARCH_ARM64:
-            switch (index) {
-                case 0: return "x9";
-                case 1: return "x10";
-                case 2: return "x11";
-                default: return "x0";
-            }
-        default:
-            return "unknown";
+    const TargetConfig *target = codegen->target;
+    for (int r = 0; r < target->num_general_regs; r++) {
+        const RegisterInfo *reg = &target->general_regs[r];
+        if (reg->type != REG_GENERAL || reg->preserved) continue;
+
+        bool reserved = false;
+        for (int i = 0; i < target->num_param_regs && !reserved; i++) {
+            reserved = strcmp(reg->name, target->param_regs[i]) == 0;
+        }
+        for (int i = 0; i < target->num_return_regs && !reserved; i++) {
+            reserved = strcmp(reg->name, target->return_regs[i]) == 0;
+        }
+        if (!reserved && index-- == 0) {
+            return reg->name;
+        }
     }
+    return multiarch_get_return_reg(codegen);
 }
 
 const char *multiarch_get_stack_pointer(MultiArchCodegen *codegen) {
@@ -604,14 +617,13 @@ void multiarch_store_memory(MultiArchCodegen *codegen, const char *src_reg, cons
 }
 
 void multiarch_syscall(MultiArchCodegen *codegen, int syscall_num, int arg_count) {
+    (void)arg_count;    // The caller has already loaded the argument registers
     multiarch_load_immediate(codegen, codegen->target->syscall_reg, syscall_num);
     multiarch_emit(codegen, "    %s", codegen->target->syscall_instruction);
 }
 
-void multiarch_exit_program(MultiArchCodegen *codegen, int exit_code) {
-    const char *return_reg = multiarch_get_return_reg(codegen);
-    multiarch_load_immediate(codegen, return_reg, exit_code);
-
+// exit() with its status already in the first argument register
+static void multiarch_exit_syscall(MultiArchCodegen *codegen) {
     switch (codegen->target->platform) {
         case PLATFORM_LINUX:
             if (codegen->target->arch == ARCH_X86_64) {
@@ -632,6 +644,38 @@ void multiarch_exit_program(MultiArchCodegen *codegen, int exit_code) {
     }
 }
 
+void multiarch_exit_program(MultiArchCodegen *codegen, int exit_code) {
+    multiarch_load_immediate(codegen, multiarch_get_param_reg(codegen, 0), exit_code);
+    multiarch_exit_syscall(codegen);
+}
+
+// The driver links with _main as the entry point (KCC_LINK_FLAGS). On
+// macOS that is main itself; elsewhere _main calls main and exits with its
+// result, the stack still aligned as the kernel left it.
+static void multiarch_emit_entry(MultiArchCodegen *codegen) {
+    if (codegen->target->platform == PLATFORM_MACOS) return;
+
+    const char *result = multiarch_get_return_reg(codegen);
+    const char *status = multiarch_get_param_reg(codegen, 0);
+    multiarch_emit(codegen, "");
+    multiarch_emit_directive(codegen, codegen->target->global_directive, "_main");
+    multiarch_emit_label(codegen, "_main");
+    multiarch_function_call(codegen, "main", 0);
+    switch (codegen->target->arch) {
+        case ARCH_X86_64:
+            multiarch_emit(codegen, "    movq %%%s, %%%s", result, status);
+            break;
+        case ARCH_ARM64:
+            if (strcmp(result, status) != 0) {
+                multiarch_emit(codegen, "    mov %s, %s", status, result);
+            }
+            break;
+        default:
+            break;
+    }
+    multiarch_exit_syscall(codegen);
+}
+
 char *multiarch_new_label(MultiArchCodegen *codegen) {
     char *label = malloc(32);
     snprintf(label, 32, "L%d", codegen->label_counter++);
@@ -644,529 +688,1162 @@ char *multiarch_new_temp(MultiArchCodegen *codegen) {
     return temp;
 }
 
-void multiarch_declare_local_var(MultiArchCodegen *codegen, const char *name, int size) {
-    if (codegen->local_var_count >= 256) return;
+// ===== CODE GENERATION =====
 
-    // Align to proper boundary
-    int alignment = (size >= 8) ? 8 : size;
-    codegen->stack_offset = (codegen->stack_offset + alignment - 1) & ~(alignment - 1);
-    codegen->stack_offset += size;
+bool multiarch_codegen_generate(MultiArchCodegen *codegen, struct ASTNode *ast) {
+    if (!codegen || !ast) return false;
 
-    // Store variable info
-    strncpy(codegen->local_vars[codegen->local_var_count].name, name, 63);
-    codegen->local_vars[codegen->local_var_count].name[63] = '\0';
-    codegen->local_vars[codegen->local_var_count].offset = -codegen->stack_offset;
-    codegen->local_vars[codegen->local_var_count].size = size;
-    codegen->local_var_count++;
-}
+    // Emit header
+    multiarch_emit_comment(codegen, "Generated by KCC Multi-Architecture Compiler");
+    char target_info[128];
+    snprintf(target_info, sizeof(target_info), "Target: %s-%s",
+             codegen->target->arch_name, codegen->target->platform_name);
+    multiarch_emit_comment(codegen, target_info);
+    multiarch_emit(codegen, "");
 
-int multiarch_get_local_var_offset(MultiArchCodegen *codegen, const char *name) {
-    for (int i = 0; i < codegen->local_var_count; i++) {
-        if (strcmp(codegen->local_vars[i].name, name) == 0) {
-            return codegen->local_vars[i].offset;
-        }
+    // Emit sections
+    multiarch_emit_directive(codegen, codegen->target->section_text, NULL);
+    multiarch_emit(codegen, "");
+
+    // Lower to the IR and generate each function from its register allocation
+    int errors = error_count();
+    IRModule *module = ir_lower_program(ast);
+    if (!module) return false;
+    if (error_count() > errors) {
+        ir_module_destroy(module);
+        return false;
+    }
+    bool defines_main = false;
+    for (IRFunction *function = module->functions; function; function = function->next) {
+        multiarch_codegen_ir_function(codegen, function);
+        defines_main |= strcmp(function->name, "main") == 0;
+    }
+    multiarch_codegen_ir_globals(codegen, module);
+    ir_module_destroy(module);
+
+    // Program entry point, only in the unit that defines main so several
+    // objects can be linked into one program
+    if (defines_main) {
+        multiarch_emit_entry(codegen);
     }
-    return 0; // Not found
+
+    return true;
 }
 
-void multiarch_load_local_var(MultiArchCodegen *codegen, const char *dest_reg, const char *var_name) {
-    int offset = multiarch_get_local_var_offset(codegen, var_name);
-    const char *fp = multiarch_get_frame_pointer(codegen);
+void multiarch_stack_alloc(MultiArchCodegen *codegen, int bytes) {
+    // Align to stack alignment
+    bytes = (bytes + codegen->target->stack_alignment - 1) & ~(codegen->target->stack_alignment - 1);
 
     switch (codegen->target->arch) {
         case ARCH_X86_64:
-            multiarch_emit(codegen, "    movq %d(%%%s), %%%s", offset, fp, dest_reg);
+            multiarch_emit(codegen, "    subq $%d, %%rsp", bytes);
             break;
         case ARCH_ARM64:
-            multiarch_emit(codegen, "    ldr %s, [%s, #%d]", dest_reg, fp, offset);
+            multiarch_emit(codegen, "    sub sp, sp, #%d", bytes);
             break;
         default:
             break;
     }
 }
 
-void multiarch_store_local_var(MultiArchCodegen *codegen, const char *src_reg, const char *var_name) {
-    int offset = multiarch_get_local_var_offset(codegen, var_name);
-    const char *fp = multiarch_get_frame_pointer(codegen);
+void multiarch_stack_dealloc(MultiArchCodegen *codegen, int bytes) {
+    // Align to stack alignment
+    bytes = (bytes + codegen->target->stack_alignment - 1) & ~(codegen->target->stack_alignment - 1);
 
     switch (codegen->target->arch) {
         case ARCH_X86_64:
-            multiarch_emit(codegen, "    movq %%%s, %d(%%%s)", src_reg, offset, fp);
+            multiarch_emit(codegen, "    addq $%d, %%rsp", bytes);
             break;
         case ARCH_ARM64:
-            multiarch_emit(codegen, "    str %s, [%s, #%d]", src_reg, fp, offset);
+            multiarch_emit(codegen, "    add sp, sp, #%d", bytes);
             break;
         default:
             break;
     }
 }
 
-// ===== AST CODE GENERATION =====
-
-bool multiarch_codegen_generate(MultiArchCodegen *codegen, struct ASTNode *ast) {
-    if (!codegen || !ast) return false;
+// ===== IR CODE GENERATION =====
+
+// Where an IR operand is read from or written to
+typedef enum {
+    MULTIARCH_LOC_REG,
+    MULTIARCH_LOC_MEM,
+    MULTIARCH_LOC_IMM
+} MultiArchLocationKind;
+
+typedef struct {
+    MultiArchLocationKind kind;
+    const char *reg;             // The register, or the base register of MEM
+    int offset;                  // MEM displacement
+    long imm;
+} MultiArchLocation;
+
+// An edge whose moves get a block of their own: it leaves a block with two
+// successors for one with several predecessors
+typedef struct {
+    int label;
+    const IRBlock *pred;
+    const IRBlock *succ;
+} MultiArchEdgeStub;
+
+// One function being generated from the IR. The frame below the frame
+// pointer holds the callee-saved registers the allocation used, then the
+// spill slots.
+typedef struct {
+    MultiArchCodegen *codegen;
+    const IRFunction *function;
+    RegAllocation *alloc;
+    int label_base;              // Block b is label L<label_base + b>
+    int epilogue_label;
+    int saved[64];               // general_regs indices of the callee-saved registers used
+    int saved_count;
+    int frame_size;              // Bytes below the frame pointer
+    int outgoing;                // ARM64: bytes of stack arguments below sp
+    MultiArchEdgeStub *stubs;
+    int stub_count;
+    int stub_capacity;
+} MultiArchFunction;
+
+static bool multiarch_is_arm64(const MultiArchFunction *fn) {
+    return fn->codegen->target->arch == ARCH_ARM64;
+}
 
-    // Emit header
-    multiarch_emit_comment(codegen, "Generated by KCC Multi-Architecture Compiler");
-    char target_info[128];
-    snprintf(target_info, sizeof(target_info), "Target: %s-%s",
-             codegen->target->arch_name, codegen->target->platform_name);
-    multiarch_emit_comment(codegen, target_info);
-    multiarch_emit(codegen, "");
+// Registers the IR code uses on its own, kept from the allocator: x86-64
+// needs rax and rdx for results and idiv, rcx for shift counts and r11 as
+// a second scratch; ARM64 scratches in x16/x17, outside the table, and x8
+static const char *multiarch_scratch(const MultiArchFunction *fn, int index) {
+    if (multiarch_is_arm64(fn)) {
+        return index == 0 ? "x16" : index == 1 ? "x17" : "x8";
+    }
+    return index == 0 ? "rax" : "r11";
+}
 
-    // Emit sections
-    multiarch_emit_directive(codegen, codegen->target->section_text, NULL);
-    multiarch_emit(codegen, "");
+static uint64_t multiarch_reserved_registers(const TargetConfig *target) {
+    static const char *const x86_64_reserved[] = {"rax", "rcx", "rdx", "r11"};
+    static const char *const arm64_reserved[] = {"x8"};
+    const char *const *names = target->arch == ARCH_ARM64 ? arm64_reserved : x86_64_reserved;
+    int count = target->arch == ARCH_ARM64 ? 1 : 4;
+
+    uint64_t reserved = 0;
+    for (int r = 0; r < target->num_general_regs && r < 64; r++) {
+        for (int i = 0; i < count; i++) {
+            if (strcmp(target->general_regs[r].name, names[i]) == 0) {
+                reserved |= (uint64_t)1 << r;
+            }
+        }
+    }
+    return reserved;
+}
 
-    // Generate code for the AST
-    multiarch_codegen_program(codegen, ast);
+static void multiarch_symbol(const MultiArchCodegen *codegen, const char *name, char *buffer,
+                             size_t size) {
+    snprintf(buffer, size, "%s%s", codegen->target->platform == PLATFORM_MACOS ? "_" : "", name);
+}
 
-    // Add program entry point
-    if (codegen->target->platform == PLATFORM_LINUX) {
-        multiarch_emit(codegen, "");
-        multiarch_emit_directive(codegen, codegen->target->global_directive, "_start");
-        multiarch_emit_label(codegen, "_start");
-        multiarch_function_call(codegen, "main", 0);
-        multiarch_exit_program(codegen, 0);
-    } else if (codegen->target->platform == PLATFORM_MACOS) {
-        multiarch_emit(codegen, "");
-        multiarch_emit_directive(codegen, codegen->target->global_directive, "_main");
-        // macOS handles entry differently
+// Name of a 64-bit register at size bytes
+static const char *multiarch_sized_reg(const MultiArchFunction *fn, const char *reg, int size,
+                                       char buffer[8]) {
+    if (size == 8) return reg;
+
+    if (multiarch_is_arm64(fn)) {
+        snprintf(buffer, 8, "w%s", reg + 1);
+    } else if (reg[1] >= '0' && reg[1] <= '9') {
+        snprintf(buffer, 8, "%s%s", reg, size == 4 ? "d" : size == 2 ? "w" : "b");
+    } else if (size == 4) {
+        snprintf(buffer, 8, "e%s", reg + 1);
+    } else if (size == 2) {
+        snprintf(buffer, 8, "%s", reg + 1);
+    } else if (reg[2] == 'x') {
+        snprintf(buffer, 8, "%cl", reg[1]);
+    } else {
+        snprintf(buffer, 8, "%sl", reg + 1);
     }
-
-    return true;
+    return buffer;
 }
 
-void multiarch_codegen_program(MultiArchCodegen *codegen, struct ASTNode *node) {
-    if (node->type != AST_PROGRAM) return;
+// Arithmetic width: 64-bit values in full registers, the rest in 32 bits
+static int multiarch_ir_width(IRType type) {
+    return type == IR_TYPE_I64 || type == IR_TYPE_PTR ? 8 : 4;
+}
 
-    for (int i = 0; i < node->data.program.declaration_count; i++) {
-        struct ASTNode *decl = node->data.program.declarations[i];
+static MultiArchLocation multiarch_reg_location(const char *reg) {
+    MultiArchLocation location = {MULTIARCH_LOC_REG, reg, 0, 0};
+    return location;
+}
 
-        if (decl->type == AST_FUNCTION_DECLARATION) {
-            multiarch_codegen_function_declaration(codegen, decl);
-        } else if (decl->type == AST_VAR_DECL) {
-            multiarch_codegen_variable_declaration(codegen, decl);
-        }
+// A frame slot offset bytes below the frame pointer. ARM64 addresses it
+// from sp, whose scaled offsets reach further than x29's signed ones.
+static MultiArchLocation multiarch_frame_location(const MultiArchFunction *fn, int offset) {
+    MultiArchLocation location = {MULTIARCH_LOC_MEM, "rbp", -offset, 0};
+    if (multiarch_is_arm64(fn)) {
+        location.reg = "sp";
+        location.offset = fn->frame_size - offset + fn->outgoing;
     }
+    return location;
 }
 
-void multiarch_codegen_function_declaration(MultiArchCodegen *codegen, struct ASTNode *node) {
-    if (node->type != AST_FUNCTION_DECLARATION) return;
-
-    multiarch_emit(codegen, "");
-    char func_comment[128];
-    snprintf(func_comment, sizeof(func_comment), "Function: %s", node->data.function_decl.name);
-    multiarch_emit_comment(codegen, func_comment);
-
-    // Make function global if it's main or explicitly requested
-    if (strcmp(node->data.function_decl.name, "main") == 0) {
-        if (codegen->target->platform == PLATFORM_MACOS) {
-            multiarch_emit_directive(codegen, codegen->target->global_directive, "_main");
-        } else {
-            multiarch_emit_directive(codegen, codegen->target->global_directive, "main");
-        }
+static MultiArchLocation multiarch_ir_place(const MultiArchFunction *fn, RegLocation where) {
+    if (where.reg != REGALLOC_STACK) {
+        return multiarch_reg_location(fn->codegen->target->general_regs[where.reg].name);
     }
-
-    multiarch_function_prologue(codegen, node->data.function_decl.name, node->data.function_decl.parameter_count);
-
-    // Allocate space for local variables if needed
-    if (codegen->stack_offset > 0) {
-        multiarch_stack_alloc(codegen, codegen->stack_offset);
+    if (where.slot < 0) {
+        MultiArchLocation nowhere = {MULTIARCH_LOC_IMM, NULL, 0, 0};
+        return nowhere;
     }
+    return multiarch_frame_location(fn, 8 * (fn->saved_count + where.slot + 1));
+}
 
-    // Generate function body
-    if (node->data.function_decl.body) {
-        multiarch_codegen_statement(codegen, node->data.function_decl.body);
+static MultiArchLocation multiarch_ir_location(const MultiArchFunction *fn, const IRInstr *value,
+                                               int position) {
+    if (value->op == IR_CONST || value->id < 0) {
+        MultiArchLocation constant = {MULTIARCH_LOC_IMM, NULL, 0, (long)value->data.constant};
+        return constant;
     }
+    return multiarch_ir_place(fn, regalloc_location(fn->alloc, value->id, position));
+}
 
-    // Add default return if needed
-    multiarch_function_return(codegen, false);
+static bool multiarch_same_location(MultiArchLocation a, MultiArchLocation b) {
+    if (a.kind != b.kind) return false;
+    switch (a.kind) {
+        case MULTIARCH_LOC_REG:
+            return strcmp(a.reg, b.reg) == 0;
+        case MULTIARCH_LOC_MEM:
+            return strcmp(a.reg, b.reg) == 0 && a.offset == b.offset;
+        default:
+            return false;
+    }
 }
 
-void multiarch_codegen_variable_declaration(MultiArchCodegen *codegen, struct ASTNode *node) {
-    if (node->type != AST_VAR_DECL) return;
+// x86-64 operand text for location at size bytes
+static const char *multiarch_x86_operand(const MultiArchFunction *fn, MultiArchLocation location,
+                                         int size, char buffer[32]) {
+    char reg[8];
+    switch (location.kind) {
+        case MULTIARCH_LOC_REG:
+            snprintf(buffer, 32, "%%%s", multiarch_sized_reg(fn, location.reg, size, reg));
+            break;
+        case MULTIARCH_LOC_MEM:
+            snprintf(buffer, 32, "%d(%%%s)", location.offset, location.reg);
+            break;
+        default:
+            snprintf(buffer, 32, "$%ld", size == 8 ? location.imm : (long)(int32_t)location.imm);
+            break;
+    }
+    return buffer;
+}
 
-    char var_comment[128];
-    snprintf(var_comment, sizeof(var_comment), "Variable: %s", node->data.var_decl.name);
-    multiarch_emit_comment(codegen, var_comment);
+static bool multiarch_fits_imm32(long value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
 
-    // For local variables, declare space on stack
-    if (codegen->in_function) {
-        int size = 8; // Default size for int
-        multiarch_declare_local_var(codegen, node->data.var_decl.name, size);
+// Copies all 64 bits of from into to; memory to memory and large constants
+// go through the first scratch register
+static void multiarch_ir_move(MultiArchFunction *fn, MultiArchLocation to, MultiArchLocation from) {
+    MultiArchCodegen *codegen = fn->codegen;
+    if (multiarch_same_location(to, from)) return;
+
+    if (to.kind == MULTIARCH_LOC_REG) {
+        if (from.kind == MULTIARCH_LOC_IMM) {
+            multiarch_load_immediate(codegen, to.reg, from.imm);
+        } else if (multiarch_is_arm64(fn)) {
+            if (from.kind == MULTIARCH_LOC_REG) {
+                multiarch_emit(codegen, "    mov %s, %s", to.reg, from.reg);
+            } else {
+                multiarch_emit(codegen, "    ldr %s, [%s, #%d]", to.reg, from.reg, from.offset);
+            }
+        } else if (from.kind == MULTIARCH_LOC_REG) {
+            multiarch_emit(codegen, "    movq %%%s, %%%s", from.reg, to.reg);
+        } else {
+            multiarch_emit(codegen, "    movq %d(%%%s), %%%s", from.offset, from.reg, to.reg);
+        }
+        return;
+    }
 
-        if (node->data.var_decl.initializer) {
-            // Generate code for initializer
-            multiarch_codegen_expression(codegen, node->data.var_decl.initializer);
-            // Store result in variable
-            multiarch_store_local_var(codegen, multiarch_get_return_reg(codegen), node->data.var_decl.name);
+    if (to.kind != MULTIARCH_LOC_MEM) return;
+    if (multiarch_is_arm64(fn)) {
+        const char *reg = from.reg;
+        if (from.kind == MULTIARCH_LOC_IMM && from.imm == 0) {
+            reg = "xzr";
+        } else if (from.kind != MULTIARCH_LOC_REG) {
+            reg = multiarch_scratch(fn, 0);
+            multiarch_ir_move(fn, multiarch_reg_location(reg), from);
         }
+        multiarch_emit(codegen, "    str %s, [%s, #%d]", reg, to.reg, to.offset);
+    } else if (from.kind == MULTIARCH_LOC_IMM && multiarch_fits_imm32(from.imm)) {
+        multiarch_emit(codegen, "    movq $%ld, %d(%%%s)", from.imm, to.offset, to.reg);
+    } else {
+        const char *reg = from.reg;
+        if (from.kind != MULTIARCH_LOC_REG) {
+            reg = multiarch_scratch(fn, 0);
+            multiarch_ir_move(fn, multiarch_reg_location(reg), from);
+        }
+        multiarch_emit(codegen, "    movq %%%s, %d(%%%s)", reg, to.offset, to.reg);
     }
 }
 
-void multiarch_codegen_statement(MultiArchCodegen *codegen, struct ASTNode *node) {
-    switch (node->type) {
-        case AST_COMPOUND_STATEMENT:
-            for (int i = 0; i < node->data.compound_stmt.statement_count; i++) {
-                multiarch_codegen_statement(codegen, node->data.compound_stmt.statements[i]);
-            }
-            break;
+// Runs the moves as one parallel copy: a move goes once no other pending
+// move still reads its destination, and a cycle is broken by parking one
+// destination in the second scratch register
+static void multiarch_ir_parallel_move(MultiArchFunction *fn, MultiArchLocation *to,
+                                       MultiArchLocation *from, int count) {
+    if (count <= 0) return;
+    bool *done = calloc((size_t)count, sizeof(bool));
+    int remaining = 0;
+    for (int i = 0; i < count; i++) {
+        done[i] = multiarch_same_location(to[i], from[i]);
+        if (!done[i]) remaining++;
+    }
 
-        case AST_EXPRESSION_STATEMENT:
-            if (node->data.expression_stmt.expression) {
-                multiarch_codegen_expression(codegen, node->data.expression_stmt.expression);
+    while (remaining > 0) {
+        bool progress = false;
+        for (int i = 0; i < count; i++) {
+            if (done[i]) continue;
+            bool blocked = false;
+            for (int j = 0; j < count && !blocked; j++) {
+                blocked = j != i && !done[j] && multiarch_same_location(from[j], to[i]);
+            }
+            if (!blocked) {
+                multiarch_ir_move(fn, to[i], from[i]);
+                done[i] = true;
+                remaining--;
+                progress = true;
+            }
+        }
+        if (progress) continue;
+
+        for (int i = 0; i < count; i++) {
+            if (done[i]) continue;
+            MultiArchLocation parked = multiarch_reg_location(multiarch_scratch(fn, 1));
+            multiarch_ir_move(fn, parked, to[i]);
+            for (int j = 0; j < count; j++) {
+                if (!done[j] && multiarch_same_location(from[j], to[i])) {
+                    from[j] = parked;
+                }
             }
             break;
+        }
+    }
+    free(done);
+}
 
-        case AST_RETURN_STATEMENT:
-            multiarch_codegen_return_stmt(codegen, node);
-            break;
+// Emits the moves the allocator asks for on the edge from pred to succ
+static void multiarch_ir_edge_moves(MultiArchFunction *fn, const IRBlock *pred, const IRBlock *succ) {
+    int count = 0;
+    RegMove *moves = regalloc_edge_moves(fn->alloc, pred, succ, &count);
+    if (!moves) return;
+
+    MultiArchLocation *to = malloc(sizeof(MultiArchLocation) * (size_t)count);
+    MultiArchLocation *from = malloc(sizeof(MultiArchLocation) * (size_t)count);
+    for (int i = 0; i < count; i++) {
+        to[i] = multiarch_ir_place(fn, moves[i].to);
+        if (moves[i].constant) {
+            from[i] = multiarch_ir_location(fn, moves[i].constant, 0);
+        } else {
+            from[i] = multiarch_ir_place(fn, moves[i].from);
+        }
+    }
+    multiarch_ir_parallel_move(fn, to, from, count);
 
-        case AST_IF_STATEMENT:
-            multiarch_codegen_if_stmt(codegen, node);
-            break;
+    free(to);
+    free(from);
+    free(moves);
+}
 
-        case AST_WHILE_STATEMENT:
-            multiarch_codegen_while_stmt(codegen, node);
-            break;
+static bool multiarch_ir_has_edge_moves(const MultiArchFunction *fn, const IRBlock *pred,
+                                        const IRBlock *succ) {
+    int count = 0;
+    RegMove *moves = regalloc_edge_moves(fn->alloc, pred, succ, &count);
+    free(moves);
+    return count > 0;
+}
 
-        case AST_VAR_DECL:
-            multiarch_codegen_variable_declaration(codegen, node);
-            break;
+// Label a branch of block takes to reach succ. Edge moves go at the start
+// of a successor with no other predecessor, or else into a stub.
+static int multiarch_ir_branch_target(MultiArchFunction *fn, const IRBlock *block,
+                                      const IRBlock *succ) {
+    if (succ->pred_count == 1 || !multiarch_ir_has_edge_moves(fn, block, succ)) {
+        return fn->label_base + succ->id;
+    }
 
-        default:
-            multiarch_emit_comment(codegen, "Unsupported statement type");
-            break;
+    if (fn->stub_count == fn->stub_capacity) {
+        fn->stub_capacity = fn->stub_capacity ? fn->stub_capacity * 2 : 8;
+        fn->stubs = realloc(fn->stubs, sizeof(MultiArchEdgeStub) * (size_t)fn->stub_capacity);
     }
+    MultiArchEdgeStub *stub = &fn->stubs[fn->stub_count++];
+    stub->label = fn->codegen->label_counter++;
+    stub->pred = block;
+    stub->succ = succ;
+    return stub->label;
 }
 
-void multiarch_codegen_expression(MultiArchCodegen *codegen, struct ASTNode *node) {
-    switch (node->type) {
-        case AST_NUMBER_LITERAL:
-            multiarch_load_immediate(codegen, multiarch_get_return_reg(codegen), node->data.number.value);
-            break;
-
-        case AST_IDENTIFIER:
-            multiarch_load_local_var(codegen, multiarch_get_return_reg(codegen), node->data.identifier.name);
-            break;
+static void multiarch_ir_jump(MultiArchFunction *fn, int label) {
+    multiarch_emit(fn->codegen, multiarch_is_arm64(fn) ? "    b L%d" : "    jmp L%d", label);
+}
 
-        case AST_BINARY_OP:
-            multiarch_codegen_binary_expr(codegen, node);
-            break;
+// ===== IR FRAME =====
 
-        case AST_FUNCTION_CALL:
-            multiarch_codegen_call_expr(codegen, node);
-            break;
+static void multiarch_ir_prologue(MultiArchFunction *fn) {
+    MultiArchCodegen *codegen = fn->codegen;
+    const TargetConfig *target = codegen->target;
+    char symbol[256];
+    multiarch_symbol(codegen, fn->function->name, symbol, sizeof(symbol));
 
-        default:
-            multiarch_emit_comment(codegen, "Unsupported expression type");
-            break;
+    multiarch_emit(codegen, "");
+    char comment[128];
+    snprintf(comment, sizeof(comment), "Function: %s (%d spill slots)",
+             fn->function->name, fn->alloc->spill_slot_count);
+    multiarch_emit_comment(codegen, comment);
+    multiarch_emit_directive(codegen, target->global_directive, symbol);
+    multiarch_emit_label(codegen, symbol);
+
+    int words = fn->saved_count + fn->alloc->spill_slot_count;
+    if (multiarch_is_arm64(fn)) {
+        fn->frame_size = (words * 8 + 15) & ~15;
+        multiarch_emit(codegen, "    stp x29, x30, [sp, #-16]!");
+        multiarch_emit(codegen, "    mov x29, sp");
+        if (fn->frame_size > 0) {
+            multiarch_emit(codegen, "    sub sp, sp, #%d", fn->frame_size);
+        }
+        for (int i = 0; i < fn->saved_count; i++) {
+            multiarch_ir_move(fn, multiarch_frame_location(fn, 8 * (i + 1)),
+                              multiarch_reg_location(target->general_regs[fn->saved[i]].name));
+        }
+    } else {
+        // The pushes count towards the 16-byte alignment of the slots below them
+        int slot_bytes = fn->alloc->spill_slot_count * 8 + (words % 2 ? 8 : 0);
+        fn->frame_size = fn->saved_count * 8 + slot_bytes;
+        multiarch_emit(codegen, "    pushq %%rbp");
+        multiarch_emit(codegen, "    movq %%rsp, %%rbp");
+        for (int i = 0; i < fn->saved_count; i++) {
+            multiarch_emit(codegen, "    pushq %%%s", target->general_regs[fn->saved[i]].name);
+        }
+        if (slot_bytes > 0) {
+            multiarch_emit(codegen, "    subq $%d, %%rsp", slot_bytes);
+        }
     }
 }
 
-void multiarch_codegen_binary_expr(MultiArchCodegen *codegen, struct ASTNode *node) {
-    if (node->type != AST_BINARY_OP) return;
+static void multiarch_ir_epilogue(MultiArchFunction *fn) {
+    MultiArchCodegen *codegen = fn->codegen;
+    const TargetConfig *target = codegen->target;
 
-    // Generate left operand
-    multiarch_codegen_expression(codegen, node->data.binary_expr.left);
-    multiarch_push(codegen, multiarch_get_return_reg(codegen));
-
-    // Generate right operand
-    multiarch_codegen_expression(codegen, node->data.binary_expr.right);
-    const char *right_reg = multiarch_get_return_reg(codegen);
-    const char *temp_reg = multiarch_get_temp_reg(codegen, 0);
-    multiarch_pop(codegen, temp_reg);
-
-    // Perform operation
-    switch (node->data.binary_expr.operator) {
-        case TOKEN_PLUS:
-            multiarch_add(codegen, right_reg, temp_reg, right_reg);
-            break;
-        case TOKEN_MINUS:
-            multiarch_sub(codegen, right_reg, temp_reg, right_reg);
-            break;
-        case TOKEN_CHAR:
-            multiarch_mul(codegen, right_reg, temp_reg, right_reg);
-            break;
-        case TOKEN_DIVIDE:
-            multiarch_div(codegen, right_reg, temp_reg, right_reg);
-            break;
-        default:
-            multiarch_emit_comment(codegen, "Unsupported binary operator");
-            break;
+    multiarch_emit(codegen, "L%d:", fn->epilogue_label);
+    if (multiarch_is_arm64(fn)) {
+        for (int i = 0; i < fn->saved_count; i++) {
+            multiarch_ir_move(fn, multiarch_reg_location(target->general_regs[fn->saved[i]].name),
+                              multiarch_frame_location(fn, 8 * (i + 1)));
+        }
+        multiarch_emit(codegen, "    mov sp, x29");
+        multiarch_emit(codegen, "    ldp x29, x30, [sp], #16");
+    } else {
+        if (fn->saved_count > 0) {
+            multiarch_emit(codegen, "    leaq -%d(%%rbp), %%rsp", fn->saved_count * 8);
+            for (int i = fn->saved_count - 1; i >= 0; i--) {
+                multiarch_emit(codegen, "    popq %%%s", target->general_regs[fn->saved[i]].name);
+            }
+        } else {
+            multiarch_emit(codegen, "    movq %%rbp, %%rsp");
+        }
+        multiarch_emit(codegen, "    popq %%rbp");
     }
+    multiarch_emit(codegen, "    ret");
 }
 
-void multiarch_codegen_return_stmt(MultiArchCodegen *codegen, struct ASTNode *node) {
-    if (node->data.return_stmt.expression) {
-        multiarch_codegen_expression(codegen, node->data.return_stmt.expression);
+// Moves every incoming argument to where the allocation has it once the
+// params at the top of the entry block are all defined
+static void multiarch_ir_params(MultiArchFunction *fn, int position) {
+    const TargetConfig *target = fn->codegen->target;
+    int count = fn->function->param_count;
+    if (count == 0) return;
+
+    MultiArchLocation *to = malloc(sizeof(MultiArchLocation) * (size_t)count);
+    MultiArchLocation *from = malloc(sizeof(MultiArchLocation) * (size_t)count);
+    int moves = 0;
+    for (int i = 0; i < count; i++) {
+        const IRInstr *param = fn->function->params[i];
+        const LiveInterval *last = fn->alloc->intervals[param->id];
+        while (last && last->next) last = last->next;
+        if (!last || last->end < position) continue;
+
+        to[moves] = multiarch_ir_location(fn, param, position);
+        int index = param->data.index;
+        if (index < target->num_param_regs) {
+            from[moves] = multiarch_reg_location(target->param_regs[index]);
+        } else {
+            // Above the saved frame pointer and return address
+            MultiArchLocation stack = {MULTIARCH_LOC_MEM, multiarch_is_arm64(fn) ? "x29" : "rbp",
+                                       16 + 8 * (index - target->num_param_regs), 0};
+            from[moves] = stack;
+        }
+        moves++;
     }
-    multiarch_function_return(codegen, node->data.return_stmt.expression != NULL);
+    multiarch_ir_parallel_move(fn, to, from, moves);
+
+    free(to);
+    free(from);
 }
 
-void multiarch_codegen_call_expr(MultiArchCodegen *codegen, struct ASTNode *node) {
-    if (node->type != AST_FUNCTION_CALL) return;
+// ===== IR INSTRUCTIONS =====
+
+static void multiarch_ir_call(MultiArchFunction *fn, const IRInstr *instr, int use) {
+    MultiArchCodegen *codegen = fn->codegen;
+    const TargetConfig *target = codegen->target;
+    int count = instr->operand_count;
+    int stack_args = count > target->num_param_regs ? count - target->num_param_regs : 0;
+    int stack_bytes = 0;
 
-    // Generate arguments and place in parameter registers
-    // FIX: Changed .arg_count to .argument_count and .args to .arguments
-    for (int i = 0; i < node->data.call_expr.argument_count && i < codegen->target->num_param_regs; i++) {
-        multiarch_codegen_expression(codegen, node->data.call_expr.arguments[i]);
-        const char *param_reg = multiarch_get_param_reg(codegen, i);
-        const char *return_reg = multiarch_get_return_reg(codegen);
+    char symbol[256];
+    if (codegen->target->platform == PLATFORM_MACOS || !is_builtin_function(instr->data.symbol)) {
+        multiarch_symbol(codegen, instr->data.symbol, symbol, sizeof(symbol));
+    } else {
+        snprintf(symbol, sizeof(symbol), "%s", instr->data.symbol);
+    }
 
-        if (strcmp(param_reg, return_reg) != 0) {
-            // Move result to parameter register
-            switch (codegen->target->arch) {
-                case ARCH_X86_64:
-                    multiarch_emit(codegen, "    movq %%%s, %%%s", return_reg, param_reg);
-                    break;
-                case ARCH_ARM64:
-                    multiarch_emit(codegen, "    mov %s, %s", param_reg, return_reg);
-                    break;
-                default:
-                    break;
+    if (stack_args > 0 && multiarch_is_arm64(fn)) {
+        stack_bytes = (stack_args * 8 + 15) & ~15;
+        multiarch_emit(codegen, "    sub sp, sp, #%d", stack_bytes);
+        fn->outgoing += stack_bytes;
+        for (int i = 0; i < stack_args; i++) {
+            MultiArchLocation slot = {MULTIARCH_LOC_MEM, "sp", 8 * i, 0};
+            multiarch_ir_move(fn, slot, multiarch_ir_location(
+                fn, instr->operands[target->num_param_regs + i], use));
+        }
+    } else if (stack_args > 0) {
+        stack_bytes = stack_args * 8;
+        if (stack_args % 2) {
+            multiarch_emit(codegen, "    subq $8, %%rsp");
+            stack_bytes += 8;
+        }
+        for (int i = count - 1; i >= target->num_param_regs; i--) {
+            MultiArchLocation arg = multiarch_ir_location(fn, instr->operands[i], use);
+            if (arg.kind == MULTIARCH_LOC_IMM && !multiarch_fits_imm32(arg.imm)) {
+                multiarch_ir_move(fn, multiarch_reg_location(multiarch_scratch(fn, 0)), arg);
+                arg = multiarch_reg_location(multiarch_scratch(fn, 0));
             }
+            char operand[32];
+            multiarch_emit(codegen, "    pushq %s", multiarch_x86_operand(fn, arg, 8, operand));
         }
     }
-    // FIX: Changed undeclared 'arg_count' to the correct struct member
-    multiarch_function_call(codegen, node->data.call_expr.function_name, node->data.call_expr.argument_count);
-}
 
-void multiarch_codegen_if_stmt(MultiArchCodegen *codegen, struct ASTNode *node) {
-    if (node->type != AST_IF_STATEMENT) return;
+    int reg_args = count - stack_args;
+    if (reg_args > 0) {
+        MultiArchLocation to[16];
+        MultiArchLocation from[16];
+        for (int i = 0; i < reg_args; i++) {
+            to[i] = multiarch_reg_location(target->param_regs[i]);
+            from[i] = multiarch_ir_location(fn, instr->operands[i], use);
+        }
+        multiarch_ir_parallel_move(fn, to, from, reg_args);
+    }
 
-    char *else_label = multiarch_new_label(codegen);
-    char *end_label = multiarch_new_label(codegen);
+    if (multiarch_is_arm64(fn)) {
+        multiarch_emit(codegen, "    bl %s", symbol);
+        if (stack_bytes > 0) {
+            multiarch_emit(codegen, "    add sp, sp, #%d", stack_bytes);
+            fn->outgoing -= stack_bytes;
+        }
+    } else {
+        // No vector registers carry arguments, for variadic callees
+        multiarch_emit(codegen, "    xorl %%eax, %%eax");
+        multiarch_emit(codegen, "    call %s", symbol);
+        if (stack_bytes > 0) {
+            multiarch_emit(codegen, "    addq $%d, %%rsp", stack_bytes);
+        }
+    }
 
-    // Generate condition
-    multiarch_codegen_expression(codegen, node->data.if_stmt.condition);
+    if (instr->id >= 0) {
+        multiarch_ir_move(fn, multiarch_ir_location(fn, instr, use + 1),
+                          multiarch_reg_location(target->return_regs[0]));
+    }
+}
 
-    // Test result and jump to else if false
-    const char *return_reg = multiarch_get_return_reg(codegen);
-    switch (codegen->target->arch) {
-        case ARCH_X86_64:
-            multiarch_emit(codegen, "    testq %%%s, %%%s", return_reg, return_reg);
-            break;
-        case ARCH_ARM64:
-            multiarch_emit(codegen, "    cmp %s, #0", return_reg);
-            break;
-        default:
-            break;
+static const char *multiarch_ir_condition(const MultiArchFunction *fn, IROp op) {
+    bool arm64 = multiarch_is_arm64(fn);
+    switch (op) {
+        case IR_EQ: return arm64 ? "eq" : "e";
+        case IR_NE: return "ne";
+        case IR_LT: return arm64 ? "lt" : "l";
+        case IR_LE: return arm64 ? "le" : "le";
+        case IR_GT: return arm64 ? "gt" : "g";
+        default:    return arm64 ? "ge" : "ge";
     }
+}
 
-    multiarch_jump_if_zero(codegen, else_label);
+// Two-address ALU operation: the result register starts as a copy of lhs
+static void multiarch_x86_binary(MultiArchFunction *fn, const char *mnemonic, const IRInstr *instr,
+                                 int use, bool commutative) {
+    MultiArchCodegen *codegen = fn->codegen;
+    int size = multiarch_ir_width(instr->type);
+    MultiArchLocation dst = multiarch_ir_location(fn, instr, use + 1);
+    MultiArchLocation result = dst.kind == MULTIARCH_LOC_REG
+        ? dst : multiarch_reg_location(multiarch_scratch(fn, 0));
+    MultiArchLocation lhs = multiarch_ir_location(fn, instr->operands[0], use);
+    MultiArchLocation rhs = multiarch_ir_location(fn, instr->operands[1], use);
+
+    // The copy of lhs would overwrite rhs
+    if (multiarch_same_location(rhs, result) && !multiarch_same_location(lhs, result)) {
+        if (commutative) {
+            MultiArchLocation swap = lhs;
+            lhs = rhs;
+            rhs = swap;
+        } else {
+            MultiArchLocation scratch = multiarch_reg_location(multiarch_scratch(fn, 1));
+            multiarch_ir_move(fn, scratch, rhs);
+            rhs = scratch;
+        }
+    }
+    if (rhs.kind == MULTIARCH_LOC_IMM && size == 8 && !multiarch_fits_imm32(rhs.imm)) {
+        MultiArchLocation scratch = multiarch_reg_location(multiarch_scratch(fn, 1));
+        multiarch_ir_move(fn, scratch, rhs);
+        rhs = scratch;
+    }
 
-    // Generate then statement
-    multiarch_codegen_statement(codegen, node->data.if_stmt.then_stmt);
-    multiarch_jump(codegen, end_label);
+    multiarch_ir_move(fn, result, lhs);
+    char source[32];
+    char target[32];
+    multiarch_emit(codegen, "    %s%c %s, %s", mnemonic, size == 8 ? 'q' : 'l',
+                   multiarch_x86_operand(fn, rhs, size, source),
+                   multiarch_x86_operand(fn, result, size, target));
+    multiarch_ir_move(fn, dst, result);
+}
 
-    // Generate else statement
-    multiarch_emit_label(codegen, else_label);
-    if (node->data.if_stmt.else_stmt) {
-        multiarch_codegen_statement(codegen, node->data.if_stmt.else_stmt);
+static void multiarch_x86_instruction(MultiArchFunction *fn, const IRInstr *instr, int use) {
+    MultiArchCodegen *codegen = fn->codegen;
+    int size = multiarch_ir_width(instr->type);
+    char suffix = size == 8 ? 'q' : 'l';
+    MultiArchLocation scratch = multiarch_reg_location(multiarch_scratch(fn, 0));
+    MultiArchLocation scratch2 = multiarch_reg_location(multiarch_scratch(fn, 1));
+    MultiArchLocation dst = scratch;
+    if (instr->id >= 0) {
+        dst = multiarch_ir_location(fn, instr, use + 1);
     }
+    MultiArchLocation result = dst.kind == MULTIARCH_LOC_REG ? dst : scratch;
+    char reg[8];
+    char operand[32];
+    char operand2[32];
+    char symbol[256];
+
+    switch (instr->op) {
+        case IR_ADD: multiarch_x86_binary(fn, "add", instr, use, true); return;
+        case IR_SUB: multiarch_x86_binary(fn, "sub", instr, use, false); return;
+        case IR_MUL: multiarch_x86_binary(fn, "imul", instr, use, true); return;
+        case IR_AND: multiarch_x86_binary(fn, "and", instr, use, true); return;
+        case IR_OR:  multiarch_x86_binary(fn, "or", instr, use, true); return;
+        case IR_XOR: multiarch_x86_binary(fn, "xor", instr, use, true); return;
+
+        case IR_SHL:
+        case IR_SHR: {
+            MultiArchLocation count = multiarch_ir_location(fn, instr->operands[1], use);
+            if (count.kind == MULTIARCH_LOC_IMM) {
+                snprintf(operand, sizeof(operand), "$%ld", count.imm & (size * 8 - 1));
+            } else {
+                multiarch_ir_move(fn, multiarch_reg_location("rcx"), count);
+                snprintf(operand, sizeof(operand), "%%cl");
+            }
+            multiarch_ir_move(fn, result, multiarch_ir_location(fn, instr->operands[0], use));
+            multiarch_emit(codegen, "    %s%c %s, %s", instr->op == IR_SHL ? "sal" : "sar", suffix,
+                           operand, multiarch_x86_operand(fn, result, size, operand2));
+            multiarch_ir_move(fn, dst, result);
+            return;
+        }
 
-    multiarch_emit_label(codegen, end_label);
-
-    free(else_label);
-    free(end_label);
-}
+        case IR_DIV:
+        case IR_MOD: {
+            MultiArchLocation divisor = multiarch_ir_location(fn, instr->operands[1], use);
+            if (divisor.kind == MULTIARCH_LOC_IMM) {
+                multiarch_ir_move(fn, scratch2, divisor);
+                divisor = scratch2;
+            }
+            multiarch_ir_move(fn, scratch, multiarch_ir_location(fn, instr->operands[0], use));
+            multiarch_emit(codegen, size == 8 ? "    cqto" : "    cltd");
+            multiarch_emit(codegen, "    idiv%c %s", suffix,
+                           multiarch_x86_operand(fn, divisor, size, operand));
+            multiarch_ir_move(fn, dst, instr->op == IR_DIV ? scratch : multiarch_reg_location("rdx"));
+            return;
+        }
 
-void multiarch_codegen_while_stmt(MultiArchCodegen *codegen, struct ASTNode *node) {
-    if (node->type != AST_WHILE_STATEMENT) return;
+        case IR_EQ:
+        case IR_NE:
+        case IR_LT:
+        case IR_LE:
+        case IR_GT:
+        case IR_GE: {
+            int width = multiarch_ir_width(instr->operands[0]->type);
+            MultiArchLocation lhs = multiarch_ir_location(fn, instr->operands[0], use);
+            MultiArchLocation rhs = multiarch_ir_location(fn, instr->operands[1], use);
+            if (lhs.kind == MULTIARCH_LOC_IMM ||
+                (lhs.kind == MULTIARCH_LOC_MEM && rhs.kind == MULTIARCH_LOC_MEM)) {
+                multiarch_ir_move(fn, scratch, lhs);
+                lhs = scratch;
+            }
+            if (rhs.kind == MULTIARCH_LOC_IMM && width == 8 && !multiarch_fits_imm32(rhs.imm)) {
+                multiarch_ir_move(fn, scratch2, rhs);
+                rhs = scratch2;
+            }
+            multiarch_emit(codegen, "    cmp%c %s, %s", width == 8 ? 'q' : 'l',
+                           multiarch_x86_operand(fn, rhs, width, operand),
+                           multiarch_x86_operand(fn, lhs, width, operand2));
+            multiarch_emit(codegen, "    set%s %%al", multiarch_ir_condition(fn, instr->op));
+            multiarch_emit(codegen, "    movzbl %%al, %%%s", multiarch_sized_reg(fn, result.reg, 4, reg));
+            multiarch_ir_move(fn, dst, result);
+            return;
+        }
 
-    char *loop_label = multiarch_new_label(codegen);
-    char *end_label = multiarch_new_label(codegen);
+        case IR_NEG:
+        case IR_BITNOT:
+            multiarch_ir_move(fn, result, multiarch_ir_location(fn, instr->operands[0], use));
+            multiarch_emit(codegen, "    %s%c %%%s", instr->op == IR_NEG ? "neg" : "not", suffix,
+                           multiarch_sized_reg(fn, result.reg, size, reg));
+            multiarch_ir_move(fn, dst, result);
+            return;
+
+        case IR_CONVERT: {
+            const IRInstr *source = instr->operands[0];
+            int from = ir_type_size(source->type);
+            int to = ir_type_size(instr->type);
+            MultiArchLocation value = multiarch_ir_location(fn, source, use);
+            if (value.kind == MULTIARCH_LOC_IMM) {
+                long converted = to == 1 ? (int8_t)value.imm : to == 2 ? (int16_t)value.imm
+                               : to == 4 ? (int32_t)value.imm : value.imm;
+                value.imm = converted;
+                multiarch_ir_move(fn, dst, value);
+                return;
+            }
+            // Sign-extend from the narrower of the two sizes
+            int extend = from < to ? from : to;
+            const char *text = multiarch_x86_operand(fn, value, extend, operand);
+            const char *target = multiarch_x86_operand(fn, result, size, operand2);
+            if (extend == 1) {
+                multiarch_emit(codegen, "    movsb%c %s, %s", suffix, text, target);
+            } else if (extend == 2) {
+                multiarch_emit(codegen, "    movsw%c %s, %s", suffix, text, target);
+            } else if (extend == 4 && size == 8) {
+                multiarch_emit(codegen, "    movslq %s, %s", text, target);
+            } else {
+                multiarch_emit(codegen, "    mov%c %s, %s", suffix, text, target);
+            }
+            multiarch_ir_move(fn, dst, result);
+            return;
+        }
 
-    multiarch_emit_label(codegen, loop_label);
+        case IR_GLOBAL_ADDR:
+            multiarch_symbol(codegen, instr->data.symbol, symbol, sizeof(symbol));
+            multiarch_emit(codegen, "    leaq %s(%%rip), %%%s", symbol, result.reg);
+            multiarch_ir_move(fn, dst, result);
+            return;
+
+        case IR_LOAD: {
+            MultiArchLocation address = multiarch_ir_location(fn, instr->operands[0], use);
+            if (address.kind != MULTIARCH_LOC_REG) {
+                multiarch_ir_move(fn, scratch2, address);
+                address = scratch2;
+            }
+            int bytes = ir_type_size(instr->type);
+            const char *target = multiarch_x86_operand(fn, result, size, operand2);
+            const char *mnemonic = bytes == 1 ? "movsbl" : bytes == 2 ? "movswl"
+                                 : bytes == 8 ? "movq" : "movl";
+            multiarch_emit(codegen, "    %s (%%%s), %s", mnemonic, address.reg, target);
+            multiarch_ir_move(fn, dst, result);
+            return;
+        }
 
-    // Generate condition
-    multiarch_codegen_expression(codegen, node->data.while_stmt.condition);
+        case IR_STORE: {
+            MultiArchLocation address = multiarch_ir_location(fn, instr->operands[0], use);
+            MultiArchLocation value = multiarch_ir_location(fn, instr->operands[1], use);
+            int bytes = ir_type_size(instr->operands[1]->type);
+            if (address.kind != MULTIARCH_LOC_REG) {
+                multiarch_ir_move(fn, scratch2, address);
+                address = scratch2;
+            }
+            if (value.kind == MULTIARCH_LOC_MEM ||
+                (value.kind == MULTIARCH_LOC_IMM && !multiarch_fits_imm32(value.imm))) {
+                multiarch_ir_move(fn, scratch, value);
+                value = scratch;
+            }
+            char width = bytes == 1 ? 'b' : bytes == 2 ? 'w' : bytes == 8 ? 'q' : 'l';
+            multiarch_emit(codegen, "    mov%c %s, (%%%s)", width,
+                           multiarch_x86_operand(fn, value, bytes, operand), address.reg);
+            return;
+        }
 
-    // Test and jump if false
-    const char *return_reg = multiarch_get_return_reg(codegen);
-    switch (codegen->target->arch) {
-        case ARCH_X86_64:
-            multiarch_emit(codegen, "    testq %%%s, %%%s", return_reg, return_reg);
-            break;
-        case ARCH_ARM64:
-            multiarch_emit(codegen, "    cmp %s, #0", return_reg);
-            break;
         default:
-            break;
+            multiarch_emit_comment(codegen, "Unsupported IR operation");
+            return;
     }
+}
 
-    multiarch_jump_if_zero(codegen, end_label);
+// Register holding location at size bytes, loading it into scratch first
+// when it is not in one already
+static const char *multiarch_arm64_read(MultiArchFunction *fn, MultiArchLocation location,
+                                        int size, const char *scratch, char buffer[8]) {
+    if (location.kind == MULTIARCH_LOC_IMM && location.imm == 0) {
+        return size == 8 ? "xzr" : "wzr";
+    }
+    if (location.kind != MULTIARCH_LOC_REG) {
+        multiarch_ir_move(fn, multiarch_reg_location(scratch), location);
+        location.reg = scratch;
+    }
+    return multiarch_sized_reg(fn, location.reg, size, buffer);
+}
 
-    // Generate body
-    multiarch_codegen_statement(codegen, node->data.while_stmt.body);
-    multiarch_jump(codegen, loop_label);
+static void multiarch_arm64_instruction(MultiArchFunction *fn, const IRInstr *instr, int use) {
+    MultiArchCodegen *codegen = fn->codegen;
+    int size = multiarch_ir_width(instr->type);
+    const char *scratch = multiarch_scratch(fn, 0);
+    const char *scratch2 = multiarch_scratch(fn, 1);
+    MultiArchLocation dst = multiarch_reg_location(scratch);
+    if (instr->id >= 0) {
+        dst = multiarch_ir_location(fn, instr, use + 1);
+    }
+    MultiArchLocation result = dst.kind == MULTIARCH_LOC_REG ? dst : multiarch_reg_location(scratch);
+    char target[8];
+    char lhs_reg[8];
+    char rhs_reg[8];
+    char symbol[256];
+    const char *out = multiarch_sized_reg(fn, result.reg, size, target);
+    const char *mnemonic = NULL;
+
+    switch (instr->op) {
+        case IR_ADD: mnemonic = "add"; break;
+        case IR_SUB: mnemonic = "sub"; break;
+        case IR_MUL: mnemonic = "mul"; break;
+        case IR_DIV: mnemonic = "sdiv"; break;
+        case IR_AND: mnemonic = "and"; break;
+        case IR_OR:  mnemonic = "orr"; break;
+        case IR_XOR: mnemonic = "eor"; break;
+        case IR_SHL: mnemonic = "lsl"; break;
+        case IR_SHR: mnemonic = "asr"; break;
+        default: break;
+    }
 
-    multiarch_emit_label(codegen, end_label);
+    if (mnemonic || instr->op == IR_MOD) {
+        MultiArchLocation lhs = multiarch_ir_location(fn, instr->operands[0], use);
+        MultiArchLocation rhs = multiarch_ir_location(fn, instr->operands[1], use);
+        const char *a = multiarch_arm64_read(fn, lhs, size, scratch, lhs_reg);
+        char immediate[32];
+        const char *b;
+        bool small = rhs.kind == MULTIARCH_LOC_IMM && rhs.imm >= 0 && rhs.imm < 4096;
+        if (small && (instr->op == IR_ADD || instr->op == IR_SUB)) {
+            snprintf(immediate, sizeof(immediate), "#%ld", rhs.imm);
+            b = immediate;
+        } else if (rhs.kind == MULTIARCH_LOC_IMM && (instr->op == IR_SHL || instr->op == IR_SHR)) {
+            snprintf(immediate, sizeof(immediate), "#%ld", rhs.imm & (size * 8 - 1));
+            b = immediate;
+        } else {
+            b = multiarch_arm64_read(fn, rhs, size, scratch2, rhs_reg);
+        }
 
-    free(loop_label);
-    free(end_label);
-}
+        if (instr->op == IR_MOD) {
+            // a - (a / b) * b, the quotient in the third scratch register
+            char quotient[8];
+            const char *q = multiarch_sized_reg(fn, multiarch_scratch(fn, 2), size, quotient);
+            multiarch_emit(codegen, "    sdiv %s, %s, %s", q, a, b);
+            multiarch_emit(codegen, "    msub %s, %s, %s, %s", out, q, b, a);
+        } else {
+            multiarch_emit(codegen, "    %s %s, %s, %s", mnemonic, out, a, b);
+        }
+        multiarch_ir_move(fn, dst, result);
+        return;
+    }
 
-void multiarch_stack_alloc(MultiArchCodegen *codegen, int bytes) {
-    // Align to stack alignment
-    bytes = (bytes + codegen->target->stack_alignment - 1) & ~(codegen->target->stack_alignment - 1);
+    switch (instr->op) {
+        case IR_EQ:
+        case IR_NE:
+        case IR_LT:
+        case IR_LE:
+        case IR_GT:
+        case IR_GE: {
+            int width = multiarch_ir_width(instr->operands[0]->type);
+            MultiArchLocation rhs = multiarch_ir_location(fn, instr->operands[1], use);
+            const char *a = multiarch_arm64_read(
+                fn, multiarch_ir_location(fn, instr->operands[0], use), width, scratch, lhs_reg);
+            if (rhs.kind == MULTIARCH_LOC_IMM && rhs.imm >= 0 && rhs.imm < 4096) {
+                multiarch_emit(codegen, "    cmp %s, #%ld", a, rhs.imm);
+            } else {
+                multiarch_emit(codegen, "    cmp %s, %s", a,
+                               multiarch_arm64_read(fn, rhs, width, scratch2, rhs_reg));
+            }
+            multiarch_emit(codegen, "    cset %s, %s", multiarch_sized_reg(fn, result.reg, 4, target),
+                           multiarch_ir_condition(fn, instr->op));
+            break;
+        }
 
-    switch (codegen->target->arch) {
-        case ARCH_X86_64:
-            multiarch_emit(codegen, "    subq $%d, %%rsp", bytes);
+        case IR_NEG:
+        case IR_BITNOT:
+            multiarch_emit(codegen, "    %s %s, %s", instr->op == IR_NEG ? "neg" : "mvn", out,
+                           multiarch_arm64_read(fn, multiarch_ir_location(fn, instr->operands[0], use),
+                                                size, scratch, lhs_reg));
+            break;
+
+        case IR_CONVERT: {
+            const IRInstr *source = instr->operands[0];
+            int from = ir_type_size(source->type);
+            int to = ir_type_size(instr->type);
+            int extend = from < to ? from : to;
+            MultiArchLocation value = multiarch_ir_location(fn, source, use);
+            if (value.kind == MULTIARCH_LOC_IMM) {
+                value.imm = to == 1 ? (int8_t)value.imm : to == 2 ? (int16_t)value.imm
+                          : to == 4 ? (int32_t)value.imm : value.imm;
+                multiarch_ir_move(fn, dst, value);
+                return;
+            }
+            const char *in = multiarch_arm64_read(fn, value, extend == 8 ? 8 : 4, scratch, lhs_reg);
+            if (extend == 1 || extend == 2 || (extend == 4 && size == 8)) {
+                multiarch_emit(codegen, "    sxt%c %s, %s", extend == 1 ? 'b' : extend == 2 ? 'h' : 'w',
+                               out, in);
+            } else {
+                multiarch_emit(codegen, "    mov %s, %s", out, in);
+            }
             break;
-        case ARCH_ARM64:
-            multiarch_emit(codegen, "    sub sp, sp, #%d", bytes);
+        }
+
+        case IR_GLOBAL_ADDR:
+            multiarch_symbol(codegen, instr->data.symbol, symbol, sizeof(symbol));
+            if (codegen->target->platform == PLATFORM_MACOS) {
+                multiarch_emit(codegen, "    adrp %s, %s@PAGE", result.reg, symbol);
+                multiarch_emit(codegen, "    add %s, %s, %s@PAGEOFF", result.reg, result.reg, symbol);
+            } else {
+                multiarch_emit(codegen, "    adrp %s, %s", result.reg, symbol);
+                multiarch_emit(codegen, "    add %s, %s, :lo12:%s", result.reg, result.reg, symbol);
+            }
             break;
-        default:
+
+        case IR_LOAD: {
+            int bytes = ir_type_size(instr->type);
+            const char *address = multiarch_arm64_read(
+                fn, multiarch_ir_location(fn, instr->operands[0], use), 8, scratch2, rhs_reg);
+            const char *load = bytes == 1 ? "ldrsb" : bytes == 2 ? "ldrsh" : "ldr";
+            multiarch_emit(codegen, "    %s %s, [%s]", load, out, address);
             break;
-    }
-}
+        }
 
-void multiarch_stack_dealloc(MultiArchCodegen *codegen, int bytes) {
-    // Align to stack alignment
-    bytes = (bytes + codegen->target->stack_alignment - 1) & ~(codegen->target->stack_alignment - 1);
+        case IR_STORE: {
+            int bytes = ir_type_size(instr->operands[1]->type);
+            const char *address = multiarch_arm64_read(
+                fn, multiarch_ir_location(fn, instr->operands[0], use), 8, scratch2, rhs_reg);
+            const char *value = multiarch_arm64_read(
+                fn, multiarch_ir_location(fn, instr->operands[1], use), bytes == 8 ? 8 : 4,
+                scratch, lhs_reg);
+            const char *store = bytes == 1 ? "strb" : bytes == 2 ? "strh" : "str";
+            multiarch_emit(codegen, "    %s %s, [%s]", store, value, address);
+            return;
+        }
 
-    switch (codegen->target->arch) {
-        case ARCH_X86_64:
-            multiarch_emit(codegen, "    addq $%d, %%rsp", bytes);
-            break;
-        case ARCH_ARM64:
-            multiarch_emit(codegen, "    add sp, sp, #%d", bytes);
-            break;
         default:
-            break;
+            multiarch_emit_comment(codegen, "Unsupported IR operation");
+            return;
+    }
+    multiarch_ir_move(fn, dst, result);
 }
 
+static void multiarch_ir_branch(MultiArchFunction *fn, const IRBlock *block, const IRInstr *instr,
+                                int use) {
+    MultiArchCodegen *codegen = fn->codegen;
+    const IRBlock *taken = instr->data.targets[0];
+    const IRBlock *not_taken = instr->data.targets[1];
+    MultiArchLocation condition = multiarch_ir_location(fn, instr->operands[0], use);
+
+    if (condition.kind == MULTIARCH_LOC_IMM) {
+        const IRBlock *succ = condition.imm ? taken : not_taken;
+        int label = multiarch_ir_branch_target(fn, block, succ);
+        if (label != fn->label_base + succ->id || block->next != succ) {
+            multiarch_ir_jump(fn, label);
+        }
+        return;
+    }
 
+    int taken_label = multiarch_ir_branch_target(fn, block, taken);
+    int not_taken_label = multiarch_ir_branch_target(fn, block, not_taken);
+    int width = multiarch_ir_width(instr->operands[0]->type);
+    bool falls_through = not_taken_label == fn->label_base + not_taken->id &&
+                         block->next == not_taken;
+
+    if (multiarch_is_arm64(fn)) {
+        char reg[8];
+        multiarch_emit(codegen, "    cbnz %s, L%d",
+                       multiarch_arm64_read(fn, condition, width, multiarch_scratch(fn, 0), reg),
+                       taken_label);
+    } else {
+        char operand[32];
+        if (condition.kind == MULTIARCH_LOC_REG) {
+            multiarch_x86_operand(fn, condition, width, operand);
+            multiarch_emit(codegen, "    test%c %s, %s", width == 8 ? 'q' : 'l', operand, operand);
+        } else {
+            multiarch_emit(codegen, "    cmp%c $0, %s", width == 8 ? 'q' : 'l',
+                           multiarch_x86_operand(fn, condition, width, operand));
+        }
+        multiarch_emit(codegen, "    jne L%d", taken_label);
+    }
+    if (!falls_through) {
+        multiarch_ir_jump(fn, not_taken_label);
+    }
 }
-void multiarch_codegen_switch_stmt(MultiArchCodegen *codegen, struct ASTNode *node) {
-    if (node->type != AST_SWITCH_STATEMENT) return;
 
-    // Generate switch expression
-    multiarch_codegen_expression(codegen, node->data.switch_stmt.expression);
-    const char *switch_reg = multiarch_get_return_reg(codegen);
-
-    // Create labels
-    char *end_label = multiarch_new_label(codegen);
-    char **case_labels = malloc(sizeof(char*) * node->data.switch_stmt.case_count);
+// Moves the allocator placed before the instruction at index
+static void multiarch_ir_split_moves(MultiArchFunction *fn, int *next_move, int index) {
+    const RegAllocation *alloc = fn->alloc;
+    while (*next_move < alloc->move_count && alloc->moves[*next_move].position / 2 <= index) {
+        const RegMove *move = &alloc->moves[(*next_move)++];
+        if (move->position / 2 == index) {
+            multiarch_ir_move(fn, multiarch_ir_place(fn, move->to), multiarch_ir_place(fn, move->from));
+        }
+    }
+}
 
-    // Generate labels for each case
-    for (int i = 0; i < node->data.switch_stmt.case_count; i++) {
-        case_labels[i] = multiarch_new_label(codegen);
+static void multiarch_ir_block(MultiArchFunction *fn, const IRBlock *block, int *index,
+                               int *next_move) {
+    MultiArchCodegen *codegen = fn->codegen;
+    const TargetConfig *target = codegen->target;
+    multiarch_emit(codegen, "L%d:", fn->label_base + block->id);
+
+    // A branch into a block it alone reaches leaves the edge's moves here
+    if (block->pred_count == 1) {
+        IRBlock *succs[2];
+        if (ir_block_successors(block->preds[0], succs) > 1) {
+            multiarch_ir_edge_moves(fn, block->preds[0], block);
+        }
     }
 
-    // Generate comparison code for each case
-    for (int i = 0; i < node->data.switch_stmt.case_count; i++) {
-        ASTNode *case_node = node->data.switch_stmt.cases[i];
+    for (const IRInstr *instr = block->first; instr; instr = instr->next, (*index)++) {
+        int use = *index * 2;
+        multiarch_ir_split_moves(fn, next_move, *index);
+        if (instr->type == IR_TYPE_F32 || instr->type == IR_TYPE_F64) {
+            multiarch_emit_comment(codegen, "Unsupported floating-point IR value");
+            continue;
+        }
+
+        switch (instr->op) {
+            case IR_CONST:
+            case IR_PARAM:
+            case IR_UNDEF:
+            case IR_PHI:
+                break;
+
+            case IR_CALL:
+                multiarch_ir_call(fn, instr, use);
+                break;
 
-        if (!case_node->data.case_stmt.is_default) {
-            // Compare switch value with case value
-            multiarch_codegen_expression(codegen, case_node->data.case_stmt.value);
-            const char *case_reg = multiarch_get_temp_reg(codegen, 1);
+            case IR_RET:
+                if (instr->operand_count > 0) {
+                    multiarch_ir_move(fn, multiarch_reg_location(target->return_regs[0]),
+                                      multiarch_ir_location(fn, instr->operands[0], use));
+                }
+                if (block->next) {
+                    multiarch_ir_jump(fn, fn->epilogue_label);
+                }
+                break;
 
-            switch (codegen->target->arch) {
-                case ARCH_X86_64:
-                    multiarch_emit(codegen, "    movq %%%s, %%%s",
-                                 multiarch_get_return_reg(codegen), case_reg);
-                    multiarch_emit(codegen, "    cmpq %%%s, %%%s", case_reg, switch_reg);
-                    break;
-                case ARCH_ARM64:
-                    multiarch_emit(codegen, "    mov %s, %s",
-                                 case_reg, multiarch_get_return_reg(codegen));
-                    multiarch_emit(codegen, "    cmp %s, %s", switch_reg, case_reg);
-                    break;
-                default:
-                    break;
+            case IR_JUMP: {
+                const IRBlock *succ = instr->data.targets[0];
+                multiarch_ir_edge_moves(fn, block, succ);
+                if (block->next != succ) {
+                    multiarch_ir_jump(fn, fn->label_base + succ->id);
+                }
+                break;
             }
 
-            multiarch_jump_if_equal(codegen, case_labels[i]);
-        }
-    }
+            case IR_BRANCH: {
+                IRBlock *succs[2];
+                if (ir_block_successors(block, succs) == 1) {
+                    multiarch_ir_edge_moves(fn, block, succs[0]);
+                    if (block->next != succs[0]) {
+                        multiarch_ir_jump(fn, fn->label_base + succs[0]->id);
+                    }
+                } else {
+                    multiarch_ir_branch(fn, block, instr, use);
+                }
+                break;
+            }
 
-    // Jump to default case if present, otherwise jump to end
-    int default_index = -1;
-    for (int i = 0; i < node->data.switch_stmt.case_count; i++) {
-        if (node->data.switch_stmt.cases[i]->data.case_stmt.is_default) {
-            default_index = i;
-            break;
+            default:
+                if (multiarch_is_arm64(fn)) {
+                    multiarch_arm64_instruction(fn, instr, use);
+                } else {
+                    multiarch_x86_instruction(fn, instr, use);
+                }
+                break;
         }
     }
+}
 
-    if (default_index >= 0) {
-        multiarch_jump(codegen, case_labels[default_index]);
-    } else {
-        multiarch_jump(codegen, end_label);
+void multiarch_codegen_ir_function(MultiArchCodegen *codegen, const IRFunction *function) {
+    const TargetConfig *target = codegen->target;
+    RegAllocation *alloc = regalloc_function(function, target, multiarch_reserved_registers(target));
+    if (!alloc) {
+        fprintf(stderr, "Error: Failed to allocate registers for function '%s'\n", function->name);
+        return;
     }
 
-    // Generate code for each case
-    for (int i = 0; i < node->data.switch_stmt.case_count; i++) {
-        ASTNode *case_node = node->data.switch_stmt.cases[i];
-
-        multiarch_emit_label(codegen, case_labels[i]);
-
-        // Generate statements for this case
-        for (int j = 0; j < case_node->data.case_stmt.statement_count; j++) {
-            multiarch_codegen_statement(codegen, case_node->data.case_stmt.statements[j]);
+    MultiArchFunction fn = {0};
+    fn.codegen = codegen;
+    fn.function = function;
+    fn.alloc = alloc;
+    fn.label_base = codegen->label_counter;
+    codegen->label_counter += function->block_count;
+    fn.epilogue_label = codegen->label_counter++;
+    for (int r = 0; r < target->num_general_regs && r < 64; r++) {
+        if ((alloc->used_callee_saved >> r) & 1) {
+            fn.saved[fn.saved_count++] = r;
         }
     }
 
-    multiarch_emit_label(codegen, end_label);
+    multiarch_ir_prologue(&fn);
 
-    // Clean up
-    for (int i = 0; i < node->data.switch_stmt.case_count; i++) {
-        free(case_labels[i]);
+    // Arguments land where the params are once the last of them is defined;
+    // the allocator's own moves among the params are subsumed by that
+    int index = 0;
+    int next_move = 0;
+    const IRInstr *instr = function->entry->first;
+    while (instr && instr->op == IR_PARAM) {
+        instr = instr->next;
+        index++;
+    }
+    if (index > 0) {
+        multiarch_ir_params(&fn, index * 2 - 1);
+        while (next_move < alloc->move_count && alloc->moves[next_move].position < index * 2) {
+            next_move++;
+        }
     }
-    free(case_labels);
-    free(end_label);
-}
-
-void multiarch_codegen_call_expr(MultiArchCodegen *codegen, struct ASTNode *node) {
-    if (node->type != AST_FUNCTION_CALL) return;
 
-    const char *func_name = node->data.call_expr.function_name;
-    int arg_count = node->data.call_expr.argument_count;
+    index = 0;
+    for (const IRBlock *block = function->entry; block; block = block->next) {
+        multiarch_ir_block(&fn, block, &index, &next_move);
+    }
 
-    // Check if this is a built-in function
-    bool is_builtin = is_builtin_function(func_name);
+    multiarch_ir_epilogue(&fn);
 
-    if (is_builtin) {
-        multiarch_emit_comment(codegen, "Call to standard library function");
-        char comment[128];
-        snprintf(comment, sizeof(comment), "Function: %s", func_name);
-        multiarch_emit_comment(codegen, comment);
+    for (int i = 0; i < fn.stub_count; i++) {
+        multiarch_emit(codegen, "L%d:", fn.stubs[i].label);
+        multiarch_ir_edge_moves(&fn, fn.stubs[i].pred, fn.stubs[i].succ);
+        multiarch_ir_jump(&fn, fn.label_base + fn.stubs[i].succ->id);
     }
 
-    // Generate arguments and place in parameter registers
-    for (int i = 0; i < arg_count && i < codegen->target->num_param_regs; i++) {
-        multiarch_codegen_expression(codegen, node->data.call_expr.arguments[i]);
-        const char *param_reg = multiarch_get_param_reg(codegen, i);
-        const char *return_reg = multiarch_get_return_reg(codegen);
+    free(fn.stubs);
+    regalloc_destroy(alloc);
+}
 
-        if (strcmp(param_reg, return_reg) != 0) {
-            // Move result to parameter register
-            switch (codegen->target->arch) {
-            case ARCH_X86_64:
-                multiarch_emit(codegen, "    movq %%%s, %%%s", return_reg, param_reg);
-                break;
-            case ARCH_ARM64:
-                multiarch_emit(codegen, "    mov %s, %s", param_reg, return_reg);
-                break;
-            default:
-                break;
-            }
+void multiarch_codegen_ir_globals(MultiArchCodegen *codegen, const IRModule *module) {
+    if (!module->globals) return;
+
+    multiarch_emit(codegen, "");
+    multiarch_emit_directive(codegen, codegen->target->section_data, NULL);
+    for (const IRGlobal *global = module->globals; global; global = global->next) {
+        char symbol[256];
+        multiarch_symbol(codegen, global->name, symbol, sizeof(symbol));
+        if (global->string) {
+            multiarch_emit_label(codegen, symbol);
+            multiarch_emit(codegen, "    .asciz \"%s\"", global->string);
+            continue;
         }
-    }
 
-    // For macOS, prepend underscore to external symbols
-    char mangled_name[256];
-    if (codegen->target->platform == PLATFORM_MACOS && is_builtin) {
-        snprintf(mangled_name, sizeof(mangled_name), "_%s", func_name);
-    } else {
-        snprintf(mangled_name, sizeof(mangled_name), "%s", func_name);
+        int size = ir_type_size(global->type);
+        if (size <= 0) size = 8;
+        multiarch_emit_directive(codegen, codegen->target->global_directive, symbol);
+        multiarch_emit(codegen, "    .balign %d", size);
+        multiarch_emit_label(codegen, symbol);
+        const char *directive = size == 1 ? ".byte" : size == 2 ? ".short"
+                              : size == 4 ? ".long" : ".quad";
+        multiarch_emit(codegen, "    %s %lld", directive,
+                       global->has_initializer ? (long long)global->initializer : 0LL);
     }
-
-    multiarch_function_call(codegen, mangled_name, arg_count);
 }
@@ -9,23 +9,62 @@ Parser *parser_create(Lexer *lexer) {
         return NULL;
     }
 
+    memset(parser, 0, sizeof(Parser));
     parser->lexer = lexer;
-    parser->current_token = lexer_next_token(lexer);
-    parser->peek_token = lexer_next_token(lexer);
+    parser->tokens = lexer_tokenize(lexer, &parser->token_count);
     parser->objc_mode = false; // Default to C mode
 
+    if (!parser->tokens) {
+        free(parser);
+        return NULL;
+    }
+
+    parser_rewind(parser, 0);
     return parser;
 }
 
 void parser_destroy(Parser *parser) {
     if (parser) {
+        free(parser->tokens);
         free(parser);
     }
 }
 
 void parser_advance(Parser *parser) {
-    parser->current_token = parser->peek_token;
-    parser->peek_token = lexer_next_token(parser->lexer);
+    // The trailing TOKEN_EOF is sticky
+    if (parser->token_index + 1 < parser->token_count) {
+        parser_rewind(parser, parser->token_index + 1);
+    }
+}
+
+Token parser_peek(Parser *parser, size_t ahead) {
+    size_t index = parser->token_index + ahead;
+    if (index >= parser->token_count) {
+        index = parser->token_count - 1;
+    }
+    return parser->tokens[index];
+}
+
+size_t parser_mark(Parser *parser) {
+    return parser->token_index;
+}
+
+void parser_rewind(Parser *parser, size_t mark) {
+    if (mark >= parser->token_count) {
+        mark = parser->token_count - 1;
+    }
+    parser->token_index = mark;
+    parser->current_token = parser->tokens[mark];
+    parser->peek_token = parser_peek(parser, 1);
+}
+
+// Gives node the position of token, for diagnostics reported after parsing
+static ASTNode *parser_at(ASTNode *node, const Token *token) {
+    if (node) {
+        node->line = token->line;
+        node->column = token->column;
+    }
+    return node;
 }
 
 bool parser_match(Parser *parser, TokenType type) {
@@ -92,47 +131,43 @@ DataType token_type_to_data_type(TokenType type) {
     }
 }
 
+// Error recovery: skip past the construct that failed to parse. Stops after
+// a ';' or a closing '}' at nesting depth 0, or before the next token that
+// can start a top-level declaration. Always consumes at least one token.
+void parser_synchronize(Parser *parser) {
+    int depth = 0;
+
+    do {
+        TokenType type = parser->current_token.type;
+        parser_advance(parser);
+
+        if (type == TOKEN_LBRACE) {
+            depth++;
+        } else if (type == TOKEN_RBRACE && depth > 0) {
+            if (--depth == 0) return;
+        } else if (type == TOKEN_SEMICOLON && depth == 0) {
+            return;
+        }
+    } while (!parser_match(parser, TOKEN_EOF) &&
+             (depth > 0 ||
+              (!parser_is_type_specifier(parser->current_token.type) &&
+               !parser_is_objc_directive(parser->current_token.type))));
+}
+
 ASTNode *parser_parse_program(Parser *parser) {
     ASTNode *program = ast_create_program();
-    int last_line = -1;
-    int last_column = -1;
-    int stuck_count = 0;
 
     while (!parser_match(parser, TOKEN_EOF)) {
-        // Prevent infinite loops on same position
-        if (parser->current_token.line == last_line &&
-            parser->current_token.column == last_column) {
-            stuck_count++;
-            if (stuck_count > 10) {
-                fprintf(stderr, "Error: Parser stuck at line %d, column %d with token type %d. Skipping to next line.\n",
-                       parser->current_token.line, parser->current_token.column, parser->current_token.type);
-
-                // Force advance until we get to a different line or EOF
-                int current_line = parser->current_token.line;
-                while (parser->current_token.line == current_line &&
-                       !parser_match(parser, TOKEN_EOF)) {
-                    parser_advance(parser);
-                }
-                stuck_count = 0;
-                last_line = -1;
-                last_column = -1;
-                continue;
-            }
-        } else {
-            last_line = parser->current_token.line;
-            last_column = parser->current_token.column;
-            stuck_count = 0;
-        }
-
         // Skip any UNKNOWN tokens with better error reporting
         if (parser->current_token.type == TOKEN_UNKNOWN) {
             fprintf(stderr, "Warning: Skipping unknown token at line %d, column %d: '%.20s'\n",
                    parser->current_token.line, parser->current_token.column,
-                   parser->current_token.value ? parser->current_token.value : "");
+                   lexer_token_text(parser->lexer, &parser->current_token));
             parser_advance(parser);
             continue;
         }
 
+        size_t start = parser_mark(parser);
         ASTNode *declaration = NULL;
 
         // Check for Objective-C directives first
@@ -140,40 +175,15 @@ ASTNode *parser_parse_program(Parser *parser) {
             parser->objc_mode = true;
             declaration = parser_parse_objc_declaration(parser);
         } else {
-            declaration = parser_parse_declaration_extended(parser);        }
+            declaration = parser_parse_declaration_extended(parser);
+        }
 
         if (declaration) {
             ast_add_declaration(program, declaration);
         } else {
-            // Skip to next potential declaration with safety check
-            int skip_line = parser->current_token.line;
-            int skip_column = parser->current_token.column;
-            int skip_attempts = 0;
-
-            while (!parser_match(parser, TOKEN_EOF) &&
-                   !parser_is_type_specifier(parser->current_token.type) &&
-                   !parser_is_objc_directive(parser->current_token.type)) {
-                parser_advance(parser);
-                skip_attempts++;
-
-                // Don't get stuck skipping on the same position
-                if (parser->current_token.line != skip_line ||
-                    parser->current_token.column != skip_column) {
-                    break;
-                }
-
-                // Safety valve - don't skip forever
-                if (skip_attempts > 50) {
-                    fprintf(stderr, "Warning: Excessive skipping at line %d, column %d. Moving to next line.\n",
-                           skip_line, skip_column);
-                    // Force move to next line
-                    while (parser->current_token.line == skip_line &&
-                           !parser_match(parser, TOKEN_EOF)) {
-                        parser_advance(parser);
-                    }
-                    break;
-                }
-            }
+            // Go back to where the declaration started and resume after it
+            parser_rewind(parser, start);
+            parser_synchronize(parser);
         }
     }
 
@@ -202,14 +212,13 @@ ASTNode *parser_parse_declaration(Parser *parser) {
         return NULL;
     }
 
-    char *name = strdup(parser->current_token.value);
+    const char *name = parser->current_token.value;
     parser_advance(parser);
 
     // Check what comes after the identifier
     if (parser->current_token.type == TOKEN_LPAREN) {
         // This is a function (declaration or definition)
         ASTNode *result = parser_parse_function(parser, data_type, name);
-        free(name);
         return result;
     } else if (parser->current_token.type == TOKEN_SEMICOLON) {
         // This is a variable declaration
@@ -217,7 +226,6 @@ ASTNode *parser_parse_declaration(Parser *parser) {
         ASTNode *result = parser_create_variable_declaration_with_qualifiers(
             data_type, name, qualifiers
         );
-        free(name);
         return result;
     } else if (parser->current_token.type == TOKEN_ASSIGN) {
         // Variable declaration with initialization
@@ -231,11 +239,9 @@ ASTNode *parser_parse_declaration(Parser *parser) {
         if (result) {
             result->data.var_decl.initializer = initializer;
         }
-        free(name);
         return result;
     } else {
         // Handle error gracefully
-        free(name);
         return NULL;
     }
 }
@@ -285,15 +291,15 @@ ASTNode *parser_parse_objc_interface(Parser *parser) {
         return NULL;
     }
 
-    char *class_name = strdup(parser->current_token.value);
+    const char *class_name = parser->current_token.value;
     parser_advance(parser);
 
     // Parse optional superclass
-    char *superclass_name = NULL;
+    const char *superclass_name = NULL;
     if (parser_match(parser, TOKEN_COLON)) {
         parser_advance(parser);
         if (parser_match(parser, TOKEN_IDENTIFIER)) {
-            superclass_name = strdup(parser->current_token.value);
+            superclass_name = parser->current_token.value;
             parser_advance(parser);
         }
     }
@@ -342,8 +348,6 @@ ASTNode *parser_parse_objc_interface(Parser *parser) {
 
     parser_expect(parser, TOKEN_AT_END);
 
-    free(class_name);
-    if (superclass_name) free(superclass_name);
     return interface;
 }
 
@@ -356,15 +360,15 @@ ASTNode *parser_parse_objc_implementation(Parser *parser) {
         return NULL;
     }
 
-    char *class_name = strdup(parser->current_token.value);
+    const char *class_name = parser->current_token.value;
     parser_advance(parser);
 
     // Parse optional category name (ClassName)
-    char *category_name = NULL;
+    const char *category_name = NULL;
     if (parser_match(parser, TOKEN_LPAREN)) {
         parser_advance(parser);
         if (parser_match(parser, TOKEN_IDENTIFIER)) {
-            category_name = strdup(parser->current_token.value);
+            category_name = parser->current_token.value;
             parser_advance(parser);
         }
         parser_expect(parser, TOKEN_RPAREN);
@@ -396,8 +400,6 @@ ASTNode *parser_parse_objc_implementation(Parser *parser) {
 
     parser_expect(parser, TOKEN_AT_END);
 
-    free(class_name);
-    if (category_name) free(category_name);
     return implementation;
 }
 
@@ -573,13 +575,12 @@ ASTNode *parser_parse_objc_property(Parser *parser) {
         return NULL;
     }
 
-    char *property_name = strdup(parser->current_token.value);
+    const char *property_name = parser->current_token.value;
     parser_advance(parser);
 
     parser_expect(parser, TOKEN_SEMICOLON);
 
     ASTNode *property = ast_create_objc_property(property_type, property_name, attributes);
-    free(property_name);
     return property;
 }
 
@@ -588,24 +589,21 @@ ASTNode *parser_parse_objc_synthesize(Parser *parser) {
 
     // Parse property list: @synthesize prop1, prop2 = ivar2;
     while (parser_match(parser, TOKEN_IDENTIFIER)) {
-        char *property_name = strdup(parser->current_token.value);
+        const char *property_name = parser->current_token.value;
         parser_advance(parser);
 
         // Optional backing ivar: property = ivar
-        char *ivar_name = NULL;
+        const char *ivar_name = NULL;
         if (parser_match(parser, TOKEN_ASSIGN)) {
             parser_advance(parser);
             if (parser_match(parser, TOKEN_IDENTIFIER)) {
-                ivar_name = strdup(parser->current_token.value);
+                ivar_name = parser->current_token.value;
                 parser_advance(parser);
             }
         }
 
         // Keep this line:
         ast_destroy(ast_create_objc_synthesize(property_name, ivar_name));
-        
-        free(property_name);
-        if (ivar_name) free(ivar_name);
 
         if (parser_match(parser, TOKEN_COMMA)) {
             parser_advance(parser);
@@ -644,7 +642,7 @@ ASTNode *parser_parse_objc_protocol(Parser *parser) {
         return NULL;
     }
 
-    char *protocol_name = strdup(parser->current_token.value);
+    const char *protocol_name = parser->current_token.value;
     parser_advance(parser);
 
     ASTNode *protocol = ast_create_objc_protocol(protocol_name);
@@ -674,7 +672,6 @@ ASTNode *parser_parse_objc_protocol(Parser *parser) {
 
     parser_expect(parser, TOKEN_AT_END);
 
-    free(protocol_name);
     return protocol;
 }
 
@@ -701,18 +698,17 @@ ASTNode *parser_parse_primary_expression(Parser *parser) {
 
     switch (parser->current_token.type) {
         case TOKEN_NUMBER: {
-            int value = atoi(parser->current_token.value);
-            primary = ast_create_number(value);
+            primary = ast_create_number(parser->current_token.literal.int_value);
             parser_advance(parser);
             break;
         }
         case TOKEN_STRING: {
-            primary = ast_create_string(parser->current_token.value);
+            primary = ast_create_string(lexer_token_text(parser->lexer, &parser->current_token));
             parser_advance(parser);
             break;
         }
         case TOKEN_NSSTRING_LITERAL: {
-            primary = ast_create_objc_string(parser->current_token.value);
+            primary = ast_create_objc_string(lexer_token_text(parser->lexer, &parser->current_token));
             parser_advance(parser);
             break;
         }
@@ -742,7 +738,8 @@ ASTNode *parser_parse_primary_expression(Parser *parser) {
             break;
         }
         case TOKEN_IDENTIFIER: {
-            primary = ast_create_identifier(parser->current_token.value);
+            primary = parser_at(ast_create_identifier(parser->current_token.value),
+                                &parser->current_token);
             parser_advance(parser);
             break;
         }
@@ -829,13 +826,12 @@ ASTNode *parser_parse_objc_selector_expression(Parser *parser) {
     parser_advance(parser); // consume '@selector'
     parser_expect(parser, TOKEN_LPAREN);
 
-    char *selector_name = strdup(parser->current_token.value);
+    const char *selector_name = parser->current_token.value;
     parser_advance(parser);
 
     parser_expect(parser, TOKEN_RPAREN);
 
     ASTNode *selector = ast_create_objc_selector(selector_name);
-    free(selector_name);
     return selector;
 }
 
@@ -860,31 +856,64 @@ ASTNode *parser_parse_property_access(Parser *parser, ASTNode *object) {
         return object;
     }
 
-    char *property_name = strdup(parser->current_token.value);
+    const char *property_name = parser->current_token.value;
     parser_advance(parser);
 
     ASTNode *access = ast_create_property_access(object, property_name);
-    free(property_name);
     return access;
 }
 
 // Rest of the original parser functions remain the same...
 
-ASTNode *parser_parse_function(Parser *parser, DataType return_type, char *name) {
+// Parameter list after '(': "type name" pairs separated by commas. A lone
+// "void" means no parameters; a parameter the parser does not understand
+// (function pointers, arrays, varargs) is skipped up to the next ',' or ')'.
+static void parser_parse_parameters(Parser *parser, ASTNode *func) {
+    if (parser_match(parser, TOKEN_VOID) && parser_peek(parser, 1).type == TOKEN_RPAREN) {
+        parser_advance(parser);
+        return;
+    }
+
+    while (!parser_match(parser, TOKEN_RPAREN) && !parser_match(parser, TOKEN_EOF)) {
+        parser_parse_type_qualifiers(parser);
+        if (parser_is_type_specifier(parser->current_token.type)) {
+            DataType type = token_type_to_data_type(parser->current_token.type);
+            parser_advance(parser);
+            parser_parse_type_qualifiers(parser);
+            while (parser_match(parser, TOKEN_MULTIPLY)) {
+                type = TYPE_POINTER;
+                parser_advance(parser);
+            }
+
+            const char *param_name = "";
+            if (parser_match(parser, TOKEN_IDENTIFIER)) {
+                param_name = parser->current_token.value;
+                parser_advance(parser);
+            }
+            if (parser_match(parser, TOKEN_COMMA) || parser_match(parser, TOKEN_RPAREN)) {
+                ast_add_parameter(func, ast_create_parameter(type, param_name));
+            }
+        }
+
+        while (!parser_match(parser, TOKEN_COMMA) && !parser_match(parser, TOKEN_RPAREN) &&
+               !parser_match(parser, TOKEN_EOF)) {
+            parser_advance(parser);
+        }
+        if (parser_match(parser, TOKEN_COMMA)) {
+            parser_advance(parser);
+        }
+    }
+}
+
+ASTNode *parser_parse_function(Parser *parser, DataType return_type, const char *name) {
     // Expect '('
     if (parser->current_token.type != TOKEN_LPAREN) {
         return NULL;
     }
     parser_advance(parser);
 
-    // Parse parameters (for now, just handle empty parameter list)
-    if (parser->current_token.type != TOKEN_RPAREN) {
-        // Skip parameters for now - advance until we find ')'
-        while (parser->current_token.type != TOKEN_RPAREN &&
-               parser->current_token.type != TOKEN_EOF) {
-            parser_advance(parser);
-        }
-    }
+    ASTNode *func = parser_create_function_declaration(return_type, name);
+    parser_parse_parameters(parser, func);
 
     if (parser->current_token.type == TOKEN_RPAREN) {
         parser_advance(parser); // consume ')'
@@ -892,18 +921,23 @@ ASTNode *parser_parse_function(Parser *parser, DataType return_type, char *name)
 
     // Check if this is a declaration or definition
     if (parser->current_token.type == TOKEN_SEMICOLON) {
-        // Function declaration: int func();
+        // Function declaration: int func(int x);
         parser_advance(parser);
-        return parser_create_function_declaration(return_type, name);
+        return func;
     } else if (parser->current_token.type == TOKEN_LBRACE) {
-        // Function definition: int func() { ... }
-        return parser_parse_function_definition(parser, return_type, name);
+        // Function definition: int func(int x) { ... }
+        ASTNode *body = parser_parse_compound_statement(parser);
+        if (!body || !func) {
+            return NULL;
+        }
+        func->data.function_decl.body = body;
+        return func;
     } else {
         return NULL;
     }
 }
 
-ASTNode *parser_parse_function_definition(Parser *parser, DataType return_type, char *name) {
+ASTNode *parser_parse_function_definition(Parser *parser, DataType return_type, const char *name) {
     // Parse the function body
     ASTNode *body = parser_parse_compound_statement(parser);
     if (!body) {
@@ -913,9 +947,7 @@ ASTNode *parser_parse_function_definition(Parser *parser, DataType return_type,
     // Create a function declaration node with body
     ASTNode *func = parser_create_function_declaration(return_type, name);
     if (func) {
-        // If your AST supports function definitions, set the body here
-        // This depends on your AST structure
-        // func->data.function.body = body; // Adjust according to your AST
+        func->data.function_decl.body = body;
     }
 
     return func;
@@ -960,14 +992,18 @@ ASTNode *parser_parse_statement(Parser *parser) {
             return parser_parse_while_statement(parser);
         case TOKEN_FOR:
             return parser_parse_for_statement(parser);
-        case TOKEN_BREAK:
+        case TOKEN_BREAK: {
+            Token keyword = parser->current_token;
             parser_advance(parser);
             parser_expect(parser, TOKEN_SEMICOLON);
-            return ast_create_break_stmt();
-        case TOKEN_CONTINUE:
+            return parser_at(ast_create_break_stmt(), &keyword);
+        }
+        case TOKEN_CONTINUE: {
+            Token keyword = parser->current_token;
             parser_advance(parser);
             parser_expect(parser, TOKEN_SEMICOLON);
-            return ast_create_continue_stmt();
+            return parser_at(ast_create_continue_stmt(), &keyword);
+        }
         // Objective-C statements
         case TOKEN_AT_TRY:
             return parser_parse_objc_try_statement(parser);
@@ -999,14 +1035,14 @@ ASTNode *parser_parse_objc_try_statement(Parser *parser) {
 
         // Parse exception type and variable
         DataType exception_type = TYPE_ID;
-        char *exception_var = NULL;
+        const char *exception_var = NULL;
 
         if (parser_is_type_specifier(parser->current_token.type)) {
             exception_type = parser_parse_type_specifier(parser);
         }
 
         if (parser_match(parser, TOKEN_IDENTIFIER)) {
-            exception_var = strdup(parser->current_token.value);
+            exception_var = parser->current_token.value;
             parser_advance(parser);
         }
 
@@ -1020,8 +1056,6 @@ ASTNode *parser_parse_objc_try_statement(Parser *parser) {
 
         // Add to catch blocks array (simplified - you'd need proper array management)
         catch_count++;
-
-        if (exception_var) free(exception_var);
     }
 
     // Parse optional @finally block
@@ -1067,51 +1101,65 @@ ASTNode *parser_parse_objc_autoreleasepool_statement(Parser *parser) {
     return ast_create_objc_autoreleasepool(pool_body);
 }
 
-ASTNode *parser_parse_compound_statement(Parser *parser) {
-    ASTNode *compound = ast_create_compound_stmt();
+// A local variable declaration, "[qualifiers] type [qualifiers] name ...".
+// Only the prefix up to the name decides; if the tokens do not start one,
+// nothing is reported and the parser is rewound to where it started.
+static ASTNode *parser_try_local_declaration(Parser *parser) {
+    size_t start = parser_mark(parser);
 
-    parser_expect(parser, TOKEN_LBRACE);
+    TypeQualifier qualifiers = parser_parse_type_qualifiers(parser);
+    if (!parser_is_type_specifier(parser->current_token.type)) {
+        parser_rewind(parser, start);
+        return NULL;
+    }
+    Token type_token = parser->current_token;
+    parser_advance(parser);
+    qualifiers |= parser_parse_type_qualifiers(parser);
+    if (!parser_match(parser, TOKEN_IDENTIFIER)) {
+        parser_rewind(parser, start);
+        return NULL;
+    }
 
-    while (!parser_match(parser, TOKEN_RBRACE) && !parser_match(parser, TOKEN_EOF)) {
-        ASTNode *stmt = NULL;
+    // Committed to a declaration
+    DataType var_type = token_to_data_type(type_token.type);
+    if (var_type == TYPE_UNKNOWN) {
+        error_syntax(type_token.line, type_token.column, "Expected type specifier");
+    }
 
-        // Check for type qualifiers first
-        if (parser_is_type_qualifier(parser->current_token.type) ||
-            parser_is_type_specifier(parser->current_token.type)) {
+    const char *var_name = parser->current_token.value;
+    parser_advance(parser);
 
-            // Parse qualifiers
-            TypeQualifier qualifiers = parser_parse_type_qualifiers(parser);
+    ASTNode *var_decl = parser_parse_variable_declaration(parser, var_type);
+    var_decl->data.var_decl.name = var_name;
+    var_decl->data.var_decl.qualifiers = qualifiers;
+    var_decl->data.var_decl.is_const = (qualifiers & QUAL_CONST) != 0;
+    var_decl->data.var_decl.is_volatile = (qualifiers & QUAL_VOLATILE) != 0;
+    return var_decl;
+}
 
-            // Parse type
-            DataType var_type = parser_parse_type_specifier(parser);
+ASTNode *parser_parse_compound_statement(Parser *parser) {
+    ASTNode *compound = ast_create_compound_stmt();
 
-            // Parse qualifiers after type
-            TypeQualifier post_qualifiers = parser_parse_type_qualifiers(parser);
-            qualifiers |= post_qualifiers;
+    parser_expect(parser, TOKEN_LBRACE);
 
-            if (parser_match(parser, TOKEN_IDENTIFIER)) {
-                char *var_name = strdup(parser->current_token.value);
-                parser_advance(parser);
+    while (!parser_match(parser, TOKEN_RBRACE) && !parser_match(parser, TOKEN_EOF)) {
+        size_t start = parser_mark(parser);
 
-                ASTNode *var_decl = parser_parse_variable_declaration(parser, var_type);
-                if (var_decl) {
-                    free(var_decl->data.var_decl.name);
-                    var_decl->data.var_decl.name = var_name;
-                    var_decl->data.var_decl.qualifiers = qualifiers;
-                    var_decl->data.var_decl.is_const = (qualifiers & QUAL_CONST) != 0;
-                    var_decl->data.var_decl.is_volatile = (qualifiers & QUAL_VOLATILE) != 0;
-                    stmt = var_decl;
-                } else {
-                    free(var_name);
-                }
-            }
-            } else {
-                stmt = parser_parse_statement(parser);
-            }
+        // Declaration or statement: try the declaration first and fall back
+        // to the statement parser from the same token when it is not one
+        ASTNode *stmt = parser_try_local_declaration(parser);
+        if (!stmt) {
+            stmt = parser_parse_statement(parser);
+        }
 
         if (stmt) {
             ast_add_statement(compound, stmt);
         }
+
+        // A statement that consumed nothing would be retried forever
+        if (parser_mark(parser) == start) {
+            parser_advance(parser);
+        }
     }
 
     parser_expect(parser, TOKEN_RBRACE);
@@ -1256,23 +1304,34 @@ ASTNode *parser_parse_typedef(Parser *parser) {
         return NULL;
     }
 
-    char *alias_name = strdup(parser->current_token.value);
+    const char *alias_name = parser->current_token.value;
     parser_advance(parser);
 
     parser_expect(parser, TOKEN_SEMICOLON);
 
     ASTNode *typedef_node = ast_create_typedef(base_type, alias_name);
-    free(alias_name);
     return typedef_node;
 }
 
+// Error recovery inside a struct/union body: drop the rest of a member
+// that failed to parse so the member loop always makes progress
+static void parser_skip_member(Parser *parser) {
+    while (!parser_match(parser, TOKEN_SEMICOLON) && !parser_match(parser, TOKEN_RBRACE) &&
+           !parser_match(parser, TOKEN_EOF)) {
+        parser_advance(parser);
+    }
+    if (parser_match(parser, TOKEN_SEMICOLON)) {
+        parser_advance(parser);
+    }
+}
+
 // Parse struct declarations
 ASTNode *parser_parse_struct(Parser *parser) {
     parser_advance(parser); // consume 'struct'
 
-    char *struct_name = NULL;
+    const char *struct_name = NULL;
     if (parser_match(parser, TOKEN_IDENTIFIER)) {
-        struct_name = strdup(parser->current_token.value);
+        struct_name = parser->current_token.value;
         parser_advance(parser);
     }
 
@@ -1286,13 +1345,14 @@ ASTNode *parser_parse_struct(Parser *parser) {
             ASTNode *member = parser_parse_struct_member(parser);
             if (member) {
                 ast_add_struct_member(struct_node, member);
+            } else {
+                parser_skip_member(parser);
             }
         }
 
         parser_expect(parser, TOKEN_RBRACE);
     }
 
-    if (struct_name) free(struct_name);
     return struct_node;
 }
 
@@ -1300,9 +1360,9 @@ ASTNode *parser_parse_struct(Parser *parser) {
 ASTNode *parser_parse_union(Parser *parser) {
     parser_advance(parser); // consume 'union'
 
-    char *union_name = NULL;
+    const char *union_name = NULL;
     if (parser_match(parser, TOKEN_IDENTIFIER)) {
-        union_name = strdup(parser->current_token.value);
+        union_name = parser->current_token.value;
         parser_advance(parser);
     }
 
@@ -1316,13 +1376,14 @@ ASTNode *parser_parse_union(Parser *parser) {
             ASTNode *member = parser_parse_struct_member(parser); // Same as struct member
             if (member) {
                 ast_add_union_member(union_node, member);
+            } else {
+                parser_skip_member(parser);
             }
         }
 
         parser_expect(parser, TOKEN_RBRACE);
     }
 
-    if (union_name) free(union_name);
     return union_node;
 }
 
@@ -1330,9 +1391,9 @@ ASTNode *parser_parse_union(Parser *parser) {
 ASTNode *parser_parse_enum(Parser *parser) {
     parser_advance(parser); // consume 'enum'
 
-    char *enum_name = NULL;
+    const char *enum_name = NULL;
     if (parser_match(parser, TOKEN_IDENTIFIER)) {
-        enum_name = strdup(parser->current_token.value);
+        enum_name = parser->current_token.value;
         parser_advance(parser);
     }
 
@@ -1350,19 +1411,18 @@ ASTNode *parser_parse_enum(Parser *parser) {
                 break;
             }
 
-            char *const_name = strdup(parser->current_token.value);
+            const char *const_name = parser->current_token.value;
             parser_advance(parser);
 
             // Check for explicit value assignment
             if (parser_match(parser, TOKEN_ASSIGN)) {
                 parser_advance(parser);
                 if (parser_match(parser, TOKEN_NUMBER)) {
-                    enum_value = atoi(parser->current_token.value);
+                    enum_value = parser->current_token.literal.int_value;
                     parser_advance(parser);
                 } else {
                     error_syntax(parser->current_token.line, parser->current_token.column,
                                 "Expected enum value");
-                    free(const_name);
                     break;
                 }
             }
@@ -1371,7 +1431,6 @@ ASTNode *parser_parse_enum(Parser *parser) {
             ast_add_enum_constant(enum_node, enum_const);
 
             enum_value++; // Auto-increment for next constant
-            free(const_name);
 
             if (parser_match(parser, TOKEN_COMMA)) {
                 parser_advance(parser);
@@ -1387,7 +1446,6 @@ ASTNode *parser_parse_enum(Parser *parser) {
         parser_expect(parser, TOKEN_RBRACE);
     }
 
-    if (enum_name) free(enum_name);
     return enum_node;
 }
 
@@ -1426,7 +1484,7 @@ ASTNode *parser_parse_struct_member(Parser *parser) {
         return NULL;
     }
 
-    char *member_name = strdup(parser->current_token.value);
+    const char *member_name = parser->current_token.value;
     parser_advance(parser);
 
     // Check for bitfield specification
@@ -1434,12 +1492,11 @@ ASTNode *parser_parse_struct_member(Parser *parser) {
     if (parser_match(parser, TOKEN_COLON)) {
         parser_advance(parser);
         if (parser_match(parser, TOKEN_NUMBER)) {
-            bitfield_width = atoi(parser->current_token.value);
+            bitfield_width = parser->current_token.literal.int_value;
             parser_advance(parser);
         } else {
             error_syntax(parser->current_token.line, parser->current_token.column,
                         "Expected bitfield width");
-            free(member_name);
             if (type_node) ast_destroy(type_node);
             return NULL;
         }
@@ -1455,7 +1512,6 @@ ASTNode *parser_parse_struct_member(Parser *parser) {
         ast_set_member_type_node(member, type_node);
     }
 
-    free(member_name);
     return member;
 }
 
@@ -1487,12 +1543,11 @@ ASTNode *parser_parse_declaration_extended(Parser *parser) {
         ASTNode *struct_node = parser_parse_struct(parser);
         // Handle variable declarations with this struct type
         if (parser_match(parser, TOKEN_IDENTIFIER)) {
-            char *var_name = strdup(parser->current_token.value);
+            const char *var_name = parser->current_token.value;
             parser_advance(parser);
             parser_expect(parser, TOKEN_SEMICOLON);
 
             ASTNode *var_decl = ast_create_var_decl_with_type_node(struct_node, var_name);
-            free(var_name);
             return var_decl;
         } else {
             parser_expect(parser, TOKEN_SEMICOLON);
@@ -1504,12 +1559,11 @@ ASTNode *parser_parse_declaration_extended(Parser *parser) {
         ASTNode *union_node = parser_parse_union(parser);
         // Handle variable declarations with this union type
         if (parser_match(parser, TOKEN_IDENTIFIER)) {
-            char *var_name = strdup(parser->current_token.value);
+            const char *var_name = parser->current_token.value;
             parser_advance(parser);
             parser_expect(parser, TOKEN_SEMICOLON);
 
             ASTNode *var_decl = ast_create_var_decl_with_type_node(union_node, var_name);
-            free(var_name);
             return var_decl;
         } else {
             parser_expect(parser, TOKEN_SEMICOLON);
@@ -1521,12 +1575,11 @@ ASTNode *parser_parse_declaration_extended(Parser *parser) {
         ASTNode *enum_node = parser_parse_enum(parser);
         // Handle variable declarations with this enum type
         if (parser_match(parser, TOKEN_IDENTIFIER)) {
-            char *var_name = strdup(parser->current_token.value);
+            const char *var_name = parser->current_token.value;
             parser_advance(parser);
             parser_expect(parser, TOKEN_SEMICOLON);
 
             ASTNode *var_decl = ast_create_var_decl_with_type_node(enum_node, var_name);
-            free(var_name);
             return var_decl;
         } else {
             parser_expect(parser, TOKEN_SEMICOLON);
@@ -1548,7 +1601,12 @@ ASTNode *parser_parse_assignment_expression(Parser *parser) {
         ASTNode *right = parser_parse_assignment_expression(parser);
 
         if (left && left->type == AST_IDENTIFIER) {
-            return ast_create_assignment(left->data.identifier.name, right);
+            ASTNode *assignment = ast_create_assignment(left->data.identifier.name, right);
+            if (assignment) {
+                assignment->line = left->line;
+                assignment->column = left->column;
+            }
+            return assignment;
         } else {
             error_syntax(parser->current_token.line, parser->current_token.column,
                         "Invalid left-hand side in assignment");
@@ -1682,7 +1740,7 @@ ASTNode* parser_parse_array_declaration(Parser* parser, ASTNode* element_type) {
     // Check for empty brackets (dynamic array or unsized)
     if (!parser_match(parser, TOKEN_RBRACKET)) {
         if (parser_match(parser, TOKEN_IDENTIFIER) &&
-            strcmp(parser->current_token.value, "dynamic") == 0) {
+            parser->current_token.value == intern_string("dynamic")) {
             is_dynamic = 1;
             parser_advance(parser);
             parser_expect(parser, TOKEN_RBRACKET);
@@ -1716,7 +1774,9 @@ ASTNode* parser_parse_multidim_array_declaration(Parser* parser, ASTNode* elemen
         parser_expect(parser, TOKEN_RBRACKET);
     }
 
-    return ast_create_multidim_array_declaration(element_type, dimensions, dim_count, line, column);
+    ASTNode* array_decl = ast_create_multidim_array_declaration(element_type, dimensions, dim_count, line, column);
+    free(dimensions);
+    return array_decl;
 }
 
 // Parse array access
@@ -1764,7 +1824,9 @@ ASTNode* parser_parse_array_literal(Parser* parser) {
 
     parser_expect(parser, TOKEN_RBRACE);
 
-    return ast_create_array_literal(elements, element_count, line, column);
+    ASTNode* literal = ast_create_array_literal(elements, element_count, line, column);
+    free(elements);
+    return literal;
 }
 
 // Parse address-of operator
@@ -0,0 +1,436 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "pch.h"
+#include "include_cache.h"
+#include "intern.h"
+#include "error.h"
+
+// ========================================
+// File layout
+// ========================================
+// All integers are in host byte order; the magic and version reject files
+// from other builds. Sections follow the header in the order below and every
+// fixed-size record is a multiple of 8 bytes, so a mapped file can be read
+// in place. Strings are NUL-terminated and referenced by their offset in the
+// string pool.
+
+#define PCH_NO_STRING UINT32_MAX
+
+#define PCH_DEP_SCANNED      0x1  // Guard detection ran on the header
+#define PCH_DEP_PRAGMA_ONCE  0x2  // The header said #pragma once
+#define PCH_DEP_ONCE         0x4  // Must not be entered again
+
+typedef struct PCHHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header;          // Path of the precompiled header
+    uint32_t dep_count;
+    uint32_t macro_count;
+    uint64_t deps_offset;
+    uint64_t macros_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint64_t text_offset;
+    uint64_t text_size;
+} PCHHeader;
+
+typedef struct PCHDependency {
+    int64_t mtime;
+    uint64_t size;
+    uint64_t hash;            // FNV-1a of the contents
+    uint32_t path;
+    uint32_t guard;           // Include guard macro, or PCH_NO_STRING
+    uint32_t flags;
+    uint32_t reserved;
+} PCHDependency;
+
+typedef struct PCHMacro {
+    uint32_t definition;      // Everything after "#define"
+    int32_t line;
+} PCHMacro;
+
+typedef struct PCHBuffer {
+    char *data;
+    size_t size;
+    size_t capacity;
+} PCHBuffer;
+
+static size_t pch_buffer_append(PCHBuffer *buffer, const void *data, size_t size) {
+    if (buffer->size + size > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (capacity < buffer->size + size) {
+            capacity *= 2;
+        }
+        char *new_data = realloc(buffer->data, capacity);
+        if (!new_data) {
+            error_fatal("Memory allocation failed for precompiled header");
+            return 0;
+        }
+        buffer->data = new_data;
+        buffer->capacity = capacity;
+    }
+
+    size_t offset = buffer->size;
+    memcpy(buffer->data + offset, data, size);
+    buffer->size += size;
+    return offset;
+}
+
+static uint32_t pch_buffer_string(PCHBuffer *buffer, const char *text) {
+    return (uint32_t)pch_buffer_append(buffer, text, strlen(text) + 1);
+}
+
+static uint64_t pch_hash(const char *data, size_t size) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static bool pch_hash_file(const char *path, uint64_t *hash) {
+    SourceFile source;
+    if (!source_file_open(&source, path)) {
+        return false;
+    }
+    *hash = pch_hash(source.data, source.size);
+    source_file_close(&source);
+    return true;
+}
+
+// ========================================
+// Writing
+// ========================================
+
+static bool pch_add_dependency(PCHBuffer *deps, PCHBuffer *strings, const char *path,
+                               const IncludeCacheEntry *entry, uint32_t flags) {
+    // Paths are recorded absolute, so the PCH can be used from any
+    // directory, not just the one it was built in
+    char resolved[PATH_MAX];
+    struct stat st;
+    if (!realpath(path, resolved) || stat(resolved, &st) != 0) {
+        fprintf(stderr, "Error: Cannot stat '%s'\n", path);
+        return false;
+    }
+
+    PCHDependency dep = {0};
+    dep.mtime = (int64_t)st.st_mtime;
+    dep.size = (uint64_t)st.st_size;
+    dep.path = pch_buffer_string(strings, resolved);
+    dep.guard = PCH_NO_STRING;
+    dep.flags = flags;
+
+    if (entry && entry->loaded) {
+        dep.hash = pch_hash(entry->source.data, entry->source.size);
+    } else if (!pch_hash_file(path, &dep.hash)) {
+        return false;
+    }
+
+    if (entry) {
+        if (entry->scanned) dep.flags |= PCH_DEP_SCANNED;
+        if (entry->pragma_once) dep.flags |= PCH_DEP_PRAGMA_ONCE;
+        if (entry->guard) dep.guard = pch_buffer_string(strings, entry->guard);
+    }
+
+    pch_buffer_append(deps, &dep, sizeof(dep));
+    return true;
+}
+
+// Spells a macro back as the text of its #define
+static char *pch_macro_definition(const Preprocessor *pp, const Macro *macro) {
+    size_t length = strlen(macro->name) + strlen(macro->body) + 8;
+    for (int i = 0; i < macro->param_count; i++) {
+        length += strlen(macro->params[i].name) + 4;
+    }
+
+    char *text = malloc(length);
+    if (!text) {
+        error_fatal("Memory allocation failed for macro '%s'", macro->name);
+        return NULL;
+    }
+
+    char *cursor = text + sprintf(text, "%s", macro->name);
+    if (macro->type == MACRO_FUNCTION) {
+        *cursor++ = '(';
+        for (int i = 0; i < macro->param_count; i++) {
+            const char *param = macro->params[i].name;
+            bool last = i + 1 == macro->param_count;
+            if (i) *cursor++ = ',';
+            if (last && macro->is_variadic) {
+                cursor += sprintf(cursor, "%s...", param == pp->id_va_args ? "" : param);
+            } else {
+                cursor += sprintf(cursor, "%s", param);
+            }
+        }
+        *cursor++ = ')';
+    }
+    sprintf(cursor, " %s", macro->body);
+    return text;
+}
+
+static bool pch_is_once(const Preprocessor *pp, const IncludeCacheEntry *entry) {
+    for (size_t i = 0; i < pp->once_count; i++) {
+        if (pp->once_files[i] == entry) return true;
+    }
+    return false;
+}
+
+bool pch_write(Preprocessor *pp, const char *header, const char *text, const char *path) {
+    PCHBuffer deps = {NULL, 0, 0};
+    PCHBuffer macros = {NULL, 0, 0};
+    PCHBuffer strings = {NULL, 0, 0};
+    bool ok = true;
+
+    PCHHeader file_header = {0};
+    memcpy(file_header.magic, PCH_MAGIC, sizeof(file_header.magic));
+    file_header.version = PCH_VERSION;
+    file_header.header = pch_buffer_string(&strings, header);
+
+    // The header itself, then every header this run read. Other entries in
+    // the process-wide include cache (server warm-up, other -j units) are
+    // not dependencies of this prefix
+    ok = pch_add_dependency(&deps, &strings, header, NULL, 0);
+    for (size_t i = 0; ok && i < pp->included_count; i++) {
+        IncludeCacheEntry *entry = pp->included_files[i];
+        uint32_t flags = pch_is_once(pp, entry) ? PCH_DEP_ONCE : 0;
+        ok = pch_add_dependency(&deps, &strings, entry->path, entry, flags);
+    }
+    file_header.dep_count = (uint32_t)(deps.size / sizeof(PCHDependency));
+
+    // Predefined macros are recreated by every Preprocessor
+    for (size_t i = 0; ok && i < pp->macro_capacity; i++) {
+        Macro *macro = pp->macros[i];
+        if (!macro || macro->is_predefined) continue;
+
+        char *definition = pch_macro_definition(pp, macro);
+        if (!definition) {
+            ok = false;
+            break;
+        }
+        PCHMacro record = {pch_buffer_string(&strings, definition), macro->line_defined};
+        pch_buffer_append(&macros, &record, sizeof(record));
+        free(definition);
+    }
+    file_header.macro_count = (uint32_t)(macros.size / sizeof(PCHMacro));
+
+    size_t text_size = strlen(text);
+    file_header.deps_offset = sizeof(PCHHeader);
+    file_header.macros_offset = file_header.deps_offset + deps.size;
+    file_header.strings_offset = file_header.macros_offset + macros.size;
+    file_header.strings_size = strings.size;
+    file_header.text_offset = file_header.strings_offset + strings.size;
+    file_header.text_size = text_size;
+
+    FILE *out = ok ? fopen(path, "wb") : NULL;
+    if (ok && !out) {
+        fprintf(stderr, "Error: Cannot open output file '%s'\n", path);
+        ok = false;
+    }
+    if (out) {
+        ok = fwrite(&file_header, sizeof(file_header), 1, out) == 1 &&
+             fwrite(deps.data, 1, deps.size, out) == deps.size &&
+             fwrite(macros.data, 1, macros.size, out) == macros.size &&
+             fwrite(strings.data, 1, strings.size, out) == strings.size &&
+             fwrite(text, 1, text_size, out) == text_size;
+        if (fclose(out) != 0 || !ok) {
+            fprintf(stderr, "Error: Failed to write precompiled header '%s'\n", path);
+            ok = false;
+            remove(path);
+        }
+    }
+
+    free(deps.data);
+    free(macros.data);
+    free(strings.data);
+    return ok;
+}
+
+// ========================================
+// Loading
+// ========================================
+
+typedef struct PCHFile {
+    SourceFile source;
+    const PCHHeader *header;
+    const PCHDependency *deps;
+    const PCHMacro *macros;
+    const char *strings;
+} PCHFile;
+
+static const char *pch_string(const PCHFile *file, uint32_t offset) {
+    return offset == PCH_NO_STRING ? NULL : file->strings + offset;
+}
+
+// Checks every section lies inside the file and every string is terminated
+static bool pch_validate(PCHFile *file) {
+    const char *data = file->source.data;
+    size_t size = file->source.size;
+    if (size < sizeof(PCHHeader)) {
+        return false;
+    }
+
+    const PCHHeader *header = (const PCHHeader *)data;
+    if (memcmp(header->magic, PCH_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != PCH_VERSION) {
+        return false;
+    }
+
+    uint64_t deps_size = (uint64_t)header->dep_count * sizeof(PCHDependency);
+    uint64_t macros_size = (uint64_t)header->macro_count * sizeof(PCHMacro);
+    if (header->deps_offset != sizeof(PCHHeader) ||
+        header->macros_offset != header->deps_offset + deps_size ||
+        header->strings_offset != header->macros_offset + macros_size ||
+        header->text_offset != header->strings_offset + header->strings_size ||
+        header->text_offset + header->text_size != size ||
+        header->strings_size == 0 || data[header->text_offset - 1] != '\0') {
+        return false;
+    }
+
+    file->header = header;
+    file->deps = (const PCHDependency *)(data + header->deps_offset);
+    file->macros = (const PCHMacro *)(data + header->macros_offset);
+    file->strings = data + header->strings_offset;
+
+    if (header->header >= header->strings_size) {
+        return false;
+    }
+    for (uint32_t i = 0; i < header->dep_count; i++) {
+        const PCHDependency *dep = &file->deps[i];
+        if (dep->path >= header->strings_size ||
+            (dep->guard != PCH_NO_STRING && dep->guard >= header->strings_size)) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->macro_count; i++) {
+        if (file->macros[i].definition >= header->strings_size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A header that was only touched still matches on contents
+static bool pch_dependency_current(const PCHFile *file, const PCHDependency *dep) {
+    const char *path = pch_string(file, dep->path);
+    struct stat st;
+    if (stat(path, &st) != 0 || (uint64_t)st.st_size != dep->size) {
+        return false;
+    }
+    if ((int64_t)st.st_mtime == dep->mtime) {
+        return true;
+    }
+
+    uint64_t hash;
+    return pch_hash_file(path, &hash) && hash == dep->hash;
+}
+
+static bool pch_open(PCHFile *file, const char *path) {
+    memset(file, 0, sizeof(PCHFile));
+    if (!source_file_open(&file->source, path)) {
+        return false;
+    }
+    if (file->source.mapped) {
+        return true;
+    }
+
+    // Without mmap source_file_open reads text; read the blob as binary
+    source_file_close(&file->source);
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        return false;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+
+    char *data = size > 0 ? malloc((size_t)size) : NULL;
+    if (!data || fread(data, 1, (size_t)size, in) != (size_t)size) {
+        free(data);
+        fclose(in);
+        return false;
+    }
+    fclose(in);
+
+    file->source.data = data;
+    file->source.size = (size_t)size;
+    return true;
+}
+
+char *pch_load(Preprocessor *pp, const char *path) {
+    PCHFile file;
+    if (!pch_open(&file, path)) {
+        fprintf(stderr, "Error: Cannot read precompiled header '%s'\n", path);
+        return NULL;
+    }
+    if (!pch_validate(&file)) {
+        fprintf(stderr, "Error: '%s' is not a precompiled header for this compiler\n", path);
+        source_file_close(&file.source);
+        return NULL;
+    }
+
+    const PCHHeader *header = file.header;
+    for (uint32_t i = 0; i < header->dep_count; i++) {
+        if (!pch_dependency_current(&file, &file.deps[i])) {
+            fprintf(stderr, "Error: '%s' has changed since precompiled header '%s' was built\n",
+                    pch_string(&file, file.deps[i].path), path);
+            source_file_close(&file.source);
+            return NULL;
+        }
+    }
+
+    free(pp->current_file);
+    pp->current_file = strdup(pch_string(&file, header->header));
+    pp->error_count = 0;
+
+    for (uint32_t i = 0; i < header->macro_count; i++) {
+        const char *definition = pch_string(&file, file.macros[i].definition);
+        PPTokenList tokens = {NULL, 0, 0};
+
+        pp->current_line = file.macros[i].line;
+        preprocessor_lex_tokens(definition, strlen(definition), &tokens);
+        preprocessor_define_tokens(pp, tokens.items, tokens.count);
+        preprocessor_tokens_free(&tokens);
+    }
+
+    // The first dependency is the precompiled header itself, which was never
+    // in the include cache
+    for (uint32_t i = 1; i < header->dep_count; i++) {
+        const PCHDependency *dep = &file.deps[i];
+        IncludeCacheEntry *entry = include_cache_lookup(pch_string(&file, dep->path));
+        if (!entry) continue;
+        preprocessor_remember_included(pp, entry);
+
+        if (dep->flags & PCH_DEP_SCANNED) {
+            const char *guard = pch_string(&file, dep->guard);
+            include_cache_set_guard(entry, guard ? intern_string(guard) : NULL);
+        }
+        if (dep->flags & PCH_DEP_PRAGMA_ONCE) {
+            include_cache_set_pragma_once(entry);
+        }
+        if (dep->flags & PCH_DEP_ONCE) {
+            preprocessor_remember_once(pp, entry);
+        }
+    }
+
+    char *text = malloc(header->text_size + 1);
+    if (!text) {
+        source_file_close(&file.source);
+        error_fatal("Memory allocation failed for precompiled header");
+        return NULL;
+    }
+    memcpy(text, file.source.data + header->text_offset, header->text_size);
+    text[header->text_size] = '\0';
+
+    source_file_close(&file.source);
+    if (pp->error_count > 0) {
+        free(text);
+        return NULL;
+    }
+    return text;
+}
@@ -9,6 +9,8 @@
 #include "preprocessor.h"
 #include "kcc.h"
 
+#define MACRO_TABLE_INITIAL_CAPACITY 256
+
 Preprocessor *preprocessor_create(void) {
     Preprocessor *pp = malloc(sizeof(Preprocessor));
     if (!pp) {
@@ -26,10 +28,25 @@ Preprocessor *preprocessor_create(void) {
         return NULL;
     }
 
+    pp->expand_arena = arena_create(ARENA_DEFAULT_CHUNK_SIZE);
+    if (!pp->expand_arena) {
+        free(pp->output);
+        free(pp);
+        error_fatal("Memory allocation failed for preprocessor");
+        return NULL;
+    }
+
     pp->output[0] = '\0';
     pp->output_size = 0;
+    pp->output_line = 1;
     pp->current_line = 1;
     pp->skip_lines = false;
+    pp->macro_generation = 1;
+
+    pp->id_defined = intern_string("defined");
+    pp->id_va_args = intern_string("__VA_ARGS__");
+    pp->id_line = intern_string("__LINE__");
+    pp->id_file = intern_string("__FILE__");
 
     // Add predefined macros
     preprocessor_add_predefined_macros(pp);
@@ -43,17 +60,22 @@ void preprocessor_destroy(Preprocessor *pp) {
     // Free include stack
     for (int i = 0; i < pp->include_depth; i++) {
         free(pp->include_stack[i].filename);
-        free(pp->include_stack[i].content);
     }
 
-    // Free macro file_defined strings (if they exist in the struct)
-    // Note: Currently commented out due to missing field in header
-    // for (int i = 0; i < pp->macro_count; i++) {
-    //     if (pp->macros[i].file_defined) {
-    //         free(pp->macros[i].file_defined);
-    //     }
-    // }
+    for (int i = 0; i < pp->include_path_count; i++) {
+        free(pp->include_paths[i]);
+    }
+    free(pp->include_paths);
+    free(pp->once_files);
+    free(pp->included_files);
 
+    // Free macro table
+    for (size_t i = 0; i < pp->macro_capacity; i++) {
+        free_macro(pp->macros[i]);
+    }
+    free(pp->macros);
+
+    arena_destroy(pp->expand_arena);
     free(pp->output);
     free(pp->current_file);
     free(pp);
@@ -66,12 +88,13 @@ void preprocessor_add_predefined_macros(Preprocessor *pp) {
 
     // Date and time
     time_t now = time(NULL);
-    struct tm *tm_info = localtime(&now);
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
 
     char date_str[32];
     char time_str[32];
-    strftime(date_str, sizeof(date_str), "\"%b %d %Y\"", tm_info);
-    strftime(time_str, sizeof(time_str), "\"%H:%M:%S\"", tm_info);
+    strftime(date_str, sizeof(date_str), "\"%b %d %Y\"", &tm_info);
+    strftime(time_str, sizeof(time_str), "\"%H:%M:%S\"", &tm_info);
 
     preprocessor_define_macro(pp, "__DATE__", date_str);
     preprocessor_define_macro(pp, "__TIME__", time_str);
@@ -85,138 +108,175 @@ void preprocessor_add_predefined_macros(Preprocessor *pp) {
     preprocessor_define_macro(pp, "__STDC_VERSION__", "201112L");
 
     // Mark predefined macros
-    for (int i = 0; i < pp->macro_count; i++) {
-        pp->macros[i].is_predefined = true;
-    }
+    preprocessor_mark_predefined(pp);
 }
 
+// Preprocesses straight from the mapped file into the output buffer
 char* preprocessor_process_file(Preprocessor* pp, const char* filename) {
-    (void)pp; // Suppress unused parameter warning
-
-    char* content = read_file(filename);
-    if (!content) {
+    SourceFile source;
+    if (!source_file_open(&source, filename)) {
         return NULL;
     }
 
-    size_t content_len = strlen(content);
-    // Allocate extra space for potential additional newlines and safety margin
-    size_t result_capacity = content_len * 2 + 1024; // Double size plus safety margin
-    char* result = malloc(result_capacity);
-    if (!result) {
-        free(content);
-        return NULL;
+    char *output = preprocessor_process_buffer(pp, source.data, source.size, filename);
+    source_file_close(&source);
+    return output;
+}
+
+char* preprocessor_process_string(Preprocessor* pp, const char* source, const char* filename) {
+    return preprocessor_process_buffer(pp, source, strlen(source), filename);
+}
+
+// Runs one translation unit; returns NULL if any errors were reported
+char *preprocessor_process_buffer(Preprocessor *pp, const char *source, size_t length,
+                                  const char *filename) {
+    free(pp->current_file);
+    pp->current_file = strdup(filename);
+    pp->current_line = 1;
+    pp->error_count = 0;
+
+    // The output is about as large as the input, so reserve that up front
+    pp->output_size = 0;
+    preprocessor_reserve_output(pp, length + 1);
+
+    preprocessor_run(pp, source, length);
+
+    // Check for unmatched conditionals
+    if (pp->cond_stack_depth > 0) {
+        pp->current_line = pp->cond_stack[pp->cond_stack_depth - 1].line_number;
+        preprocessor_error(pp, "Unterminated conditional directive");
+        pp->cond_stack_depth = 0;
+        pp->skip_lines = false;
     }
-    result[0] = '\0';
-    size_t result_len = 0;
 
-    // Make a copy for strtok since it modifies the string
-    char* content_copy = strdup(content);
-    if (!content_copy) {
-        free(content);
-        free(result);
+    char *output = preprocessor_take_output(pp);
+    if (pp->error_count > 0) {
+        free(output);
         return NULL;
     }
+    return output;
+}
 
-    char* line = strtok(content_copy, "\n");
-    while (line != NULL) {
-        size_t line_len = strlen(line);
-
-        // Check if we have enough space (line + newline + null terminator)
-        if (result_len + line_len + 2 >= result_capacity) {
-            // Expand buffer
-            result_capacity *= 2;
-            char* new_result = realloc(result, result_capacity);
-            if (!new_result) {
-                free(content);
-                free(content_copy);
-                free(result);
-                return NULL;
-            }
-            result = new_result;
+void preprocessor_add_include_path(Preprocessor *pp, const char *dir) {
+    if (pp->include_path_count == pp->include_path_capacity) {
+        int capacity = pp->include_path_capacity ? pp->include_path_capacity * 2 : 8;
+        char **paths = realloc(pp->include_paths, (size_t)capacity * sizeof(char*));
+        if (!paths) {
+            error_fatal("Memory allocation failed for include paths");
+            return;
         }
+        pp->include_paths = paths;
+        pp->include_path_capacity = capacity;
+    }
 
-        if (line[0] == '#') {
-            // Process directive - don't add to output if it's an include
-            if (strncmp(line + 1, "include", 7) == 0) {
-                // Skip include lines - don't add them to output
-            } else {
-                // Handle other directives or add them as-is
-                strcpy(result + result_len, line);
-                result_len += line_len;
-                result[result_len++] = '\n';
-                result[result_len] = '\0';
-            }
-        } else {
-            // Regular code line - add to output
-            strcpy(result + result_len, line);
-            result_len += line_len;
-            result[result_len++] = '\n';
-            result[result_len] = '\0';
-        }
-        line = strtok(NULL, "\n");
+    // Drop trailing separators so "dir/" and "dir" are the same path
+    size_t length = strlen(dir);
+    while (length > 1 && (dir[length - 1] == '/' || dir[length - 1] == '\\')) {
+        length--;
     }
+    pp->include_paths[pp->include_path_count++] = strndup(dir, length);
+}
 
-    free(content);
-    free(content_copy);
-    return result;
+// ========================================
+// Macro table
+// ========================================
+// Open addressing with linear probing, keyed by interned name so a probe
+// compares pointers. Capacity is a power of two and the load factor is kept
+// at or below 1/2; #undef uses backward-shift deletion, so there are no
+// tombstones.
+
+static size_t macro_table_slot(const Preprocessor *pp, const char *name) {
+    size_t mask = pp->macro_capacity - 1;
+    size_t index = intern_hash(name) & mask;
+
+    while (pp->macros[index] && pp->macros[index]->name != name) {
+        index = (index + 1) & mask;
+    }
+    return index;
 }
 
-char* preprocessor_process_string(Preprocessor* pp, const char* source, const char* filename) {
-    pp->current_file = strdup(filename);
-    pp->current_line = 1;
-    pp->output_size = 0;
-    pp->output[0] = '\0';
+static bool macro_table_grow(Preprocessor *pp) {
+    size_t old_capacity = pp->macro_capacity;
+    Macro **old_slots = pp->macros;
 
-    char line[MAX_LINE_LENGTH];
-    const char* src_ptr = source;
+    size_t new_capacity = old_capacity ? old_capacity * 2 : MACRO_TABLE_INITIAL_CAPACITY;
+    Macro **new_slots = calloc(new_capacity, sizeof(Macro*));
+    if (!new_slots) {
+        error_fatal("Memory allocation failed for macro table");
+        return false;
+    }
 
-    while (*src_ptr) {
-        // Extract line
-        int i = 0;
-        while (*src_ptr && *src_ptr != '\n' && i < MAX_LINE_LENGTH - 1) {
-            line[i++] = *src_ptr++;
+    pp->macros = new_slots;
+    pp->macro_capacity = new_capacity;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_slots[i]) {
+            pp->macros[macro_table_slot(pp, old_slots[i]->name)] = old_slots[i];
         }
-        line[i] = '\0';
+    }
 
-        if (*src_ptr == '\n') {
-            src_ptr++;
-        }
+    free(old_slots);
+    return true;
+}
 
-        // Process line
-        if (preprocessor_should_skip_line(pp)) {
-            // Still need to process conditional directives when skipping
-            if (preprocessor_is_directive(line)) {
-                char *directive = preprocessor_get_directive_name(line);
-                if (directive && (strcmp(directive, "endif") == 0 ||
-                    strcmp(directive, "else") == 0 ||
-                    strcmp(directive, "elif") == 0)) {
-                    preprocessor_process_directive(pp, line);
-                }
-                free(directive);
-            }
-        } else {
-            if (preprocessor_is_directive(line)) {
-                if (!preprocessor_process_directive(pp, line)) {
-                    preprocessor_error(pp, "Error processing directive: %s", line);
-                }
-            } else {
-                // Expand macros and add to output
-                char *expanded = preprocessor_expand_macros(pp, line);
-                preprocessor_append_output(pp, expanded);
-                preprocessor_append_output(pp, "\n");
-                free(expanded);
-            }
-        }
+// Adds a new definition, replacing any previous one for the same name.
+// Takes ownership of the macro.
+bool preprocessor_add_macro(Preprocessor *pp, Macro *macro) {
+    if ((pp->macro_count + 1) * 2 > pp->macro_capacity && !macro_table_grow(pp)) {
+        free_macro(macro);
+        return false;
+    }
 
-        pp->current_line++;
+    size_t index = macro_table_slot(pp, macro->name);
+    Macro *previous = pp->macros[index];
+
+    if (previous) {
+        if (previous->is_predefined) {
+            preprocessor_warning(pp, "Redefining predefined macro '%s'", macro->name);
+        } else if (previous->type != macro->type || strcmp(previous->body, macro->body) != 0) {
+            preprocessor_warning(pp, "Macro '%s' redefined", macro->name);
+        }
+        free_macro(previous);
+    } else {
+        pp->macro_count++;
     }
 
-    // Check for unmatched conditionals
-    if (pp->cond_stack_depth > 0) {
-        preprocessor_error(pp, "Unmatched conditional directive");
+    pp->macros[index] = macro;
+    pp->macro_generation++;
+    return true;
+}
+
+// Defines a macro from its spelling, as if by "#define <head> <body>"
+static bool macro_define_text(Preprocessor *pp, const char *head, const char *body) {
+    size_t head_length = strlen(head);
+    size_t body_length = strlen(body);
+    char *text = malloc(head_length + body_length + 2);
+    if (!text) {
+        error_fatal("Memory allocation failed for macro '%s'", head);
+        return false;
     }
 
-    return strdup(pp->output);
+    memcpy(text, head, head_length);
+    text[head_length] = ' ';
+    memcpy(text + head_length + 1, body, body_length + 1);
+
+    PPTokenList tokens = {NULL, 0, 0};
+    preprocessor_lex_tokens(text, head_length + body_length + 1, &tokens);
+    bool result = preprocessor_define_tokens(pp, tokens.items, tokens.count);
+
+    preprocessor_tokens_free(&tokens);
+    free(text);
+    return result;
+}
+
+void free_macro(Macro *macro) {
+    if (!macro) return;
+
+    free(macro->body);
+    free(macro->params);
+    free(macro->tokens);
+    free(macro->expansion);
+    free(macro->file_defined);
+    free(macro);
 }
 
 bool preprocessor_define_macro(Preprocessor *pp, const char *name, const char *body) {
@@ -229,164 +289,117 @@ bool preprocessor_define_macro(Preprocessor *pp, const char *name, const char *b
         return false;
     }
 
-    // Check if we have space for more macros
-    if (pp->macro_count >= MAX_MACROS) {
-        preprocessor_error(pp, "Too many macros defined");
+    return macro_define_text(pp, name, body);
+}
+
+bool preprocessor_define_function_macro(Preprocessor *pp, const char *name,
+                                      const char *params[], int param_count, const char *body) {
+    if (!pp || !name || !body || param_count < 0 || strlen(name) == 0) {
         return false;
     }
 
-    // Get pointer to the macro structure in the array
-    void *macro_ptr = &pp->macros[pp->macro_count++];
-
-    // Access the macro struct directly - assuming standard macro structure
-    Macro *macro = (Macro *)macro_ptr;
+    // Spell the head as "name(a,b)" and let the #define path parse it
+    size_t head_length = strlen(name) + 3;
+    for (int i = 0; i < param_count; i++) {
+        head_length += strlen(params[i]) + 1;
+    }
 
-    // Use safe string copying with bounds checking
-    if (!safe_strcpy(macro->name, sizeof(macro->name), name)) {
-        pp->macro_count--; // Revert the increment
-        preprocessor_error(pp, "Macro name too long: %.50s", name);
+    char *head = malloc(head_length);
+    if (!head) {
+        error_fatal("Memory allocation failed for macro '%s'", name);
         return false;
     }
 
-    // Check if body fits in fixed array
-    if (!safe_strcpy(macro->body, sizeof(macro->body), body)) {
-        pp->macro_count--; // Revert the increment
-        preprocessor_warning(pp, "Macro body truncated: %.50s", name);
-        // Continue anyway with truncated body
-        strncpy(macro->body, body, sizeof(macro->body) - 1);
-        macro->body[sizeof(macro->body) - 1] = '\0';
+    char *cursor = head + sprintf(head, "%s(", name);
+    for (int i = 0; i < param_count; i++) {
+        cursor += sprintf(cursor, i ? ",%s" : "%s", params[i]);
     }
+    strcpy(cursor, ")");
 
-    macro->type = MACRO_OBJECT;
-    macro->param_count = 0;
-    macro->is_predefined = false;
-    macro->line_defined = pp->current_line;
-    // Note: file_defined field removed due to missing field in header
-
-    return true;
+    bool result = macro_define_text(pp, head, body);
+    free(head);
+    return result;
 }
 
-bool preprocessor_define_function_macro(Preprocessor *pp, const char *name,
-                                      const char *params[], int param_count, const char *body) {
-    if (pp->macro_count >= MAX_MACROS) {
-        preprocessor_error(pp, "Too many macros defined");
+bool preprocessor_undefine_macro(Preprocessor *pp, const char *name) {
+    Macro *macro = preprocessor_find_macro(pp, name);
+    if (!macro) {
         return false;
     }
 
-    if (param_count > MAX_MACRO_PARAMS) {
-        preprocessor_error(pp, "Too many macro parameters");
+    // Don't allow undefining predefined macros
+    if (macro->is_predefined) {
+        preprocessor_warning(pp, "Cannot undefine predefined macro '%s'", name);
         return false;
     }
 
-    void *macro_ptr = &pp->macros[pp->macro_count++];
-
-    Macro *macro = (Macro *)macro_ptr;
-
-    strncpy(macro->name, name, sizeof(macro->name) - 1);
-    macro->name[sizeof(macro->name) - 1] = '\0';
-
-    strncpy(macro->body, body, sizeof(macro->body) - 1);
-    macro->body[sizeof(macro->body) - 1] = '\0';
-
-    macro->type = MACRO_FUNCTION;
-    macro->param_count = param_count;
-    macro->is_predefined = false;
-    macro->line_defined = pp->current_line;
-    // Note: file_defined field removed due to missing field in header
-
-    for (int i = 0; i < param_count; i++) {
-        strncpy(macro->params[i].name, params[i], sizeof(macro->params[i].name) - 1);
-        macro->params[i].name[sizeof(macro->params[i].name) - 1] = '\0';
+    size_t mask = pp->macro_capacity - 1;
+    size_t hole = macro_table_slot(pp, macro->name);
+    pp->macros[hole] = NULL;
+    pp->macro_count--;
+    pp->macro_generation++;
+    free_macro(macro);
+
+    // Pull later members of the probe run back into the hole whenever the
+    // hole lies between their home slot and where they are now
+    for (size_t next = (hole + 1) & mask; pp->macros[next]; next = (next + 1) & mask) {
+        size_t home = intern_hash(pp->macros[next]->name) & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            pp->macros[hole] = pp->macros[next];
+            pp->macros[next] = NULL;
+            hole = next;
+        }
     }
 
     return true;
 }
 
-bool preprocessor_undefine_macro(Preprocessor *pp, const char *name) {
-    for (int i = 0; i < pp->macro_count; i++) {
-        // Access macro fields through anonymous struct
-        void *macro_ptr = &pp->macros[i];
-        if (strcmp(((struct { char name[64]; char body[512]; int type; int param_count; bool is_predefined; int line_defined; char *file_defined; struct { char name[32]; } params[16]; } *)macro_ptr)->name, name) == 0) {
-            // Don't allow undefining predefined macros
-            if (((struct { char name[64]; char body[512]; int type; int param_count; bool is_predefined; int line_defined; char *file_defined; struct { char name[32]; } params[16]; } *)macro_ptr)->is_predefined) {
-                preprocessor_warning(pp, "Cannot undefine predefined macro '%s'", name);
-                return false;
-            }
-
-            // Free file_defined string
-            if (((struct { char name[64]; char body[512]; int type; int param_count; bool is_predefined; int line_defined; char *file_defined; struct { char name[32]; } params[16]; } *)macro_ptr)->file_defined) {
-                free(((struct { char name[64]; char body[512]; int type; int param_count; bool is_predefined; int line_defined; char *file_defined; struct { char name[32]; } params[16]; } *)macro_ptr)->file_defined);
-            }
-
-            // Shift remaining macros
-            for (int j = i; j < pp->macro_count - 1; j++) {
-                pp->macros[j] = pp->macros[j + 1];
-            }
-            pp->macro_count--;
-            return true;
-        }
+Macro *preprocessor_find_macro_n(Preprocessor *pp, const char *name, size_t length) {
+    if (!pp || !name || pp->macro_count == 0) {
+        return NULL;
     }
-    return false;
-}
 
-Macro *preprocessor_find_macro(Preprocessor *pp, const char *name) {
-    for (int i = 0; i < pp->macro_count; i++) {
-        Macro *macro = &pp->macros[i];
-        if (strcmp(macro->name, name) == 0) {
-            return macro;
-        }
+    // A spelling that was never interned cannot name a macro
+    const char *key = intern_lookup_n(name, length);
+    if (!key) {
+        return NULL;
     }
-    return NULL;
-}
 
-bool preprocessor_is_macro_defined(Preprocessor *pp, const char *name) {
-    return preprocessor_find_macro(pp, name) != NULL;
+    return pp->macros[macro_table_slot(pp, key)];
 }
 
-char *preprocessor_expand_macros(Preprocessor *pp, const char *line) {
-    (void)pp; // Suppress unused parameter warning
-    return strdup(line); // Simplified for now - just return a copy
+Macro *preprocessor_lookup_macro(Preprocessor *pp, const char *interned) {
+    if (pp->macro_count == 0) {
+        return NULL;
+    }
+    return pp->macros[macro_table_slot(pp, interned)];
 }
 
-char *preprocessor_expand_function_macro(Preprocessor *pp, Macro *macro,
-                                       const char *args[], int arg_count) {
-    (void)args; // Suppress unused parameter warning
+Macro *preprocessor_find_macro(Preprocessor *pp, const char *name) {
+    return name ? preprocessor_find_macro_n(pp, name, strlen(name)) : NULL;
+}
 
-    void *macro_ptr = (void *)macro;
-    if (arg_count != ((struct { char name[64]; char body[512]; int type; int param_count; bool is_predefined; int line_defined; char *file_defined; struct { char name[32]; } params[16]; } *)macro_ptr)->param_count) {
-        preprocessor_error(pp, "Macro '%s' expects %d arguments, got %d",
-                         ((struct { char name[64]; char body[512]; int type; int param_count; bool is_predefined; int line_defined; char *file_defined; struct { char name[32]; } params[16]; } *)macro_ptr)->name, ((struct { char name[64]; char body[512]; int type; int param_count; bool is_predefined; int line_defined; char *file_defined; struct { char name[32]; } params[16]; } *)macro_ptr)->param_count, arg_count);
-        return strdup(((struct { char name[64]; char body[512]; int type; int param_count; bool is_predefined; int line_defined; char *file_defined; struct { char name[32]; } params[16]; } *)macro_ptr)->body);
+void preprocessor_mark_predefined(Preprocessor *pp) {
+    for (size_t i = 0; i < pp->macro_capacity; i++) {
+        if (pp->macros[i]) {
+            pp->macros[i]->is_predefined = true;
+        }
     }
-
-    return strdup(((struct { char name[64]; char body[512]; int type; int param_count; bool is_predefined; int line_defined; char *file_defined; struct { char name[32]; } params[16]; } *)macro_ptr)->body); // Simplified for now
 }
 
-char *preprocessor_substitute_params(const char *body, const char *params[],
-                                   const char *args[], int param_count) {
-    (void)params; // Suppress unused parameter warning
-    (void)args; // Suppress unused parameter warning
-    (void)param_count; // Suppress unused parameter warning
-    return strdup(body); // Simplified for now
+bool preprocessor_is_macro_defined(Preprocessor *pp, const char *name) {
+    return preprocessor_find_macro(pp, name) != NULL;
 }
 
 bool preprocessor_process_directive(Preprocessor *pp, const char *line) {
-    char *directive = preprocessor_get_directive_name(line);
-    if (!directive) return false;
+    if (!preprocessor_is_directive(line)) return false;
 
-    bool result = false;
+    PPTokenList tokens = {NULL, 0, 0};
+    preprocessor_lex_tokens(line, strlen(line), &tokens);
 
-    if (strcmp(directive, "define") == 0) {
-        result = preprocessor_handle_define(pp, line);
-    } else if (strcmp(directive, "undef") == 0) {
-        result = preprocessor_handle_undef(pp, line);
-    } else if (strcmp(directive, "include") == 0) {
-        result = preprocessor_handle_include(pp, line);
-    } else {
-        preprocessor_error(pp, "Unknown directive: #%s", directive);
-    }
-
-    free(directive);
+    // tokens[0] is the '#'
+    bool result = preprocessor_handle_directive_tokens(pp, tokens.items + 1, tokens.count - 1);
+    preprocessor_tokens_free(&tokens);
     return result;
 }
 
@@ -397,21 +410,11 @@ bool preprocessor_handle_define(Preprocessor *pp, const char *directive) {
         return false;
     }
 
-    char *name = strtok(args, " \t");
-    if (!name) {
-        free(args);
-        preprocessor_error(pp, "Missing macro name in #define");
-        return false;
-    }
-
-    // Object-like macro
-    char *body = strtok(NULL, ""); // Get rest of line
-    if (!body) body = "";
+    PPTokenList tokens = {NULL, 0, 0};
+    preprocessor_lex_tokens(args, strlen(args), &tokens);
+    bool result = preprocessor_define_tokens(pp, tokens.items, tokens.count);
 
-    // Skip leading whitespace in body
-    while (*body && isspace(*body)) body++;
-
-    bool result = preprocessor_define_macro(pp, name, body);
+    preprocessor_tokens_free(&tokens);
     free(args);
     return result;
 }
@@ -517,21 +520,48 @@ char *preprocessor_stringify(const char *text) {
     return result;
 }
 
-void preprocessor_append_output(Preprocessor *pp, const char *text) {
-    size_t text_len = strlen(text);
-    size_t needed = pp->output_size + text_len + 1;
-
-    if (needed > pp->output_capacity) {
-        pp->output_capacity = needed * 2;
-        pp->output = realloc(pp->output, pp->output_capacity);
-        if (!pp->output) {
-            error_fatal("Memory allocation failed for preprocessor output");
-            return;
-        }
+// Makes room for at least `extra` more bytes plus the terminator
+void preprocessor_reserve_output(Preprocessor *pp, size_t extra) {
+    size_t needed = pp->output_size + extra + 1;
+    if (needed <= pp->output_capacity) {
+        return;
+    }
+
+    size_t capacity = pp->output_capacity ? pp->output_capacity : 4096;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+
+    char *output = realloc(pp->output, capacity);
+    if (!output) {
+        error_fatal("Memory allocation failed for preprocessor output");
+        return;
     }
 
-    strcpy(pp->output + pp->output_size, text);
-    pp->output_size += text_len;
+    pp->output = output;
+    pp->output_capacity = capacity;
+}
+
+void preprocessor_append_output_n(Preprocessor *pp, const char *text, size_t length) {
+    preprocessor_reserve_output(pp, length);
+    memcpy(pp->output + pp->output_size, text, length);
+    pp->output_size += length;
+    pp->output[pp->output_size] = '\0';
+}
+
+void preprocessor_append_output(Preprocessor *pp, const char *text) {
+    preprocessor_append_output_n(pp, text, strlen(text));
+}
+
+// Hands the output buffer to the caller; the next run starts a fresh one
+char *preprocessor_take_output(Preprocessor *pp) {
+    preprocessor_reserve_output(pp, 0);
+
+    char *output = pp->output;
+    pp->output = NULL;
+    pp->output_size = 0;
+    pp->output_capacity = 0;
+    return output;
 }
 
 bool preprocessor_should_skip_line(Preprocessor *pp) {
@@ -548,9 +578,10 @@ void preprocessor_push_conditional(Preprocessor *pp, ConditionalType type, bool
     cond->type = type;
     cond->condition_met = condition;
     cond->else_taken = false;
+    cond->was_skipping = pp->skip_lines;
     cond->line_number = pp->current_line;
 
-    pp->skip_lines = !condition;
+    pp->skip_lines = cond->was_skipping || !condition;
 }
 
 bool preprocessor_pop_conditional(Preprocessor *pp) {
@@ -559,12 +590,13 @@ bool preprocessor_pop_conditional(Preprocessor *pp) {
     }
 
     pp->cond_stack_depth--;
-    pp->skip_lines = preprocessor_should_skip_line(pp);
+    pp->skip_lines = pp->cond_stack[pp->cond_stack_depth].was_skipping;
 
     return true;
 }
 
 int preprocessor_error(Preprocessor* pp, const char* format, ...) {
+    pp->error_count++;
     fprintf(stderr, "Preprocessor error in %s:%d: ",
             pp->current_file ? pp->current_file : "unknown", pp->current_line);
 
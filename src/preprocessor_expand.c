@@ -0,0 +1,1924 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+#include "preprocessor.h"
+#include "kcc.h"
+#include "lexer_scan.h"
+#include "include_cache.h"
+
+// Token-based macro expansion.
+// Source text is lexed once into preprocessing tokens which are expanded as
+// they stream by (Prosser's algorithm: every token carries the hide-set of
+// macros it came from, so recursion stops without re-scanning text). Macro
+// bodies are pre-lexed at #define time, and the expansion of an object-like
+// macro is memoized until the next #define/#undef.
+
+// ========================================
+// Token lists
+// ========================================
+
+void preprocessor_tokens_push(PPTokenList *list, const PPToken *token) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 16;
+        PPToken *items = realloc(list->items, capacity * sizeof(PPToken));
+        if (!items) {
+            error_fatal("Memory allocation failed for preprocessing tokens");
+            return;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = *token;
+}
+
+void preprocessor_tokens_free(PPTokenList *list) {
+    free(list->items);
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+static bool pp_is_punct(const PPToken *token, const char *spelling) {
+    return token->kind == PP_PUNCT && strcmp(token->text, spelling) == 0;
+}
+
+static PPToken pp_make_token(PPTokenKind kind, const char *text, int line, unsigned char flags) {
+    PPToken token;
+    token.text = text;
+    token.hideset = NULL;
+    token.line = line;
+    token.column = 0;
+    token.param = -1;
+    token.kind = (unsigned char)kind;
+    token.flags = flags;
+    return token;
+}
+
+// ========================================
+// Lexing
+// ========================================
+
+typedef struct PPLexer {
+    const char *cur;
+    const char *end;
+    int line;
+    const char *line_begin;      // Where the current source line starts
+    bool line_start;             // Next token is the first on its line
+    bool skipping;               // Inside a false group: don't intern words
+    bool has_peek;
+    PPToken peek;
+} PPLexer;
+
+// Multi-character punctuators, longest first
+static const struct {
+    const char *text;
+    size_t length;
+} pp_punctuators[] = {
+    {"...", 3}, {"<<=", 3}, {">>=", 3},
+    {"->", 2}, {"++", 2}, {"--", 2}, {"<<", 2}, {">>", 2}, {"<=", 2}, {">=", 2},
+    {"==", 2}, {"!=", 2}, {"&&", 2}, {"||", 2}, {"*=", 2}, {"/=", 2}, {"%=", 2},
+    {"+=", 2}, {"-=", 2}, {"&=", 2}, {"^=", 2}, {"|=", 2}, {"##", 2},
+    {NULL, 0}
+};
+
+static void pp_lexer_init(PPLexer *lx, const char *text, size_t length) {
+    memset(lx, 0, sizeof(PPLexer));
+    lx->cur = text;
+    lx->end = text + length;
+    lx->line = 1;
+    lx->line_begin = text;
+    lx->line_start = true;
+}
+
+static const char *pp_skip_literal(const char *p, const char *end, char quote) {
+    p++; // Opening quote
+    while (p < end && *p != quote && *p != '\n') {
+        if (*p == '\\' && p + 1 < end) p++;
+        p++;
+    }
+    return p < end && *p == quote ? p + 1 : p;
+}
+
+static void pp_lex(PPLexer *lx, PPToken *token) {
+    const char *p = lx->cur;
+    const char *end = lx->end;
+    unsigned char flags = 0;
+
+    // Whitespace, comments and line splices
+    while (p < end) {
+        const char *q = lexer_scan_whitespace(p, end);
+        if (q != p) {
+            const char *last_newline = NULL;
+            size_t newlines = lexer_scan_count_newlines(p, q, &last_newline);
+            if (newlines) {
+                lx->line += (int)newlines;
+                lx->line_begin = last_newline + 1;
+                lx->line_start = true;
+            }
+            flags |= PP_SPACE_BEFORE;
+            p = q;
+            continue;
+        }
+
+        if (*p == '\\' && end - p >= 2 && (p[1] == '\n' || (p[1] == '\r' && end - p >= 3 && p[2] == '\n'))) {
+            p += p[1] == '\n' ? 2 : 3;
+            lx->line++;
+            lx->line_begin = p;
+            continue;
+        }
+
+        if (*p == '/' && end - p >= 2 && p[1] == '*') {
+            const char *q = p + 2;
+            for (;;) {
+                q = lexer_scan_until2(q, end, '*', '*');
+                if (end - q < 2) {
+                    q = end;
+                    break;
+                }
+                if (q[1] == '/') {
+                    q += 2;
+                    break;
+                }
+                q++;
+            }
+            const char *last_newline = NULL;
+            size_t newlines = lexer_scan_count_newlines(p, q, &last_newline);
+            if (newlines) {
+                lx->line += (int)newlines;
+                lx->line_begin = last_newline + 1;
+            }
+            flags |= PP_SPACE_BEFORE;
+            p = q;
+            continue;
+        }
+
+        if (*p == '/' && end - p >= 2 && p[1] == '/') {
+            p = lexer_scan_until2(p + 2, end, '\n', '\n');
+            flags |= PP_SPACE_BEFORE;
+            continue;
+        }
+
+        break;
+    }
+
+    if (lx->line_start) {
+        flags |= PP_LINE_START;
+        lx->line_start = false;
+    }
+
+    if (p >= end) {
+        lx->cur = p;
+        *token = pp_make_token(PP_EOF, "", lx->line, flags | PP_LINE_START);
+        return;
+    }
+
+    const char *start = p;
+    PPTokenKind kind;
+    unsigned char c = (unsigned char)*p;
+
+    if (isalpha(c) || c == '_' || c == '$') {
+        // Encoding prefixes belong to the literal that follows them
+        const char *q = p;
+        if (*q == 'u' && end - q >= 2 && q[1] == '8') q += 2;
+        else if (*q == 'u' || *q == 'U' || *q == 'L') q++;
+
+        if (q != p && q < end && (*q == '"' || *q == '\'')) {
+            kind = *q == '"' ? PP_STRING : PP_CHAR;
+            p = pp_skip_literal(q, end, *q);
+        } else {
+            kind = PP_IDENT;
+            p = lexer_scan_identifier(p, end);
+            while (p < end && *p == '$') p = lexer_scan_identifier(p + 1, end);
+        }
+    } else if (isdigit(c) || (c == '.' && end - p >= 2 && isdigit((unsigned char)p[1]))) {
+        // pp-number: digits, letters, '_', '.' and signed exponents
+        kind = PP_NUMBER;
+        p++;
+        while (p < end) {
+            char d = *p;
+            if ((d == '+' || d == '-') && strchr("eEpP", p[-1])) {
+                p++;
+            } else if (isalnum((unsigned char)d) || d == '_' || d == '.') {
+                p++;
+            } else {
+                break;
+            }
+        }
+    } else if (c == '"' || c == '\'') {
+        kind = c == '"' ? PP_STRING : PP_CHAR;
+        p = pp_skip_literal(p, end, (char)c);
+    } else {
+        kind = PP_PUNCT;
+        size_t length = 1;
+        if (end - p >= 2) {
+            for (int i = 0; pp_punctuators[i].text; i++) {
+                size_t n = pp_punctuators[i].length;
+                if (pp_punctuators[i].text[0] == c && (size_t)(end - p) >= n &&
+                    memcmp(p, pp_punctuators[i].text, n) == 0) {
+                    length = n;
+                    break;
+                }
+            }
+        }
+        if (length == 1 && !strchr("[](){}.&*+-~!/%<>^|?:;=,#", c)) {
+            kind = PP_OTHER;
+        }
+        p += length;
+    }
+
+    lx->cur = p;
+
+    // Words in skipped groups are never looked at, so don't intern them
+    const char *text = NULL;
+    if (!lx->skipping || kind == PP_PUNCT) {
+        text = intern_string_n(start, (size_t)(p - start));
+    }
+    *token = pp_make_token(kind, text, lx->line, flags);
+    token->column = (int)(start - lx->line_begin) + 1;
+}
+
+static const PPToken *pp_lexer_peek(PPLexer *lx) {
+    if (!lx->has_peek) {
+        pp_lex(lx, &lx->peek);
+        lx->has_peek = true;
+    }
+    return &lx->peek;
+}
+
+static void pp_lexer_read(PPLexer *lx, PPToken *token) {
+    if (lx->has_peek) {
+        *token = lx->peek;
+        lx->has_peek = false;
+    } else {
+        pp_lex(lx, token);
+    }
+}
+
+static bool pp_is_directive_start(const PPToken *token) {
+    return (token->flags & PP_LINE_START) && token->kind == PP_PUNCT &&
+           token->text[0] == '#' && token->text[1] == '\0';
+}
+
+void preprocessor_lex_tokens(const char *text, size_t length, PPTokenList *out) {
+    PPLexer lx;
+    pp_lexer_init(&lx, text, length);
+
+    for (;;) {
+        PPToken token;
+        pp_lexer_read(&lx, &token);
+        if (token.kind == PP_EOF) break;
+        preprocessor_tokens_push(out, &token);
+    }
+}
+
+// ========================================
+// Spelling
+// ========================================
+
+static bool pp_is_word_char(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == '$';
+}
+
+// True if writing `next` straight after `prev` would lex differently
+static bool pp_would_paste(const char *prev, const char *next) {
+    static const char *pairs[] = {
+        "++", "--", "<<", ">>", "&&", "||", "==", "!=", "<=", ">=", "->",
+        "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "##", "..", "/*", "//",
+        NULL
+    };
+
+    char a = prev[intern_length(prev) - 1];
+    char b = next[0];
+
+    bool number = isdigit((unsigned char)prev[0]) || (prev[0] == '.' && isdigit((unsigned char)prev[1]));
+
+    if (pp_is_word_char(a) && pp_is_word_char(b)) return true;
+    if (number && (b == '.' || ((b == '+' || b == '-') && strchr("eEpP", a)))) return true;
+    if (a == '.' && isdigit((unsigned char)b)) return true;
+    if ((b == '"' || b == '\'') &&
+        (!strcmp(prev, "L") || !strcmp(prev, "u") || !strcmp(prev, "U") || !strcmp(prev, "u8"))) return true;
+
+    for (int i = 0; pairs[i]; i++) {
+        if (pairs[i][0] == a && pairs[i][1] == b) return true;
+    }
+    return false;
+}
+
+static void pp_spell_append(char **buffer, size_t *length, size_t *capacity, const char *text, size_t n) {
+    if (*length + n + 1 > *capacity) {
+        size_t new_capacity = *capacity ? *capacity * 2 : 64;
+        while (new_capacity < *length + n + 1) new_capacity *= 2;
+        char *grown = realloc(*buffer, new_capacity);
+        if (!grown) {
+            error_fatal("Memory allocation failed for macro text");
+            return;
+        }
+        *buffer = grown;
+        *capacity = new_capacity;
+    }
+    memcpy(*buffer + *length, text, n);
+    *length += n;
+    (*buffer)[*length] = '\0';
+}
+
+char *preprocessor_spell_tokens(const PPToken *tokens, size_t count) {
+    char *buffer = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+    const char *prev = NULL;
+
+    pp_spell_append(&buffer, &length, &capacity, "", 0);
+    for (size_t i = 0; i < count; i++) {
+        const PPToken *token = &tokens[i];
+        if (token->kind == PP_PLACEMARKER) continue;
+
+        if (prev && ((token->flags & PP_SPACE_BEFORE) || pp_would_paste(prev, token->text))) {
+            pp_spell_append(&buffer, &length, &capacity, " ", 1);
+        }
+        pp_spell_append(&buffer, &length, &capacity, token->text, intern_length(token->text));
+        prev = token->text;
+    }
+    return buffer;
+}
+
+// Writes one token to the preprocessor output, keeping output lines and
+// columns in step with the source so the compiler's diagnostics point at the
+// right place. Tokens from macro expansions have no column of their own and
+// are spaced as the source spaced them.
+static void pp_emit(Preprocessor *pp, const PPToken *token) {
+    if (token->line > pp->output_line) {
+        while (pp->output_line < token->line) {
+            preprocessor_append_output_n(pp, "\n", 1);
+            pp->output_line++;
+        }
+        pp->output_line_start = pp->output_size;
+        pp->output_last = NULL;
+    }
+
+    int column = (int)(pp->output_size - pp->output_line_start) + 1;
+    if (token->column > column) {
+        static const char spaces[] = "                ";
+        int pad = token->column - column;
+        while (pad > 0) {
+            int n = pad < (int)sizeof(spaces) - 1 ? pad : (int)sizeof(spaces) - 1;
+            preprocessor_append_output_n(pp, spaces, (size_t)n);
+            pad -= n;
+        }
+    } else if (pp->output_last &&
+               ((token->flags & PP_SPACE_BEFORE) || pp_would_paste(pp->output_last, token->text))) {
+        preprocessor_append_output_n(pp, " ", 1);
+    }
+
+    preprocessor_append_output_n(pp, token->text, intern_length(token->text));
+    pp->output_last = token->text;
+}
+
+static PPToken pp_stringize(const PPTokenList *arg, int line, unsigned char flags) {
+    char *buffer = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+
+    pp_spell_append(&buffer, &length, &capacity, "\"", 1);
+    for (size_t i = 0; i < arg->count; i++) {
+        const PPToken *token = &arg->items[i];
+        if (token->kind == PP_PLACEMARKER) continue;
+        if (i > 0 && (token->flags & PP_SPACE_BEFORE)) {
+            pp_spell_append(&buffer, &length, &capacity, " ", 1);
+        }
+
+        const char *text = token->text;
+        size_t n = intern_length(text);
+        if (token->kind == PP_STRING || token->kind == PP_CHAR) {
+            for (size_t j = 0; j < n; j++) {
+                if (text[j] == '"' || text[j] == '\\') {
+                    pp_spell_append(&buffer, &length, &capacity, "\\", 1);
+                }
+                pp_spell_append(&buffer, &length, &capacity, text + j, 1);
+            }
+        } else {
+            pp_spell_append(&buffer, &length, &capacity, text, n);
+        }
+    }
+    pp_spell_append(&buffer, &length, &capacity, "\"", 1);
+
+    PPToken result = pp_make_token(PP_STRING, intern_string_n(buffer, length), line, flags);
+    free(buffer);
+    return result;
+}
+
+// ========================================
+// Hide-sets
+// ========================================
+
+static bool hideset_contains(const PPHideSet *hs, const char *name) {
+    for (; hs; hs = hs->next) {
+        if (hs->name == name) return true;
+    }
+    return false;
+}
+
+static PPHideSet *hideset_add(Preprocessor *pp, PPHideSet *hs, const char *name) {
+    if (hideset_contains(hs, name)) {
+        return hs;
+    }
+    PPHideSet *node = arena_alloc(pp->expand_arena, sizeof(PPHideSet));
+    node->name = name;
+    node->next = hs;
+    return node;
+}
+
+static PPHideSet *hideset_union(Preprocessor *pp, PPHideSet *a, PPHideSet *b) {
+    if (!a) return b;
+    if (!b) return a;
+    for (; a; a = a->next) {
+        b = hideset_add(pp, b, a->name);
+    }
+    return b;
+}
+
+static PPHideSet *hideset_intersection(Preprocessor *pp, PPHideSet *a, PPHideSet *b) {
+    PPHideSet *result = NULL;
+    for (; a; a = a->next) {
+        if (hideset_contains(b, a->name)) {
+            result = hideset_add(pp, result, a->name);
+        }
+    }
+    return result;
+}
+
+// ========================================
+// Expansion
+// ========================================
+
+typedef struct PPExpander {
+    Preprocessor *pp;
+    PPLexer *lexer;              // Source text, stopping at directives...
+    const PPToken *list;         // ...or a fixed token list
+    size_t list_pos;
+    size_t list_count;
+    PPTokenList pending;         // Replacement tokens; the top is read next
+    bool probing;                // Building a memo: fail quietly
+    bool failed;
+} PPExpander;
+
+static void pp_expander_init(PPExpander *ex, Preprocessor *pp, PPLexer *lexer,
+                             const PPToken *list, size_t count) {
+    memset(ex, 0, sizeof(PPExpander));
+    ex->pp = pp;
+    ex->lexer = lexer;
+    ex->list = list;
+    ex->list_count = count;
+}
+
+static const PPToken *pp_peek(PPExpander *ex) {
+    if (ex->pending.count) {
+        return &ex->pending.items[ex->pending.count - 1];
+    }
+    if (ex->lexer) {
+        const PPToken *token = pp_lexer_peek(ex->lexer);
+        return token->kind == PP_EOF || pp_is_directive_start(token) ? NULL : token;
+    }
+    return ex->list_pos < ex->list_count ? &ex->list[ex->list_pos] : NULL;
+}
+
+static bool pp_next(PPExpander *ex, PPToken *token) {
+    if (ex->pending.count) {
+        *token = ex->pending.items[--ex->pending.count];
+        return true;
+    }
+    if (!pp_peek(ex)) {
+        return false;
+    }
+    if (ex->lexer) {
+        pp_lexer_read(ex->lexer, token);
+        ex->pp->current_line = token->line;
+    } else {
+        *token = ex->list[ex->list_pos++];
+    }
+    return true;
+}
+
+// Queues replacement tokens so they are read before anything else
+static void pp_push_front(PPExpander *ex, const PPTokenList *tokens) {
+    for (size_t i = tokens->count; i > 0; i--) {
+        preprocessor_tokens_push(&ex->pending, &tokens->items[i - 1]);
+    }
+}
+
+static bool pp_expand_next(PPExpander *ex, PPToken *out);
+
+// Fully macro-expands a token list in isolation (argument pre-expansion)
+static void pp_expand_list(Preprocessor *pp, const PPToken *tokens, size_t count,
+                           PPTokenList *out, bool *failed) {
+    PPExpander sub;
+    pp_expander_init(&sub, pp, NULL, tokens, count);
+    sub.probing = failed != NULL;
+
+    PPToken token;
+    while (pp_expand_next(&sub, &token)) {
+        preprocessor_tokens_push(out, &token);
+    }
+    if (failed && sub.failed) {
+        *failed = true;
+    }
+    preprocessor_tokens_free(&sub.pending);
+}
+
+// Reads the arguments of a function-like macro after its '('
+static bool pp_collect_args(PPExpander *ex, Macro *macro, PPTokenList *args,
+                            PPToken *rparen) {
+    int slots = macro->param_count > 0 ? macro->param_count : 1;
+    int index = 0;
+    int depth = 0;
+
+    for (;;) {
+        PPToken token;
+        if (!pp_next(ex, &token)) {
+            if (ex->probing) {
+                ex->failed = true;
+            } else {
+                preprocessor_error(ex->pp, "Unterminated argument list invoking macro '%s'", macro->name);
+            }
+            return false;
+        }
+
+        if (token.flags & PP_LINE_START) {
+            token.flags = (unsigned char)((token.flags & ~PP_LINE_START) | PP_SPACE_BEFORE);
+        }
+
+        if (token.kind == PP_PUNCT) {
+            if (pp_is_punct(&token, "(")) {
+                depth++;
+            } else if (pp_is_punct(&token, ")")) {
+                if (depth == 0) {
+                    *rparen = token;
+                    break;
+                }
+                depth--;
+            } else if (depth == 0 && pp_is_punct(&token, ",") &&
+                       !(macro->is_variadic && index == macro->param_count - 1)) {
+                index++;
+                continue;
+            }
+        }
+
+        if (index < slots) {
+            preprocessor_tokens_push(&args[index], &token);
+        }
+    }
+
+    int given = index + 1;
+    if (macro->param_count == 0 && given == 1 && args[0].count == 0) {
+        return true;
+    }
+    if (given == macro->param_count ||
+        (macro->is_variadic && given == macro->param_count - 1)) {
+        return true;
+    }
+
+    if (ex->probing) {
+        ex->failed = true;
+    } else {
+        preprocessor_error(ex->pp, "Macro '%s' expects %d arguments, got %d",
+                           macro->name, macro->param_count, given);
+    }
+    return false;
+}
+
+// Joins two tokens with ##, re-lexing the combined spelling
+static PPToken pp_paste(Preprocessor *pp, const PPToken *left, const PPToken *right) {
+    if (left->kind == PP_PLACEMARKER) return *right;
+    if (right->kind == PP_PLACEMARKER) return *left;
+
+    size_t left_length = intern_length(left->text);
+    size_t right_length = intern_length(right->text);
+    char *joined = malloc(left_length + right_length + 1);
+    if (!joined) {
+        error_fatal("Memory allocation failed for token paste");
+        return *left;
+    }
+    memcpy(joined, left->text, left_length);
+    memcpy(joined + left_length, right->text, right_length);
+    joined[left_length + right_length] = '\0';
+
+    PPLexer lx;
+    pp_lexer_init(&lx, joined, left_length + right_length);
+    PPToken result;
+    pp_lexer_read(&lx, &result);
+
+    if (lx.cur != lx.end || (result.flags & PP_SPACE_BEFORE)) {
+        preprocessor_error(pp, "Pasting \"%s\" and \"%s\" does not give a valid preprocessing token",
+                           left->text, right->text);
+        result = *left;
+    } else {
+        result.hideset = left->hideset;
+        result.line = left->line;
+        result.column = left->column;
+        result.flags = left->flags & PP_SPACE_BEFORE;
+    }
+
+    free(joined);
+    return result;
+}
+
+// Builds the replacement for one invocation: parameters substituted, # and
+// ## applied, and `hideset` added to every resulting token
+static void pp_subst(PPExpander *ex, Macro *macro, PPTokenList *args, PPHideSet *hideset,
+                     const PPToken *origin, PPTokenList *out) {
+    Preprocessor *pp = ex->pp;
+    PPTokenList body = {NULL, 0, 0, };
+    PPTokenList *expanded = NULL;
+
+    if (macro->param_count > 0) {
+        expanded = calloc((size_t)macro->param_count, sizeof(PPTokenList));
+        if (!expanded) {
+            error_fatal("Memory allocation failed for macro arguments");
+            return;
+        }
+    }
+
+    for (int i = 0; i < macro->token_count; i++) {
+        const PPToken *token = &macro->tokens[i];
+
+        if (token->flags & PP_STRINGIZE_OP) {
+            const PPToken *param = &macro->tokens[++i];
+            PPToken str = pp_stringize(&args[param->param], origin->line, token->flags & PP_SPACE_BEFORE);
+            preprocessor_tokens_push(&body, &str);
+            continue;
+        }
+
+        if (token->param >= 0) {
+            PPTokenList *arg = &args[token->param];
+            bool pasted = (i + 1 < macro->token_count && (macro->tokens[i + 1].flags & PP_PASTE_OP)) ||
+                          (i > 0 && (macro->tokens[i - 1].flags & PP_PASTE_OP));
+
+            const PPTokenList *source = arg;
+            if (!pasted) {
+                // Arguments are expanded once, however often they are used
+                PPTokenList *cached = &expanded[token->param];
+                if (!cached->items && arg->count) {
+                    pp_expand_list(pp, arg->items, arg->count, cached,
+                                   ex->probing ? &ex->failed : NULL);
+                }
+                source = cached;
+            }
+
+            if (source->count == 0) {
+                if (pasted) {
+                    PPToken marker = pp_make_token(PP_PLACEMARKER, "", origin->line, 0);
+                    marker.param = token->param;
+                    preprocessor_tokens_push(&body, &marker);
+                }
+                continue;
+            }
+
+            for (size_t j = 0; j < source->count; j++) {
+                PPToken copy = source->items[j];
+                copy.flags &= (unsigned char)~(PP_PASTE_OP | PP_STRINGIZE_OP | PP_LINE_START);
+                copy.param = j == 0 ? token->param : -1;
+                if (j == 0) {
+                    copy.flags = (unsigned char)((copy.flags & ~PP_SPACE_BEFORE) |
+                                                 (token->flags & PP_SPACE_BEFORE));
+                }
+                preprocessor_tokens_push(&body, &copy);
+            }
+            continue;
+        }
+
+        preprocessor_tokens_push(&body, token);
+    }
+
+    // Apply ## left to right, then drop placemarkers
+    for (size_t i = 0; i < body.count; i++) {
+        PPToken token = body.items[i];
+
+        if ((token.flags & PP_PASTE_OP) && out->count > 0 && i + 1 < body.count) {
+            PPToken *left = &out->items[out->count - 1];
+            const PPToken *right = &body.items[++i];
+
+            // GNU: ", ## __VA_ARGS__" drops the comma when no variadic
+            // arguments were given and pastes nothing otherwise
+            if (macro->is_variadic && right->param == macro->param_count - 1 &&
+                pp_is_punct(left, ",")) {
+                if (right->kind == PP_PLACEMARKER) {
+                    out->count--;
+                } else {
+                    preprocessor_tokens_push(out, right);
+                }
+                continue;
+            }
+
+            *left = pp_paste(pp, left, right);
+            continue;
+        }
+
+        preprocessor_tokens_push(out, &token);
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < out->count; i++) {
+        PPToken *token = &out->items[i];
+        if (token->kind == PP_PLACEMARKER) continue;
+
+        token->flags &= (unsigned char)~(PP_PASTE_OP | PP_STRINGIZE_OP | PP_LINE_START);
+        token->hideset = hideset_union(pp, token->hideset, hideset);
+        token->line = origin->line;
+        token->column = 0;
+        token->param = -1;
+        out->items[kept++] = *token;
+    }
+    out->count = kept;
+
+    // The first token takes the place and spacing of the macro name it replaces
+    if (out->count) {
+        out->items[0].flags = (unsigned char)((out->items[0].flags & ~PP_SPACE_BEFORE) |
+                                              (origin->flags & PP_SPACE_BEFORE));
+        out->items[0].column = origin->column;
+    }
+
+    for (int i = 0; i < macro->param_count; i++) {
+        preprocessor_tokens_free(&expanded[i]);
+    }
+    free(expanded);
+    preprocessor_tokens_free(&body);
+}
+
+// Expands an object-like macro in isolation and keeps the result. Every
+// memoized token is final except possibly a trailing function-like macro
+// name, which may still pick up arguments from the text that follows.
+static bool pp_memoize(Preprocessor *pp, Macro *macro) {
+    if (macro->expansion_generation == pp->macro_generation) {
+        return macro->expansion_count >= 0;
+    }
+
+    free(macro->expansion);
+    macro->expansion = NULL;
+    macro->expansion_count = -1;
+    macro->expansion_generation = pp->macro_generation;
+
+    PPExpander probe;
+    pp_expander_init(&probe, pp, NULL, NULL, 0);
+    probe.probing = true;
+
+    PPToken origin = pp_make_token(PP_IDENT, macro->name, 0, 0);
+    PPTokenList replacement = {NULL, 0, 0};
+    pp_subst(&probe, macro, NULL, hideset_add(pp, NULL, macro->name), &origin, &replacement);
+
+    PPTokenList result = {NULL, 0, 0};
+    bool failed = probe.failed;
+    pp_expand_list(pp, replacement.items, replacement.count, &result, &failed);
+    preprocessor_tokens_free(&replacement);
+
+    if (failed) {
+        preprocessor_tokens_free(&result);
+        return false;
+    }
+
+    for (size_t i = 0; i < result.count; i++) {
+        PPToken *token = &result.items[i];
+        bool trailing_call = false;
+
+        if (token->kind == PP_IDENT && i + 1 == result.count && !(token->flags & PP_PAINTED)) {
+            Macro *callee = preprocessor_lookup_macro(pp, token->text);
+            trailing_call = callee && callee->type == MACRO_FUNCTION &&
+                            !hideset_contains(token->hideset, callee->name);
+        }
+        if (token->kind == PP_IDENT && !trailing_call) {
+            token->flags |= PP_PAINTED;
+        }
+        token->hideset = NULL;
+    }
+
+    macro->expansion = result.items;
+    macro->expansion_count = (int)result.count;
+    return true;
+}
+
+// Dynamic macros whose value depends on where they are used
+static bool pp_expand_builtin(PPExpander *ex, PPToken *token) {
+    Preprocessor *pp = ex->pp;
+
+    if (token->text != pp->id_line && token->text != pp->id_file) {
+        return false;
+    }
+
+    // A memoized expansion must not capture the line it was built on
+    if (ex->probing) {
+        ex->failed = true;
+    }
+
+    if (token->text == pp->id_line) {
+        char number[32];
+        int length = snprintf(number, sizeof(number), "%d", pp->current_line);
+        token->text = intern_string_n(number, (size_t)length);
+        token->kind = PP_NUMBER;
+        return true;
+    }
+
+    // Stringizing a "literal" escapes any backslashes or quotes in the path
+    const char *file = pp->current_file ? pp->current_file : "<stdin>";
+    PPToken name = pp_make_token(PP_STRING, intern_string(file), token->line, 0);
+    PPTokenList raw = {&name, 1, 1};
+    int column = token->column;
+    *token = pp_stringize(&raw, token->line, token->flags);
+    token->column = column;
+    return true;
+}
+
+// Returns the next fully expanded token, or false at the end of the input
+// (or at the next directive when reading source text)
+static bool pp_expand_next(PPExpander *ex, PPToken *out) {
+    Preprocessor *pp = ex->pp;
+    PPToken token;
+
+    while (pp_next(ex, &token)) {
+        if (token.kind != PP_IDENT || (token.flags & PP_PAINTED)) {
+            *out = token;
+            return true;
+        }
+
+        Macro *macro = preprocessor_lookup_macro(pp, token.text);
+        if (!macro) {
+            pp_expand_builtin(ex, &token);
+            *out = token;
+            return true;
+        }
+
+        if (hideset_contains(token.hideset, macro->name)) {
+            token.flags |= PP_PAINTED;
+            *out = token;
+            return true;
+        }
+
+        if (macro->type == MACRO_OBJECT) {
+            if (!token.hideset && pp_memoize(pp, macro)) {
+                for (int i = macro->expansion_count; i > 0; i--) {
+                    PPToken copy = macro->expansion[i - 1];
+                    copy.line = token.line;
+                    copy.column = i == 1 ? token.column : 0;
+                    if (i == 1) {
+                        copy.flags = (unsigned char)((copy.flags & ~PP_SPACE_BEFORE) |
+                                                     (token.flags & PP_SPACE_BEFORE));
+                    }
+                    preprocessor_tokens_push(&ex->pending, &copy);
+                }
+                continue;
+            }
+
+            PPTokenList replacement = {NULL, 0, 0};
+            pp_subst(ex, macro, NULL, hideset_add(pp, token.hideset, macro->name), &token, &replacement);
+            pp_push_front(ex, &replacement);
+            preprocessor_tokens_free(&replacement);
+            continue;
+        }
+
+        // A function-like macro name is only an invocation when followed by '('
+        const PPToken *next = pp_peek(ex);
+        if (!next || !pp_is_punct(next, "(")) {
+            *out = token;
+            return true;
+        }
+
+        PPToken lparen;
+        pp_next(ex, &lparen);
+
+        int slots = macro->param_count > 0 ? macro->param_count : 1;
+        PPTokenList *args = calloc((size_t)slots, sizeof(PPTokenList));
+        if (!args) {
+            error_fatal("Memory allocation failed for macro arguments");
+            return false;
+        }
+
+        PPToken rparen;
+        if (pp_collect_args(ex, macro, args, &rparen)) {
+            PPHideSet *hideset = hideset_intersection(pp, token.hideset, rparen.hideset);
+            hideset = hideset_add(pp, hideset, macro->name);
+
+            PPTokenList replacement = {NULL, 0, 0};
+            pp_subst(ex, macro, args, hideset, &token, &replacement);
+            pp_push_front(ex, &replacement);
+            preprocessor_tokens_free(&replacement);
+        }
+
+        for (int i = 0; i < slots; i++) {
+            preprocessor_tokens_free(&args[i]);
+        }
+        free(args);
+    }
+
+    return false;
+}
+
+// ========================================
+// #define
+// ========================================
+
+bool preprocessor_define_tokens(Preprocessor *pp, const PPToken *tokens, size_t count) {
+    if (count == 0 || tokens[0].kind != PP_IDENT) {
+        preprocessor_error(pp, "Macro names must be identifiers");
+        return false;
+    }
+
+    const char *name = tokens[0].text;
+    if (name == pp->id_defined) {
+        preprocessor_error(pp, "\"defined\" cannot be used as a macro name");
+        return false;
+    }
+
+    MacroType type = MACRO_OBJECT;
+    const char *params[256];
+    int param_count = 0;
+    bool variadic = false;
+    size_t i = 1;
+
+    // A '(' directly after the name makes it function-like
+    if (i < count && pp_is_punct(&tokens[i], "(") && !(tokens[i].flags & PP_SPACE_BEFORE)) {
+        type = MACRO_FUNCTION;
+        i++;
+
+        if (i < count && pp_is_punct(&tokens[i], ")")) {
+            i++;
+        } else {
+            for (;;) {
+                if (i >= count) {
+                    preprocessor_error(pp, "Missing ')' in parameter list of macro '%s'", name);
+                    return false;
+                }
+                if (param_count == (int)(sizeof(params) / sizeof(params[0]))) {
+                    preprocessor_error(pp, "Too many parameters for macro '%s'", name);
+                    return false;
+                }
+
+                if (pp_is_punct(&tokens[i], "...")) {
+                    params[param_count++] = pp->id_va_args;
+                    variadic = true;
+                    i++;
+                } else if (tokens[i].kind == PP_IDENT) {
+                    params[param_count++] = tokens[i++].text;
+                    if (i < count && pp_is_punct(&tokens[i], "...")) {
+                        variadic = true; // GNU named variadic parameter
+                        i++;
+                    }
+                } else {
+                    preprocessor_error(pp, "Invalid parameter list for macro '%s'", name);
+                    return false;
+                }
+
+                if (i < count && pp_is_punct(&tokens[i], ")") ) {
+                    i++;
+                    break;
+                }
+                if (variadic || i >= count || !pp_is_punct(&tokens[i], ",")) {
+                    preprocessor_error(pp, "Expected ',' or ')' in parameter list of macro '%s'", name);
+                    return false;
+                }
+                i++;
+            }
+        }
+    }
+
+    size_t body_count = count - i;
+    PPToken *body = NULL;
+    if (body_count) {
+        body = malloc(body_count * sizeof(PPToken));
+        if (!body) {
+            error_fatal("Memory allocation failed for macro '%s'", name);
+            return false;
+        }
+    }
+
+    for (size_t j = 0; j < body_count; j++) {
+        PPToken token = tokens[i + j];
+        token.flags &= (unsigned char)~(PP_LINE_START | PP_PAINTED);
+        if (j == 0) token.flags &= (unsigned char)~PP_SPACE_BEFORE;
+        token.hideset = NULL;
+        token.param = -1;
+
+        if (token.kind == PP_IDENT) {
+            for (int p = 0; p < param_count; p++) {
+                if (params[p] == token.text) {
+                    token.param = (short)p;
+                    break;
+                }
+            }
+        }
+        body[j] = token;
+    }
+
+    // Mark the operators, now that parameters are known
+    for (size_t j = 0; j < body_count; j++) {
+        if (body[j].kind != PP_PUNCT) continue;
+
+        if (strcmp(body[j].text, "##") == 0) {
+            if (j == 0 || j + 1 == body_count) {
+                preprocessor_error(pp, "'##' cannot appear at either end of a macro expansion");
+                free(body);
+                return false;
+            }
+            body[j].flags |= PP_PASTE_OP;
+        } else if (type == MACRO_FUNCTION && strcmp(body[j].text, "#") == 0) {
+            if (j + 1 == body_count || body[j + 1].param < 0) {
+                preprocessor_error(pp, "'#' is not followed by a macro parameter");
+                free(body);
+                return false;
+            }
+            body[j].flags |= PP_STRINGIZE_OP;
+        }
+    }
+
+    Macro *macro = calloc(1, sizeof(Macro));
+    if (!macro) {
+        free(body);
+        error_fatal("Memory allocation failed for macro '%s'", name);
+        return false;
+    }
+
+    macro->name = name;
+    macro->type = type;
+    macro->tokens = body;
+    macro->token_count = (int)body_count;
+    macro->body = preprocessor_spell_tokens(body, body_count);
+    macro->is_variadic = variadic;
+    macro->line_defined = pp->current_line;
+
+    if (param_count > 0) {
+        macro->params = malloc((size_t)param_count * sizeof(MacroParam));
+        if (!macro->params) {
+            free_macro(macro);
+            error_fatal("Memory allocation failed for macro '%s'", name);
+            return false;
+        }
+        for (int p = 0; p < param_count; p++) {
+            macro->params[p].name = params[p];
+        }
+    }
+    macro->param_count = param_count;
+
+    return preprocessor_add_macro(pp, macro);
+}
+
+// ========================================
+// #if expressions
+// ========================================
+
+typedef struct PPEval {
+    Preprocessor *pp;
+    const PPToken *tokens;
+    size_t pos;
+    size_t count;
+    bool error;
+} PPEval;
+
+static long long pp_eval_conditional(PPEval *ev);
+
+static const PPToken *pp_eval_peek(PPEval *ev) {
+    return ev->pos < ev->count ? &ev->tokens[ev->pos] : NULL;
+}
+
+static bool pp_eval_accept(PPEval *ev, const char *punct) {
+    const PPToken *token = pp_eval_peek(ev);
+    if (token && pp_is_punct(token, punct)) {
+        ev->pos++;
+        return true;
+    }
+    return false;
+}
+
+static long long pp_eval_number(PPEval *ev, const PPToken *token) {
+    if (token->kind == PP_CHAR) {
+        const char *p = strchr(token->text, '\'') + 1;
+        if (*p != '\\') return (unsigned char)*p;
+        switch (p[1]) {
+            case 'n': return '\n';
+            case 't': return '\t';
+            case 'r': return '\r';
+            case '0': return strtol(p + 1, NULL, 8);
+            case 'x': return strtol(p + 2, NULL, 16);
+            default:  return (unsigned char)p[1];
+        }
+    }
+
+    char *end;
+    unsigned long long value = strtoull(token->text, &end, 0);
+    while (*end == 'u' || *end == 'U' || *end == 'l' || *end == 'L') end++;
+    if (*end != '\0') {
+        preprocessor_error(ev->pp, "Invalid integer constant '%s' in #if", token->text);
+        ev->error = true;
+    }
+    return (long long)value;
+}
+
+static long long pp_eval_primary(PPEval *ev) {
+    const PPToken *token = pp_eval_peek(ev);
+    if (!token) {
+        preprocessor_error(ev->pp, "Unexpected end of #if expression");
+        ev->error = true;
+        return 0;
+    }
+    ev->pos++;
+
+    if (token->kind == PP_PUNCT) {
+        if (pp_is_punct(token, "(")) {
+            long long value = pp_eval_conditional(ev);
+            if (!pp_eval_accept(ev, ")")) {
+                preprocessor_error(ev->pp, "Missing ')' in #if expression");
+                ev->error = true;
+            }
+            return value;
+        }
+        if (pp_is_punct(token, "-")) return -pp_eval_primary(ev);
+        if (pp_is_punct(token, "+")) return pp_eval_primary(ev);
+        if (pp_is_punct(token, "!")) return !pp_eval_primary(ev);
+        if (pp_is_punct(token, "~")) return ~pp_eval_primary(ev);
+    }
+
+    if (token->kind == PP_NUMBER || token->kind == PP_CHAR) {
+        return pp_eval_number(ev, token);
+    }
+
+    // Identifiers left after expansion evaluate to 0
+    if (token->kind == PP_IDENT) {
+        return 0;
+    }
+
+    preprocessor_error(ev->pp, "Unexpected '%s' in #if expression", token->text);
+    ev->error = true;
+    return 0;
+}
+
+// Binary operators by precedence level, loosest first
+static const char *pp_binary_ops[][5] = {
+    {"||", NULL},
+    {"&&", NULL},
+    {"|", NULL},
+    {"^", NULL},
+    {"&", NULL},
+    {"==", "!=", NULL},
+    {"<", ">", "<=", ">=", NULL},
+    {"<<", ">>", NULL},
+    {"+", "-", NULL},
+    {"*", "/", "%", NULL},
+};
+
+#define PP_BINARY_LEVELS ((int)(sizeof(pp_binary_ops) / sizeof(pp_binary_ops[0])))
+
+static long long pp_eval_binary(PPEval *ev, int level) {
+    if (level == PP_BINARY_LEVELS) {
+        return pp_eval_primary(ev);
+    }
+
+    long long left = pp_eval_binary(ev, level + 1);
+    for (;;) {
+        const PPToken *token = pp_eval_peek(ev);
+        const char *op = NULL;
+        if (token && token->kind == PP_PUNCT) {
+            for (int i = 0; pp_binary_ops[level][i]; i++) {
+                if (strcmp(token->text, pp_binary_ops[level][i]) == 0) {
+                    op = pp_binary_ops[level][i];
+                    break;
+                }
+            }
+        }
+        if (!op) return left;
+        ev->pos++;
+
+        long long right = pp_eval_binary(ev, level + 1);
+        if (!strcmp(op, "||"))      left = left || right;
+        else if (!strcmp(op, "&&")) left = left && right;
+        else if (!strcmp(op, "|"))  left = left | right;
+        else if (!strcmp(op, "^"))  left = left ^ right;
+        else if (!strcmp(op, "&"))  left = left & right;
+        else if (!strcmp(op, "==")) left = left == right;
+        else if (!strcmp(op, "!=")) left = left != right;
+        else if (!strcmp(op, "<"))  left = left < right;
+        else if (!strcmp(op, ">"))  left = left > right;
+        else if (!strcmp(op, "<=")) left = left <= right;
+        else if (!strcmp(op, ">=")) left = left >= right;
+        else if (!strcmp(op, "<<")) left = (long long)((unsigned long long)left << (right & 63));
+        else if (!strcmp(op, ">>")) left = left >> (right & 63);
+        else if (!strcmp(op, "+"))  left = (long long)((unsigned long long)left + (unsigned long long)right);
+        else if (!strcmp(op, "-"))  left = (long long)((unsigned long long)left - (unsigned long long)right);
+        else if (!strcmp(op, "*"))  left = (long long)((unsigned long long)left * (unsigned long long)right);
+        else if (right == 0) {
+            preprocessor_error(ev->pp, "Division by zero in #if expression");
+            ev->error = true;
+            left = 0;
+        } else if (!strcmp(op, "/")) left = left / right;
+        else                         left = left % right;
+    }
+}
+
+static long long pp_eval_conditional(PPEval *ev) {
+    long long condition = pp_eval_binary(ev, 0);
+    if (!pp_eval_accept(ev, "?")) {
+        return condition;
+    }
+
+    long long if_true = pp_eval_conditional(ev);
+    if (!pp_eval_accept(ev, ":")) {
+        preprocessor_error(ev->pp, "Expected ':' in #if expression");
+        ev->error = true;
+    }
+    long long if_false = pp_eval_conditional(ev);
+    return condition ? if_true : if_false;
+}
+
+long long preprocessor_evaluate_tokens(Preprocessor *pp, const PPToken *tokens, size_t count) {
+    // Resolve `defined X` / `defined(X)` before anything is expanded
+    PPTokenList resolved = {NULL, 0, 0};
+    for (size_t i = 0; i < count; i++) {
+        if (tokens[i].kind != PP_IDENT || tokens[i].text != pp->id_defined) {
+            preprocessor_tokens_push(&resolved, &tokens[i]);
+            continue;
+        }
+
+        size_t j = i + 1;
+        bool paren = j < count && pp_is_punct(&tokens[j], "(");
+        if (paren) j++;
+
+        if (j >= count || tokens[j].kind != PP_IDENT ||
+            (paren && (j + 1 >= count || !pp_is_punct(&tokens[j + 1], ")")))) {
+            preprocessor_error(pp, "Operator \"defined\" requires an identifier");
+            preprocessor_tokens_free(&resolved);
+            return 0;
+        }
+
+        bool defined = preprocessor_lookup_macro(pp, tokens[j].text) != NULL ||
+                       tokens[j].text == pp->id_line || tokens[j].text == pp->id_file;
+        PPToken value = pp_make_token(PP_NUMBER, intern_string(defined ? "1" : "0"), tokens[i].line, 0);
+        preprocessor_tokens_push(&resolved, &value);
+        i = paren ? j + 1 : j;
+    }
+
+    PPTokenList expanded = {NULL, 0, 0};
+    pp_expand_list(pp, resolved.items, resolved.count, &expanded, NULL);
+    preprocessor_tokens_free(&resolved);
+
+    PPEval ev = {pp, expanded.items, 0, expanded.count, false};
+    long long value = 0;
+    if (expanded.count == 0) {
+        preprocessor_error(pp, "#if with no expression");
+    } else {
+        value = pp_eval_conditional(&ev);
+        if (!ev.error && ev.pos != ev.count) {
+            preprocessor_error(pp, "Missing binary operator before '%s' in #if", expanded.items[ev.pos].text);
+            value = 0;
+        }
+    }
+
+    preprocessor_tokens_free(&expanded);
+    return ev.error ? 0 : value;
+}
+
+// ========================================
+// Directives
+// ========================================
+
+static bool pp_name_is(const PPToken *token, const char *name) {
+    return token->kind == PP_IDENT && strcmp(token->text, name) == 0;
+}
+
+static bool pp_handle_conditional(Preprocessor *pp, const PPToken *tokens, size_t count) {
+    const PPToken *name = &tokens[0];
+    const PPToken *args = tokens + 1;
+    size_t arg_count = count - 1;
+
+    if (pp_name_is(name, "ifdef") || pp_name_is(name, "ifndef")) {
+        bool want = pp_name_is(name, "ifdef");
+        bool condition = false;
+        if (!pp->skip_lines) {
+            if (arg_count == 0 || args[0].kind != PP_IDENT) {
+                preprocessor_error(pp, "#%s expects a macro name", name->text);
+            } else {
+                condition = (preprocessor_lookup_macro(pp, args[0].text) != NULL) == want;
+            }
+        }
+        preprocessor_push_conditional(pp, want ? COND_IFDEF : COND_IFNDEF, condition);
+        return true;
+    }
+
+    if (pp_name_is(name, "if")) {
+        bool condition = !pp->skip_lines && preprocessor_evaluate_tokens(pp, args, arg_count) != 0;
+        preprocessor_push_conditional(pp, COND_IF, condition);
+        return true;
+    }
+
+    if (pp->cond_stack_depth == 0) {
+        preprocessor_error(pp, "#%s without #if", name->text);
+        return true;
+    }
+
+    ConditionalState *cond = &pp->cond_stack[pp->cond_stack_depth - 1];
+
+    if (pp_name_is(name, "elif")) {
+        if (cond->else_taken) {
+            preprocessor_error(pp, "#elif after #else");
+        }
+        if (cond->was_skipping || cond->condition_met) {
+            pp->skip_lines = true;
+        } else {
+            bool condition = preprocessor_evaluate_tokens(pp, args, arg_count) != 0;
+            cond->condition_met = condition;
+            pp->skip_lines = !condition;
+        }
+        cond->type = COND_ELIF;
+        return true;
+    }
+
+    if (pp_name_is(name, "else")) {
+        if (cond->else_taken) {
+            preprocessor_error(pp, "#else after #else");
+        }
+        cond->else_taken = true;
+        cond->type = COND_ELSE;
+        pp->skip_lines = cond->was_skipping || cond->condition_met;
+        cond->condition_met = true;
+        return true;
+    }
+
+    // #endif
+    preprocessor_pop_conditional(pp);
+    return true;
+}
+
+// ========================================
+// #include
+// ========================================
+
+// Include-guard detection. A file is guarded when everything in it sits
+// inside one "#ifndef X" (or "#if !defined X") group: nothing but
+// whitespace and comments before the #ifndef or after its #endif.
+typedef enum {
+    GUARD_START,                 // Nothing seen yet
+    GUARD_INSIDE,                // Inside the candidate group
+    GUARD_ENDED,                 // Candidate group closed; nothing after it so far
+    GUARD_NONE                   // Not a guarded file
+} PPGuardState;
+
+typedef struct PPGuardScan {
+    PPGuardState state;
+    const char *candidate;
+    int depth;                   // Conditional depth the guard group opens at
+} PPGuardScan;
+
+static void pp_guard_directive(PPGuardScan *scan, Preprocessor *pp,
+                               const PPToken *tokens, size_t count) {
+    if (!scan || scan->state == GUARD_NONE) {
+        return;
+    }
+
+    const PPToken *name = count ? &tokens[0] : NULL;
+    switch (scan->state) {
+        case GUARD_START:
+            scan->state = GUARD_NONE;
+            if (!name) break;
+
+            if (pp_name_is(name, "ifndef") && count == 2 && tokens[1].kind == PP_IDENT) {
+                scan->candidate = tokens[1].text;
+            } else if (pp_name_is(name, "if") && count >= 3 && pp_is_punct(&tokens[1], "!") &&
+                       tokens[2].text == pp->id_defined) {
+                // #if !defined X / #if !defined(X)
+                if (count == 4 && tokens[3].kind == PP_IDENT) {
+                    scan->candidate = tokens[3].text;
+                } else if (count == 6 && pp_is_punct(&tokens[3], "(") &&
+                           tokens[4].kind == PP_IDENT && pp_is_punct(&tokens[5], ")")) {
+                    scan->candidate = tokens[4].text;
+                }
+            }
+
+            if (scan->candidate) {
+                scan->state = GUARD_INSIDE;
+                scan->depth = pp->cond_stack_depth;
+            }
+            break;
+
+        case GUARD_INSIDE:
+            if (name && pp->cond_stack_depth == scan->depth + 1) {
+                if (pp_name_is(name, "endif")) {
+                    scan->state = GUARD_ENDED;
+                } else if (pp_name_is(name, "else") || pp_name_is(name, "elif")) {
+                    scan->state = GUARD_NONE;
+                }
+            }
+            break;
+
+        default:
+            scan->state = GUARD_NONE;
+            break;
+    }
+}
+
+static void pp_guard_text(PPGuardScan *scan) {
+    if (scan && scan->state != GUARD_INSIDE) {
+        scan->state = GUARD_NONE;
+    }
+}
+
+static void pp_run_source(Preprocessor *pp, const char *source, size_t length, PPGuardScan *scan);
+
+static bool pp_file_listed(IncludeCacheEntry *const *files, size_t count,
+                           const IncludeCacheEntry *entry) {
+    for (size_t i = 0; i < count; i++) {
+        if (files[i] == entry) return true;
+    }
+    return false;
+}
+
+static void pp_file_list_add(IncludeCacheEntry ***files, size_t *count, size_t *capacity,
+                             IncludeCacheEntry *entry) {
+    if (pp_file_listed(*files, *count, entry)) {
+        return;
+    }
+    if (*count == *capacity) {
+        size_t new_capacity = *capacity ? *capacity * 2 : 16;
+        IncludeCacheEntry **grown = realloc(*files, new_capacity * sizeof(IncludeCacheEntry*));
+        if (!grown) {
+            error_fatal("Memory allocation failed for include tracking");
+            return;
+        }
+        *files = grown;
+        *capacity = new_capacity;
+    }
+    (*files)[(*count)++] = entry;
+}
+
+static bool pp_is_once(const Preprocessor *pp, const IncludeCacheEntry *entry) {
+    return pp_file_listed(pp->once_files, pp->once_count, entry);
+}
+
+void preprocessor_remember_once(Preprocessor *pp, IncludeCacheEntry *entry) {
+    pp_file_list_add(&pp->once_files, &pp->once_count, &pp->once_capacity, entry);
+}
+
+void preprocessor_remember_included(Preprocessor *pp, IncludeCacheEntry *entry) {
+    pp_file_list_add(&pp->included_files, &pp->included_count, &pp->included_capacity, entry);
+}
+
+// Tells the compiler's lexer which line the following output comes from
+static void pp_emit_line_marker(Preprocessor *pp, int line, const char *file) {
+    if (pp->output_size && pp->output[pp->output_size - 1] != '\n') {
+        preprocessor_append_output_n(pp, "\n", 1);
+    }
+
+    char number[32];
+    int length = snprintf(number, sizeof(number), "# %d \"", line);
+    preprocessor_append_output_n(pp, number, (size_t)length);
+    for (const char *p = file; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            preprocessor_append_output_n(pp, "\\", 1);
+        }
+        preprocessor_append_output_n(pp, p, 1);
+    }
+    preprocessor_append_output_n(pp, "\"\n", 2);
+
+    pp->output_line = line;
+    pp->output_line_start = pp->output_size;
+    pp->output_last = NULL;
+}
+
+static char *pp_join_path(const char *dir, size_t dir_length, const char *name) {
+    size_t name_length = strlen(name);
+    char *path = malloc(dir_length + name_length + 2);
+    if (!path) {
+        error_fatal("Memory allocation failed for include path");
+        return NULL;
+    }
+
+    memcpy(path, dir, dir_length);
+    size_t length = dir_length;
+    if (dir_length) {
+        path[length++] = '/';
+    }
+    memcpy(path + length, name, name_length + 1);
+    return path;
+}
+
+// Resolves a header name to a cache entry; *path receives the path it was
+// found under and *search_index the include path used (-1 if beside the
+// including file)
+static IncludeCacheEntry *pp_find_include(Preprocessor *pp, const char *name, bool quoted,
+                                          bool next, char **path, int *search_index) {
+    *path = NULL;
+    *search_index = -1;
+
+    if (name[0] == '/') {
+        IncludeCacheEntry *entry = include_cache_lookup(name);
+        if (entry) *path = strdup(name);
+        return entry;
+    }
+
+    int first = 0;
+    if (next && pp->include_depth > 0) {
+        first = pp->include_stack[pp->include_depth - 1].search_index + 1;
+    } else if (quoted) {
+        // "header.h" is looked for next to the file that includes it first
+        const char *file = pp->current_file ? pp->current_file : "";
+        const char *slash = strrchr(file, '/');
+        size_t dir_length = slash ? (size_t)(slash - file) : 0;
+
+        char *candidate = pp_join_path(file, dir_length, name);
+        IncludeCacheEntry *entry = candidate ? include_cache_lookup(candidate) : NULL;
+        if (entry) {
+            *path = candidate;
+            return entry;
+        }
+        free(candidate);
+    }
+
+    for (int i = first; i < pp->include_path_count; i++) {
+        const char *dir = pp->include_paths[i];
+        char *candidate = pp_join_path(dir, strlen(dir), name);
+        IncludeCacheEntry *entry = candidate ? include_cache_lookup(candidate) : NULL;
+        if (entry) {
+            *path = candidate;
+            *search_index = i;
+            return entry;
+        }
+        free(candidate);
+    }
+
+    return NULL;
+}
+
+// Spells the header name of an #include; returns NULL if the operand is
+// neither "file" nor <file>
+static char *pp_header_name(const PPToken *tokens, size_t count, bool *quoted) {
+    if (count == 0) {
+        return NULL;
+    }
+
+    if (tokens[0].kind == PP_STRING && tokens[0].text[0] == '"') {
+        size_t length = intern_length(tokens[0].text);
+        *quoted = true;
+        return length >= 2 ? strndup(tokens[0].text + 1, length - 2) : NULL;
+    }
+
+    if (!pp_is_punct(&tokens[0], "<")) {
+        return NULL;
+    }
+
+    char *buffer = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+    pp_spell_append(&buffer, &length, &capacity, "", 0);
+
+    for (size_t i = 1; i < count; i++) {
+        if (pp_is_punct(&tokens[i], ">")) {
+            *quoted = false;
+            return buffer;
+        }
+        if (i > 1 && (tokens[i].flags & PP_SPACE_BEFORE)) {
+            pp_spell_append(&buffer, &length, &capacity, " ", 1);
+        }
+        pp_spell_append(&buffer, &length, &capacity, tokens[i].text, intern_length(tokens[i].text));
+    }
+
+    free(buffer);
+    return NULL;
+}
+
+static bool pp_handle_include(Preprocessor *pp, const PPToken *tokens, size_t count) {
+    const PPToken *directive = &tokens[0];
+    bool import = pp_name_is(directive, "import");
+    bool next = pp_name_is(directive, "include_next");
+
+    bool quoted = false;
+    char *name = pp_header_name(tokens + 1, count - 1, &quoted);
+    if (!name) {
+        // #include MACRO: the expansion must form a header name
+        PPTokenList expanded = {NULL, 0, 0};
+        pp_expand_list(pp, tokens + 1, count - 1, &expanded, NULL);
+        name = pp_header_name(expanded.items, expanded.count, &quoted);
+        preprocessor_tokens_free(&expanded);
+    }
+    if (!name || !name[0]) {
+        preprocessor_error(pp, "#%s expects \"FILENAME\" or <FILENAME>", directive->text);
+        free(name);
+        return false;
+    }
+
+    char *path = NULL;
+    int search_index = -1;
+    IncludeCacheEntry *entry = pp_find_include(pp, name, quoted, next, &path, &search_index);
+    if (!entry) {
+        // kcc ships no C library headers, so unresolved <system> headers are
+        // left to the assembler/linker stage; a missing "local" header is an error
+        if (quoted) {
+            preprocessor_error(pp, "'%s' file not found", name);
+        }
+        free(name);
+        return !quoted;
+    }
+    free(name);
+
+    // Already included under its guard or #pragma once: nothing to read
+    const char *guard = include_cache_guard(entry);
+    if (pp_is_once(pp, entry) || (guard && preprocessor_lookup_macro(pp, guard))) {
+        free(path);
+        return true;
+    }
+
+    if (pp->include_depth >= MAX_INCLUDE_DEPTH) {
+        preprocessor_error(pp, "#include nested too deeply");
+        free(path);
+        return false;
+    }
+
+    if (!include_cache_load(entry)) {
+        preprocessor_error(pp, "Cannot read '%s'", path);
+        free(path);
+        return false;
+    }
+    preprocessor_remember_included(pp, entry);
+
+    if (import || include_cache_pragma_once(entry)) {
+        preprocessor_remember_once(pp, entry);
+    }
+
+    IncludeFile *frame = &pp->include_stack[pp->include_depth++];
+    frame->filename = pp->current_file;
+    frame->line = pp->current_line;
+    frame->search_index = search_index;
+    frame->cond_depth = pp->cond_stack_depth;
+    frame->entry = entry;
+
+    pp->current_file = path;
+    pp_emit_line_marker(pp, 1, path);
+
+    PPGuardScan scan = {GUARD_START, NULL, 0};
+    pp_run_source(pp, entry->source.data, entry->source.size, &scan);
+
+    if (pp->cond_stack_depth > frame->cond_depth) {
+        pp->current_line = pp->cond_stack[pp->cond_stack_depth - 1].line_number;
+        preprocessor_error(pp, "Unterminated conditional directive");
+        pp->cond_stack_depth = frame->cond_depth;
+        pp->skip_lines = false;
+    }
+
+    include_cache_set_guard(entry, scan.state == GUARD_ENDED ? scan.candidate : NULL);
+
+    free(pp->current_file);
+    pp->current_file = frame->filename;
+    pp->current_line = frame->line;
+    pp->include_depth--;
+
+    pp_emit_line_marker(pp, frame->line + 1, pp->current_file);
+    return true;
+}
+
+bool preprocessor_handle_directive_tokens(Preprocessor *pp, const PPToken *tokens, size_t count) {
+    if (count == 0) {
+        return true; // Null directive
+    }
+
+    const PPToken *name = &tokens[0];
+    if (name->kind == PP_NUMBER) {
+        return true; // Line marker from another preprocessor
+    }
+    if (name->kind != PP_IDENT) {
+        if (!pp->skip_lines) {
+            preprocessor_error(pp, "Invalid preprocessing directive");
+        }
+        return false;
+    }
+
+    if (pp_name_is(name, "if") || pp_name_is(name, "ifdef") || pp_name_is(name, "ifndef") ||
+        pp_name_is(name, "elif") || pp_name_is(name, "else") || pp_name_is(name, "endif")) {
+        return pp_handle_conditional(pp, tokens, count);
+    }
+
+    if (pp->skip_lines) {
+        return true;
+    }
+
+    if (pp_name_is(name, "define")) {
+        return preprocessor_define_tokens(pp, tokens + 1, count - 1);
+    }
+
+    if (pp_name_is(name, "undef")) {
+        if (count < 2 || tokens[1].kind != PP_IDENT) {
+            preprocessor_error(pp, "Missing macro name in #undef");
+            return false;
+        }
+        if (preprocessor_lookup_macro(pp, tokens[1].text)) {
+            return preprocessor_undefine_macro(pp, tokens[1].text);
+        }
+        return true;
+    }
+
+    if (pp_name_is(name, "include") || pp_name_is(name, "include_next") || pp_name_is(name, "import")) {
+        return pp_handle_include(pp, tokens, count);
+    }
+
+    if (pp_name_is(name, "error") || pp_name_is(name, "warning")) {
+        char *message = preprocessor_spell_tokens(tokens + 1, count - 1);
+        if (pp_name_is(name, "error")) {
+            preprocessor_error(pp, "#error %s", message);
+        } else {
+            preprocessor_warning(pp, "#warning %s", message);
+        }
+        free(message);
+        return true;
+    }
+
+    if (pp_name_is(name, "pragma")) {
+        if (count == 2 && pp_name_is(&tokens[1], "once") && pp->include_depth > 0) {
+            IncludeCacheEntry *entry = pp->include_stack[pp->include_depth - 1].entry;
+            include_cache_set_pragma_once(entry);
+            preprocessor_remember_once(pp, entry);
+        }
+        return true;
+    }
+
+    if (pp_name_is(name, "line") || pp_name_is(name, "ident")) {
+        return true;
+    }
+
+    preprocessor_error(pp, "Unknown directive: #%s", name->text);
+    return false;
+}
+
+// ========================================
+// Driver
+// ========================================
+
+// Preprocesses one file's text into the output; scan, if given, records
+// whether the file is wrapped in an include guard
+static void pp_run_source(Preprocessor *pp, const char *source, size_t length, PPGuardScan *scan) {
+    PPLexer lx;
+    pp_lexer_init(&lx, source, length);
+    lx.skipping = pp->skip_lines;
+
+    PPExpander ex;
+    pp_expander_init(&ex, pp, &lx, NULL, 0);
+
+    PPTokenList line = {NULL, 0, 0};
+
+    for (;;) {
+        const PPToken *next = pp_lexer_peek(&lx);
+        if (next->kind == PP_EOF) {
+            break;
+        }
+
+        if (pp_is_directive_start(next)) {
+            PPToken hash;
+            pp_lexer_read(&lx, &hash);
+            pp->current_line = hash.line;
+
+            // Directive names must be readable even inside skipped groups
+            lx.skipping = false;
+            line.count = 0;
+            while (!(pp_lexer_peek(&lx)->flags & PP_LINE_START)) {
+                PPToken token;
+                pp_lexer_read(&lx, &token);
+                preprocessor_tokens_push(&line, &token);
+            }
+
+            pp_guard_directive(scan, pp, line.items, line.count);
+            preprocessor_handle_directive_tokens(pp, line.items, line.count);
+            lx.skipping = pp->skip_lines;
+            continue;
+        }
+
+        if (pp->skip_lines) {
+            PPToken token;
+            pp_lexer_read(&lx, &token);
+            continue;
+        }
+
+        pp_guard_text(scan);
+
+        // Expand the text up to the next directive
+        PPToken token;
+        while (pp_expand_next(&ex, &token)) {
+            pp->current_line = token.line;
+            pp_emit(pp, &token);
+        }
+
+        if (pp->expand_arena->allocation_count) {
+            arena_reset(pp->expand_arena);
+        }
+    }
+
+    // Keep the line count of the source
+    while (pp->output_line < lx.line) {
+        preprocessor_append_output_n(pp, "\n", 1);
+        pp->output_line++;
+        pp->output_line_start = pp->output_size;
+    }
+
+    preprocessor_tokens_free(&line);
+    preprocessor_tokens_free(&ex.pending);
+}
+
+void preprocessor_run(Preprocessor *pp, const char *source, size_t length) {
+    pp->output_line = 1;
+    pp->output_line_start = pp->output_size;
+    pp->output_last = NULL;
+
+    pp_run_source(pp, source, length, NULL);
+
+    if (pp->output_size && pp->output[pp->output_size - 1] != '\n') {
+        preprocessor_append_output_n(pp, "\n", 1);
+    }
+}
+
+// ========================================
+// String interface
+// ========================================
+
+char *preprocessor_expand_macros(Preprocessor *pp, const char *line) {
+    PPTokenList tokens = {NULL, 0, 0};
+    PPTokenList expanded = {NULL, 0, 0};
+
+    preprocessor_lex_tokens(line, strlen(line), &tokens);
+    pp_expand_list(pp, tokens.items, tokens.count, &expanded, NULL);
+
+    char *result = preprocessor_spell_tokens(expanded.items, expanded.count);
+    preprocessor_tokens_free(&tokens);
+    preprocessor_tokens_free(&expanded);
+    return result;
+}
+
+char *preprocessor_expand_function_macro(Preprocessor *pp, Macro *macro,
+                                       const char *args[], int arg_count) {
+    if (arg_count != macro->param_count) {
+        preprocessor_error(pp, "Macro '%s' expects %d arguments, got %d",
+                         macro->name, macro->param_count, arg_count);
+        return strdup(macro->body);
+    }
+
+    int slots = arg_count > 0 ? arg_count : 1;
+    PPTokenList *arg_tokens = calloc((size_t)slots, sizeof(PPTokenList));
+    if (!arg_tokens) {
+        error_fatal("Memory allocation failed for macro arguments");
+        return NULL;
+    }
+    for (int i = 0; i < arg_count; i++) {
+        preprocessor_lex_tokens(args[i], strlen(args[i]), &arg_tokens[i]);
+    }
+
+    PPExpander ex;
+    pp_expander_init(&ex, pp, NULL, NULL, 0);
+    PPToken origin = pp_make_token(PP_IDENT, macro->name, 0, 0);
+
+    PPTokenList replacement = {NULL, 0, 0};
+    PPTokenList expanded = {NULL, 0, 0};
+    pp_subst(&ex, macro, arg_tokens, hideset_add(pp, NULL, macro->name), &origin, &replacement);
+    pp_expand_list(pp, replacement.items, replacement.count, &expanded, NULL);
+
+    char *result = preprocessor_spell_tokens(expanded.items, expanded.count);
+
+    for (int i = 0; i < slots; i++) {
+        preprocessor_tokens_free(&arg_tokens[i]);
+    }
+    free(arg_tokens);
+    preprocessor_tokens_free(&replacement);
+    preprocessor_tokens_free(&expanded);
+    return result;
+}
+
+char *preprocessor_substitute_params(const char *body, const char *params[],
+                                   const char *args[], int param_count) {
+    PPTokenList tokens = {NULL, 0, 0};
+    PPTokenList result = {NULL, 0, 0};
+    preprocessor_lex_tokens(body, strlen(body), &tokens);
+
+    for (size_t i = 0; i < tokens.count; i++) {
+        const PPToken *token = &tokens.items[i];
+        int param = -1;
+        if (token->kind == PP_IDENT) {
+            for (int p = 0; p < param_count; p++) {
+                if (strcmp(token->text, params[p]) == 0) {
+                    param = p;
+                    break;
+                }
+            }
+        }
+
+        if (param < 0) {
+            preprocessor_tokens_push(&result, token);
+            continue;
+        }
+
+        PPTokenList arg = {NULL, 0, 0};
+        preprocessor_lex_tokens(args[param], strlen(args[param]), &arg);
+        for (size_t j = 0; j < arg.count; j++) {
+            PPToken copy = arg.items[j];
+            if (j == 0) {
+                copy.flags = (unsigned char)((copy.flags & ~PP_SPACE_BEFORE) |
+                                             (token->flags & PP_SPACE_BEFORE));
+            }
+            preprocessor_tokens_push(&result, &copy);
+        }
+        preprocessor_tokens_free(&arg);
+    }
+
+    char *text = preprocessor_spell_tokens(result.items, result.count);
+    preprocessor_tokens_free(&tokens);
+    preprocessor_tokens_free(&result);
+    return text;
+}
@@ -0,0 +1,729 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "regalloc.h"
+
+#define REGALLOC_ARENA_CHUNK_SIZE (16 * 1024)
+
+// Working state of one allocation; the result lives in alloc
+typedef struct {
+    RegAllocation *alloc;
+    const IRFunction *function;
+    const TargetConfig *target;
+    IRBlock **blocks;            // By block id
+    uint64_t *live_out;
+    uint64_t allocatable;        // Bit per general_regs index
+
+    // Use positions of each value, ascending: uses[use_start[v] .. use_start[v + 1])
+    int *use_start;
+    int *uses;
+
+    int *calls;                  // Positions of call instructions, ascending
+    int call_count;
+
+    // Pieces waiting for a register, a binary heap ordered by start
+    LiveInterval **unhandled;
+    int unhandled_count;
+    int unhandled_capacity;
+
+    // Pieces holding a register at the current position
+    LiveInterval **active;
+    int active_count;
+} RegAllocState;
+
+static inline bool regalloc_bit(const uint64_t *set, int bit) {
+    return (set[bit >> 6] >> (bit & 63)) & 1;
+}
+
+static inline void regalloc_set_bit(uint64_t *set, int bit) {
+    set[bit >> 6] |= (uint64_t)1 << (bit & 63);
+}
+
+static int regalloc_pred_index(const IRBlock *block, const IRBlock *pred) {
+    for (int i = 0; i < block->pred_count; i++) {
+        if (block->preds[i] == pred) return i;
+    }
+    return -1;
+}
+
+// ============================================================================
+// Numbering and liveness
+// ============================================================================
+
+static void regalloc_number(RegAllocState *state) {
+    RegAllocation *alloc = state->alloc;
+    int index = 0;
+    for (IRBlock *block = state->function->entry; block; block = block->next) {
+        state->blocks[block->id] = block;
+        alloc->block_start[block->id] = index * 2;
+        for (IRInstr *instr = block->first; instr; instr = instr->next) {
+            index++;
+        }
+        alloc->block_end[block->id] = (index - 1) * 2;
+    }
+}
+
+// Values live on entry to and exit from each block, iterated to a fixed
+// point backwards over the layout. A phi operand is live out of the
+// predecessor it comes from rather than into the phi's block.
+static void regalloc_liveness(RegAllocState *state) {
+    RegAllocation *alloc = state->alloc;
+    int block_count = state->function->block_count;
+    int words = alloc->live_words;
+    uint64_t *gen = calloc((size_t)block_count * (size_t)words, sizeof(uint64_t));
+    uint64_t *kill = calloc((size_t)block_count * (size_t)words, sizeof(uint64_t));
+
+    for (int b = 0; b < block_count; b++) {
+        uint64_t *block_gen = gen + (size_t)b * (size_t)words;
+        uint64_t *block_kill = kill + (size_t)b * (size_t)words;
+        for (IRInstr *instr = state->blocks[b]->first; instr; instr = instr->next) {
+            if (instr->op != IR_PHI) {
+                for (int i = 0; i < instr->operand_count; i++) {
+                    int value = instr->operands[i]->id;
+                    if (value >= 0 && !regalloc_bit(block_kill, value)) {
+                        regalloc_set_bit(block_gen, value);
+                    }
+                }
+            }
+            if (instr->id >= 0) {
+                regalloc_set_bit(block_kill, instr->id);
+            }
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = block_count - 1; b >= 0; b--) {
+            IRBlock *block = state->blocks[b];
+            uint64_t *out = state->live_out + (size_t)b * (size_t)words;
+            uint64_t *in = alloc->live_in + (size_t)b * (size_t)words;
+
+            IRBlock *succs[2];
+            int succ_count = ir_block_successors(block, succs);
+            for (int s = 0; s < succ_count; s++) {
+                const uint64_t *succ_in = alloc->live_in + (size_t)succs[s]->id * (size_t)words;
+                for (int w = 0; w < words; w++) {
+                    out[w] |= succ_in[w];
+                }
+                int pred = regalloc_pred_index(succs[s], block);
+                for (IRInstr *phi = succs[s]->first; phi && phi->op == IR_PHI; phi = phi->next) {
+                    if (pred >= 0 && pred < phi->operand_count && phi->operands[pred]->id >= 0) {
+                        regalloc_set_bit(out, phi->operands[pred]->id);
+                    }
+                }
+            }
+
+            const uint64_t *block_gen = gen + (size_t)b * (size_t)words;
+            const uint64_t *block_kill = kill + (size_t)b * (size_t)words;
+            for (int w = 0; w < words; w++) {
+                uint64_t live = block_gen[w] | (out[w] & ~block_kill[w]);
+                if (live != in[w]) {
+                    in[w] = live;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    free(gen);
+    free(kill);
+}
+
+// ============================================================================
+// Intervals
+// ============================================================================
+
+static LiveInterval *regalloc_piece(RegAllocState *state, int value, int start, int end) {
+    LiveInterval *piece = arena_calloc(state->alloc->arena, 1, sizeof(LiveInterval));
+    piece->value = value;
+    piece->start = start;
+    piece->end = end;
+    piece->reg = REGALLOC_STACK;
+    return piece;
+}
+
+static void regalloc_extend(int *first, int *last, int value, int position) {
+    if (position < first[value]) first[value] = position;
+    if (position > last[value]) last[value] = position;
+}
+
+// One interval per value, without holes: from the earliest of its
+// definition and the starts of blocks it is live into, to the latest of its
+// uses and the ends of blocks it is live out of. Also records every use
+// position and the call positions.
+static void regalloc_build_intervals(RegAllocState *state) {
+    RegAllocation *alloc = state->alloc;
+    const IRFunction *function = state->function;
+    int value_count = function->value_count;
+    int words = alloc->live_words;
+    int *first = malloc(sizeof(int) * (size_t)(value_count + 1));
+    int *last = malloc(sizeof(int) * (size_t)(value_count + 1));
+    int *use_count = calloc((size_t)value_count + 1, sizeof(int));
+    for (int v = 0; v < value_count; v++) {
+        first[v] = INT_MAX;
+        last[v] = -1;
+    }
+
+    // Count uses and calls first so both lists fit in one allocation each
+    int call_count = 0;
+    for (IRBlock *block = function->entry; block; block = block->next) {
+        for (IRInstr *instr = block->first; instr; instr = instr->next) {
+            if (instr->op == IR_CALL) call_count++;
+            if (instr->op == IR_PHI) continue;
+            for (int i = 0; i < instr->operand_count; i++) {
+                if (instr->operands[i]->id >= 0) use_count[instr->operands[i]->id]++;
+            }
+        }
+        IRBlock *succs[2];
+        int succ_count = ir_block_successors(block, succs);
+        for (int s = 0; s < succ_count; s++) {
+            int pred = regalloc_pred_index(succs[s], block);
+            for (IRInstr *phi = succs[s]->first; phi && phi->op == IR_PHI; phi = phi->next) {
+                if (pred >= 0 && pred < phi->operand_count && phi->operands[pred]->id >= 0) {
+                    use_count[phi->operands[pred]->id]++;
+                }
+            }
+        }
+    }
+
+    state->use_start = malloc(sizeof(int) * (size_t)(value_count + 1));
+    int total = 0;
+    for (int v = 0; v < value_count; v++) {
+        state->use_start[v] = total;
+        total += use_count[v];
+        use_count[v] = 0;
+    }
+    state->use_start[value_count] = total;
+    state->uses = malloc(sizeof(int) * (size_t)(total + 1));
+    state->calls = malloc(sizeof(int) * (size_t)(call_count + 1));
+
+    // Uses are recorded in layout order, so each value's list comes out sorted
+    int index = 0;
+    for (IRBlock *block = function->entry; block; block = block->next) {
+        int block_start = alloc->block_start[block->id];
+        int block_end = alloc->block_end[block->id];
+
+        for (IRInstr *instr = block->first; instr; instr = instr->next, index++) {
+            int use = index * 2;
+            if (instr->op == IR_PHI) {
+                regalloc_extend(first, last, instr->id, block_start);
+                continue;
+            }
+            for (int i = 0; i < instr->operand_count; i++) {
+                int value = instr->operands[i]->id;
+                if (value < 0) continue;
+                regalloc_extend(first, last, value, use);
+                state->uses[state->use_start[value] + use_count[value]++] = use;
+            }
+            if (instr->id >= 0) {
+                regalloc_extend(first, last, instr->id, use + 1);
+            }
+            if (instr->op == IR_CALL) {
+                state->calls[state->call_count++] = use;
+            }
+        }
+
+        IRBlock *succs[2];
+        int succ_count = ir_block_successors(block, succs);
+        for (int s = 0; s < succ_count; s++) {
+            int pred = regalloc_pred_index(succs[s], block);
+            for (IRInstr *phi = succs[s]->first; phi && phi->op == IR_PHI; phi = phi->next) {
+                if (pred >= 0 && pred < phi->operand_count && phi->operands[pred]->id >= 0) {
+                    int value = phi->operands[pred]->id;
+                    regalloc_extend(first, last, value, block_end);
+                    state->uses[state->use_start[value] + use_count[value]++] = block_end;
+                }
+            }
+        }
+
+        const uint64_t *in = alloc->live_in + (size_t)block->id * (size_t)words;
+        const uint64_t *out = state->live_out + (size_t)block->id * (size_t)words;
+        for (int v = 0; v < value_count; v++) {
+            if (regalloc_bit(in, v)) regalloc_extend(first, last, v, block_start);
+            if (regalloc_bit(out, v)) regalloc_extend(first, last, v, block_end);
+        }
+    }
+
+    for (int v = 0; v < value_count; v++) {
+        if (last[v] >= 0) {
+            alloc->intervals[v] = regalloc_piece(state, v, first[v], last[v]);
+        }
+    }
+
+    free(first);
+    free(last);
+    free(use_count);
+}
+
+// First use of value at or after position, or INT_MAX
+static int regalloc_next_use(const RegAllocState *state, int value, int position) {
+    int lo = state->use_start[value];
+    int hi = state->use_start[value + 1];
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (state->uses[mid] < position) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < state->use_start[value + 1] ? state->uses[lo] : INT_MAX;
+}
+
+// First call the piece is live across, or -1. A call's result starts after
+// it, so it does not count; an argument counts only if it stays live after.
+static int regalloc_first_call(const RegAllocState *state, const LiveInterval *piece) {
+    int lo = 0;
+    int hi = state->call_count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (state->calls[mid] < piece->start) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < state->call_count && state->calls[lo] < piece->end ? state->calls[lo] : -1;
+}
+
+// ============================================================================
+// Linear scan
+// ============================================================================
+
+static bool regalloc_before(const LiveInterval *a, const LiveInterval *b) {
+    return a->start < b->start || (a->start == b->start && a->value < b->value);
+}
+
+static void regalloc_push(RegAllocState *state, LiveInterval *piece) {
+    if (state->unhandled_count == state->unhandled_capacity) {
+        state->unhandled_capacity = state->unhandled_capacity ? state->unhandled_capacity * 2 : 64;
+        state->unhandled = realloc(state->unhandled,
+                                   sizeof(LiveInterval*) * (size_t)state->unhandled_capacity);
+    }
+    int i = state->unhandled_count++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!regalloc_before(piece, state->unhandled[parent])) break;
+        state->unhandled[i] = state->unhandled[parent];
+        i = parent;
+    }
+    state->unhandled[i] = piece;
+}
+
+static LiveInterval *regalloc_pop(RegAllocState *state) {
+    LiveInterval *top = state->unhandled[0];
+    LiveInterval *last = state->unhandled[--state->unhandled_count];
+    int i = 0;
+    for (;;) {
+        int child = i * 2 + 1;
+        if (child >= state->unhandled_count) break;
+        if (child + 1 < state->unhandled_count &&
+            regalloc_before(state->unhandled[child + 1], state->unhandled[child])) {
+            child++;
+        }
+        if (!regalloc_before(state->unhandled[child], last)) break;
+        state->unhandled[i] = state->unhandled[child];
+        i = child;
+    }
+    if (state->unhandled_count > 0) {
+        state->unhandled[i] = last;
+    }
+    return top;
+}
+
+// Cuts piece in two at position and returns the part from position on
+static LiveInterval *regalloc_split(RegAllocState *state, LiveInterval *piece, int position) {
+    LiveInterval *rest = regalloc_piece(state, piece->value, position, piece->end);
+    rest->next = piece->next;
+    piece->next = rest;
+    piece->end = position - 1;
+    return rest;
+}
+
+// Puts piece on the stack up to its next use, from where the rest of it
+// competes for a register again
+static void regalloc_spill(RegAllocState *state, LiveInterval *piece) {
+    piece->reg = REGALLOC_STACK;
+    int use = regalloc_next_use(state, piece->value, piece->start + 1);
+    if (use <= piece->end) {
+        regalloc_push(state, regalloc_split(state, piece, use));
+    }
+}
+
+// Gives piece reg, or returns false when piece starts at a call it outlives
+// and reg is caller-saved; it then waits on the stack for its next use instead
+static bool regalloc_assign(RegAllocState *state, LiveInterval *piece, int reg) {
+    if (!state->target->general_regs[reg].preserved) {
+        // A call clobbers it: keep the register up to the call only
+        int call = regalloc_first_call(state, piece);
+        if (call == piece->start) {
+            regalloc_spill(state, piece);
+            return false;
+        }
+        if (call >= 0) {
+            regalloc_spill(state, regalloc_split(state, piece, call));
+        }
+    } else {
+        state->alloc->used_callee_saved |= (uint64_t)1 << reg;
+    }
+
+    piece->reg = reg;
+    state->active[state->active_count++] = piece;
+    return true;
+}
+
+// Free register for piece, or -1. Values live across a call want a
+// callee-saved register, preferably one already saved; the rest want a
+// caller-saved one, which costs nothing to use.
+static int regalloc_free_register(const RegAllocState *state, const LiveInterval *piece,
+                                  const bool *taken) {
+    bool crosses_call = regalloc_first_call(state, piece) >= 0;
+    int best = -1;
+    int best_score = -1;
+    for (int r = 0; r < state->target->num_general_regs; r++) {
+        if (!((state->allocatable >> r) & 1) || taken[r]) continue;
+
+        bool preserved = state->target->general_regs[r].preserved;
+        bool saved = (state->alloc->used_callee_saved >> r) & 1;
+        int score;
+        if (crosses_call) {
+            score = preserved ? (saved ? 3 : 2) : 1;
+        } else {
+            score = preserved ? (saved ? 2 : 1) : 3;
+        }
+        if (score > best_score) {
+            best = r;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+static void regalloc_linear_scan(RegAllocState *state) {
+    bool taken[64] = {false};
+
+    for (int v = 0; v < state->function->value_count; v++) {
+        if (state->alloc->intervals[v]) {
+            regalloc_push(state, state->alloc->intervals[v]);
+        }
+    }
+
+    while (state->unhandled_count > 0) {
+        LiveInterval *current = regalloc_pop(state);
+        int position = current->start;
+
+        // Expire pieces that ended before this one starts
+        int kept = 0;
+        for (int i = 0; i < state->active_count; i++) {
+            LiveInterval *piece = state->active[i];
+            if (piece->end < position) {
+                taken[piece->reg] = false;
+            } else {
+                state->active[kept++] = piece;
+            }
+        }
+        state->active_count = kept;
+
+        int reg = regalloc_free_register(state, current, taken);
+        if (reg >= 0) {
+            taken[reg] = regalloc_assign(state, current, reg);
+            continue;
+        }
+
+        // All taken: evict the piece used furthest in the future, unless
+        // that is the current one
+        int victim = -1;
+        int furthest = regalloc_next_use(state, current->value, position);
+        for (int i = 0; i < state->active_count; i++) {
+            int use = regalloc_next_use(state, state->active[i]->value, position);
+            if (use > furthest) {
+                victim = i;
+                furthest = use;
+            }
+        }
+        if (victim < 0) {
+            regalloc_spill(state, current);
+            continue;
+        }
+
+        LiveInterval *evicted = state->active[victim];
+        state->active[victim] = state->active[--state->active_count];
+        reg = evicted->reg;
+        if (evicted->start == position) {
+            regalloc_spill(state, evicted);
+        } else {
+            regalloc_spill(state, regalloc_split(state, evicted, position));
+        }
+        taken[reg] = regalloc_assign(state, current, reg);
+    }
+}
+
+// ============================================================================
+// Spill slots and moves
+// ============================================================================
+
+// Every value that spends time on the stack needs a slot. Values are
+// visited by start, and a slot is reused once the lifetime of the value that
+// had it is over, as in linear scan over the slots themselves.
+static void regalloc_assign_slots(RegAllocState *state) {
+    RegAllocation *alloc = state->alloc;
+    int value_count = state->function->value_count;
+    int *order = malloc(sizeof(int) * (size_t)(value_count + 1));
+    int *slot_end = malloc(sizeof(int) * (size_t)(value_count + 1));
+    int order_count = 0;
+
+    for (int v = 0; v < value_count; v++) {
+        alloc->spill_slot[v] = -1;
+        for (LiveInterval *piece = alloc->intervals[v]; piece; piece = piece->next) {
+            if (piece->reg == REGALLOC_STACK) {
+                order[order_count++] = v;
+                break;
+            }
+        }
+    }
+
+    // Insertion sort by start; values are numbered roughly in layout order
+    for (int i = 1; i < order_count; i++) {
+        int value = order[i];
+        int start = alloc->intervals[value]->start;
+        int j = i - 1;
+        while (j >= 0 && alloc->intervals[order[j]]->start > start) {
+            order[j + 1] = order[j];
+            j--;
+        }
+        order[j + 1] = value;
+    }
+
+    for (int i = 0; i < order_count; i++) {
+        int value = order[i];
+        LiveInterval *last = alloc->intervals[value];
+        while (last->next) last = last->next;
+
+        int slot = -1;
+        for (int s = 0; s < alloc->spill_slot_count; s++) {
+            if (slot_end[s] < alloc->intervals[value]->start) {
+                slot = s;
+                break;
+            }
+        }
+        if (slot < 0) {
+            slot = alloc->spill_slot_count++;
+        }
+        slot_end[slot] = last->end;
+        alloc->spill_slot[value] = slot;
+    }
+
+    free(order);
+    free(slot_end);
+}
+
+static RegLocation regalloc_piece_location(const RegAllocation *alloc, const LiveInterval *piece) {
+    RegLocation location = {piece->reg, -1};
+    if (piece->reg == REGALLOC_STACK) {
+        location.slot = alloc->spill_slot[piece->value];
+    }
+    return location;
+}
+
+static int regalloc_compare_moves(const void *a, const void *b) {
+    const RegMove *x = a;
+    const RegMove *y = b;
+    // A value reloaded for its use at 2k may be stored again at 2k + 1, so
+    // order by position; at one position stores free registers before
+    // reloads fill them
+    if (x->position != y->position) return x->position - y->position;
+    int x_load = x->to.reg != REGALLOC_STACK;
+    int y_load = y->to.reg != REGALLOC_STACK;
+    if (x_load != y_load) return x_load - y_load;
+    return x->value - y->value;
+}
+
+// Moves between consecutive pieces of a value. Those at a block's first
+// position are left to the edge moves, which know where control came from.
+static void regalloc_collect_moves(RegAllocState *state) {
+    RegAllocation *alloc = state->alloc;
+    int value_count = state->function->value_count;
+    bool *block_starts = calloc((size_t)alloc->block_end[state->function->block_count - 1] + 2,
+                                sizeof(bool));
+    for (int b = 0; b < state->function->block_count; b++) {
+        block_starts[alloc->block_start[b]] = true;
+    }
+
+    int capacity = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            alloc->moves = capacity ? arena_alloc(alloc->arena, sizeof(RegMove) * (size_t)capacity)
+                                    : NULL;
+        }
+        for (int v = 0; v < value_count; v++) {
+            for (LiveInterval *piece = alloc->intervals[v]; piece && piece->next; piece = piece->next) {
+                LiveInterval *next = piece->next;
+                if (piece->reg == next->reg || block_starts[next->start]) continue;
+                if (pass == 0) {
+                    capacity++;
+                    continue;
+                }
+                RegMove *move = &alloc->moves[alloc->move_count++];
+                move->position = next->start;
+                move->value = v;
+                move->constant = NULL;
+                move->from = regalloc_piece_location(alloc, piece);
+                move->to = regalloc_piece_location(alloc, next);
+            }
+        }
+    }
+
+    if (alloc->move_count > 1) {
+        qsort(alloc->moves, (size_t)alloc->move_count, sizeof(RegMove), regalloc_compare_moves);
+    }
+    free(block_starts);
+}
+
+// ============================================================================
+// Interface
+// ============================================================================
+
+RegAllocation *regalloc_function(const IRFunction *function, const TargetConfig *target,
+                                 uint64_t reserved) {
+    if (!function || !target || !function->entry) return NULL;
+
+    Arena *arena = arena_create(REGALLOC_ARENA_CHUNK_SIZE);
+    if (!arena) return NULL;
+
+    int value_count = function->value_count;
+    int block_count = function->block_count;
+    RegAllocation *alloc = arena_calloc(arena, 1, sizeof(RegAllocation));
+    alloc->arena = arena;
+    alloc->function = function;
+    alloc->target = target;
+    alloc->live_words = (value_count + 63) / 64 + 1;
+    alloc->block_start = arena_calloc(arena, (size_t)block_count, sizeof(int));
+    alloc->block_end = arena_calloc(arena, (size_t)block_count, sizeof(int));
+    alloc->live_in = arena_calloc(arena, (size_t)block_count * (size_t)alloc->live_words,
+                                  sizeof(uint64_t));
+    alloc->intervals = arena_calloc(arena, (size_t)value_count + 1, sizeof(LiveInterval*));
+    alloc->spill_slot = arena_calloc(arena, (size_t)value_count + 1, sizeof(int));
+
+    RegAllocState state = {0};
+    state.alloc = alloc;
+    state.function = function;
+    state.target = target;
+    state.blocks = calloc((size_t)block_count, sizeof(IRBlock*));
+    state.live_out = calloc((size_t)block_count * (size_t)alloc->live_words, sizeof(uint64_t));
+    state.active = malloc(sizeof(LiveInterval*) * (size_t)(target->num_general_regs + 1));
+    for (int r = 0; r < target->num_general_regs && r < 64; r++) {
+        if (target->general_regs[r].type == REG_GENERAL && !((reserved >> r) & 1)) {
+            state.allocatable |= (uint64_t)1 << r;
+        }
+    }
+
+    regalloc_number(&state);
+    regalloc_liveness(&state);
+    regalloc_build_intervals(&state);
+    regalloc_linear_scan(&state);
+    regalloc_assign_slots(&state);
+    regalloc_collect_moves(&state);
+
+    free(state.blocks);
+    free(state.live_out);
+    free(state.use_start);
+    free(state.uses);
+    free(state.calls);
+    free(state.unhandled);
+    free(state.active);
+    return alloc;
+}
+
+void regalloc_destroy(RegAllocation *alloc) {
+    if (alloc) {
+        arena_destroy(alloc->arena);
+    }
+}
+
+RegLocation regalloc_location(const RegAllocation *alloc, int value, int position) {
+    const LiveInterval *piece = alloc->intervals[value];
+    while (piece && piece->next && piece->end < position) {
+        piece = piece->next;
+    }
+    if (!piece) {
+        RegLocation nowhere = {REGALLOC_STACK, -1};
+        return nowhere;
+    }
+    return regalloc_piece_location(alloc, piece);
+}
+
+bool regalloc_same_location(RegLocation a, RegLocation b) {
+    return a.reg == b.reg && (a.reg != REGALLOC_STACK || a.slot == b.slot);
+}
+
+RegMove *regalloc_edge_moves(const RegAllocation *alloc, const IRBlock *pred,
+                             const IRBlock *succ, int *count) {
+    int from_position = alloc->block_end[pred->id];
+    int to_position = alloc->block_start[succ->id];
+    int pred_index = regalloc_pred_index(succ, pred);
+    const uint64_t *in = alloc->live_in + (size_t)succ->id * (size_t)alloc->live_words;
+
+    int capacity = 0;
+    for (IRInstr *phi = succ->first; phi && phi->op == IR_PHI; phi = phi->next) {
+        capacity++;
+    }
+    for (int v = 0; v < alloc->function->value_count; v++) {
+        if (regalloc_bit(in, v)) capacity++;
+    }
+
+    *count = 0;
+    if (capacity == 0) return NULL;
+    RegMove *moves = malloc(sizeof(RegMove) * (size_t)capacity);
+
+    for (int v = 0; v < alloc->function->value_count; v++) {
+        if (!regalloc_bit(in, v)) continue;
+        RegMove move = {to_position, v, NULL,
+                        regalloc_location(alloc, v, from_position),
+                        regalloc_location(alloc, v, to_position)};
+        if (!regalloc_same_location(move.from, move.to)) {
+            moves[(*count)++] = move;
+        }
+    }
+
+    for (IRInstr *phi = succ->first; phi && phi->op == IR_PHI; phi = phi->next) {
+        if (pred_index < 0 || pred_index >= phi->operand_count) continue;
+        const IRInstr *operand = phi->operands[pred_index];
+        RegMove move = {to_position, phi->id, NULL, {REGALLOC_STACK, -1},
+                        regalloc_location(alloc, phi->id, to_position)};
+        if (operand->id >= 0) {
+            move.from = regalloc_location(alloc, operand->id, from_position);
+            if (regalloc_same_location(move.from, move.to)) continue;
+        } else if (operand->op == IR_CONST) {
+            move.constant = operand;
+        } else {
+            continue;
+        }
+        moves[(*count)++] = move;
+    }
+
+    if (*count == 0) {
+        free(moves);
+        return NULL;
+    }
+    return moves;
+}
+
+void regalloc_print(const RegAllocation *alloc, FILE *out) {
+    fprintf(out, "; %s: %d spill slots\n", alloc->function->name, alloc->spill_slot_count);
+    for (int v = 0; v < alloc->function->value_count; v++) {
+        if (!alloc->intervals[v]) continue;
+        fprintf(out, ";   %%%d", v);
+        for (const LiveInterval *piece = alloc->intervals[v]; piece; piece = piece->next) {
+            if (piece->reg == REGALLOC_STACK) {
+                fprintf(out, " [%d,%d] slot%d", piece->start, piece->end, alloc->spill_slot[v]);
+            } else {
+                fprintf(out, " [%d,%d] %s", piece->start, piece->end,
+                        alloc->target->general_regs[piece->reg].name);
+            }
+        }
+        fputc('\n', out);
+    }
+}
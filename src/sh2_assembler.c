@@ -0,0 +1,1854 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <ctype.h>
+
+#include "sh2_assembler.h"
+#include "sh2_instruction_set.h"
+#include "elf_writer.h"
+#include "intern.h"
+#include "error.h"
+
+#define SH2_MAX_SECTIONS 16
+#define SH2_NONE (-1)
+
+// ELF SH relocation type
+#define R_SH_DIR32 1
+
+// How far past a PC-relative load its literal may end up (conservatively:
+// mov.l reaches (PC & ~3) + 4 + 1020, mov.w PC + 4 + 510)
+#define SH2_REACH_LONG 1020
+#define SH2_REACH_WORD 512
+
+typedef enum {
+    SH2_ITEM_INSN,                   // Complete opcode
+    SH2_ITEM_BRANCH,                 // bra/bsr/bt/bf(/s) to a label
+    SH2_ITEM_PCLOAD,                 // mov.w/mov.l/mova from a label or literal
+    SH2_ITEM_DATA,                   // Bytes from data directives
+    SH2_ITEM_WORD,                   // 32-bit symbol address (.long sym)
+    SH2_ITEM_SPACE,                  // Repeated fill byte
+    SH2_ITEM_ALIGN,
+    SH2_ITEM_LABEL,
+    SH2_ITEM_LTORG,                  // .pool/.ltorg: literals may go here
+    SH2_ITEM_POOL                    // Placed literal pool
+} SH2ItemKind;
+
+// Instruction flags
+#define SH2_DELAYED 0x1              // Followed by a delay slot
+#define SH2_BARRIER 0x2              // Never falls through
+#define SH2_RELAXED 0x4              // Branch uses the long form
+#define SH2_ADDRESS 0x8              // mova: the label itself, never a literal
+
+typedef struct SH2Item {
+    SH2ItemKind kind;
+    uint16_t opcode;
+    uint8_t flags;
+    uint8_t width;                   // PCLOAD: 2 or 4
+    int symbol;                      // Target, label or WORD symbol
+    int literal;                     // PCLOAD: pooled literal, or SH2_NONE
+    int64_t addend;                  // WORD/BRANCH addend, SPACE fill
+    size_t offset;                   // DATA: bytes; POOL: first literal
+    size_t length;                   // DATA/SPACE: bytes; ALIGN: alignment;
+                                     // POOL: literal count
+    int line;
+    uint32_t address;                // Assigned by layout
+    uint32_t size;
+} SH2Item;
+
+typedef struct SH2Literal {
+    uint32_t value;                  // Constant, or addend to the symbol
+    int symbol;                      // SH2_NONE for a constant
+    uint8_t width;
+    uint32_t address;
+} SH2Literal;
+
+typedef struct SH2Section {
+    char name[64];
+    uint32_t type;
+    uint64_t flags;
+    uint32_t alignment;
+
+    SH2Item *items;
+    int item_count;
+    int item_capacity;
+
+    unsigned char *bytes;            // DATA payloads
+    size_t byte_count;
+    size_t byte_capacity;
+
+    SH2Literal *literals;
+    int literal_count;
+    int literal_capacity;
+
+    unsigned char *data;             // Encoded contents
+    uint32_t size;
+    uint32_t base;                   // Flat binary address
+    int elf_index;
+} SH2Section;
+
+typedef struct SH2Symbol {
+    const char *name;                // Interned
+    int section;                     // SH2_NONE until defined
+    uint32_t address;                // Section offset, known after layout
+    bool global;
+    int elf_symbol;                  // Writer handle, SH2_NONE until created
+} SH2Symbol;
+
+// A 32-bit absolute address to fill in once symbols have final addresses
+typedef struct SH2Reloc {
+    int section;
+    uint32_t offset;
+    int symbol;
+    int64_t addend;
+} SH2Reloc;
+
+struct SH2Assembler {
+    SH2Section sections[SH2_MAX_SECTIONS];
+    int section_count;
+    int current;
+
+    SH2Symbol *symbols;
+    int symbol_count;
+    int symbol_capacity;
+    int *symbol_slots;               // Open addressing: symbol index + 1, or 0
+    size_t slot_capacity;            // Power of two
+
+    SH2Reloc *relocs;
+    int reloc_count;
+    int reloc_capacity;
+
+    int generated;                   // Counter for assembler-made labels
+    bool finished;                   // Layout done; no more input
+    int line;
+    int error_count;
+};
+
+typedef enum {
+    SH2_ARG_REG,                     // Rn
+    SH2_ARG_R0,                      // Form only: Rn that must be R0
+    SH2_ARG_CTRL,                    // sr, gbr, vbr
+    SH2_ARG_SYS,                     // mach, macl, pr
+    SH2_ARG_IMM,                     // #imm
+    SH2_ARG_IND,                     // @Rn
+    SH2_ARG_POSTINC,                 // @Rn+
+    SH2_ARG_PREDEC,                  // @-Rn
+    SH2_ARG_DISP,                    // @(disp,Rn)
+    SH2_ARG_R0IDX,                   // @(R0,Rn)
+    SH2_ARG_GBRDISP,                 // @(disp,GBR)
+    SH2_ARG_R0GBR,                   // @(R0,GBR)
+    SH2_ARG_PCDISP,                  // @(disp,PC)
+    SH2_ARG_LABEL,                   // symbol[+-offset]
+    SH2_ARG_NONE
+} SH2ArgKind;
+
+typedef struct SH2Arg {
+    SH2ArgKind kind;
+    int reg;                         // Register, base register or index of
+                                     // the control/system register
+    int64_t value;                   // Immediate, displacement or offset
+    int symbol;
+} SH2Arg;
+
+static void sh2_error(SH2Assembler *as, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "Error: SH-2 assembler line %d: ", as->line);
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    as->error_count++;
+}
+
+static void *sh2_grow(void *array, int *capacity, size_t element_size, const char *what) {
+    int grown = *capacity ? *capacity * 2 : 64;
+    void *resized = realloc(array, (size_t)grown * element_size);
+    if (!resized) {
+        error_fatal("Memory allocation failed for assembler %s", what);
+        return NULL;
+    }
+    *capacity = grown;
+    return resized;
+}
+
+// ========================================
+// Sections, items and symbols
+// ========================================
+
+static int sh2_section(SH2Assembler *as, const char *name, uint32_t type, uint64_t flags) {
+    for (int i = 0; i < as->section_count; i++) {
+        if (strcmp(as->sections[i].name, name) == 0) {
+            return i;
+        }
+    }
+    if (as->section_count == SH2_MAX_SECTIONS) {
+        sh2_error(as, "too many sections");
+        return as->current;
+    }
+
+    SH2Section *section = &as->sections[as->section_count];
+    memset(section, 0, sizeof(SH2Section));
+    snprintf(section->name, sizeof(section->name), "%s", name);
+    section->type = type;
+    section->flags = flags;
+    section->alignment = (flags & ELF_SHF_EXECINSTR) ? 2 : 1;
+    return as->section_count++;
+}
+
+static SH2Item *sh2_append(SH2Section *section, SH2ItemKind kind, int line) {
+    if (section->item_count == section->item_capacity) {
+        SH2Item *items = sh2_grow(section->items, &section->item_capacity, sizeof(SH2Item),
+                                  "items");
+        if (!items) return NULL;
+        section->items = items;
+    }
+    SH2Item *item = &section->items[section->item_count++];
+    memset(item, 0, sizeof(SH2Item));
+    item->kind = kind;
+    item->symbol = SH2_NONE;
+    item->literal = SH2_NONE;
+    item->line = line;
+    return item;
+}
+
+static SH2Item *sh2_item(SH2Assembler *as, SH2ItemKind kind) {
+    return sh2_append(&as->sections[as->current], kind, as->line);
+}
+
+static bool sh2_grow_slots(SH2Assembler *as) {
+    size_t capacity = as->slot_capacity ? as->slot_capacity * 2 : 256;
+    int *slots = calloc(capacity, sizeof(int));
+    if (!slots) {
+        error_fatal("Memory allocation failed for assembler symbols");
+        return false;
+    }
+
+    size_t mask = capacity - 1;
+    for (int i = 0; i < as->symbol_count; i++) {
+        size_t index = intern_hash(as->symbols[i].name) & mask;
+        while (slots[index]) index = (index + 1) & mask;
+        slots[index] = i + 1;
+    }
+    free(as->symbol_slots);
+    as->symbol_slots = slots;
+    as->slot_capacity = capacity;
+    return true;
+}
+
+// Finds or creates the symbol with the given spelling
+static int sh2_symbol(SH2Assembler *as, const char *text, size_t length) {
+    if ((size_t)(as->symbol_count + 1) * 2 > as->slot_capacity && !sh2_grow_slots(as)) {
+        return SH2_NONE;
+    }
+
+    const char *name = intern_string_n(text, length);
+    size_t mask = as->slot_capacity - 1;
+    size_t index = intern_hash(name) & mask;
+    while (as->symbol_slots[index]) {
+        int symbol = as->symbol_slots[index] - 1;
+        if (as->symbols[symbol].name == name) {
+            return symbol;
+        }
+        index = (index + 1) & mask;
+    }
+
+    if (as->symbol_count == as->symbol_capacity) {
+        SH2Symbol *symbols = sh2_grow(as->symbols, &as->symbol_capacity, sizeof(SH2Symbol),
+                                      "symbols");
+        if (!symbols) return SH2_NONE;
+        as->symbols = symbols;
+    }
+
+    SH2Symbol *symbol = &as->symbols[as->symbol_count];
+    symbol->name = name;
+    symbol->section = SH2_NONE;
+    symbol->address = 0;
+    symbol->global = false;
+    symbol->elf_symbol = SH2_NONE;
+    as->symbol_slots[index] = as->symbol_count + 1;
+    return as->symbol_count++;
+}
+
+static void sh2_define_label(SH2Assembler *as, int section, int symbol, int line) {
+    SH2Item *item = sh2_append(&as->sections[section], SH2_ITEM_LABEL, line);
+    if (!item) return;
+    item->symbol = symbol;
+    as->symbols[symbol].section = section;
+}
+
+// A label only the assembler refers to
+static int sh2_generated_label(SH2Assembler *as) {
+    char name[32];
+    int length = snprintf(name, sizeof(name), ".Lsh2_%d", as->generated++);
+    return sh2_symbol(as, name, (size_t)length);
+}
+
+static void sh2_emit_bytes(SH2Assembler *as, const void *bytes, size_t length) {
+    SH2Section *section = &as->sections[as->current];
+    if (section->type == ELF_SHT_NOBITS) {
+        sh2_error(as, "data in a NOBITS section");
+        return;
+    }
+
+    if (section->byte_count + length > section->byte_capacity) {
+        size_t capacity = section->byte_capacity ? section->byte_capacity : 256;
+        while (capacity < section->byte_count + length) capacity *= 2;
+        unsigned char *data = realloc(section->bytes, capacity);
+        if (!data) {
+            error_fatal("Memory allocation failed for assembler section");
+            return;
+        }
+        section->bytes = data;
+        section->byte_capacity = capacity;
+    }
+
+    // Consecutive data extends the previous item
+    SH2Item *last = section->item_count ? &section->items[section->item_count - 1] : NULL;
+    if (!last || last->kind != SH2_ITEM_DATA) {
+        last = sh2_item(as, SH2_ITEM_DATA);
+        if (!last) return;
+        last->offset = section->byte_count;
+    }
+    memcpy(section->bytes + section->byte_count, bytes, length);
+    section->byte_count += length;
+    last->length += length;
+}
+
+static void sh2_emit_value(SH2Assembler *as, uint64_t value, int size) {
+    unsigned char bytes[4];
+    for (int i = 0; i < size; i++) {
+        bytes[i] = (unsigned char)(value >> ((size - 1 - i) * 8));
+    }
+    sh2_emit_bytes(as, bytes, (size_t)size);
+}
+
+static void sh2_put16(unsigned char *p, uint16_t value) {
+    p[0] = (unsigned char)(value >> 8);
+    p[1] = (unsigned char)value;
+}
+
+static void sh2_put32(unsigned char *p, uint32_t value) {
+    p[0] = (unsigned char)(value >> 24);
+    p[1] = (unsigned char)(value >> 16);
+    p[2] = (unsigned char)(value >> 8);
+    p[3] = (unsigned char)value;
+}
+
+// ========================================
+// Operands
+// ========================================
+
+static const char *sh2_skip_space(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+static const char *sh2_trim(const char *start, const char *end) {
+    while (end > start && isspace((unsigned char)end[-1])) end--;
+    return end;
+}
+
+static bool sh2_is_symbol_char(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == '.' || c == '$';
+}
+
+// r0-r15 spelled exactly over [p, end)
+static int sh2_register(const char *p, const char *end) {
+    size_t length = (size_t)(end - p);
+    if (length < 2 || length > 3 || tolower((unsigned char)p[0]) != 'r') return SH2_NONE;
+    int number = 0;
+    for (const char *c = p + 1; c < end; c++) {
+        if (!isdigit((unsigned char)*c)) return SH2_NONE;
+        number = number * 10 + (*c - '0');
+    }
+    if (length == 3 && p[1] == '0') return SH2_NONE;
+    return number < 16 ? number : SH2_NONE;
+}
+
+static bool sh2_is_word(const char *p, const char *end, const char *word) {
+    size_t length = strlen(word);
+    return (size_t)(end - p) == length && strncasecmp(p, word, length) == 0;
+}
+
+// number, symbol, or symbol/number terms joined by + and -; at most one
+// (positive) symbol
+static bool sh2_parse_expression(SH2Assembler *as, const char **cursor, const char *end,
+                                 int64_t *value, int *symbol) {
+    const char *p = sh2_skip_space(*cursor, end);
+    *value = 0;
+    *symbol = SH2_NONE;
+    bool negate = false;
+    bool any = false;
+
+    while (p < end) {
+        if (*p == '-' || *p == '+') {
+            if (*p == '-') negate = !negate;
+            p = sh2_skip_space(p + 1, end);
+            continue;
+        }
+
+        if (isdigit((unsigned char)*p)) {
+            char *number_end;
+            int64_t number = (int64_t)strtoull(p, &number_end, 0);
+            if (number_end > end) number_end = (char *)end;
+            *value += negate ? -number : number;
+            p = number_end;
+        } else if (*p == '\'' && p + 1 < end) {
+            *value += negate ? -(int64_t)(unsigned char)p[1] : (int64_t)(unsigned char)p[1];
+            p += (p + 2 < end && p[2] == '\'') ? 3 : 2;
+        } else if (sh2_is_symbol_char(*p)) {
+            const char *start = p;
+            while (p < end && sh2_is_symbol_char(*p)) p++;
+            if (*symbol != SH2_NONE || negate) {
+                sh2_error(as, "unsupported symbol arithmetic");
+                return false;
+            }
+            *symbol = sh2_symbol(as, start, (size_t)(p - start));
+        } else {
+            break;
+        }
+
+        any = true;
+        negate = false;
+        p = sh2_skip_space(p, end);
+        if (p >= end || (*p != '+' && *p != '-')) break;
+    }
+
+    if (!any) {
+        sh2_error(as, "expected an expression");
+        return false;
+    }
+    *cursor = p;
+    return true;
+}
+
+// A constant expression filling [p, end)
+static bool sh2_parse_constant(SH2Assembler *as, const char *p, const char *end, int64_t *value) {
+    int symbol;
+    if (!sh2_parse_expression(as, &p, end, value, &symbol)) return false;
+    if (symbol != SH2_NONE || sh2_skip_space(p, end) != end) {
+        sh2_error(as, "expected a constant");
+        return false;
+    }
+    return true;
+}
+
+// @(a,b)
+static bool sh2_parse_indexed(SH2Assembler *as, const char *p, const char *end, SH2Arg *arg) {
+    if (end - p < 2 || end[-1] != ')') {
+        sh2_error(as, "expected ')'");
+        return false;
+    }
+    end--;
+    const char *comma = memchr(p, ',', (size_t)(end - p));
+    if (!comma) {
+        sh2_error(as, "expected @(displacement,register)");
+        return false;
+    }
+
+    const char *first = sh2_skip_space(p, comma);
+    const char *first_end = sh2_trim(first, comma);
+    const char *second = sh2_skip_space(comma + 1, end);
+    const char *second_end = sh2_trim(second, end);
+
+    bool gbr = sh2_is_word(second, second_end, "gbr");
+    bool pc = sh2_is_word(second, second_end, "pc");
+    int base = sh2_register(second, second_end);
+    if (!gbr && !pc && base == SH2_NONE) {
+        sh2_error(as, "unknown base register '%.*s'", (int)(second_end - second), second);
+        return false;
+    }
+
+    if (sh2_register(first, first_end) == 0) {
+        if (pc) {
+            sh2_error(as, "@(r0,pc) is not an SH-2 addressing mode");
+            return false;
+        }
+        arg->kind = gbr ? SH2_ARG_R0GBR : SH2_ARG_R0IDX;
+        arg->reg = base;
+        return true;
+    }
+
+    if (!sh2_parse_constant(as, first, first_end, &arg->value)) return false;
+    arg->kind = gbr ? SH2_ARG_GBRDISP : pc ? SH2_ARG_PCDISP : SH2_ARG_DISP;
+    arg->reg = base;
+    return true;
+}
+
+static bool sh2_parse_arg(SH2Assembler *as, const char *p, const char *end, SH2Arg *arg) {
+    p = sh2_skip_space(p, end);
+    end = sh2_trim(p, end);
+    arg->reg = SH2_NONE;
+    arg->value = 0;
+    arg->symbol = SH2_NONE;
+
+    if (p >= end) {
+        sh2_error(as, "missing operand");
+        return false;
+    }
+
+    if (*p == '#') {
+        arg->kind = SH2_ARG_IMM;
+        return sh2_parse_constant(as, p + 1, end, &arg->value);
+    }
+
+    if (*p == '@') {
+        p = sh2_skip_space(p + 1, end);
+        if (p < end && *p == '(') {
+            return sh2_parse_indexed(as, p + 1, end, arg);
+        }
+        arg->kind = SH2_ARG_IND;
+        if (p < end && *p == '-') {
+            arg->kind = SH2_ARG_PREDEC;
+            p++;
+        } else if (end > p && end[-1] == '+') {
+            arg->kind = SH2_ARG_POSTINC;
+            end--;
+        }
+        arg->reg = sh2_register(p, end);
+        if (arg->reg == SH2_NONE) {
+            sh2_error(as, "expected a register after '@'");
+            return false;
+        }
+        return true;
+    }
+
+    if ((arg->reg = sh2_register(p, end)) != SH2_NONE) {
+        arg->kind = SH2_ARG_REG;
+        return true;
+    }
+    if ((arg->reg = sh2_control_register(p, (size_t)(end - p))) >= 0) {
+        arg->kind = SH2_ARG_CTRL;
+        return true;
+    }
+    if ((arg->reg = sh2_system_register(p, (size_t)(end - p))) >= 0) {
+        arg->kind = SH2_ARG_SYS;
+        return true;
+    }
+
+    arg->kind = SH2_ARG_LABEL;
+    const char *cursor = p;
+    if (!sh2_parse_expression(as, &cursor, end, &arg->value, &arg->symbol)) return false;
+    if (arg->symbol == SH2_NONE || sh2_skip_space(cursor, end) != end) {
+        sh2_error(as, "expected a label");
+        return false;
+    }
+    return true;
+}
+
+// ========================================
+// Instructions
+// ========================================
+
+typedef enum {
+    SH2_ENC_NONE,                    // No operand fields
+    SH2_ENC_N,                       // First operand's register in n
+    SH2_ENC_MN,                      // First operand's register in m, second's in n
+    SH2_ENC_LDC,                     // Register in n, control register in bits 4-5
+    SH2_ENC_STC,                     // Control register in bits 4-5, register in n
+    SH2_ENC_IMM_S,                   // Signed 8-bit immediate
+    SH2_ENC_IMM_U,                   // Unsigned 8-bit immediate
+    SH2_ENC_IMM_N,                   // Signed 8-bit immediate, register in n
+    SH2_ENC_DISP_LOAD,               // mov.l @(disp,Rm),Rn
+    SH2_ENC_DISP_STORE,              // mov.l Rm,@(disp,Rn)
+    SH2_ENC_DISP_R0_LOAD,            // mov.b/w @(disp,Rm),R0
+    SH2_ENC_DISP_R0_STORE,           // mov.b/w R0,@(disp,Rn)
+    SH2_ENC_GBR_LOAD,                // mov.x @(disp,GBR),R0
+    SH2_ENC_GBR_STORE,               // mov.x R0,@(disp,GBR)
+    SH2_ENC_PC_DISP,                 // mov.x/mova @(disp,PC),Rn
+    SH2_ENC_PC_LABEL,                // mov.x/mova label,Rn
+    SH2_ENC_BRANCH                   // bra/bsr/bt/bf(/s) label
+} SH2Encoding;
+
+typedef struct SH2Form {
+    const char *mnemonic;
+    SH2ArgKind first;
+    SH2ArgKind second;
+    uint16_t opcode;
+    SH2Encoding encoding;
+    uint8_t scale;                   // Displacement unit in bytes
+    uint8_t flags;
+} SH2Form;
+
+#define SH2_NO SH2_ARG_NONE
+
+static const SH2Form sh2_forms[] = {
+    // Data transfer
+    {"mov",     SH2_ARG_IMM,     SH2_ARG_REG,     SH2_OP_MOV_IMM,       SH2_ENC_IMM_N, 1, 0},
+    {"mov",     SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_MOV_RR,        SH2_ENC_MN, 1, 0},
+    {"mov.b",   SH2_ARG_REG,     SH2_ARG_IND,     SH2_OP_MOV_B_STORE,   SH2_ENC_MN, 1, 0},
+    {"mov.w",   SH2_ARG_REG,     SH2_ARG_IND,     SH2_OP_MOV_W_STORE,   SH2_ENC_MN, 1, 0},
+    {"mov.l",   SH2_ARG_REG,     SH2_ARG_IND,     SH2_OP_MOV_L_STORE,   SH2_ENC_MN, 1, 0},
+    {"mov.b",   SH2_ARG_IND,     SH2_ARG_REG,     SH2_OP_MOV_B_LOAD,    SH2_ENC_MN, 1, 0},
+    {"mov.w",   SH2_ARG_IND,     SH2_ARG_REG,     SH2_OP_MOV_W_LOAD,    SH2_ENC_MN, 1, 0},
+    {"mov.l",   SH2_ARG_IND,     SH2_ARG_REG,     SH2_OP_MOV_L_LOAD,    SH2_ENC_MN, 1, 0},
+    {"mov.b",   SH2_ARG_REG,     SH2_ARG_PREDEC,  SH2_OP_MOV_B_PREDEC,  SH2_ENC_MN, 1, 0},
+    {"mov.w",   SH2_ARG_REG,     SH2_ARG_PREDEC,  SH2_OP_MOV_W_PREDEC,  SH2_ENC_MN, 1, 0},
+    {"mov.l",   SH2_ARG_REG,     SH2_ARG_PREDEC,  SH2_OP_MOV_L_PREDEC,  SH2_ENC_MN, 1, 0},
+    {"mov.b",   SH2_ARG_POSTINC, SH2_ARG_REG,     SH2_OP_MOV_B_POSTINC, SH2_ENC_MN, 1, 0},
+    {"mov.w",   SH2_ARG_POSTINC, SH2_ARG_REG,     SH2_OP_MOV_W_POSTINC, SH2_ENC_MN, 1, 0},
+    {"mov.l",   SH2_ARG_POSTINC, SH2_ARG_REG,     SH2_OP_MOV_L_POSTINC, SH2_ENC_MN, 1, 0},
+    {"mov.b",   SH2_ARG_REG,     SH2_ARG_R0IDX,   SH2_OP_MOV_B_R0_STORE, SH2_ENC_MN, 1, 0},
+    {"mov.w",   SH2_ARG_REG,     SH2_ARG_R0IDX,   SH2_OP_MOV_W_R0_STORE, SH2_ENC_MN, 1, 0},
+    {"mov.l",   SH2_ARG_REG,     SH2_ARG_R0IDX,   SH2_OP_MOV_L_R0_STORE, SH2_ENC_MN, 1, 0},
+    {"mov.b",   SH2_ARG_R0IDX,   SH2_ARG_REG,     SH2_OP_MOV_B_R0_LOAD, SH2_ENC_MN, 1, 0},
+    {"mov.w",   SH2_ARG_R0IDX,   SH2_ARG_REG,     SH2_OP_MOV_W_R0_LOAD, SH2_ENC_MN, 1, 0},
+    {"mov.l",   SH2_ARG_R0IDX,   SH2_ARG_REG,     SH2_OP_MOV_L_R0_LOAD, SH2_ENC_MN, 1, 0},
+    {"mov.b",   SH2_ARG_R0,      SH2_ARG_GBRDISP, SH2_OP_MOV_B_GBR_STORE, SH2_ENC_GBR_STORE, 1, 0},
+    {"mov.w",   SH2_ARG_R0,      SH2_ARG_GBRDISP, SH2_OP_MOV_W_GBR_STORE, SH2_ENC_GBR_STORE, 2, 0},
+    {"mov.l",   SH2_ARG_R0,      SH2_ARG_GBRDISP, SH2_OP_MOV_L_GBR_STORE, SH2_ENC_GBR_STORE, 4, 0},
+    {"mov.b",   SH2_ARG_GBRDISP, SH2_ARG_R0,      SH2_OP_MOV_B_GBR_LOAD, SH2_ENC_GBR_LOAD, 1, 0},
+    {"mov.w",   SH2_ARG_GBRDISP, SH2_ARG_R0,      SH2_OP_MOV_W_GBR_LOAD, SH2_ENC_GBR_LOAD, 2, 0},
+    {"mov.l",   SH2_ARG_GBRDISP, SH2_ARG_R0,      SH2_OP_MOV_L_GBR_LOAD, SH2_ENC_GBR_LOAD, 4, 0},
+    {"mov.b",   SH2_ARG_R0,      SH2_ARG_DISP,    SH2_OP_MOV_B_R0_DISP_STORE, SH2_ENC_DISP_R0_STORE, 1, 0},
+    {"mov.w",   SH2_ARG_R0,      SH2_ARG_DISP,    SH2_OP_MOV_W_R0_DISP_STORE, SH2_ENC_DISP_R0_STORE, 2, 0},
+    {"mov.l",   SH2_ARG_REG,     SH2_ARG_DISP,    SH2_OP_MOV_L_DISP_STORE, SH2_ENC_DISP_STORE, 4, 0},
+    {"mov.b",   SH2_ARG_DISP,    SH2_ARG_R0,      SH2_OP_MOV_B_DISP_R0_LOAD, SH2_ENC_DISP_R0_LOAD, 1, 0},
+    {"mov.w",   SH2_ARG_DISP,    SH2_ARG_R0,      SH2_OP_MOV_W_DISP_R0_LOAD, SH2_ENC_DISP_R0_LOAD, 2, 0},
+    {"mov.l",   SH2_ARG_DISP,    SH2_ARG_REG,     SH2_OP_MOV_L_DISP_LOAD, SH2_ENC_DISP_LOAD, 4, 0},
+    {"mov.w",   SH2_ARG_PCDISP,  SH2_ARG_REG,     SH2_OP_MOV_W_PC,      SH2_ENC_PC_DISP, 2, 0},
+    {"mov.l",   SH2_ARG_PCDISP,  SH2_ARG_REG,     SH2_OP_MOV_L_PC,      SH2_ENC_PC_DISP, 4, 0},
+    {"mov.w",   SH2_ARG_LABEL,   SH2_ARG_REG,     SH2_OP_MOV_W_PC,      SH2_ENC_PC_LABEL, 2, 0},
+    {"mov.l",   SH2_ARG_LABEL,   SH2_ARG_REG,     SH2_OP_MOV_L_PC,      SH2_ENC_PC_LABEL, 4, 0},
+    {"mova",    SH2_ARG_PCDISP,  SH2_ARG_R0,      SH2_OP_MOVA,          SH2_ENC_PC_DISP, 4, 0},
+    {"mova",    SH2_ARG_LABEL,   SH2_ARG_R0,      SH2_OP_MOVA,          SH2_ENC_PC_LABEL, 4, SH2_ADDRESS},
+    {"movt",    SH2_ARG_REG,     SH2_NO,          SH2_OP_MOVT,          SH2_ENC_N, 1, 0},
+    {"swap.b",  SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_SWAP_B,        SH2_ENC_MN, 1, 0},
+    {"swap.w",  SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_SWAP_W,        SH2_ENC_MN, 1, 0},
+    {"xtrct",   SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_XTRCT,         SH2_ENC_MN, 1, 0},
+
+    // Arithmetic
+    {"add",     SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_ADD,           SH2_ENC_MN, 1, 0},
+    {"add",     SH2_ARG_IMM,     SH2_ARG_REG,     SH2_OP_ADD_IMM,       SH2_ENC_IMM_N, 1, 0},
+    {"addc",    SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_ADDC,          SH2_ENC_MN, 1, 0},
+    {"addv",    SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_ADDV,          SH2_ENC_MN, 1, 0},
+    {"sub",     SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_SUB,           SH2_ENC_MN, 1, 0},
+    {"subc",    SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_SUBC,          SH2_ENC_MN, 1, 0},
+    {"subv",    SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_SUBV,          SH2_ENC_MN, 1, 0},
+    {"neg",     SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_NEG,           SH2_ENC_MN, 1, 0},
+    {"negc",    SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_NEGC,          SH2_ENC_MN, 1, 0},
+    {"mac.l",   SH2_ARG_POSTINC, SH2_ARG_POSTINC, SH2_OP_MAC_L,         SH2_ENC_MN, 1, 0},
+    {"mac.w",   SH2_ARG_POSTINC, SH2_ARG_POSTINC, SH2_OP_MAC_W,         SH2_ENC_MN, 1, 0},
+    {"mac",     SH2_ARG_POSTINC, SH2_ARG_POSTINC, SH2_OP_MAC_W,         SH2_ENC_MN, 1, 0},
+    {"mul.l",   SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_MUL_L,         SH2_ENC_MN, 1, 0},
+    {"mulu.w",  SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_MULU_W,        SH2_ENC_MN, 1, 0},
+    {"mulu",    SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_MULU_W,        SH2_ENC_MN, 1, 0},
+    {"muls.w",  SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_MULS_W,        SH2_ENC_MN, 1, 0},
+    {"muls",    SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_MULS_W,        SH2_ENC_MN, 1, 0},
+    {"div0s",   SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_DIV0S,         SH2_ENC_MN, 1, 0},
+    {"div0u",   SH2_NO,          SH2_NO,          SH2_OP_DIV0U,         SH2_ENC_NONE, 1, 0},
+    {"div1",    SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_DIV1,          SH2_ENC_MN, 1, 0},
+    {"dmulu.l", SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_DMULU_L,       SH2_ENC_MN, 1, 0},
+    {"dmuls.l", SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_DMULS_L,       SH2_ENC_MN, 1, 0},
+    {"dt",      SH2_ARG_REG,     SH2_NO,          SH2_OP_DT,            SH2_ENC_N, 1, 0},
+    {"exts.b",  SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_EXTS_B,        SH2_ENC_MN, 1, 0},
+    {"exts.w",  SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_EXTS_W,        SH2_ENC_MN, 1, 0},
+    {"extu.b",  SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_EXTU_B,        SH2_ENC_MN, 1, 0},
+    {"extu.w",  SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_EXTU_W,        SH2_ENC_MN, 1, 0},
+
+    // Compare
+    {"cmp/eq",  SH2_ARG_IMM,     SH2_ARG_R0,      SH2_OP_CMP_EQ_IMM,    SH2_ENC_IMM_S, 1, 0},
+    {"cmp/eq",  SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_CMP_EQ,        SH2_ENC_MN, 1, 0},
+    {"cmp/hs",  SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_CMP_HS,        SH2_ENC_MN, 1, 0},
+    {"cmp/ge",  SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_CMP_GE,        SH2_ENC_MN, 1, 0},
+    {"cmp/hi",  SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_CMP_HI,        SH2_ENC_MN, 1, 0},
+    {"cmp/gt",  SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_CMP_GT,        SH2_ENC_MN, 1, 0},
+    {"cmp/str", SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_CMP_STR,       SH2_ENC_MN, 1, 0},
+    {"cmp/pz",  SH2_ARG_REG,     SH2_NO,          SH2_OP_CMP_PZ,        SH2_ENC_N, 1, 0},
+    {"cmp/pl",  SH2_ARG_REG,     SH2_NO,          SH2_OP_CMP_PL,        SH2_ENC_N, 1, 0},
+
+    // Logic
+    {"and",     SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_AND,           SH2_ENC_MN, 1, 0},
+    {"and",     SH2_ARG_IMM,     SH2_ARG_R0,      SH2_OP_AND_IMM,       SH2_ENC_IMM_U, 1, 0},
+    {"and.b",   SH2_ARG_IMM,     SH2_ARG_R0GBR,   SH2_OP_AND_B,         SH2_ENC_IMM_U, 1, 0},
+    {"or",      SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_OR,            SH2_ENC_MN, 1, 0},
+    {"or",      SH2_ARG_IMM,     SH2_ARG_R0,      SH2_OP_OR_IMM,        SH2_ENC_IMM_U, 1, 0},
+    {"or.b",    SH2_ARG_IMM,     SH2_ARG_R0GBR,   SH2_OP_OR_B,          SH2_ENC_IMM_U, 1, 0},
+    {"xor",     SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_XOR,           SH2_ENC_MN, 1, 0},
+    {"xor",     SH2_ARG_IMM,     SH2_ARG_R0,      SH2_OP_XOR_IMM,       SH2_ENC_IMM_U, 1, 0},
+    {"xor.b",   SH2_ARG_IMM,     SH2_ARG_R0GBR,   SH2_OP_XOR_B,         SH2_ENC_IMM_U, 1, 0},
+    {"tst",     SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_TST,           SH2_ENC_MN, 1, 0},
+    {"tst",     SH2_ARG_IMM,     SH2_ARG_R0,      SH2_OP_TST_IMM,       SH2_ENC_IMM_U, 1, 0},
+    {"tst.b",   SH2_ARG_IMM,     SH2_ARG_R0GBR,   SH2_OP_TST_B,         SH2_ENC_IMM_U, 1, 0},
+    {"not",     SH2_ARG_REG,     SH2_ARG_REG,     SH2_OP_NOT,           SH2_ENC_MN, 1, 0},
+    {"tas.b",   SH2_ARG_IND,     SH2_NO,          SH2_OP_TAS_B,         SH2_ENC_N, 1, 0},
+
+    // Shift and rotate
+    {"shal",    SH2_ARG_REG,     SH2_NO,          SH2_OP_SHAL,          SH2_ENC_N, 1, 0},
+    {"shar",    SH2_ARG_REG,     SH2_NO,          SH2_OP_SHAR,          SH2_ENC_N, 1, 0},
+    {"shll",    SH2_ARG_REG,     SH2_NO,          SH2_OP_SHLL,          SH2_ENC_N, 1, 0},
+    {"shlr",    SH2_ARG_REG,     SH2_NO,          SH2_OP_SHLR,          SH2_ENC_N, 1, 0},
+    {"shll2",   SH2_ARG_REG,     SH2_NO,          SH2_OP_SHLL2,         SH2_ENC_N, 1, 0},
+    {"shlr2",   SH2_ARG_REG,     SH2_NO,          SH2_OP_SHLR2,         SH2_ENC_N, 1, 0},
+    {"shll8",   SH2_ARG_REG,     SH2_NO,          SH2_OP_SHLL8,         SH2_ENC_N, 1, 0},
+    {"shlr8",   SH2_ARG_REG,     SH2_NO,          SH2_OP_SHLR8,         SH2_ENC_N, 1, 0},
+    {"shll16",  SH2_ARG_REG,     SH2_NO,          SH2_OP_SHLL16,        SH2_ENC_N, 1, 0},
+    {"shlr16",  SH2_ARG_REG,     SH2_NO,          SH2_OP_SHLR16,        SH2_ENC_N, 1, 0},
+    {"rotl",    SH2_ARG_REG,     SH2_NO,          SH2_OP_ROTL,          SH2_ENC_N, 1, 0},
+    {"rotr",    SH2_ARG_REG,     SH2_NO,          SH2_OP_ROTR,          SH2_ENC_N, 1, 0},
+    {"rotcl",   SH2_ARG_REG,     SH2_NO,          SH2_OP_ROTCL,         SH2_ENC_N, 1, 0},
+    {"rotcr",   SH2_ARG_REG,     SH2_NO,          SH2_OP_ROTCR,         SH2_ENC_N, 1, 0},
+
+    // Branch
+    {"bra",     SH2_ARG_LABEL,   SH2_NO,          SH2_OP_BRA,  SH2_ENC_BRANCH, 2, SH2_DELAYED | SH2_BARRIER},
+    {"bsr",     SH2_ARG_LABEL,   SH2_NO,          SH2_OP_BSR,  SH2_ENC_BRANCH, 2, SH2_DELAYED},
+    {"bt",      SH2_ARG_LABEL,   SH2_NO,          SH2_OP_BT,   SH2_ENC_BRANCH, 2, 0},
+    {"bf",      SH2_ARG_LABEL,   SH2_NO,          SH2_OP_BF,   SH2_ENC_BRANCH, 2, 0},
+    {"bt/s",    SH2_ARG_LABEL,   SH2_NO,          SH2_OP_BT_S, SH2_ENC_BRANCH, 2, SH2_DELAYED},
+    {"bf/s",    SH2_ARG_LABEL,   SH2_NO,          SH2_OP_BF_S, SH2_ENC_BRANCH, 2, SH2_DELAYED},
+    {"bt.s",    SH2_ARG_LABEL,   SH2_NO,          SH2_OP_BT_S, SH2_ENC_BRANCH, 2, SH2_DELAYED},
+    {"bf.s",    SH2_ARG_LABEL,   SH2_NO,          SH2_OP_BF_S, SH2_ENC_BRANCH, 2, SH2_DELAYED},
+    {"braf",    SH2_ARG_REG,     SH2_NO,          SH2_OP_BRAF, SH2_ENC_N, 1, SH2_DELAYED | SH2_BARRIER},
+    {"bsrf",    SH2_ARG_REG,     SH2_NO,          SH2_OP_BSRF, SH2_ENC_N, 1, SH2_DELAYED},
+    {"jmp",     SH2_ARG_IND,     SH2_NO,          SH2_OP_JMP,  SH2_ENC_N, 1, SH2_DELAYED | SH2_BARRIER},
+    {"jsr",     SH2_ARG_IND,     SH2_NO,          SH2_OP_JSR,  SH2_ENC_N, 1, SH2_DELAYED},
+    {"rts",     SH2_NO,          SH2_NO,          SH2_OP_RTS,  SH2_ENC_NONE, 1, SH2_DELAYED | SH2_BARRIER},
+    {"rte",     SH2_NO,          SH2_NO,          SH2_OP_RTE,  SH2_ENC_NONE, 1, SH2_DELAYED | SH2_BARRIER},
+    {"trapa",   SH2_ARG_IMM,     SH2_NO,          SH2_OP_TRAPA, SH2_ENC_IMM_U, 1, 0},
+
+    // System control
+    {"ldc",     SH2_ARG_REG,     SH2_ARG_CTRL,    SH2_OP_LDC,   SH2_ENC_LDC, 1, 0},
+    {"ldc.l",   SH2_ARG_POSTINC, SH2_ARG_CTRL,    SH2_OP_LDC_L, SH2_ENC_LDC, 1, 0},
+    {"stc",     SH2_ARG_CTRL,    SH2_ARG_REG,     SH2_OP_STC,   SH2_ENC_STC, 1, 0},
+    {"stc.l",   SH2_ARG_CTRL,    SH2_ARG_PREDEC,  SH2_OP_STC_L, SH2_ENC_STC, 1, 0},
+    {"lds",     SH2_ARG_REG,     SH2_ARG_SYS,     SH2_OP_LDS,   SH2_ENC_LDC, 1, 0},
+    {"lds.l",   SH2_ARG_POSTINC, SH2_ARG_SYS,     SH2_OP_LDS_L, SH2_ENC_LDC, 1, 0},
+    {"sts",     SH2_ARG_SYS,     SH2_ARG_REG,     SH2_OP_STS,   SH2_ENC_STC, 1, 0},
+    {"sts.l",   SH2_ARG_SYS,     SH2_ARG_PREDEC,  SH2_OP_STS_L, SH2_ENC_STC, 1, 0},
+    {"clrmac",  SH2_NO,          SH2_NO,          SH2_OP_CLRMAC, SH2_ENC_NONE, 1, 0},
+    {"clrt",    SH2_NO,          SH2_NO,          SH2_OP_CLRT,   SH2_ENC_NONE, 1, 0},
+    {"sett",    SH2_NO,          SH2_NO,          SH2_OP_SETT,   SH2_ENC_NONE, 1, 0},
+    {"nop",     SH2_NO,          SH2_NO,          SH2_OP_NOP,    SH2_ENC_NONE, 1, 0},
+    {"sleep",   SH2_NO,          SH2_NO,          SH2_OP_SLEEP,  SH2_ENC_NONE, 1, 0},
+};
+
+#undef SH2_NO
+
+static bool sh2_arg_matches(SH2ArgKind expected, const SH2Arg *arg) {
+    if (expected == SH2_ARG_R0) {
+        return arg->kind == SH2_ARG_REG && arg->reg == 0;
+    }
+    return arg->kind == expected;
+}
+
+static uint16_t sh2_field_n(int reg) {
+    return (uint16_t)((reg & 0xF) << 8);
+}
+
+static uint16_t sh2_field_m(int reg) {
+    return (uint16_t)((reg & 0xF) << 4);
+}
+
+// A displacement that must be a multiple of scale below limit units
+static bool sh2_displacement(SH2Assembler *as, int64_t disp, int scale, int limit, uint16_t *field) {
+    if (disp < 0 || disp % scale || disp / scale >= limit) {
+        sh2_error(as, "displacement %lld is out of range", (long long)disp);
+        return false;
+    }
+    *field = (uint16_t)(disp / scale);
+    return true;
+}
+
+static bool sh2_immediate(SH2Assembler *as, int64_t value, int64_t low, int64_t high,
+                          uint16_t *field) {
+    if (value < low || value > high) {
+        sh2_error(as, "immediate %lld is out of range", (long long)value);
+        return false;
+    }
+    *field = (uint16_t)(value & 0xFF);
+    return true;
+}
+
+// A PC-relative instruction must not sit in a delay slot, where its PC is
+// not its own address
+static bool sh2_in_delay_slot(SH2Assembler *as) {
+    SH2Section *section = &as->sections[as->current];
+    for (int i = section->item_count - 1; i >= 0; i--) {
+        SH2Item *item = &section->items[i];
+        if (item->kind == SH2_ITEM_INSN || item->kind == SH2_ITEM_BRANCH ||
+            item->kind == SH2_ITEM_PCLOAD) {
+            return (item->flags & SH2_DELAYED) != 0;
+        }
+        if (item->kind != SH2_ITEM_LABEL) return false;
+    }
+    return false;
+}
+
+static void sh2_encode_form(SH2Assembler *as, const SH2Form *form, const SH2Arg *args) {
+    uint16_t opcode = form->opcode;
+    uint16_t field = 0;
+
+    switch (form->encoding) {
+        case SH2_ENC_NONE:
+            break;
+        case SH2_ENC_N:
+            opcode |= sh2_field_n(args[0].reg);
+            break;
+        case SH2_ENC_MN:
+            opcode |= sh2_field_m(args[0].reg) | sh2_field_n(args[1].reg);
+            break;
+        case SH2_ENC_LDC:
+            opcode |= sh2_field_n(args[0].reg) | sh2_field_m(args[1].reg);
+            break;
+        case SH2_ENC_STC:
+            opcode |= sh2_field_m(args[0].reg) | sh2_field_n(args[1].reg);
+            break;
+        case SH2_ENC_IMM_S:
+            if (!sh2_immediate(as, args[0].value, -128, 127, &field)) return;
+            opcode |= field;
+            break;
+        case SH2_ENC_IMM_U:
+            if (!sh2_immediate(as, args[0].value, 0, 255, &field)) return;
+            opcode |= field;
+            break;
+        case SH2_ENC_IMM_N:
+            if (!sh2_immediate(as, args[0].value, -128, 127, &field)) return;
+            opcode |= field | sh2_field_n(args[1].reg);
+            break;
+        case SH2_ENC_DISP_LOAD:
+            if (!sh2_displacement(as, args[0].value, form->scale, 16, &field)) return;
+            opcode |= field | sh2_field_m(args[0].reg) | sh2_field_n(args[1].reg);
+            break;
+        case SH2_ENC_DISP_STORE:
+            if (!sh2_displacement(as, args[1].value, form->scale, 16, &field)) return;
+            opcode |= field | sh2_field_m(args[0].reg) | sh2_field_n(args[1].reg);
+            break;
+        case SH2_ENC_DISP_R0_LOAD:
+            if (!sh2_displacement(as, args[0].value, form->scale, 16, &field)) return;
+            opcode |= field | sh2_field_m(args[0].reg);
+            break;
+        case SH2_ENC_DISP_R0_STORE:
+            if (!sh2_displacement(as, args[1].value, form->scale, 16, &field)) return;
+            opcode |= field | sh2_field_m(args[1].reg);
+            break;
+        case SH2_ENC_GBR_LOAD:
+            if (!sh2_displacement(as, args[0].value, form->scale, 256, &field)) return;
+            opcode |= field;
+            break;
+        case SH2_ENC_GBR_STORE:
+            if (!sh2_displacement(as, args[1].value, form->scale, 256, &field)) return;
+            opcode |= field;
+            break;
+        case SH2_ENC_PC_DISP:
+            if (sh2_in_delay_slot(as)) {
+                sh2_error(as, "PC-relative load in a delay slot");
+                return;
+            }
+            if (!sh2_displacement(as, args[0].value, form->scale, 256, &field)) return;
+            opcode |= field | sh2_field_n(args[1].reg);
+            break;
+        case SH2_ENC_PC_LABEL: {
+            if (sh2_in_delay_slot(as)) {
+                sh2_error(as, "PC-relative load in a delay slot");
+                return;
+            }
+            SH2Item *item = sh2_item(as, SH2_ITEM_PCLOAD);
+            if (!item) return;
+            item->opcode = (uint16_t)(opcode | sh2_field_n(args[1].reg));
+            item->flags = form->flags;
+            item->width = form->scale;
+            item->symbol = args[0].symbol;
+            item->addend = args[0].value;
+            return;
+        }
+        case SH2_ENC_BRANCH: {
+            if (sh2_in_delay_slot(as)) {
+                sh2_error(as, "branch in a delay slot");
+                return;
+            }
+            SH2Item *item = sh2_item(as, SH2_ITEM_BRANCH);
+            if (!item) return;
+            item->opcode = opcode;
+            item->flags = form->flags;
+            item->symbol = args[0].symbol;
+            item->addend = args[0].value;
+            return;
+        }
+    }
+
+    if ((form->flags & SH2_DELAYED) && sh2_in_delay_slot(as)) {
+        sh2_error(as, "branch in a delay slot");
+        return;
+    }
+    SH2Item *item = sh2_item(as, SH2_ITEM_INSN);
+    if (!item) return;
+    item->opcode = opcode;
+    item->flags = form->flags;
+}
+
+static void sh2_instruction(SH2Assembler *as, const char *mnemonic, const SH2Arg *args,
+                            int count) {
+    bool known = false;
+    for (size_t i = 0; i < sizeof(sh2_forms) / sizeof(sh2_forms[0]); i++) {
+        const SH2Form *form = &sh2_forms[i];
+        if (strcmp(form->mnemonic, mnemonic) != 0) continue;
+        known = true;
+
+        int expected = (form->first != SH2_ARG_NONE) + (form->second != SH2_ARG_NONE);
+        if (expected != count) continue;
+        if (count > 0 && !sh2_arg_matches(form->first, &args[0])) continue;
+        if (count > 1 && !sh2_arg_matches(form->second, &args[1])) continue;
+
+        if (!(as->sections[as->current].flags & ELF_SHF_EXECINSTR)) {
+            sh2_error(as, "instruction outside a code section");
+            return;
+        }
+        sh2_encode_form(as, form, args);
+        return;
+    }
+
+    if (known) {
+        sh2_error(as, "invalid operands for '%s'", mnemonic);
+    } else {
+        sh2_error(as, "unknown instruction '%s'", mnemonic);
+    }
+}
+
+// ========================================
+// Directives
+// ========================================
+
+static void sh2_align(SH2Assembler *as, uint64_t alignment) {
+    if (alignment == 0 || (alignment & (alignment - 1)) || alignment > 4096) {
+        sh2_error(as, "alignment must be a power of two");
+        return;
+    }
+
+    SH2Section *section = &as->sections[as->current];
+    if (alignment > section->alignment) {
+        section->alignment = (uint32_t)alignment;
+    }
+    SH2Item *item = sh2_item(as, SH2_ITEM_ALIGN);
+    if (item) item->length = (size_t)alignment;
+}
+
+static void sh2_switch_section(SH2Assembler *as, const char *name, size_t length) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*s", (int)length, name);
+
+    // Drop any ELF flags/type arguments: .section name, "flags", @type
+    char *comma = strchr(buffer, ',');
+    if (comma) *comma = '\0';
+
+    uint32_t type = ELF_SHT_PROGBITS;
+    uint64_t flags = ELF_SHF_ALLOC;
+    if (strncmp(buffer, ".text", 5) == 0 || strcmp(buffer, ".vectors") == 0) {
+        flags |= ELF_SHF_EXECINSTR;
+    } else if (strncmp(buffer, ".bss", 4) == 0) {
+        type = ELF_SHT_NOBITS;
+        flags |= ELF_SHF_WRITE;
+    } else if (strncmp(buffer, ".data", 5) == 0) {
+        flags |= ELF_SHF_WRITE;
+    }
+    as->current = sh2_section(as, buffer, type, flags);
+}
+
+static size_t sh2_parse_string(SH2Assembler *as, const char **cursor, const char *end,
+                               char *out, size_t capacity) {
+    const char *p = sh2_skip_space(*cursor, end);
+    size_t length = 0;
+    if (p >= end || *p != '"') {
+        sh2_error(as, "expected a string");
+        return 0;
+    }
+    p++;
+
+    while (p < end && *p != '"') {
+        char c = *p++;
+        if (c == '\\' && p < end) {
+            c = *p++;
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case 'a': c = '\a'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'v': c = '\v'; break;
+                case 'x': {
+                    unsigned value = 0;
+                    while (p < end && isxdigit((unsigned char)*p)) {
+                        value = value * 16 + (unsigned)(isdigit((unsigned char)*p) ? *p - '0'
+                                                        : (tolower((unsigned char)*p) - 'a' + 10));
+                        p++;
+                    }
+                    c = (char)value;
+                    break;
+                }
+                default:
+                    if (c >= '0' && c <= '7') {
+                        unsigned value = (unsigned)(c - '0');
+                        for (int i = 0; i < 2 && p < end && *p >= '0' && *p <= '7'; i++) {
+                            value = value * 8 + (unsigned)(*p++ - '0');
+                        }
+                        c = (char)value;
+                    }
+                    break;
+            }
+        }
+        if (length < capacity) out[length] = c;
+        length++;
+    }
+
+    if (p >= end) {
+        sh2_error(as, "unterminated string");
+        return 0;
+    }
+    *cursor = p + 1;
+    return length;
+}
+
+static void sh2_data(SH2Assembler *as, int size, const char *p, const char *end) {
+    while (p < end) {
+        int64_t value;
+        int symbol;
+        if (!sh2_parse_expression(as, &p, end, &value, &symbol)) return;
+
+        if (symbol != SH2_NONE) {
+            if (size != 4) {
+                sh2_error(as, "symbol does not fit in %d bytes", size);
+                return;
+            }
+            if (as->sections[as->current].type == ELF_SHT_NOBITS) {
+                sh2_error(as, "data in a NOBITS section");
+                return;
+            }
+            SH2Item *item = sh2_item(as, SH2_ITEM_WORD);
+            if (!item) return;
+            item->symbol = symbol;
+            item->addend = value;
+        } else {
+            sh2_emit_value(as, (uint64_t)value, size);
+        }
+
+        p = sh2_skip_space(p, end);
+        if (p < end && *p == ',') p++;
+    }
+}
+
+static void sh2_directive(SH2Assembler *as, const char *name, size_t name_length,
+                          const char *p, const char *end) {
+#define SH2_IS(text) (name_length == sizeof(text) - 1 && memcmp(name, text, name_length) == 0)
+    p = sh2_skip_space(p, end);
+
+    if (SH2_IS(".text") || SH2_IS(".data") || SH2_IS(".bss") || SH2_IS(".rodata")) {
+        sh2_switch_section(as, name, name_length);
+    } else if (SH2_IS(".section")) {
+        const char *start = p;
+        while (p < end && *p != ' ' && *p != '\t') p++;
+        sh2_switch_section(as, start, (size_t)(p - start));
+    } else if (SH2_IS(".globl") || SH2_IS(".global")) {
+        while (p < end) {
+            const char *start = p;
+            while (p < end && sh2_is_symbol_char(*p)) p++;
+            if (p == start) {
+                sh2_error(as, "expected a symbol name");
+                return;
+            }
+            int symbol = sh2_symbol(as, start, (size_t)(p - start));
+            if (symbol != SH2_NONE) as->symbols[symbol].global = true;
+            p = sh2_skip_space(p, end);
+            if (p < end && *p == ',') p = sh2_skip_space(p + 1, end);
+        }
+    } else if (SH2_IS(".align") || SH2_IS(".p2align")) {
+        // SH assemblers take .align as a power of two
+        long value = strtol(p, NULL, 0);
+        if (value < 0 || value > 12) {
+            sh2_error(as, "alignment must be a power of two");
+            return;
+        }
+        sh2_align(as, (uint64_t)1 << value);
+    } else if (SH2_IS(".balign")) {
+        sh2_align(as, (uint64_t)strtol(p, NULL, 0));
+    } else if (SH2_IS(".byte")) {
+        sh2_data(as, 1, p, end);
+    } else if (SH2_IS(".short") || SH2_IS(".word") || SH2_IS(".hword") || SH2_IS(".2byte")) {
+        sh2_data(as, 2, p, end);
+    } else if (SH2_IS(".long") || SH2_IS(".int") || SH2_IS(".4byte")) {
+        sh2_data(as, 4, p, end);
+    } else if (SH2_IS(".ascii") || SH2_IS(".asciz") || SH2_IS(".string")) {
+        bool terminate = !SH2_IS(".ascii");
+        while (p < end) {
+            char stack_buffer[256];
+            const char *start = p;
+            size_t length = sh2_parse_string(as, &p, end, stack_buffer, sizeof(stack_buffer));
+            if (length > sizeof(stack_buffer)) {
+                char *buffer = malloc(length);
+                if (!buffer) {
+                    error_fatal("Memory allocation failed for assembler string");
+                    return;
+                }
+                p = start;
+                sh2_parse_string(as, &p, end, buffer, length);
+                sh2_emit_bytes(as, buffer, length);
+                free(buffer);
+            } else if (p != start) {
+                sh2_emit_bytes(as, stack_buffer, length);
+            } else {
+                return;
+            }
+            if (terminate) sh2_emit_value(as, 0, 1);
+            p = sh2_skip_space(p, end);
+            if (p < end && *p == ',') p++;
+        }
+    } else if (SH2_IS(".zero") || SH2_IS(".space") || SH2_IS(".skip")) {
+        char *cursor;
+        long count = strtol(p, &cursor, 0);
+        cursor = (char *)sh2_skip_space(cursor, end);
+        long fill = (cursor < end && *cursor == ',') ? strtol(cursor + 1, NULL, 0) : 0;
+        if (count < 0) {
+            sh2_error(as, "negative size");
+            return;
+        }
+        SH2Item *item = sh2_item(as, SH2_ITEM_SPACE);
+        if (!item) return;
+        item->length = (size_t)count;
+        item->addend = fill & 0xFF;
+    } else if (SH2_IS(".pool") || SH2_IS(".ltorg")) {
+        sh2_item(as, SH2_ITEM_LTORG);
+    } else if (SH2_IS(".type") || SH2_IS(".size") || SH2_IS(".file") || SH2_IS(".ident") ||
+               SH2_IS(".local") || SH2_IS(".hidden") || SH2_IS(".little") || SH2_IS(".big") ||
+               (name_length > 5 && memcmp(name, ".cfi_", 5) == 0)) {
+        // Only meaningful to other object formats or debuggers
+    } else {
+        sh2_error(as, "unsupported directive '%.*s'", (int)name_length, name);
+    }
+#undef SH2_IS
+}
+
+// ========================================
+// Lines
+// ========================================
+
+// Splits operands on top-level commas
+static int sh2_split_args(SH2Assembler *as, const char *p, const char *end, SH2Arg *args,
+                          int capacity) {
+    int count = 0;
+    p = sh2_skip_space(p, end);
+    while (p < end) {
+        const char *start = p;
+        int depth = 0;
+        while (p < end && (depth > 0 || *p != ',')) {
+            if (*p == '(') depth++;
+            if (*p == ')') depth--;
+            p++;
+        }
+        if (count == capacity) {
+            sh2_error(as, "too many operands");
+            return -1;
+        }
+        if (!sh2_parse_arg(as, start, p, &args[count++])) {
+            return -1;
+        }
+        if (p < end) p++;
+    }
+    return count;
+}
+
+static void sh2_statement(SH2Assembler *as, const char *p, const char *end) {
+    p = sh2_skip_space(p, end);
+    end = sh2_trim(p, end);
+
+    // Any number of labels
+    while (p < end) {
+        const char *start = p;
+        while (p < end && sh2_is_symbol_char(*p)) p++;
+        if (p > start && p < end && *p == ':') {
+            int symbol = sh2_symbol(as, start, (size_t)(p - start));
+            if (symbol != SH2_NONE) {
+                if (as->symbols[symbol].section != SH2_NONE) {
+                    sh2_error(as, "symbol '%.*s' is already defined", (int)(p - start), start);
+                } else {
+                    sh2_define_label(as, as->current, symbol, as->line);
+                }
+            }
+            p = sh2_skip_space(p + 1, end);
+        } else {
+            p = start;
+            break;
+        }
+    }
+    if (p >= end) return;
+
+    const char *name = p;
+    while (p < end && !isspace((unsigned char)*p)) p++;
+    size_t name_length = (size_t)(p - name);
+
+    if (name[0] == '.') {
+        sh2_directive(as, name, name_length, p, end);
+        return;
+    }
+
+    char mnemonic[16];
+    if (name_length >= sizeof(mnemonic)) {
+        sh2_error(as, "unknown instruction '%.*s'", (int)name_length, name);
+        return;
+    }
+    for (size_t i = 0; i < name_length; i++) {
+        mnemonic[i] = (char)tolower((unsigned char)name[i]);
+    }
+    mnemonic[name_length] = '\0';
+
+    SH2Arg args[2];
+    int count = sh2_split_args(as, p, end, args, 2);
+    if (count >= 0) {
+        sh2_instruction(as, mnemonic, args, count);
+    }
+}
+
+// Strips '!' comments, '#' comment lines and /* */, and splits on ';'
+static void sh2_line(SH2Assembler *as, const char *line, const char *end) {
+    const char *p = sh2_skip_space(line, end);
+    if (p < end && *p == '#') return;
+
+    const char *statement = p;
+    bool in_string = false;
+    while (p < end) {
+        char c = *p;
+        if (in_string) {
+            if (c == '\\' && p + 1 < end) p++;
+            else if (c == '"') in_string = false;
+        } else if (c == '"') {
+            in_string = true;
+        } else if (c == '!') {
+            break;
+        } else if (c == '/' && p + 1 < end && p[1] == '*') {
+            sh2_statement(as, statement, p);
+            const char *close = p + 2;
+            while (close + 1 < end && !(close[0] == '*' && close[1] == '/')) close++;
+            p = close + 1 < end ? close + 2 : end;
+            statement = p;
+            continue;
+        } else if (c == ';') {
+            sh2_statement(as, statement, p);
+            statement = p + 1;
+        }
+        p++;
+    }
+    sh2_statement(as, statement, p);
+}
+
+SH2Assembler *sh2_asm_create(void) {
+    SH2Assembler *as = calloc(1, sizeof(SH2Assembler));
+    if (!as) {
+        error_fatal("Memory allocation failed for assembler");
+        return NULL;
+    }
+    as->current = sh2_section(as, ".text", ELF_SHT_PROGBITS, ELF_SHF_ALLOC | ELF_SHF_EXECINSTR);
+    return as;
+}
+
+void sh2_asm_destroy(SH2Assembler *as) {
+    if (!as) return;
+
+    for (int i = 0; i < as->section_count; i++) {
+        free(as->sections[i].items);
+        free(as->sections[i].bytes);
+        free(as->sections[i].literals);
+        free(as->sections[i].data);
+    }
+    free(as->symbols);
+    free(as->symbol_slots);
+    free(as->relocs);
+    free(as);
+}
+
+void sh2_asm_source(SH2Assembler *as, const char *text, size_t length) {
+    if (as->finished) {
+        sh2_error(as, "source added after the output was written");
+        return;
+    }
+
+    const char *end = text + length;
+    while (text < end) {
+        const char *newline = memchr(text, '\n', (size_t)(end - text));
+        const char *line_end = newline ? newline : end;
+        as->line++;
+        sh2_line(as, text, line_end);
+        text = newline ? newline + 1 : end;
+    }
+}
+
+int sh2_asm_error_count(const SH2Assembler *as) {
+    return as->error_count;
+}
+
+// ========================================
+// Literal pools
+// ========================================
+
+static bool sh2_is_relaxable(const SH2Item *item) {
+    return item->kind == SH2_ITEM_BRANCH &&
+           (item->opcode == SH2_OP_BT || item->opcode == SH2_OP_BF);
+}
+
+static bool sh2_is_instruction(const SH2Item *item) {
+    return item->kind == SH2_ITEM_INSN || item->kind == SH2_ITEM_BRANCH ||
+           item->kind == SH2_ITEM_PCLOAD;
+}
+
+static uint32_t sh2_pool_max_size(const SH2Section *section, size_t first, size_t count) {
+    uint32_t size = 4;               // Alignment, and the gap after a mov.w
+    for (size_t i = first; i < first + count; i++) {
+        size += section->literals[i].width;
+    }
+    return size;
+}
+
+// Upper bound on an item's size, whatever layout decides
+static uint32_t sh2_max_size(const SH2Section *section, const SH2Item *item) {
+    switch (item->kind) {
+        case SH2_ITEM_INSN:
+        case SH2_ITEM_PCLOAD: return 2;
+        case SH2_ITEM_BRANCH: return sh2_is_relaxable(item) ? 6 : 2;
+        case SH2_ITEM_DATA:
+        case SH2_ITEM_SPACE:  return (uint32_t)item->length;
+        case SH2_ITEM_WORD:   return 4;
+        case SH2_ITEM_ALIGN:  return (uint32_t)item->length - 1;
+        case SH2_ITEM_POOL:   return sh2_pool_max_size(section, item->offset, item->length);
+        default:              return 0;
+    }
+}
+
+// Parses n out of <prefix><n>
+static bool sh2_numbered_label(const char *name, const char *prefix, uint32_t *value) {
+    size_t length = strlen(prefix);
+    if (strncmp(name, prefix, length) != 0 || name[length] == '\0') return false;
+    char *end;
+    long long number = strtoll(name + length, &end, 10);
+    if (*end != '\0') return false;
+    *value = (uint32_t)number;
+    return true;
+}
+
+// What a PC-relative load from a label the section does not define reads:
+// the emitters name their constants .L_const_<n>/.L_frame_<n> and call
+// targets .L_<function> without writing the pool themselves
+static bool sh2_literal_for(SH2Assembler *as, const SH2Item *item, SH2Literal *literal) {
+    const char *name = as->symbols[item->symbol].name;
+    literal->width = item->width;
+    literal->symbol = SH2_NONE;
+    literal->value = 0;
+
+    if (sh2_numbered_label(name, ".L_const_", &literal->value) ||
+        sh2_numbered_label(name, ".L_frame_", &literal->value)) {
+        int32_t value = (int32_t)literal->value;
+        if (item->width == 2 && (value < -32768 || value > 0xFFFF)) {
+            sh2_error(as, "'%s' does not fit in a mov.w literal", name);
+            return false;
+        }
+        return true;
+    }
+
+    if (strncmp(name, ".L_", 3) == 0 && name[3] != '\0' && item->width == 4) {
+        char target[256];
+        int length = snprintf(target, sizeof(target), "_%s", name + 3);
+        if (length < 0 || (size_t)length >= sizeof(target)) {
+            sh2_error(as, "symbol name too long");
+            return false;
+        }
+        literal->symbol = sh2_symbol(as, target, (size_t)length);
+        return literal->symbol != SH2_NONE;
+    }
+
+    sh2_error(as, "PC-relative load from '%s', which is not in this section", name);
+    return false;
+}
+
+static int sh2_add_literal(SH2Section *section, int open, const SH2Literal *literal) {
+    for (int i = open; i < section->literal_count; i++) {
+        SH2Literal *existing = &section->literals[i];
+        if (existing->width == literal->width && existing->value == literal->value &&
+            existing->symbol == literal->symbol) {
+            return i;
+        }
+    }
+
+    if (section->literal_count == section->literal_capacity) {
+        SH2Literal *literals = sh2_grow(section->literals, &section->literal_capacity,
+                                        sizeof(SH2Literal), "literals");
+        if (!literals) return SH2_NONE;
+        section->literals = literals;
+    }
+    section->literals[section->literal_count] = *literal;
+    return section->literal_count++;
+}
+
+// Closes the open pool; with skip, execution branches around it
+static void sh2_dump_pool(SH2Assembler *as, int index, int open, bool skip, int line) {
+    SH2Section *section = &as->sections[index];
+    int label = SH2_NONE;
+    if (skip) {
+        label = sh2_generated_label(as);
+        SH2Item *branch = sh2_append(section, SH2_ITEM_BRANCH, line);
+        if (!branch) return;
+        branch->opcode = SH2_OP_BRA;
+        branch->flags = SH2_DELAYED | SH2_BARRIER;
+        branch->symbol = label;
+        SH2Item *slot = sh2_append(section, SH2_ITEM_INSN, line);
+        if (!slot) return;
+        slot->opcode = SH2_OP_NOP;
+    }
+
+    SH2Item *pool = sh2_append(section, SH2_ITEM_POOL, line);
+    if (!pool) return;
+    pool->offset = (size_t)open;
+    pool->length = (size_t)(section->literal_count - open);
+
+    if (skip) {
+        sh2_define_label(as, index, label, line);
+    }
+}
+
+// Rebuilds a section's item list with its literal pools placed
+static void sh2_place_literals(SH2Assembler *as, int index) {
+    SH2Section *section = &as->sections[index];
+    SH2Item *items = section->items;
+    int count = section->item_count;
+    section->items = NULL;
+    section->item_count = 0;
+    section->item_capacity = 0;
+
+    int open = section->literal_count;     // First literal of the open pool
+    uint32_t position = 0;                 // Upper bound of the next address
+    uint32_t deadline = UINT32_MAX;        // Where the open pool must end by
+    int slot = 0;                          // 1: next instruction is a delay
+                                           // slot, 2: of an unconditional one
+    bool at_break = false;                 // Just past an unconditional slot
+
+    for (int i = 0; i < count; i++) {
+        SH2Item item = items[i];
+        as->line = item.line;
+
+        if (section->literal_count > open) {
+            uint32_t pool = sh2_pool_max_size(section, (size_t)open,
+                                              (size_t)(section->literal_count - open));
+            if (at_break || item.kind == SH2_ITEM_LTORG) {
+                sh2_dump_pool(as, index, open, false, item.line);
+                position += pool;
+                open = section->literal_count;
+                deadline = UINT32_MAX;
+            } else if (slot == 0) {
+                // Leave room for this item, its delay slot, the item's own
+                // literal and the branch around the pool
+                uint32_t next = position + sh2_max_size(section, &item) +
+                                ((item.flags & SH2_DELAYED) ? 2 : 0) + 4 + 4;
+                if (next + pool > deadline) {
+                    sh2_dump_pool(as, index, open, true, item.line);
+                    position += 4 + pool;
+                    open = section->literal_count;
+                    deadline = UINT32_MAX;
+                }
+            }
+        }
+        if (item.kind == SH2_ITEM_LTORG) continue;
+
+        if (item.kind == SH2_ITEM_PCLOAD && !(item.flags & SH2_ADDRESS) &&
+            as->symbols[item.symbol].section != index) {
+            SH2Literal literal;
+            if (sh2_literal_for(as, &item, &literal)) {
+                literal.value += (uint32_t)item.addend;
+                item.literal = sh2_add_literal(section, open, &literal);
+                uint32_t reach = position + (item.width == 4 ? SH2_REACH_LONG : SH2_REACH_WORD);
+                if (reach < deadline) deadline = reach;
+            }
+        }
+
+        SH2Item *placed = sh2_append(section, item.kind, item.line);
+        if (!placed) break;
+        *placed = item;
+        position += sh2_max_size(section, &item);
+
+        if (sh2_is_instruction(&item)) {
+            at_break = slot == 2;
+            slot = (item.flags & SH2_DELAYED) ? ((item.flags & SH2_BARRIER) ? 2 : 1) : 0;
+        }
+    }
+
+    if (section->literal_count > open) {
+        sh2_dump_pool(as, index, open, false, as->line);
+    }
+    free(items);
+}
+
+// ========================================
+// Layout and encoding
+// ========================================
+
+static bool sh2_branch_in_range(const SH2Item *item, int64_t disp) {
+    if (disp & 1) return false;
+    if (item->opcode == SH2_OP_BRA || item->opcode == SH2_OP_BSR) {
+        return disp >= -4096 && disp <= 4094;
+    }
+    return disp >= -256 && disp <= 254;
+}
+
+// Assigns addresses, relaxing conditional branches until nothing changes
+static void sh2_layout(SH2Assembler *as, int index) {
+    SH2Section *section = &as->sections[index];
+    bool changed = true;
+
+    while (changed) {
+        uint32_t address = 0;
+        const SH2Item *previous = NULL;
+        for (int i = 0; i < section->item_count; i++) {
+            SH2Item *item = &section->items[i];
+            item->address = address;
+            switch (item->kind) {
+                case SH2_ITEM_INSN:
+                case SH2_ITEM_PCLOAD:
+                    item->size = 2;
+                    break;
+                case SH2_ITEM_BRANCH:
+                    item->size = (item->flags & SH2_RELAXED) ? 6 : 2;
+                    break;
+                case SH2_ITEM_DATA:
+                case SH2_ITEM_SPACE:
+                    item->size = (uint32_t)item->length;
+                    break;
+                case SH2_ITEM_WORD:
+                    item->size = 4;
+                    break;
+                case SH2_ITEM_ALIGN:
+                    item->size = (uint32_t)(-address & (item->length - 1));
+                    break;
+                case SH2_ITEM_LABEL:
+                    item->size = 0;
+                    as->symbols[item->symbol].address = address;
+                    break;
+                case SH2_ITEM_POOL: {
+                    // mov.w reads from at least PC + 4
+                    uint32_t cursor = address;
+                    if (previous && previous->kind == SH2_ITEM_PCLOAD && previous->width == 2) {
+                        cursor += 2;
+                    }
+                    for (int width = 4; width >= 2; width -= 2) {
+                        for (size_t l = item->offset; l < item->offset + item->length; l++) {
+                            SH2Literal *literal = &section->literals[l];
+                            if (literal->width != width) continue;
+                            cursor = (cursor + (uint32_t)width - 1) & ~(uint32_t)(width - 1);
+                            literal->address = cursor;
+                            cursor += (uint32_t)width;
+                        }
+                    }
+                    item->size = cursor - address;
+                    if (section->alignment < 4) section->alignment = 4;
+                    break;
+                }
+                default:
+                    item->size = 0;
+                    break;
+            }
+            address += item->size;
+            if (item->kind != SH2_ITEM_LABEL) previous = item;
+        }
+        section->size = address;
+
+        changed = false;
+        for (int i = 0; i < section->item_count; i++) {
+            SH2Item *item = &section->items[i];
+            if (!sh2_is_relaxable(item) || (item->flags & SH2_RELAXED)) continue;
+            SH2Symbol *target = &as->symbols[item->symbol];
+            if (target->section != index) continue;
+            int64_t disp = (int64_t)target->address + item->addend - ((int64_t)item->address + 4);
+            if (!sh2_branch_in_range(item, disp)) {
+                item->flags |= SH2_RELAXED;
+                changed = true;
+            }
+        }
+    }
+}
+
+static void sh2_add_reloc(SH2Assembler *as, int section, uint32_t offset, int symbol,
+                          int64_t addend) {
+    if (as->reloc_count == as->reloc_capacity) {
+        SH2Reloc *relocs = sh2_grow(as->relocs, &as->reloc_capacity, sizeof(SH2Reloc),
+                                    "relocations");
+        if (!relocs) return;
+        as->relocs = relocs;
+    }
+    SH2Reloc *reloc = &as->relocs[as->reloc_count++];
+    reloc->section = section;
+    reloc->offset = offset;
+    reloc->symbol = symbol;
+    reloc->addend = addend;
+}
+
+static uint16_t sh2_branch_opcode(SH2Assembler *as, uint16_t opcode, int64_t disp) {
+    SH2Item probe = {.opcode = opcode};
+    if (!sh2_branch_in_range(&probe, disp)) {
+        sh2_error(as, "branch target is out of range");
+        return opcode;
+    }
+    if (opcode == SH2_OP_BRA) return sh2_encode_bra((int)disp);
+    if (opcode == SH2_OP_BSR) return sh2_encode_bsr((int)disp);
+    return (uint16_t)(opcode | ((disp >> 1) & 0xFF));
+}
+
+static void sh2_encode_pcload(SH2Assembler *as, const SH2Section *section, int index,
+                              const SH2Item *item, unsigned char *out) {
+    uint32_t target;
+    if (item->literal != SH2_NONE) {
+        target = section->literals[item->literal].address;
+    } else {
+        SH2Symbol *symbol = &as->symbols[item->symbol];
+        if (symbol->section != index) {
+            sh2_error(as, "'%s' is not in this section", symbol->name);
+            return;
+        }
+        target = symbol->address + (uint32_t)item->addend;
+    }
+
+    uint32_t base = item->width == 4 ? (item->address & ~3u) + 4 : item->address + 4;
+    int64_t disp = (int64_t)target - (int64_t)base;
+    if (disp < 0 || disp % item->width || disp / item->width > 255) {
+        sh2_error(as, "PC-relative load target is out of range");
+        return;
+    }
+    sh2_put16(out, (uint16_t)(item->opcode | (uint16_t)(disp / item->width)));
+}
+
+static void sh2_encode_section(SH2Assembler *as, int index) {
+    SH2Section *section = &as->sections[index];
+    if (section->type == ELF_SHT_NOBITS) {
+        for (int i = 0; i < section->item_count; i++) {
+            SH2ItemKind kind = section->items[i].kind;
+            if (kind != SH2_ITEM_SPACE && kind != SH2_ITEM_ALIGN && kind != SH2_ITEM_LABEL) {
+                as->line = section->items[i].line;
+                sh2_error(as, "only space can be reserved in '%s'", section->name);
+            }
+        }
+        return;
+    }
+
+    section->data = calloc(section->size ? section->size : 1, 1);
+    if (!section->data) {
+        error_fatal("Memory allocation failed for assembler section");
+        return;
+    }
+
+    bool code = (section->flags & ELF_SHF_EXECINSTR) != 0;
+    for (int i = 0; i < section->item_count; i++) {
+        SH2Item *item = &section->items[i];
+        unsigned char *out = section->data + item->address;
+        as->line = item->line;
+
+        switch (item->kind) {
+            case SH2_ITEM_INSN:
+                sh2_put16(out, item->opcode);
+                break;
+            case SH2_ITEM_PCLOAD:
+                sh2_encode_pcload(as, section, index, item, out);
+                break;
+            case SH2_ITEM_BRANCH: {
+                SH2Symbol *target = &as->symbols[item->symbol];
+                if (target->section != index) {
+                    sh2_error(as, "branch to '%s', which is not in this section", target->name);
+                    break;
+                }
+                int64_t destination = (int64_t)target->address + item->addend;
+                if (item->flags & SH2_RELAXED) {
+                    // b<!cond> over; bra target; nop; over:
+                    sh2_put16(out, (uint16_t)((item->opcode ^ (SH2_OP_BT ^ SH2_OP_BF)) | 1));
+                    sh2_put16(out + 2, sh2_branch_opcode(as, SH2_OP_BRA,
+                                                         destination - (item->address + 6)));
+                    sh2_put16(out + 4, SH2_OP_NOP);
+                } else {
+                    sh2_put16(out, sh2_branch_opcode(as, item->opcode,
+                                                     destination - (item->address + 4)));
+                }
+                break;
+            }
+            case SH2_ITEM_DATA:
+                memcpy(out, section->bytes + item->offset, item->length);
+                break;
+            case SH2_ITEM_WORD:
+                sh2_add_reloc(as, index, item->address, item->symbol, item->addend);
+                break;
+            case SH2_ITEM_SPACE:
+                memset(out, (int)item->addend, item->length);
+                break;
+            case SH2_ITEM_ALIGN:
+                for (uint32_t b = 0; b < item->size; b++) {
+                    bool even = ((item->address + b) & 1) == 0;
+                    if (code && even && b + 1 < item->size) {
+                        sh2_put16(out + b, SH2_OP_NOP);
+                        b++;
+                    }
+                }
+                break;
+            case SH2_ITEM_POOL:
+                for (size_t l = item->offset; l < item->offset + item->length; l++) {
+                    SH2Literal *literal = &section->literals[l];
+                    unsigned char *slot = section->data + literal->address;
+                    if (literal->symbol != SH2_NONE) {
+                        sh2_add_reloc(as, index, literal->address, literal->symbol,
+                                      (int32_t)literal->value);
+                    } else if (literal->width == 4) {
+                        sh2_put32(slot, literal->value);
+                    } else {
+                        sh2_put16(slot, (uint16_t)literal->value);
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Places pools, lays out and encodes every section, once
+static bool sh2_finish(SH2Assembler *as) {
+    if (!as->finished) {
+        as->finished = true;
+        if (as->error_count == 0) {
+            for (int i = 0; i < as->section_count; i++) {
+                sh2_place_literals(as, i);
+                sh2_layout(as, i);
+            }
+            for (int i = 0; i < as->section_count; i++) {
+                sh2_encode_section(as, i);
+            }
+        }
+    }
+    return as->error_count == 0;
+}
+
+// ========================================
+// Output
+// ========================================
+
+static int sh2_elf_symbol(SH2Assembler *as, ElfWriter *writer, int index) {
+    SH2Symbol *symbol = &as->symbols[index];
+    if (symbol->elf_symbol != SH2_NONE) {
+        return symbol->elf_symbol;
+    }
+
+    int section = 0;
+    uint8_t type = ELF_STT_NOTYPE;
+    if (symbol->section != SH2_NONE) {
+        SH2Section *owner = &as->sections[symbol->section];
+        section = owner->elf_index;
+        if (symbol->global) {
+            type = (owner->flags & ELF_SHF_EXECINSTR) ? ELF_STT_FUNC : ELF_STT_OBJECT;
+        }
+    }
+    symbol->elf_symbol = elf_writer_add_symbol(writer, symbol->name, section,
+                                               symbol->address, 0, type, symbol->global);
+    return symbol->elf_symbol;
+}
+
+bool sh2_asm_write_object(SH2Assembler *as, const char *path) {
+    if (!sh2_finish(as)) {
+        return false;
+    }
+
+    ElfWriter *writer = elf_writer_create(false, true, ELF_EM_SH);
+    if (!writer) return false;
+
+    for (int i = 0; i < as->section_count; i++) {
+        SH2Section *section = &as->sections[i];
+        section->elf_index = elf_writer_add_section(writer, section->name, section->type,
+                                                    section->flags, section->alignment,
+                                                    section->data, section->size);
+    }
+
+    // Defined symbols, except assembler-local .L labels
+    for (int i = 0; i < as->symbol_count; i++) {
+        SH2Symbol *symbol = &as->symbols[i];
+        if (symbol->section != SH2_NONE && strncmp(symbol->name, ".L", 2) != 0) {
+            sh2_elf_symbol(as, writer, i);
+        }
+    }
+
+    // Local symbols are referenced through their section
+    for (int i = 0; i < as->reloc_count; i++) {
+        SH2Reloc *reloc = &as->relocs[i];
+        SH2Symbol *symbol = &as->symbols[reloc->symbol];
+        int target;
+        int64_t addend = reloc->addend;
+        if (symbol->section != SH2_NONE && !symbol->global) {
+            target = elf_writer_section_symbol(writer, as->sections[symbol->section].elf_index);
+            addend += symbol->address;
+        } else {
+            target = sh2_elf_symbol(as, writer, reloc->symbol);
+        }
+        elf_writer_add_relocation(writer, as->sections[reloc->section].elf_index,
+                                  reloc->offset, target, R_SH_DIR32, addend);
+    }
+
+    bool ok = elf_writer_write(writer, path);
+    elf_writer_destroy(writer);
+    return ok;
+}
+
+// Code first, then read-only data, then data, then .bss
+static int sh2_binary_rank(const SH2Section *section) {
+    if (section->type == ELF_SHT_NOBITS) return 3;
+    if (section->flags & ELF_SHF_EXECINSTR) return 0;
+    return (section->flags & ELF_SHF_WRITE) ? 2 : 1;
+}
+
+bool sh2_asm_write_binary(SH2Assembler *as, const char *path, uint32_t base_address) {
+    if (!sh2_finish(as)) {
+        return false;
+    }
+
+    uint32_t address = base_address;
+    for (int rank = 0; rank < 4; rank++) {
+        for (int i = 0; i < as->section_count; i++) {
+            SH2Section *section = &as->sections[i];
+            if (sh2_binary_rank(section) != rank) continue;
+            address = (address + section->alignment - 1) & ~(section->alignment - 1);
+            section->base = address;
+            address += section->size;
+        }
+    }
+
+    for (int i = 0; i < as->reloc_count; i++) {
+        SH2Reloc *reloc = &as->relocs[i];
+        SH2Symbol *symbol = &as->symbols[reloc->symbol];
+        if (symbol->section == SH2_NONE) {
+            fprintf(stderr, "Error: undefined symbol '%s' in a flat binary\n", symbol->name);
+            as->error_count++;
+            continue;
+        }
+        uint32_t value = as->sections[symbol->section].base + symbol->address +
+                         (uint32_t)reloc->addend;
+        sh2_put32(as->sections[reloc->section].data + reloc->offset, value);
+    }
+    if (as->error_count > 0) {
+        return false;
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: cannot write '%s'\n", path);
+        return false;
+    }
+
+    bool ok = true;
+    uint32_t written = base_address;
+    for (int rank = 0; rank < 3 && ok; rank++) {
+        for (int i = 0; i < as->section_count && ok; i++) {
+            SH2Section *section = &as->sections[i];
+            if (sh2_binary_rank(section) != rank) continue;
+            while (written < section->base && ok) {
+                ok = fputc(0, file) != EOF;
+                written++;
+            }
+            if (section->size > 0 && ok) {
+                ok = fwrite(section->data, 1, section->size, file) == section->size;
+            }
+            written += section->size;
+        }
+    }
+
+    if (fclose(file) != 0) ok = false;
+    if (!ok) {
+        fprintf(stderr, "Error: failed writing '%s'\n", path);
+    }
+    return ok;
+}
@@ -4,580 +4,581 @@
 #include "sh2_instruction_set.h"
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 // ============================================================================
 // Data Transfer Instructions
 // ============================================================================
 
-void sh2_mov_reg_reg(FILE *out, int dst, int src) {
-    fprintf(out, "\tmov\tr%d,r%d\n", src, dst);
+void sh2_mov_reg_reg(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tmov\tr%d,r%d\n", src, dst);
 }
 
-void sh2_mov_imm(FILE *out, int reg, int8_t imm) {
-    fprintf(out, "\tmov\t#%d,r%d\n", imm, reg);
+void sh2_mov_imm(AsmBuffer *out, int reg, int8_t imm) {
+    asm_buffer_format(out, "\tmov\t#%d,r%d\n", imm, reg);
 }
 
-void sh2_mov_w_imm(FILE *out, int reg, int16_t imm) {
-    fprintf(out, "\tmov.w\t.L_const_%d,r%d\n", imm, reg);
+void sh2_mov_w_imm(AsmBuffer *out, int reg, int16_t imm) {
+    asm_buffer_format(out, "\tmov.w\t.L_const_%d,r%d\n", imm, reg);
 }
 
-void sh2_mov_l_imm(FILE *out, int reg, int32_t imm) {
-    fprintf(out, "\tmov.l\t.L_const_%d,r%d\n", imm, reg);
+void sh2_mov_l_imm(AsmBuffer *out, int reg, int32_t imm) {
+    asm_buffer_format(out, "\tmov.l\t.L_const_%d,r%d\n", imm, reg);
 }
 
-void sh2_mov_l_disp_reg(FILE *out, int dst, int disp, int src) {
-    fprintf(out, "\tmov.l\t@(%d,r%d),r%d\n", disp, src, dst);
+void sh2_mov_l_disp_reg(AsmBuffer *out, int dst, int disp, int src) {
+    asm_buffer_format(out, "\tmov.l\t@(%d,r%d),r%d\n", disp, src, dst);
 }
 
-void sh2_mov_l_reg_disp(FILE *out, int src, int disp, int dst) {
-    fprintf(out, "\tmov.l\tr%d,@(%d,r%d)\n", src, disp, dst);
+void sh2_mov_l_reg_disp(AsmBuffer *out, int src, int disp, int dst) {
+    asm_buffer_format(out, "\tmov.l\tr%d,@(%d,r%d)\n", src, disp, dst);
 }
 
-void sh2_mov_w_disp_reg(FILE *out, int dst, int disp, int src) {
-    fprintf(out, "\tmov.w\t@(%d,r%d),r%d\n", disp, src, dst);
+void sh2_mov_w_disp_reg(AsmBuffer *out, int dst, int disp, int src) {
+    asm_buffer_format(out, "\tmov.w\t@(%d,r%d),r%d\n", disp, src, dst);
 }
 
-void sh2_mov_w_reg_disp(FILE *out, int src, int disp, int dst) {
-    fprintf(out, "\tmov.w\tr%d,@(%d,r%d)\n", src, disp, dst);
+void sh2_mov_w_reg_disp(AsmBuffer *out, int src, int disp, int dst) {
+    asm_buffer_format(out, "\tmov.w\tr%d,@(%d,r%d)\n", src, disp, dst);
 }
 
-void sh2_mov_b_disp_reg(FILE *out, int dst, int disp, int src) {
-    fprintf(out, "\tmov.b\t@(%d,r%d),r%d\n", disp, src, dst);
+void sh2_mov_b_disp_reg(AsmBuffer *out, int dst, int disp, int src) {
+    asm_buffer_format(out, "\tmov.b\t@(%d,r%d),r%d\n", disp, src, dst);
 }
 
-void sh2_mov_b_reg_disp(FILE *out, int src, int disp, int dst) {
-    fprintf(out, "\tmov.b\tr%d,@(%d,r%d)\n", src, disp, dst);
+void sh2_mov_b_reg_disp(AsmBuffer *out, int src, int disp, int dst) {
+    asm_buffer_format(out, "\tmov.b\tr%d,@(%d,r%d)\n", src, disp, dst);
 }
 
-void sh2_mov_l_indir(FILE *out, int dst, int src) {
-    fprintf(out, "\tmov.l\t@r%d,r%d\n", src, dst);
+void sh2_mov_l_indir(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tmov.l\t@r%d,r%d\n", src, dst);
 }
 
-void sh2_mov_l_indir_store(FILE *out, int src, int dst) {
-    fprintf(out, "\tmov.l\tr%d,@r%d\n", src, dst);
+void sh2_mov_l_indir_store(AsmBuffer *out, int src, int dst) {
+    asm_buffer_format(out, "\tmov.l\tr%d,@r%d\n", src, dst);
 }
 
-void sh2_mov_w_indir(FILE *out, int dst, int src) {
-    fprintf(out, "\tmov.w\t@r%d,r%d\n", src, dst);
+void sh2_mov_w_indir(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tmov.w\t@r%d,r%d\n", src, dst);
 }
 
-void sh2_mov_w_indir_store(FILE *out, int src, int dst) {
-    fprintf(out, "\tmov.w\tr%d,@r%d\n", src, dst);
+void sh2_mov_w_indir_store(AsmBuffer *out, int src, int dst) {
+    asm_buffer_format(out, "\tmov.w\tr%d,@r%d\n", src, dst);
 }
 
-void sh2_mov_b_indir(FILE *out, int dst, int src) {
-    fprintf(out, "\tmov.b\t@r%d,r%d\n", src, dst);
+void sh2_mov_b_indir(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tmov.b\t@r%d,r%d\n", src, dst);
 }
 
-void sh2_mov_b_indir_store(FILE *out, int src, int dst) {
-    fprintf(out, "\tmov.b\tr%d,@r%d\n", src, dst);
+void sh2_mov_b_indir_store(AsmBuffer *out, int src, int dst) {
+    asm_buffer_format(out, "\tmov.b\tr%d,@r%d\n", src, dst);
 }
 
-void sh2_mov_l_post_inc(FILE *out, int dst, int src) {
-    fprintf(out, "\tmov.l\t@r%d+,r%d\n", src, dst);
+void sh2_mov_l_post_inc(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tmov.l\t@r%d+,r%d\n", src, dst);
 }
 
-void sh2_mov_w_post_inc(FILE *out, int dst, int src) {
-    fprintf(out, "\tmov.w\t@r%d+,r%d\n", src, dst);
+void sh2_mov_w_post_inc(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tmov.w\t@r%d+,r%d\n", src, dst);
 }
 
-void sh2_mov_b_post_inc(FILE *out, int dst, int src) {
-    fprintf(out, "\tmov.b\t@r%d+,r%d\n", src, dst);
+void sh2_mov_b_post_inc(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tmov.b\t@r%d+,r%d\n", src, dst);
 }
 
-void sh2_mov_l_pre_dec(FILE *out, int src, int dst) {
-    fprintf(out, "\tmov.l\tr%d,@-r%d\n", src, dst);
+void sh2_mov_l_pre_dec(AsmBuffer *out, int src, int dst) {
+    asm_buffer_format(out, "\tmov.l\tr%d,@-r%d\n", src, dst);
 }
 
-void sh2_mov_w_pre_dec(FILE *out, int src, int dst) {
-    fprintf(out, "\tmov.w\tr%d,@-r%d\n", src, dst);
+void sh2_mov_w_pre_dec(AsmBuffer *out, int src, int dst) {
+    asm_buffer_format(out, "\tmov.w\tr%d,@-r%d\n", src, dst);
 }
 
-void sh2_mov_b_pre_dec(FILE *out, int src, int dst) {
-    fprintf(out, "\tmov.b\tr%d,@-r%d\n", src, dst);
+void sh2_mov_b_pre_dec(AsmBuffer *out, int src, int dst) {
+    asm_buffer_format(out, "\tmov.b\tr%d,@-r%d\n", src, dst);
 }
 
-void sh2_mov_l_r0_indexed(FILE *out, int dst, int src) {
-    fprintf(out, "\tmov.l\t@(r0,r%d),r%d\n", src, dst);
+void sh2_mov_l_r0_indexed(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tmov.l\t@(r0,r%d),r%d\n", src, dst);
 }
 
-void sh2_mov_l_r0_indexed_store(FILE *out, int src, int dst) {
-    fprintf(out, "\tmov.l\tr%d,@(r0,r%d)\n", src, dst);
+void sh2_mov_l_r0_indexed_store(AsmBuffer *out, int src, int dst) {
+    asm_buffer_format(out, "\tmov.l\tr%d,@(r0,r%d)\n", src, dst);
 }
 
-void sh2_mov_w_r0_indexed(FILE *out, int dst, int src) {
-    fprintf(out, "\tmov.w\t@(r0,r%d),r%d\n", src, dst);
+void sh2_mov_w_r0_indexed(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tmov.w\t@(r0,r%d),r%d\n", src, dst);
 }
 
-void sh2_mov_w_r0_indexed_store(FILE *out, int src, int dst) {
-    fprintf(out, "\tmov.w\tr%d,@(r0,r%d)\n", src, dst);
+void sh2_mov_w_r0_indexed_store(AsmBuffer *out, int src, int dst) {
+    asm_buffer_format(out, "\tmov.w\tr%d,@(r0,r%d)\n", src, dst);
 }
 
-void sh2_mov_b_r0_indexed(FILE *out, int dst, int src) {
-    fprintf(out, "\tmov.b\t@(r0,r%d),r%d\n", src, dst);
+void sh2_mov_b_r0_indexed(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tmov.b\t@(r0,r%d),r%d\n", src, dst);
 }
 
-void sh2_mov_b_r0_indexed_store(FILE *out, int src, int dst) {
-    fprintf(out, "\tmov.b\tr%d,@(r0,r%d)\n", src, dst);
+void sh2_mov_b_r0_indexed_store(AsmBuffer *out, int src, int dst) {
+    asm_buffer_format(out, "\tmov.b\tr%d,@(r0,r%d)\n", src, dst);
 }
 
-void sh2_mov_l_gbr_disp(FILE *out, int reg, int disp) {
-    fprintf(out, "\tmov.l\t@(%d,gbr),r%d\n", disp, reg);
+void sh2_mov_l_gbr_disp(AsmBuffer *out, int reg, int disp) {
+    asm_buffer_format(out, "\tmov.l\t@(%d,gbr),r%d\n", disp, reg);
 }
 
-void sh2_mov_l_gbr_store(FILE *out, int reg, int disp) {
-    fprintf(out, "\tmov.l\tr%d,@(%d,gbr)\n", reg, disp);
+void sh2_mov_l_gbr_store(AsmBuffer *out, int reg, int disp) {
+    asm_buffer_format(out, "\tmov.l\tr%d,@(%d,gbr)\n", reg, disp);
 }
 
-void sh2_mov_w_gbr_disp(FILE *out, int reg, int disp) {
-    fprintf(out, "\tmov.w\t@(%d,gbr),r%d\n", disp, reg);
+void sh2_mov_w_gbr_disp(AsmBuffer *out, int reg, int disp) {
+    asm_buffer_format(out, "\tmov.w\t@(%d,gbr),r%d\n", disp, reg);
 }
 
-void sh2_mov_w_gbr_store(FILE *out, int reg, int disp) {
-    fprintf(out, "\tmov.w\tr%d,@(%d,gbr)\n", reg, disp);
+void sh2_mov_w_gbr_store(AsmBuffer *out, int reg, int disp) {
+    asm_buffer_format(out, "\tmov.w\tr%d,@(%d,gbr)\n", reg, disp);
 }
 
-void sh2_mov_b_gbr_disp(FILE *out, int reg, int disp) {
-    fprintf(out, "\tmov.b\t@(%d,gbr),r%d\n", disp, reg);
+void sh2_mov_b_gbr_disp(AsmBuffer *out, int reg, int disp) {
+    asm_buffer_format(out, "\tmov.b\t@(%d,gbr),r%d\n", disp, reg);
 }
 
-void sh2_mov_b_gbr_store(FILE *out, int reg, int disp) {
-    fprintf(out, "\tmov.b\tr%d,@(%d,gbr)\n", reg, disp);
+void sh2_mov_b_gbr_store(AsmBuffer *out, int reg, int disp) {
+    asm_buffer_format(out, "\tmov.b\tr%d,@(%d,gbr)\n", reg, disp);
 }
 
-void sh2_mova(FILE *out, int disp) {
-    fprintf(out, "\tmova\t@(%d,pc),r0\n", disp);
+void sh2_mova(AsmBuffer *out, int disp) {
+    asm_buffer_format(out, "\tmova\t@(%d,pc),r0\n", disp);
 }
 
-void sh2_movt(FILE *out, int reg) {
-    fprintf(out, "\tmovt\tr%d\n", reg);
+void sh2_movt(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tmovt\tr%d\n", reg);
 }
 
-void sh2_swap_b(FILE *out, int dst, int src) {
-    fprintf(out, "\tswap.b\tr%d,r%d\n", src, dst);
+void sh2_swap_b(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tswap.b\tr%d,r%d\n", src, dst);
 }
 
-void sh2_swap_w(FILE *out, int dst, int src) {
-    fprintf(out, "\tswap.w\tr%d,r%d\n", src, dst);
+void sh2_swap_w(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tswap.w\tr%d,r%d\n", src, dst);
 }
 
-void sh2_xtrct(FILE *out, int dst, int src) {
-    fprintf(out, "\txtrct\tr%d,r%d\n", src, dst);
+void sh2_xtrct(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\txtrct\tr%d,r%d\n", src, dst);
 }
 
 // ============================================================================
 // Arithmetic Instructions
 // ============================================================================
 
-void sh2_add(FILE *out, int dst, int src) {
-    fprintf(out, "\tadd\tr%d,r%d\n", src, dst);
+void sh2_add(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tadd\tr%d,r%d\n", src, dst);
 }
 
-void sh2_add_imm(FILE *out, int reg, int8_t imm) {
-    fprintf(out, "\tadd\t#%d,r%d\n", imm, reg);
+void sh2_add_imm(AsmBuffer *out, int reg, int8_t imm) {
+    asm_buffer_format(out, "\tadd\t#%d,r%d\n", imm, reg);
 }
 
-void sh2_addc(FILE *out, int dst, int src) {
-    fprintf(out, "\taddc\tr%d,r%d\n", src, dst);
+void sh2_addc(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\taddc\tr%d,r%d\n", src, dst);
 }
 
-void sh2_addv(FILE *out, int dst, int src) {
-    fprintf(out, "\taddv\tr%d,r%d\n", src, dst);
+void sh2_addv(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\taddv\tr%d,r%d\n", src, dst);
 }
 
-void sh2_sub(FILE *out, int dst, int src) {
-    fprintf(out, "\tsub\tr%d,r%d\n", src, dst);
+void sh2_sub(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tsub\tr%d,r%d\n", src, dst);
 }
 
-void sh2_subc(FILE *out, int dst, int src) {
-    fprintf(out, "\tsubc\tr%d,r%d\n", src, dst);
+void sh2_subc(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tsubc\tr%d,r%d\n", src, dst);
 }
 
-void sh2_subv(FILE *out, int dst, int src) {
-    fprintf(out, "\tsubv\tr%d,r%d\n", src, dst);
+void sh2_subv(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tsubv\tr%d,r%d\n", src, dst);
 }
 
-void sh2_neg(FILE *out, int dst, int src) {
-    fprintf(out, "\tneg\tr%d,r%d\n", src, dst);
+void sh2_neg(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tneg\tr%d,r%d\n", src, dst);
 }
 
-void sh2_negc(FILE *out, int dst, int src) {
-    fprintf(out, "\tnegc\tr%d,r%d\n", src, dst);
+void sh2_negc(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tnegc\tr%d,r%d\n", src, dst);
 }
 
-void sh2_mac_l(FILE *out, int src1, int src2) {
-    fprintf(out, "\tmac.l\t@r%d+,@r%d+\n", src1, src2);
+void sh2_mac_l(AsmBuffer *out, int src1, int src2) {
+    asm_buffer_format(out, "\tmac.l\t@r%d+,@r%d+\n", src1, src2);
 }
 
-void sh2_mac_w(FILE *out, int src1, int src2) {
-    fprintf(out, "\tmac.w\t@r%d+,@r%d+\n", src1, src2);
+void sh2_mac_w(AsmBuffer *out, int src1, int src2) {
+    asm_buffer_format(out, "\tmac.w\t@r%d+,@r%d+\n", src1, src2);
 }
 
-void sh2_mul_l(FILE *out, int src1, int src2) {
-    fprintf(out, "\tmul.l\tr%d,r%d\n", src1, src2);
+void sh2_mul_l(AsmBuffer *out, int src1, int src2) {
+    asm_buffer_format(out, "\tmul.l\tr%d,r%d\n", src1, src2);
 }
 
-void sh2_mulu_w(FILE *out, int src1, int src2) {
-    fprintf(out, "\tmulu.w\tr%d,r%d\n", src1, src2);
+void sh2_mulu_w(AsmBuffer *out, int src1, int src2) {
+    asm_buffer_format(out, "\tmulu.w\tr%d,r%d\n", src1, src2);
 }
 
-void sh2_muls_w(FILE *out, int src1, int src2) {
-    fprintf(out, "\tmuls.w\tr%d,r%d\n", src1, src2);
+void sh2_muls_w(AsmBuffer *out, int src1, int src2) {
+    asm_buffer_format(out, "\tmuls.w\tr%d,r%d\n", src1, src2);
 }
 
-void sh2_div0s(FILE *out, int src1, int src2) {
-    fprintf(out, "\tdiv0s\tr%d,r%d\n", src1, src2);
+void sh2_div0s(AsmBuffer *out, int src1, int src2) {
+    asm_buffer_format(out, "\tdiv0s\tr%d,r%d\n", src1, src2);
 }
 
-void sh2_div0u(FILE *out) {
-    fprintf(out, "\tdiv0u\n");
+void sh2_div0u(AsmBuffer *out) {
+    asm_buffer_format(out, "\tdiv0u\n");
 }
 
-void sh2_div1(FILE *out, int src1, int src2) {
-    fprintf(out, "\tdiv1\tr%d,r%d\n", src1, src2);
+void sh2_div1(AsmBuffer *out, int src1, int src2) {
+    asm_buffer_format(out, "\tdiv1\tr%d,r%d\n", src1, src2);
 }
 
-void sh2_dmulu_l(FILE *out, int src1, int src2) {
-    fprintf(out, "\tdmulu.l\tr%d,r%d\n", src1, src2);
+void sh2_dmulu_l(AsmBuffer *out, int src1, int src2) {
+    asm_buffer_format(out, "\tdmulu.l\tr%d,r%d\n", src1, src2);
 }
 
-void sh2_dmuls_l(FILE *out, int src1, int src2) {
-    fprintf(out, "\tdmuls.l\tr%d,r%d\n", src1, src2);
+void sh2_dmuls_l(AsmBuffer *out, int src1, int src2) {
+    asm_buffer_format(out, "\tdmuls.l\tr%d,r%d\n", src1, src2);
 }
 
-void sh2_dt(FILE *out, int reg) {
-    fprintf(out, "\tdt\tr%d\n", reg);
+void sh2_dt(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tdt\tr%d\n", reg);
 }
 
 // ============================================================================
 // Logic Instructions
 // ============================================================================
 
-void sh2_and(FILE *out, int dst, int src) {
-    fprintf(out, "\tand\tr%d,r%d\n", src, dst);
+void sh2_and(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tand\tr%d,r%d\n", src, dst);
 }
 
-void sh2_and_imm(FILE *out, uint8_t imm) {
-    fprintf(out, "\tand\t#%u,r0\n", imm);
+void sh2_and_imm(AsmBuffer *out, uint8_t imm) {
+    asm_buffer_format(out, "\tand\t#%u,r0\n", imm);
 }
 
-void sh2_and_b_imm(FILE *out, uint8_t imm) {
-    fprintf(out, "\tand.b\t#%u,@(r0,gbr)\n", imm);
+void sh2_and_b_imm(AsmBuffer *out, uint8_t imm) {
+    asm_buffer_format(out, "\tand.b\t#%u,@(r0,gbr)\n", imm);
 }
 
-void sh2_or(FILE *out, int dst, int src) {
-    fprintf(out, "\tor\tr%d,r%d\n", src, dst);
+void sh2_or(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tor\tr%d,r%d\n", src, dst);
 }
 
-void sh2_or_imm(FILE *out, uint8_t imm) {
-    fprintf(out, "\tor\t#%u,r0\n", imm);
+void sh2_or_imm(AsmBuffer *out, uint8_t imm) {
+    asm_buffer_format(out, "\tor\t#%u,r0\n", imm);
 }
 
-void sh2_or_b_imm(FILE *out, uint8_t imm) {
-    fprintf(out, "\tor.b\t#%u,@(r0,gbr)\n", imm);
+void sh2_or_b_imm(AsmBuffer *out, uint8_t imm) {
+    asm_buffer_format(out, "\tor.b\t#%u,@(r0,gbr)\n", imm);
 }
 
-void sh2_xor(FILE *out, int dst, int src) {
-    fprintf(out, "\txor\tr%d,r%d\n", src, dst);
+void sh2_xor(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\txor\tr%d,r%d\n", src, dst);
 }
 
-void sh2_xor_imm(FILE *out, uint8_t imm) {
-    fprintf(out, "\txor\t#%u,r0\n", imm);
+void sh2_xor_imm(AsmBuffer *out, uint8_t imm) {
+    asm_buffer_format(out, "\txor\t#%u,r0\n", imm);
 }
 
-void sh2_xor_b_imm(FILE *out, uint8_t imm) {
-    fprintf(out, "\txor.b\t#%u,@(r0,gbr)\n", imm);
+void sh2_xor_b_imm(AsmBuffer *out, uint8_t imm) {
+    asm_buffer_format(out, "\txor.b\t#%u,@(r0,gbr)\n", imm);
 }
 
-void sh2_not(FILE *out, int dst, int src) {
-    fprintf(out, "\tnot\tr%d,r%d\n", src, dst);
+void sh2_not(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\tnot\tr%d,r%d\n", src, dst);
 }
 
-void sh2_tst(FILE *out, int src1, int src2) {
-    fprintf(out, "\ttst\tr%d,r%d\n", src1, src2);
+void sh2_tst(AsmBuffer *out, int src1, int src2) {
+    asm_buffer_format(out, "\ttst\tr%d,r%d\n", src1, src2);
 }
 
-void sh2_tst_imm(FILE *out, uint8_t imm) {
-    fprintf(out, "\ttst\t#%u,r0\n", imm);
+void sh2_tst_imm(AsmBuffer *out, uint8_t imm) {
+    asm_buffer_format(out, "\ttst\t#%u,r0\n", imm);
 }
 
-void sh2_tst_b_imm(FILE *out, uint8_t imm) {
-    fprintf(out, "\ttst.b\t#%u,@(r0,gbr)\n", imm);
+void sh2_tst_b_imm(AsmBuffer *out, uint8_t imm) {
+    asm_buffer_format(out, "\ttst.b\t#%u,@(r0,gbr)\n", imm);
 }
 
 // ============================================================================
 // Shift Instructions
 // ============================================================================
 
-void sh2_shal(FILE *out, int reg) {
-    fprintf(out, "\tshal\tr%d\n", reg);
+void sh2_shal(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tshal\tr%d\n", reg);
 }
 
-void sh2_shar(FILE *out, int reg) {
-    fprintf(out, "\tshar\tr%d\n", reg);
+void sh2_shar(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tshar\tr%d\n", reg);
 }
 
-void sh2_shll(FILE *out, int reg) {
-    fprintf(out, "\tshll\tr%d\n", reg);
+void sh2_shll(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tshll\tr%d\n", reg);
 }
 
-void sh2_shlr(FILE *out, int reg) {
-    fprintf(out, "\tshlr\tr%d\n", reg);
+void sh2_shlr(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tshlr\tr%d\n", reg);
 }
 
-void sh2_shll2(FILE *out, int reg) {
-    fprintf(out, "\tshll2\tr%d\n", reg);
+void sh2_shll2(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tshll2\tr%d\n", reg);
 }
 
-void sh2_shlr2(FILE *out, int reg) {
-    fprintf(out, "\tshlr2\tr%d\n", reg);
+void sh2_shlr2(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tshlr2\tr%d\n", reg);
 }
 
-void sh2_shll8(FILE *out, int reg) {
-    fprintf(out, "\tshll8\tr%d\n", reg);
+void sh2_shll8(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tshll8\tr%d\n", reg);
 }
 
-void sh2_shlr8(FILE *out, int reg) {
-    fprintf(out, "\tshlr8\tr%d\n", reg);
+void sh2_shlr8(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tshlr8\tr%d\n", reg);
 }
 
-void sh2_shll16(FILE *out, int reg) {
-    fprintf(out, "\tshll16\tr%d\n", reg);
+void sh2_shll16(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tshll16\tr%d\n", reg);
 }
 
-void sh2_shlr16(FILE *out, int reg) {
-    fprintf(out, "\tshlr16\tr%d\n", reg);
+void sh2_shlr16(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tshlr16\tr%d\n", reg);
 }
 
-void sh2_rotl(FILE *out, int reg) {
-    fprintf(out, "\trotl\tr%d\n", reg);
+void sh2_rotl(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\trotl\tr%d\n", reg);
 }
 
-void sh2_rotr(FILE *out, int reg) {
-    fprintf(out, "\trotr\tr%d\n", reg);
+void sh2_rotr(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\trotr\tr%d\n", reg);
 }
 
-void sh2_rotcl(FILE *out, int reg) {
-    fprintf(out, "\trotcl\tr%d\n", reg);
+void sh2_rotcl(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\trotcl\tr%d\n", reg);
 }
 
-void sh2_rotcr(FILE *out, int reg) {
-    fprintf(out, "\trotcr\tr%d\n", reg);
+void sh2_rotcr(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\trotcr\tr%d\n", reg);
 }
 
 // ============================================================================
 // Branch Instructions
 // ============================================================================
 
-void sh2_bra(FILE *out, const char *label) {
-    fprintf(out, "\tbra\t%s\n", label);
+void sh2_bra(AsmBuffer *out, const char *label) {
+    asm_buffer_format(out, "\tbra\t%s\n", label);
 }
 
-void sh2_braf(FILE *out, int reg) {
-    fprintf(out, "\tbraf\tr%d\n", reg);
+void sh2_braf(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tbraf\tr%d\n", reg);
 }
 
-void sh2_bsr(FILE *out, const char *label) {
-    fprintf(out, "\tbsr\t%s\n", label);
+void sh2_bsr(AsmBuffer *out, const char *label) {
+    asm_buffer_format(out, "\tbsr\t%s\n", label);
 }
 
-void sh2_bsrf(FILE *out, int reg) {
-    fprintf(out, "\tbsrf\tr%d\n", reg);
+void sh2_bsrf(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tbsrf\tr%d\n", reg);
 }
 
-void sh2_bt(FILE *out, const char *label) {
-    fprintf(out, "\tbt\t%s\n", label);
+void sh2_bt(AsmBuffer *out, const char *label) {
+    asm_buffer_format(out, "\tbt\t%s\n", label);
 }
 
-void sh2_bf(FILE *out, const char *label) {
-    fprintf(out, "\tbf\t%s\n", label);
+void sh2_bf(AsmBuffer *out, const char *label) {
+    asm_buffer_format(out, "\tbf\t%s\n", label);
 }
 
-void sh2_bt_s(FILE *out, const char *label) {
-    fprintf(out, "\tbt/s\t%s\n", label);
+void sh2_bt_s(AsmBuffer *out, const char *label) {
+    asm_buffer_format(out, "\tbt/s\t%s\n", label);
 }
 
-void sh2_bf_s(FILE *out, const char *label) {
-    fprintf(out, "\tbf/s\t%s\n", label);
+void sh2_bf_s(AsmBuffer *out, const char *label) {
+    asm_buffer_format(out, "\tbf/s\t%s\n", label);
 }
 
-void sh2_jmp(FILE *out, int reg) {
-    fprintf(out, "\tjmp\t@r%d\n", reg);
+void sh2_jmp(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tjmp\t@r%d\n", reg);
 }
 
-void sh2_jsr(FILE *out, int reg) {
-    fprintf(out, "\tjsr\t@r%d\n", reg);
+void sh2_jsr(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tjsr\t@r%d\n", reg);
 }
 
-void sh2_rts(FILE *out) {
-    fprintf(out, "\trts\n");
+void sh2_rts(AsmBuffer *out) {
+    asm_buffer_format(out, "\trts\n");
 }
 
-void sh2_rte(FILE *out) {
-    fprintf(out, "\trte\n");
+void sh2_rte(AsmBuffer *out) {
+    asm_buffer_format(out, "\trte\n");
 }
 
 // ============================================================================
 // Compare Instructions
 // ============================================================================
 
-void sh2_cmp_eq(FILE *out, int src1, int src2) {
-    fprintf(out, "\tcmp/eq\tr%d,r%d\n", src1, src2);
+void sh2_cmp_eq(AsmBuffer *out, int src1, int src2) {
+    asm_buffer_format(out, "\tcmp/eq\tr%d,r%d\n", src1, src2);
 }
 
-void sh2_cmp_hs(FILE *out, int src1, int src2) {
-    fprintf(out, "\tcmp/hs\tr%d,r%d\n", src1, src2);
+void sh2_cmp_hs(AsmBuffer *out, int src1, int src2) {
+    asm_buffer_format(out, "\tcmp/hs\tr%d,r%d\n", src1, src2);
 }
 
-void sh2_cmp_ge(FILE *out, int src1, int src2) {
-    fprintf(out, "\tcmp/ge\tr%d,r%d\n", src1, src2);
+void sh2_cmp_ge(AsmBuffer *out, int src1, int src2) {
+    asm_buffer_format(out, "\tcmp/ge\tr%d,r%d\n", src1, src2);
 }
 
-void sh2_cmp_hi(FILE *out, int src1, int src2) {
-    fprintf(out, "\tcmp/hi\tr%d,r%d\n", src1, src2);
+void sh2_cmp_hi(AsmBuffer *out, int src1, int src2) {
+    asm_buffer_format(out, "\tcmp/hi\tr%d,r%d\n", src1, src2);
 }
 
-void sh2_cmp_gt(FILE *out, int src1, int src2) {
-    fprintf(out, "\tcmp/gt\tr%d,r%d\n", src1, src2);
+void sh2_cmp_gt(AsmBuffer *out, int src1, int src2) {
+    asm_buffer_format(out, "\tcmp/gt\tr%d,r%d\n", src1, src2);
 }
 
-void sh2_cmp_pz(FILE *out, int reg) {
-    fprintf(out, "\tcmp/pz\tr%d\n", reg);
+void sh2_cmp_pz(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tcmp/pz\tr%d\n", reg);
 }
 
-void sh2_cmp_pl(FILE *out, int reg) {
-    fprintf(out, "\tcmp/pl\tr%d\n", reg);
+void sh2_cmp_pl(AsmBuffer *out, int reg) {
+    asm_buffer_format(out, "\tcmp/pl\tr%d\n", reg);
 }
 
-void sh2_cmp_str(FILE *out, int src1, int src2) {
-    fprintf(out, "\tcmp/str\tr%d,r%d\n", src1, src2);
+void sh2_cmp_str(AsmBuffer *out, int src1, int src2) {
+    asm_buffer_format(out, "\tcmp/str\tr%d,r%d\n", src1, src2);
 }
 
-void sh2_cmp_eq_imm(FILE *out, int8_t imm) {
-    fprintf(out, "\tcmp/eq\t#%d,r0\n", imm);
+void sh2_cmp_eq_imm(AsmBuffer *out, int8_t imm) {
+    asm_buffer_format(out, "\tcmp/eq\t#%d,r0\n", imm);
 }
 
 // ============================================================================
 // System Control Instructions
 // ============================================================================
 
-void sh2_ldc(FILE *out, int src, const char *ctrl) {
-    fprintf(out, "\tldc\tr%d,%s\n", src, ctrl);
+void sh2_ldc(AsmBuffer *out, int src, const char *ctrl) {
+    asm_buffer_format(out, "\tldc\tr%d,%s\n", src, ctrl);
 }
 
-void sh2_ldc_l(FILE *out, int src, const char *ctrl) {
-    fprintf(out, "\tldc.l\t@r%d+,%s\n", src, ctrl);
+void sh2_ldc_l(AsmBuffer *out, int src, const char *ctrl) {
+    asm_buffer_format(out, "\tldc.l\t@r%d+,%s\n", src, ctrl);
 }
 
-void sh2_stc(FILE *out, const char *ctrl, int dst) {
-    fprintf(out, "\tstc\t%s,r%d\n", ctrl, dst);
+void sh2_stc(AsmBuffer *out, const char *ctrl, int dst) {
+    asm_buffer_format(out, "\tstc\t%s,r%d\n", ctrl, dst);
 }
 
-void sh2_stc_l(FILE *out, const char *ctrl, int dst) {
-    fprintf(out, "\tstc.l\t%s,@-r%d\n", ctrl, dst);
+void sh2_stc_l(AsmBuffer *out, const char *ctrl, int dst) {
+    asm_buffer_format(out, "\tstc.l\t%s,@-r%d\n", ctrl, dst);
 }
 
-void sh2_lds(FILE *out, int src, const char *ctrl) {
-    fprintf(out, "\tlds\tr%d,%s\n", src, ctrl);
+void sh2_lds(AsmBuffer *out, int src, const char *ctrl) {
+    asm_buffer_format(out, "\tlds\tr%d,%s\n", src, ctrl);
 }
 
-void sh2_lds_l(FILE *out, int src, const char *ctrl) {
-    fprintf(out, "\tlds.l\t@r%d+,%s\n", src, ctrl);
+void sh2_lds_l(AsmBuffer *out, int src, const char *ctrl) {
+    asm_buffer_format(out, "\tlds.l\t@r%d+,%s\n", src, ctrl);
 }
 
-void sh2_sts(FILE *out, const char *ctrl, int dst) {
-    fprintf(out, "\tsts\t%s,r%d\n", ctrl, dst);
+void sh2_sts(AsmBuffer *out, const char *ctrl, int dst) {
+    asm_buffer_format(out, "\tsts\t%s,r%d\n", ctrl, dst);
 }
 
-void sh2_sts_l(FILE *out, const char *ctrl, int dst) {
-    fprintf(out, "\tsts.l\t%s,@-r%d\n", ctrl, dst);
+void sh2_sts_l(AsmBuffer *out, const char *ctrl, int dst) {
+    asm_buffer_format(out, "\tsts.l\t%s,@-r%d\n", ctrl, dst);
 }
 
-void sh2_clrmac(FILE *out) {
-    fprintf(out, "\tclrmac\n");
+void sh2_clrmac(AsmBuffer *out) {
+    asm_buffer_format(out, "\tclrmac\n");
 }
 
-void sh2_clrt(FILE *out) {
-    fprintf(out, "\tclrt\n");
+void sh2_clrt(AsmBuffer *out) {
+    asm_buffer_format(out, "\tclrt\n");
 }
 
-void sh2_sett(FILE *out) {
-    fprintf(out, "\tsett\n");
+void sh2_sett(AsmBuffer *out) {
+    asm_buffer_format(out, "\tsett\n");
 }
 
-void sh2_ldtlb(FILE *out) {
-    fprintf(out, "\tldtlb\n");
+void sh2_ldtlb(AsmBuffer *out) {
+    asm_buffer_format(out, "\tldtlb\n");
 }
 
-void sh2_nop(FILE *out) {
-    fprintf(out, "\tnop\n");
+void sh2_nop(AsmBuffer *out) {
+    asm_buffer_format(out, "\tnop\n");
 }
 
-void sh2_rte_nop(FILE *out) {
-    fprintf(out, "\trte\n");
-    fprintf(out, "\tnop\n");
+void sh2_rte_nop(AsmBuffer *out) {
+    asm_buffer_format(out, "\trte\n");
+    asm_buffer_format(out, "\tnop\n");
 }
 
-void sh2_sleep(FILE *out) {
-    fprintf(out, "\tsleep\n");
+void sh2_sleep(AsmBuffer *out) {
+    asm_buffer_format(out, "\tsleep\n");
 }
 
 // ============================================================================
 // Sign/Zero Extension
 // ============================================================================
 
-void sh2_exts_b(FILE *out, int dst, int src) {
-    fprintf(out, "\texts.b\tr%d,r%d\n", src, dst);
+void sh2_exts_b(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\texts.b\tr%d,r%d\n", src, dst);
 }
 
-void sh2_exts_w(FILE *out, int dst, int src) {
-    fprintf(out, "\texts.w\tr%d,r%d\n", src, dst);
+void sh2_exts_w(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\texts.w\tr%d,r%d\n", src, dst);
 }
 
-void sh2_extu_b(FILE *out, int dst, int src) {
-    fprintf(out, "\textu.b\tr%d,r%d\n", src, dst);
+void sh2_extu_b(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\textu.b\tr%d,r%d\n", src, dst);
 }
 
-void sh2_extu_w(FILE *out, int dst, int src) {
-    fprintf(out, "\textu.w\tr%d,r%d\n", src, dst);
+void sh2_extu_w(AsmBuffer *out, int dst, int src) {
+    asm_buffer_format(out, "\textu.w\tr%d,r%d\n", src, dst);
 }
 
 // ============================================================================
 // Pseudo Instructions
 // ============================================================================
 
-void sh2_push(FILE *out, int reg) {
+void sh2_push(AsmBuffer *out, int reg) {
     sh2_mov_l_pre_dec(out, reg, 15);
 }
 
-void sh2_pop(FILE *out, int reg) {
+void sh2_pop(AsmBuffer *out, int reg) {
     sh2_mov_l_post_inc(out, reg, 15);
 }
 
-void sh2_call(FILE *out, const char *label) {
-    fprintf(out, "\tmov.l\t.L_%s,r0\n", label);
-    fprintf(out, "\tjsr\t@r0\n");
-    fprintf(out, "\tnop\n");
+void sh2_call(AsmBuffer *out, const char *label) {
+    asm_buffer_format(out, "\tmov.l\t.L_%s,r0\n", label);
+    asm_buffer_format(out, "\tjsr\t@r0\n");
+    asm_buffer_format(out, "\tnop\n");
 }
 
-void sh2_ret(FILE *out) {
-    fprintf(out, "\trts\n");
-    fprintf(out, "\tnop\n");
+void sh2_ret(AsmBuffer *out) {
+    asm_buffer_format(out, "\trts\n");
+    asm_buffer_format(out, "\tnop\n");
 }
 
-void sh2_label(FILE *out, const char *label) {
-    fprintf(out, "%s:\n", label);
+void sh2_label(AsmBuffer *out, const char *label) {
+    asm_buffer_format(out, "%s:\n", label);
 }
 
-void sh2_comment(FILE *out, const char *comment) {
-    fprintf(out, "\t! %s\n", comment);
+void sh2_comment(AsmBuffer *out, const char *comment) {
+    asm_buffer_format(out, "\t! %s\n", comment);
 }
 
-void sh2_load_imm32(FILE *out, int reg, uint32_t value) {
-    if (value <= 127 && value >= 0) {
+void sh2_load_imm32(AsmBuffer *out, int reg, uint32_t value) {
+    if (value <= 127) {
         sh2_mov_imm(out, reg, (int8_t)value);
     } else {
-        fprintf(out, "\tmov.l\t.L_const_%u,r%d\n", value, reg);
+        asm_buffer_format(out, "\tmov.l\t.L_const_%u,r%d\n", value, reg);
     }
 }
 
@@ -631,15 +632,15 @@ const char* sh2_literal_pool_add(LiteralPool *pool, uint32_t value) {
     return label;
 }
 
-void sh2_literal_pool_emit(LiteralPool *pool, FILE *out) {
+void sh2_literal_pool_emit(LiteralPool *pool, AsmBuffer *out) {
     if (pool->count == 0) return;
 
-    fprintf(out, "\n\t.align 4\n");
+    asm_buffer_format(out, "\n\t.align 4\n");
     for (int i = 0; i < pool->count; i++) {
-        fprintf(out, "%s:\n", pool->entries[i].label);
-        fprintf(out, "\t.long\t0x%08X\n", pool->entries[i].value);
+        asm_buffer_format(out, "%s:\n", pool->entries[i].label);
+        asm_buffer_format(out, "\t.long\t0x%08X\n", pool->entries[i].value);
     }
-    fprintf(out, "\n");
+    asm_buffer_format(out, "\n");
 }
 
 void sh2_literal_pool_clear(LiteralPool *pool) {
@@ -653,14 +654,571 @@ void sh2_literal_pool_clear(LiteralPool *pool) {
 // Instruction Encoding (for binary output)
 // ============================================================================
 
+// Operand fields; out-of-range values are truncated to the field width
+static uint16_t sh2_fmt_nm(uint16_t opcode, int n, int m) {
+    return (uint16_t)(opcode | ((n & 0xF) << 8) | ((m & 0xF) << 4));
+}
+
+static uint16_t sh2_fmt_n(uint16_t opcode, int n) {
+    return (uint16_t)(opcode | ((n & 0xF) << 8));
+}
+
+static uint16_t sh2_fmt_i(uint16_t opcode, int imm) {
+    return (uint16_t)(opcode | (imm & 0xFF));
+}
+
+static uint16_t sh2_fmt_ni(uint16_t opcode, int n, int imm) {
+    return (uint16_t)(opcode | ((n & 0xF) << 8) | (imm & 0xFF));
+}
+
+static uint16_t sh2_fmt_d12(uint16_t opcode, int disp) {
+    return (uint16_t)(opcode | ((disp >> 1) & 0xFFF));
+}
+
+// Data Transfer
+
 uint16_t sh2_encode_mov_reg_reg(int dst, int src) {
-    return 0x6003 | (dst << 8) | (src << 4);
+    return sh2_fmt_nm(SH2_OP_MOV_RR, dst, src);
+}
+
+uint16_t sh2_encode_mov_imm(int reg, int8_t imm) {
+    return sh2_fmt_ni(SH2_OP_MOV_IMM, reg, imm);
+}
+
+uint16_t sh2_encode_mov_w_pc(int reg, int disp) {
+    return sh2_fmt_ni(SH2_OP_MOV_W_PC, reg, disp >> 1);
+}
+
+uint16_t sh2_encode_mov_l_pc(int reg, int disp) {
+    return sh2_fmt_ni(SH2_OP_MOV_L_PC, reg, disp >> 2);
+}
+
+uint16_t sh2_encode_mov_l_disp_reg(int dst, int disp, int src) {
+    return (uint16_t)(sh2_fmt_nm(SH2_OP_MOV_L_DISP_LOAD, dst, src) | ((disp >> 2) & 0xF));
+}
+
+uint16_t sh2_encode_mov_l_reg_disp(int src, int disp, int dst) {
+    return (uint16_t)(sh2_fmt_nm(SH2_OP_MOV_L_DISP_STORE, dst, src) | ((disp >> 2) & 0xF));
+}
+
+uint16_t sh2_encode_mov_w_disp_reg(int dst, int disp, int src) {
+    if (dst != 0) return SH2_ENCODE_INVALID;
+    return (uint16_t)(sh2_fmt_nm(SH2_OP_MOV_W_DISP_R0_LOAD, 0, src) | ((disp >> 1) & 0xF));
+}
+
+uint16_t sh2_encode_mov_w_reg_disp(int src, int disp, int dst) {
+    if (src != 0) return SH2_ENCODE_INVALID;
+    return (uint16_t)(sh2_fmt_nm(SH2_OP_MOV_W_R0_DISP_STORE, 0, dst) | ((disp >> 1) & 0xF));
+}
+
+uint16_t sh2_encode_mov_b_disp_reg(int dst, int disp, int src) {
+    if (dst != 0) return SH2_ENCODE_INVALID;
+    return (uint16_t)(sh2_fmt_nm(SH2_OP_MOV_B_DISP_R0_LOAD, 0, src) | (disp & 0xF));
+}
+
+uint16_t sh2_encode_mov_b_reg_disp(int src, int disp, int dst) {
+    if (src != 0) return SH2_ENCODE_INVALID;
+    return (uint16_t)(sh2_fmt_nm(SH2_OP_MOV_B_R0_DISP_STORE, 0, dst) | (disp & 0xF));
+}
+
+uint16_t sh2_encode_mov_l_indir(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_MOV_L_LOAD, dst, src);
+}
+
+uint16_t sh2_encode_mov_l_indir_store(int src, int dst) {
+    return sh2_fmt_nm(SH2_OP_MOV_L_STORE, dst, src);
+}
+
+uint16_t sh2_encode_mov_w_indir(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_MOV_W_LOAD, dst, src);
+}
+
+uint16_t sh2_encode_mov_w_indir_store(int src, int dst) {
+    return sh2_fmt_nm(SH2_OP_MOV_W_STORE, dst, src);
+}
+
+uint16_t sh2_encode_mov_b_indir(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_MOV_B_LOAD, dst, src);
+}
+
+uint16_t sh2_encode_mov_b_indir_store(int src, int dst) {
+    return sh2_fmt_nm(SH2_OP_MOV_B_STORE, dst, src);
+}
+
+uint16_t sh2_encode_mov_l_post_inc(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_MOV_L_POSTINC, dst, src);
+}
+
+uint16_t sh2_encode_mov_w_post_inc(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_MOV_W_POSTINC, dst, src);
+}
+
+uint16_t sh2_encode_mov_b_post_inc(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_MOV_B_POSTINC, dst, src);
+}
+
+uint16_t sh2_encode_mov_l_pre_dec(int src, int dst) {
+    return sh2_fmt_nm(SH2_OP_MOV_L_PREDEC, dst, src);
+}
+
+uint16_t sh2_encode_mov_w_pre_dec(int src, int dst) {
+    return sh2_fmt_nm(SH2_OP_MOV_W_PREDEC, dst, src);
+}
+
+uint16_t sh2_encode_mov_b_pre_dec(int src, int dst) {
+    return sh2_fmt_nm(SH2_OP_MOV_B_PREDEC, dst, src);
+}
+
+uint16_t sh2_encode_mov_l_r0_indexed(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_MOV_L_R0_LOAD, dst, src);
+}
+
+uint16_t sh2_encode_mov_l_r0_indexed_store(int src, int dst) {
+    return sh2_fmt_nm(SH2_OP_MOV_L_R0_STORE, dst, src);
+}
+
+uint16_t sh2_encode_mov_w_r0_indexed(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_MOV_W_R0_LOAD, dst, src);
+}
+
+uint16_t sh2_encode_mov_w_r0_indexed_store(int src, int dst) {
+    return sh2_fmt_nm(SH2_OP_MOV_W_R0_STORE, dst, src);
+}
+
+uint16_t sh2_encode_mov_b_r0_indexed(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_MOV_B_R0_LOAD, dst, src);
+}
+
+uint16_t sh2_encode_mov_b_r0_indexed_store(int src, int dst) {
+    return sh2_fmt_nm(SH2_OP_MOV_B_R0_STORE, dst, src);
+}
+
+uint16_t sh2_encode_mov_l_gbr_disp(int reg, int disp) {
+    return reg == 0 ? sh2_fmt_i(SH2_OP_MOV_L_GBR_LOAD, disp >> 2) : SH2_ENCODE_INVALID;
+}
+
+uint16_t sh2_encode_mov_l_gbr_store(int reg, int disp) {
+    return reg == 0 ? sh2_fmt_i(SH2_OP_MOV_L_GBR_STORE, disp >> 2) : SH2_ENCODE_INVALID;
 }
 
+uint16_t sh2_encode_mov_w_gbr_disp(int reg, int disp) {
+    return reg == 0 ? sh2_fmt_i(SH2_OP_MOV_W_GBR_LOAD, disp >> 1) : SH2_ENCODE_INVALID;
+}
+
+uint16_t sh2_encode_mov_w_gbr_store(int reg, int disp) {
+    return reg == 0 ? sh2_fmt_i(SH2_OP_MOV_W_GBR_STORE, disp >> 1) : SH2_ENCODE_INVALID;
+}
+
+uint16_t sh2_encode_mov_b_gbr_disp(int reg, int disp) {
+    return reg == 0 ? sh2_fmt_i(SH2_OP_MOV_B_GBR_LOAD, disp) : SH2_ENCODE_INVALID;
+}
+
+uint16_t sh2_encode_mov_b_gbr_store(int reg, int disp) {
+    return reg == 0 ? sh2_fmt_i(SH2_OP_MOV_B_GBR_STORE, disp) : SH2_ENCODE_INVALID;
+}
+
+uint16_t sh2_encode_mova(int disp) {
+    return sh2_fmt_i(SH2_OP_MOVA, disp >> 2);
+}
+
+uint16_t sh2_encode_movt(int reg) {
+    return sh2_fmt_n(SH2_OP_MOVT, reg);
+}
+
+uint16_t sh2_encode_swap_b(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_SWAP_B, dst, src);
+}
+
+uint16_t sh2_encode_swap_w(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_SWAP_W, dst, src);
+}
+
+uint16_t sh2_encode_xtrct(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_XTRCT, dst, src);
+}
+
+// Arithmetic
+
 uint16_t sh2_encode_add(int dst, int src) {
-    return 0x300C | (dst << 8) | (src << 4);
+    return sh2_fmt_nm(SH2_OP_ADD, dst, src);
+}
+
+uint16_t sh2_encode_add_imm(int reg, int8_t imm) {
+    return sh2_fmt_ni(SH2_OP_ADD_IMM, reg, imm);
+}
+
+uint16_t sh2_encode_addc(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_ADDC, dst, src);
+}
+
+uint16_t sh2_encode_addv(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_ADDV, dst, src);
+}
+
+uint16_t sh2_encode_sub(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_SUB, dst, src);
+}
+
+uint16_t sh2_encode_subc(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_SUBC, dst, src);
+}
+
+uint16_t sh2_encode_subv(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_SUBV, dst, src);
+}
+
+uint16_t sh2_encode_neg(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_NEG, dst, src);
+}
+
+uint16_t sh2_encode_negc(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_NEGC, dst, src);
+}
+
+uint16_t sh2_encode_mac_l(int src1, int src2) {
+    return sh2_fmt_nm(SH2_OP_MAC_L, src2, src1);
+}
+
+uint16_t sh2_encode_mac_w(int src1, int src2) {
+    return sh2_fmt_nm(SH2_OP_MAC_W, src2, src1);
+}
+
+uint16_t sh2_encode_mul_l(int src1, int src2) {
+    return sh2_fmt_nm(SH2_OP_MUL_L, src2, src1);
+}
+
+uint16_t sh2_encode_mulu_w(int src1, int src2) {
+    return sh2_fmt_nm(SH2_OP_MULU_W, src2, src1);
+}
+
+uint16_t sh2_encode_muls_w(int src1, int src2) {
+    return sh2_fmt_nm(SH2_OP_MULS_W, src2, src1);
+}
+
+uint16_t sh2_encode_div0s(int src1, int src2) {
+    return sh2_fmt_nm(SH2_OP_DIV0S, src2, src1);
+}
+
+uint16_t sh2_encode_div0u(void) {
+    return SH2_OP_DIV0U;
+}
+
+uint16_t sh2_encode_div1(int src1, int src2) {
+    return sh2_fmt_nm(SH2_OP_DIV1, src2, src1);
+}
+
+uint16_t sh2_encode_dmulu_l(int src1, int src2) {
+    return sh2_fmt_nm(SH2_OP_DMULU_L, src2, src1);
+}
+
+uint16_t sh2_encode_dmuls_l(int src1, int src2) {
+    return sh2_fmt_nm(SH2_OP_DMULS_L, src2, src1);
+}
+
+uint16_t sh2_encode_dt(int reg) {
+    return sh2_fmt_n(SH2_OP_DT, reg);
+}
+
+// Logic
+
+uint16_t sh2_encode_and(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_AND, dst, src);
+}
+
+uint16_t sh2_encode_and_imm(uint8_t imm) {
+    return sh2_fmt_i(SH2_OP_AND_IMM, imm);
+}
+
+uint16_t sh2_encode_and_b_imm(uint8_t imm) {
+    return sh2_fmt_i(SH2_OP_AND_B, imm);
+}
+
+uint16_t sh2_encode_or(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_OR, dst, src);
+}
+
+uint16_t sh2_encode_or_imm(uint8_t imm) {
+    return sh2_fmt_i(SH2_OP_OR_IMM, imm);
+}
+
+uint16_t sh2_encode_or_b_imm(uint8_t imm) {
+    return sh2_fmt_i(SH2_OP_OR_B, imm);
+}
+
+uint16_t sh2_encode_xor(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_XOR, dst, src);
+}
+
+uint16_t sh2_encode_xor_imm(uint8_t imm) {
+    return sh2_fmt_i(SH2_OP_XOR_IMM, imm);
+}
+
+uint16_t sh2_encode_xor_b_imm(uint8_t imm) {
+    return sh2_fmt_i(SH2_OP_XOR_B, imm);
+}
+
+uint16_t sh2_encode_not(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_NOT, dst, src);
+}
+
+uint16_t sh2_encode_tst(int src1, int src2) {
+    return sh2_fmt_nm(SH2_OP_TST, src2, src1);
+}
+
+uint16_t sh2_encode_tst_imm(uint8_t imm) {
+    return sh2_fmt_i(SH2_OP_TST_IMM, imm);
+}
+
+uint16_t sh2_encode_tst_b_imm(uint8_t imm) {
+    return sh2_fmt_i(SH2_OP_TST_B, imm);
+}
+
+uint16_t sh2_encode_tas_b(int reg) {
+    return sh2_fmt_n(SH2_OP_TAS_B, reg);
+}
+
+// Shift and Rotate
+
+uint16_t sh2_encode_shal(int reg) {
+    return sh2_fmt_n(SH2_OP_SHAL, reg);
+}
+
+uint16_t sh2_encode_shar(int reg) {
+    return sh2_fmt_n(SH2_OP_SHAR, reg);
+}
+
+uint16_t sh2_encode_shll(int reg) {
+    return sh2_fmt_n(SH2_OP_SHLL, reg);
+}
+
+uint16_t sh2_encode_shlr(int reg) {
+    return sh2_fmt_n(SH2_OP_SHLR, reg);
+}
+
+uint16_t sh2_encode_shll2(int reg) {
+    return sh2_fmt_n(SH2_OP_SHLL2, reg);
+}
+
+uint16_t sh2_encode_shlr2(int reg) {
+    return sh2_fmt_n(SH2_OP_SHLR2, reg);
+}
+
+uint16_t sh2_encode_shll8(int reg) {
+    return sh2_fmt_n(SH2_OP_SHLL8, reg);
+}
+
+uint16_t sh2_encode_shlr8(int reg) {
+    return sh2_fmt_n(SH2_OP_SHLR8, reg);
+}
+
+uint16_t sh2_encode_shll16(int reg) {
+    return sh2_fmt_n(SH2_OP_SHLL16, reg);
+}
+
+uint16_t sh2_encode_shlr16(int reg) {
+    return sh2_fmt_n(SH2_OP_SHLR16, reg);
+}
+
+uint16_t sh2_encode_rotl(int reg) {
+    return sh2_fmt_n(SH2_OP_ROTL, reg);
+}
+
+uint16_t sh2_encode_rotr(int reg) {
+    return sh2_fmt_n(SH2_OP_ROTR, reg);
+}
+
+uint16_t sh2_encode_rotcl(int reg) {
+    return sh2_fmt_n(SH2_OP_ROTCL, reg);
+}
+
+uint16_t sh2_encode_rotcr(int reg) {
+    return sh2_fmt_n(SH2_OP_ROTCR, reg);
+}
+
+// Branch
+
+uint16_t sh2_encode_bra(int disp) {
+    return sh2_fmt_d12(SH2_OP_BRA, disp);
+}
+
+uint16_t sh2_encode_braf(int reg) {
+    return sh2_fmt_n(SH2_OP_BRAF, reg);
+}
+
+uint16_t sh2_encode_bsr(int disp) {
+    return sh2_fmt_d12(SH2_OP_BSR, disp);
+}
+
+uint16_t sh2_encode_bsrf(int reg) {
+    return sh2_fmt_n(SH2_OP_BSRF, reg);
+}
+
+uint16_t sh2_encode_bt(int disp) {
+    return sh2_fmt_i(SH2_OP_BT, disp >> 1);
+}
+
+uint16_t sh2_encode_bf(int disp) {
+    return sh2_fmt_i(SH2_OP_BF, disp >> 1);
+}
+
+uint16_t sh2_encode_bt_s(int disp) {
+    return sh2_fmt_i(SH2_OP_BT_S, disp >> 1);
+}
+
+uint16_t sh2_encode_bf_s(int disp) {
+    return sh2_fmt_i(SH2_OP_BF_S, disp >> 1);
+}
+
+uint16_t sh2_encode_jmp(int reg) {
+    return sh2_fmt_n(SH2_OP_JMP, reg);
+}
+
+uint16_t sh2_encode_jsr(int reg) {
+    return sh2_fmt_n(SH2_OP_JSR, reg);
+}
+
+uint16_t sh2_encode_rts(void) {
+    return SH2_OP_RTS;
 }
 
+uint16_t sh2_encode_rte(void) {
+    return SH2_OP_RTE;
+}
+
+uint16_t sh2_encode_trapa(uint8_t imm) {
+    return sh2_fmt_i(SH2_OP_TRAPA, imm);
+}
+
+// Compare
+
 uint16_t sh2_encode_cmp_eq(int src1, int src2) {
-    return 0x3000 | (src2 << 8) | (src1 << 4);
-}
\ No newline at end of file
+    return sh2_fmt_nm(SH2_OP_CMP_EQ, src2, src1);
+}
+
+uint16_t sh2_encode_cmp_hs(int src1, int src2) {
+    return sh2_fmt_nm(SH2_OP_CMP_HS, src2, src1);
+}
+
+uint16_t sh2_encode_cmp_ge(int src1, int src2) {
+    return sh2_fmt_nm(SH2_OP_CMP_GE, src2, src1);
+}
+
+uint16_t sh2_encode_cmp_hi(int src1, int src2) {
+    return sh2_fmt_nm(SH2_OP_CMP_HI, src2, src1);
+}
+
+uint16_t sh2_encode_cmp_gt(int src1, int src2) {
+    return sh2_fmt_nm(SH2_OP_CMP_GT, src2, src1);
+}
+
+uint16_t sh2_encode_cmp_pz(int reg) {
+    return sh2_fmt_n(SH2_OP_CMP_PZ, reg);
+}
+
+uint16_t sh2_encode_cmp_pl(int reg) {
+    return sh2_fmt_n(SH2_OP_CMP_PL, reg);
+}
+
+uint16_t sh2_encode_cmp_str(int src1, int src2) {
+    return sh2_fmt_nm(SH2_OP_CMP_STR, src2, src1);
+}
+
+uint16_t sh2_encode_cmp_eq_imm(int8_t imm) {
+    return sh2_fmt_i(SH2_OP_CMP_EQ_IMM, imm);
+}
+
+// System Control
+
+static int sh2_register_index(const char *const names[3], const char *name, size_t length) {
+    for (int i = 0; i < 3; i++) {
+        if (strlen(names[i]) == length && strncasecmp(names[i], name, length) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int sh2_control_register(const char *name, size_t length) {
+    static const char *const names[3] = {"sr", "gbr", "vbr"};
+    return sh2_register_index(names, name, length);
+}
+
+int sh2_system_register(const char *name, size_t length) {
+    static const char *const names[3] = {"mach", "macl", "pr"};
+    return sh2_register_index(names, name, length);
+}
+
+static uint16_t sh2_fmt_special(uint16_t opcode, int reg, int special) {
+    if (special < 0) return SH2_ENCODE_INVALID;
+    return (uint16_t)(sh2_fmt_n(opcode, reg) | (special << 4));
+}
+
+uint16_t sh2_encode_ldc(int src, const char *ctrl) {
+    return sh2_fmt_special(SH2_OP_LDC, src, sh2_control_register(ctrl, strlen(ctrl)));
+}
+
+uint16_t sh2_encode_ldc_l(int src, const char *ctrl) {
+    return sh2_fmt_special(SH2_OP_LDC_L, src, sh2_control_register(ctrl, strlen(ctrl)));
+}
+
+uint16_t sh2_encode_stc(const char *ctrl, int dst) {
+    return sh2_fmt_special(SH2_OP_STC, dst, sh2_control_register(ctrl, strlen(ctrl)));
+}
+
+uint16_t sh2_encode_stc_l(const char *ctrl, int dst) {
+    return sh2_fmt_special(SH2_OP_STC_L, dst, sh2_control_register(ctrl, strlen(ctrl)));
+}
+
+uint16_t sh2_encode_lds(int src, const char *ctrl) {
+    return sh2_fmt_special(SH2_OP_LDS, src, sh2_system_register(ctrl, strlen(ctrl)));
+}
+
+uint16_t sh2_encode_lds_l(int src, const char *ctrl) {
+    return sh2_fmt_special(SH2_OP_LDS_L, src, sh2_system_register(ctrl, strlen(ctrl)));
+}
+
+uint16_t sh2_encode_sts(const char *ctrl, int dst) {
+    return sh2_fmt_special(SH2_OP_STS, dst, sh2_system_register(ctrl, strlen(ctrl)));
+}
+
+uint16_t sh2_encode_sts_l(const char *ctrl, int dst) {
+    return sh2_fmt_special(SH2_OP_STS_L, dst, sh2_system_register(ctrl, strlen(ctrl)));
+}
+
+uint16_t sh2_encode_clrmac(void) {
+    return SH2_OP_CLRMAC;
+}
+
+uint16_t sh2_encode_clrt(void) {
+    return SH2_OP_CLRT;
+}
+
+uint16_t sh2_encode_sett(void) {
+    return SH2_OP_SETT;
+}
+
+uint16_t sh2_encode_nop(void) {
+    return SH2_OP_NOP;
+}
+
+uint16_t sh2_encode_sleep(void) {
+    return SH2_OP_SLEEP;
+}
+
+// Sign/Zero Extension
+
+uint16_t sh2_encode_exts_b(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_EXTS_B, dst, src);
+}
+
+uint16_t sh2_encode_exts_w(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_EXTS_W, dst, src);
+}
+
+uint16_t sh2_encode_extu_b(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_EXTU_B, dst, src);
+}
+
+uint16_t sh2_encode_extu_w(int dst, int src) {
+    return sh2_fmt_nm(SH2_OP_EXTU_W, dst, src);
+}
@@ -76,14 +76,14 @@ bool sh2_can_use_in_delay_slot(const char *instruction) {
 }
 
 // Try to fill delay slot with useful instruction
-void sh2_optimize_delay_slot(FILE *out, const char *branch_inst,
+void sh2_optimize_delay_slot(AsmBuffer *out, const char *branch_inst,
                               const char *next_inst) {
     if (sh2_can_use_in_delay_slot(next_inst)) {
-        fprintf(out, "\t%s\n", branch_inst);
-        fprintf(out, "\t%s\n", next_inst);
+        asm_buffer_format(out, "\t%s\n", branch_inst);
+        asm_buffer_format(out, "\t%s\n", next_inst);
     } else {
-        fprintf(out, "\t%s\n", branch_inst);
-        fprintf(out, "\tnop\n");
+        asm_buffer_format(out, "\t%s\n", branch_inst);
+        asm_buffer_format(out, "\tnop\n");
     }
 }
 
@@ -133,7 +133,7 @@ int sh2_alloc_find_victim(RegisterAllocator *alloc) {
 // ============================================================================
 
 // Generate efficient comparison
-void sh2_gen_compare(FILE *out, const char *op, int lhs, int rhs,
+void sh2_gen_compare(AsmBuffer *out, const char *op, int lhs, int rhs,
                      const char *true_label) {
     if (strcmp(op, "==") == 0) {
         sh2_cmp_eq(out, lhs, rhs);
@@ -158,7 +158,7 @@ void sh2_gen_compare(FILE *out, const char *op, int lhs, int rhs,
 }
 
 // Generate efficient loop
-void sh2_gen_loop(FILE *out, int counter_reg, int count,
+void sh2_gen_loop(AsmBuffer *out, int counter_reg, int count,
                   const char *body_label, const char *end_label) {
     // Use dt instruction for efficient countdown loops
     sh2_mov_imm(out, counter_reg, count);
@@ -173,7 +173,7 @@ void sh2_gen_loop(FILE *out, int counter_reg, int count,
 }
 
 // Generate efficient switch statement using jump table
-void sh2_gen_switch(FILE *out, int value_reg, int num_cases,
+void sh2_gen_switch(AsmBuffer *out, int value_reg, int num_cases,
                     const char *table_label) {
     (void)table_label;  // Mark as intentionally unused
 
@@ -201,7 +201,7 @@ void sh2_gen_switch(FILE *out, int value_reg, int num_cases,
 // ============================================================================
 
 // Optimize multiplication by constant
-void sh2_gen_mul_const(FILE *out, int dst, int src, int constant) {
+void sh2_gen_mul_const(AsmBuffer *out, int dst, int src, int constant) {
     if (constant == 0) {
         sh2_mov_imm(out, dst, 0);
     } else if (constant == 1) {
@@ -248,7 +248,7 @@ void sh2_gen_mul_const(FILE *out, int dst, int src, int constant) {
 }
 
 // Optimize division by constant
-void sh2_gen_div_const(FILE *out, int dst, int src, int constant) {
+void sh2_gen_div_const(AsmBuffer *out, int dst, int src, int constant) {
     if (constant == 1) {
         if (dst != src) {
             sh2_mov_reg_reg(out, dst, src);
@@ -287,7 +287,7 @@ void sh2_gen_div_const(FILE *out, int dst, int src, int constant) {
 // ============================================================================
 
 // Optimize consecutive memory loads
-void sh2_gen_load_multiple(FILE *out, int base_reg, int *dst_regs,
+void sh2_gen_load_multiple(AsmBuffer *out, int base_reg, int *dst_regs,
                             int count, int offset) {
     for (int i = 0; i < count; i++) {
         int current_offset = offset + (i * 4);
@@ -300,7 +300,7 @@ void sh2_gen_load_multiple(FILE *out, int base_reg, int *dst_regs,
 }
 
 // Optimize consecutive memory stores
-void sh2_gen_store_multiple(FILE *out, int base_reg, int *src_regs,
+void sh2_gen_store_multiple(AsmBuffer *out, int base_reg, int *src_regs,
                              int count, int offset) {
     for (int i = 0; i < count; i++) {
         int current_offset = offset + (i * 4);
@@ -317,7 +317,7 @@ void sh2_gen_store_multiple(FILE *out, int base_reg, int *src_regs,
 // ============================================================================
 
 // Replace expensive operations with cheaper equivalents
-void sh2_strength_reduce(FILE *out, const char *op, int dst, int src,
+void sh2_strength_reduce(AsmBuffer *out, const char *op, int dst, int src,
                          int constant) {
     if (strcmp(op, "*") == 0) {
         sh2_gen_mul_const(out, dst, src, constant);
@@ -336,7 +336,7 @@ void sh2_strength_reduce(FILE *out, const char *op, int dst, int src,
 // ============================================================================
 
 // Invert branch to eliminate unnecessary jumps
-void sh2_optimize_branch_chain(FILE *out, bool invert,
+void sh2_optimize_branch_chain(AsmBuffer *out, bool invert,
                                 const char *target_label) {
     if (invert) {
         sh2_bf(out, target_label);
@@ -351,10 +351,10 @@ void sh2_optimize_branch_chain(FILE *out, bool invert,
 // ============================================================================
 
 // Generate leaf function (no calls to other functions)
-void sh2_gen_leaf_function(FILE *out, const char *name, int frame_size) {
-    fprintf(out, "\n\t.align 2\n");
-    fprintf(out, "\t.global _%s\n", name);
-    fprintf(out, "_%s:\n", name);
+void sh2_gen_leaf_function(AsmBuffer *out, const char *name, int frame_size) {
+    asm_buffer_format(out, "\n\t.align 2\n");
+    asm_buffer_format(out, "\t.global _%s\n", name);
+    asm_buffer_format(out, "_%s:\n", name);
 
     if (frame_size > 0) {
         // Only save frame pointer, not PR (no calls)
@@ -371,7 +371,7 @@ void sh2_gen_leaf_function(FILE *out, const char *name, int frame_size) {
 }
 
 // Generate tail call optimization
-void sh2_gen_tail_call(FILE *out, const char *target) {
+void sh2_gen_tail_call(AsmBuffer *out, const char *target) {
     // Restore frame and jump directly
     sh2_mov_reg_reg(out, 15, 14);
     sh2_pop(out, 14);
@@ -387,7 +387,7 @@ void sh2_gen_tail_call(FILE *out, const char *target) {
 // ============================================================================
 
 // Use shorter instruction sequences
-void sh2_optimize_code_size(FILE *out, const char *operation,
+void sh2_optimize_code_size(AsmBuffer *out, const char *operation,
                             int dst, int src, int immediate) {
     (void)src;  // Mark as intentionally unused
 
@@ -407,7 +407,7 @@ void sh2_optimize_code_size(FILE *out, const char *operation,
 // ============================================================================
 
 // Recognize common idioms and optimize
-void sh2_optimize_idiom(FILE *out, const char *pattern_name,
+void sh2_optimize_idiom(AsmBuffer *out, const char *pattern_name,
                         int *regs, int count) {
     (void)count;  // Mark as intentionally unused
 
@@ -443,7 +443,7 @@ void sh2_optimize_idiom(FILE *out, const char *pattern_name,
 // ============================================================================
 
 // Optimize for Saturn's dual CPU architecture
-void sh2_optimize_for_dual_cpu(FILE *out, bool is_slave) {
+void sh2_optimize_for_dual_cpu(AsmBuffer *out, bool is_slave) {
     if (is_slave) {
         sh2_comment(out, "Slave CPU code");
         // Ensure proper synchronization
@@ -454,7 +454,7 @@ void sh2_optimize_for_dual_cpu(FILE *out, bool is_slave) {
 }
 
 // Optimize VDP1/VDP2 memory access
-void sh2_optimize_vram_access(FILE *out, uint32_t vram_addr,
+void sh2_optimize_vram_access(AsmBuffer *out, uint32_t vram_addr,
                                int data_reg, bool is_write) {
     // Use efficient addressing modes for VRAM
     sh2_mov_l_imm(out, 0, vram_addr);
@@ -470,10 +470,10 @@ void sh2_optimize_vram_access(FILE *out, uint32_t vram_addr,
 // Debug Support
 // ============================================================================
 
-void sh2_emit_debug_info(FILE *out, const char *source_file, int line) {
-    fprintf(out, "\t! %s:%d\n", source_file, line);
+void sh2_emit_debug_info(AsmBuffer *out, const char *source_file, int line) {
+    asm_buffer_format(out, "\t! %s:%d\n", source_file, line);
 }
 
-void sh2_emit_function_trace(FILE *out, const char *func_name) {
-    fprintf(out, "\t! ENTER: %s\n", func_name);
+void sh2_emit_function_trace(AsmBuffer *out, const char *func_name) {
+    asm_buffer_format(out, "\t! ENTER: %s\n", func_name);
 }
\ No newline at end of file
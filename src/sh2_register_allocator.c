@@ -335,16 +335,16 @@ int sh2_regalloc_get_num_spill_slots(SH2RegisterAllocator *alloc) {
     return alloc->num_spill_slots;
 }
 
-void sh2_regalloc_emit_spill(SH2RegisterAllocator *alloc, FILE *out, int vreg, int temp_reg) {
+void sh2_regalloc_emit_spill(SH2RegisterAllocator *alloc, AsmBuffer *out, int vreg, int temp_reg) {
     if (!sh2_regalloc_is_spilled(alloc, vreg)) return;
-    fprintf(out, "\t! Spill v%d to stack\n", vreg);
+    asm_buffer_format(out, "\t! Spill v%d to stack\n", vreg);
     sh2_mov_l_reg_disp(out, temp_reg, sh2_regalloc_get_spill_offset(alloc, vreg), 14);
     alloc->num_spills++;
 }
 
-void sh2_regalloc_emit_reload(SH2RegisterAllocator *alloc, FILE *out, int vreg, int temp_reg) {
+void sh2_regalloc_emit_reload(SH2RegisterAllocator *alloc, AsmBuffer *out, int vreg, int temp_reg) {
     if (!sh2_regalloc_is_spilled(alloc, vreg)) return;
-    fprintf(out, "\t! Reload v%d from stack\n", vreg);
+    asm_buffer_format(out, "\t! Reload v%d from stack\n", vreg);
     sh2_mov_l_disp_reg(out, temp_reg, sh2_regalloc_get_spill_offset(alloc, vreg), 14);
     alloc->num_reloads++;
 }
@@ -411,8 +411,8 @@ int sh2_regalloc_find_free_saved(SH2RegisterAllocator *alloc) {
     return -1;
 }
 
-void sh2_regalloc_print_allocation(SH2RegisterAllocator *alloc, FILE *out) {
-    fprintf(out, "\n! Register Allocation: %d vregs, %d spill slots\n",
+void sh2_regalloc_print_allocation(SH2RegisterAllocator *alloc, AsmBuffer *out) {
+    asm_buffer_format(out, "\n! Register Allocation: %d vregs, %d spill slots\n",
             alloc->num_vregs, alloc->num_spill_slots);
 }
 
@@ -422,8 +422,8 @@ void sh2_regalloc_get_stats(SH2RegisterAllocator *alloc, int *s, int *r, int *m)
     if (m) *m = alloc->num_moves;
 }
 
-void sh2_regalloc_dump_interference(SH2RegisterAllocator *alloc, FILE *out) {
-    fprintf(out, "! Interference graph for %d vregs\n", alloc->num_vregs);
+void sh2_regalloc_dump_interference(SH2RegisterAllocator *alloc, AsmBuffer *out) {
+    asm_buffer_format(out, "! Interference graph for %d vregs\n", alloc->num_vregs);
 }
 
 bool sh2_regalloc_verify(SH2RegisterAllocator *alloc) {
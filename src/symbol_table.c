@@ -1,23 +1,25 @@
 #include "symbol_table.h"
 #include "kcc.h"
+#include "intern.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 SymbolTable *symbol_table_create(void) {
-    SymbolTable *table = malloc(sizeof(SymbolTable));
+    SymbolTable *table = calloc(1, sizeof(SymbolTable));
     if (!table) {
         error_fatal("Memory allocation failed for symbol table");
         return NULL;
     }
 
-    table->table = calloc(SYMBOL_TABLE_SIZE, sizeof(Symbol*));
+    table->table = calloc(SYMBOL_TABLE_INITIAL_CAPACITY, sizeof(Symbol*));
     if (!table->table) {
         free(table);
         error_fatal("Memory allocation failed for symbol table array");
         return NULL;
     }
 
+    table->capacity = SYMBOL_TABLE_INITIAL_CAPACITY;
     table->current_scope = 0;
     return table;
 }
@@ -25,56 +27,81 @@ SymbolTable *symbol_table_create(void) {
 void symbol_table_destroy(SymbolTable *table) {
     if (!table) return;
 
-    for (int i = 0; i < SYMBOL_TABLE_SIZE; i++) {
-        Symbol *symbol = table->table[i];
-        while (symbol) {
-            Symbol *next = symbol->next;
-            free(symbol->name);
-            free(symbol);
-            symbol = next;
-        }
+    // The log holds every live symbol exactly once
+    for (int i = 0; i < table->count; i++) {
+        free(table->scope_log[i]);
     }
+    free(table->scope_log);
+    free(table->scope_marks);
     free(table->table);
     free(table);
 }
 
 void symbol_table_enter_scope(SymbolTable *table) {
-    if (table) {
-        table->current_scope++;
+    if (!table) return;
+
+    if (table->current_scope >= table->marks_capacity) {
+        int new_capacity = table->marks_capacity ? table->marks_capacity * 2 : 16;
+        int *new_marks = realloc(table->scope_marks, new_capacity * sizeof(int));
+        if (!new_marks) {
+            error_fatal("Memory allocation failed for symbol table scopes");
+            return;
+        }
+        table->scope_marks = new_marks;
+        table->marks_capacity = new_capacity;
+    }
+
+    table->scope_marks[table->current_scope] = table->count;
+    table->current_scope++;
+    if (table->current_scope > table->max_scope_seen) {
+        table->max_scope_seen = table->current_scope;
     }
 }
 
 void symbol_table_exit_scope(SymbolTable *table) {
-    if (!table) return;
+    if (!table || table->current_scope == 0) return;
 
-    // Remove all symbols in the current scope
-    for (int i = 0; i < SYMBOL_TABLE_SIZE; i++) {
-        Symbol **current = &table->table[i];
-        while (*current) {
-            if ((*current)->scope_level == table->current_scope) {
-                Symbol *to_remove = *current;
-                *current = (*current)->next;
-                free(to_remove->name);
-                free(to_remove);
-            } else {
-                current = &(*current)->next;
-            }
-        }
-    }
+    int mark = table->scope_marks[table->current_scope - 1];
+    unsigned int mask = (unsigned int)table->capacity - 1;
 
-    if (table->current_scope > 0) {
-        table->current_scope--;
+    // Symbols are popped newest first. Anything declared after a symbol lives
+    // in this scope or a deeper one that is already gone, so each symbol is
+    // still at the head of its bucket when its turn comes.
+    while (table->count > mark) {
+        Symbol *symbol = table->scope_log[--table->count];
+        table->table[intern_hash(symbol->name) & mask] = symbol->next;
+        free(symbol);
     }
+
+    table->current_scope--;
 }
 
 unsigned int symbol_table_hash(const char *name) {
-    if (!name) return 0;
+    return name ? intern_hash(name) : 0;
+}
+
+// Doubles the bucket array. Chains are rebuilt from the log, oldest first, so
+// they keep the newest-first order that shadowing and scope exit rely on.
+static bool symbol_table_grow(SymbolTable *table) {
+    int new_capacity = table->capacity * 2;
+    Symbol **new_table = calloc(new_capacity, sizeof(Symbol*));
+    if (!new_table) {
+        error_fatal("Memory allocation failed for symbol table array");
+        return false;
+    }
 
-    unsigned int hash = 0;
-    for (int i = 0; name[i] != '\0'; i++) {
-        hash = hash * 31 + name[i];
+    unsigned int mask = (unsigned int)new_capacity - 1;
+    for (int i = 0; i < table->count; i++) {
+        Symbol *symbol = table->scope_log[i];
+        unsigned int index = intern_hash(symbol->name) & mask;
+        symbol->next = new_table[index];
+        new_table[index] = symbol;
     }
-    return hash % SYMBOL_TABLE_SIZE;
+
+    free(table->table);
+    table->table = new_table;
+    table->capacity = new_capacity;
+    return true;
 }
 
 bool symbol_table_insert(SymbolTable *table, const char *name, SymbolType symbol_type, DataType data_type) {
@@ -85,19 +112,31 @@ bool symbol_table_insert(SymbolTable *table, const char *name, SymbolType symbol
         return false; // Symbol already exists in current scope
     }
 
-    unsigned int index = symbol_table_hash(name);
+    // Keep the load factor at or below 3/4
+    if ((table->count + 1) * 4 > table->capacity * 3 && !symbol_table_grow(table)) {
+        return false;
+    }
+
+    if (table->count == table->log_capacity) {
+        int new_capacity = table->log_capacity ? table->log_capacity * 2 : 64;
+        Symbol **new_log = realloc(table->scope_log, new_capacity * sizeof(Symbol*));
+        if (!new_log) {
+            error_fatal("Memory allocation failed for symbol table scopes");
+            return false;
+        }
+        table->scope_log = new_log;
+        table->log_capacity = new_capacity;
+    }
+
+    unsigned int index = intern_hash(name) & ((unsigned int)table->capacity - 1);
 
-    Symbol *symbol = malloc(sizeof(Symbol));
+    Symbol *symbol = calloc(1, sizeof(Symbol));
     if (!symbol) {
         error_fatal("Memory allocation failed for symbol");
         return false;
     }
 
-    symbol->name = safe_strdup(name);
-    if (!symbol->name) {
-        free(symbol);
-        return false;
-    }
+    symbol->name = name;
 
     symbol->symbol_type = symbol_type;
     symbol->data_type = data_type;
@@ -105,6 +144,7 @@ bool symbol_table_insert(SymbolTable *table, const char *name, SymbolType symbol
     symbol->next = table->table[index];
 
     table->table[index] = symbol;
+    table->scope_log[table->count++] = symbol;
 
     return true;
 }
@@ -112,11 +152,10 @@ bool symbol_table_insert(SymbolTable *table, const char *name, SymbolType symbol
 Symbol *symbol_table_lookup(SymbolTable *table, const char *name) {
     if (!table || !name) return NULL;
 
-    unsigned int index = symbol_table_hash(name);
-    Symbol *symbol = table->table[index];
+    Symbol *symbol = table->table[intern_hash(name) & ((unsigned int)table->capacity - 1)];
 
     while (symbol) {
-        if (strcmp(symbol->name, name) == 0) {
+        if (symbol->name == name) {
             return symbol;
         }
         symbol = symbol->next;
@@ -128,11 +167,12 @@ Symbol *symbol_table_lookup(SymbolTable *table, const char *name) {
 Symbol *symbol_table_lookup_current_scope(SymbolTable *table, const char *name) {
     if (!table || !name) return NULL;
 
-    unsigned int index = symbol_table_hash(name);
-    Symbol *symbol = table->table[index];
+    Symbol *symbol = table->table[intern_hash(name) & ((unsigned int)table->capacity - 1)];
 
-    while (symbol) {
-        if (strcmp(symbol->name, name) == 0 && symbol->scope_level == table->current_scope) {
+    // Chains are newest first, so the current scope's symbols come before
+    // any from enclosing scopes
+    while (symbol && symbol->scope_level == table->current_scope) {
+        if (symbol->name == name) {
             return symbol;
         }
         symbol = symbol->next;
@@ -150,7 +190,7 @@ void symbol_table_print(SymbolTable *table) {
     printf("=== Symbol Table ===\n");
     printf("Current scope: %d\n", table->current_scope);
 
-    for (int i = 0; i < SYMBOL_TABLE_SIZE; i++) {
+    for (int i = 0; i < table->capacity; i++) {
         Symbol *symbol = table->table[i];
         while (symbol) {
             const char *symbol_type_str;
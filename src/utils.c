@@ -5,6 +5,13 @@
 #include <sys/stat.h>
 #include "kcc.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define KCC_HAVE_MMAP 1
+#endif
+
 // Read entire file into memory
 char* read_file(const char* filename) {
     if (!filename) {
@@ -50,6 +57,67 @@ char* read_file(const char* filename) {
     return content;
 }
 
+bool source_file_open(SourceFile *file, const char *filename) {
+    if (!file || !filename) {
+        return false;
+    }
+
+    memset(file, 0, sizeof(SourceFile));
+
+#ifdef KCC_HAVE_MMAP
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Could not open file '%s'\n", filename);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+            madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+            close(fd);
+            file->data = data;
+            file->size = (size_t)st.st_size;
+            file->mapped = true;
+            return true;
+        }
+    }
+    close(fd);
+#endif
+
+    // Empty files, pipes and platforms without mmap
+    char *content = read_file(filename);
+    if (!content) {
+        return false;
+    }
+
+    file->data = content;
+    file->size = strlen(content);
+    file->mapped = false;
+    return true;
+}
+
+void source_file_close(SourceFile *file) {
+    if (!file || !file->data) {
+        return;
+    }
+
+    if (file->mapped) {
+#ifdef KCC_HAVE_MMAP
+        munmap((void *)file->data, file->size);
+#endif
+    } else {
+        free((void *)file->data);
+    }
+
+    file->data = NULL;
+    file->size = 0;
+    file->mapped = false;
+}
+
 // Safe memory allocation
 void* safe_malloc(size_t size) {
     void* ptr = malloc(size);
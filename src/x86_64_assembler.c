@@ -0,0 +1,1753 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <ctype.h>
+
+#include "x86_64_assembler.h"
+#include "elf_writer.h"
+#include "intern.h"
+#include "error.h"
+
+#define X86_MAX_SECTIONS 16
+
+// ELF x86-64 relocation types
+#define R_X86_64_64    1
+#define R_X86_64_PC32  2
+#define R_X86_64_32    10
+#define R_X86_64_32S   11
+#define R_X86_64_PLT32 4
+
+typedef struct X86Section {
+    char name[64];
+    uint32_t type;
+    uint64_t flags;
+    uint64_t alignment;
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+    int elf_index;
+} X86Section;
+
+typedef struct X86Symbol {
+    const char *name;                // Interned
+    int section;                     // X86_NONE until defined
+    size_t offset;
+    bool global;
+    bool referenced;
+    int elf_symbol;                  // Writer handle, X86_NONE until created
+} X86Symbol;
+
+typedef enum {
+    X86_FIX_PC32,                    // rip-relative data reference
+    X86_FIX_BRANCH32,                // call/jmp/jcc target
+    X86_FIX_ABS32S,                  // Sign-extended 32-bit address
+    X86_FIX_ABS32,
+    X86_FIX_ABS64
+} X86FixupKind;
+
+// A reference to a symbol whose address is not known while encoding
+typedef struct X86Fixup {
+    int section;
+    size_t offset;
+    int symbol;
+    X86FixupKind kind;
+    int64_t addend;
+    int line;
+} X86Fixup;
+
+struct X86Assembler {
+    X86Section sections[X86_MAX_SECTIONS];
+    int section_count;
+    int current;                     // Section instructions go to
+
+    X86Symbol *symbols;
+    int symbol_count;
+    int symbol_capacity;
+    int *symbol_slots;               // Open addressing: symbol index + 1, or 0
+    size_t slot_capacity;            // Power of two
+
+    X86Fixup *fixups;
+    int fixup_count;
+    int fixup_capacity;
+
+    int line;
+    int error_count;
+};
+
+static void x86_error(X86Assembler *as, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    if (as->line > 0) {
+        fprintf(stderr, "Error: assembler line %d: ", as->line);
+    } else {
+        fprintf(stderr, "Error: assembler: ");
+    }
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    as->error_count++;
+}
+
+// ========================================
+// Sections and symbols
+// ========================================
+
+static int x86_section(X86Assembler *as, const char *name, uint32_t type, uint64_t flags) {
+    for (int i = 0; i < as->section_count; i++) {
+        if (strcmp(as->sections[i].name, name) == 0) {
+            return i;
+        }
+    }
+    if (as->section_count == X86_MAX_SECTIONS) {
+        x86_error(as, "too many sections");
+        return as->current;
+    }
+
+    X86Section *section = &as->sections[as->section_count];
+    memset(section, 0, sizeof(X86Section));
+    snprintf(section->name, sizeof(section->name), "%s", name);
+    section->type = type;
+    section->flags = flags;
+    section->alignment = 1;
+    return as->section_count++;
+}
+
+static void x86_emit_bytes(X86Assembler *as, const void *bytes, size_t length) {
+    X86Section *section = &as->sections[as->current];
+    if (section->type == ELF_SHT_NOBITS) {
+        x86_error(as, "data in a NOBITS section");
+        return;
+    }
+
+    if (section->size + length > section->capacity) {
+        size_t capacity = section->capacity ? section->capacity : 1024;
+        while (capacity < section->size + length) {
+            capacity *= 2;
+        }
+        unsigned char *data = realloc(section->data, capacity);
+        if (!data) {
+            error_fatal("Memory allocation failed for assembler output");
+            return;
+        }
+        section->data = data;
+        section->capacity = capacity;
+    }
+    memcpy(section->data + section->size, bytes, length);
+    section->size += length;
+}
+
+static void x86_emit_byte(X86Assembler *as, unsigned value) {
+    unsigned char byte = (unsigned char)value;
+    x86_emit_bytes(as, &byte, 1);
+}
+
+static void x86_emit_value(X86Assembler *as, uint64_t value, int size) {
+    unsigned char bytes[8];
+    for (int i = 0; i < size; i++) {
+        bytes[i] = (unsigned char)(value >> (i * 8));
+    }
+    x86_emit_bytes(as, bytes, (size_t)size);
+}
+
+static bool x86_grow_slots(X86Assembler *as) {
+    size_t capacity = as->slot_capacity ? as->slot_capacity * 2 : 64;
+    int *slots = calloc(capacity, sizeof(int));
+    if (!slots) {
+        error_fatal("Memory allocation failed for assembler symbols");
+        return false;
+    }
+
+    for (int i = 0; i < as->symbol_count; i++) {
+        size_t index = intern_hash(as->symbols[i].name) & (capacity - 1);
+        while (slots[index]) {
+            index = (index + 1) & (capacity - 1);
+        }
+        slots[index] = i + 1;
+    }
+
+    free(as->symbol_slots);
+    as->symbol_slots = slots;
+    as->slot_capacity = capacity;
+    return true;
+}
+
+// Finds or creates the symbol with the given spelling
+static int x86_symbol(X86Assembler *as, const char *text, size_t length) {
+    if ((size_t)(as->symbol_count + 1) * 2 > as->slot_capacity && !x86_grow_slots(as)) {
+        return X86_NONE;
+    }
+
+    const char *name = intern_string_n(text, length);
+    size_t mask = as->slot_capacity - 1;
+    size_t index = intern_hash(name) & mask;
+    while (as->symbol_slots[index]) {
+        int symbol = as->symbol_slots[index] - 1;
+        if (as->symbols[symbol].name == name) {
+            return symbol;
+        }
+        index = (index + 1) & mask;
+    }
+
+    if (as->symbol_count == as->symbol_capacity) {
+        int capacity = as->symbol_capacity ? as->symbol_capacity * 2 : 64;
+        X86Symbol *symbols = realloc(as->symbols, (size_t)capacity * sizeof(X86Symbol));
+        if (!symbols) {
+            error_fatal("Memory allocation failed for assembler symbols");
+            return X86_NONE;
+        }
+        as->symbols = symbols;
+        as->symbol_capacity = capacity;
+    }
+
+    X86Symbol *symbol = &as->symbols[as->symbol_count];
+    symbol->name = name;
+    symbol->section = X86_NONE;
+    symbol->offset = 0;
+    symbol->global = false;
+    symbol->referenced = false;
+    symbol->elf_symbol = X86_NONE;
+    as->symbol_slots[index] = as->symbol_count + 1;
+    return as->symbol_count++;
+}
+
+static void x86_define_label(X86Assembler *as, const char *text, size_t length) {
+    int symbol = x86_symbol(as, text, length);
+    if (symbol == X86_NONE) return;
+
+    if (as->symbols[symbol].section != X86_NONE) {
+        x86_error(as, "symbol '%.*s' is already defined", (int)length, text);
+        return;
+    }
+    as->symbols[symbol].section = as->current;
+    as->symbols[symbol].offset = as->sections[as->current].size;
+}
+
+// Emits a placeholder for a symbol's address, filled in by the writer
+static void x86_emit_fixup(X86Assembler *as, X86FixupKind kind, const char *name,
+                           int64_t addend, int size) {
+    int symbol = x86_symbol(as, name, strlen(name));
+    if (symbol == X86_NONE) return;
+
+    if (as->fixup_count == as->fixup_capacity) {
+        int capacity = as->fixup_capacity ? as->fixup_capacity * 2 : 64;
+        X86Fixup *fixups = realloc(as->fixups, (size_t)capacity * sizeof(X86Fixup));
+        if (!fixups) {
+            error_fatal("Memory allocation failed for assembler fixups");
+            return;
+        }
+        as->fixups = fixups;
+        as->fixup_capacity = capacity;
+    }
+
+    X86Fixup *fixup = &as->fixups[as->fixup_count++];
+    fixup->section = as->current;
+    fixup->offset = as->sections[as->current].size;
+    fixup->symbol = symbol;
+    fixup->kind = kind;
+    fixup->addend = addend;
+    fixup->line = as->line;
+    as->symbols[symbol].referenced = true;
+    x86_emit_value(as, 0, size);
+}
+
+// ========================================
+// Operands
+// ========================================
+
+// Register names by number, then by width: 1, 2, 4 and 8 bytes
+static const char *const x86_register_names[X86_RIP + 1][4] = {
+    {"al", "ax", "eax", "rax"},     {"cl", "cx", "ecx", "rcx"},
+    {"dl", "dx", "edx", "rdx"},     {"bl", "bx", "ebx", "rbx"},
+    {"spl", "sp", "esp", "rsp"},    {"bpl", "bp", "ebp", "rbp"},
+    {"sil", "si", "esi", "rsi"},    {"dil", "di", "edi", "rdi"},
+    {"r8b", "r8w", "r8d", "r8"},    {"r9b", "r9w", "r9d", "r9"},
+    {"r10b", "r10w", "r10d", "r10"}, {"r11b", "r11w", "r11d", "r11"},
+    {"r12b", "r12w", "r12d", "r12"}, {"r13b", "r13w", "r13d", "r13"},
+    {"r14b", "r14w", "r14d", "r14"}, {"r15b", "r15w", "r15d", "r15"},
+    {NULL, NULL, NULL, "rip"},
+};
+
+// Column of x86_register_names for a width in bytes, or -1
+static int x86_width_index(int size) {
+    switch (size) {
+        case 1: return 0;
+        case 2: return 1;
+        case 4: return 2;
+        case 8: return 3;
+        default: return -1;
+    }
+}
+
+static const char *x86_skip_space(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+static bool x86_is_symbol_char(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == '.' || c == '$';
+}
+
+static bool x86_parse_register(X86Assembler *as, const char **cursor, const char *end,
+                               int *number, int *size) {
+    const char *p = *cursor + 1;     // Past the '%'
+    const char *start = p;
+    while (p < end && isalnum((unsigned char)*p)) p++;
+
+    size_t length = (size_t)(p - start);
+    for (int n = 0; n <= X86_RIP; n++) {
+        for (int w = 0; w < 4; w++) {
+            const char *name = x86_register_names[n][w];
+            if (name && strlen(name) == length && memcmp(name, start, length) == 0) {
+                *number = n;
+                *size = 1 << w;
+                *cursor = p;
+                return true;
+            }
+        }
+    }
+    x86_error(as, "unknown register '%%%.*s'", (int)length, start);
+    return false;
+}
+
+// number, symbol, or symbol/number terms joined by + and -; at most one
+// (positive) symbol
+static bool x86_parse_expression(X86Assembler *as, const char **cursor, const char *end,
+                                 int64_t *value, const char **symbol) {
+    const char *p = x86_skip_space(*cursor, end);
+    *value = 0;
+    *symbol = NULL;
+    bool negate = false;
+    bool any = false;
+
+    while (p < end) {
+        if (*p == '-' || *p == '+') {
+            if (*p == '-') negate = !negate;
+            p = x86_skip_space(p + 1, end);
+            continue;
+        }
+
+        if (isdigit((unsigned char)*p)) {
+            char *number_end;
+            int64_t number = (int64_t)strtoull(p, &number_end, 0);
+            if (number_end > end) number_end = (char *)end;
+            *value += negate ? -number : number;
+            p = number_end;
+        } else if (*p == '\'' && p + 1 < end) {
+            *value += negate ? -(int64_t)(unsigned char)p[1] : (int64_t)(unsigned char)p[1];
+            p += (p + 2 < end && p[2] == '\'') ? 3 : 2;
+        } else if (x86_is_symbol_char(*p)) {
+            const char *start = p;
+            while (p < end && x86_is_symbol_char(*p)) p++;
+            if (*symbol || negate) {
+                x86_error(as, "unsupported symbol arithmetic");
+                return false;
+            }
+            *symbol = intern_string_n(start, (size_t)(p - start));
+        } else {
+            break;
+        }
+
+        any = true;
+        negate = false;
+        p = x86_skip_space(p, end);
+        if (p >= end || (*p != '+' && *p != '-')) break;
+    }
+
+    if (!any) {
+        x86_error(as, "expected an expression");
+        return false;
+    }
+    *cursor = p;
+    return true;
+}
+
+static bool x86_parse_operand(X86Assembler *as, const char *p, const char *end,
+                              X86Operand *operand) {
+    memset(operand, 0, sizeof(X86Operand));
+    operand->base = X86_NONE;
+    operand->index = X86_NONE;
+    operand->scale = 1;
+
+    p = x86_skip_space(p, end);
+    if (p < end && *p == '*') {
+        operand->indirect = true;
+        p = x86_skip_space(p + 1, end);
+    }
+    if (p >= end) {
+        x86_error(as, "missing operand");
+        return false;
+    }
+
+    if (*p == '%') {
+        operand->kind = X86_OP_REG;
+        if (!x86_parse_register(as, &p, end, &operand->reg, &operand->size)) return false;
+    } else if (*p == '$') {
+        operand->kind = X86_OP_IMM;
+        p++;
+        if (!x86_parse_expression(as, &p, end, &operand->value, &operand->symbol)) return false;
+    } else {
+        operand->kind = X86_OP_MEM;
+        if (*p != '(' &&
+            !x86_parse_expression(as, &p, end, &operand->value, &operand->symbol)) {
+            return false;
+        }
+
+        p = x86_skip_space(p, end);
+        if (p < end && *p == '(') {
+            int size;
+            p = x86_skip_space(p + 1, end);
+            if (p < end && *p == '%' && !x86_parse_register(as, &p, end, &operand->base, &size)) {
+                return false;
+            }
+            p = x86_skip_space(p, end);
+            if (p < end && *p == ',') {
+                p = x86_skip_space(p + 1, end);
+                if (p >= end || *p != '%' ||
+                    !x86_parse_register(as, &p, end, &operand->index, &size)) {
+                    x86_error(as, "expected an index register");
+                    return false;
+                }
+                p = x86_skip_space(p, end);
+                if (p < end && *p == ',') {
+                    char *scale_end;
+                    operand->scale = (int)strtol(p + 1, &scale_end, 10);
+                    p = scale_end;
+                }
+            }
+            p = x86_skip_space(p, end);
+            if (p >= end || *p != ')') {
+                x86_error(as, "expected ')'");
+                return false;
+            }
+            p++;
+
+            if (operand->index == X86_RIP || operand->index == 4 ||
+                (operand->scale != 1 && operand->scale != 2 && operand->scale != 4 &&
+                 operand->scale != 8) ||
+                (operand->base == X86_RIP && operand->index != X86_NONE)) {
+                x86_error(as, "invalid addressing mode");
+                return false;
+            }
+        }
+    }
+
+    p = x86_skip_space(p, end);
+    if (p < end) {
+        x86_error(as, "junk after operand: '%.*s'", (int)(end - p), p);
+        return false;
+    }
+    return true;
+}
+
+// ========================================
+// Encoding
+// ========================================
+
+static bool x86_fits_int8(int64_t value) {
+    return value >= -128 && value <= 127;
+}
+
+static bool x86_fits_int32(int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+// Byte registers 4-7 mean spl..dil only with a REX prefix (ah..bh without)
+static bool x86_needs_rex_for_byte(const X86Operand *operand) {
+    return operand && operand->kind == X86_OP_REG && operand->size == 1 &&
+           operand->reg >= 4 && operand->reg <= 7;
+}
+
+// Prefixes, opcode and ModRM/SIB/displacement for an instruction whose
+// ModRM.reg is reg_field (a register or an opcode extension) and whose
+// ModRM.rm is rm. imm_size is the size of any immediate that follows, which
+// rip-relative displacements have to account for.
+static void x86_emit_modrm_op(X86Assembler *as, int size, bool default64,
+                              const unsigned char *opcode, int opcode_length,
+                              int reg_field, const X86Operand *reg_operand,
+                              const X86Operand *rm, int imm_size) {
+    if (size == 2) {
+        x86_emit_byte(as, 0x66);
+    }
+
+    unsigned rex = 0;
+    if (size == 8 && !default64) rex |= 0x08;
+    if (reg_field >= 8) rex |= 0x04;
+    if (rm->kind == X86_OP_REG) {
+        if (rm->reg >= 8) rex |= 0x01;
+    } else {
+        if (rm->index != X86_NONE && rm->index >= 8) rex |= 0x02;
+        if (rm->base != X86_NONE && rm->base != X86_RIP && rm->base >= 8) rex |= 0x01;
+    }
+    if (rex || x86_needs_rex_for_byte(reg_operand) || x86_needs_rex_for_byte(rm)) {
+        x86_emit_byte(as, 0x40 | rex);
+    }
+
+    x86_emit_bytes(as, opcode, (size_t)opcode_length);
+
+    unsigned reg_bits = (unsigned)(reg_field & 7) << 3;
+    if (rm->kind == X86_OP_REG) {
+        x86_emit_byte(as, 0xC0 | reg_bits | (unsigned)(rm->reg & 7));
+        return;
+    }
+
+    unsigned scale_bits = rm->scale == 8 ? 3 : rm->scale == 4 ? 2 : rm->scale == 2 ? 1 : 0;
+    unsigned index_bits = rm->index == X86_NONE ? 4 : (unsigned)(rm->index & 7);
+
+    if (rm->base == X86_RIP) {
+        x86_emit_byte(as, reg_bits | 0x05);
+        if (rm->symbol) {
+            x86_emit_fixup(as, X86_FIX_PC32, rm->symbol, rm->value - 4 - imm_size, 4);
+        } else {
+            x86_emit_value(as, (uint64_t)rm->value, 4);
+        }
+        return;
+    }
+
+    if (rm->base == X86_NONE) {
+        // Absolute [disp32] or [index*scale + disp32]
+        x86_emit_byte(as, reg_bits | 0x04);
+        x86_emit_byte(as, (scale_bits << 6) | (index_bits << 3) | 0x05);
+        if (rm->symbol) {
+            x86_emit_fixup(as, X86_FIX_ABS32S, rm->symbol, rm->value, 4);
+        } else {
+            x86_emit_value(as, (uint64_t)rm->value, 4);
+        }
+        return;
+    }
+
+    unsigned base_bits = (unsigned)(rm->base & 7);
+    bool needs_sib = rm->index != X86_NONE || base_bits == 4;
+    unsigned mod;
+    if (rm->symbol || !x86_fits_int8(rm->value)) {
+        mod = 0x80;
+    } else if (rm->value == 0 && base_bits != 5) {
+        mod = 0x00;                  // rbp/r13 have no disp-less form
+    } else {
+        mod = 0x40;
+    }
+
+    x86_emit_byte(as, mod | reg_bits | (needs_sib ? 0x04 : base_bits));
+    if (needs_sib) {
+        x86_emit_byte(as, (scale_bits << 6) | (index_bits << 3) | base_bits);
+    }
+
+    if (mod == 0x40) {
+        x86_emit_byte(as, (unsigned)(rm->value & 0xFF));
+    } else if (mod == 0x80) {
+        if (rm->symbol) {
+            x86_emit_fixup(as, X86_FIX_ABS32S, rm->symbol, rm->value, 4);
+        } else {
+            x86_emit_value(as, (uint64_t)rm->value, 4);
+        }
+    }
+}
+
+static void x86_emit_op1(X86Assembler *as, int size, bool default64, unsigned opcode,
+                         int reg_field, const X86Operand *reg_operand, const X86Operand *rm,
+                         int imm_size) {
+    unsigned char byte = (unsigned char)opcode;
+    x86_emit_modrm_op(as, size, default64, &byte, 1, reg_field, reg_operand, rm, imm_size);
+}
+
+static void x86_emit_op2(X86Assembler *as, int size, unsigned opcode, int reg_field,
+                         const X86Operand *reg_operand, const X86Operand *rm) {
+    unsigned char bytes[2] = {0x0F, (unsigned char)opcode};
+    x86_emit_modrm_op(as, size, false, bytes, 2, reg_field, reg_operand, rm, 0);
+}
+
+// Immediate of imm_size bytes; symbolic ones become fixups
+static void x86_emit_immediate(X86Assembler *as, const X86Operand *imm, int imm_size,
+                               bool sign_extended) {
+    if (imm->symbol) {
+        X86FixupKind kind = imm_size == 8 ? X86_FIX_ABS64
+                          : sign_extended ? X86_FIX_ABS32S : X86_FIX_ABS32;
+        if (imm_size < 4) {
+            x86_error(as, "symbol does not fit in a %d-byte immediate", imm_size);
+            return;
+        }
+        x86_emit_fixup(as, kind, imm->symbol, imm->value, imm_size);
+        return;
+    }
+    x86_emit_value(as, (uint64_t)imm->value, imm_size);
+}
+
+static int x86_imm_size(int size) {
+    return size == 8 ? 4 : size;
+}
+
+static const char *x86_condition_names[16][3] = {
+    {"o", NULL, NULL}, {"no", NULL, NULL}, {"b", "c", "nae"}, {"ae", "nb", "nc"},
+    {"e", "z", NULL}, {"ne", "nz", NULL}, {"be", "na", NULL}, {"a", "nbe", NULL},
+    {"s", NULL, NULL}, {"ns", NULL, NULL}, {"p", "pe", NULL}, {"np", "po", NULL},
+    {"l", "nge", NULL}, {"ge", "nl", NULL}, {"le", "ng", NULL}, {"g", "nle", NULL},
+};
+
+static int x86_condition(const char *text, size_t length) {
+    for (int cc = 0; cc < 16; cc++) {
+        for (int i = 0; i < 3 && x86_condition_names[cc][i]; i++) {
+            if (strlen(x86_condition_names[cc][i]) == length &&
+                memcmp(x86_condition_names[cc][i], text, length) == 0) {
+                return cc;
+            }
+        }
+    }
+    return X86_NONE;
+}
+
+static int x86_suffix_size(char suffix) {
+    switch (suffix) {
+        case 'b': return 1;
+        case 'w': return 2;
+        case 'l': return 4;
+        case 'q': return 8;
+        default:  return 0;
+    }
+}
+
+// Matches "base" or "base" plus a size suffix; *size is 0 without a suffix
+static bool x86_match(const char *mnemonic, const char *base, int *size) {
+    size_t length = strlen(base);
+    if (strncmp(mnemonic, base, length) != 0) return false;
+    if (mnemonic[length] == '\0') {
+        *size = 0;
+        return true;
+    }
+    if (mnemonic[length + 1] == '\0' && x86_suffix_size(mnemonic[length])) {
+        *size = x86_suffix_size(mnemonic[length]);
+        return true;
+    }
+    return false;
+}
+
+// Operand size from the suffix, else from the register operands
+static int x86_operand_size(X86Assembler *as, int suffix_size, const X86Operand *operands,
+                            int count, int fallback) {
+    if (suffix_size) return suffix_size;
+    for (int i = count - 1; i >= 0; i--) {
+        if (operands[i].kind == X86_OP_REG) return operands[i].size;
+    }
+    if (!fallback) {
+        x86_error(as, "operand size is ambiguous; add a size suffix");
+        return 8;
+    }
+    return fallback;
+}
+
+static bool x86_is_reg_or_mem(const X86Operand *operand) {
+    return operand->kind == X86_OP_REG || operand->kind == X86_OP_MEM;
+}
+
+static void x86_encode_branch(X86Assembler *as, const X86Operand *target, int short_opcode,
+                              const unsigned char *near_opcode, int near_length) {
+    X86Section *section = &as->sections[as->current];
+    int symbol = target->symbol ? x86_symbol(as, target->symbol, strlen(target->symbol))
+                                : X86_NONE;
+
+    // Backward branches to a label in this section know their distance now
+    if (short_opcode >= 0 && symbol != X86_NONE &&
+        as->symbols[symbol].section == as->current) {
+        int64_t distance = (int64_t)as->symbols[symbol].offset + target->value -
+                           (int64_t)(section->size + 2);
+        if (x86_fits_int8(distance)) {
+            x86_emit_byte(as, (unsigned)short_opcode);
+            x86_emit_byte(as, (unsigned)(distance & 0xFF));
+            return;
+        }
+    }
+
+    x86_emit_bytes(as, near_opcode, (size_t)near_length);
+    if (symbol == X86_NONE) {
+        x86_error(as, "branch target must be a label");
+        x86_emit_value(as, 0, 4);
+        return;
+    }
+    x86_emit_fixup(as, X86_FIX_BRANCH32, target->symbol, target->value - 4, 4);
+}
+
+// jmp/call and their indirect forms
+static void x86_encode_jump(X86Assembler *as, bool is_call, const X86Operand *target) {
+    if (target->indirect || target->kind == X86_OP_REG) {
+        x86_emit_op1(as, 8, true, 0xFF, is_call ? 2 : 4, NULL, target, 0);
+        return;
+    }
+    if (target->kind != X86_OP_MEM || target->base != X86_NONE || target->index != X86_NONE) {
+        x86_error(as, "invalid %s target", is_call ? "call" : "jmp");
+        return;
+    }
+
+    unsigned char opcode = is_call ? 0xE8 : 0xE9;
+    x86_encode_branch(as, target, is_call ? -1 : 0xEB, &opcode, 1);
+}
+
+// add/or/adc/sbb/and/sub/xor/cmp share one encoding scheme
+static void x86_encode_alu(X86Assembler *as, int group, int size, const X86Operand *src,
+                           const X86Operand *dst) {
+    unsigned byte_op = size == 1 ? 0 : 1;
+
+    if (src->kind == X86_OP_IMM && x86_is_reg_or_mem(dst)) {
+        if (size == 1) {
+            x86_emit_op1(as, size, false, 0x80, group, NULL, dst, 1);
+            x86_emit_immediate(as, src, 1, false);
+        } else if (!src->symbol && x86_fits_int8(src->value)) {
+            x86_emit_op1(as, size, false, 0x83, group, NULL, dst, 1);
+            x86_emit_value(as, (uint64_t)src->value, 1);
+        } else {
+            int imm_size = x86_imm_size(size);
+            x86_emit_op1(as, size, false, 0x81, group, NULL, dst, imm_size);
+            x86_emit_immediate(as, src, imm_size, true);
+        }
+    } else if (src->kind == X86_OP_REG && x86_is_reg_or_mem(dst)) {
+        x86_emit_op1(as, size, false, (unsigned)(group * 8) + byte_op, src->reg, src, dst, 0);
+    } else if (src->kind == X86_OP_MEM && dst->kind == X86_OP_REG) {
+        x86_emit_op1(as, size, false, (unsigned)(group * 8) + 2 + byte_op, dst->reg, dst, src, 0);
+    } else {
+        x86_error(as, "invalid operands");
+    }
+}
+
+static void x86_encode_mov(X86Assembler *as, int size, const X86Operand *src,
+                           const X86Operand *dst, bool force_64bit_immediate) {
+    unsigned byte_op = size == 1 ? 0 : 1;
+
+    if (src->kind == X86_OP_IMM && dst->kind == X86_OP_REG) {
+        bool fits = src->symbol ? true : x86_fits_int32(src->value);
+        if (size == 8 && (force_64bit_immediate || !fits)) {
+            // movabs $imm64, %reg
+            x86_emit_byte(as, 0x48 | (dst->reg >= 8 ? 1 : 0));
+            x86_emit_byte(as, 0xB8 + (unsigned)(dst->reg & 7));
+            x86_emit_immediate(as, src, 8, false);
+        } else if (size == 8) {
+            x86_emit_op1(as, size, false, 0xC7, 0, NULL, dst, 4);
+            x86_emit_immediate(as, src, 4, true);
+        } else {
+            if (size == 2) x86_emit_byte(as, 0x66);
+            if (dst->reg >= 8 || x86_needs_rex_for_byte(dst)) {
+                x86_emit_byte(as, 0x40 | (dst->reg >= 8 ? 1 : 0));
+            }
+            x86_emit_byte(as, (size == 1 ? 0xB0 : 0xB8) + (unsigned)(dst->reg & 7));
+            x86_emit_immediate(as, src, size, false);
+        }
+    } else if (src->kind == X86_OP_IMM && dst->kind == X86_OP_MEM) {
+        int imm_size = x86_imm_size(size);
+        x86_emit_op1(as, size, false, size == 1 ? 0xC6 : 0xC7, 0, NULL, dst, imm_size);
+        x86_emit_immediate(as, src, imm_size, true);
+    } else if (src->kind == X86_OP_REG && x86_is_reg_or_mem(dst)) {
+        x86_emit_op1(as, size, false, 0x88 + byte_op, src->reg, src, dst, 0);
+    } else if (src->kind == X86_OP_MEM && dst->kind == X86_OP_REG) {
+        x86_emit_op1(as, size, false, 0x8A + byte_op, dst->reg, dst, src, 0);
+    } else {
+        x86_error(as, "invalid operands");
+    }
+}
+
+// Group 2 shifts and rotates: $imm, %cl or an implied count of 1
+static void x86_encode_shift(X86Assembler *as, int extension, int size,
+                             const X86Operand *operands, int count) {
+    const X86Operand *dst = &operands[count - 1];
+    unsigned byte_op = size == 1 ? 0 : 1;
+
+    if (count == 1 || (operands[0].kind == X86_OP_IMM && !operands[0].symbol &&
+                       operands[0].value == 1)) {
+        x86_emit_op1(as, size, false, 0xD0 + byte_op, extension, NULL, dst, 0);
+    } else if (operands[0].kind == X86_OP_IMM) {
+        x86_emit_op1(as, size, false, 0xC0 + byte_op, extension, NULL, dst, 1);
+        x86_emit_value(as, (uint64_t)operands[0].value, 1);
+    } else if (operands[0].kind == X86_OP_REG && operands[0].reg == 1 && operands[0].size == 1) {
+        x86_emit_op1(as, size, false, 0xD2 + byte_op, extension, NULL, dst, 0);
+    } else {
+        x86_error(as, "shift count must be an immediate or %%cl");
+    }
+}
+
+// Base names, for decoding text, printing and error messages
+static const char *const x86_mnemonics[X86_OPCODE_COUNT] = {
+    "add", "or", "adc", "sbb", "and", "sub", "xor", "cmp",
+    "mov", "movabs", "movzx", "movsx", "lea", "test", "imul",
+    "not", "neg", "mul", "div", "idiv", "inc", "dec",
+    "rol", "ror", "shl", "shr", "sar",
+    "push", "pop", "jmp", "call", "jcc", "setcc", "cmovcc",
+    "ret", "leave", "syscall", "nop", "hlt", "int3", "ud2", "cqto", "cltq", "cltd",
+};
+
+typedef struct X86Fixed {
+    X86Opcode opcode;
+    unsigned char bytes[3];
+    int length;
+} X86Fixed;
+
+static const X86Fixed x86_fixed[] = {
+    {X86_RET, {0xC3}, 1}, {X86_LEAVE, {0xC9}, 1}, {X86_SYSCALL, {0x0F, 0x05}, 2},
+    {X86_NOP, {0x90}, 1}, {X86_HLT, {0xF4}, 1}, {X86_INT3, {0xCC}, 1},
+    {X86_UD2, {0x0F, 0x0B}, 2}, {X86_CQTO, {0x48, 0x99}, 2}, {X86_CLTQ, {0x48, 0x98}, 2},
+    {X86_CLTD, {0x99}, 1},
+};
+
+// Group 3 (F6/F7) and group 4/5 (FE/FF) single-operand instructions
+static const struct { X86Opcode opcode; unsigned byte; int extension; } x86_unary[] = {
+    {X86_NOT, 0xF6, 2}, {X86_NEG, 0xF6, 3}, {X86_MUL, 0xF6, 4}, {X86_IMUL, 0xF6, 5},
+    {X86_DIV, 0xF6, 6}, {X86_IDIV, 0xF6, 7}, {X86_INC, 0xFE, 0}, {X86_DEC, 0xFE, 1},
+};
+
+static const struct { X86Opcode opcode; int extension; } x86_shifts[] = {
+    {X86_ROL, 0}, {X86_ROR, 1}, {X86_SHL, 4}, {X86_SHR, 5}, {X86_SAR, 7},
+};
+
+static void x86_encode_unary(X86Assembler *as, const X86Instruction *instruction) {
+    const X86Operand *operands = instruction->operands;
+    const char *name = x86_mnemonics[instruction->opcode];
+
+    for (size_t i = 0; i < sizeof(x86_unary) / sizeof(x86_unary[0]); i++) {
+        if (x86_unary[i].opcode != instruction->opcode) continue;
+
+        if (instruction->operand_count != 1 || !x86_is_reg_or_mem(&operands[0])) {
+            x86_error(as, "'%s' takes one register or memory operand", name);
+            return;
+        }
+        int size = x86_operand_size(as, instruction->size, operands, 1, 0);
+        x86_emit_op1(as, size, false, x86_unary[i].byte + (size == 1 ? 0 : 1),
+                     x86_unary[i].extension, NULL, &operands[0], 0);
+        return;
+    }
+}
+
+static void x86_encode_imul(X86Assembler *as, const X86Instruction *instruction) {
+    const X86Operand *operands = instruction->operands;
+    int count = instruction->operand_count;
+    if (count < 2) {
+        x86_encode_unary(as, instruction);
+        return;
+    }
+
+    const X86Operand *dst = &operands[count - 1];
+    if (dst->kind != X86_OP_REG) {
+        x86_error(as, "imul needs a register destination");
+        return;
+    }
+    int size = x86_operand_size(as, instruction->size, operands, count, 0);
+    if (operands[0].kind == X86_OP_IMM) {
+        // imul $imm, src, dst (src defaults to dst)
+        const X86Operand *src = count == 3 ? &operands[1] : dst;
+        bool short_form = !operands[0].symbol && x86_fits_int8(operands[0].value);
+        int imm_size = short_form ? 1 : x86_imm_size(size);
+        x86_emit_op1(as, size, false, short_form ? 0x6B : 0x69, dst->reg, dst, src, imm_size);
+        x86_emit_immediate(as, &operands[0], imm_size, true);
+    } else if (count == 2) {
+        x86_emit_op2(as, size, 0xAF, dst->reg, dst, &operands[0]);
+    } else {
+        x86_error(as, "invalid operands to imul");
+    }
+}
+
+static void x86_encode_extend(X86Assembler *as, const X86Instruction *instruction) {
+    const X86Operand *operands = instruction->operands;
+    bool sign = instruction->opcode == X86_MOVSX;
+    if (instruction->operand_count != 2 || operands[1].kind != X86_OP_REG ||
+        !x86_is_reg_or_mem(&operands[0])) {
+        x86_error(as, "invalid operands to '%s'", x86_mnemonics[instruction->opcode]);
+        return;
+    }
+
+    int from = instruction->source_size ? instruction->source_size
+             : operands[0].kind == X86_OP_REG ? operands[0].size : 0;
+    int to = instruction->size ? instruction->size : operands[1].size;
+    if (from == 4 && sign && to == 8) {
+        x86_emit_op1(as, to, false, 0x63, operands[1].reg, &operands[1], &operands[0], 0);
+    } else if ((from == 1 || from == 2) && to > from) {
+        unsigned opcode = (sign ? 0xBE : 0xB6) + (from == 2 ? 1 : 0);
+        x86_emit_op2(as, to, opcode, operands[1].reg, &operands[1], &operands[0]);
+    } else {
+        x86_error(as, "invalid operands to '%s'", x86_mnemonics[instruction->opcode]);
+    }
+}
+
+static void x86_encode_stack(X86Assembler *as, const X86Instruction *instruction) {
+    bool push = instruction->opcode == X86_PUSH;
+    const char *name = x86_mnemonics[instruction->opcode];
+    if (instruction->operand_count != 1) {
+        x86_error(as, "'%s' takes one operand", name);
+        return;
+    }
+
+    const X86Operand *operand = &instruction->operands[0];
+    if (operand->kind == X86_OP_REG) {
+        if (operand->size != 8) {
+            x86_error(as, "'%s' needs a 64-bit register", name);
+            return;
+        }
+        if (operand->reg >= 8) x86_emit_byte(as, 0x41);
+        x86_emit_byte(as, (push ? 0x50 : 0x58) + (unsigned)(operand->reg & 7));
+    } else if (operand->kind == X86_OP_IMM && push) {
+        if (!operand->symbol && x86_fits_int8(operand->value)) {
+            x86_emit_byte(as, 0x6A);
+            x86_emit_value(as, (uint64_t)operand->value, 1);
+        } else {
+            x86_emit_byte(as, 0x68);
+            x86_emit_immediate(as, operand, 4, true);
+        }
+    } else if (operand->kind == X86_OP_MEM) {
+        x86_emit_op1(as, 8, true, push ? 0xFF : 0x8F, push ? 6 : 0, NULL, operand, 0);
+    } else {
+        x86_error(as, "invalid operand to '%s'", name);
+    }
+}
+
+static void x86_encode(X86Assembler *as, const X86Instruction *instruction) {
+    const X86Operand *operands = instruction->operands;
+    int count = instruction->operand_count;
+    X86Opcode opcode = instruction->opcode;
+    const char *name = (unsigned)opcode < X86_OPCODE_COUNT ? x86_mnemonics[opcode] : "?";
+    int cc = (int)instruction->condition;
+    int size;
+
+    if (opcode <= X86_CMP) {
+        if (count != 2) {
+            x86_error(as, "'%s' takes two operands", name);
+            return;
+        }
+        size = x86_operand_size(as, instruction->size, operands, count, 0);
+        x86_encode_alu(as, (int)opcode, size, &operands[0], &operands[1]);
+        return;
+    }
+
+    switch (opcode) {
+        case X86_MOV:
+            if (count != 2) {
+                x86_error(as, "mov takes two operands");
+                return;
+            }
+            size = x86_operand_size(as, instruction->size, operands, count, 0);
+            x86_encode_mov(as, size, &operands[0], &operands[1], false);
+            return;
+
+        case X86_MOVABS:
+            if (count != 2 || operands[0].kind != X86_OP_IMM || operands[1].kind != X86_OP_REG ||
+                operands[1].size != 8) {
+                x86_error(as, "movabs takes an immediate and a 64-bit register");
+                return;
+            }
+            x86_encode_mov(as, 8, &operands[0], &operands[1], true);
+            return;
+
+        case X86_MOVZX:
+        case X86_MOVSX:
+            x86_encode_extend(as, instruction);
+            return;
+
+        case X86_LEA:
+            if (count != 2 || operands[0].kind != X86_OP_MEM || operands[1].kind != X86_OP_REG) {
+                x86_error(as, "lea takes a memory operand and a register");
+                return;
+            }
+            size = x86_operand_size(as, instruction->size, operands, count, 0);
+            x86_emit_op1(as, size, false, 0x8D, operands[1].reg, &operands[1], &operands[0], 0);
+            return;
+
+        case X86_TEST:
+            if (count != 2 || !x86_is_reg_or_mem(&operands[1])) {
+                x86_error(as, "invalid operands to test");
+                return;
+            }
+            size = x86_operand_size(as, instruction->size, operands, count, 0);
+            if (operands[0].kind == X86_OP_IMM) {
+                int imm_size = x86_imm_size(size);
+                x86_emit_op1(as, size, false, size == 1 ? 0xF6 : 0xF7, 0, NULL, &operands[1],
+                             imm_size);
+                x86_emit_immediate(as, &operands[0], imm_size, true);
+            } else if (operands[0].kind == X86_OP_REG) {
+                x86_emit_op1(as, size, false, size == 1 ? 0x84 : 0x85, operands[0].reg,
+                             &operands[0], &operands[1], 0);
+            } else {
+                x86_error(as, "invalid operands to test");
+            }
+            return;
+
+        case X86_IMUL:
+            x86_encode_imul(as, instruction);
+            return;
+
+        case X86_NOT: case X86_NEG: case X86_MUL: case X86_DIV: case X86_IDIV:
+        case X86_INC: case X86_DEC:
+            x86_encode_unary(as, instruction);
+            return;
+
+        case X86_ROL: case X86_ROR: case X86_SHL: case X86_SHR: case X86_SAR:
+            if (count < 1 || count > 2 || !x86_is_reg_or_mem(&operands[count - 1])) {
+                x86_error(as, "invalid operands to '%s'", name);
+                return;
+            }
+            size = x86_operand_size(as, instruction->size, &operands[count - 1], 1, 0);
+            for (size_t i = 0; i < sizeof(x86_shifts) / sizeof(x86_shifts[0]); i++) {
+                if (x86_shifts[i].opcode == opcode) {
+                    x86_encode_shift(as, x86_shifts[i].extension, size, operands, count);
+                }
+            }
+            return;
+
+        case X86_PUSH:
+        case X86_POP:
+            x86_encode_stack(as, instruction);
+            return;
+
+        case X86_JMP:
+        case X86_CALL:
+            if (count != 1) {
+                x86_error(as, "'%s' takes one operand", name);
+                return;
+            }
+            x86_encode_jump(as, opcode == X86_CALL, &operands[0]);
+            return;
+
+        case X86_JCC: {
+            if (count != 1 || operands[0].kind != X86_OP_MEM) {
+                x86_error(as, "'j%s' takes a label", x86_condition_names[cc & 15][0]);
+                return;
+            }
+            unsigned char near[2] = {0x0F, (unsigned char)(0x80 + cc)};
+            x86_encode_branch(as, &operands[0], 0x70 + cc, near, 2);
+            return;
+        }
+
+        case X86_SETCC:
+            if (count != 1 || !x86_is_reg_or_mem(&operands[0]) ||
+                (operands[0].kind == X86_OP_REG && operands[0].size != 1)) {
+                x86_error(as, "'set%s' takes a byte register or memory operand",
+                          x86_condition_names[cc & 15][0]);
+                return;
+            }
+            x86_emit_op2(as, 1, 0x90 + (unsigned)cc, 0, NULL, &operands[0]);
+            return;
+
+        case X86_CMOVCC:
+            if (count != 2 || operands[1].kind != X86_OP_REG || !x86_is_reg_or_mem(&operands[0])) {
+                x86_error(as, "invalid operands to 'cmov%s'", x86_condition_names[cc & 15][0]);
+                return;
+            }
+            size = x86_operand_size(as, instruction->size, operands, count, 0);
+            x86_emit_op2(as, size, 0x40 + (unsigned)cc, operands[1].reg, &operands[1], &operands[0]);
+            return;
+
+        default:
+            break;
+    }
+
+    for (size_t i = 0; i < sizeof(x86_fixed) / sizeof(x86_fixed[0]); i++) {
+        if (x86_fixed[i].opcode == opcode) {
+            if (count != 0) x86_error(as, "'%s' takes no operands", name);
+            x86_emit_bytes(as, x86_fixed[i].bytes, (size_t)x86_fixed[i].length);
+            return;
+        }
+    }
+    x86_error(as, "unknown opcode %d", (int)opcode);
+}
+
+// ========================================
+// Mnemonics
+// ========================================
+
+static const struct { const char *name; X86Opcode opcode; } x86_fixed_names[] = {
+    {"ret", X86_RET}, {"retq", X86_RET}, {"leave", X86_LEAVE}, {"leaveq", X86_LEAVE},
+    {"syscall", X86_SYSCALL}, {"nop", X86_NOP}, {"hlt", X86_HLT}, {"int3", X86_INT3},
+    {"ud2", X86_UD2}, {"cqto", X86_CQTO}, {"cqo", X86_CQTO}, {"cltq", X86_CLTQ},
+    {"cdqe", X86_CLTQ}, {"cltd", X86_CLTD}, {"cdq", X86_CLTD},
+};
+
+// Opcode, size suffix and condition code of an AT&T mnemonic
+static bool x86_decode_mnemonic(const char *mnemonic, X86Instruction *instruction) {
+    size_t length = strlen(mnemonic);
+    int size = 0;
+
+    for (size_t i = 0; i < sizeof(x86_fixed_names) / sizeof(x86_fixed_names[0]); i++) {
+        if (strcmp(mnemonic, x86_fixed_names[i].name) == 0) {
+            instruction->opcode = x86_fixed_names[i].opcode;
+            return true;
+        }
+    }
+
+    // jcc
+    if (mnemonic[0] == 'j' && length > 1) {
+        int cc = x86_condition(mnemonic + 1, length - 1);
+        if (cc != X86_NONE) {
+            instruction->opcode = X86_JCC;
+            instruction->condition = (X86Condition)cc;
+            return true;
+        }
+    }
+
+    // setcc, optionally with a b suffix
+    if (strncmp(mnemonic, "set", 3) == 0) {
+        size_t cc_length = length - 3;
+        int cc = x86_condition(mnemonic + 3, cc_length);
+        if (cc == X86_NONE && cc_length > 1 && mnemonic[length - 1] == 'b') {
+            cc = x86_condition(mnemonic + 3, cc_length - 1);
+        }
+        if (cc != X86_NONE) {
+            instruction->opcode = X86_SETCC;
+            instruction->condition = (X86Condition)cc;
+            return true;
+        }
+    }
+
+    // cmovcc, optionally with a size suffix
+    if (strncmp(mnemonic, "cmov", 4) == 0) {
+        size_t cc_length = length - 4;
+        int cc = x86_condition(mnemonic + 4, cc_length);
+        if (cc == X86_NONE && cc_length > 1 && x86_suffix_size(mnemonic[length - 1])) {
+            cc = x86_condition(mnemonic + 4, cc_length - 1);
+            size = x86_suffix_size(mnemonic[length - 1]);
+        }
+        if (cc != X86_NONE) {
+            instruction->opcode = X86_CMOVCC;
+            instruction->condition = (X86Condition)cc;
+            instruction->size = size;
+            return true;
+        }
+    }
+
+    // movzx/movsx: movz{b,w}{w,l,q}, movs{b,w}{w,l,q}, movslq
+    if (length == 6 && (strncmp(mnemonic, "movz", 4) == 0 || strncmp(mnemonic, "movs", 4) == 0)) {
+        int from = x86_suffix_size(mnemonic[4]);
+        int to = x86_suffix_size(mnemonic[5]);
+        if (from && to > from) {
+            instruction->opcode = mnemonic[3] == 's' ? X86_MOVSX : X86_MOVZX;
+            instruction->source_size = from;
+            instruction->size = to;
+            return true;
+        }
+    }
+
+    // Everything else is a base name with an optional size suffix
+    if (x86_match(mnemonic, "sal", &size)) {
+        instruction->opcode = X86_SHL;
+        instruction->size = size;
+        return true;
+    }
+    for (int opcode = 0; opcode < X86_JCC; opcode++) {
+        if (opcode != X86_MOVZX && opcode != X86_MOVSX &&
+            x86_match(mnemonic, x86_mnemonics[opcode], &size)) {
+            instruction->opcode = (X86Opcode)opcode;
+            instruction->size = size;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ========================================
+// Printing
+// ========================================
+
+static char x86_size_suffix(int size) {
+    switch (size) {
+        case 1: return 'b';
+        case 2: return 'w';
+        case 4: return 'l';
+        case 8: return 'q';
+        default: return '\0';
+    }
+}
+
+static void x86_format_value(AsmBuffer *out, const X86Operand *operand) {
+    if (!operand->symbol) {
+        asm_buffer_int(out, operand->value);
+        return;
+    }
+    asm_buffer_puts(out, operand->symbol);
+    if (operand->value > 0) asm_buffer_putc(out, '+');
+    if (operand->value != 0) asm_buffer_int(out, operand->value);
+}
+
+static void x86_format_register(AsmBuffer *out, int number, int size) {
+    int width = x86_width_index(size);
+    const char *name = number >= 0 && number <= X86_RIP && width >= 0
+                       ? x86_register_names[number][width] : NULL;
+    asm_buffer_putc(out, '%');
+    asm_buffer_puts(out, name ? name : "?");
+}
+
+static void x86_format_operand(AsmBuffer *out, const X86Operand *operand) {
+    if (operand->indirect) asm_buffer_putc(out, '*');
+
+    switch (operand->kind) {
+        case X86_OP_REG:
+            x86_format_register(out, operand->reg, operand->size);
+            break;
+        case X86_OP_IMM:
+            asm_buffer_putc(out, '$');
+            x86_format_value(out, operand);
+            break;
+        case X86_OP_MEM:
+            if (operand->symbol || operand->value != 0 ||
+                (operand->base == X86_NONE && operand->index == X86_NONE)) {
+                x86_format_value(out, operand);
+            }
+            if (operand->base != X86_NONE || operand->index != X86_NONE) {
+                asm_buffer_putc(out, '(');
+                if (operand->base != X86_NONE) x86_format_register(out, operand->base, 8);
+                if (operand->index != X86_NONE) {
+                    asm_buffer_putc(out, ',');
+                    x86_format_register(out, operand->index, 8);
+                    asm_buffer_putc(out, ',');
+                    asm_buffer_int(out, operand->scale);
+                }
+                asm_buffer_putc(out, ')');
+            }
+            break;
+    }
+}
+
+void x86_asm_format(AsmBuffer *out, const X86Instruction *instruction) {
+    // The mnemonic is a base name, a condition code and up to two size
+    // suffixes, written straight into the buffer
+    X86Opcode opcode = instruction->opcode;
+    const char *base = x86_mnemonics[opcode];
+    const char *cc = "";
+    char source_suffix = '\0';
+    char suffix = '\0';
+
+    switch (opcode) {
+        case X86_JCC:
+        case X86_SETCC:
+        case X86_CMOVCC:
+            base = opcode == X86_JCC ? "j" : opcode == X86_SETCC ? "set" : "cmov";
+            cc = x86_condition_names[instruction->condition & 15][0];
+            if (opcode == X86_CMOVCC) suffix = x86_size_suffix(instruction->size);
+            break;
+        case X86_MOVZX:
+        case X86_MOVSX:
+            base = opcode == X86_MOVSX ? "movs" : "movz";
+            source_suffix = x86_size_suffix(instruction->source_size);
+            suffix = x86_size_suffix(instruction->size);
+            break;
+        case X86_PUSH:
+        case X86_POP:
+        case X86_CALL:
+            suffix = 'q';
+            break;
+        default:
+            if (opcode < X86_PUSH) suffix = x86_size_suffix(instruction->size);
+            break;
+    }
+
+    asm_buffer_puts(out, base);
+    asm_buffer_puts(out, cc);
+    size_t length = strlen(base) + strlen(cc);
+    if (source_suffix) {
+        asm_buffer_putc(out, source_suffix);
+        length++;
+    }
+    if (suffix) {
+        asm_buffer_putc(out, suffix);
+        length++;
+    }
+    if (instruction->operand_count == 0) return;
+
+    for (; length < 8; length++) {
+        asm_buffer_putc(out, ' ');
+    }
+    for (int i = 0; i < instruction->operand_count; i++) {
+        if (i > 0) asm_buffer_puts(out, ", ");
+        x86_format_operand(out, &instruction->operands[i]);
+    }
+}
+
+// ========================================
+// Directives
+// ========================================
+
+static void x86_align(X86Assembler *as, uint64_t alignment) {
+    if (alignment == 0 || (alignment & (alignment - 1))) {
+        x86_error(as, "alignment must be a power of two");
+        return;
+    }
+
+    X86Section *section = &as->sections[as->current];
+    if (alignment > section->alignment) {
+        section->alignment = alignment;
+    }
+
+    unsigned fill = (section->flags & ELF_SHF_EXECINSTR) ? 0x90 : 0x00;
+    while (section->size % alignment) {
+        if (section->type == ELF_SHT_NOBITS) {
+            section->size++;
+        } else {
+            x86_emit_byte(as, fill);
+        }
+    }
+}
+
+// Maps ELF and Mach-O section names onto an ELF section
+static void x86_switch_section(X86Assembler *as, const char *name, size_t length) {
+    static const struct { const char *from; const char *to; } aliases[] = {
+        {"__TEXT,__text", ".text"}, {"__TEXT,__cstring", ".rodata"},
+        {"__TEXT,__const", ".rodata"}, {"__DATA,__data", ".data"},
+        {"__DATA,__const", ".data"}, {"__DATA,__bss", ".bss"},
+    };
+
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*s", (int)length, name);
+    for (size_t i = 0; i < sizeof(aliases) / sizeof(aliases[0]); i++) {
+        size_t alias_length = strlen(aliases[i].from);
+        if (strncmp(buffer, aliases[i].from, alias_length) == 0 &&
+            (buffer[alias_length] == '\0' || buffer[alias_length] == ',')) {
+            snprintf(buffer, sizeof(buffer), "%s", aliases[i].to);
+            break;
+        }
+    }
+
+    // Drop any ELF flags/type arguments: .section name, "flags", @type
+    char *comma = strchr(buffer, ',');
+    if (comma) *comma = '\0';
+
+    uint32_t type = ELF_SHT_PROGBITS;
+    uint64_t flags = ELF_SHF_ALLOC;
+    if (strncmp(buffer, ".text", 5) == 0) {
+        flags |= ELF_SHF_EXECINSTR;
+    } else if (strncmp(buffer, ".bss", 4) == 0) {
+        type = ELF_SHT_NOBITS;
+        flags |= ELF_SHF_WRITE;
+    } else if (strncmp(buffer, ".data", 5) == 0) {
+        flags |= ELF_SHF_WRITE;
+    }
+    as->current = x86_section(as, buffer, type, flags);
+}
+
+static size_t x86_parse_string(X86Assembler *as, const char **cursor, const char *end,
+                               char *out, size_t capacity) {
+    const char *p = x86_skip_space(*cursor, end);
+    size_t length = 0;
+    if (p >= end || *p != '"') {
+        x86_error(as, "expected a string");
+        return 0;
+    }
+    p++;
+
+    while (p < end && *p != '"') {
+        char c = *p++;
+        if (c == '\\' && p < end) {
+            c = *p++;
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case 'a': c = '\a'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'v': c = '\v'; break;
+                case 'x': {
+                    unsigned value = 0;
+                    while (p < end && isxdigit((unsigned char)*p)) {
+                        value = value * 16 + (unsigned)(isdigit((unsigned char)*p) ? *p - '0'
+                                                        : (tolower((unsigned char)*p) - 'a' + 10));
+                        p++;
+                    }
+                    c = (char)value;
+                    break;
+                }
+                default:
+                    if (c >= '0' && c <= '7') {
+                        unsigned value = (unsigned)(c - '0');
+                        for (int i = 0; i < 2 && p < end && *p >= '0' && *p <= '7'; i++) {
+                            value = value * 8 + (unsigned)(*p++ - '0');
+                        }
+                        c = (char)value;
+                    }
+                    break;
+            }
+        }
+        if (length < capacity) out[length] = c;
+        length++;
+    }
+
+    if (p >= end) {
+        x86_error(as, "unterminated string");
+        return 0;
+    }
+    *cursor = p + 1;
+    return length;
+}
+
+static void x86_data(X86Assembler *as, int size, const char *p, const char *end) {
+    while (p < end) {
+        int64_t value;
+        const char *symbol;
+        if (!x86_parse_expression(as, &p, end, &value, &symbol)) return;
+
+        if (symbol) {
+            if (size < 4) {
+                x86_error(as, "symbol does not fit in %d bytes", size);
+                return;
+            }
+            x86_emit_fixup(as, size == 8 ? X86_FIX_ABS64 : X86_FIX_ABS32, symbol, value, size);
+        } else {
+            x86_emit_value(as, (uint64_t)value, size);
+        }
+
+        p = x86_skip_space(p, end);
+        if (p < end && *p == ',') p++;
+    }
+}
+
+static void x86_directive(X86Assembler *as, const char *name, size_t name_length,
+                          const char *p, const char *end) {
+#define X86_IS(text) (name_length == sizeof(text) - 1 && memcmp(name, text, name_length) == 0)
+    p = x86_skip_space(p, end);
+
+    if (X86_IS(".text") || X86_IS(".data") || X86_IS(".bss") || X86_IS(".rodata")) {
+        x86_switch_section(as, name, name_length);
+    } else if (X86_IS(".section")) {
+        const char *start = p;
+        while (p < end && *p != ' ' && *p != '\t') p++;
+        x86_switch_section(as, start, (size_t)(p - start));
+    } else if (X86_IS(".globl") || X86_IS(".global")) {
+        while (p < end) {
+            const char *start = p;
+            while (p < end && x86_is_symbol_char(*p)) p++;
+            if (p == start) {
+                x86_error(as, "expected a symbol name");
+                return;
+            }
+            int symbol = x86_symbol(as, start, (size_t)(p - start));
+            if (symbol != X86_NONE) as->symbols[symbol].global = true;
+            p = x86_skip_space(p, end);
+            if (p < end && *p == ',') p = x86_skip_space(p + 1, end);
+        }
+    } else if (X86_IS(".p2align") || X86_IS(".align") || X86_IS(".balign")) {
+        long value = strtol(p, NULL, 0);
+        x86_align(as, X86_IS(".p2align") ? (uint64_t)1 << value : (uint64_t)value);
+    } else if (X86_IS(".byte")) {
+        x86_data(as, 1, p, end);
+    } else if (X86_IS(".short") || X86_IS(".word") || X86_IS(".value") || X86_IS(".2byte")) {
+        x86_data(as, 2, p, end);
+    } else if (X86_IS(".long") || X86_IS(".int") || X86_IS(".4byte")) {
+        x86_data(as, 4, p, end);
+    } else if (X86_IS(".quad") || X86_IS(".8byte")) {
+        x86_data(as, 8, p, end);
+    } else if (X86_IS(".ascii") || X86_IS(".asciz") || X86_IS(".string")) {
+        bool terminate = !X86_IS(".ascii");
+        while (p < end) {
+            char stack_buffer[256];
+            const char *start = p;
+            size_t length = x86_parse_string(as, &p, end, stack_buffer, sizeof(stack_buffer));
+            if (length > sizeof(stack_buffer)) {
+                char *buffer = malloc(length);
+                if (!buffer) {
+                    error_fatal("Memory allocation failed for assembler string");
+                    return;
+                }
+                p = start;
+                x86_parse_string(as, &p, end, buffer, length);
+                x86_emit_bytes(as, buffer, length);
+                free(buffer);
+            } else if (p != start) {
+                x86_emit_bytes(as, stack_buffer, length);
+            } else {
+                return;
+            }
+            if (terminate) x86_emit_byte(as, 0);
+            p = x86_skip_space(p, end);
+            if (p < end && *p == ',') p++;
+        }
+    } else if (X86_IS(".zero") || X86_IS(".space") || X86_IS(".skip")) {
+        char *cursor;
+        long count = strtol(p, &cursor, 0);
+        cursor = (char *)x86_skip_space(cursor, end);
+        unsigned fill = (cursor < end && *cursor == ',') ? (unsigned)strtol(cursor + 1, NULL, 0) : 0;
+        X86Section *section = &as->sections[as->current];
+        for (long i = 0; i < count; i++) {
+            if (section->type == ELF_SHT_NOBITS) {
+                section->size++;
+            } else {
+                x86_emit_byte(as, fill);
+            }
+        }
+    } else if (X86_IS(".type") || X86_IS(".size") || X86_IS(".file") || X86_IS(".ident") ||
+               X86_IS(".local") || X86_IS(".hidden") || X86_IS(".build_version") ||
+               X86_IS(".macosx_version_min") || X86_IS(".subsections_via_symbols") ||
+               (name_length > 5 && memcmp(name, ".cfi_", 5) == 0)) {
+        // Only meaningful to other object formats or debuggers
+    } else {
+        x86_error(as, "unsupported directive '%.*s'", (int)name_length, name);
+    }
+#undef X86_IS
+}
+
+// ========================================
+// Lines
+// ========================================
+
+// Splits operands on top-level commas
+static int x86_split_operands(X86Assembler *as, const char *p, const char *end,
+                              X86Operand *operands, int capacity) {
+    int count = 0;
+    p = x86_skip_space(p, end);
+    while (p < end) {
+        const char *start = p;
+        int depth = 0;
+        while (p < end && (depth > 0 || *p != ',')) {
+            if (*p == '(') depth++;
+            if (*p == ')') depth--;
+            p++;
+        }
+        if (count == capacity) {
+            x86_error(as, "too many operands");
+            return -1;
+        }
+        if (!x86_parse_operand(as, start, p, &operands[count++])) {
+            return -1;
+        }
+        if (p < end) p++;
+    }
+    return count;
+}
+
+static void x86_statement(X86Assembler *as, const char *p, const char *end) {
+    p = x86_skip_space(p, end);
+    while (end > p && isspace((unsigned char)end[-1])) end--;
+
+    // Any number of labels
+    while (p < end) {
+        const char *start = p;
+        while (p < end && x86_is_symbol_char(*p)) p++;
+        if (p > start && p < end && *p == ':') {
+            x86_define_label(as, start, (size_t)(p - start));
+            p = x86_skip_space(p + 1, end);
+        } else {
+            p = start;
+            break;
+        }
+    }
+    if (p >= end) return;
+
+    const char *name = p;
+    while (p < end && !isspace((unsigned char)*p)) p++;
+    size_t name_length = (size_t)(p - name);
+
+    if (name[0] == '.') {
+        x86_directive(as, name, name_length, p, end);
+        return;
+    }
+
+    char mnemonic[32];
+    if (name_length >= sizeof(mnemonic)) {
+        x86_error(as, "unknown instruction '%.*s'", (int)name_length, name);
+        return;
+    }
+    for (size_t i = 0; i < name_length; i++) {
+        mnemonic[i] = (char)tolower((unsigned char)name[i]);
+    }
+    mnemonic[name_length] = '\0';
+
+    X86Instruction instruction = {0};
+    if (!x86_decode_mnemonic(mnemonic, &instruction)) {
+        x86_error(as, "unknown instruction '%s'", mnemonic);
+        return;
+    }
+    int count = x86_split_operands(as, p, end, instruction.operands, 3);
+    if (count >= 0) {
+        instruction.operand_count = count;
+        x86_encode(as, &instruction);
+    }
+}
+
+// Strips comments and splits on ';' outside strings
+static void x86_line(X86Assembler *as, const char *line, const char *end) {
+    const char *p = x86_skip_space(line, end);
+    if (end - p >= 2 && p[0] == '/' && p[1] == '/') return;
+
+    const char *statement = p;
+    bool in_string = false;
+    while (p < end) {
+        char c = *p;
+        if (in_string) {
+            if (c == '\\' && p + 1 < end) p++;
+            else if (c == '"') in_string = false;
+        } else if (c == '"') {
+            in_string = true;
+        } else if (c == '#') {
+            break;
+        } else if (c == '/' && p + 1 < end && p[1] == '*') {
+            // /* comment */ within the line
+            x86_statement(as, statement, p);
+            const char *close = p + 2;
+            while (close + 1 < end && !(close[0] == '*' && close[1] == '/')) close++;
+            p = close + 1 < end ? close + 2 : end;
+            statement = p;
+            continue;
+        } else if (c == ';') {
+            x86_statement(as, statement, p);
+            statement = p + 1;
+        }
+        p++;
+    }
+    x86_statement(as, statement, p);
+}
+
+X86Assembler *x86_asm_create(void) {
+    X86Assembler *as = calloc(1, sizeof(X86Assembler));
+    if (!as) {
+        error_fatal("Memory allocation failed for assembler");
+        return NULL;
+    }
+    as->current = x86_section(as, ".text", ELF_SHT_PROGBITS, ELF_SHF_ALLOC | ELF_SHF_EXECINSTR);
+    return as;
+}
+
+void x86_asm_destroy(X86Assembler *as) {
+    if (!as) return;
+
+    for (int i = 0; i < as->section_count; i++) {
+        free(as->sections[i].data);
+    }
+    free(as->symbols);
+    free(as->symbol_slots);
+    free(as->fixups);
+    free(as);
+}
+
+void x86_asm_source(X86Assembler *as, const char *text, size_t length) {
+    const char *end = text + length;
+    while (text < end) {
+        const char *newline = memchr(text, '\n', (size_t)(end - text));
+        const char *line_end = newline ? newline : end;
+        as->line++;
+        x86_line(as, text, line_end);
+        text = newline ? newline + 1 : end;
+    }
+}
+
+X86Operand x86_reg(int reg, int size) {
+    X86Operand operand = {X86_OP_REG, reg, size, 0, NULL, X86_NONE, X86_NONE, 1, false};
+    return operand;
+}
+
+X86Operand x86_imm(int64_t value) {
+    X86Operand operand = {X86_OP_IMM, X86_NONE, 0, value, NULL, X86_NONE, X86_NONE, 1, false};
+    return operand;
+}
+
+X86Operand x86_mem(int base, int64_t displacement) {
+    X86Operand operand = {X86_OP_MEM, X86_NONE, 0, displacement, NULL, base, X86_NONE, 1, false};
+    return operand;
+}
+
+X86Operand x86_sym(const char *symbol) {
+    X86Operand operand = {X86_OP_MEM, X86_NONE, 0, 0, symbol, X86_NONE, X86_NONE, 1, false};
+    return operand;
+}
+
+void x86_asm_encode(X86Assembler *as, const X86Instruction *instruction) {
+    x86_encode(as, instruction);
+}
+
+void x86_asm_label(X86Assembler *as, const char *name) {
+    x86_define_label(as, name, strlen(name));
+}
+
+void x86_asm_global(X86Assembler *as, const char *name) {
+    int symbol = x86_symbol(as, name, strlen(name));
+    if (symbol != X86_NONE) as->symbols[symbol].global = true;
+}
+
+void x86_asm_section(X86Assembler *as, const char *name) {
+    x86_switch_section(as, name, strlen(name));
+}
+
+int x86_asm_error_count(const X86Assembler *as) {
+    return as->error_count;
+}
+
+// ========================================
+// Object output
+// ========================================
+
+static int x86_elf_symbol(X86Assembler *as, ElfWriter *writer, int index) {
+    X86Symbol *symbol = &as->symbols[index];
+    if (symbol->elf_symbol != X86_NONE) {
+        return symbol->elf_symbol;
+    }
+
+    int section = 0;
+    uint8_t type = ELF_STT_NOTYPE;
+    if (symbol->section != X86_NONE) {
+        X86Section *owner = &as->sections[symbol->section];
+        section = owner->elf_index;
+        if (symbol->global) {
+            type = (owner->flags & ELF_SHF_EXECINSTR) ? ELF_STT_FUNC : ELF_STT_OBJECT;
+        }
+    }
+    symbol->elf_symbol = elf_writer_add_symbol(writer, symbol->name, section,
+                                               (uint64_t)symbol->offset, 0, type, symbol->global);
+    return symbol->elf_symbol;
+}
+
+bool x86_asm_write_object(X86Assembler *as, const char *path) {
+    if (as->error_count > 0) {
+        return false;
+    }
+
+    ElfWriter *writer = elf_writer_create(true, false, ELF_EM_X86_64);
+    if (!writer) return false;
+
+    for (int i = 0; i < as->section_count; i++) {
+        X86Section *section = &as->sections[i];
+        section->elf_index = elf_writer_add_section(writer, section->name, section->type,
+                                                    section->flags, section->alignment,
+                                                    section->data, section->size);
+    }
+
+    // Defined symbols, except assembler-local .L labels
+    for (int i = 0; i < as->symbol_count; i++) {
+        X86Symbol *symbol = &as->symbols[i];
+        if (symbol->section != X86_NONE && strncmp(symbol->name, ".L", 2) != 0) {
+            x86_elf_symbol(as, writer, i);
+        }
+    }
+
+    for (int i = 0; i < as->fixup_count; i++) {
+        X86Fixup *fixup = &as->fixups[i];
+        X86Symbol *symbol = &as->symbols[fixup->symbol];
+        X86Section *section = &as->sections[fixup->section];
+        bool pc_relative = fixup->kind == X86_FIX_PC32 || fixup->kind == X86_FIX_BRANCH32;
+
+        // Resolved here: pc-relative references within one section
+        if (pc_relative && symbol->section == fixup->section) {
+            int64_t value = (int64_t)symbol->offset + fixup->addend - (int64_t)fixup->offset;
+            if (!x86_fits_int32(value)) {
+                as->line = fixup->line;
+                x86_error(as, "branch to '%s' is out of range", symbol->name);
+                continue;
+            }
+            for (int b = 0; b < 4; b++) {
+                section->data[fixup->offset + (size_t)b] = (unsigned char)((uint64_t)value >> (b * 8));
+            }
+            continue;
+        }
+
+        uint32_t type;
+        switch (fixup->kind) {
+            case X86_FIX_PC32:     type = R_X86_64_PC32; break;
+            case X86_FIX_BRANCH32: type = symbol->section == X86_NONE ? R_X86_64_PLT32
+                                                                      : R_X86_64_PC32; break;
+            case X86_FIX_ABS32S:   type = R_X86_64_32S; break;
+            case X86_FIX_ABS32:    type = R_X86_64_32; break;
+            default:               type = R_X86_64_64; break;
+        }
+
+        // Local symbols are referenced through their section
+        int target;
+        int64_t addend = fixup->addend;
+        if (symbol->section != X86_NONE && !symbol->global) {
+            target = elf_writer_section_symbol(writer, as->sections[symbol->section].elf_index);
+            addend += (int64_t)symbol->offset;
+        } else {
+            target = x86_elf_symbol(as, writer, fixup->symbol);
+        }
+        elf_writer_add_relocation(writer, section->elf_index, fixup->offset, target, type, addend);
+    }
+
+    bool ok = as->error_count == 0 && elf_writer_write(writer, path);
+    elf_writer_destroy(writer);
+    return ok;
+}
@@ -0,0 +1,66 @@
+#include "../include/kcc.h"
+#include "../include/arena.h"
+#include <assert.h>
+#include <stdint.h>
+
+void test_arena(void) {
+    // Small allocations are 16-byte aligned and come from one chunk
+    Arena *arena = arena_create(256);
+    char *a = arena_alloc(arena, 1);
+    char *b = arena_alloc(arena, 3);
+    assert(((uintptr_t)a & 15) == 0);
+    assert(((uintptr_t)b & 15) == 0);
+    assert(b == a + 16);
+    assert(arena->allocation_count == 2);
+    assert(arena->bytes_allocated == 32);
+
+    // Filling the chunk starts a new one; earlier memory stays put
+    strcpy(a, "");
+    for (int i = 0; i < 32; i++) {
+        int *value = arena_alloc(arena, sizeof(int));
+        *value = i;
+    }
+    assert(arena->head->next != NULL);
+    assert(arena->bytes_reserved >= 512);
+
+    // Oversized requests get their own chunk behind the head
+    ArenaChunk *head = arena->head;
+    void *big = arena_alloc(arena, 4096);
+    assert(big != NULL);
+    assert(arena->head == head);
+    assert(head->next->size == 4096);
+
+    // Copies
+    char *copy = arena_strdup(arena, "arena");
+    assert(strcmp(copy, "arena") == 0);
+    char *prefix = arena_strndup(arena, "prefix-rest", 6);
+    assert(strcmp(prefix, "prefix") == 0);
+    int zeros[4] = {0};
+    int *cleared = arena_calloc(arena, 4, sizeof(int));
+    assert(memcmp(cleared, zeros, sizeof(zeros)) == 0);
+    assert(arena_strdup(arena, NULL) == NULL);
+
+    // Reset keeps only the newest chunk and recycles it
+    arena_reset(arena);
+    assert(arena->head->next == NULL);
+    assert(arena->head->used == 0);
+    assert(arena->bytes_allocated == 0);
+    assert(arena->allocation_count == 0);
+    arena_destroy(arena);
+
+    // The AST lives in one arena: destroying the program releases every node
+    const char *source = "int f(int a) { int b = a + 1; return b * 2; }";
+    Lexer *lexer = lexer_create(source, "test_file");
+    Parser *parser = parser_create(lexer);
+    ASTNode *ast = parser_parse_program(parser);
+    assert(ast != NULL);
+    assert(ast_node_count() > 5);
+
+    ast_destroy(ast->data.program.declarations[0]);
+    assert(ast_node_count() > 5);
+    ast_destroy(ast);
+    assert(ast_node_count() == 0);
+
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+}
@@ -0,0 +1,164 @@
+#include "test_util.h"
+#include "../include/compile_cache.h"
+#include <assert.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+// Path of the entry for key, as the cache lays it out
+static void entry_path(char path[PATH_MAX], const char *dir, const char *key) {
+    snprintf(path, PATH_MAX, "%s/%.2s/%s", dir, key, key + 2);
+}
+
+// Sets an entry's mtime age seconds into the past
+static void age_entry(const char *dir, const char *key, int age) {
+    char path[PATH_MAX];
+    entry_path(path, dir, key);
+    struct timeval times[2];
+    gettimeofday(&times[0], NULL);
+    times[0].tv_sec -= age;
+    times[1] = times[0];
+    assert(utimes(path, times) == 0);
+}
+
+static bool entry_exists(const char *dir, const char *key) {
+    char path[PATH_MAX];
+    entry_path(path, dir, key);
+    return access(path, F_OK) == 0;
+}
+
+// Removes the cache directory and its two levels of contents
+static void remove_tree(const char *path, int depth) {
+    DIR *dir = opendir(path);
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir))) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            char child[PATH_MAX];
+            snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+            if (depth > 0) remove_tree(child, depth - 1);
+            remove(child);
+        }
+        closedir(dir);
+    }
+    remove(path);
+}
+
+static void test_keys(void) {
+    const char *source = "int main() { return 0; }\n";
+    size_t length = strlen(source);
+    CompilerOptions opts = {0};
+    opts.target_arch = "x86_64";
+    char key[COMPILE_CACHE_KEY_SIZE];
+    char other[COMPILE_CACHE_KEY_SIZE];
+
+    // Stable, 32 hex digits
+    compile_cache_key(source, length, &opts, true, key);
+    compile_cache_key(source, length, &opts, true, other);
+    assert(strlen(key) == COMPILE_CACHE_KEY_SIZE - 1 && strcmp(key, other) == 0);
+    assert(strspn(key, "0123456789abcdef") == COMPILE_CACHE_KEY_SIZE - 1);
+
+    // Everything the output depends on is in the key
+    compile_cache_key(source, length, &opts, false, other);
+    assert(strcmp(key, other) != 0);
+    compile_cache_key(source, length - 1, &opts, true, other);
+    assert(strcmp(key, other) != 0);
+    opts.optimize = true;
+    compile_cache_key(source, length, &opts, true, other);
+    assert(strcmp(key, other) != 0);
+    opts.optimize = false;
+    opts.target_arch = "arm64";
+    compile_cache_key(source, length, &opts, true, other);
+    assert(strcmp(key, other) != 0);
+
+    // Paths and other options that do not change the output are not
+    opts.target_arch = "x86_64";
+    opts.output_file = "elsewhere.o";
+    opts.verbose = true;
+    compile_cache_key(source, length, &opts, true, other);
+    assert(strcmp(key, other) == 0);
+}
+
+static void test_size_limit(void) {
+    unsetenv("KCC_CACHE_MAX_SIZE");
+    assert(compile_cache_max_size() == COMPILE_CACHE_DEFAULT_MAX_SIZE);
+    setenv("KCC_CACHE_MAX_SIZE", "500M", 1);
+    assert(compile_cache_max_size() == 500ull * 1024 * 1024);
+    setenv("KCC_CACHE_MAX_SIZE", "2k", 1);
+    assert(compile_cache_max_size() == 2048);
+    setenv("KCC_CACHE_MAX_SIZE", "4096", 1);
+    assert(compile_cache_max_size() == 4096);
+    unsetenv("KCC_CACHE_MAX_SIZE");
+}
+
+static void test_store_and_fetch(void) {
+    char dir[] = "/tmp/kcc_cache_XXXXXX";
+    assert(mkdtemp(dir));
+    char input[PATH_MAX];
+    char output[PATH_MAX];
+    snprintf(input, sizeof(input), "%s/input.o", dir);
+    snprintf(output, sizeof(output), "%s/output.o", dir);
+    char contents[1001] = {0};
+
+    CompilerOptions opts = {0};
+    char keys[3][COMPILE_CACHE_KEY_SIZE];
+    for (int i = 0; i < 3; i++) {
+        char source[32];
+        snprintf(source, sizeof(source), "int unit%d;\n", i);
+        compile_cache_key(source, strlen(source), &opts, true, keys[i]);
+    }
+
+    // A miss leaves the output alone; a store makes the next fetch a hit
+    // that copies the entry out
+    assert(!compile_cache_fetch(dir, keys[0], output));
+    assert(access(output, F_OK) != 0);
+    memset(contents, 'a', 1000);
+    test_write_file(dir, "input.o", contents);
+    compile_cache_store(dir, keys[0], input, 1 << 20);
+    assert(compile_cache_fetch(dir, keys[0], output));
+    FILE *file = fopen(output, "rb");
+    assert(file);
+    char buffer[1001];
+    assert(fread(buffer, 1, sizeof(buffer), file) == 1000);
+    fclose(file);
+    assert(buffer[0] == 'a' && buffer[999] == 'a');
+
+    // Eviction drops the least recently used entries; a hit counts as a use
+    memset(contents, 'b', 1000);
+    test_write_file(dir, "input.o", contents);
+    compile_cache_store(dir, keys[1], input, 1 << 20);
+    age_entry(dir, keys[0], 300);
+    age_entry(dir, keys[1], 200);
+    assert(compile_cache_fetch(dir, keys[0], output));
+    memset(contents, 'c', 1000);
+    test_write_file(dir, "input.o", contents);
+    compile_cache_store(dir, keys[2], input, 2500);
+    assert(entry_exists(dir, keys[0]));
+    assert(!entry_exists(dir, keys[1]));
+    assert(entry_exists(dir, keys[2]));
+    assert(!compile_cache_fetch(dir, keys[1], output));
+
+    // The counters add up across all of the above
+    FILE *out = tmpfile();
+    assert(out && compile_cache_print_stats(dir, out));
+    rewind(out);
+    char text[1024];
+    size_t got = fread(text, 1, sizeof(text) - 1, out);
+    text[got] = '\0';
+    fclose(out);
+    assert(strstr(text, "Hits:             2\n"));
+    assert(strstr(text, "Misses:           2\n"));
+    assert(strstr(text, "Hit rate:         50.0%\n"));
+    assert(strstr(text, "Stores:           3\n"));
+    assert(strstr(text, "Evictions:        1\n"));
+    assert(strstr(text, "Size:             2.0 KB"));
+
+    remove_tree(dir, 1);
+}
+
+void test_compile_cache(void) {
+    test_keys();
+    test_size_limit();
+    test_store_and_fetch();
+}
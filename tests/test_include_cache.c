@@ -0,0 +1,80 @@
+#include "test_util.h"
+#include "../include/include_cache.h"
+#include <assert.h>
+#include <unistd.h>
+
+static size_t count_occurrences(const char *text, const char *needle) {
+    size_t count = 0;
+    for (const char *p = strstr(text, needle); p; p = strstr(p + 1, needle)) {
+        count++;
+    }
+    return count;
+}
+
+void test_include_cache(void) {
+    char dir[] = "/tmp/kcc_include_XXXXXX";
+    assert(mkdtemp(dir) != NULL);
+
+    test_write_file(dir, "guarded.h", "// leading comment\n#ifndef GUARDED_H\n#define GUARDED_H\n"
+                                 "int guarded_decl;\n#endif\n");
+    test_write_file(dir, "bang.h", "#if !defined(BANG_H)\n#define BANG_H\nint bang_decl;\n#endif\n");
+    test_write_file(dir, "once.h", "#pragma once\nint once_decl;\n");
+    test_write_file(dir, "open.h", "#ifndef OPEN_H\n#define OPEN_H\n#endif\nint open_decl;\n");
+    test_write_file(dir, "main.c", "#include \"guarded.h\"\n#include \"guarded.h\"\n"
+                              "#include \"bang.h\"\n#include \"./bang.h\"\n"
+                              "#include \"once.h\"\n#include \"once.h\"\n"
+                              "#include \"open.h\"\n#include \"open.h\"\n"
+                              "#include <kcc_no_such_header.h>\n"
+                              "int main_decl;\n");
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/main.c", dir);
+    Preprocessor *pp = preprocessor_create();
+    char *output = preprocessor_process_file(pp, path);
+    assert(output != NULL);
+    assert(count_occurrences(output, "int guarded_decl;") == 1);
+    assert(count_occurrences(output, "int bang_decl;") == 1);
+    assert(count_occurrences(output, "int once_decl;") == 1);
+    assert(count_occurrences(output, "int open_decl;") == 2);
+    assert(count_occurrences(output, "int main_decl;") == 1);
+    free(output);
+    preprocessor_destroy(pp);
+
+    // What the preprocessor learnt stays with the cached file, and the same
+    // file reached through another path shares its entry
+    snprintf(path, sizeof(path), "%s/guarded.h", dir);
+    IncludeCacheEntry *guarded = include_cache_lookup(path);
+    assert(guarded && guarded->loaded);
+    assert(include_cache_guard(guarded) == intern_string("GUARDED_H"));
+    assert(!include_cache_pragma_once(guarded));
+    snprintf(path, sizeof(path), "%s/./guarded.h", dir);
+    assert(include_cache_lookup(path) == guarded);
+
+    snprintf(path, sizeof(path), "%s/bang.h", dir);
+    assert(include_cache_guard(include_cache_lookup(path)) == intern_string("BANG_H"));
+    snprintf(path, sizeof(path), "%s/once.h", dir);
+    assert(include_cache_pragma_once(include_cache_lookup(path)));
+    snprintf(path, sizeof(path), "%s/open.h", dir);
+    assert(include_cache_guard(include_cache_lookup(path)) == NULL);
+    snprintf(path, sizeof(path), "%s/missing.h", dir);
+    assert(include_cache_lookup(path) == NULL);
+
+    // A second translation unit is served from the same entries
+    size_t entries = include_cache_count();
+    snprintf(path, sizeof(path), "%s/main.c", dir);
+    pp = preprocessor_create();
+    output = preprocessor_process_file(pp, path);
+    assert(output != NULL);
+    assert(count_occurrences(output, "int guarded_decl;") == 1);
+    assert(include_cache_count() == entries);
+    free(output);
+    preprocessor_destroy(pp);
+
+    const char *names[] = {"guarded.h", "bang.h", "once.h", "open.h", "main.c"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+        unlink(path);
+    }
+    rmdir(dir);
+    include_cache_destroy();
+}
@@ -0,0 +1,44 @@
+#include "../include/kcc.h"
+#include "../include/intern.h"
+#include <assert.h>
+
+void test_intern(void) {
+    // One handle per spelling
+    const char *a = intern_string("interned_name");
+    char buffer[] = "interned_name";
+    assert(intern_string(buffer) == a);
+    assert(intern_string_n("interned_name_suffix", 13) == a);
+    assert(intern_string("interned_other") != a);
+    assert(intern_string("") == intern_string_n("xyz", 0));
+
+    // Length and hash are stored with the characters
+    assert(intern_length(a) == 13);
+    assert(intern_hash(a) == intern_hash_bytes("interned_name", 13));
+
+    // Lookup finds existing spellings without adding new ones
+    size_t count = intern_count();
+    assert(intern_lookup_n("interned_name", 13) == a);
+    assert(intern_lookup_n("never_interned_spelling", 23) == NULL);
+    assert(intern_count() == count);
+
+    // Growth keeps earlier handles stable
+    char name[32];
+    for (int i = 0; i < 5000; i++) {
+        snprintf(name, sizeof(name), "grow_%d", i);
+        intern_string(name);
+    }
+    assert(intern_string("interned_name") == a);
+    assert(strcmp(intern_string("grow_4321"), "grow_4321") == 0);
+
+    // The lexer and the AST hand out the same handles
+    Lexer *lexer = lexer_create("int counter;", "test_file");
+    Parser *parser = parser_create(lexer);
+    ASTNode *ast = parser_parse_program(parser);
+    assert(ast != NULL);
+    assert(ast->data.program.declaration_count == 1);
+    ASTNode *decl = ast->data.program.declarations[0];
+    assert(decl->data.var_decl.name == intern_string("counter"));
+    ast_destroy(ast);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+}
@@ -0,0 +1,150 @@
+#include "test_util.h"
+#include "../include/error.h"
+#include <assert.h>
+
+static bool has_pred(const IRBlock *block, const IRBlock *pred) {
+    for (int i = 0; i < block->pred_count; i++) {
+        if (block->preds[i] == pred) return true;
+    }
+    return false;
+}
+
+// Every laid out block ends in one terminator, its phis lead with one
+// operand per predecessor, and predecessor lists match the edges exactly
+static void check_function(const IRFunction *function) {
+    int edges = 0;
+    int preds = 0;
+    for (IRBlock *block = function->entry; block; block = block->next) {
+        assert(ir_block_terminated(block));
+        bool in_phis = true;
+        for (IRInstr *instr = block->first; instr; instr = instr->next) {
+            assert(instr->block == block);
+            if (instr->op == IR_PHI) {
+                assert(in_phis && instr->operand_count == block->pred_count);
+            } else {
+                in_phis = false;
+            }
+            assert(instr == block->last || instr->op < IR_JUMP);
+        }
+
+        IRBlock *succs[2];
+        int count = ir_block_successors(block, succs);
+        for (int i = 0; i < count; i++) {
+            assert(has_pred(succs[i], block));
+        }
+        edges += count;
+        preds += block->pred_count;
+    }
+    assert(edges == preds);
+    assert(function->entry->pred_count == 0);
+}
+
+// The successor of a block ending in a jump
+static IRBlock *jump_target(const IRBlock *block) {
+    assert(block->last->op == IR_JUMP);
+    return block->last->data.targets[0];
+}
+
+void test_ir(void) {
+    IRModule *module = test_lower_source(
+        "int f(int n) {\n"
+        "    int s = 0;\n"
+        "    int i = 0;\n"
+        "    while (i < n) {\n"
+        "        if (i > 5) {\n"
+        "            break;\n"
+        "        }\n"
+        "        if (i < 2) {\n"
+        "            s = s + i;\n"
+        "        } else {\n"
+        "            s = s - 1;\n"
+        "        }\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    return s;\n"
+        "}\n");
+    IRFunction *function = module->functions;
+    assert(function && !function->next && function->param_count == 1);
+    check_function(function);
+
+    // The loop header merges the entry and the back edge: one phi per
+    // variable assigned in the loop, starting from the constants
+    IRBlock *entry = function->entry;
+    IRBlock *header = jump_target(entry);
+    assert(header->pred_count == 2 && header->preds[0] == entry);
+    IRInstr *i_phi = header->first;
+    IRInstr *s_phi = i_phi->next;
+    assert(i_phi->op == IR_PHI && s_phi->op == IR_PHI && s_phi->next->op != IR_PHI);
+    assert(i_phi->operands[0]->op == IR_CONST && i_phi->operands[0]->data.constant == 0);
+    assert(s_phi->operands[0]->op == IR_CONST && s_phi->operands[0]->data.constant == 0);
+
+    IRInstr *test = header->last;
+    assert(test->op == IR_BRANCH && test->operands[0]->op == IR_LT);
+    assert(test->operands[0]->operands[0] == i_phi);
+    assert(test->operands[0]->operands[1] == function->params[0]);
+    IRBlock *body = test->data.targets[0];
+    IRBlock *exit = test->data.targets[1];
+
+    // The break jumps straight to the exit, which so has two predecessors;
+    // the value returned is the header's s, the same along both
+    IRInstr *break_test = body->last;
+    assert(break_test->op == IR_BRANCH && break_test->operands[0]->op == IR_GT);
+    IRBlock *break_block = break_test->data.targets[0];
+    assert(jump_target(break_block) == exit && break_block->first == break_block->last);
+    assert(exit->pred_count == 2 && has_pred(exit, header) && has_pred(exit, break_block));
+    assert(exit->first->op == IR_RET && exit->first->operands[0] == s_phi);
+
+    // if/else: each arm defines s and the join picks between them
+    IRBlock *choose = break_test->data.targets[1];
+    assert(choose->last->op == IR_BRANCH);
+    IRBlock *then_block = choose->last->data.targets[0];
+    IRBlock *else_block = choose->last->data.targets[1];
+    IRBlock *join = jump_target(then_block);
+    assert(jump_target(else_block) == join);
+    assert(join->pred_count == 2 && join->preds[0] == then_block && join->preds[1] == else_block);
+    IRInstr *s_join = join->first;
+    assert(s_join->op == IR_PHI && s_join->next->op != IR_PHI);
+    assert(s_join->operands[0]->op == IR_ADD && s_join->operands[0]->block == then_block);
+    assert(s_join->operands[1]->op == IR_SUB && s_join->operands[1]->block == else_block);
+
+    // The join is the latch: the back edge carries its values to the header
+    assert(jump_target(join) == header && header->preds[1] == join);
+    assert(s_phi->operands[1] == s_join);
+    IRInstr *next_i = i_phi->operands[1];
+    assert(next_i->op == IR_ADD && next_i->block == join && next_i->operands[0] == i_phi);
+
+    // Nothing follows the break in its block, so no dead block is laid out
+    int blocks = 0;
+    for (IRBlock *block = function->entry; block; block = block->next) blocks++;
+    assert(blocks == 9);
+
+    ir_module_destroy(module);
+
+    // A variable assigned on one arm only meets its value from before the if
+    // in a phi at the join
+    module = test_lower_source("int g(int a) { int r = 1; if (a < 3) { r = 2; } return r; }");
+    function = module->functions;
+    check_function(function);
+    IRBlock *done = NULL;
+    for (IRBlock *block = function->entry; block; block = block->next) {
+        if (block->last->op == IR_RET) done = block;
+    }
+    assert(done && done->pred_count == 2);
+    IRInstr *r = done->last->operands[0];
+    assert(r->op == IR_PHI && r->block == done);
+    for (int i = 0; i < 2; i++) {
+        int64_t value = done->preds[i] == function->entry ? 1 : 2;
+        assert(r->operands[i]->op == IR_CONST && r->operands[i]->data.constant == value);
+    }
+    ir_module_destroy(module);
+
+    // What the IR cannot express is an error, not a silent undef
+    int errors = error_count();
+    module = test_lower_source("int h(int a) { return a + missing; }");
+    assert(error_count() == errors + 1);
+    ir_module_destroy(module);
+    module = test_lower_source("int k(int a) { undeclared = a; return a; }");
+    assert(error_count() == errors + 2);
+    ir_module_destroy(module);
+    error_reset();
+}
@@ -0,0 +1,67 @@
+#include "../include/kcc.h"
+#include <assert.h>
+
+static TokenType first_token_type(const char *source, const char *filename) {
+    Lexer *lexer = lexer_create(source, filename);
+    Token token = lexer_next_token(lexer);
+    lexer_destroy(lexer);
+    return token.type;
+}
+
+void test_keywords(void) {
+    static const struct {
+        const char *word;
+        TokenType type;
+    } c_keywords[] = {
+        {"int", TOKEN_INT}, {"char", TOKEN_CHAR_KW}, {"void", TOKEN_VOID},
+        {"float", TOKEN_FLOAT}, {"double", TOKEN_DOUBLE}, {"long", TOKEN_LONG},
+        {"short", TOKEN_SHORT}, {"unsigned", TOKEN_UNSIGNED}, {"signed", TOKEN_SIGNED},
+        {"if", TOKEN_IF}, {"else", TOKEN_ELSE}, {"while", TOKEN_WHILE},
+        {"for", TOKEN_FOR}, {"return", TOKEN_RETURN}, {"break", TOKEN_BREAK},
+        {"continue", TOKEN_CONTINUE}, {"switch", TOKEN_SWITCH}, {"case", TOKEN_CASE},
+        {"default", TOKEN_DEFAULT}, {"sizeof", TOKEN_SIZEOF}, {"typedef", TOKEN_TYPEDEF},
+        {"struct", TOKEN_STRUCT}, {"union", TOKEN_UNION}, {"enum", TOKEN_ENUM},
+        {"static", TOKEN_STATIC}, {"extern", TOKEN_EXTERN}, {"const", TOKEN_CONST},
+        {"volatile", TOKEN_VOLATILE}, {"restrict", TOKEN_RESTRICT},
+    };
+
+    // Every C keyword hashes to its own entry
+    for (size_t i = 0; i < sizeof(c_keywords) / sizeof(c_keywords[0]); i++) {
+        TokenType type = TOKEN_UNKNOWN;
+        assert(is_keyword(c_keywords[i].word, &type));
+        assert(type == c_keywords[i].type);
+        assert(first_token_type(c_keywords[i].word, "test_file") == c_keywords[i].type);
+    }
+
+    // Prefixes, extensions and case variants of keywords are identifiers
+    static const char *identifiers[] = {
+        "in", "integer", "returns", "whilex", "If", "INT", "_int", "x", "structs",
+    };
+    for (size_t i = 0; i < sizeof(identifiers) / sizeof(identifiers[0]); i++) {
+        TokenType type = TOKEN_UNKNOWN;
+        assert(!is_keyword(identifiers[i], &type));
+        assert(first_token_type(identifiers[i], "test_file") == TOKEN_IDENTIFIER);
+    }
+
+    // '@' directives
+    TokenType type = TOKEN_UNKNOWN;
+    assert(is_objc_at_keyword("interface", &type) && type == TOKEN_AT_INTERFACE);
+    assert(is_objc_at_keyword("synthesize", &type) && type == TOKEN_AT_SYNTHESIZE);
+    assert(!is_objc_at_keyword("int", &type));
+    assert(first_token_type("@end", "test_file") == TOKEN_AT_END);
+    assert(first_token_type("@bogus", "test_file") == TOKEN_AT_IDENTIFIER);
+
+    // Objective-C types only in objc mode
+    assert(is_objc_type("BOOL", &type) && type == TOKEN_BOOL_KW);
+    assert(first_token_type("BOOL", "test_file") == TOKEN_IDENTIFIER);
+    assert(first_token_type("BOOL", "test_file.m") == TOKEN_BOOL_KW);
+
+    // Property attributes only inside @property ( ... )
+    Lexer *lexer = lexer_create("@property (copy) copy;", "test_file.m");
+    assert(lexer_next_token(lexer).type == TOKEN_AT_PROPERTY);
+    assert(lexer_next_token(lexer).type == TOKEN_LPAREN);
+    assert(lexer_next_token(lexer).type == TOKEN_COPY);
+    assert(lexer_next_token(lexer).type == TOKEN_RPAREN);
+    assert(lexer_next_token(lexer).type == TOKEN_IDENTIFIER);
+    lexer_destroy(lexer);
+}
@@ -15,11 +15,55 @@ void test_parser(void) {
     assert(ast->data.program.declaration_count == 1);
     
     ASTNode *func = ast->data.program.declarations[0];
-    assert(func->type == AST_FUNCTION_CALL);
+    assert(func->type == AST_FUNCTION_DECLARATION);
     assert(strcmp(func->data.function_decl.name, "main") == 0);
     assert(func->data.function_decl.return_type == TYPE_INT);
     
     ast_destroy(ast);
     parser_destroy(parser);
     lexer_destroy(lexer);
+
+    // Indexed lookahead: peeking and rewinding do not re-lex
+    lexer = lexer_create("a = b + 1;", "test_file");
+    parser = parser_create(lexer);
+    assert(parser->token_count == 7);
+    assert(parser->tokens[6].type == TOKEN_EOF);
+    assert(parser_peek(parser, 0).type == TOKEN_IDENTIFIER);
+    assert(parser_peek(parser, 3).type == TOKEN_PLUS);
+    assert(parser_peek(parser, 100).type == TOKEN_EOF);
+    size_t mark = parser_mark(parser);
+    parser_advance(parser);
+    parser_advance(parser);
+    assert(parser->current_token.type == TOKEN_IDENTIFIER);
+    assert(parser->current_token.value == intern_string("b"));
+    parser_rewind(parser, mark);
+    assert(parser->current_token.value == intern_string("a"));
+    assert(parser->peek_token.type == TOKEN_ASSIGN);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+
+    // Block items: a declaration is tried first, and a statement is parsed
+    // from the same token when the declaration prefix does not match
+    error_reset();
+    source = "int f(int n) { const int a = n; a = a + 1; int b; b = a; return b; }";
+    lexer = lexer_create(source, "test_file");
+    parser = parser_create(lexer);
+    ast = parser_parse_program(parser);
+    assert(error_count() == 0);
+    ASTNode *body = ast->data.program.declarations[0]->data.function_decl.body;
+    assert(body->type == AST_COMPOUND_STATEMENT);
+    assert(body->data.compound_stmt.statement_count == 5);
+    ASTNode **items = body->data.compound_stmt.statements;
+    assert(items[0]->type == AST_VAR_DECL);
+    assert(items[0]->data.var_decl.name == intern_string("a"));
+    assert(items[0]->data.var_decl.is_const);
+    assert(items[0]->data.var_decl.initializer != NULL);
+    assert(items[1]->type == AST_EXPRESSION_STATEMENT);
+    assert(items[2]->type == AST_VAR_DECL);
+    assert(items[2]->data.var_decl.initializer == NULL);
+    assert(items[3]->type == AST_EXPRESSION_STATEMENT);
+    assert(items[4]->type == AST_RETURN_STATEMENT);
+    ast_destroy(ast);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
 }
\ No newline at end of file
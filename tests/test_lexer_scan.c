@@ -0,0 +1,65 @@
+#include "../include/kcc.h"
+#include "../include/lexer_scan.h"
+#include <assert.h>
+
+// Runs every scanner on buf[start, start + length) and stores the results
+static void scan_all(const char *buf, size_t start, size_t length, const char *results[5],
+                     size_t *newlines) {
+    const char *p = buf + start;
+    const char *end = p + length;
+    results[0] = lexer_scan_whitespace(p, end);
+    results[1] = lexer_scan_identifier(p, end);
+    results[2] = lexer_scan_until2(p, end, '"', '\\');
+    results[3] = lexer_scan_until2(p, end, '*', '\n');
+    results[4] = NULL;
+    *newlines = lexer_scan_count_newlines(p, end, &results[4]);
+}
+
+void test_lexer_scan(void) {
+    // Buffers mixing runs of each class, including bytes >= 0x80, so the
+    // vector paths see matches at every lane and across block boundaries
+    static const char alphabet[] = " \t\n\r\v\fazAZ09_\"\\*/#+\x80\xff";
+    char buf[300];
+    unsigned int seed = 12345;
+    for (int round = 0; round < 40; round++) {
+        for (size_t i = 0; i < sizeof(buf); i++) {
+            seed = seed * 1103515245u + 12345u;
+            unsigned int pick = (seed >> 16) % (sizeof(alphabet) - 1);
+            // Long runs of one class exercise the whole-block fast paths
+            buf[i] = (round & 1) && i % 37 ? buf[i ? i - 1 : 0] : alphabet[pick];
+        }
+
+        for (size_t start = 0; start < 40; start++) {
+            for (size_t length = 0; start + length <= sizeof(buf); length += 7) {
+                const char *vector[5];
+                const char *scalar[5];
+                size_t vector_lines;
+                size_t scalar_lines;
+
+                lexer_scan_set_vector(true);
+                scan_all(buf, start, length, vector, &vector_lines);
+                lexer_scan_set_vector(false);
+                scan_all(buf, start, length, scalar, &scalar_lines);
+
+                for (int k = 0; k < 5; k++) {
+                    assert(vector[k] == scalar[k]);
+                }
+                assert(vector_lines == scalar_lines);
+            }
+        }
+    }
+    lexer_scan_set_vector(true);
+
+    // Known answers
+    const char *text = "  \t\n  ident_9 + \"a\\\"b\" \n";
+    const char *end = text + strlen(text);
+    assert(lexer_scan_whitespace(text, end) == text + 6);
+    assert(lexer_scan_identifier(text + 6, end) == text + 13);
+    assert(lexer_scan_until2(text, end, '"', '\\') == text + 16);
+    assert(lexer_scan_until2(text + 17, end, '"', '\\') == text + 18);
+    const char *last = NULL;
+    assert(lexer_scan_count_newlines(text, end, &last) == 2);
+    assert(last == end - 1);
+    assert(lexer_scan_whitespace(end, end) == end);
+    assert(lexer_scan_backend_name() != NULL);
+}
@@ -1,9 +1,24 @@
 #include <stdio.h>
 #include <assert.h>
+#include "../include/lexer_scan.h"
 
 // Forward declarations of test functions
 void test_lexer(void);
 void test_parser(void);
+void test_arena(void);
+void test_intern(void);
+void test_symbol_table(void);
+void test_keywords(void);
+void test_lexer_scan(void);
+void test_preprocessor(void);
+void test_include_cache(void);
+void test_pch(void);
+void test_x86_assembler(void);
+void test_sh2_assembler(void);
+void test_compile_cache(void);
+void test_ir(void);
+void test_regalloc(void);
+void test_multiarch(void);
 
 int main(void) {
     printf("Running KCC tests...\n");
@@ -16,6 +31,62 @@ int main(void) {
     test_parser();
     printf("PASSED\n");
 
+    printf("Testing arena... ");
+    test_arena();
+    printf("PASSED\n");
+
+    printf("Testing interner... ");
+    test_intern();
+    printf("PASSED\n");
+
+    printf("Testing symbol table... ");
+    test_symbol_table();
+    printf("PASSED\n");
+
+    printf("Testing keywords... ");
+    test_keywords();
+    printf("PASSED\n");
+
+    printf("Testing lexer scanners (%s)... ", lexer_scan_backend_name());
+    test_lexer_scan();
+    printf("PASSED\n");
+
+    printf("Testing preprocessor... ");
+    test_preprocessor();
+    printf("PASSED\n");
+
+    printf("Testing include cache... ");
+    test_include_cache();
+    printf("PASSED\n");
+
+    printf("Testing precompiled headers... ");
+    test_pch();
+    printf("PASSED\n");
+
+    printf("Testing x86-64 assembler... ");
+    test_x86_assembler();
+    printf("PASSED\n");
+
+    printf("Testing SH-2 assembler... ");
+    test_sh2_assembler();
+    printf("PASSED\n");
+
+    printf("Testing compile cache... ");
+    test_compile_cache();
+    printf("PASSED\n");
+
+    printf("Testing IR lowering... ");
+    test_ir();
+    printf("PASSED\n");
+
+    printf("Testing register allocation... ");
+    test_regalloc();
+    printf("PASSED\n");
+
+    printf("Testing multiarch backend... ");
+    test_multiarch();
+    printf("PASSED\n");
+
     printf("All tests passed!\n");
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include "test_util.h"
+#include <assert.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Builds a program for the host with the IR backend, links it the way the
+// driver does and runs it; returns its exit status, or -1 when the host has
+// no toolchain to assemble and link with
+static int build_and_run(const char *source) {
+    TargetArch arch = detect_host_architecture();
+    TargetPlatform platform = detect_host_platform();
+    if (arch == ARCH_UNKNOWN || platform == PLATFORM_UNKNOWN ||
+        system("cc --version >/dev/null 2>&1") != 0) {
+        return -1;
+    }
+
+    char dir[] = "/tmp/kcc_multiarch_XXXXXX";
+    assert(mkdtemp(dir));
+    char asm_path[PATH_MAX];
+    char program[PATH_MAX];
+    snprintf(asm_path, sizeof(asm_path), "%s/program.s", dir);
+    snprintf(program, sizeof(program), "%s/program", dir);
+
+    test_generate(source, asm_path, arch, platform);
+
+    char command[3 * PATH_MAX];
+    snprintf(command, sizeof(command), "cc '%s' -o '%s' " KCC_LINK_FLAGS, asm_path, program);
+    assert(system(command) == 0);
+    snprintf(command, sizeof(command), "'%s'", program);
+    int status = system(command);
+    assert(WIFEXITED(status));
+
+    unlink(asm_path);
+    unlink(program);
+    rmdir(dir);
+    return WEXITSTATUS(status);
+}
+
+void test_multiarch(void) {
+    // The program starts at the backend's entry point and exits with what
+    // main returns
+    int status = build_and_run(
+        "int add(int a, int b) { return a + b; }\n"
+        "int main() {\n"
+        "    int s = 0;\n"
+        "    int i = 0;\n"
+        "    while (i < 5) {\n"
+        "        s = add(s, i);\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    return s + 32;\n"
+        "}\n");
+    if (status < 0) {
+        printf("(no host toolchain, skipped) ");
+        return;
+    }
+    assert(status == 42);
+}
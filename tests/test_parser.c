@@ -18,10 +18,46 @@ void test_lexer(void) {
     
     Token token4 = lexer_next_token(lexer);
     assert(token4.type == TOKEN_NUMBER);
-    assert(strcmp(token4.value, "42") == 0);
+    assert(strcmp(lexer_token_text(lexer, &token4), "42") == 0);
+    assert(token4.literal.int_value == 42);
     
     Token token5 = lexer_next_token(lexer);
     assert(token5.type == TOKEN_SEMICOLON);
     
     lexer_destroy(lexer);
+
+    // Tokens are spans over the input; only identifiers and keywords carry
+    // an interned spelling, everything else is materialized on demand
+    const char *spans = "count += 7 * \"text\";";
+    lexer = lexer_create(spans, "test_file");
+    Token ident = lexer_next_token(lexer);
+    assert(ident.offset == 0 && ident.length == 5);
+    assert(ident.value == intern_string("count"));
+    Token plus = lexer_next_token(lexer);
+    assert(plus.type == TOKEN_PLUS && plus.value == NULL);
+    assert(lexer_token_start(lexer, &plus) == spans + 6);
+    Token assign = lexer_next_token(lexer);
+    assert(assign.type == TOKEN_ASSIGN && assign.value == NULL);
+    Token seven = lexer_next_token(lexer);
+    assert(seven.type == TOKEN_NUMBER && seven.value == NULL);
+    assert(seven.offset == 9 && seven.length == 1);
+    Token star = lexer_next_token(lexer);
+    assert(star.type == TOKEN_MULTIPLY && star.value == NULL);
+    Token text = lexer_next_token(lexer);
+    assert(text.type == TOKEN_STRING && text.value == NULL);
+    assert(strcmp(lexer_token_text(lexer, &text), "text") == 0);
+    assert(lexer_next_token(lexer).type == TOKEN_SEMICOLON);
+    assert(lexer_next_token(lexer).type == TOKEN_EOF);
+    lexer_destroy(lexer);
+
+    // Constants past INT_MAX are diagnosed and clamped, not overflowed
+    error_reset();
+    lexer = lexer_create("2147483647 99999999999 123456789012345678901234567890", "test_file");
+    assert(lexer_next_token(lexer).literal.int_value == 2147483647);
+    assert(error_count() == 0);
+    assert(lexer_next_token(lexer).literal.int_value == 2147483647);
+    assert(lexer_next_token(lexer).literal.int_value == 2147483647);
+    assert(error_count() == 2);
+    lexer_destroy(lexer);
+    error_reset();
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "test_util.h"
+#include "../include/pch.h"
+#include "../include/include_cache.h"
+#include <assert.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+// Loads the PCH into a fresh preprocessor and checks the restored state
+static bool load_and_check(const char *dir, const char *pch_path) {
+    Preprocessor *pp = preprocessor_create();
+    preprocessor_add_include_path(pp, dir);
+    char *text = pch_load(pp, pch_path);
+    if (!text) {
+        preprocessor_destroy(pp);
+        return false;
+    }
+
+    assert(strstr(text, "int prefix_decl;") != NULL);
+    Macro *macro = preprocessor_find_macro(pp, "PREFIX_SIZE");
+    assert(macro && strcmp(macro->body, "(4 * 8)") == 0);
+    macro = preprocessor_find_macro(pp, "PREFIX_MAX");
+    assert(macro && macro->type == MACRO_FUNCTION && macro->param_count == 2);
+    assert(preprocessor_is_macro_defined(pp, "PART_H"));
+
+    // The guard learnt while building the PCH keeps part.h out
+    char *output = preprocessor_process_string(pp, "#include \"part.h\"\nint x = PREFIX_SIZE;\n",
+                                               "pch_user.c");
+    assert(output && strstr(output, "part_decl") == NULL);
+    assert(strstr(output, "int x = (4 * 8)    ;") != NULL);
+
+    free(output);
+    free(text);
+    preprocessor_destroy(pp);
+    return true;
+}
+
+void test_pch(void) {
+    char dir[] = "/tmp/kcc_pch_XXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    test_write_file(dir, "part.h", "#ifndef PART_H\n#define PART_H\nint part_decl;\n#endif\n");
+    test_write_file(dir, "prefix.h", "#include \"part.h\"\n#define PREFIX_SIZE (4 * 8)\n"
+                                "#define PREFIX_MAX(a, b) ((a) > (b) ? (a) : (b))\n"
+                                "int prefix_decl;\n");
+
+    // Build from inside the directory with relative paths, as a build
+    // system running "kcc --emit-pch prefix.h.pch prefix.h" would
+    char cwd[PATH_MAX];
+    assert(getcwd(cwd, sizeof(cwd)) != NULL);
+    assert(chdir(dir) == 0);
+
+    // Another unit has already put a header in the process-wide cache
+    test_write_file(dir, "unrelated.h", "int unrelated_decl;\n");
+    Preprocessor *pp = preprocessor_create();
+    preprocessor_add_include_path(pp, ".");
+    char *other = preprocessor_process_string(pp, "#include \"unrelated.h\"\n", "other.c");
+    assert(other != NULL);
+    free(other);
+    preprocessor_destroy(pp);
+
+    pp = preprocessor_create();
+    preprocessor_add_include_path(pp, ".");
+    char *text = preprocessor_process_file(pp, "prefix.h");
+    assert(text != NULL);
+    assert(pch_write(pp, "prefix.h", text, "prefix.h.pch"));
+    free(text);
+    preprocessor_destroy(pp);
+
+    // Use it from elsewhere
+    assert(chdir("/") == 0);
+    char pch_path[PATH_MAX];
+    snprintf(pch_path, sizeof(pch_path), "%s/prefix.h.pch", dir);
+    assert(load_and_check(dir, pch_path));
+
+    // Only headers the prefix read are dependencies
+    test_write_file(dir, "unrelated.h", "long unrelated_decl;\n");
+    assert(load_and_check(dir, pch_path));
+
+    // Touching a header without changing it keeps the PCH valid
+    char part_path[PATH_MAX];
+    snprintf(part_path, sizeof(part_path), "%s/part.h", dir);
+    struct utimbuf times = {1000000000, 1000000000};
+    assert(utime(part_path, &times) == 0);
+    assert(load_and_check(dir, pch_path));
+
+    // Editing one rejects it
+    test_write_file(dir, "part.h", "#ifndef PART_H\n#define PART_H\nlong part_decl;\n#endif\n");
+    assert(!load_and_check(dir, pch_path));
+
+    assert(chdir(cwd) == 0);
+    const char *names[] = {"part.h", "prefix.h", "prefix.h.pch", "unrelated.h"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+        unlink(path);
+    }
+    rmdir(dir);
+    include_cache_destroy();
+}
@@ -0,0 +1,210 @@
+#include "../include/kcc.h"
+#include <assert.h>
+#include <unistd.h>
+
+// Writes text to a fresh temporary file and returns its path in path
+static void write_temp_file(char path[64], const char *text) {
+    strcpy(path, "/tmp/kcc_test_XXXXXX");
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    size_t length = strlen(text);
+    assert(write(fd, text, length) == (ssize_t)length);
+    close(fd);
+}
+
+static void test_source_files(void) {
+    char path[64];
+
+    // Regular files are mapped and not NUL-terminated; size is exact
+    const char *text = "int a;\nint b;\n";
+    write_temp_file(path, text);
+    SourceFile file;
+    assert(source_file_open(&file, path));
+    assert(file.size == strlen(text));
+    assert(memcmp(file.data, text, file.size) == 0);
+#if defined(__unix__) || defined(__APPLE__)
+    assert(file.mapped);
+#endif
+    source_file_close(&file);
+    unlink(path);
+
+    // Empty files cannot be mapped and fall back to reading
+    write_temp_file(path, "");
+    assert(source_file_open(&file, path));
+    assert(file.size == 0 && !file.mapped);
+    source_file_close(&file);
+    unlink(path);
+
+    // Blank lines, directives and dropped #includes keep their newline, so
+    // tokens in the output sit on their source lines
+    write_temp_file(path, "#include <kcc_no_such_header.h>\n"
+                          "#define N 3\n"
+                          "\n"
+                          "int x = N;\n"
+                          "int y;");
+    Preprocessor *pp = preprocessor_create();
+    char *output = preprocessor_process_file(pp, path);
+    assert(output != NULL);
+    Lexer *lexer = lexer_create(output, path);
+    Token token = lexer_next_token(lexer);
+    assert(token.type == TOKEN_INT && token.line == 4);
+    token = lexer_next_token(lexer);
+    assert(token.value == intern_string("x") && token.line == 4);
+    lexer_next_token(lexer);
+    token = lexer_next_token(lexer);
+    assert(token.type == TOKEN_NUMBER && token.literal.int_value == 3);
+    lexer_next_token(lexer);
+    token = lexer_next_token(lexer);
+    assert(token.type == TOKEN_INT && token.line == 5);
+    lexer_destroy(lexer);
+    free(output);
+    preprocessor_destroy(pp);
+    unlink(path);
+}
+
+static void test_macro_table(void) {
+    Preprocessor *pp = preprocessor_create();
+    size_t predefined = pp->macro_count;
+    char name[32];
+    char body[32];
+
+    // Far past any fixed limit; the table keeps growing
+    for (int i = 0; i < 2000; i++) {
+        snprintf(name, sizeof(name), "M%d", i);
+        snprintf(body, sizeof(body), "%d", i * 3);
+        assert(preprocessor_define_macro(pp, name, body));
+    }
+    assert(pp->macro_count == predefined + 2000);
+    assert(pp->macro_capacity >= 4000);
+    assert((pp->macro_capacity & (pp->macro_capacity - 1)) == 0);
+
+    for (int i = 0; i < 2000; i++) {
+        snprintf(name, sizeof(name), "M%d", i);
+        snprintf(body, sizeof(body), "%d", i * 3);
+        Macro *macro = preprocessor_find_macro(pp, name);
+        assert(macro && macro->name == intern_string(name));
+        assert(strcmp(macro->body, body) == 0);
+        assert(preprocessor_lookup_macro(pp, macro->name) == macro);
+    }
+
+    // Spans need not be NUL-terminated
+    assert(preprocessor_find_macro_n(pp, "M17(x)", 3) == preprocessor_find_macro(pp, "M17"));
+    assert(preprocessor_find_macro(pp, "M2000") == NULL);
+    assert(preprocessor_find_macro(pp, "kcc_never_interned_name") == NULL);
+
+    // Redefinition replaces the entry instead of shadowing it
+    unsigned long generation = pp->macro_generation;
+    assert(preprocessor_define_macro(pp, "M5", "15"));
+    assert(pp->macro_count == predefined + 2000);
+    assert(pp->macro_generation > generation);
+    const char *params[] = {"a", "b"};
+    assert(preprocessor_define_function_macro(pp, "SUM", params, 2, "a + b"));
+    Macro *function = preprocessor_find_macro(pp, "SUM");
+    assert(function && function->type == MACRO_FUNCTION && function->param_count == 2);
+    assert(function->params[1].name == intern_string("b"));
+
+    // Removing every other macro must not strand the rest of a probe run
+    for (int i = 0; i < 2000; i += 2) {
+        snprintf(name, sizeof(name), "M%d", i);
+        assert(preprocessor_undefine_macro(pp, name));
+        assert(!preprocessor_undefine_macro(pp, name));
+    }
+    assert(preprocessor_is_macro_defined(pp, "__KCC__"));
+    assert(pp->macro_count == predefined + 1001);
+    for (int i = 0; i < 2000; i++) {
+        snprintf(name, sizeof(name), "M%d", i);
+        assert(preprocessor_is_macro_defined(pp, name) == (i % 2 == 1));
+    }
+
+    preprocessor_destroy(pp);
+}
+
+// Preprocesses source and checks the output, ignoring the lines that held
+// directives
+static void expect_expansion(const char *source, const char *expected) {
+    Preprocessor *pp = preprocessor_create();
+    char *output = preprocessor_process_string(pp, source, "expand.c");
+    assert(output != NULL);
+
+    const char *p = output;
+    while (*p == '\n') p++;
+    size_t length = strlen(p);
+    while (length > 0 && p[length - 1] == '\n') length--;
+    if (length != strlen(expected) || memcmp(p, expected, length) != 0) {
+        fprintf(stderr, "\nexpected: [%s]\n     got: [%.*s]\n", expected, (int)length, p);
+        assert(0);
+    }
+
+    free(output);
+    preprocessor_destroy(pp);
+}
+
+static void test_macro_expansion(void) {
+    // Hide-sets stop self-reference, directly and through other macros
+    expect_expansion("#define A B\n#define B A\nA B", "A B");
+    expect_expansion("#define z z[0]\nz", "z[0]");
+    expect_expansion("#define f(a) a*g\n#define g(a) f(a)\nf(2)(9)", "2*9*g");
+
+    // The rescanning example from C11 6.10.3.5
+    expect_expansion("#define x 3\n#define f(a) f(x * (a))\n#undef x\n#define x 2\n"
+                     "#define g f\n#define z z[0]\n#define h g(~\n#define m(a) a(w)\n"
+                     "#define w 0,1\n#define t(a) a\n"
+                     "f(y+1) + f(f(z)) % t(t(g)(0) + t)(1);",
+                     "f(2 * (y+1)) + f(2 * (f(2 * (z[0])))) % f(2 * (0)) + t(1);");
+
+    // # and ##, including placemarkers for empty arguments
+    expect_expansion("#define str(x) # x\nstr( a  \"b\\n\" )", "\"a \\\"b\\\\n\\\"\"");
+    expect_expansion("#define r(x,y) x ## y\nr(x,y) r(,y) r(x,)", "xy     y     x");
+
+    // Variadics, with the GNU comma swallowing
+    expect_expansion("#define V(fmt, ...) printf(fmt, ## __VA_ARGS__)\nV(\"a\") V(\"b\", 1, 2)",
+                     "printf(\"a\") printf(\"b\", 1, 2)");
+    expect_expansion("#define C(...) [__VA_ARGS__]\nC() C(1, (2, 3))", "[]  [1, (2, 3)]");
+
+    // A function-like name without arguments is left alone
+    expect_expansion("#define f(a) a\nint f; f (1)", "int f; 1");
+
+    // Memoized object-like expansions go stale on redefinition
+    expect_expansion("#define X 1\n#define Y X + X\nY\n#undef X\n#define X 2\nY",
+                     "1 + 1\n\n\n2 + 2");
+    expect_expansion("#define L __LINE__\nL\nL", "2\n3");
+
+    // Conditionals, nested inside skipped groups
+    expect_expansion("#if 1 + 2 * 3 == 7 && !defined(FOO)\nyes\n#else\nno\n#endif",
+                     "yes");
+    expect_expansion("#if 0\n#if 1\nbad\n#else\nbad\n#endif\n#elif defined __KCC__\nok\n#endif",
+                     "ok");
+}
+
+static void test_columns(void) {
+    // Indentation and spacing survive, so the compiler sees the source columns
+    expect_expansion("int f(int a) {\n    return a +;\n}", "int f(int a) {\n    return a +;\n}");
+
+    // Short expansions are padded back out to the source columns; a token
+    // that a longer expansion ran past keeps its separating space
+    expect_expansion("#define N 1\n    return N  +  y;", "    return 1  +  y;");
+    expect_expansion("#define N 100000\n    return N  +  y;", "    return 100000 + y;");
+
+    Preprocessor *pp = preprocessor_create();
+    char *output = preprocessor_process_string(pp, "#define N 1\nint g(int y) {\n"
+                                               "    return N  +;\n}\n", "columns.c");
+    assert(output != NULL);
+    Lexer *lexer = lexer_create(output, "columns.c");
+    Token token;
+    do {
+        token = lexer_next_token(lexer);
+    } while (token.type != TOKEN_SEMICOLON && token.type != TOKEN_EOF);
+    assert(token.type == TOKEN_SEMICOLON && token.line == 3 && token.column == 16);
+    lexer_destroy(lexer);
+    free(output);
+    preprocessor_destroy(pp);
+
+    expect_expansion("#define P +\nP+", "+ +");
+}
+
+void test_preprocessor(void) {
+    test_source_files();
+    test_macro_table();
+    test_macro_expansion();
+    test_columns();
+}
@@ -0,0 +1,250 @@
+#include "test_util.h"
+#include "../include/regalloc.h"
+#include <assert.h>
+#include <unistd.h>
+
+// A small register file makes pressure easy to build: two caller-saved
+// registers, then two callee-saved ones
+static const RegisterInfo test_regs[] = {
+    {"t0", REG_GENERAL, 8, false}, {"t1", REG_GENERAL, 8, false},
+    {"s0", REG_GENERAL, 8, true},  {"s1", REG_GENERAL, 8, true},
+};
+#define CALLEE_SAVED ((uint64_t)0xC)
+
+// The module's last function, the one being tested
+static IRFunction *last_function(IRModule *module) {
+    IRFunction *function = module->functions;
+    while (function && function->next) function = function->next;
+    assert(function);
+    return function;
+}
+
+static const LiveInterval *last_piece(const LiveInterval *piece) {
+    while (piece->next) piece = piece->next;
+    return piece;
+}
+
+// Pieces of a value follow on from each other, no register holds two values
+// at once, and values sharing a spill slot are never live at the same time
+static void check_allocation(const RegAllocation *alloc) {
+    int value_count = alloc->function->value_count;
+    for (int v = 0; v < value_count; v++) {
+        for (const LiveInterval *piece = alloc->intervals[v]; piece; piece = piece->next) {
+            assert(piece->value == v && piece->start <= piece->end);
+            assert(!piece->next || piece->next->start == piece->end + 1);
+            assert(piece->reg == REGALLOC_STACK ||
+                   (piece->reg >= 0 && piece->reg < alloc->target->num_general_regs));
+            if (piece->reg == REGALLOC_STACK) {
+                assert(alloc->spill_slot[v] >= 0 && alloc->spill_slot[v] < alloc->spill_slot_count);
+            }
+        }
+    }
+
+    for (int v = 0; v < value_count; v++) {
+        if (!alloc->intervals[v]) continue;
+        for (int w = v + 1; w < value_count; w++) {
+            if (!alloc->intervals[w]) continue;
+            for (const LiveInterval *a = alloc->intervals[v]; a; a = a->next) {
+                for (const LiveInterval *b = alloc->intervals[w]; b; b = b->next) {
+                    bool overlap = a->start <= b->end && b->start <= a->end;
+                    assert(!overlap || a->reg == REGALLOC_STACK || a->reg != b->reg);
+                }
+            }
+            if (alloc->spill_slot[v] >= 0 && alloc->spill_slot[v] == alloc->spill_slot[w]) {
+                assert(last_piece(alloc->intervals[v])->end < alloc->intervals[w]->start ||
+                       last_piece(alloc->intervals[w])->end < alloc->intervals[v]->start);
+            }
+        }
+    }
+}
+
+// Number of values that spend some time in a spill slot
+static int spilled_values(const RegAllocation *alloc) {
+    int count = 0;
+    for (int v = 0; v < alloc->function->value_count; v++) {
+        for (const LiveInterval *piece = alloc->intervals[v]; piece; piece = piece->next) {
+            if (piece->reg == REGALLOC_STACK) {
+                count++;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+// Position of the function's only call
+static int call_position(const IRFunction *function) {
+    int index = 0;
+    int position = -1;
+    for (IRBlock *block = function->entry; block; block = block->next) {
+        for (IRInstr *instr = block->first; instr; instr = instr->next, index++) {
+            if (instr->op == IR_CALL) {
+                assert(position < 0);
+                position = index * 2;
+            }
+        }
+    }
+    assert(position >= 0);
+    return position;
+}
+
+static void test_splitting(const TargetConfig *target) {
+    // Six values live at once with two registers
+    IRModule *module = test_lower_source(
+        "int f(int a, int b, int c) {\n"
+        "    int x = a + b;\n"
+        "    int y = b + c;\n"
+        "    int z = c + a;\n"
+        "    return x * y * z + a + b + c;\n"
+        "}\n");
+    RegAllocation *alloc = regalloc_function(last_function(module), target, CALLEE_SAVED);
+    assert(alloc);
+    check_allocation(alloc);
+    assert(alloc->used_callee_saved == 0);
+
+    // Some value is stored and later reloaded, the reload being a move
+    // inside its block
+    bool reloaded = false;
+    for (int v = 0; v < alloc->function->value_count; v++) {
+        for (const LiveInterval *piece = alloc->intervals[v]; piece && piece->next; piece = piece->next) {
+            reloaded |= piece->reg == REGALLOC_STACK && piece->next->reg >= 0;
+        }
+    }
+    assert(reloaded);
+    assert(alloc->move_count > 0 && alloc->spill_slot_count > 0);
+    for (int i = 0; i < alloc->move_count; i++) {
+        const RegMove *move = &alloc->moves[i];
+        assert(!regalloc_same_location(move->from, move->to));
+        assert(i == 0 || alloc->moves[i - 1].position <= move->position);
+    }
+    regalloc_destroy(alloc);
+    ir_module_destroy(module);
+}
+
+static void test_slot_sharing(const TargetConfig *target) {
+    // Two bursts of pressure, the first dead before the second starts
+    IRModule *module = test_lower_source(
+        "int f(int a, int b) {\n"
+        "    int p = a + 1;\n"
+        "    int q = a + 2;\n"
+        "    int r = a + 3;\n"
+        "    int s = p * q * r + a;\n"
+        "    int t = s + 1;\n"
+        "    int u = s + 2;\n"
+        "    int w = s + 3;\n"
+        "    return t * u * w + s + b;\n"
+        "}\n");
+    RegAllocation *alloc = regalloc_function(last_function(module), target, CALLEE_SAVED);
+    assert(alloc);
+    check_allocation(alloc);
+    assert(alloc->spill_slot_count > 0);
+    assert(alloc->spill_slot_count < spilled_values(alloc));
+    regalloc_destroy(alloc);
+    ir_module_destroy(module);
+}
+
+static void test_callee_saved(const TargetConfig *target) {
+    IRModule *module = test_lower_source(
+        "int g(int x);\n"
+        "int f(int a) {\n"
+        "    int keep = a * 3;\n"
+        "    int r = g(a);\n"
+        "    return keep + r;\n"
+        "}\n");
+    IRFunction *function = last_function(module);
+    int call = call_position(function);
+
+    // A value live across the call goes to a callee-saved register, which
+    // the function then has to save
+    RegAllocation *alloc = regalloc_function(function, target, 0);
+    check_allocation(alloc);
+    int keep = -1;
+    for (int v = 0; v < function->value_count; v++) {
+        const LiveInterval *piece = alloc->intervals[v];
+        if (piece && piece->start < call && last_piece(piece)->end > call + 1) keep = v;
+    }
+    assert(keep >= 0);
+    RegLocation at_call = regalloc_location(alloc, keep, call);
+    assert(at_call.reg >= 0 && test_regs[at_call.reg].preserved);
+    assert(alloc->used_callee_saved == (uint64_t)1 << at_call.reg);
+    regalloc_destroy(alloc);
+
+    // Without callee-saved registers it waits out the call on the stack
+    alloc = regalloc_function(function, target, CALLEE_SAVED);
+    check_allocation(alloc);
+    assert(alloc->used_callee_saved == 0);
+    assert(regalloc_location(alloc, keep, call).reg == REGALLOC_STACK);
+    assert(regalloc_location(alloc, keep, last_piece(alloc->intervals[keep])->end).reg >= 0);
+    regalloc_destroy(alloc);
+    ir_module_destroy(module);
+
+    // Nothing crosses a call: caller-saved registers cost nothing and are
+    // preferred
+    module = test_lower_source("int h(int a, int b) { int c = a + b; return c * a; }");
+    alloc = regalloc_function(last_function(module), target, 0);
+    check_allocation(alloc);
+    assert(alloc->used_callee_saved == 0 && alloc->spill_slot_count == 0);
+    regalloc_destroy(alloc);
+    ir_module_destroy(module);
+}
+
+// Generates x86-64 assembly for source and returns the text
+static char *generate_x86_64(const char *source) {
+    char path[] = "/tmp/kcc_regalloc_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    test_generate(source, path, ARCH_X86_64, PLATFORM_LINUX);
+
+    FILE *file = fopen(path, "rb");
+    assert(file);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = malloc((size_t)size + 1);
+    assert(text && fread(text, 1, (size_t)size, file) == (size_t)size);
+    text[size] = '\0';
+    fclose(file);
+    unlink(path);
+    return text;
+}
+
+static void test_save_restore(void) {
+    // The callee-saved register is pushed after the frame is set up and
+    // popped before it is torn down
+    char *text = generate_x86_64(
+        "int g(int x);\n"
+        "int f(int a) {\n"
+        "    int keep = a * 3;\n"
+        "    int r = g(a);\n"
+        "    return keep + r;\n"
+        "}\n");
+    const char *frame = strstr(text, "    movq %rsp, %rbp\n");
+    const char *push = strstr(text, "    pushq %rbx\n");
+    const char *call = strstr(text, "    call g\n");
+    const char *pop = strstr(text, "    popq %rbx\n");
+    const char *ret = strstr(text, "    popq %rbp\n    ret\n");
+    assert(frame && push && call && pop && ret);
+    assert(frame < push && push < call && call < pop && pop < ret);
+    assert(!strstr(push + 1, "    pushq %rbx\n") && !strstr(pop + 1, "    popq %rbx\n"));
+    free(text);
+
+    // A leaf function saves nothing
+    text = generate_x86_64("int h(int a, int b) { int c = a + b; return c * a; }");
+    assert(strstr(text, "h:\n") && !strstr(text, "    pushq %rbx\n"));
+    assert(!strstr(text, "    pushq %r12\n"));
+    free(text);
+}
+
+void test_regalloc(void) {
+    TargetConfig target = {0};
+    target.arch = ARCH_UNKNOWN;
+    target.general_regs = test_regs;
+    target.num_general_regs = (int)(sizeof(test_regs) / sizeof(test_regs[0]));
+
+    test_splitting(&target);
+    test_slot_sharing(&target);
+    test_callee_saved(&target);
+    test_save_restore();
+}
@@ -0,0 +1,134 @@
+#include "../include/kcc.h"
+#include "../include/sh2_assembler.h"
+#include <assert.h>
+#include <unistd.h>
+
+// Assembles source into a flat image at base and checks it byte for byte
+static void expect_binary(const char *source, uint32_t base,
+                          const unsigned char *expected, size_t length) {
+    char path[] = "/tmp/kcc_sh2_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    SH2Assembler *as = sh2_asm_create();
+    sh2_asm_source(as, source, strlen(source));
+    assert(sh2_asm_error_count(as) == 0);
+    assert(sh2_asm_write_binary(as, path, base));
+    sh2_asm_destroy(as);
+
+    FILE *file = fopen(path, "rb");
+    assert(file);
+    unsigned char *image = malloc(length + 1);
+    size_t size = fread(image, 1, length + 1, file);
+    fclose(file);
+    if (size != length || memcmp(image, expected, length) != 0) {
+        fprintf(stderr, "\nimage:");
+        for (size_t i = 0; i < size; i++) fprintf(stderr, " %02x", image[i]);
+        fprintf(stderr, "\n");
+        assert(0);
+    }
+    free(image);
+    unlink(path);
+}
+
+void test_sh2_assembler(void) {
+    // Immediate forms and a bt within reach
+    static const unsigned char branch[] = {
+        0xe0, 0x01,                  // mov #1,r0
+        0x88, 0x01,                  // cmp/eq #1,r0
+        0x89, 0x00,                  // bt done
+        0x70, 0x01,                  // add #1,r0
+        0x00, 0x0b,                  // done: rts
+        0x00, 0x09,                  // nop
+    };
+    expect_binary("_f:\n"
+                  "    mov #1,r0\n"
+                  "    cmp/eq #1,r0\n"
+                  "    bt done\n"
+                  "    add #1,r0\n"
+                  "done:\n"
+                  "    rts\n"
+                  "    nop\n",
+                  0, branch, sizeof(branch));
+
+    // A bf out of reach becomes bt over a bra with a nop in its delay slot
+    enum { GAP = 300 };
+    unsigned char relaxed[6 + GAP + 4] = {
+        0x89, 0x01,                  // bt .+6
+        0xa0, 0x96,                  // bra far (disp 300)
+        0x00, 0x09,                  // nop
+    };
+    relaxed[6 + GAP] = 0x00;
+    relaxed[6 + GAP + 1] = 0x0b;     // far: rts
+    relaxed[6 + GAP + 2] = 0x00;
+    relaxed[6 + GAP + 3] = 0x09;     // nop
+    expect_binary("    bf far\n"
+                  "    .space 300\n"
+                  "far:\n"
+                  "    rts\n"
+                  "    nop\n",
+                  0, relaxed, sizeof(relaxed));
+
+    // Literals land after the delay slot of rts: longs aligned first, then
+    // words; .L_<name> loads the address of _<name>
+    static const unsigned char pool[] = {
+        0xd1, 0x02,                  // mov.l @(8,pc),r1
+        0x92, 0x07,                  // mov.w @(14,pc),r2
+        0xd3, 0x02,                  // mov.l @(8,pc),r3
+        0x00, 0x0b,                  // rts
+        0x00, 0x09,                  // nop
+        0x00, 0x00,                  // alignment
+        0x12, 0x34, 0x56, 0x78,      // 0x12345678
+        0x06, 0x00, 0x40, 0x00,      // _main
+        0x03, 0xe8,                  // 1000
+    };
+    expect_binary("_main:\n"
+                  "    mov.l .L_const_305419896,r1\n"
+                  "    mov.w .L_const_1000,r2\n"
+                  "    mov.l .L_main,r3\n"
+                  "    rts\n"
+                  "    nop\n",
+                  0x06004000, pool, sizeof(pool));
+
+    // .pool places pending literals where it stands
+    static const unsigned char ltorg[] = {
+        0xd1, 0x01,                  // mov.l @(4,pc),r1
+        0x00, 0x0b,                  // rts
+        0x00, 0x09,                  // nop
+        0x00, 0x00,                  // alignment
+        0x00, 0x00, 0x00, 0x2a,      // 42
+        0xe0, 0x00,                  // mov #0,r0
+    };
+    expect_binary("    mov.l .L_const_42,r1\n"
+                  "    rts\n"
+                  "    nop\n"
+                  "    .pool\n"
+                  "    mov #0,r0\n",
+                  0, ltorg, sizeof(ltorg));
+
+    // With no branch within reach, the pool goes behind an inserted bra
+    enum { BODY = 1100 };
+    unsigned char forced[12 + BODY + 4] = {
+        0xd1, 0x01,                  // mov.l @(4,pc),r1
+        0xa0, 0x03,                  // bra .+12
+        0x00, 0x09,                  // nop
+        0x00, 0x00,                  // alignment
+        0x00, 0x00, 0x00, 0x07,      // 7
+    };
+    forced[12 + BODY + 1] = 0x0b;
+    forced[12 + BODY + 3] = 0x09;
+    expect_binary("    mov.l .L_const_7,r1\n"
+                  "    .space 1100\n"
+                  "    rts\n"
+                  "    nop\n",
+                  0, forced, sizeof(forced));
+
+    // Undefined symbols cannot go into a flat image
+    SH2Assembler *as = sh2_asm_create();
+    const char *call = "    mov.l .L_missing,r1\n    jsr @r1\n    nop\n";
+    sh2_asm_source(as, call, strlen(call));
+    assert(!sh2_asm_write_binary(as, "/tmp/kcc_sh2_never_written.bin", 0));
+    sh2_asm_destroy(as);
+    unlink("/tmp/kcc_sh2_never_written.bin");
+}
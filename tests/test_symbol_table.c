@@ -0,0 +1,76 @@
+#include "../include/kcc.h"
+#include "../include/symbol_table.h"
+#include <assert.h>
+
+void test_symbol_table(void) {
+    SymbolTable *table = symbol_table_create();
+    const char *x = intern_string("x");
+    const char *y = intern_string("y");
+
+    // Names are handles: lookups compare pointers
+    assert(symbol_table_insert(table, x, SYMBOL_VARIABLE, TYPE_INT));
+    assert(!symbol_table_insert(table, x, SYMBOL_VARIABLE, TYPE_INT));
+    Symbol *outer = symbol_table_lookup(table, x);
+    assert(outer != NULL && outer->name == x && outer->scope_level == 0);
+    assert(symbol_table_lookup(table, y) == NULL);
+
+    // Inner scopes shadow, and leaving them uncovers the outer symbol
+    symbol_table_enter_scope(table);
+    assert(symbol_table_lookup_current_scope(table, x) == NULL);
+    assert(symbol_table_insert(table, x, SYMBOL_VARIABLE, TYPE_CHAR));
+    assert(symbol_table_insert(table, y, SYMBOL_VARIABLE, TYPE_INT));
+    assert(symbol_table_lookup(table, x)->data_type == TYPE_CHAR);
+    symbol_table_exit_scope(table);
+    assert(symbol_table_lookup(table, x) == outer);
+    assert(symbol_table_lookup(table, y) == NULL);
+    assert(table->count == 1);
+
+    symbol_table_destroy(table);
+
+    // Growing past the initial buckets, with every name shadowed in a nest
+    // of scopes, keeps chains newest first
+    table = symbol_table_create();
+    enum { NAMES = 500, DEPTH = 40 };
+    const char *names[NAMES];
+    char buffer[32];
+    for (int i = 0; i < NAMES; i++) {
+        snprintf(buffer, sizeof(buffer), "sym_%d", i);
+        names[i] = intern_string(buffer);
+        assert(symbol_table_insert(table, names[i], SYMBOL_VARIABLE, TYPE_INT));
+    }
+    assert(table->capacity > SYMBOL_TABLE_INITIAL_CAPACITY);
+    assert(table->count * 4 <= table->capacity * 3);
+
+    for (int depth = 1; depth <= DEPTH; depth++) {
+        symbol_table_enter_scope(table);
+        // Each scope shadows a different slice, so shadowed names are spread
+        // over scopes and some growth happens while scopes are open
+        for (int i = depth; i < NAMES; i += depth) {
+            assert(symbol_table_insert(table, names[i], SYMBOL_VARIABLE, TYPE_INT));
+            symbol_table_lookup(table, names[i])->line = depth;
+        }
+    }
+    assert(table->current_scope == DEPTH && table->max_scope_seen == DEPTH);
+
+    for (int depth = DEPTH; depth >= 0; depth--) {
+        for (int i = 0; i < NAMES; i++) {
+            // The innermost open scope that declared the name wins
+            int expected = 0;
+            for (int d = depth; d >= 1; d--) {
+                if (i >= d && i % d == 0) {
+                    expected = d;
+                    break;
+                }
+            }
+            Symbol *symbol = symbol_table_lookup(table, names[i]);
+            assert(symbol && symbol->scope_level == expected && symbol->line == expected);
+            assert((symbol_table_lookup_current_scope(table, names[i]) != NULL) ==
+                   (expected == depth));
+        }
+        symbol_table_exit_scope(table);
+    }
+
+    // Exiting the outermost scope is a no-op
+    assert(table->current_scope == 0 && table->count == NAMES);
+    symbol_table_destroy(table);
+}
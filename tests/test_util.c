@@ -0,0 +1,38 @@
+#include "test_util.h"
+#include <assert.h>
+#include <limits.h>
+
+IRModule *test_lower_source(const char *source) {
+    Lexer *lexer = lexer_create(source, "test_file");
+    Parser *parser = parser_create(lexer);
+    ASTNode *ast = parser_parse_program(parser);
+    assert(ast != NULL);
+    IRModule *module = ir_lower_program(ast);
+    assert(module != NULL);
+    ast_destroy(ast);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    return module;
+}
+
+void test_generate(const char *source, const char *path, TargetArch arch, TargetPlatform platform) {
+    Lexer *lexer = lexer_create(source, "test_file");
+    Parser *parser = parser_create(lexer);
+    ASTNode *ast = parser_parse_program(parser);
+    assert(ast != NULL);
+    MultiArchCodegen *codegen = multiarch_codegen_create(path, arch, platform);
+    assert(codegen && multiarch_codegen_generate(codegen, ast));
+    multiarch_codegen_destroy(codegen);
+    ast_destroy(ast);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+}
+
+void test_write_file(const char *dir, const char *name, const char *text) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *file = fopen(path, "w");
+    assert(file != NULL);
+    fputs(text, file);
+    fclose(file);
+}
@@ -0,0 +1,20 @@
+#ifndef KCC_TEST_UTIL_H
+#define KCC_TEST_UTIL_H
+
+#include "../include/kcc.h"
+#include "../include/ir.h"
+#include "../include/multiarch_codegen.h"
+
+// Helpers shared by the test files
+
+// Parses source and lowers it to IR; the module is the caller's to destroy
+IRModule *test_lower_source(const char *source);
+
+// Parses source and writes the IR backend's assembly for arch and platform
+// to path
+void test_generate(const char *source, const char *path, TargetArch arch, TargetPlatform platform);
+
+// Writes text to dir/name
+void test_write_file(const char *dir, const char *name, const char *text);
+
+#endif // KCC_TEST_UTIL_H
@@ -0,0 +1,211 @@
+#include "../include/kcc.h"
+#include "../include/elf_writer.h"
+#include "../include/x86_64_assembler.h"
+#include <assert.h>
+#include <unistd.h>
+
+// Little-endian fields of the ELF64 file
+static uint64_t read_le(const unsigned char *p, int size) {
+    uint64_t value = 0;
+    for (int i = size - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+// Reads the whole object into memory; *size receives its length
+static unsigned char *read_object(const char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    assert(file);
+    fseek(file, 0, SEEK_END);
+    *size = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    unsigned char *data = malloc(*size);
+    assert(data && fread(data, 1, *size, file) == *size);
+    fclose(file);
+    return data;
+}
+
+// Finds a section by name; returns its contents and sets *size, or NULL
+static const unsigned char *find_section(const unsigned char *elf, const char *name,
+                                         uint64_t *size) {
+    uint64_t shoff = read_le(elf + 0x28, 8);
+    int shentsize = (int)read_le(elf + 0x3A, 2);
+    int shnum = (int)read_le(elf + 0x3C, 2);
+    int shstrndx = (int)read_le(elf + 0x3E, 2);
+    const unsigned char *strtab_header = elf + shoff + (uint64_t)shstrndx * shentsize;
+    const char *strtab = (const char *)elf + read_le(strtab_header + 24, 8);
+
+    for (int i = 1; i < shnum; i++) {
+        const unsigned char *header = elf + shoff + (uint64_t)i * shentsize;
+        if (strcmp(strtab + read_le(header, 4), name) == 0) {
+            *size = read_le(header + 32, 8);
+            return elf + read_le(header + 24, 8);
+        }
+    }
+    return NULL;
+}
+
+// Writes the object and checks that .text holds exactly the expected bytes
+static void expect_text(X86Assembler *as, const unsigned char *expected, size_t length) {
+    char path[] = "/tmp/kcc_x86_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    assert(x86_asm_error_count(as) == 0);
+    assert(x86_asm_write_object(as, path));
+
+    size_t size;
+    unsigned char *elf = read_object(path, &size);
+    assert(size > 64 && memcmp(elf, "\177ELF", 4) == 0);
+    assert(elf[4] == 2 && elf[5] == 1);                 // ELFCLASS64, little-endian
+    assert(read_le(elf + 16, 2) == 1);                  // ET_REL
+    assert(read_le(elf + 18, 2) == ELF_EM_X86_64);
+
+    uint64_t text_size;
+    const unsigned char *text = find_section(elf, ".text", &text_size);
+    assert(text);
+    if (text_size != length || memcmp(text, expected, length) != 0) {
+        fprintf(stderr, "\n.text:");
+        for (uint64_t i = 0; i < text_size; i++) fprintf(stderr, " %02x", text[i]);
+        fprintf(stderr, "\n");
+        assert(0);
+    }
+
+    // The call to an undefined function is left to the linker
+    uint64_t rela_size;
+    assert(find_section(elf, ".rela.text", &rela_size) && rela_size == 24);
+    free(elf);
+    unlink(path);
+}
+
+static X86Instruction insn1(X86Opcode opcode, int size, X86Operand operand) {
+    return (X86Instruction){.opcode = opcode, .size = size, .operands = {operand},
+                            .operand_count = 1};
+}
+
+static X86Instruction insn2(X86Opcode opcode, int size, X86Operand src, X86Operand dst) {
+    return (X86Instruction){.opcode = opcode, .size = size, .operands = {src, dst},
+                            .operand_count = 2};
+}
+
+void test_x86_assembler(void) {
+    X86Instruction sequence[] = {
+        insn1(X86_PUSH, 8, x86_reg(X86_RBP, 8)),
+        insn2(X86_MOV, 8, x86_reg(X86_RSP, 8), x86_reg(X86_RBP, 8)),
+        insn2(X86_SUB, 8, x86_imm(32), x86_reg(X86_RSP, 8)),
+        // L0:
+        insn2(X86_MOV, 8, x86_imm(0x12345678), x86_reg(X86_R8, 8)),
+        {.opcode = X86_MOVSX, .size = 8, .source_size = 4,
+         .operands = {x86_mem(X86_RBP, -16), x86_reg(X86_RCX, 8)}, .operand_count = 2},
+        {.opcode = X86_MOVZX, .size = 8, .source_size = 1,
+         .operands = {x86_reg(X86_RCX, 1), x86_reg(X86_RCX, 8)}, .operand_count = 2},
+        insn2(X86_MOV, 4, x86_reg(X86_RCX, 4), x86_mem(X86_RBP, -4)),
+        insn2(X86_MOV, 1, x86_reg(X86_RCX, 1), x86_mem(X86_RBP, -17)),
+        insn2(X86_MOV, 1, x86_reg(X86_RSI, 1), x86_mem(X86_RSP, 0)),
+        {.opcode = X86_CQTO},
+        insn1(X86_IDIV, 8, x86_mem(X86_RSP, 0)),
+        {.opcode = X86_SETCC, .condition = X86_CC_L, .operands = {x86_reg(X86_RCX, 1)},
+         .operand_count = 1},
+        insn2(X86_IMUL, 8, x86_imm(2), x86_reg(X86_RSI, 8)),
+        // Backward branches are short, forward ones near
+        {.opcode = X86_JCC, .condition = X86_CC_E, .operands = {x86_sym("L0")},
+         .operand_count = 1},
+        insn1(X86_JMP, 0, x86_sym("L0")),
+        {.opcode = X86_JCC, .condition = X86_CC_NE, .operands = {x86_sym("L1")},
+         .operand_count = 1},
+        insn1(X86_JMP, 0, x86_sym("L1")),
+        insn1(X86_CALL, 0, x86_sym("_external")),
+        // L1:
+        {.opcode = X86_RET},
+    };
+    const int count = (int)(sizeof(sequence) / sizeof(sequence[0]));
+    static const unsigned char expected[] = {
+        0x55,
+        0x48, 0x89, 0xe5,
+        0x48, 0x83, 0xec, 0x20,
+        0x49, 0xc7, 0xc0, 0x78, 0x56, 0x34, 0x12,
+        0x48, 0x63, 0x4d, 0xf0,
+        0x48, 0x0f, 0xb6, 0xc9,
+        0x89, 0x4d, 0xfc,
+        0x88, 0x4d, 0xef,
+        0x40, 0x88, 0x34, 0x24,
+        0x48, 0x99,
+        0x48, 0xf7, 0x3c, 0x24,
+        0x0f, 0x9c, 0xc1,
+        0x48, 0x6b, 0xf6, 0x02,
+        0x74, 0xd8,
+        0xeb, 0xd6,
+        0x0f, 0x85, 0x0a, 0x00, 0x00, 0x00,
+        0xe9, 0x05, 0x00, 0x00, 0x00,
+        0xe8, 0x00, 0x00, 0x00, 0x00,
+        0xc3,
+    };
+
+    // Encoded directly, as the code generator does
+    X86Assembler *as = x86_asm_create();
+    x86_asm_global(as, "_f");
+    x86_asm_label(as, "_f");
+    for (int i = 0; i < count; i++) {
+        if (i == 3) x86_asm_label(as, "L0");
+        if (i == count - 1) x86_asm_label(as, "L1");
+        x86_asm_encode(as, &sequence[i]);
+    }
+    expect_text(as, expected, sizeof(expected));
+    x86_asm_destroy(as);
+
+    // Printed as -S does and assembled from the text: the same bytes
+    AsmBuffer text;
+    assert(asm_buffer_init(&text, NULL));
+    asm_buffer_puts(&text, ".globl _f\n_f:\n");
+    for (int i = 0; i < count; i++) {
+        if (i == 3) asm_buffer_puts(&text, "L0:\n");
+        if (i == count - 1) asm_buffer_puts(&text, "L1:\n");
+        asm_buffer_puts(&text, "    ");
+        x86_asm_format(&text, &sequence[i]);
+        asm_buffer_putc(&text, '\n');
+    }
+    as = x86_asm_create();
+    x86_asm_source(as, text.data, text.length);
+    expect_text(as, expected, sizeof(expected));
+    x86_asm_destroy(as);
+
+    // AT&T spellings
+    static const struct { int index; const char *text; } spellings[] = {
+        {0, "pushq   %rbp"}, {3, "movq    $305419896, %r8"}, {4, "movslq  -16(%rbp), %rcx"},
+        {5, "movzbq  %cl, %rcx"}, {7, "movb    %cl, -17(%rbp)"}, {8, "movb    %sil, (%rsp)"},
+        {9, "cqto"}, {10, "idivq   (%rsp)"}, {11, "setl    %cl"}, {13, "je      L0"},
+        {14, "jmp     L0"}, {17, "callq   _external"}, {18, "ret"},
+    };
+    for (size_t i = 0; i < sizeof(spellings) / sizeof(spellings[0]); i++) {
+        asm_buffer_reset(&text);
+        x86_asm_format(&text, &sequence[spellings[i].index]);
+        asm_buffer_putc(&text, '\0');
+        if (strcmp(text.data, spellings[i].text) != 0) {
+            fprintf(stderr, "\nexpected: [%s]\n     got: [%s]\n", spellings[i].text, text.data);
+            assert(0);
+        }
+    }
+    X86Operand literal = x86_imm(8);
+    literal.symbol = "string_literal_0";
+    X86Instruction load = insn2(X86_MOV, 8, literal, x86_reg(X86_R11, 8));
+    asm_buffer_reset(&text);
+    x86_asm_format(&text, &load);
+    asm_buffer_putc(&text, '\0');
+    assert(strcmp(text.data, "movq    $string_literal_0+8, %r11") == 0);
+    X86Instruction cmov = insn2(X86_CMOVCC, 2, x86_reg(X86_R9, 2), x86_reg(X86_RSI, 2));
+    cmov.condition = X86_CC_GE;
+    asm_buffer_reset(&text);
+    x86_asm_format(&text, &cmov);
+    asm_buffer_putc(&text, '\0');
+    assert(strcmp(text.data, "cmovgew %r9w, %si") == 0);
+    asm_buffer_free(&text);
+
+    // Bad operands are reported and keep the object from being written
+    as = x86_asm_create();
+    X86Instruction bad = insn2(X86_LEA, 8, x86_imm(1), x86_reg(X86_RAX, 8));
+    x86_asm_encode(as, &bad);
+    assert(x86_asm_error_count(as) == 1);
+    assert(!x86_asm_write_object(as, "/tmp/kcc_x86_never_written.o"));
+    x86_asm_destroy(as);
+}
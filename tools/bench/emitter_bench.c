@@ -0,0 +1,186 @@
+// Assembly emitter throughput benchmark.
+// Generates code for a parsed program (a file, or a synthetic one when none
+// is given) and reports MB/s of assembly written, then formats a fixed
+// instruction mix through stdio and through the emitters' AsmBuffer and
+// reports MB/s for both.
+//
+//   emitter_bench [-n iterations] [file ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "kcc.h"
+#include "asm_buffer.h"
+
+#define SYNTHETIC_FUNCTIONS 20000
+#define MIX_LINES (4 * 1024 * 1024)
+
+static double bench_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Branchy functions, so labels and jumps are part of the output
+static char *bench_synthetic_input(int functions) {
+    static const char *snippet =
+        "int accumulate_%d(int count) {\n"
+        "    int total = 0;\n"
+        "    int index;\n"
+        "    for (index = 0; index < count; index = index + 1) {\n"
+        "        if (index > 3) { total = total + index * 42; } else { total = total - 1; }\n"
+        "    }\n"
+        "    while (total > 100) { total = total - 7; }\n"
+        "    return total;\n"
+        "}\n\n";
+    size_t size = (strlen(snippet) + 16) * (size_t)functions + 1;
+
+    char *input = malloc(size);
+    if (!input) return NULL;
+
+    size_t used = 0;
+    for (int i = 0; i < functions; i++) {
+        used += (size_t)snprintf(input + used, size - used, snippet, i);
+    }
+    return input;
+}
+
+static off_t bench_file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? st.st_size : 0;
+}
+
+static int bench_codegen(const char *name, const char *input, int iterations, const char *path) {
+    Lexer *lexer = lexer_create(input, name);
+    Parser *parser = lexer ? parser_create(lexer) : NULL;
+    ASTNode *ast = parser ? parser_parse_program(parser) : NULL;
+    if (!ast || error_has_errors()) {
+        fprintf(stderr, "%s: parsing failed\n", name);
+        if (ast) ast_destroy(ast);
+        if (parser) parser_destroy(parser);
+        if (lexer) lexer_destroy(lexer);
+        return 1;
+    }
+
+    double seconds = 0;
+    bool ok = true;
+    for (int i = 0; i < iterations && ok; i++) {
+        double start = bench_now();
+        CodeGenerator *codegen = codegen_create(path);
+        ok = codegen && codegen_generate(codegen, ast);
+        if (codegen) codegen_destroy(codegen);
+        seconds += bench_now() - start;
+    }
+
+    double megabytes = (double)bench_file_size(path) * iterations / (1024.0 * 1024.0);
+    if (ok) {
+        printf("%s: codegen %.1f MB x %d\n", name, megabytes / iterations, iterations);
+        printf("  %-8s %8.1f MB/s\n", "codegen", megabytes / seconds);
+    } else {
+        fprintf(stderr, "%s: code generation failed\n", name);
+    }
+
+    ast_destroy(ast);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    return ok ? 0 : 1;
+}
+
+// The same lines through fprintf and through asm_buffer_format
+static int bench_mix(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) return 1;
+
+    double start = bench_now();
+    for (int i = 0; i < MIX_LINES; i += 4) {
+        fprintf(file, "    movq    %d(%%rbp), %%rax\n", -8 * (i & 63));
+        fprintf(file, "    addq    $%d, %%rax\n", i);
+        fprintf(file, "    jz      L%d\n", i >> 2);
+        fprintf(file, "L%d:\n", i >> 2);
+    }
+    fclose(file);
+    double stdio_seconds = bench_now() - start;
+    double stdio_megabytes = (double)bench_file_size(path) / (1024.0 * 1024.0);
+
+    file = fopen(path, "w");
+    if (!file) return 1;
+
+    AsmBuffer buffer;
+    start = bench_now();
+    bool ok = asm_buffer_init(&buffer, file);
+    for (int i = 0; ok && i < MIX_LINES; i += 4) {
+        asm_buffer_format(&buffer, "    movq    %d(%%rbp), %%rax\n", -8 * (i & 63));
+        asm_buffer_format(&buffer, "    addq    $%d, %%rax\n", i);
+        asm_buffer_format(&buffer, "    jz      L%d\n", i >> 2);
+        asm_buffer_format(&buffer, "L%d:\n", i >> 2);
+    }
+    ok = ok && asm_buffer_flush(&buffer);
+    asm_buffer_free(&buffer);
+    fclose(file);
+    double buffer_seconds = bench_now() - start;
+    double buffer_megabytes = (double)bench_file_size(path) / (1024.0 * 1024.0);
+
+    printf("instruction mix: %.1f MB\n", buffer_megabytes);
+    printf("  %-8s %8.1f MB/s\n", "stdio", stdio_megabytes / stdio_seconds);
+    printf("  %-8s %8.1f MB/s  (%.2fx)\n", "buffer", buffer_megabytes / buffer_seconds,
+           stdio_seconds / buffer_seconds);
+
+    if (!ok || stdio_megabytes != buffer_megabytes) {
+        fprintf(stderr, "instruction mix: stdio and buffer output differ in size\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = 5;
+    int failures = 0;
+    int files = 0;
+
+    char path[] = "/tmp/emitter_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot create a temporary file\n");
+        return 1;
+    }
+    close(fd);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+            if (iterations < 1) iterations = 1;
+            continue;
+        }
+
+        char *input = read_file(argv[i]);
+        if (!input) {
+            fprintf(stderr, "Cannot read %s\n", argv[i]);
+            failures++;
+            continue;
+        }
+        failures += bench_codegen(argv[i], input, iterations, path);
+        free(input);
+        files++;
+    }
+
+    if (files == 0 && failures == 0) {
+        char *input = bench_synthetic_input(SYNTHETIC_FUNCTIONS);
+        if (!input) {
+            fprintf(stderr, "Cannot allocate synthetic input\n");
+            remove(path);
+            return 1;
+        }
+        failures += bench_codegen("synthetic", input, iterations, path);
+        free(input);
+    }
+
+    failures += bench_mix(path);
+
+    remove(path);
+    intern_table_destroy();
+    return failures ? 1 : 0;
+}
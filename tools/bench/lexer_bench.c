@@ -0,0 +1,140 @@
+// Lexer throughput benchmark.
+// Tokenizes one or more source files (or a synthetic input when none is
+// given) with the scalar scanner and with the vector scanner, reports MB/s
+// for both and checks that the two token streams agree.
+//
+//   lexer_bench [-n iterations] [file ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "kcc.h"
+#include "lexer.h"
+#include "lexer_scan.h"
+
+#define SYNTHETIC_SIZE (8 * 1024 * 1024)
+
+typedef struct {
+    double seconds;
+    size_t tokens;
+    unsigned long checksum;
+} BenchResult;
+
+static double bench_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static char *bench_synthetic_input(size_t size) {
+    static const char *snippet =
+        "/* Block comment describing the function below,\n"
+        " * spread over a few lines like real headers do. */\n"
+        "static int accumulate_values(int count, int initial_value) {\n"
+        "    int total_sum = initial_value;   // running total\n"
+        "    for (int index = 0; index < count; index = index + 1) {\n"
+        "        total_sum = total_sum + index * 42;\n"
+        "    }\n"
+        "    printf(\"total: %d \\\"done\\\"\\n\", total_sum);\n"
+        "    return total_sum;\n"
+        "}\n\n";
+    size_t snippet_length = strlen(snippet);
+
+    char *input = malloc(size + 1);
+    if (!input) return NULL;
+
+    size_t used = 0;
+    while (used + snippet_length <= size) {
+        memcpy(input + used, snippet, snippet_length);
+        used += snippet_length;
+    }
+    input[used] = '\0';
+    return input;
+}
+
+static BenchResult bench_run(const char *input, int iterations) {
+    BenchResult result = {0.0, 0, 0};
+
+    for (int i = 0; i < iterations; i++) {
+        Lexer *lexer = lexer_create(input, "bench.c");
+        size_t count = 0;
+
+        double start = bench_now();
+        Token *tokens = lexer_tokenize(lexer, &count);
+        result.seconds += bench_now() - start;
+
+        unsigned long checksum = 0;
+        for (size_t t = 0; t < count; t++) {
+            checksum = checksum * 31 + (unsigned long)tokens[t].type * 7 +
+                       tokens[t].offset + (unsigned long)tokens[t].line +
+                       (unsigned long)tokens[t].column * 13;
+        }
+        result.tokens = count;
+        result.checksum = checksum;
+
+        free(tokens);
+        lexer_destroy(lexer);
+    }
+
+    return result;
+}
+
+static int bench_input(const char *name, const char *input, int iterations) {
+    double megabytes = (double)strlen(input) * iterations / (1024.0 * 1024.0);
+
+    lexer_scan_set_vector(false);
+    BenchResult scalar = bench_run(input, iterations);
+
+    lexer_scan_set_vector(true);
+    BenchResult vector = bench_run(input, iterations);
+
+    printf("%s: %.1f MB x %d, %zu tokens\n", name, megabytes / iterations, iterations, vector.tokens);
+    printf("  %-8s %8.1f MB/s\n", "scalar", megabytes / scalar.seconds);
+    printf("  %-8s %8.1f MB/s  (%.2fx)\n", lexer_scan_backend_name(),
+           megabytes / vector.seconds, scalar.seconds / vector.seconds);
+
+    if (scalar.tokens != vector.tokens || scalar.checksum != vector.checksum) {
+        fprintf(stderr, "%s: scalar and vector token streams differ\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = 10;
+    int failures = 0;
+    int files = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+            if (iterations < 1) iterations = 1;
+            continue;
+        }
+
+        char *input = read_file(argv[i]);
+        if (!input) {
+            fprintf(stderr, "Cannot read %s\n", argv[i]);
+            failures++;
+            continue;
+        }
+        failures += bench_input(argv[i], input, iterations);
+        free(input);
+        files++;
+    }
+
+    if (files == 0 && failures == 0) {
+        char *input = bench_synthetic_input(SYNTHETIC_SIZE);
+        if (!input) {
+            fprintf(stderr, "Cannot allocate synthetic input\n");
+            return 1;
+        }
+        failures += bench_input("synthetic", input, iterations);
+        free(input);
+    }
+
+    intern_table_destroy();
+    return failures ? 1 : 0;
+}
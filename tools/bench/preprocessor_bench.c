@@ -0,0 +1,132 @@
+// Preprocessor throughput benchmark.
+// Runs one or more files (or a synthetic macro-heavy input when none is
+// given) through the preprocessor and reports MB/s of source consumed.
+//
+//   preprocessor_bench [-n iterations] [file ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "kcc.h"
+#include "preprocessor.h"
+
+#define SYNTHETIC_SIZE (4 * 1024 * 1024)
+
+static double bench_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Platform-header style input: layered feature macros, function-like
+// helpers with # and ##, and code that uses them over and over
+static char *bench_synthetic_input(size_t size) {
+    static const char *prologue =
+        "#define KCC_PLATFORM_LINUX 1\n"
+        "#define KCC_ARCH_BITS 64\n"
+        "#define KCC_ALIGNMENT (KCC_ARCH_BITS / 8)\n"
+        "#define KCC_PAGE_SIZE (4096 * KCC_ALIGNMENT / KCC_ALIGNMENT)\n"
+        "#define KCC_CONCAT(a, b) a ## b\n"
+        "#define KCC_XCONCAT(a, b) KCC_CONCAT(a, b)\n"
+        "#define KCC_STR(x) #x\n"
+        "#define KCC_XSTR(x) KCC_STR(x)\n"
+        "#define KCC_MIN(a, b) ((a) < (b) ? (a) : (b))\n"
+        "#define KCC_MAX(a, b) ((a) > (b) ? (a) : (b))\n"
+        "#define KCC_CLAMP(x, lo, hi) KCC_MIN(KCC_MAX(x, lo), hi)\n"
+        "#define KCC_LOG(fmt, ...) kcc_log(__FILE__, __LINE__, fmt, ## __VA_ARGS__)\n"
+        "#define KCC_FIELD(type, name) type KCC_XCONCAT(field_, name);\n";
+    static const char *snippet =
+        "#if KCC_PLATFORM_LINUX && KCC_ARCH_BITS == 64\n"
+        "struct page { KCC_FIELD(int, size) KCC_FIELD(char *, base) };\n"
+        "static int page_round(int n) {\n"
+        "    int aligned = KCC_CLAMP(n, KCC_ALIGNMENT, KCC_PAGE_SIZE);\n"
+        "    KCC_LOG(\"rounded %d to %d in \" KCC_XSTR(KCC_PAGE_SIZE), n, aligned);\n"
+        "    return aligned + KCC_MAX(KCC_ALIGNMENT, KCC_ARCH_BITS);\n"
+        "}\n"
+        "#else\n"
+        "#error unsupported platform\n"
+        "#endif\n\n";
+
+    size_t prologue_length = strlen(prologue);
+    size_t snippet_length = strlen(snippet);
+
+    char *input = malloc(size + prologue_length + 1);
+    if (!input) return NULL;
+
+    memcpy(input, prologue, prologue_length);
+    size_t used = prologue_length;
+    while (used + snippet_length <= size + prologue_length) {
+        memcpy(input + used, snippet, snippet_length);
+        used += snippet_length;
+    }
+    input[used] = '\0';
+    return input;
+}
+
+static int bench_input(const char *name, const char *input, int iterations) {
+    size_t length = strlen(input);
+    double seconds = 0.0;
+    size_t output_length = 0;
+
+    for (int i = 0; i < iterations; i++) {
+        Preprocessor *pp = preprocessor_create();
+
+        double start = bench_now();
+        char *output = preprocessor_process_buffer(pp, input, length, name);
+        seconds += bench_now() - start;
+
+        if (!output) {
+            fprintf(stderr, "%s: preprocessing failed\n", name);
+            preprocessor_destroy(pp);
+            return 1;
+        }
+        output_length = strlen(output);
+        free(output);
+        preprocessor_destroy(pp);
+    }
+
+    double megabytes = (double)length * iterations / (1024.0 * 1024.0);
+    printf("%s: %.1f MB x %d -> %.1f MB\n", name, megabytes / iterations, iterations,
+           (double)output_length / (1024.0 * 1024.0));
+    printf("  %8.1f MB/s\n", megabytes / seconds);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = 10;
+    int failures = 0;
+    int files = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+            if (iterations < 1) iterations = 1;
+            continue;
+        }
+
+        char *input = read_file(argv[i]);
+        if (!input) {
+            fprintf(stderr, "Cannot read %s\n", argv[i]);
+            failures++;
+            continue;
+        }
+        failures += bench_input(argv[i], input, iterations);
+        free(input);
+        files++;
+    }
+
+    if (files == 0 && failures == 0) {
+        char *input = bench_synthetic_input(SYNTHETIC_SIZE);
+        if (!input) {
+            fprintf(stderr, "Cannot allocate synthetic input\n");
+            return 1;
+        }
+        failures += bench_input("synthetic", input, iterations);
+        free(input);
+    }
+
+    intern_table_destroy();
+    return failures ? 1 : 0;
+}